@@ -0,0 +1,310 @@
+/**
+ * @file llkeyframebatch.cpp
+ * @brief Keyframe interpolations evaluated four curves at a time.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+//-----------------------------------------------------------------------------
+// Header Files
+//-----------------------------------------------------------------------------
+#include "linden_common.h"
+
+#include "llkeyframebatch.h"
+#include "lljointstate.h"
+
+namespace
+{
+	// Lane i of a group of four
+	inline F32& lane(LLVector4a& v, U32 i)
+	{
+		return v.getF32ptr()[i];
+	}
+
+	inline F32 lane(const LLVector4a& v, U32 i)
+	{
+		return v.getF32ptr()[i];
+	}
+
+	// Lanes in use in the group holding the last of count entries
+	inline U32 usedLanes(U32 group, U32 count)
+	{
+		const U32 used = count - group * 4;
+		return used >= 4 ? LLVector4Logical::MASK_XYZW : (1 << used) - 1;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// LLKeyframeBatch()
+//-----------------------------------------------------------------------------
+LLKeyframeBatch::LLKeyframeBatch()
+	: mVectorCount(0),
+	  mRotationCount(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+// clear()
+//-----------------------------------------------------------------------------
+void LLKeyframeBatch::clear()
+{
+	// lane storage is kept for the next frame
+	mVectorTargets.clear();
+	mRotationTargets.clear();
+	mVectorCount = 0;
+	mRotationCount = 0;
+}
+
+//-----------------------------------------------------------------------------
+// addVector()
+//-----------------------------------------------------------------------------
+void LLKeyframeBatch::addVector(LLJointState* state, EChannel channel,
+								const LLVector3& before, const LLVector3& after, F32 u)
+{
+	const U32 group = mVectorCount / 4;
+	const U32 i = mVectorCount % 4;
+	if (!i)
+	{
+		if (group == mVectors.size())
+		{
+			mVectors.emplace_back();
+		}
+		// unused lanes still get evaluated, keep them finite
+		VectorLanes& lanes = mVectors[group];
+		for (U32 c = 0; c < 3; ++c)
+		{
+			lanes.mValue[c].clear();
+			lanes.mAfter[c].clear();
+		}
+		lanes.mU.clear();
+	}
+
+	VectorLanes& lanes = mVectors[group];
+	for (U32 c = 0; c < 3; ++c)
+	{
+		lane(lanes.mValue[c], i) = before.mV[c];
+		lane(lanes.mAfter[c], i) = after.mV[c];
+	}
+	lane(lanes.mU, i) = u;
+
+	mVectorTargets.push_back({ state, channel });
+	++mVectorCount;
+}
+
+//-----------------------------------------------------------------------------
+// addRotation()
+//-----------------------------------------------------------------------------
+void LLKeyframeBatch::addRotation(LLJointState* state,
+								  const LLQuaternion& before, const LLQuaternion& after, F32 u)
+{
+	const U32 group = mRotationCount / 4;
+	const U32 i = mRotationCount % 4;
+	if (!i)
+	{
+		if (group == mRotations.size())
+		{
+			mRotations.emplace_back();
+		}
+		RotationLanes& lanes = mRotations[group];
+		for (U32 c = 0; c < 4; ++c)
+		{
+			lanes.mValue[c].clear();
+			lanes.mAfter[c].clear();
+		}
+		lanes.mU.clear();
+	}
+
+	RotationLanes& lanes = mRotations[group];
+	for (U32 c = 0; c < 4; ++c)
+	{
+		lane(lanes.mValue[c], i) = before.mQ[c];
+		lane(lanes.mAfter[c], i) = after.mQ[c];
+	}
+	lane(lanes.mU, i) = u;
+
+	mRotationTargets.push_back(state);
+	++mRotationCount;
+}
+
+//-----------------------------------------------------------------------------
+// evaluate()
+//-----------------------------------------------------------------------------
+void LLKeyframeBatch::evaluate()
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_AVATAR;
+
+	// lerp(), before + (after - before) * u
+	const U32 vector_groups = (mVectorCount + 3) / 4;
+	for (U32 g = 0; g < vector_groups; ++g)
+	{
+		VectorLanes& lanes = mVectors[g];
+		for (U32 c = 0; c < 3; ++c)
+		{
+			LLVector4a delta;
+			delta.setSub(lanes.mAfter[c], lanes.mValue[c]);
+			delta.mul(lanes.mU);
+			lanes.mValue[c].add(delta);
+		}
+	}
+
+	// nlerp(), the same operations in the same order as lerp() and
+	// LLQuaternion::normalize(), lane by lane
+	LLVector4a zero;
+	zero.clear();
+	LLVector4a one;
+	one.splat(1.f);
+	LLVector4a mag_threshold;
+	mag_threshold.splat(FP_MAG_THRESHOLD);
+	LLVector4a unit_tolerance;
+	unit_tolerance.splat(ONE_PART_IN_A_MILLION);
+
+	const U32 rotation_groups = (mRotationCount + 3) / 4;
+	for (U32 g = 0; g < rotation_groups; ++g)
+	{
+		RotationLanes& lanes = mRotations[g];
+
+		LLVector4a dot;
+		dot.setMul(lanes.mValue[0], lanes.mAfter[0]);
+		for (U32 c = 1; c < 4; ++c)
+		{
+			LLVector4a term;
+			term.setMul(lanes.mValue[c], lanes.mAfter[c]);
+			dot.add(term);
+		}
+
+		// keys in opposite hemispheres need slerp(), worked out before the
+		// lanes are overwritten
+		const U32 flipped = dot.lessThan(zero).getGatheredBits() & usedLanes(g, mRotationCount);
+		LLQuaternion slerped[4];
+		for (U32 i = 0; i < 4; ++i)
+		{
+			if (flipped & (1 << i))
+			{
+				const LLQuaternion before(lane(lanes.mValue[0], i), lane(lanes.mValue[1], i),
+										  lane(lanes.mValue[2], i), lane(lanes.mValue[3], i));
+				const LLQuaternion after(lane(lanes.mAfter[0], i), lane(lanes.mAfter[1], i),
+										 lane(lanes.mAfter[2], i), lane(lanes.mAfter[3], i));
+				slerped[i] = nlerp(lane(lanes.mU, i), before, after);
+			}
+		}
+
+		LLVector4a inv_t;
+		inv_t.setSub(one, lanes.mU);
+
+		LLVector4a res[4];
+		LLVector4a mag;
+		for (U32 c = 0; c < 4; ++c)
+		{
+			LLVector4a scaled_before;
+			scaled_before.setMul(inv_t, lanes.mValue[c]);
+			res[c].setMul(lanes.mU, lanes.mAfter[c]);
+			res[c].add(scaled_before);
+
+			LLVector4a square;
+			square.setMul(res[c], res[c]);
+			if (c)
+			{
+				mag.add(square);
+			}
+			else
+			{
+				mag = square;
+			}
+		}
+		mag = _mm_sqrt_ps(mag);
+
+		// renormalize unless already within a millionth of unit length,
+		// a quaternion too small to normalize becomes the identity
+		LLVector4a drift;
+		drift.setSub(one, mag);
+		drift.setAbs(drift);
+		const LLVector4Logical valid = mag.greaterThan(mag_threshold);
+		const LLVector4Logical renormalize = _mm_and_ps(valid, drift.greaterThan(unit_tolerance));
+
+		LLVector4a oomag;
+		oomag.setDiv(one, mag);
+		for (U32 c = 0; c < 4; ++c)
+		{
+			LLVector4a normalized;
+			normalized.setMul(res[c], oomag);
+			res[c].setSelectWithMask(renormalize, normalized, res[c]);
+			lanes.mValue[c].setSelectWithMask(valid, res[c], c == VW ? one : zero);
+		}
+
+		for (U32 i = 0; i < 4; ++i)
+		{
+			if (flipped & (1 << i))
+			{
+				for (U32 c = 0; c < 4; ++c)
+				{
+					lane(lanes.mValue[c], i) = slerped[i].mQ[c];
+				}
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// apply()
+//-----------------------------------------------------------------------------
+void LLKeyframeBatch::apply() const
+{
+	for (U32 i = 0; i < mVectorCount; ++i)
+	{
+		const VectorTarget& target = mVectorTargets[i];
+		if (target.mChannel == POSITION)
+		{
+			target.mState->setPosition(getVector(i));
+		}
+		else
+		{
+			target.mState->setScale(getVector(i));
+		}
+	}
+
+	for (U32 i = 0; i < mRotationCount; ++i)
+	{
+		mRotationTargets[i]->setRotation(getRotation(i));
+	}
+}
+
+//-----------------------------------------------------------------------------
+// getVector()
+//-----------------------------------------------------------------------------
+LLVector3 LLKeyframeBatch::getVector(U32 index) const
+{
+	llassert(index < mVectorCount);
+	const VectorLanes& lanes = mVectors[index / 4];
+	const U32 i = index % 4;
+	return LLVector3(lane(lanes.mValue[0], i), lane(lanes.mValue[1], i), lane(lanes.mValue[2], i));
+}
+
+//-----------------------------------------------------------------------------
+// getRotation()
+//-----------------------------------------------------------------------------
+LLQuaternion LLKeyframeBatch::getRotation(U32 index) const
+{
+	llassert(index < mRotationCount);
+	const RotationLanes& lanes = mRotations[index / 4];
+	const U32 i = index % 4;
+	return LLQuaternion(lane(lanes.mValue[0], i), lane(lanes.mValue[1], i),
+						lane(lanes.mValue[2], i), lane(lanes.mValue[3], i));
+}
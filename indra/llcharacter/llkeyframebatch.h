@@ -0,0 +1,113 @@
+/**
+ * @file llkeyframebatch.h
+ * @brief Keyframe interpolations evaluated four curves at a time.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLKEYFRAMEBATCH_H
+#define LL_LLKEYFRAMEBATCH_H
+
+#include <vector>
+
+#include "llmath.h"
+#include "llquaternion.h"
+#include "llvector4a.h"
+#include "v3math.h"
+
+class LLJointState;
+
+//-----------------------------------------------------------------------------
+// class LLKeyframeBatch
+//
+// The interpolations a motion needs for one frame, gathered from all of its
+// curves and evaluated together.  Each component is kept in its own lane
+// array, so every SSE operation works on four curves at once.  Results are
+// the same as LLKeyframeMotion::Curve::getValue(): vectors are lerped and
+// rotations nlerped, with the rare pair of keys in opposite hemispheres
+// slerped one at a time.
+//-----------------------------------------------------------------------------
+class LLKeyframeBatch
+{
+public:
+	enum EChannel
+	{
+		POSITION,
+		SCALE
+	};
+
+	LLKeyframeBatch();
+
+	void clear();
+	bool empty() const		{ return !mVectorCount && !mRotationCount; }
+
+	// Queues lerp(before, after, u) for state's position or scale
+	void addVector(LLJointState* state, EChannel channel,
+				   const LLVector3& before, const LLVector3& after, F32 u);
+
+	// Queues nlerp(u, before, after) for state's rotation
+	void addRotation(LLJointState* state,
+					 const LLQuaternion& before, const LLQuaternion& after, F32 u);
+
+	void evaluate();
+
+	// Hands the evaluated values to their joint states
+	void apply() const;
+
+	U32 getVectorCount() const		{ return mVectorCount; }
+	U32 getRotationCount() const	{ return mRotationCount; }
+
+	// Evaluated values, in the order they were added
+	LLVector3 getVector(U32 index) const;
+	LLQuaternion getRotation(U32 index) const;
+
+private:
+	// Four vector curves, one component per lane.  mValue holds the
+	// earlier key until evaluate() replaces it with the result.
+	struct VectorLanes
+	{
+		LLVector4a	mValue[3];
+		LLVector4a	mAfter[3];
+		LLVector4a	mU;
+	};
+
+	struct RotationLanes
+	{
+		LLVector4a	mValue[4];
+		LLVector4a	mAfter[4];
+		LLVector4a	mU;
+	};
+
+	struct VectorTarget
+	{
+		LLJointState*	mState;
+		EChannel		mChannel;
+	};
+
+	std::vector<VectorLanes>	mVectors;
+	std::vector<RotationLanes>	mRotations;
+	std::vector<VectorTarget>	mVectorTargets;
+	std::vector<LLJointState*>	mRotationTargets;
+	U32							mVectorCount;
+	U32							mRotationCount;
+};
+
+#endif // LL_LLKEYFRAMEBATCH_H
@@ -37,6 +37,7 @@
 #include "llcriticaldamp.h"
 #include "lldir.h"
 #include "llendianswizzle.h"
+#include "llkeyframebatch.h"
 #include "llkeyframemotion.h"
 #include "llquantize.h"
 #include "m3math.h"
@@ -130,7 +131,7 @@ U32 LLKeyframeMotion::JointMotionList::dumpDiagInfo()
 //-----------------------------------------------------------------------------
 // JointMotion::update()
 //-----------------------------------------------------------------------------
-void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time, F32 duration)
+void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time, F32 duration, LLKeyframeBatch& batch)
 {
 	// this value being 0 is the cause of https://jira.lindenlab.com/browse/SL-22678 but I haven't 
 	// managed to get a stack to see how it got here. Testing for 0 here will stop the crash.
@@ -140,13 +141,24 @@ void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time,
 	}
 
 	U32 usage = joint_state->getUsage();
+	F32 u;
 
 	//-------------------------------------------------------------------------
 	// update scale component of joint state
 	//-------------------------------------------------------------------------
 	if ((usage & LLJointState::SCALE) && mScaleCurve.mNumKeys)
 	{
-		joint_state->setScale( mScaleCurve.getValue( time, duration ) );
+		const LLVector3* before;
+		const LLVector3* after;
+		mScaleCurve.findKeys(time, duration, before, after, u);
+		if (after)
+		{
+			batch.addVector(joint_state, LLKeyframeBatch::SCALE, *before, *after, u);
+		}
+		else
+		{
+			joint_state->setScale(before ? *before : LLVector3());
+		}
 	}
 
 	//-------------------------------------------------------------------------
@@ -154,7 +166,17 @@ void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time,
 	//-------------------------------------------------------------------------
 	if ((usage & LLJointState::ROT) && mRotationCurve.mNumKeys)
 	{
-		joint_state->setRotation( mRotationCurve.getValue( time, duration ) );
+		const LLQuaternion* before;
+		const LLQuaternion* after;
+		mRotationCurve.findKeys(time, duration, before, after, u);
+		if (after)
+		{
+			batch.addRotation(joint_state, *before, *after, u);
+		}
+		else
+		{
+			joint_state->setRotation(before ? *before : LLQuaternion());
+		}
 	}
 
 	//-------------------------------------------------------------------------
@@ -162,7 +184,17 @@ void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time,
 	//-------------------------------------------------------------------------
 	if ((usage & LLJointState::POS) && mPositionCurve.mNumKeys)
 	{
-		joint_state->setPosition( mPositionCurve.getValue( time, duration ) );
+		const LLVector3* before;
+		const LLVector3* after;
+		mPositionCurve.findKeys(time, duration, before, after, u);
+		if (after)
+		{
+			batch.addVector(joint_state, LLKeyframeBatch::POSITION, *before, *after, u);
+		}
+		else
+		{
+			joint_state->setPosition(before ? *before : LLVector3());
+		}
 	}
 }
 
@@ -485,11 +517,22 @@ BOOL LLKeyframeMotion::onUpdate(F32 time, U8* joint_mask)
 void LLKeyframeMotion::applyKeyframes(F32 time)
 {
 	llassert_always (mJointMotionList->getNumJointMotions() <= mJointStates.size());
+
+	// values between keys are interpolated together, several curves per
+	// instruction
+	static thread_local LLKeyframeBatch batch;
+	batch.clear();
 	for (U32 i=0; i<mJointMotionList->getNumJointMotions(); i++)
 	{
 		mJointMotionList->getJointMotion(i)->update(mJointStates[i],
 													  time, 
-													  mJointMotionList->mDuration );
+													  mJointMotionList->mDuration,
+													  batch);
+	}
+	if (!batch.empty())
+	{
+		batch.evaluate();
+		batch.apply();
 	}
 
 	LLJoint::JointPriority* pose_priority = (LLJoint::JointPriority* )mCharacter->getAnimationData("Hand Pose Priority");
@@ -46,6 +46,7 @@
 
 #include "boost/unordered/unordered_flat_map.hpp"
 
+class LLKeyframeBatch;
 class LLKeyframeDataCache;
 class LLDataPacker;
 
@@ -308,57 +309,59 @@ class LLKeyframeMotion :
 			T			mValue;
 		};
 
-		T interp(F32 u, Key& before, Key& after)
-		{
-			switch (mInterpolationType)
-			{
-			case IT_STEP:
-				return before.mValue;
-			default:
-			case IT_LINEAR:
-			case IT_SPLINE:
-				return LLKeyframeMotionLerp::lerp(u, before.mValue, after.mValue);
-			}
-		}
-
-		T getValue(F32 time, F32 duration)
+		// The keys either side of time and how far time is between them.
+		// after is null where the value is just before's: on a key, outside
+		// the keys or with step interpolation.  Both are null with no keys.
+		void findKeys(F32 time, F32 duration, const T*& before, const T*& after, F32& u) const
 		{
+			before = nullptr;
+			after = nullptr;
+			u = 0.f;
 			if (mKeys.empty())
 			{
-				return T();
+				return;
 			}
 
-			T value;
-			typename key_map_t::iterator right = std::lower_bound(mKeys.begin(), mKeys.end(), time, [](const auto& a, const auto& b) { return a.first < b; });
+			typename key_map_t::const_iterator right = std::lower_bound(mKeys.begin(), mKeys.end(), time, [](const auto& a, const auto& b) { return a.first < b; });
 			if (right == mKeys.end())
 			{
 				// Past last key
 				--right;
-				value = right->second.mValue;
+				before = &right->second.mValue;
 			}
 			else if (right == mKeys.begin() || right->first == time)
 			{
 				// Before first key or exactly on a key
-				value = right->second.mValue;
+				before = &right->second.mValue;
 			}
 			else
 			{
 				// Between two keys
-				typename key_map_t::iterator left = right; --left;
-				F32 index_before = left->first;
-				F32 index_after = right->first;
-				Key& pos_before = left->second;
-				Key& pos_after = right->second;
-				if (right == mKeys.end())
+				typename key_map_t::const_iterator left = right; --left;
+				before = &left->second.mValue;
+				if (mInterpolationType != IT_STEP)
 				{
-					pos_after = mLoopInKey;
-					index_after = duration;
+					after = &right->second.mValue;
+					u = (time - left->first) / (right->first - left->first);
 				}
+			}
+		}
 
-				F32 u = (time - index_before) / (index_after - index_before);
-				value = interp(u, pos_before, pos_after);
+		T getValue(F32 time, F32 duration)
+		{
+			const T* before;
+			const T* after;
+			F32 u;
+			findKeys(time, duration, before, after, u);
+			if (!before)
+			{
+				return T();
+			}
+			if (!after)
+			{
+				return *before;
 			}
-			return value;
+			return LLKeyframeMotionLerp::lerp(u, *before, *after);
 		}
 
 		InterpolationType	mInterpolationType = LLKeyframeMotion::IT_LINEAR;
@@ -389,7 +392,9 @@ class LLKeyframeMotion :
 		U32				mUsage;
 		LLJoint::JointPriority	mPriority;
 
-		void update(LLJointState* joint_state, F32 time, F32 duration);
+		// Sets the joint state's values at time, queueing those that need
+		// interpolating into batch
+		void update(LLJointState* joint_state, F32 time, F32 duration, LLKeyframeBatch& batch);
 	};
 	
 	//-------------------------------------------------------------------------
@@ -0,0 +1,445 @@
+/**
+ * @file llkeyframebatch_test.cpp
+ * @brief Checks batched keyframe interpolation against lerp() and nlerp().
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llkeyframebatch.h"
+
+#include "llparallelfor.h"
+#include "llstring.h"
+#include "stringize.h"
+#include "workqueue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// Small deterministic generator, the results must not depend on the run
+	struct Sequence
+	{
+		U32 mState = 4321;
+
+		F32 next(F32 lo, F32 hi)
+		{
+			mState = mState * 1664525 + 1013904223;
+			return lo + (hi - lo) * F32(mState >> 8) / F32(1 << 24);
+		}
+
+		LLVector3 vector()
+		{
+			return LLVector3(next(-2.f, 2.f), next(-2.f, 2.f), next(-2.f, 2.f));
+		}
+
+		LLQuaternion rotation()
+		{
+			LLQuaternion q(next(-1.f, 1.f), next(-1.f, 1.f), next(-1.f, 1.f), next(-1.f, 1.f));
+			q.normalize();
+			return q;
+		}
+	};
+
+	const F32 TOLERANCE = 1e-5f;
+
+	bool approx_equal(const LLVector3& a, const LLVector3& b)
+	{
+		return dist_vec_squared(a, b) <= TOLERANCE * TOLERANCE;
+	}
+
+	bool approx_equal(const LLQuaternion& a, const LLQuaternion& b)
+	{
+		for (U32 c = 0; c < 4; ++c)
+		{
+			if (fabsf(a.mQ[c] - b.mQ[c]) > TOLERANCE)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// A curve shaped like LLKeyframeMotion::Curve, for the benchmark
+	template<typename T>
+	struct BenchCurve
+	{
+		std::vector<F32>	mTimes;
+		std::vector<T>		mValues;
+
+		// index of the key before time, or -1 when the value is a key's
+		S32 find(F32 time, S32& key, F32& u) const
+		{
+			auto right = std::lower_bound(mTimes.begin(), mTimes.end(), time);
+			if (right == mTimes.end())
+			{
+				key = (S32)mTimes.size() - 1;
+				return -1;
+			}
+			if (right == mTimes.begin() || *right == time)
+			{
+				key = S32(right - mTimes.begin());
+				return -1;
+			}
+			key = S32(right - mTimes.begin());
+			u = (time - *(right - 1)) / (*right - *(right - 1));
+			return key - 1;
+		}
+	};
+
+	struct BenchJoint
+	{
+		BenchCurve<LLQuaternion>	mRotation;
+		BenchCurve<LLVector3>		mPosition;
+	};
+
+	typedef std::vector<BenchJoint> bench_motion_t;
+	typedef std::vector<bench_motion_t> bench_avatar_t;
+}
+
+namespace tut
+{
+	struct keyframebatch_data
+	{
+		Sequence mSeq;
+		LLKeyframeBatch mBatch;
+	};
+
+	typedef test_group<keyframebatch_data> keyframebatch_group;
+	typedef keyframebatch_group::object keyframebatch_object;
+	tut::keyframebatch_group keyframebatch_test_group("LLKeyframeBatch");
+
+	template<> template<>
+	void keyframebatch_object::test<1>()
+	{
+		set_test_name("vectors match lerp()");
+
+		// whole groups of four and partial ones
+		for (U32 count = 1; count <= 9; ++count)
+		{
+			std::vector<LLVector3> expected;
+			mBatch.clear();
+			for (U32 i = 0; i < count; ++i)
+			{
+				const LLVector3 before = mSeq.vector();
+				const LLVector3 after = mSeq.vector();
+				const F32 u = mSeq.next(0.f, 1.f);
+				mBatch.addVector(NULL, (i & 1) ? LLKeyframeBatch::SCALE : LLKeyframeBatch::POSITION, before, after, u);
+				expected.push_back(lerp(before, after, u));
+			}
+			mBatch.evaluate();
+
+			ensure_equals("vector count", mBatch.getVectorCount(), count);
+			ensure_equals("no rotations", mBatch.getRotationCount(), 0U);
+			for (U32 i = 0; i < count; ++i)
+			{
+				ensure(STRINGIZE("count " << count << " vector " << i), approx_equal(mBatch.getVector(i), expected[i]));
+			}
+		}
+	}
+
+	template<> template<>
+	void keyframebatch_object::test<2>()
+	{
+		set_test_name("rotations match nlerp()");
+
+		for (U32 count = 1; count <= 9; ++count)
+		{
+			std::vector<LLQuaternion> expected;
+			mBatch.clear();
+			for (U32 i = 0; i < count; ++i)
+			{
+				const LLQuaternion before = mSeq.rotation();
+				LLQuaternion after = mSeq.rotation();
+				// both hemispheres, so lanes are lerped and slerped in one group
+				if ((dot(before, after) < 0.f) == bool(i % 3))
+				{
+					after = -after;
+				}
+				const F32 u = mSeq.next(0.f, 1.f);
+				mBatch.addRotation(NULL, before, after, u);
+				expected.push_back(nlerp(u, before, after));
+			}
+			mBatch.evaluate();
+
+			ensure_equals("rotation count", mBatch.getRotationCount(), count);
+			for (U32 i = 0; i < count; ++i)
+			{
+				ensure(STRINGIZE("count " << count << " rotation " << i), approx_equal(mBatch.getRotation(i), expected[i]));
+			}
+		}
+	}
+
+	template<> template<>
+	void keyframebatch_object::test<3>()
+	{
+		set_test_name("rotation edge cases");
+
+		const LLQuaternion q = mSeq.rotation();
+		const LLQuaternion zero(0.f, 0.f, 0.f, 0.f);
+		// slightly off unit length, left alone by normalize()
+		const LLQuaternion near_unit(0.f, 0.f, 0.f, 1.f + 0.5f * ONE_PART_IN_A_MILLION);
+		const LLQuaternion other = mSeq.rotation();
+
+		mBatch.clear();
+		mBatch.addRotation(NULL, q, q, 0.5f);
+		mBatch.addRotation(NULL, zero, zero, 0.25f);
+		mBatch.addRotation(NULL, near_unit, near_unit, 0.75f);
+		mBatch.addRotation(NULL, q, other, 0.f);
+		mBatch.addRotation(NULL, q, other, 1.f);
+		mBatch.evaluate();
+
+		ensure("same keys", approx_equal(mBatch.getRotation(0), nlerp(0.5f, q, q)));
+		ensure("degenerate keys give the identity", mBatch.getRotation(1) == LLQuaternion::DEFAULT);
+		ensure("near unit kept as is", approx_equal(mBatch.getRotation(2), nlerp(0.75f, near_unit, near_unit)));
+		ensure("near unit not renormalized", mBatch.getRotation(2).mQ[VW] > 1.f);
+		ensure("u of 0", approx_equal(mBatch.getRotation(3), nlerp(0.f, q, other)));
+		ensure("u of 1", approx_equal(mBatch.getRotation(4), nlerp(1.f, q, other)));
+	}
+
+	template<> template<>
+	void keyframebatch_object::test<4>()
+	{
+		set_test_name("reuse after clear");
+
+		// fill two groups with keys in opposite hemispheres
+		const LLQuaternion q = mSeq.rotation();
+		for (U32 i = 0; i < 8; ++i)
+		{
+			mBatch.addRotation(NULL, q, -q, 0.5f);
+			mBatch.addVector(NULL, LLKeyframeBatch::POSITION, mSeq.vector(), mSeq.vector(), 0.5f);
+		}
+		mBatch.evaluate();
+
+		mBatch.clear();
+		ensure("empty after clear", mBatch.empty());
+
+		const LLQuaternion before = mSeq.rotation();
+		LLQuaternion after = mSeq.rotation();
+		if (dot(before, after) < 0.f)
+		{
+			after = -after;
+		}
+		const LLVector3 from = mSeq.vector();
+		const LLVector3 to = mSeq.vector();
+		mBatch.addRotation(NULL, before, after, 0.3f);
+		mBatch.addVector(NULL, LLKeyframeBatch::SCALE, from, to, 0.3f);
+		ensure("not empty", !mBatch.empty());
+		mBatch.evaluate();
+
+		ensure_equals("one rotation", mBatch.getRotationCount(), 1U);
+		ensure_equals("one vector", mBatch.getVectorCount(), 1U);
+		ensure("rotation", approx_equal(mBatch.getRotation(0), nlerp(0.3f, before, after)));
+		ensure("vector", approx_equal(mBatch.getVector(0), lerp(from, to, 0.3f)));
+	}
+
+	template<> template<>
+	void keyframebatch_object::test<5>()
+	{
+		set_test_name("crowd benchmark");
+
+		// Sampling a crowd's animations takes a while, so this only runs on
+		// request, e.g. LL_KEYFRAME_BENCH_AVATARS=100
+		std::string avatars_str = LLStringUtil::getenv("LL_KEYFRAME_BENCH_AVATARS");
+		if (avatars_str.empty())
+		{
+			skip("set LL_KEYFRAME_BENCH_AVATARS to run");
+		}
+		const U32 avatar_count = (U32)std::stoul(avatars_str);
+
+		// Roughly a stand, a walk layered with a few AO and gesture
+		// animations, each driving most of a Bento skeleton
+		const U32 MOTIONS = 6;
+		const U32 JOINTS = 80;
+		const U32 KEYS = 40;
+		const F32 DURATION = 4.f;
+		const U32 FRAMES = 60;
+
+		std::vector<bench_avatar_t> avatars(avatar_count);
+		for (bench_avatar_t& avatar : avatars)
+		{
+			avatar.resize(MOTIONS);
+			for (bench_motion_t& motion : avatar)
+			{
+				motion.resize(JOINTS);
+				for (U32 j = 0; j < JOINTS; ++j)
+				{
+					BenchJoint& joint = motion[j];
+					LLQuaternion rot = mSeq.rotation();
+					for (U32 k = 0; k < KEYS; ++k)
+					{
+						joint.mRotation.mTimes.push_back(DURATION * k / KEYS);
+						joint.mRotation.mValues.push_back(rot);
+						rot = nlerp(0.1f, rot, mSeq.rotation());
+						// the pelvis and a few others move
+						if (j % 8 == 0)
+						{
+							joint.mPosition.mTimes.push_back(DURATION * k / KEYS);
+							joint.mPosition.mValues.push_back(mSeq.vector());
+						}
+					}
+				}
+			}
+		}
+
+		// Each avatar's motions at each frame's time, the sum keeps the
+		// results live
+		auto scalar = [&](const bench_avatar_t& avatar, F32 time, F32& sum)
+		{
+			for (const bench_motion_t& motion : avatar)
+			{
+				for (const BenchJoint& joint : motion)
+				{
+					S32 key;
+					F32 u;
+					S32 before = joint.mRotation.find(time, key, u);
+					LLQuaternion rot = before < 0 ? joint.mRotation.mValues[key]
+											: nlerp(u, joint.mRotation.mValues[before], joint.mRotation.mValues[key]);
+					sum += rot.mQ[VW];
+					if (!joint.mPosition.mTimes.empty())
+					{
+						before = joint.mPosition.find(time, key, u);
+						LLVector3 pos = before < 0 ? joint.mPosition.mValues[key]
+											: lerp(joint.mPosition.mValues[before], joint.mPosition.mValues[key], u);
+						sum += pos.mV[VZ];
+					}
+				}
+			}
+		};
+
+		auto batched = [&](const bench_avatar_t& avatar, F32 time, F32& sum)
+		{
+			static thread_local LLKeyframeBatch batch;
+			for (const bench_motion_t& motion : avatar)
+			{
+				batch.clear();
+				for (const BenchJoint& joint : motion)
+				{
+					S32 key;
+					F32 u;
+					S32 before = joint.mRotation.find(time, key, u);
+					if (before < 0)
+					{
+						sum += joint.mRotation.mValues[key].mQ[VW];
+					}
+					else
+					{
+						batch.addRotation(NULL, joint.mRotation.mValues[before], joint.mRotation.mValues[key], u);
+					}
+					if (!joint.mPosition.mTimes.empty())
+					{
+						before = joint.mPosition.find(time, key, u);
+						if (before < 0)
+						{
+							sum += joint.mPosition.mValues[key].mV[VZ];
+						}
+						else
+						{
+							batch.addVector(NULL, LLKeyframeBatch::POSITION,
+											joint.mPosition.mValues[before], joint.mPosition.mValues[key], u);
+						}
+					}
+				}
+				batch.evaluate();
+				for (U32 i = 0; i < batch.getRotationCount(); ++i)
+				{
+					sum += batch.getRotation(i).mQ[VW];
+				}
+				for (U32 i = 0; i < batch.getVectorCount(); ++i)
+				{
+					sum += batch.getVector(i).mV[VZ];
+				}
+			}
+		};
+
+		typedef std::chrono::high_resolution_clock clock_t;
+		auto ms = [](clock_t::time_point start)
+		{
+			return std::chrono::duration_cast<std::chrono::microseconds>(clock_t::now() - start).count() / 1000.0;
+		};
+		auto frame_time = [&](U32 frame) { return DURATION * (frame + 0.37f) / FRAMES; };
+
+		F32 scalar_sum = 0.f;
+		clock_t::time_point start = clock_t::now();
+		for (U32 f = 0; f < FRAMES; ++f)
+		{
+			for (const bench_avatar_t& avatar : avatars)
+			{
+				scalar(avatar, frame_time(f), scalar_sum);
+			}
+		}
+		const double scalar_ms = ms(start) / FRAMES;
+
+		F32 batched_sum = 0.f;
+		start = clock_t::now();
+		for (U32 f = 0; f < FRAMES; ++f)
+		{
+			for (const bench_avatar_t& avatar : avatars)
+			{
+				batched(avatar, frame_time(f), batched_sum);
+			}
+		}
+		const double batched_ms = ms(start) / FRAMES;
+		ensure("same poses", fabsf(scalar_sum - batched_sum) <= 1e-3f * llmax(1.f, fabsf(scalar_sum)));
+
+		// one avatar per chunk, as the viewer hands them to the General pool
+		LL::WorkQueue queue("KeyframeBatchBench");
+		std::vector<std::thread> workers;
+		const U32 worker_count = llmax(1U, std::thread::hardware_concurrency() - 1);
+		for (U32 i = 0; i < worker_count; ++i)
+		{
+			workers.emplace_back([&queue](){ queue.runUntilClose(); });
+		}
+		std::vector<F32> sums(avatars.size());
+		start = clock_t::now();
+		for (U32 f = 0; f < FRAMES; ++f)
+		{
+			const F32 time = frame_time(f);
+			LL::parallelFor("KeyframeBatchBench", avatars.size(), 1,
+							[&](size_t begin, size_t end)
+							{
+								for (size_t i = begin; i < end; ++i)
+								{
+									batched(avatars[i], time, sums[i]);
+								}
+							});
+		}
+		const double parallel_ms = ms(start) / FRAMES;
+		queue.close();
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+
+		std::cout << "\n" << avatar_count << " avatars, " << MOTIONS << " motions of " << JOINTS
+				  << " joints each, per frame:\n"
+				  << "  scalar            " << scalar_ms << " ms\n"
+				  << "  batched           " << batched_ms << " ms\n"
+				  << "  batched, " << worker_count + 1 << " threads " << parallel_ms << " ms" << std::endl;
+	}
+}
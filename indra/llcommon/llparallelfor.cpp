@@ -0,0 +1,131 @@
+/**
+ * @file   llparallelfor.cpp
+ * @brief  Runs a loop over a range in chunks on a thread pool.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+// Precompiled header
+#include "linden_common.h"
+// associated header
+#include "llparallelfor.h"
+// STL headers
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+// other Linden headers
+#include "threadpool.h"
+#include "workqueue.h"
+
+namespace
+{
+    // Shared with the helpers posted to the queue. A helper that starts
+    // after every chunk is taken finds nothing to do and never touches
+    // mBody, which may be gone by then.
+    struct ParallelJob
+    {
+        ParallelJob(size_t count, size_t grain,
+                    const std::function<void(size_t, size_t)>& body):
+            mCount(count),
+            mGrain(grain),
+            mChunks((count + grain - 1) / grain),
+            mBody(&body),
+            mNext(0),
+            mDone(0)
+        {}
+
+        void runChunks()
+        {
+            size_t chunk;
+            while ((chunk = mNext.fetch_add(1, std::memory_order_relaxed)) < mChunks)
+            {
+                size_t begin = chunk * mGrain;
+                (*mBody)(begin, std::min(mCount, begin + mGrain));
+                mDone.fetch_add(1, std::memory_order_release);
+            }
+        }
+
+        // Stops handing out chunks, returns how many were handed out
+        size_t abandon()
+        {
+            return std::min(mNext.exchange(mChunks), mChunks);
+        }
+
+        void waitFor(size_t chunks)
+        {
+            while (mDone.load(std::memory_order_acquire) < chunks)
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        const size_t mCount;
+        const size_t mGrain;
+        const size_t mChunks;
+        const std::function<void(size_t, size_t)>* mBody;
+        std::atomic<size_t> mNext;
+        std::atomic<size_t> mDone;
+    };
+} // anonymous namespace
+
+void LL::parallelFor(const std::string& queue_name, size_t count, size_t grain,
+                     const std::function<void(size_t, size_t)>& body)
+{
+    if (! count)
+    {
+        return;
+    }
+    grain = std::max(grain, size_t(1));
+    if (count <= grain)
+    {
+        body(0, count);
+        return;
+    }
+
+    auto job = std::make_shared<ParallelJob>(count, grain, body);
+
+    // One helper per pool thread at most, the caller makes up the rest
+    size_t helpers = std::min(job->mChunks - 1,
+                              ThreadPoolBase::getWidth(queue_name, std::thread::hardware_concurrency()));
+    WorkQueue::ptr_t queue = WorkQueue::getInstance(queue_name);
+    if (queue)
+    {
+        for (size_t i = 0; i < helpers; ++i)
+        {
+            if (! queue->post([job](){ job->runChunks(); }))
+            {
+                break;
+            }
+        }
+    }
+
+    try
+    {
+        job->runChunks();
+    }
+    catch (...)
+    {
+        job->waitFor(job->abandon() - 1);
+        throw;
+    }
+    job->waitFor(job->mChunks);
+}
@@ -0,0 +1,52 @@
+/**
+ * @file   llparallelfor.h
+ * @brief  Runs a loop over a range in chunks on a thread pool.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#if ! defined(LL_LLPARALLELFOR_H)
+#define LL_LLPARALLELFOR_H
+
+#include <functional>
+#include <string>
+
+namespace LL
+{
+    /**
+     * Splits [0, count) into chunks of grain items and calls body(begin, end)
+     * once per chunk, on the threads of the named WorkQueue and on the
+     * calling thread. Returns when every chunk has run.
+     *
+     * The calling thread takes chunks too and only ever waits on chunks
+     * already running elsewhere, so a busy pool, a closed queue or calling
+     * from one of the pool's own threads costs parallelism, not progress.
+     * Chunks run in no particular order, body must be safe to call
+     * concurrently on disjoint ranges. If body throws on the calling
+     * thread, chunks not yet started are abandoned and the exception is
+     * rethrown once the running ones finish. body must not throw on the
+     * pool's threads.
+     */
+    void parallelFor(const std::string& queue_name, size_t count, size_t grain,
+                     const std::function<void(size_t begin, size_t end)>& body);
+} // namespace LL
+
+#endif /* ! defined(LL_LLPARALLELFOR_H) */
@@ -0,0 +1,1151 @@
+/**
+ * @file llsddocument.cpp
+ * @brief Read only LLSD document parsed into one flat buffer of nodes.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "llsddocument.h"
+
+#include "apr_base64.h"
+
+#include "lldate.h"
+#include "llstring.h"
+#include "lluri.h"
+
+#include <cstring>
+
+namespace
+{
+	// Decoded text is packed in chunks of this size; bigger strings get a
+	// chunk of their own.
+	const size_t CHUNK_SIZE = 64 * 1024;
+
+	U32 read_u32_nbo(const char* pos)
+	{
+		const U8* bytes = reinterpret_cast<const U8*>(pos);
+		return ((U32)bytes[0] << 24) | ((U32)bytes[1] << 16) | ((U32)bytes[2] << 8) | (U32)bytes[3];
+	}
+
+	F64 read_f64_nbo(const char* pos)
+	{
+		U64 bits = ((U64)read_u32_nbo(pos) << 32) | (U64)read_u32_nbo(pos + 4);
+		F64 value;
+		memcpy(&value, &bits, sizeof(F64));
+		return value;
+	}
+
+	// Reads a notation style string up to delim, the opening delimiter
+	// already consumed. See deserialize_string_delim() in llsdserialize.cpp.
+	// When there is nothing to unescape, text points into the source and
+	// value is left empty.
+	bool read_delimited(const char*& pos, const char* end, char delim,
+						const char*& text, U32& size, std::string& value, bool& decoded)
+	{
+		const char* start = pos;
+		while (pos < end && *pos != delim && *pos != '\\')
+		{
+			++pos;
+		}
+		if (pos >= end)
+		{
+			return false;
+		}
+		if (*pos == delim)
+		{
+			text = start;
+			size = (U32)(pos - start);
+			decoded = false;
+			++pos;
+			return true;
+		}
+
+		value.assign(start, pos);
+		while (pos < end)
+		{
+			char c = *pos++;
+			if (c == delim)
+			{
+				decoded = true;
+				return true;
+			}
+			if (c != '\\')
+			{
+				value.push_back(c);
+				continue;
+			}
+			if (pos >= end)
+			{
+				return false;
+			}
+			c = *pos++;
+			switch (c)
+			{
+			case 'a': value.push_back('\a'); break;
+			case 'b': value.push_back('\b'); break;
+			case 'f': value.push_back('\f'); break;
+			case 'n': value.push_back('\n'); break;
+			case 'r': value.push_back('\r'); break;
+			case 't': value.push_back('\t'); break;
+			case 'v': value.push_back('\v'); break;
+			case 'x':
+				if (end - pos < 2)
+				{
+					return false;
+				}
+				value.push_back((char)((hex_as_nybble(pos[0]) << 4) | hex_as_nybble(pos[1])));
+				pos += 2;
+				break;
+			default:
+				value.push_back(c);
+				break;
+			}
+		}
+		return false;
+	}
+
+	bool starts_with(const char* pos, const char* end, std::string_view prefix)
+	{
+		return (size_t)(end - pos) >= prefix.size() && !memcmp(pos, prefix.data(), prefix.size());
+	}
+
+	bool is_xml_space(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+	}
+
+	void append_utf8(std::string& out, U32 code)
+	{
+		if (code < 0x80)
+		{
+			out.push_back((char)code);
+		}
+		else if (code < 0x800)
+		{
+			out.push_back((char)(0xC0 | (code >> 6)));
+			out.push_back((char)(0x80 | (code & 0x3F)));
+		}
+		else if (code < 0x10000)
+		{
+			out.push_back((char)(0xE0 | (code >> 12)));
+			out.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+			out.push_back((char)(0x80 | (code & 0x3F)));
+		}
+		else
+		{
+			out.push_back((char)(0xF0 | (code >> 18)));
+			out.push_back((char)(0x80 | ((code >> 12) & 0x3F)));
+			out.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+			out.push_back((char)(0x80 | (code & 0x3F)));
+		}
+	}
+}
+
+//
+// Tokenizer for the subset of XML that LLSD uses
+//
+
+struct LLSDDocument::XMLCursor
+{
+	const char* mPos;
+	const char* mEnd;
+
+	// Skips white space, comments, processing instructions and doctype
+	// declarations between elements. Returns false if what follows is
+	// neither one of those nor a tag.
+	bool skipMisc()
+	{
+		while (true)
+		{
+			while (mPos < mEnd && is_xml_space(*mPos))
+			{
+				++mPos;
+			}
+			if (mPos >= mEnd || *mPos != '<')
+			{
+				return false;
+			}
+			if (starts_with(mPos, mEnd, "<?"))
+			{
+				if (!skipPast("?>")) return false;
+			}
+			else if (starts_with(mPos, mEnd, "<!--"))
+			{
+				if (!skipPast("-->")) return false;
+			}
+			else if (starts_with(mPos, mEnd, "<!"))
+			{
+				if (!skipPast(">")) return false;
+			}
+			else
+			{
+				return true;
+			}
+		}
+	}
+
+	bool skipPast(std::string_view marker)
+	{
+		std::string_view rest(mPos, mEnd - mPos);
+		size_t found = rest.find(marker);
+		if (found == std::string_view::npos)
+		{
+			return false;
+		}
+		mPos += found + marker.size();
+		return true;
+	}
+
+	// Reads the tag at mPos, skipping its attributes
+	bool readTag(std::string_view& name, bool& closing, bool& empty)
+	{
+		if (!skipMisc())
+		{
+			return false;
+		}
+		++mPos;
+		closing = (mPos < mEnd && *mPos == '/');
+		if (closing)
+		{
+			++mPos;
+		}
+		const char* start = mPos;
+		while (mPos < mEnd && !is_xml_space(*mPos) && *mPos != '/' && *mPos != '>')
+		{
+			++mPos;
+		}
+		name = std::string_view(start, mPos - start);
+
+		char quote = 0;
+		const char* last = NULL;
+		while (mPos < mEnd)
+		{
+			char c = *mPos++;
+			if (quote)
+			{
+				if (c == quote) quote = 0;
+			}
+			else if (c == '"' || c == '\'')
+			{
+				quote = c;
+			}
+			else if (c == '>')
+			{
+				empty = (last && *last == '/');
+				return !name.empty() && !(closing && empty);
+			}
+			else if (!is_xml_space(c))
+			{
+				last = mPos - 1;
+			}
+		}
+		return false;
+	}
+};
+
+//
+// LLSDDocument
+//
+
+LLSDDocument::LLSDDocument()
+:	mChunkPos(NULL),
+	mChunkLeft(0),
+	mChunkBytes(0)
+{
+}
+
+LLSDDocument::~LLSDDocument()
+{
+}
+
+void LLSDDocument::clear()
+{
+	mNodes.clear();
+	mChunks.clear();
+	mChunkPos = NULL;
+	mChunkLeft = 0;
+	mChunkBytes = 0;
+	mData.clear();
+	mData.shrink_to_fit();
+}
+
+size_t LLSDDocument::getMemoryUsage() const
+{
+	return mNodes.capacity() * sizeof(Node) + mChunkBytes + mData.capacity();
+}
+
+U32 LLSDDocument::addNode(LLSD::Type type)
+{
+	U32 index = (U32)mNodes.size();
+	mNodes.emplace_back();
+	Node& node = mNodes.back();
+	memset(&node, 0, sizeof(Node));
+	node.mType = (U8)type;
+	node.mEnd = index + 1;
+	return index;
+}
+
+char* LLSDDocument::allocate(size_t size)
+{
+	if (size > CHUNK_SIZE / 4)
+	{
+		mChunks.emplace_back(new char[size]);
+		mChunkBytes += size;
+		return mChunks.back().get();
+	}
+	if (size > mChunkLeft)
+	{
+		mChunks.emplace_back(new char[CHUNK_SIZE]);
+		mChunkBytes += CHUNK_SIZE;
+		mChunkPos = mChunks.back().get();
+		mChunkLeft = CHUNK_SIZE;
+	}
+	char* block = mChunkPos;
+	mChunkPos += size;
+	mChunkLeft -= size;
+	return block;
+}
+
+const char* LLSDDocument::store(const std::string& text)
+{
+	if (text.empty())
+	{
+		return "";
+	}
+	char* block = allocate(text.size());
+	memcpy(block, text.data(), text.size());
+	return block;
+}
+
+bool LLSDDocument::parse(const char* data, size_t size)
+{
+	static const std::string_view BINARY_HEADER("<? llsd/binary ?>");
+	static const std::string_view XML_HEADER("<? llsd/xml ?>");
+
+	auto has_header = [&](std::string_view header)
+	{
+		if (size < header.size())
+		{
+			return false;
+		}
+		std::string start(data, header.size());
+		LLStringUtil::toLower(start);
+		return start == header;
+	};
+	auto skip_header = [&](std::string_view header)
+	{
+		size_t pos = header.size();
+		while (pos < size && isspace((U8)data[pos]))
+		{
+			++pos;
+		}
+		return pos;
+	};
+
+	if (has_header(BINARY_HEADER))
+	{
+		size_t start = skip_header(BINARY_HEADER);
+		return parseBinary(data + start, size - start);
+	}
+	if (has_header(XML_HEADER))
+	{
+		size_t start = skip_header(XML_HEADER);
+		return parseXML(data + start, size - start);
+	}
+
+	size_t start = 0;
+	while (start < size && isspace((U8)data[start]))
+	{
+		++start;
+	}
+	if (start < size && data[start] == '<')
+	{
+		return parseXML(data + start, size - start);
+	}
+	return parseBinary(data, size);
+}
+
+bool LLSDDocument::parse(std::vector<char>&& data)
+{
+	// Moving a vector keeps its buffer, so the nodes stay valid
+	std::vector<char> source(std::move(data));
+	if (!parse(source.data(), source.size()))
+	{
+		return false;
+	}
+	mData = std::move(source);
+	return true;
+}
+
+bool LLSDDocument::parseBinary(const char* data, size_t size)
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_LLSD;
+	clear();
+
+	struct Open
+	{
+		U32 mIndex;
+		U32 mLeft;
+	};
+	std::vector<Open> open;
+	const char* pos = data;
+	const char* const end = data + size;
+	std::string decoded;
+
+	auto fail = [&](const char* what)
+	{
+		LL_INFOS() << "Failed to parse binary LLSD at offset " << (pos - data) << ": " << what << LL_ENDL;
+		clear();
+		return false;
+	};
+	// Reads a 4 byte size and checks that many bytes follow
+	auto read_size = [&](U32& count)
+	{
+		if (end - pos < 4)
+		{
+			return false;
+		}
+		count = read_u32_nbo(pos);
+		pos += 4;
+		return count <= (U32)(end - pos);
+	};
+
+	do
+	{
+		const char* key = NULL;
+		U32 key_size = 0;
+		if (!open.empty())
+		{
+			Open& container = open.back();
+			bool is_map = (mNodes[container.mIndex].mType == LLSD::TypeMap);
+			if (!container.mLeft)
+			{
+				if (pos >= end || *pos++ != (is_map ? '}' : ']'))
+				{
+					return fail("unterminated map or array");
+				}
+				mNodes[container.mIndex].mEnd = (U32)mNodes.size();
+				open.pop_back();
+				continue;
+			}
+			--container.mLeft;
+
+			if (is_map)
+			{
+				if (pos >= end)
+				{
+					return fail("missing map key");
+				}
+				char c = *pos++;
+				if (c == 'k')
+				{
+					if (!read_size(key_size))
+					{
+						return fail("bad map key size");
+					}
+					key = pos;
+					pos += key_size;
+				}
+				else if (c == '\'' || c == '"')
+				{
+					bool escaped = false;
+					if (!read_delimited(pos, end, c, key, key_size, decoded, escaped))
+					{
+						return fail("unterminated map key");
+					}
+					if (escaped)
+					{
+						key = store(decoded);
+						key_size = (U32)decoded.size();
+					}
+				}
+				else
+				{
+					return fail("bad map key");
+				}
+			}
+		}
+
+		if (pos >= end)
+		{
+			return fail("missing value");
+		}
+		U32 index = 0;
+		char c = *pos++;
+		switch (c)
+		{
+		case '!':
+			index = addNode(LLSD::TypeUndefined);
+			break;
+
+		case '0':
+		case '1':
+			index = addNode(LLSD::TypeBoolean);
+			mNodes[index].mBoolean = (c == '1');
+			break;
+
+		case 'i':
+			if (end - pos < 4)
+			{
+				return fail("truncated integer");
+			}
+			index = addNode(LLSD::TypeInteger);
+			mNodes[index].mInteger = (S32)read_u32_nbo(pos);
+			pos += 4;
+			break;
+
+		case 'r':
+			if (end - pos < 8)
+			{
+				return fail("truncated real");
+			}
+			index = addNode(LLSD::TypeReal);
+			mNodes[index].mReal = read_f64_nbo(pos);
+			pos += 8;
+			break;
+
+		case 'd':
+			// Dates are written in host byte order
+			if (end - pos < 8)
+			{
+				return fail("truncated date");
+			}
+			index = addNode(LLSD::TypeDate);
+			memcpy(&mNodes[index].mReal, pos, sizeof(F64));
+			pos += 8;
+			break;
+
+		case 'u':
+			if (end - pos < UUID_BYTES)
+			{
+				return fail("truncated uuid");
+			}
+			index = addNode(LLSD::TypeUUID);
+			memcpy(mNodes[index].mUUID, pos, UUID_BYTES);
+			pos += UUID_BYTES;
+			break;
+
+		case 's':
+		case 'l':
+		case 'b':
+		{
+			U32 length = 0;
+			if (!read_size(length))
+			{
+				return fail("bad string size");
+			}
+			index = addNode(c == 's' ? LLSD::TypeString : (c == 'l' ? LLSD::TypeURI : LLSD::TypeBinary));
+			mNodes[index].mData = pos;
+			mNodes[index].mSize = length;
+			pos += length;
+			break;
+		}
+
+		case '\'':
+		case '"':
+		{
+			const char* text = NULL;
+			U32 length = 0;
+			bool escaped = false;
+			if (!read_delimited(pos, end, c, text, length, decoded, escaped))
+			{
+				return fail("unterminated string");
+			}
+			index = addNode(LLSD::TypeString);
+			if (escaped)
+			{
+				text = store(decoded);
+				length = (U32)decoded.size();
+			}
+			mNodes[index].mData = text;
+			mNodes[index].mSize = length;
+			break;
+		}
+
+		case '{':
+		case '[':
+		{
+			// Every member takes at least a byte, so the count can not be
+			// more than what is left
+			U32 count = 0;
+			if (!read_size(count))
+			{
+				return fail("bad map or array size");
+			}
+			if (open.size() >= MAX_DEPTH)
+			{
+				return fail("too deeply nested");
+			}
+			index = addNode(c == '{' ? LLSD::TypeMap : LLSD::TypeArray);
+			mNodes[index].mSize = count;
+			open.push_back({ index, count });
+			break;
+		}
+
+		default:
+			return fail("unrecognized type");
+		}
+
+		mNodes[index].mKey = key;
+		mNodes[index].mKeySize = key_size;
+	} while (!open.empty());
+
+	return true;
+}
+
+bool LLSDDocument::parseXMLText(XMLCursor& cursor, std::string_view name, const char*& text, U32& size)
+{
+	// Text that needs no decoding is used in place; anything else is
+	// gathered in decoded and stored.
+	const char* start = cursor.mPos;
+	const char* run = start;
+	bool plain = true;
+	std::string decoded;
+	const char*& pos = cursor.mPos;
+	const char* const end = cursor.mEnd;
+
+	while (true)
+	{
+		while (pos < end && *pos != '<' && *pos != '&' && *pos != '\r')
+		{
+			++pos;
+		}
+		if (pos >= end)
+		{
+			return false;
+		}
+		bool closing_tag = (*pos == '<' && !starts_with(pos, end, "<![CDATA[") && !starts_with(pos, end, "<!--"));
+		if (closing_tag)
+		{
+			if (plain)
+			{
+				text = start;
+				size = (U32)(pos - start);
+			}
+			else
+			{
+				decoded.append(run, pos);
+				text = store(decoded);
+				size = (U32)decoded.size();
+			}
+			std::string_view tag;
+			bool closing = false;
+			bool empty = false;
+			return cursor.readTag(tag, closing, empty) && closing && tag == name;
+		}
+
+		plain = false;
+		decoded.append(run, pos);
+		if (*pos == '\r')
+		{
+			// XML line ends read as a single '\n'
+			decoded.push_back('\n');
+			++pos;
+			if (pos < end && *pos == '\n')
+			{
+				++pos;
+			}
+		}
+		else if (*pos == '&')
+		{
+			std::string_view rest(pos, end - pos);
+			size_t semi = rest.find(';');
+			if (semi == std::string_view::npos || semi < 2)
+			{
+				return false;
+			}
+			std::string_view entity = rest.substr(1, semi - 1);
+			if (entity == "lt") decoded.push_back('<');
+			else if (entity == "gt") decoded.push_back('>');
+			else if (entity == "amp") decoded.push_back('&');
+			else if (entity == "quot") decoded.push_back('"');
+			else if (entity == "apos") decoded.push_back('\'');
+			else if (entity[0] == '#')
+			{
+				std::string digits(entity.substr(1));
+				int base = 10;
+				if (!digits.empty() && (digits[0] == 'x' || digits[0] == 'X'))
+				{
+					digits.erase(0, 1);
+					base = 16;
+				}
+				char* digits_end = NULL;
+				unsigned long code = strtoul(digits.c_str(), &digits_end, base);
+				if (digits.empty() || *digits_end || code > 0x10FFFF)
+				{
+					return false;
+				}
+				append_utf8(decoded, (U32)code);
+			}
+			else
+			{
+				return false;
+			}
+			pos += semi + 1;
+		}
+		else if (starts_with(pos, end, "<![CDATA["))
+		{
+			pos += 9;
+			std::string_view rest(pos, end - pos);
+			size_t close = rest.find("]]>");
+			if (close == std::string_view::npos)
+			{
+				return false;
+			}
+			decoded.append(pos, close);
+			pos += close + 3;
+		}
+		else if (!cursor.skipPast("-->"))
+		{
+			return false;
+		}
+		run = pos;
+	}
+}
+
+bool LLSDDocument::parseXML(const char* data, size_t size)
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_LLSD;
+	clear();
+
+	XMLCursor cursor = { data, data + size };
+	std::vector<U32> open;
+	std::string_view name;
+	bool closing = false;
+	bool empty = false;
+
+	auto fail = [&](const char* what)
+	{
+		LL_INFOS() << "Failed to parse LLSD XML at offset " << (cursor.mPos - data) << ": " << what << LL_ENDL;
+		clear();
+		return false;
+	};
+
+	if (!cursor.readTag(name, closing, empty) || closing || name != "llsd")
+	{
+		return fail("missing <llsd> element");
+	}
+	if (empty)
+	{
+		addNode(LLSD::TypeUndefined);
+		return true;
+	}
+
+	while (true)
+	{
+		if (!cursor.readTag(name, closing, empty))
+		{
+			return fail("bad tag");
+		}
+
+		if (closing)
+		{
+			if (open.empty())
+			{
+				if (name != "llsd")
+				{
+					return fail("mismatched </llsd>");
+				}
+				if (mNodes.empty())
+				{
+					addNode(LLSD::TypeUndefined);
+				}
+				return true;
+			}
+			Node& container = mNodes[open.back()];
+			if (name != (container.mType == LLSD::TypeMap ? "map" : "array"))
+			{
+				return fail("mismatched closing tag");
+			}
+			container.mEnd = (U32)mNodes.size();
+			open.pop_back();
+			continue;
+		}
+
+		if (open.empty() && !mNodes.empty())
+		{
+			return fail("more than one top level value");
+		}
+
+		const char* key = NULL;
+		U32 key_size = 0;
+		if (!open.empty() && mNodes[open.back()].mType == LLSD::TypeMap)
+		{
+			if (name != "key")
+			{
+				return fail("expected <key>");
+			}
+			if (empty)
+			{
+				key = "";
+			}
+			else if (!parseXMLText(cursor, "key", key, key_size))
+			{
+				return fail("bad <key>");
+			}
+			if (!cursor.readTag(name, closing, empty) || closing)
+			{
+				return fail("missing map value");
+			}
+		}
+
+		LLSD::Type type;
+		if (name == "map") type = LLSD::TypeMap;
+		else if (name == "array") type = LLSD::TypeArray;
+		else if (name == "undef") type = LLSD::TypeUndefined;
+		else if (name == "boolean") type = LLSD::TypeBoolean;
+		else if (name == "integer") type = LLSD::TypeInteger;
+		else if (name == "real") type = LLSD::TypeReal;
+		else if (name == "uuid") type = LLSD::TypeUUID;
+		else if (name == "string") type = LLSD::TypeString;
+		else if (name == "date") type = LLSD::TypeDate;
+		else if (name == "uri") type = LLSD::TypeURI;
+		else if (name == "binary") type = LLSD::TypeBinary;
+		else
+		{
+			return fail("unknown element");
+		}
+
+		if (!open.empty())
+		{
+			++mNodes[open.back()].mSize;
+		}
+
+		if (type == LLSD::TypeMap || type == LLSD::TypeArray)
+		{
+			U32 index = addNode(type);
+			mNodes[index].mKey = key;
+			mNodes[index].mKeySize = key_size;
+			if (!empty)
+			{
+				if (open.size() >= MAX_DEPTH)
+				{
+					return fail("too deeply nested");
+				}
+				open.push_back(index);
+			}
+			continue;
+		}
+
+		const char* text = "";
+		U32 length = 0;
+		if (!empty && !parseXMLText(cursor, name, text, length))
+		{
+			return fail("bad value");
+		}
+		std::string_view value(text, length);
+
+		U32 index = addNode(type);
+		Node& node = mNodes[index];
+		node.mKey = key;
+		node.mKeySize = key_size;
+		switch (type)
+		{
+		case LLSD::TypeBoolean:
+			node.mBoolean = (value == "true" || value == "1");
+			break;
+
+		case LLSD::TypeInteger:
+		{
+			// Same as LLSDXMLParser: sscanf first, the LLSD string rules if
+			// that fails
+			char buffer[64];
+			size_t count = llmin(value.size(), sizeof(buffer) - 1);
+			memcpy(buffer, value.data(), count);
+			buffer[count] = '\0';
+			S32 i;
+			if (count < sizeof(buffer) - 1 && sscanf(buffer, "%d", &i) == 1)
+			{
+				node.mInteger = i;
+			}
+			else
+			{
+				node.mInteger = LLSD(std::string(value)).asInteger();
+			}
+			break;
+		}
+
+		case LLSD::TypeReal:
+			node.mReal = LLSD(std::string(value)).asReal();
+			break;
+
+		case LLSD::TypeUUID:
+			memcpy(node.mUUID, LLUUID(value).mData, UUID_BYTES);
+			break;
+
+		case LLSD::TypeDate:
+			node.mReal = LLDate(std::string(value)).secondsSinceEpoch();
+			break;
+
+		case LLSD::TypeString:
+		case LLSD::TypeURI:
+			node.mData = text;
+			node.mSize = length;
+			break;
+
+		case LLSD::TypeBinary:
+		{
+			// Base64 written by other tools may be broken over lines
+			std::string stripped;
+			stripped.reserve(value.size());
+			for (char c : value)
+			{
+				if (!isspace((U8)c))
+				{
+					stripped.push_back(c);
+				}
+			}
+			int decoded_size = apr_base64_decode_len(stripped.c_str());
+			char* block = decoded_size > 0 ? allocate(decoded_size) : NULL;
+			decoded_size = block ? apr_base64_decode_binary((unsigned char*)block, stripped.c_str()) : 0;
+			node.mData = block ? block : "";
+			node.mSize = (U32)llmax(decoded_size, 0);
+			break;
+		}
+
+		default:
+			break;
+		}
+	}
+}
+
+LLSDDocument::Value LLSDDocument::root() const
+{
+	if (mNodes.empty())
+	{
+		return Value();
+	}
+	return Value(this, 0, (U32)mNodes.size());
+}
+
+LLSD LLSDDocument::toLLSD() const
+{
+	return mNodes.empty() ? LLSD() : toLLSD(0);
+}
+
+LLSD LLSDDocument::toLLSD(U32 index) const
+{
+	const Node& node = mNodes[index];
+	switch (node.mType)
+	{
+	case LLSD::TypeBoolean:
+		return LLSD(node.mBoolean);
+	case LLSD::TypeInteger:
+		return LLSD(node.mInteger);
+	case LLSD::TypeReal:
+		return LLSD(node.mReal);
+	case LLSD::TypeDate:
+		return LLSD(LLDate(node.mReal));
+	case LLSD::TypeUUID:
+	{
+		LLUUID id;
+		memcpy(id.mData, node.mUUID, UUID_BYTES);
+		return LLSD(id);
+	}
+	case LLSD::TypeString:
+		return LLSD(std::string(node.mData, node.mSize));
+	case LLSD::TypeURI:
+		return LLSD(LLURI(std::string(node.mData, node.mSize)));
+	case LLSD::TypeBinary:
+	{
+		const U8* bytes = reinterpret_cast<const U8*>(node.mData);
+		return LLSD(LLSD::Binary(bytes, bytes + node.mSize));
+	}
+	case LLSD::TypeMap:
+	{
+		LLSD map = LLSD::emptyMap();
+		for (U32 child = index + 1; child < node.mEnd; child = mNodes[child].mEnd)
+		{
+			const Node& member = mNodes[child];
+			std::string_view key(member.mKey ? member.mKey : "", member.mKeySize);
+			// insert() keeps the first of duplicate keys, like the parsers
+			map.insert(key, toLLSD(child));
+		}
+		return map;
+	}
+	case LLSD::TypeArray:
+	{
+		LLSD array = LLSD::emptyArray();
+		for (U32 child = index + 1; child < node.mEnd; child = mNodes[child].mEnd)
+		{
+			array.append(toLLSD(child));
+		}
+		return array;
+	}
+	default:
+		return LLSD();
+	}
+}
+
+//
+// LLSDDocument::Value
+//
+
+LLSD::Type LLSDDocument::Value::type() const
+{
+	return mDocument ? (LLSD::Type)mDocument->mNodes[mIndex].mType : LLSD::TypeUndefined;
+}
+
+LLSD::Boolean LLSDDocument::Value::asBoolean() const
+{
+	return type() == LLSD::TypeBoolean ? mDocument->mNodes[mIndex].mBoolean : toLLSD().asBoolean();
+}
+
+LLSD::Integer LLSDDocument::Value::asInteger() const
+{
+	return type() == LLSD::TypeInteger ? mDocument->mNodes[mIndex].mInteger : toLLSD().asInteger();
+}
+
+LLSD::Real LLSDDocument::Value::asReal() const
+{
+	return type() == LLSD::TypeReal ? mDocument->mNodes[mIndex].mReal : toLLSD().asReal();
+}
+
+LLSD::UUID LLSDDocument::Value::asUUID() const
+{
+	if (type() != LLSD::TypeUUID)
+	{
+		return toLLSD().asUUID();
+	}
+	LLUUID id;
+	memcpy(id.mData, mDocument->mNodes[mIndex].mUUID, UUID_BYTES);
+	return id;
+}
+
+LLSD::Date LLSDDocument::Value::asDate() const
+{
+	return type() == LLSD::TypeDate ? LLDate(mDocument->mNodes[mIndex].mReal) : toLLSD().asDate();
+}
+
+LLSD::URI LLSDDocument::Value::asURI() const
+{
+	LLSD::Type value_type = type();
+	if (value_type == LLSD::TypeURI || value_type == LLSD::TypeString)
+	{
+		return LLURI(std::string(asStringView()));
+	}
+	return toLLSD().asURI();
+}
+
+LLSD::String LLSDDocument::Value::asString() const
+{
+	LLSD::Type value_type = type();
+	if (value_type == LLSD::TypeString || value_type == LLSD::TypeURI)
+	{
+		return std::string(asStringView());
+	}
+	return toLLSD().asString();
+}
+
+LLSD::Binary LLSDDocument::Value::asBinary() const
+{
+	if (type() != LLSD::TypeBinary)
+	{
+		return toLLSD().asBinary();
+	}
+	const U8* bytes = reinterpret_cast<const U8*>(mDocument->mNodes[mIndex].mData);
+	return LLSD::Binary(bytes, bytes + mDocument->mNodes[mIndex].mSize);
+}
+
+std::string_view LLSDDocument::Value::asStringView() const
+{
+	LLSD::Type value_type = type();
+	if (value_type != LLSD::TypeString && value_type != LLSD::TypeURI && value_type != LLSD::TypeBinary)
+	{
+		return std::string_view();
+	}
+	const Node& node = mDocument->mNodes[mIndex];
+	return std::string_view(node.mData, node.mSize);
+}
+
+size_t LLSDDocument::Value::size() const
+{
+	return (isMap() || isArray()) ? mDocument->mNodes[mIndex].mSize : 0;
+}
+
+std::string_view LLSDDocument::Value::key() const
+{
+	if (!mDocument || !mDocument->mNodes[mIndex].mKey)
+	{
+		return std::string_view();
+	}
+	const Node& node = mDocument->mNodes[mIndex];
+	return std::string_view(node.mKey, node.mKeySize);
+}
+
+LLSDDocument::Value LLSDDocument::Value::get(std::string_view name) const
+{
+	if (!isMap())
+	{
+		return Value();
+	}
+	for (Value member = first(); member; member = member.next())
+	{
+		if (member.key() == name)
+		{
+			return member;
+		}
+	}
+	return Value();
+}
+
+LLSDDocument::Value LLSDDocument::Value::at(size_t i) const
+{
+	if (i >= size())
+	{
+		return Value();
+	}
+	Value member = first();
+	while (i--)
+	{
+		member = member.next();
+	}
+	return member;
+}
+
+LLSDDocument::Value LLSDDocument::Value::first() const
+{
+	if (!size())
+	{
+		return Value();
+	}
+	return Value(mDocument, mIndex + 1, mDocument->mNodes[mIndex].mEnd);
+}
+
+LLSDDocument::Value LLSDDocument::Value::next() const
+{
+	if (!mDocument)
+	{
+		return Value();
+	}
+	U32 sibling = mDocument->mNodes[mIndex].mEnd;
+	if (sibling >= mParentEnd)
+	{
+		return Value();
+	}
+	return Value(mDocument, sibling, mParentEnd);
+}
+
+LLSD LLSDDocument::Value::toLLSD() const
+{
+	return mDocument ? mDocument->toLLSD(mIndex) : LLSD();
+}
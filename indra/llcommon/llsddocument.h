@@ -0,0 +1,197 @@
+/**
+ * @file llsddocument.h
+ * @brief Read only LLSD document parsed into one flat buffer of nodes.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLSDDOCUMENT_H
+#define LL_LLSDDOCUMENT_H
+
+#include "llsd.h"
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+/**
+ * @class LLSDDocument
+ * @brief Binary or XML LLSD, parsed without building an LLSD tree.
+ *
+ * Every value becomes one fixed size node in a single vector, in document
+ * order, and each node knows where its subtree ends so siblings can be
+ * skipped over. Strings, URIs, binaries and map keys are not copied: they
+ * point into the parsed buffer. Only text that needs decoding (escapes,
+ * XML entities, base64) is copied, into chunks owned by the document.
+ *
+ * This makes parsing large payloads a few big allocations instead of one
+ * or more per value, and lets callers pick out what they need. Anything
+ * that wants an LLSD can get one for the whole document or any value with
+ * toLLSD().
+ *
+ * Only the binary and XML formats are supported; use LLSDSerialize for
+ * notation.
+ */
+class LL_COMMON_API LLSDDocument
+{
+	LOG_CLASS(LLSDDocument);
+public:
+	class Value;
+
+	LLSDDocument();
+	~LLSDDocument();
+	LLSDDocument(LLSDDocument&&) = default;
+	LLSDDocument& operator=(LLSDDocument&&) = default;
+	LLSDDocument(const LLSDDocument&) = delete;
+	LLSDDocument& operator=(const LLSDDocument&) = delete;
+
+	/**
+	 * @brief Parses binary or XML LLSD, as told apart by LLSDSerialize.
+	 *
+	 * A "<? LLSD/Binary ?>" or "<? LLSD/XML ?>" header picks the format.
+	 * Without one, data starting with '<' is XML and anything else is
+	 * binary. The data is not copied and must outlive the document.
+	 * @return Returns false, and leaves the document empty, on error.
+	 */
+	bool parse(const char* data, size_t size);
+	/// Same as above, with the document keeping data.
+	bool parse(std::vector<char>&& data);
+
+	/// Parses binary LLSD without a header.
+	bool parseBinary(const char* data, size_t size);
+	/// Parses the <llsd> element of an XML document.
+	bool parseXML(const char* data, size_t size);
+
+	void clear();
+	bool isEmpty() const { return mNodes.empty(); }
+
+	/// The top level value, undefined if the document is empty.
+	Value root() const;
+	/// Converts the whole document.
+	LLSD toLLSD() const;
+
+	size_t getNumNodes() const { return mNodes.size(); }
+	/// Bytes allocated by the document, counting the parsed data if it
+	/// keeps it.
+	size_t getMemoryUsage() const;
+
+	/**
+	 * @class Value
+	 * @brief Handle to one value of a document, valid as long as it is.
+	 *
+	 * Accessors of the value's own type are direct reads; any other
+	 * conversion goes through toLLSD() and follows the LLSD rules.
+	 */
+	class LL_COMMON_API Value
+	{
+	public:
+		Value() : mDocument(NULL), mIndex(0), mParentEnd(0) {}
+
+		LLSD::Type type() const;
+		bool isUndefined() const { return type() == LLSD::TypeUndefined; }
+		bool isDefined() const { return type() != LLSD::TypeUndefined; }
+		bool isMap() const { return type() == LLSD::TypeMap; }
+		bool isArray() const { return type() == LLSD::TypeArray; }
+		bool isString() const { return type() == LLSD::TypeString; }
+
+		LLSD::Boolean asBoolean() const;
+		LLSD::Integer asInteger() const;
+		LLSD::Real asReal() const;
+		LLSD::UUID asUUID() const;
+		LLSD::Date asDate() const;
+		LLSD::URI asURI() const;
+		LLSD::String asString() const;
+		LLSD::Binary asBinary() const;
+		/// Bytes of a string, URI or binary, without copying them.
+		std::string_view asStringView() const;
+
+		/// Number of members of a map or array, 0 for anything else.
+		size_t size() const;
+		/// Name of this value in the map holding it, empty otherwise.
+		std::string_view key() const;
+
+		/// First member named key of a map, undefined if none.
+		Value get(std::string_view key) const;
+		bool has(std::string_view key) const { return get(key).isDefined(); }
+		/// Member i of an array or map, in document order; linear time.
+		Value at(size_t i) const;
+
+		/// Walks the members of a map or array:
+		/// for (Value v = map.first(); v; v = v.next()) ...
+		Value first() const;
+		Value next() const;
+
+		explicit operator bool() const { return mDocument != NULL; }
+
+		LLSD toLLSD() const;
+
+	private:
+		friend class LLSDDocument;
+		Value(const LLSDDocument* document, U32 index, U32 parent_end)
+		:	mDocument(document), mIndex(index), mParentEnd(parent_end) {}
+
+		const LLSDDocument* mDocument;
+		U32 mIndex;
+		// End of the container holding this value, where next() stops
+		U32 mParentEnd;
+	};
+
+	/// Maps and arrays nested deeper than this are refused, so that
+	/// converting a document can not run out of stack.
+	static const U32 MAX_DEPTH = 1024;
+
+private:
+	struct Node
+	{
+		const char* mKey;		// name in the enclosing map, or NULL
+		U32 mKeySize;
+		U32 mEnd;				// index of the first node past this subtree
+		U32 mSize;				// members of a map or array, bytes of a string, URI or binary
+		U8 mType;				// LLSD::Type
+		union
+		{
+			LLSD::Boolean mBoolean;
+			LLSD::Integer mInteger;
+			LLSD::Real mReal;	// also seconds since epoch of a date
+			const char* mData;	// string, URI or binary
+			U8 mUUID[UUID_BYTES];
+		};
+	};
+
+	struct XMLCursor;
+
+	U32 addNode(LLSD::Type type);
+	char* allocate(size_t size);
+	const char* store(const std::string& text);
+	bool parseXMLText(XMLCursor& cursor, std::string_view name, const char*& text, U32& size);
+	LLSD toLLSD(U32 index) const;
+
+	std::vector<Node> mNodes;
+	// Decoded text, in chunks that never move once allocated
+	std::vector<std::unique_ptr<char[]>> mChunks;
+	char* mChunkPos;
+	size_t mChunkLeft;
+	size_t mChunkBytes;
+	// Set when the document keeps the data it parsed
+	std::vector<char> mData;
+};
+
+#endif // LL_LLSDDOCUMENT_H
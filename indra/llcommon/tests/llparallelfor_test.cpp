@@ -0,0 +1,162 @@
+/**
+ * @file   llparallelfor_test.cpp
+ * @brief  Test for LL::parallelFor().
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+// Precompiled header
+#include "linden_common.h"
+// associated header
+#include "llparallelfor.h"
+// STL headers
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+// other Linden headers
+#include "stringize.h"
+#include "workqueue.h"
+#include "../test/lltut.h"
+
+using namespace LL;
+
+/*****************************************************************************
+*   TUT
+*****************************************************************************/
+namespace tut
+{
+    struct llparallelfor_data
+    {
+        // every index in [0, count) is visited exactly once
+        static bool coversOnce(const std::vector<std::atomic<S32>>& visits)
+        {
+            for (const auto& visit : visits)
+            {
+                if (visit.load() != 1)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+    typedef test_group<llparallelfor_data> llparallelfor_group;
+    typedef llparallelfor_group::object object;
+    llparallelfor_group llparallelforgrp("llparallelfor");
+
+    template<> template<>
+    void object::test<1>()
+    {
+        set_test_name("no queue");
+        // with no such queue everything runs on the calling thread
+        std::vector<std::atomic<S32>> visits(1000);
+        std::thread::id caller = std::this_thread::get_id();
+        bool other_thread = false;
+        parallelFor("NoSuchQueue", visits.size(), 64,
+                    [&](size_t begin, size_t end)
+                    {
+                        other_thread |= std::this_thread::get_id() != caller;
+                        for (size_t i = begin; i < end; ++i)
+                        {
+                            ++visits[i];
+                        }
+                    });
+        ensure("covered", coversOnce(visits));
+        ensure("ran inline", ! other_thread);
+
+        S32 calls = 0;
+        parallelFor("NoSuchQueue", 0, 64, [&calls](size_t, size_t){ ++calls; });
+        ensure_equals("empty range", calls, 0);
+        parallelFor("NoSuchQueue", 10, 0, [&calls](size_t begin, size_t end){ calls += S32(end - begin); });
+        ensure_equals("zero grain", calls, 10);
+    }
+
+    template<> template<>
+    void object::test<2>()
+    {
+        set_test_name("consumers");
+        WorkQueue queue("ParallelForTest");
+        std::vector<std::thread> consumers;
+        for (S32 i = 0; i < 3; ++i)
+        {
+            consumers.emplace_back([&queue](){ queue.runUntilClose(); });
+        }
+
+        for (size_t count : { size_t(1), size_t(63), size_t(64), size_t(65), size_t(10000) })
+        {
+            std::vector<std::atomic<S32>> visits(count);
+            parallelFor("ParallelForTest", count, 64,
+                        [&visits](size_t begin, size_t end)
+                        {
+                            for (size_t i = begin; i < end; ++i)
+                            {
+                                ++visits[i];
+                            }
+                        });
+            ensure(STRINGIZE("covered " << count), coversOnce(visits));
+        }
+
+        queue.close();
+        for (auto& consumer : consumers)
+        {
+            consumer.join();
+        }
+
+        // a closed queue takes no helpers, the caller does it all
+        std::vector<std::atomic<S32>> visits(500);
+        parallelFor("ParallelForTest", visits.size(), 16,
+                    [&visits](size_t begin, size_t end)
+                    {
+                        for (size_t i = begin; i < end; ++i)
+                        {
+                            ++visits[i];
+                        }
+                    });
+        ensure("covered after close", coversOnce(visits));
+    }
+
+    template<> template<>
+    void object::test<3>()
+    {
+        set_test_name("exception");
+        bool caught = false;
+        std::atomic<S32> chunks{ 0 };
+        try
+        {
+            parallelFor("NoSuchQueue", 100, 10,
+                        [&chunks](size_t begin, size_t)
+                        {
+                            ++chunks;
+                            if (begin == 30)
+                            {
+                                throw std::runtime_error("chunk");
+                            }
+                        });
+        }
+        catch (const std::runtime_error&)
+        {
+            caught = true;
+        }
+        ensure("rethrown", caught);
+        ensure_equals("stopped at the throw", chunks.load(), 4);
+    }
+} // namespace tut
@@ -0,0 +1,362 @@
+/**
+ * @file llsddocument_test.cpp
+ * @brief LLSDDocument unit tests and parse benchmark
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llsddocument.h"
+
+#include "lldate.h"
+#include "llmemory.h"
+#include "llsdserialize.h"
+#include "llsdutil.h"
+#include "llstring.h"
+#include "lluri.h"
+#include "stringize.h"
+
+#include "../test/lltut.h"
+
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+	LLSD make_sample()
+	{
+		LLSD sd;
+		sd["undef"] = LLSD();
+		sd["true"] = true;
+		sd["false"] = false;
+		sd["integer"] = -12345;
+		sd["real"] = 3.25;
+		sd["uuid"] = LLUUID("d7f4aeca-88f1-42a1-b385-b9db18abb255");
+		sd["date"] = LLDate(1700000000.5);
+		sd["uri"] = LLURI("http://example.com/a?b=c&d=e");
+		sd["string"] = "plain";
+		sd["markup"] = "<tag attr=\"1\">&amp; 'quoted'</tag>";
+		sd["empty"] = "";
+		sd["binary"] = LLSD::Binary({ 0, 1, 2, 0xfe, 0xff });
+		sd["empty map"] = LLSD::emptyMap();
+		sd["empty array"] = LLSD::emptyArray();
+		for (S32 i = 0; i < 4; ++i)
+		{
+			LLSD item;
+			item["index"] = i;
+			item["name"] = llformat("item %d", i);
+			item["values"].append(i * 0.5);
+			item["values"].append(LLSD::emptyArray());
+			sd["items"].append(item);
+		}
+		return sd;
+	}
+
+	std::string to_binary(const LLSD& sd)
+	{
+		std::ostringstream str;
+		LLSDSerialize::toBinary(sd, str);
+		return str.str();
+	}
+
+	std::string to_xml(const LLSD& sd)
+	{
+		std::ostringstream str;
+		LLSDSerialize::toXML(sd, str);
+		return str.str();
+	}
+}
+
+namespace tut
+{
+	struct sddocument_data
+	{
+	};
+	typedef test_group<sddocument_data> sddocument_test;
+	typedef sddocument_test::object sddocument_object;
+	tut::sddocument_test sddocument("LLSDDocument");
+
+	template<> template<>
+	void sddocument_object::test<1>()
+	{
+		set_test_name("binary round trip");
+
+		LLSD sd = make_sample();
+		std::string data = to_binary(sd);
+		LLSDDocument doc;
+		ensure("parsed", doc.parseBinary(data.data(), data.size()));
+		ensure("same as LLSD", llsd_equals(doc.toLLSD(), sd));
+
+		LLSDDocument::Value root = doc.root();
+		ensure("map", root.isMap());
+		ensure_equals("map size", root.size(), (size_t)sd.size());
+		ensure_equals("integer", root.get("integer").asInteger(), -12345);
+		ensure_equals("real", root.get("real").asReal(), 3.25);
+		ensure_equals("uuid", root.get("uuid").asUUID(), sd["uuid"].asUUID());
+		ensure("true", root.get("true").asBoolean());
+		ensure("missing", !root.has("missing"));
+		ensure_equals("date", root.get("date").asDate().secondsSinceEpoch(), 1700000000.5);
+
+		// Strings point into the data instead of being copied
+		std::string_view string = root.get("string").asStringView();
+		ensure_equals("string", std::string(string), "plain");
+		ensure("string in place", string.data() >= data.data() && string.data() < data.data() + data.size());
+
+		LLSDDocument::Value items = root.get("items");
+		ensure_equals("array size", items.size(), (size_t)4);
+		ensure_equals("at", items.at(2).get("name").asString(), "item 2");
+		ensure("past the end", !items.at(4));
+		S32 count = 0;
+		for (LLSDDocument::Value item = items.first(); item; item = item.next())
+		{
+			ensure_equals("walk", item.get("index").asInteger(), count++);
+		}
+		ensure_equals("walked", count, 4);
+		ensure("subtree", llsd_equals(items.at(1).toLLSD(), sd["items"][1]));
+
+		// Conversions to other types follow LLSD
+		ensure_equals("integer as string", root.get("integer").asString(), "-12345");
+		ensure_equals("real as integer", root.get("real").asInteger(), 3);
+	}
+
+	template<> template<>
+	void sddocument_object::test<2>()
+	{
+		set_test_name("XML round trip");
+
+		LLSD sd = make_sample();
+		std::string data = to_xml(sd);
+		LLSDDocument doc;
+		ensure("parsed", doc.parseXML(data.data(), data.size()));
+		ensure("same as LLSD", llsd_equals(doc.toLLSD(), sd));
+		ensure_equals("entities", doc.root().get("markup").asString(), sd["markup"].asString());
+		ensure_equals("binary", doc.root().get("binary").asBinary().size(), (size_t)5);
+
+		std::string pretty;
+		{
+			std::ostringstream str;
+			LLSDSerialize::toPrettyXML(sd, str);
+			pretty = str.str();
+		}
+		ensure("parsed pretty", doc.parseXML(pretty.data(), pretty.size()));
+		ensure("same as LLSD pretty", llsd_equals(doc.toLLSD(), sd));
+
+		std::string text =
+			"<?xml version=\"1.0\" ?>\r\n"
+			"<!-- comment -->\r\n"
+			"<llsd><map>\r\n"
+			"<key>a&#x41;</key><string>line\r\nnext <![CDATA[<raw>]]></string>\r\n"
+			"<key>b</key><undef />\r\n"
+			"<key>c</key><array><integer>7</integer><real>1.5</real><boolean>1</boolean></array>\r\n"
+			"</map></llsd>";
+		ensure("parsed text", doc.parse(text.data(), text.size()));
+		ensure_equals("char reference", std::string(doc.root().first().key()), "aA");
+		ensure_equals("line ends and cdata", doc.root().get("aA").asString(), "line\nnext <raw>");
+		ensure("undef", doc.root().get("b").isUndefined());
+		ensure_equals("array", doc.root().get("c").size(), (size_t)3);
+		LLSD expected;
+		std::istringstream str(text);
+		ensure("LLSDSerialize parsed", LLSDSerialize::fromXML(expected, str) > 0);
+		ensure("same as LLSDSerialize", llsd_equals(doc.toLLSD(), expected));
+	}
+
+	template<> template<>
+	void sddocument_object::test<3>()
+	{
+		set_test_name("headers and notation strings");
+
+		LLSD sd = make_sample();
+		LLSDDocument doc;
+		{
+			std::ostringstream str;
+			LLSDSerialize::serialize(sd, str, LLSDSerialize::LLSD_BINARY);
+			std::string data = str.str();
+			std::vector<char> buffer(data.begin(), data.end());
+			ensure("binary header", doc.parse(std::move(buffer)));
+			ensure("binary", llsd_equals(doc.toLLSD(), sd));
+		}
+		{
+			std::ostringstream str;
+			LLSDSerialize::serialize(sd, str, LLSDSerialize::LLSD_XML);
+			std::string data = str.str();
+			ensure("xml header", doc.parse(data.data(), data.size()));
+			ensure("xml", llsd_equals(doc.toLLSD(), sd));
+		}
+
+		// Binary strings and keys may be written the notation way
+		static const char data[] = "{\0\0\0\2'k\\x41'\"a\\nb\"k\0\0\0\1z!}";
+		size_t size = sizeof(data) - 1;
+		ensure("notation strings", doc.parseBinary(data, size));
+		LLSD expected;
+		std::istringstream str(std::string(data, size));
+		ensure("LLSDSerialize parsed", LLSDSerialize::fromBinary(expected, str, size) > 0);
+		ensure("same as LLSDSerialize", llsd_equals(doc.toLLSD(), expected));
+		ensure_equals("unescaped", doc.root().get("kA").asString(), "a\nb");
+	}
+
+	template<> template<>
+	void sddocument_object::test<4>()
+	{
+		set_test_name("malformed input");
+
+		std::string data = to_binary(make_sample());
+		LLSDDocument doc;
+		for (size_t size : { (size_t)0, (size_t)1, data.size() / 2, data.size() - 1 })
+		{
+			ensure(STRINGIZE("truncated binary " << size), !doc.parseBinary(data.data(), size));
+			ensure("left empty", doc.isEmpty() && !doc.root());
+		}
+
+		// A count bigger than what follows is refused before anything is
+		// allocated for it
+		static const char huge[] = "[\x7f\xff\xff\xff!]";
+		ensure("huge count", !doc.parseBinary(huge, sizeof(huge) - 1));
+
+		std::string deep("<llsd>");
+		std::string nested;
+		for (U32 i = 0; i <= LLSDDocument::MAX_DEPTH; ++i)
+		{
+			deep.append("<array>");
+			nested.append("[\0\0\0\1", 5);
+		}
+		nested.append("!");
+		for (U32 i = 0; i <= LLSDDocument::MAX_DEPTH; ++i)
+		{
+			deep.append("</array>");
+			nested.append("]");
+		}
+		deep.append("</llsd>");
+		ensure("too deep", !doc.parseXML(deep.data(), deep.size()));
+		ensure("too deep binary", !doc.parseBinary(nested.data(), nested.size()));
+
+		for (const char* xml : { "<llsd><map><string>a</string></map></llsd>",
+								 "<llsd><array></map></llsd>",
+								 "<llsd><integer>1</integer><integer>2</integer></llsd>",
+								 "<llsd><string>&bogus;</string></llsd>",
+								 "<llsd><string>open",
+								 "<notllsd/>" })
+		{
+			ensure(STRINGIZE("bad xml " << xml), !doc.parseXML(xml, strlen(xml)));
+		}
+		static const char empty[] = "<llsd/>";
+		ensure("empty llsd", doc.parseXML(empty, sizeof(empty) - 1));
+		ensure("undefined root", doc.root().isUndefined() && doc.toLLSD().isUndefined());
+	}
+
+	template<> template<>
+	void sddocument_object::test<5>()
+	{
+		set_test_name("parse benchmark");
+
+		// Parsing payloads of several megabytes takes a while, so this only
+		// runs on request, e.g. LL_SDDOCUMENT_BENCH_MB=4,16
+		std::string sizes = LLStringUtil::getenv("LL_SDDOCUMENT_BENCH_MB");
+		if (sizes.empty())
+		{
+			skip("set LL_SDDOCUMENT_BENCH_MB to run");
+		}
+
+		typedef std::chrono::high_resolution_clock clock_t;
+		auto ms = [](clock_t::time_point start)
+		{
+			return std::chrono::duration_cast<std::chrono::microseconds>(clock_t::now() - start).count() / 1000.0;
+		};
+		// Peak RSS only grows, so the document, which should need less, is
+		// measured first and the LLSD figure is how much further it went.
+		auto peak_kb = []() { return (S64)(LLMemory::getCurrentRSS() / 1024); };
+
+		std::vector<std::string> counts;
+		LLStringUtil::getTokens(sizes, counts, ",");
+		for (const std::string& count_str : counts)
+		{
+			const size_t target = (size_t)std::stoul(count_str) * 1024 * 1024;
+
+			// Shaped like an inventory or object properties payload
+			LLSD sd = LLSD::emptyArray();
+			size_t item_size = 0;
+			for (S32 i = 0; (size_t)sd.size() * item_size < target; ++i)
+			{
+				LLSD item;
+				item["item_id"] = LLUUID::generateNewID();
+				item["parent_id"] = LLUUID::generateNewID();
+				item["name"] = llformat("Object number %d", i);
+				item["desc"] = "A description of some length that is not too short";
+				item["type"] = i % 20;
+				item["flags"] = i * 7;
+				item["created_at"] = LLDate(1700000000.0 + i);
+				item["scale"] = i * 0.25;
+				LLSD permissions;
+				permissions["owner_mask"] = 0x7fffffff;
+				permissions["everyone_mask"] = 0;
+				item["permissions"] = permissions;
+				sd.append(item);
+				if (!item_size)
+				{
+					item_size = to_binary(item).size();
+				}
+			}
+			std::string binary = to_binary(sd);
+			std::string xml = to_xml(sd);
+
+			for (S32 format = 0; format < 2; ++format)
+			{
+				const std::string& data = format ? xml : binary;
+
+				S64 base = peak_kb();
+				clock_t::time_point start = clock_t::now();
+				LLSDDocument doc;
+				bool parsed = format ? doc.parseXML(data.data(), data.size()) : doc.parseBinary(data.data(), data.size());
+				double doc_ms = ms(start);
+				S64 doc_kb = peak_kb() - base;
+				ensure("document parsed", parsed);
+
+				base = peak_kb();
+				start = clock_t::now();
+				LLSD parsed_sd;
+				std::istringstream str(data);
+				if (format)
+				{
+					LLSDSerialize::fromXML(parsed_sd, str);
+				}
+				else
+				{
+					LLSDSerialize::fromBinary(parsed_sd, str, data.size());
+				}
+				double sd_ms = ms(start);
+				S64 sd_kb = peak_kb() - base;
+
+				start = clock_t::now();
+				LLSD converted = doc.toLLSD();
+				double convert_ms = ms(start);
+				ensure("same result", llsd_equals(converted, parsed_sd));
+
+				std::cout << "\n" << (format ? "XML" : "binary") << " " << data.size() / 1024 << " KB, "
+						  << sd.size() << " items:\n"
+						  << "  LLSDSerialize " << sd_ms << " ms, peak RSS +" << sd_kb << " KB\n"
+						  << "  LLSDDocument  " << doc_ms << " ms, peak RSS +" << doc_kb << " KB, "
+						  << doc.getMemoryUsage() / 1024 << " KB in " << doc.getNumNodes() << " nodes\n"
+						  << "  toLLSD()      " << convert_ms << " ms" << std::endl;
+			}
+		}
+	}
+}
@@ -0,0 +1,159 @@
+/**
+ * @file   workpriorityqueue_test.cpp
+ * @brief  Test for WorkPriorityQueue.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+// Precompiled header
+#include "linden_common.h"
+// associated header
+#include "workqueue.h"
+// STL headers
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+// other Linden headers
+#include "../test/lltut.h"
+
+using namespace LL;
+
+/*****************************************************************************
+*   TUT
+*****************************************************************************/
+namespace tut
+{
+    struct workpriorityqueue_data
+    {
+        // one heap, so that the order is exact
+        WorkPriorityQueue queue{ "priority", 1024, 1 };
+        std::string order;
+
+        WorkPriorityQueue::Work record(char name)
+        {
+            return [this, name](){ order += name; };
+        }
+    };
+    typedef test_group<workpriorityqueue_data> workpriorityqueue_group;
+    typedef workpriorityqueue_group::object object;
+    workpriorityqueue_group workpriorityqueuegrp("workpriorityqueue");
+
+    template<> template<>
+    void object::test<1>()
+    {
+        set_test_name("priority order");
+        queue.post(record('a'), 1.f);
+        queue.post(record('b'), 3.f);
+        queue.post(record('c'));
+        queue.post(record('d'), 3.f);
+        queue.post(record('e'), 2.f);
+        ensure_equals("size", queue.size(), 5);
+        queue.close();
+        ensure("closed, not done", queue.isClosed() && ! queue.done());
+        ensure("post after close", ! queue.post(record('x')));
+        queue.runUntilClose();
+        // ties run in posting order
+        ensure_equals("order", order, "bdeac");
+        ensure("done", queue.done());
+    }
+
+    template<> template<>
+    void object::test<2>()
+    {
+        set_test_name("setPriority");
+        WorkPriorityQueue::Ticket a, b, c;
+        queue.post(record('a'), 1.f, &a);
+        queue.post(record('b'), 2.f, &b);
+        queue.post(record('c'), 3.f, &c);
+        ensure("promote a", queue.setPriority(a, 10.f));
+        ensure("demote c", queue.setPriority(c, 0.f));
+        ensure("promote c", queue.setPriority(c, 5.f));
+        ensure("empty ticket", ! queue.setPriority(WorkPriorityQueue::Ticket(), 1.f));
+        queue.runOne();
+        ensure_equals("first", order, "a");
+        ensure("already run", ! queue.setPriority(a, 20.f));
+        queue.runPending();
+        ensure_equals("order", order, "acb");
+        ensure_equals("reprioritizing doesn't count twice", queue.size(), 0);
+    }
+
+    template<> template<>
+    void object::test<3>()
+    {
+        set_test_name("capacity");
+        WorkPriorityQueue small{ "small", 2, 1 };
+        ensure("first", small.tryPost(record('a')));
+        ensure("second", small.tryPost(record('b'), 1.f));
+        ensure("full", ! small.tryPost(record('c')));
+        small.runOne();
+        ensure("room again", small.tryPost(record('c')));
+        small.runPending();
+        ensure_equals("order", order, "bac");
+    }
+
+    template<> template<>
+    void object::test<4>()
+    {
+        set_test_name("stealing");
+        // four heaps, one consumer: it must steal three quarters of the work
+        WorkPriorityQueue shared{ "shared", 1024, 4 };
+        const S32 ITEMS = 400;
+        std::atomic<S32> ran{ 0 };
+        for (S32 i = 0; i < ITEMS; ++i)
+        {
+            shared.post([&ran](){ ++ran; }, F32(i % 7));
+        }
+        std::thread consumer([&shared](){ shared.runUntilClose(); });
+        shared.close();
+        consumer.join();
+        ensure_equals("all ran", ran.load(), ITEMS);
+        ensure_equals("stolen", shared.getStolenCount(), U64(ITEMS * 3 / 4));
+    }
+
+    template<> template<>
+    void object::test<5>()
+    {
+        set_test_name("several consumers");
+        WorkPriorityQueue shared{ "consumers", 1024, 4 };
+        const S32 ITEMS = 10000;
+        std::atomic<S32> ran{ 0 };
+        std::vector<std::thread> consumers;
+        for (S32 i = 0; i < 4; ++i)
+        {
+            consumers.emplace_back([&shared](){ shared.runUntilClose(); });
+        }
+        std::vector<WorkPriorityQueue::Ticket> tickets(ITEMS);
+        for (S32 i = 0; i < ITEMS; ++i)
+        {
+            shared.post([&ran](){ ++ran; }, 0.f, &tickets[i]);
+            // reprioritizing races with the consumers taking the work
+            shared.setPriority(tickets[i / 2], F32(i));
+        }
+        shared.close();
+        for (auto& consumer : consumers)
+        {
+            consumer.join();
+        }
+        ensure_equals("all ran once", ran.load(), ITEMS);
+        ensure("drained", shared.done());
+    }
+} // namespace tut
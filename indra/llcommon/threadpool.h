@@ -18,6 +18,7 @@
 #include <memory>                   // std::unique_ptr
 #include <string>
 #include <thread>
+#include <type_traits>              // std::is_same_v
 #include <utility>                  // std::pair
 #include <vector>
 
@@ -118,7 +119,7 @@ namespace LL
          * constrain any ThreadPool accepting work from the main thread.
          */
         ThreadPoolUsing(const std::string& name, size_t threads=1, size_t capacity=1024*1024):
-            ThreadPoolBase(name, threads, new queue_t(name, capacity))
+            ThreadPoolBase(name, threads, makeQueue(name, threads, capacity))
         {}
         ~ThreadPoolUsing() override {}
 
@@ -127,11 +128,28 @@ namespace LL
          * post work to it
          */
         queue_t& getQueue() { return static_cast<queue_t&>(*mQueue); }
+
+    private:
+        static queue_t* makeQueue(const std::string& name, size_t threads, size_t capacity)
+        {
+            if constexpr (std::is_same_v<queue_t, WorkPriorityQueue>)
+            {
+                // one heap per worker thread
+                return new queue_t(name, capacity, getConfiguredWidth(name, threads));
+            }
+            else
+            {
+                return new queue_t(name, capacity);
+            }
+        }
     };
 
     /// ThreadPool is shorthand for using the simpler WorkQueue
     using ThreadPool = ThreadPoolUsing<WorkQueue>;
 
+    /// PriorityThreadPool runs the most urgent work first, see WorkPriorityQueue
+    using PriorityThreadPool = ThreadPoolUsing<WorkPriorityQueue>;
+
 } // namespace LL
 
 #endif /* ! defined(LL_THREADPOOL_H) */
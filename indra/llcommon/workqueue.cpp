@@ -15,10 +15,15 @@
 #include "workqueue.h"
 // STL headers
 // std headers
+#include <atomic>
+#include <queue>
+#include <thread>
+#include <vector>
 // external library headers
 // other Linden headers
 #include "llcoros.h"
 #include LLCOROS_MUTEX_HEADER
+#include LLCOROS_CONDVAR_HEADER
 #include "llerror.h"
 #include "llexception.h"
 #include "stringize.h"
@@ -243,3 +248,282 @@ bool LL::WorkSchedule::tryPop_(Work& work)
 {
     return mQueue.tryPop(work);
 }
+
+/*****************************************************************************
+*   WorkPriorityQueue
+*****************************************************************************/
+// Guarded by the mutex of its shard
+struct LL::WorkPriorityQueue::Item
+{
+    Work mWork;
+    Priority mPriority;
+    U64 mSequence;
+    // bumped by setPriority(), so older heap entries can be told apart
+    U32 mGeneration{ 0 };
+    size_t mShard;
+    bool mTaken{ false };
+};
+
+namespace
+{
+    struct HeapEntry
+    {
+        LL::WorkPriorityQueue::Priority mPriority;
+        U64 mSequence;
+        U32 mGeneration;
+        LL::WorkPriorityQueue::Ticket mItem;
+
+        // std::priority_queue puts the greatest first: higher priority, then
+        // lower sequence
+        bool operator<(const HeapEntry& other) const
+        {
+            if (mPriority != other.mPriority)
+                return mPriority < other.mPriority;
+            return mSequence > other.mSequence;
+        }
+    };
+
+    struct Shard
+    {
+        Mutex mMutex;
+        std::priority_queue<HeapEntry> mHeap;
+    };
+
+    // Which shard the current thread consumes, for the last queue it
+    // consumed: threads normally serve a single queue
+    struct ConsumerSlot
+    {
+        U64 mQueueId{ 0 };
+        size_t mShard{ 0 };
+    };
+    thread_local ConsumerSlot sConsumerSlot;
+    std::atomic<U64> sNextQueueId{ 1 };
+} // anonymous namespace
+
+struct LL::WorkPriorityQueue::State
+{
+    State(size_t capacity, size_t shards):
+        mId(sNextQueueId++),
+        mCapacity(capacity),
+        mShards(shards)
+    {}
+
+    const U64 mId;
+    const size_t mCapacity;
+    std::vector<Shard> mShards;
+    std::atomic<size_t> mNextShard{ 0 };
+    std::atomic<U64> mStolen{ 0 };
+
+    // mMutex guards the rest, and is never locked while holding a shard
+    Mutex mMutex;
+    LLCoros::ConditionVariable mEmptyCond;
+    LLCoros::ConditionVariable mCapacityCond;
+    // posted, not yet taken; may briefly lag behind a take
+    size_t mCount{ 0 };
+    U64 mSequence{ 0 };
+    size_t mConsumers{ 0 };
+    bool mClosed{ false };
+};
+
+LL::WorkPriorityQueue::WorkPriorityQueue(const std::string& name, size_t capacity,
+                                         size_t shards):
+    super(name),
+    mState(std::make_unique<State>(
+               capacity,
+               shards? shards : llmax(1u, std::thread::hardware_concurrency())))
+{
+}
+
+LL::WorkPriorityQueue::~WorkPriorityQueue()
+{
+}
+
+void LL::WorkPriorityQueue::close()
+{
+    {
+        Lock lock(mState->mMutex);
+        mState->mClosed = true;
+    }
+    mState->mEmptyCond.notify_all();
+    mState->mCapacityCond.notify_all();
+}
+
+size_t LL::WorkPriorityQueue::size()
+{
+    Lock lock(mState->mMutex);
+    return mState->mCount;
+}
+
+bool LL::WorkPriorityQueue::isClosed()
+{
+    Lock lock(mState->mMutex);
+    return mState->mClosed;
+}
+
+bool LL::WorkPriorityQueue::done()
+{
+    Lock lock(mState->mMutex);
+    return mState->mClosed && ! mState->mCount;
+}
+
+bool LL::WorkPriorityQueue::post(const Work& callable)
+{
+    return push(callable, 0.f, nullptr, true);
+}
+
+bool LL::WorkPriorityQueue::post(const Work& callable, Priority priority, Ticket* ticket)
+{
+    return push(callable, priority, ticket, true);
+}
+
+bool LL::WorkPriorityQueue::tryPost(const Work& callable)
+{
+    return push(callable, 0.f, nullptr, false);
+}
+
+bool LL::WorkPriorityQueue::tryPost(const Work& callable, Priority priority, Ticket* ticket)
+{
+    return push(callable, priority, ticket, false);
+}
+
+bool LL::WorkPriorityQueue::push(const Work& callable, Priority priority, Ticket* ticket,
+                                 bool wait)
+{
+    State& state(*mState);
+    auto item{ std::make_shared<Item>() };
+    item->mWork = callable;
+    item->mPriority = priority;
+    // A consumer posting follow-up work keeps it, anybody else deals round
+    // robin
+    item->mShard = (sConsumerSlot.mQueueId == state.mId)?
+        sConsumerSlot.mShard :
+        state.mNextShard++ % state.mShards.size();
+    {
+        Lock lock(state.mMutex);
+        while (! state.mClosed && state.mCount >= state.mCapacity)
+        {
+            if (! wait)
+                return false;
+            state.mCapacityCond.wait(lock);
+        }
+        if (state.mClosed)
+            return false;
+        item->mSequence = state.mSequence++;
+        ++state.mCount;
+        // Pushed under the queue lock, so that no consumer can see the count
+        // without the item
+        Shard& shard(state.mShards[item->mShard]);
+        Lock shard_lock(shard.mMutex);
+        shard.mHeap.push(HeapEntry{ priority, item->mSequence, 0, item });
+    }
+    state.mEmptyCond.notify_one();
+    if (ticket)
+    {
+        *ticket = item;
+    }
+    return true;
+}
+
+bool LL::WorkPriorityQueue::setPriority(const Ticket& ticket, Priority priority)
+{
+    if (! ticket)
+        return false;
+    Shard& shard(mState->mShards[ticket->mShard]);
+    Lock lock(shard.mMutex);
+    if (ticket->mTaken)
+        return false;
+    if (ticket->mPriority != priority)
+    {
+        // Leave the old entry in the heap, take() skips it
+        ticket->mPriority = priority;
+        ++ticket->mGeneration;
+        shard.mHeap.push(HeapEntry{ priority, ticket->mSequence, ticket->mGeneration, ticket });
+    }
+    return true;
+}
+
+U64 LL::WorkPriorityQueue::getStolenCount() const
+{
+    return mState->mStolen;
+}
+
+size_t LL::WorkPriorityQueue::getConsumerShard()
+{
+    State& state(*mState);
+    if (sConsumerSlot.mQueueId != state.mId)
+    {
+        Lock lock(state.mMutex);
+        sConsumerSlot.mQueueId = state.mId;
+        sConsumerSlot.mShard = state.mConsumers++ % state.mShards.size();
+    }
+    return sConsumerSlot.mShard;
+}
+
+bool LL::WorkPriorityQueue::take(Work& work)
+{
+    State& state(*mState);
+    size_t own = getConsumerShard();
+    size_t shards = state.mShards.size();
+    for (size_t i = 0; i < shards; ++i)
+    {
+        Shard& shard(state.mShards[(own + i) % shards]);
+        bool found = false;
+        {
+            Lock lock(shard.mMutex);
+            while (! shard.mHeap.empty())
+            {
+                HeapEntry entry{ shard.mHeap.top() };
+                shard.mHeap.pop();
+                Item& item(*entry.mItem);
+                if (item.mTaken || item.mGeneration != entry.mGeneration)
+                    continue;       // reprioritized since
+                item.mTaken = true;
+                work = std::move(item.mWork);
+                found = true;
+                break;
+            }
+        }
+        if (found)
+        {
+            if (i)
+            {
+                ++state.mStolen;
+            }
+            {
+                Lock lock(state.mMutex);
+                --state.mCount;
+            }
+            state.mCapacityCond.notify_one();
+            return true;
+        }
+    }
+    return false;
+}
+
+LL::WorkPriorityQueue::Work LL::WorkPriorityQueue::pop_()
+{
+    State& state(*mState);
+    for (;;)
+    {
+        Work work;
+        if (take(work))
+            return work;
+
+        Lock lock(state.mMutex);
+        // mCount can be nonzero with every heap empty for the moment between
+        // another consumer's take and its decrement: just look again.
+        while (! state.mCount)
+        {
+            if (state.mClosed)
+            {
+                LLTHROW(LLThreadSafeQueueInterrupt());
+            }
+            state.mEmptyCond.wait(lock);
+        }
+    }
+}
+
+bool LL::WorkPriorityQueue::tryPop_(Work& work)
+{
+    return take(work);
+}
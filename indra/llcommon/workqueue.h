@@ -20,6 +20,7 @@
 #include <chrono>
 #include <exception>                // std::current_exception
 #include <functional>               // std::function
+#include <memory>                   // std::shared_ptr, std::unique_ptr
 #include <string>
 
 namespace LL
@@ -442,6 +443,113 @@ namespace LL
                  getWeak(), TimePoint::clock::now(), interval, std::move(callable)));
     }
 
+/*****************************************************************************
+*   WorkPriorityQueue: prioritized work spread over the consumer threads
+*****************************************************************************/
+    /**
+     * WorkPriorityQueue is for a ThreadPool whose work items are not equally
+     * urgent. Instead of one shared FIFO, each consumer thread gets its own
+     * heap of work, most urgent (highest priority) first, ties in posting
+     * order. Posted work is dealt round robin over the heaps. A consumer
+     * runs the most urgent item of its own heap and, when that is empty,
+     * steals the most urgent item of another consumer's heap.
+     *
+     * The priority of posted work can be changed until a consumer takes it,
+     * through the Ticket optionally returned by post().
+     *
+     * Ordering is per heap: with several consumers, an item may start while
+     * a more urgent one still waits in another heap, behind that consumer's
+     * current item.
+     */
+    class WorkPriorityQueue: public LLInstanceTrackerSubclass<WorkPriorityQueue, WorkQueueBase>
+    {
+    private:
+        using super = LLInstanceTrackerSubclass<WorkPriorityQueue, WorkQueueBase>;
+        struct Item;
+        struct State;
+
+    public:
+        /// higher runs first
+        using Priority = F32;
+        /// handle to posted work, for setPriority()
+        using Ticket = std::shared_ptr<Item>;
+
+        /**
+         * You may omit the WorkPriorityQueue name, in which case a unique
+         * name is synthesized; for practical purposes that makes it
+         * anonymous.
+         *
+         * The queue doesn't know how many threads will consume it: pass
+         * shards to set how many heaps to spread work over, 0 meaning one
+         * per hardware thread. Consumers beyond that share heaps.
+         */
+        WorkPriorityQueue(const std::string& name = std::string(), size_t capacity=1024,
+                          size_t shards=0);
+        ~WorkPriorityQueue() override;
+
+        /**
+         * Since the point of WorkQueue is to pass work to some other worker
+         * thread(s) asynchronously, it's important that it continue to exist
+         * until the worker thread(s) have drained it. To communicate that
+         * it's time for them to quit, close() the queue.
+         */
+        void close() override;
+
+        /**
+         * Number of posted items no consumer has taken yet. The same caveats
+         * apply as for WorkQueue::size().
+         */
+        size_t size() override;
+        /// producer end: are we prevented from pushing any additional items?
+        bool isClosed() override;
+        /// consumer end: are we done, is the queue entirely drained?
+        bool done() override;
+
+        /*---------------------- fire and forget API -----------------------*/
+
+        /**
+         * post work at priority 0, unless the queue is closed before we can
+         * post
+         */
+        bool post(const Work& callable) override;
+
+        /**
+         * post work at the specified priority, unless the queue is closed
+         * before we can post. Pass ticket to be able to reprioritize it.
+         */
+        bool post(const Work& callable, Priority priority, Ticket* ticket=nullptr);
+
+        /**
+         * post work at priority 0, unless the queue is full
+         */
+        bool tryPost(const Work& callable) override;
+
+        /**
+         * post work at the specified priority, unless the queue is full
+         */
+        bool tryPost(const Work& callable, Priority priority, Ticket* ticket=nullptr);
+
+        /**
+         * Change the priority of posted work. Returns false if a consumer
+         * has already taken it (or the ticket is empty).
+         */
+        bool setPriority(const Ticket& ticket, Priority priority);
+
+        /// how many items were run by a consumer other than the one they
+        /// were dealt to
+        U64 getStolenCount() const;
+
+    private:
+        bool push(const Work& callable, Priority priority, Ticket* ticket, bool wait);
+        size_t getConsumerShard();
+        bool take(Work& work);
+
+        Work pop_() override;
+        bool tryPop_(Work&) override;
+
+        std::unique_ptr<State> mState;
+    };
+
     /// general case: arbitrary C++ return type
     template <typename CALLABLE, typename FOLLOWUP, typename RETURNTYPE>
     struct WorkQueueBase::MakeReplyLambda
@@ -153,6 +153,12 @@ const int HTTP_CONNECTION_LIMIT_MAX = 256;
 const long HTTP_PIPELINING_DEFAULT = 0L;
 const long HTTP_PIPELINING_MAX = 20L;
 
+// HTTP/2 multiplexing limits.  Consecutive HTTP/2 protocol
+// errors in a class before it goes back to HTTP/1.1.
+const long HTTP_MULTIPLEX_STREAMS_DEFAULT = 0L;
+const long HTTP_MULTIPLEX_STREAMS_MAX = 256L;
+const int HTTP_MULTIPLEX_ERROR_LIMIT = 3;
+
 // Miscellaneous defaults
 const bool HTTP_USE_RETRY_AFTER_DEFAULT = true;
 const long HTTP_THROTTLE_RATE_DEFAULT = 0L;
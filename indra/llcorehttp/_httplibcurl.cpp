@@ -30,6 +30,7 @@
 #include "bufferarray.h"
 #include "_httpoprequest.h"
 #include "_httppolicy.h"
+#include "httpstats.h"
 
 #include "llhttpconstants.h"
 
@@ -64,7 +65,10 @@ HttpLibcurl::HttpLibcurl(HttpService * service)
 	  mPolicyCount(0),
 	  mMultiHandles(NULL),
 	  mActiveHandles(NULL),
-	  mDirtyPolicy(NULL)
+	  mDirtyPolicy(NULL),
+	  mMultiplexActive(NULL),
+	  mMultiplexDisabled(NULL),
+	  mMultiplexErrors(NULL)
 {}
 
 
@@ -105,6 +109,15 @@ void HttpLibcurl::shutdown()
 
 		delete [] mDirtyPolicy;
 		mDirtyPolicy = NULL;
+
+		delete [] mMultiplexActive;
+		mMultiplexActive = NULL;
+
+		delete [] mMultiplexDisabled;
+		mMultiplexDisabled = NULL;
+
+		delete [] mMultiplexErrors;
+		mMultiplexErrors = NULL;
 	}
 
 	mPolicyCount = 0;
@@ -121,6 +134,9 @@ void HttpLibcurl::start(int policy_count)
 	mMultiHandles = new CURLM * [mPolicyCount];
 	mActiveHandles = new int [mPolicyCount];
 	mDirtyPolicy = new bool [mPolicyCount];
+	mMultiplexActive = new bool [mPolicyCount];
+	mMultiplexDisabled = new bool [mPolicyCount];
+	mMultiplexErrors = new int [mPolicyCount];
 	
 	for (int policy_class(0); policy_class < mPolicyCount; ++policy_class)
 	{
@@ -131,6 +147,9 @@ void HttpLibcurl::start(int policy_count)
 		}
 		mActiveHandles[policy_class] = 0;
 		mDirtyPolicy[policy_class] = false;
+		mMultiplexActive[policy_class] = false;
+		mMultiplexDisabled[policy_class] = false;
+		mMultiplexErrors[policy_class] = 0;
 		policyUpdated(policy_class);
 	}
 }
@@ -409,6 +428,11 @@ bool HttpLibcurl::completeRequest(CURLM * multi_handle, CURL * handle, CURLcode
         }
 	}
 
+	if (handle)
+	{
+		recordTransport(op, handle, status);
+	}
+
     if (multi_handle && handle)
     {
         // Detach from multi and recycle handle
@@ -440,6 +464,56 @@ bool HttpLibcurl::completeRequest(CURLM * multi_handle, CURL * handle, CURLcode
 }
 
 
+void HttpLibcurl::recordTransport(const opReqPtr_t &op, CURL * handle, CURLcode status)
+{
+	const int policy_class(op->mReqPolicy);
+
+	// New connections this request had to open, zero when it was
+	// served on one already open
+	long new_connects(0L);
+	long http_version(CURL_HTTP_VERSION_NONE);
+	curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &new_connects);
+	curl_easy_getinfo(handle, CURLINFO_HTTP_VERSION, &http_version);
+	const bool http2(CURL_HTTP_VERSION_2_0 == http_version);
+
+	bool fallback(false);
+	if (isMultiplexing(policy_class))
+	{
+		if (CURLE_HTTP2 == status || CURLE_HTTP2_STREAM == status)
+		{
+			// Protocol failure.  Retry goes out over HTTP/1.1 and
+			// the class gives up on HTTP/2 if these keep coming.
+			op->mCurlHttp1Only = true;
+			fallback = true;
+			mMultiplexActive[policy_class] = false;
+			if (++mMultiplexErrors[policy_class] >= HTTP_MULTIPLEX_ERROR_LIMIT)
+			{
+				LL_WARNS(LOG_CORE) << "Repeated HTTP/2 errors in policy class " << policy_class
+								   << ", falling back to HTTP/1.1."
+								   << LL_ENDL;
+				mMultiplexDisabled[policy_class] = true;
+				mMultiplexActive[policy_class] = false;
+				policyUpdated(policy_class);
+			}
+		}
+		else if (op->mCurlHttp1Only)
+		{
+			fallback = true;
+		}
+		else if (CURLE_OK == status)
+		{
+			// Server picked the protocol, an HTTP/1.1-only server
+			// keeps the class at its unmultiplexed request limit.
+			mMultiplexErrors[policy_class] = 0;
+			mMultiplexActive[policy_class] = http2;
+			fallback = ! http2;
+		}
+	}
+
+	HTTPStats::instance().recordTransport(policy_class, new_connects, CURLE_OK == status, http2, fallback);
+}
+
+
 int HttpLibcurl::getActiveCount() const
 {
 	return mActiveOps.size();
@@ -453,6 +527,24 @@ int HttpLibcurl::getActiveCountInClass(int policy_class) const
 	return mActiveHandles ? mActiveHandles[policy_class] : 0;
 }
 
+bool HttpLibcurl::isMultiplexing(int policy_class) const
+{
+	if (policy_class < 0 || policy_class >= mPolicyCount || ! mMultiplexDisabled)
+	{
+		return false;
+	}
+
+	HttpPolicy & policy(mService->getPolicy());
+	return policy.getClassOptions(policy_class).mMultiplexStreams > 0L && ! mMultiplexDisabled[policy_class];
+}
+
+
+bool HttpLibcurl::isMultiplexActive(int policy_class) const
+{
+	return isMultiplexing(policy_class) && mMultiplexActive[policy_class];
+}
+
+
 void HttpLibcurl::policyUpdated(int policy_class)
 {
     LL_PROFILE_ZONE_SCOPED_CATEGORY_NETWORK;
@@ -487,7 +579,28 @@ void HttpLibcurl::policyUpdated(int policy_class)
 		policy.stallPolicy(policy_class, false);
 		mDirtyPolicy[policy_class] = false;
 
-		if (options.mPipelining > 1)
+		if (isMultiplexing(policy_class))
+		{
+			// HTTP/2 multiplexing.  Libcurl waits for a connection
+			// that can take another stream before opening a new one,
+			// connection limits only come into play once all of them
+			// are at their stream limit or the server is HTTP/1.1.
+			check_curl_multi_setopt(multi_handle,
+									 CURLMOPT_PIPELINING,
+									 CURLPIPE_MULTIPLEX);
+#if LIBCURL_VERSION_NUM >= 0x074300
+			check_curl_multi_setopt(multi_handle,
+									 CURLMOPT_MAX_CONCURRENT_STREAMS,
+									 long(options.mMultiplexStreams));
+#endif
+			check_curl_multi_setopt(multi_handle,
+									 CURLMOPT_MAX_HOST_CONNECTIONS,
+									 long(options.mPerHostConnectionLimit));
+			check_curl_multi_setopt(multi_handle,
+									 CURLMOPT_MAX_TOTAL_CONNECTIONS,
+									 long(options.mConnectionLimit));
+		}
+		else if (options.mPipelining > 1)
 		{
 			// We'll try to do pipelining on this multihandle
 			check_curl_multi_setopt(multi_handle,
@@ -124,6 +124,20 @@ class HttpLibcurl
 	/// Threading:  called by worker thread.
 	void policyUpdated(int policy_class);
 
+	/// Return whether requests in the class should ask for HTTP/2
+	/// and share connections.  True when the class has multiplexing
+	/// configured and it hasn't been turned off by protocol errors.
+	///
+	/// Threading:  called by worker thread.
+	bool isMultiplexing(int policy_class) const;
+
+	/// Return whether the class is multiplexing and its most recent
+	/// completed request came back over HTTP/2.  Policy uses this to
+	/// open up the in-flight request limit.
+	///
+	/// Threading:  called by worker thread.
+	bool isMultiplexActive(int policy_class) const;
+
 	/// Allocate a curl handle for caller.  May be freed using
 	/// either the freeHandle() method or calling curl_easy_cleanup()
 	/// directly.
@@ -149,6 +163,10 @@ class HttpLibcurl
 	/// Invoked to cancel an active request, mainly during shutdown
 	/// and destroy.
     void cancelRequest(const opReqPtr_t &op);
+
+	/// Records connection reuse and protocol for a completed request
+	/// and tracks HTTP/2 negotiation and failures for its class.
+	void recordTransport(const opReqPtr_t &op, CURL * handle, CURLcode status);
 	
 protected:
     typedef std::set<opReqPtr_t> active_set_t;
@@ -213,6 +231,9 @@ class HttpLibcurl
 	CURLM **			mMultiHandles;		// One handle per policy class
 	int *				mActiveHandles;		// Active count per policy class
 	bool *				mDirtyPolicy;		// Dirty policy update waiting for stall (per pc)
+	bool *				mMultiplexActive;	// Last completion came over HTTP/2 (per pc)
+	bool *				mMultiplexDisabled;	// HTTP/2 turned off after protocol errors (per pc)
+	int *				mMultiplexErrors;	// Consecutive HTTP/2 protocol errors (per pc)
 	
 }; // end class HttpLibcurl
 
@@ -136,6 +136,7 @@ HttpOpRequest::HttpOpRequest()
 	  mReqHeaders(),
 	  mReqOptions(),
 	  mCurlActive(false),
+	  mCurlHttp1Only(false),
 	  mCurlHandle(NULL),
 	  mCurlService(NULL),
 	  mCurlHeaders(NULL),
@@ -529,6 +530,19 @@ HttpStatus HttpOpRequest::prepareRequest(HttpService * service)
 
 	check_curl_easy_setopt(mCurlHandle, CURLOPT_COOKIEFILE, "");
 
+	if (mCurlHttp1Only)
+	{
+		check_curl_easy_setopt(mCurlHandle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+	}
+	else if (service->getTransport().isMultiplexing(mReqPolicy))
+	{
+		// Ask for HTTP/2 via ALPN, plain HTTP/1.1 servers still
+		// work.  PIPEWAIT has libcurl wait for a connection it can
+		// multiplex on rather than open another.
+		check_curl_easy_setopt(mCurlHandle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+		check_curl_easy_setopt(mCurlHandle, CURLOPT_PIPEWAIT, 1L);
+	}
+
 	if(!gpolicy.mUserAgent.empty())
 	{
 		check_curl_easy_setopt(mCurlHandle, CURLOPT_USERAGENT, gpolicy.mUserAgent.c_str());
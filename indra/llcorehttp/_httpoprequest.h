@@ -202,6 +202,7 @@ class HttpOpRequest final : public HttpOperation
 
 	// Transport data
 	bool				mCurlActive;
+	bool				mCurlHttp1Only;			// HTTP/2 failed on this request, stay on HTTP/1.1
 	CURL *				mCurlHandle;
 	HttpService *		mCurlService;
 	curl_slist *		mCurlHeaders;
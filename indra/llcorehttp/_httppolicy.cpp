@@ -41,6 +41,16 @@ namespace
 
 static const char * const LOG_CORE("CoreHttp");
 
+// HTTP/2 protocol errors are only worth a retry in a multiplexing class,
+// where the transport has switched the request to HTTP/1.1 for it
+bool isHttp2Fallback(const LLCore::HttpOpRequest::ptr_t & op)
+{
+	static const LLCore::HttpStatus http2_error(LLCore::HttpStatus::EXT_CURL_EASY, CURLE_HTTP2);
+	static const LLCore::HttpStatus http2_stream(LLCore::HttpStatus::EXT_CURL_EASY, CURLE_HTTP2_STREAM);
+
+	return op->mCurlHttp1Only && (op->mStatus == http2_error || op->mStatus == http2_stream);
+}
+
 } // end anonymous namespace
 
 
@@ -254,10 +264,15 @@ HttpService::ELoopSpeed HttpPolicy::processReadyQueue()
 		}
 
 		int active(transport.getActiveCountInClass(policy_class));
-		int active_limit(state.mOptions.mPipelining > 1L
-						 ? (state.mOptions.mPerHostConnectionLimit
-							* state.mOptions.mPipelining)
-						 : state.mOptions.mConnectionLimit);
+		int active_limit(state.mOptions.mConnectionLimit);
+		if (transport.isMultiplexActive(policy_class))
+		{
+			active_limit = state.mOptions.mPerHostConnectionLimit * state.mOptions.mMultiplexStreams;
+		}
+		else if (state.mOptions.mPipelining > 1L)
+		{
+			active_limit = state.mOptions.mPerHostConnectionLimit * state.mOptions.mPipelining;
+		}
 		int needed(active_limit - active);		// Expect negatives here
 
 		if (needed > 0)
@@ -399,7 +414,8 @@ bool HttpPolicy::stageAfterCompletion(const HttpOpRequest::ptr_t &op)
 #endif
 		
 		// If this failed, we might want to retry.
-		if (op->mPolicyRetries < op->mPolicyRetryLimit && op->mStatus.isRetryable())
+		if (op->mPolicyRetries < op->mPolicyRetryLimit
+			&& (op->mStatus.isRetryable() || isHttp2Fallback(op)))
 		{
 			// Okay, worth a retry.
 			retryOp(op);
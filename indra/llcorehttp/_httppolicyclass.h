@@ -64,6 +64,7 @@ class HttpPolicyClass
 	long						mPerHostConnectionLimit;
 	long						mPipelining;
 	long						mThrottleRate;
+	long						mMultiplexStreams;
 };  // end class HttpPolicyClass
 
 }  // end namespace LLCore
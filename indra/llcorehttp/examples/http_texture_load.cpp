@@ -42,6 +42,7 @@
 #include "httpresponse.h"
 #include "httpoptions.h"
 #include "httpheaders.h"
+#include "httpstats.h"
 #include "bufferarray.h"
 #include "_mutex.h"
 
@@ -59,6 +60,7 @@ void usage(std::ostream & out);
 static int concurrency_limit(40);
 static int highwater(100);
 static int pipeline_depth(0);
+static int multiplex_streams(0);
 static int tracing(0);
 static char url_format[1024] = "http://example.com/some/path?texture_id=%s.texture";
 
@@ -166,7 +168,7 @@ int main(int argc, char** argv)
 	bool do_verbose(false);
 	
 	int option(-1);
-	while (-1 != (option = getopt(argc, argv, "u:c:h?RwvH:p:t:")))
+	while (-1 != (option = getopt(argc, argv, "u:c:h?RwvH:p:m:t:")))
 	{
 		switch (option)
 		{
@@ -196,7 +198,7 @@ int main(int argc, char** argv)
 				char * end;
 
 				value = strtoul(optarg, &end, 10);
-				if (value < 1 || value > 200 || *end != '\0')
+				if (value < 1 || value > 256 || *end != '\0')
 				{
 					usage(std::cerr);
 					return 1;
@@ -220,6 +222,21 @@ int main(int argc, char** argv)
 			}
 			break;
 
+		case 'm':
+		    {
+				unsigned long value;
+				char * end;
+
+				value = strtoul(optarg, &end, 10);
+				if (value > 256 || *end != '\0')
+				{
+					usage(std::cerr);
+					return 1;
+				}
+				multiplex_streams = value;
+			}
+			break;
+
 		case '5':
 		    {
 				unsigned long value;
@@ -290,6 +307,13 @@ int main(int argc, char** argv)
 												   pipeline_depth,
 												   NULL);
 	}
+	if (multiplex_streams)
+	{
+		LLCore::HttpRequest::setStaticPolicyOption(LLCore::HttpRequest::PO_MULTIPLEX_STREAMS,
+												   LLCore::HttpRequest::DEFAULT_POLICY_ID,
+												   multiplex_streams,
+												   NULL);
+	}
 	if (tracing)
 	{
 		LLCore::HttpRequest::setStaticPolicyOption(LLCore::HttpRequest::PO_TRACE,
@@ -352,6 +376,10 @@ int main(int argc, char** argv)
 			  << std::endl;
 	std::cout << "Retries: " << ws.mRetries << "  Retries on 503: " << ws.mRetriesHttp503
 			  << std::endl;
+	const LLCore::HTTPStats::TransportStats transport(LLCore::HTTPStats::instance().getTransportStats());
+	std::cout << "Connections opened: " << transport.mConnects << "  Transfers on reused connections: " << transport.mReused
+			  << "  HTTP/2 transfers: " << transport.mHttp2 << "  HTTP/1.1 fallbacks: " << transport.mFallbacks
+			  << std::endl;
 	std::cout << "User CPU: " << (metrics.mEndUTime - metrics.mStartUTime)
 			  << " uS  System CPU: " << (metrics.mEndSTime - metrics.mStartSTime)
 			  << " uS  Wall Time: "  << (metrics.mEndWallTime - metrics.mStartWallTime)
@@ -392,9 +420,15 @@ void usage(std::ostream & out)
 		" -c <limit>            Maximum connection concurrency.  Range:  [1..100]\n"
 		"                       Default:  " << concurrency_limit << "\n"
 		" -H <limit>            HTTP request highwater (requests fed to llcorehttp).\n"
-		"                       Range:  [1..200]  Default:  " << highwater << "\n"
+		"                       Range:  [1..256]  Default:  " << highwater << "\n"
 		" -p <depth>            If <depth> is positive, enables and sets pipelineing\n"
 		"                       depth on HTTP requests.  Default:  " << pipeline_depth << "\n"
+		" -m <streams>          If <streams> is positive, asks for HTTP/2 and multiplexes\n"
+		"                       up to <streams> requests per connection, falling back to\n"
+		"                       HTTP/1.1 for servers without it.  Compare opened\n"
+		"                       connections and wall time against a run without it,\n"
+		"                       e.g. -c 4 -H 256 -m 100 vs. -c 40 -H 256.\n"
+		"                       Range:  [0..256]  Default:  " << multiplex_streams << "\n"
 		" -t <level>            If <level> is positive ([1..3]), enables and sets HTTP\n"
 		"                       tracing on HTTP requests.  Default:  " << tracing << "\n"
 		" -v                    Verbose mode.  Issue some chatter while running\n"
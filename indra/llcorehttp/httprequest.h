@@ -236,6 +236,25 @@ class HttpRequest
 		/// Global only
 		PO_USER_AGENT,
 
+		/// If positive, requests in the class ask for HTTP/2 and
+		/// are multiplexed over shared connections.  Value gives
+		/// the maximum number of concurrent streams on a
+		/// connection.  A value of zero, the default, disables
+		/// multiplexing.
+		///
+		/// Servers that only speak HTTP/1.1 are still served,
+		/// TLS negotiation picks the protocol per connection.
+		/// While the class isn't getting HTTP/2 responses, the
+		/// in-flight request limit is the one used without
+		/// multiplexing.  Once it is, the limit becomes
+		/// PO_PER_HOST_CONNECTION_LIMIT times this value.  Requests
+		/// failing on an HTTP/2 protocol error are retried over
+		/// HTTP/1.1 and repeated errors turn multiplexing off for
+		/// the class.
+		///
+		/// Per-class only
+		PO_MULTIPLEX_STREAMS,
+
 		PO_LAST  // Always at end
 	};
 
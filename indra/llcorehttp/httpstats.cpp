@@ -38,6 +38,10 @@ HTTPStats::HTTPStats()
 void HTTPStats::resetStats()
 {
     mResutCodes.clear();
+    {
+        LLMutexLock lock(&mTransportMutex);
+        mTransports.clear();
+    }
     mDataDown.reset();
     mDataUp.reset();
     mRequests = 0;
@@ -57,6 +61,38 @@ void HTTPStats::recordResultCode(S32 code)
 
 }
 
+void HTTPStats::recordTransport(S32 policy_class, S32 new_connects, bool succeeded, bool http2, bool fallback)
+{
+    LLMutexLock lock(&mTransportMutex);
+    TransportStats& stats(mTransports[policy_class]);
+
+    ++stats.mTransfers;
+    stats.mConnects += new_connects;
+    if (succeeded && !new_connects)
+        ++stats.mReused;
+    if (http2)
+        ++stats.mHttp2;
+    if (fallback)
+        ++stats.mFallbacks;
+}
+
+HTTPStats::TransportStats HTTPStats::getTransportStats() const
+{
+    TransportStats total;
+
+    LLMutexLock lock(&mTransportMutex);
+    for (std::map<S32, TransportStats>::const_iterator it = mTransports.begin(); it != mTransports.end(); ++it)
+    {
+        total.mTransfers += (*it).second.mTransfers;
+        total.mConnects += (*it).second.mConnects;
+        total.mReused += (*it).second.mReused;
+        total.mHttp2 += (*it).second.mHttp2;
+        total.mFallbacks += (*it).second.mFallbacks;
+    }
+
+    return total;
+}
+
 namespace
 {
     std::string byte_count_converter(F32 bytes)
@@ -97,6 +133,22 @@ void HTTPStats::dumpStats()
         out << (*it).first << " " << (*it).second << std::endl;
     }
 
+    out << std::endl;
+    out << "Connections by policy class:" << std::endl;
+    out << "Class Transfers Opened Reused HTTP/2 Fallbacks" << std::endl;
+
+    std::map<S32, TransportStats> transports;
+    {
+        LLMutexLock lock(&mTransportMutex);
+        transports = mTransports;
+    }
+    for (std::map<S32, TransportStats>::iterator it = transports.begin(); it != transports.end(); ++it)
+    {
+        const TransportStats& stats((*it).second);
+        out << (*it).first << " " << stats.mTransfers << " " << stats.mConnects << " " << stats.mReused
+            << " " << stats.mHttp2 << " " << stats.mFallbacks << std::endl;
+    }
+
     LL_WARNS("HTTPCore") << out.str() << LL_ENDL;
 }
 
@@ -32,6 +32,7 @@
 #include "llstatsaccumulator.h"
 #include "llsingleton.h"
 #include "llsd.h"
+#include "llmutex.h"
 
 namespace LLCore
 {
@@ -59,6 +60,25 @@ namespace LLCore
 
         void    recordResultCode(S32 code);
 
+        // A completed transfer in policy_class.  new_connects is the
+        // number of connections it had to open, zero when it reused
+        // one, which only counts as reuse when the transfer succeeded.
+        // fallback is set when the class is multiplexing but the
+        // transfer went over HTTP/1.1.  Called from the worker thread.
+        void    recordTransport(S32 policy_class, S32 new_connects, bool succeeded, bool http2, bool fallback);
+
+        struct TransportStats
+        {
+            S32 mTransfers = 0;
+            S32 mConnects = 0;
+            S32 mReused = 0;
+            S32 mHttp2 = 0;
+            S32 mFallbacks = 0;
+        };
+
+        // Totals over all policy classes
+        TransportStats getTransportStats() const;
+
         void    dumpStats();
     private:
         StatsAccumulator mDataDown;
@@ -67,6 +87,8 @@ namespace LLCore
         S32              mRequests;
 
         std::map<S32, S32> mResutCodes;
+        mutable LLMutex  mTransportMutex;
+        std::map<S32, TransportStats> mTransports;
     };
 
 
@@ -32,8 +32,11 @@
 #include "httpheaders.h"
 #include "httpresponse.h"
 #include "httpoptions.h"
+#include "httpstats.h"
 #include "_httpservice.h"
 #include "_httprequestqueue.h"
+#include "_httppolicy.h"
+#include "_httplibcurl.h"
 
 #include <curl/curl.h>
 #include <boost/regex.hpp>
@@ -3012,6 +3015,252 @@ void HttpRequestTestObjectType::test<23>()
 }
 
 
+template <> template <>
+void HttpRequestTestObjectType::test<24>()
+{
+	ScopedCurlInit ready;
+
+	set_test_name("HttpRequest GETs multiplexed class to HTTP/1.1 service");
+
+	// The test server only speaks HTTP/1.x so every request in a
+	// multiplexing class has to complete over the fallback and be
+	// counted as one.  64 and 256 outstanding requests are the
+	// loads texture and mesh fetches put on a class.
+	TestHandler2 handler(this, "handler");
+    LLCore::HttpHandler::ptr_t handlerp(&handler, NoOpDeletor);
+	std::string url_base(get_base_url());
+	mHandlerCalls = 0;
+
+	HttpRequest * req = NULL;
+
+	try
+	{
+        // Get singletons created
+		HttpRequest::createService();
+
+		long streams(0L);
+		HttpStatus status = HttpRequest::setStaticPolicyOption(HttpRequest::PO_MULTIPLEX_STREAMS,
+															   HttpRequest::DEFAULT_POLICY_ID,
+															   32L,
+															   &streams);
+		ensure("Multiplexing set on the class", bool(status));
+		ensure("Multiplexing streams readback", 32L == streams);
+
+		// Start threading early so that thread memory is invariant
+		// over the test.
+		HttpRequest::startThread();
+
+		// create a new ref counted object with an implicit reference
+		req = new HttpRequest();
+
+		HTTPStats::instance().resetStats();
+
+		mStatus = HttpStatus(200);
+		int issued(0);
+		const int loads[] = { 64, 256 };
+		for (int load : loads)
+		{
+			for (int i(0); i < load; ++i)
+			{
+				HttpHandle handle = req->requestGet(HttpRequest::DEFAULT_POLICY_ID,
+													url_base,
+													HttpOptions::ptr_t(),
+													HttpHeaders::ptr_t(),
+													handlerp);
+				ensure("Valid handle returned for multiplexed request", handle != LLCORE_HTTP_HANDLE_INVALID);
+			}
+			issued += load;
+
+			// Run the notification pump.
+			int count(0);
+			int limit(LOOP_COUNT_LONG);
+			while (count++ < limit && mHandlerCalls < issued)
+			{
+				req->update(1000000);
+				usleep(LOOP_SLEEP_INTERVAL);
+			}
+			ensure("Requests executed in reasonable time", count < limit);
+			ensure("One handler invocation per request", mHandlerCalls == issued);
+		}
+
+		// Okay, request a shutdown of the servicing thread
+		mStatus = HttpStatus();
+		HttpHandle handle = req->requestStopThread(handlerp);
+		ensure("Valid handle returned for stop request", handle != LLCORE_HTTP_HANDLE_INVALID);
+
+		// Run the notification pump again
+		int count(0);
+		int limit(LOOP_COUNT_LONG);
+		while (count++ < limit && mHandlerCalls < issued + 1)
+		{
+			req->update(1000000);
+			usleep(LOOP_SLEEP_INTERVAL);
+		}
+		ensure("Stop request executed in reasonable time", count < limit);
+		ensure("Stop handler invocation", mHandlerCalls == issued + 1);
+
+		// See that we actually shutdown the thread
+		count = 0;
+		limit = LOOP_COUNT_SHORT;
+		while (count++ < limit && ! HttpService::isStopped())
+		{
+			usleep(LOOP_SLEEP_INTERVAL);
+		}
+		ensure("Thread actually stopped running", HttpService::isStopped());
+
+		// Worker is gone, the counts can be read safely
+		const HTTPStats::TransportStats stats(HTTPStats::instance().getTransportStats());
+		ensure("Every request counted", stats.mTransfers == issued);
+		ensure("No HTTP/2 from an HTTP/1.1 service", 0 == stats.mHttp2);
+		ensure("Every request fell back", stats.mFallbacks == issued);
+		ensure("Connections opened or reused for every request", stats.mConnects + stats.mReused >= issued);
+
+		// release the request object
+		delete req;
+		req = NULL;
+
+		// Shut down service
+		HttpRequest::destroyService();
+	}
+	catch (...)
+	{
+		stop_thread(req);
+		delete req;
+		HttpRequest::destroyService();
+		throw;
+	}
+}
+
+
+template <> template <>
+void HttpRequestTestObjectType::test<25>()
+{
+	ScopedCurlInit ready;
+
+	set_test_name("HttpRequest PO_MULTIPLEX_STREAMS policy class option");
+
+	TestHandler2 handler(this, "handler");
+    LLCore::HttpHandler::ptr_t handlerp(&handler, NoOpDeletor);
+	mHandlerCalls = 0;
+
+	HttpRequest * req = NULL;
+
+	try
+	{
+        // Get singletons created
+		HttpRequest::createService();
+		HttpService * service(HttpService::instanceOf());
+
+		HttpRequest::policy_t multiplexed(HttpRequest::createPolicyClass());
+		ensure("Policy class created", multiplexed != HttpRequest::INVALID_POLICY_ID);
+
+		long streams(-1L);
+		HttpStatus status = service->getPolicy().getClassOptions(multiplexed).get(HttpRequest::PO_MULTIPLEX_STREAMS, &streams);
+		ensure("Multiplexing readable on a class", bool(status));
+		ensure("Multiplexing off by default", 0L == streams);
+
+		status = HttpRequest::setStaticPolicyOption(HttpRequest::PO_MULTIPLEX_STREAMS, multiplexed,
+													1000L, &streams);
+		ensure("Multiplexing set on the class", bool(status));
+		ensure("Stream count clamped to the maximum", 256L == streams);
+
+		status = HttpRequest::setStaticPolicyOption(HttpRequest::PO_MULTIPLEX_STREAMS, multiplexed,
+													-4L, &streams);
+		ensure("Negative stream count accepted", bool(status));
+		ensure("Negative stream count clamped to off", 0L == streams);
+
+		status = HttpRequest::setStaticPolicyOption(HttpRequest::PO_MULTIPLEX_STREAMS, multiplexed,
+													32L, &streams);
+		ensure("Multiplexing set again", bool(status) && 32L == streams);
+
+		status = HttpRequest::setStaticPolicyOption(HttpRequest::PO_MULTIPLEX_STREAMS,
+													HttpRequest::GLOBAL_POLICY_ID, 32L, NULL);
+		ensure("Multiplexing is not a global option", ! status);
+
+		std::string str_value;
+		status = HttpRequest::setStaticPolicyOption(HttpRequest::PO_MULTIPLEX_STREAMS, multiplexed,
+													std::string("32"), &str_value);
+		ensure("Multiplexing is not a string option", ! status);
+
+		status = service->getPolicy().getClassOptions(HttpRequest::DEFAULT_POLICY_ID).get(HttpRequest::PO_MULTIPLEX_STREAMS, &streams);
+		ensure("Other classes untouched", bool(status) && 0L == streams);
+
+		HttpRequest::startThread();
+
+		// The transport picks the option up from the class
+		HttpLibcurl & transport(service->getTransport());
+		ensure("Multiplexing class multiplexes", transport.isMultiplexing(multiplexed));
+		ensure("Other class does not", ! transport.isMultiplexing(HttpRequest::DEFAULT_POLICY_ID));
+		ensure("Not active before any HTTP/2 response", ! transport.isMultiplexActive(multiplexed));
+
+		// create a new ref counted object with an implicit reference
+		req = new HttpRequest();
+
+		// Okay, request a shutdown of the servicing thread
+		mStatus = HttpStatus();
+		HttpHandle handle = req->requestStopThread(handlerp);
+		ensure("Valid handle returned for stop request", handle != LLCORE_HTTP_HANDLE_INVALID);
+
+		// Run the notification pump.
+		int count(0);
+		int limit(LOOP_COUNT_SHORT);
+		while (count++ < limit && mHandlerCalls < 1)
+		{
+			req->update(1000000);
+			usleep(LOOP_SLEEP_INTERVAL);
+		}
+		ensure("Stop request executed in reasonable time", count < limit);
+
+		// See that we actually shutdown the thread
+		count = 0;
+		limit = LOOP_COUNT_SHORT;
+		while (count++ < limit && ! HttpService::isStopped())
+		{
+			usleep(LOOP_SLEEP_INTERVAL);
+		}
+		ensure("Thread actually stopped running", HttpService::isStopped());
+
+		// release the request object
+		delete req;
+		req = NULL;
+
+		// Shut down service
+		HttpRequest::destroyService();
+	}
+	catch (...)
+	{
+		stop_thread(req);
+		delete req;
+		HttpRequest::destroyService();
+		throw;
+	}
+}
+
+template <> template <>
+void HttpRequestTestObjectType::test<26>()
+{
+	set_test_name("HTTPStats transport counters");
+
+	HTTPStats::instance().resetStats();
+
+	// class, new connections, succeeded, HTTP/2, fallback
+	HTTPStats::instance().recordTransport(1, 1, true, true, false);		// opened a connection
+	HTTPStats::instance().recordTransport(1, 0, true, true, false);		// reused it
+	HTTPStats::instance().recordTransport(1, 0, false, false, true);	// failed, not a reuse
+	HTTPStats::instance().recordTransport(2, 0, true, false, true);		// reused, HTTP/1.1 fallback
+
+	const HTTPStats::TransportStats stats(HTTPStats::instance().getTransportStats());
+	ensure_equals("Transfers", stats.mTransfers, 4);
+	ensure_equals("Connections opened", stats.mConnects, 1);
+	ensure_equals("Only successful transfers reuse", stats.mReused, 2);
+	ensure_equals("HTTP/2 transfers", stats.mHttp2, 2);
+	ensure_equals("Fallbacks", stats.mFallbacks, 2);
+
+	HTTPStats::instance().resetStats();
+	ensure_equals("Reset", HTTPStats::instance().getTransportStats().mTransfers, 0);
+}
+
+
 }  // end namespace tut
 
 namespace
@@ -294,6 +294,21 @@ void HttpStatusTestObjectType::test<8>()
 	ensure("Undecodable error 65535", msg == "Unknown_65535");
 }
 
+
+template <> template <>
+void HttpStatusTestObjectType::test<9>()
+{
+	set_test_name("HttpStatus isRetryable() leaves HTTP/2 errors to the policy");
+
+	ensure("Timeout retryable", HttpStatus(HttpStatus::EXT_CURL_EASY, CURLE_OPERATION_TIMEDOUT).isRetryable());
+	ensure("503 retryable", HttpStatus(503).isRetryable());
+	ensure("404 not retryable", ! HttpStatus(404).isRetryable());
+
+	// Only a multiplexing class retries these, over HTTP/1.1
+	ensure("HTTP/2 error not retryable", ! HttpStatus(HttpStatus::EXT_CURL_EASY, CURLE_HTTP2).isRetryable());
+	ensure("HTTP/2 stream error not retryable", ! HttpStatus(HttpStatus::EXT_CURL_EASY, CURLE_HTTP2_STREAM).isRetryable());
+}
+
 } // end namespace tut
 
 #endif	// TEST_HTTP_STATUS_H
@@ -41,12 +41,18 @@
 #include "lldiskcache.h"
 
 const std::string DISK_CACHE_DIR_NAME = "cache";
+const std::string DISK_CACHE_JOURNAL_NAME = "index.journal";
 
 LLDiskCache::LLDiskCache()
 {
 }
 
-void LLDiskCache::init(ELLPath location, const uintmax_t max_size_bytes, const bool enable_cache_debug_info, const bool cache_version_mismatch)
+LLDiskCache::~LLDiskCache()
+{
+    flushIndex();
+}
+
+void LLDiskCache::init(ELLPath location, const uintmax_t max_size_bytes, const bool enable_cache_debug_info, const bool cache_version_mismatch, const bool use_index, const U32 pack_max_asset_size)
 {
     mMaxSizeBytes = max_size_bytes;
     mEnableCacheDebugInfo = enable_cache_debug_info;
@@ -58,9 +64,63 @@ void LLDiskCache::init(ELLPath location, const uintmax_t max_size_bytes, const b
     }
 
     createCache();
+
+    // A read only instance can not keep the journal up to date, so it
+    // sticks with the directory walk.
+    if (use_index && !mReadOnly)
+    {
+        auto start_time = std::chrono::high_resolution_clock::now();
+
+        mPackMaxAssetSize = pack_max_asset_size;
+        if (mPackMaxAssetSize > 0)
+        {
+            openPack();
+        }
+
+        mIndex = std::make_unique<LLDiskCacheIndex>(mCacheDir + gDirUtilp->getDirDelimiter() + DISK_CACHE_JOURNAL_NAME);
+        if (!mIndex->load())
+        {
+            // The directory walk only finds the loose files
+            std::vector<LLDiskCacheIndex::Entry> packed;
+            if (std::shared_ptr<LLDiskCachePack> pack = getPack())
+            {
+                pack->getAssets(packed);
+            }
+            mIndex->rebuild(mCacheDir, mCacheFilenameExt, packed);
+        }
+
+        auto end_time = std::chrono::high_resolution_clock::now();
+        LL_INFOS() << "Disk cache index ready with " << mIndex->getEntryCount() << " entries in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count() << " ms" << LL_ENDL;
+    }
+    else if (!mReadOnly)
+    {
+        // Don't leave a stale journal behind for the next indexed session.
+        // A read only instance leaves it alone, it belongs to the instance
+        // that owns the cache.
+        LLFile::remove(mCacheDir + gDirUtilp->getDirDelimiter() + DISK_CACHE_JOURNAL_NAME, ENOENT);
+    }
 }
 
 
+void LLDiskCache::openPack()
+{
+    auto pack = std::make_shared<LLDiskCachePack>(mCacheDir + gDirUtilp->getDirDelimiter(), mPackMaxAssetSize);
+    if (!pack->open())
+    {
+        pack.reset();
+    }
+
+    LLMutexLock lock(&mPackMutex);
+    mPack = std::move(pack);
+}
+
+std::shared_ptr<LLDiskCachePack> LLDiskCache::getPack() const
+{
+    LLMutexLock lock(&mPackMutex);
+    return mPack;
+}
+
 void LLDiskCache::createCache()
 {
     LLFile::mkdir(mCacheDir);
@@ -103,6 +163,12 @@ void LLDiskCache::purge()
 {
     if (mReadOnly) return;
 
+    if (mIndex)
+    {
+        purgeIndexed();
+        return;
+    }
+
     if (mEnableCacheDebugInfo)
     {
         LL_INFOS() << "Total dir size before purge is " << dirFileSize(mCacheDir) << LL_ENDL;
@@ -230,6 +296,118 @@ void LLDiskCache::purge()
     }
 }
 
+void LLDiskCache::purgeIndexed()
+{
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    std::vector<LLDiskCacheIndex::Entry> evicted;
+    mIndex->evict(mMaxSizeBytes, evicted);
+
+    std::shared_ptr<LLDiskCachePack> pack = getPack();
+    boost::system::error_code ec;
+    for (const LLDiskCacheIndex::Entry& entry : evicted)
+    {
+        if (!LLApp::isRunning())
+        {
+            break;
+        }
+
+        if (pack && pack->erase(entry.mID))
+        {
+            continue;
+        }
+
+        // The entries are already gone from the index; see the comment
+        // above purge() about racing with readers.
+        boost::filesystem::remove(metaDataToFilepath(entry.mID, entry.mType), ec);
+        if (ec.failed())
+        {
+            LL_WARNS() << "Failed to delete cache file " << entry.mID << ": " << ec.message() << LL_ENDL;
+        }
+    }
+
+    // Journal the removals only once the files are gone so that a crash in
+    // between leaves entries pointing at missing files rather than files
+    // that nothing knows about.
+    mIndex->flush();
+    if (pack)
+    {
+        pack->flush();
+    }
+
+    if (mEnableCacheDebugInfo)
+    {
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto execute_time = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+
+        for (const LLDiskCacheIndex::Entry& entry : evicted)
+        {
+            LL_INFOS() << "DELETE:  " << entry.mLastAccess << "  " << entry.mSize << "  " << entry.mID << LL_ENDL;
+        }
+
+        LL_INFOS() << "Indexed cache size after purge is " << mIndex->getTotalSize() << "/" << mMaxSizeBytes
+            << " in " << mIndex->getEntryCount() << " files" << LL_ENDL;
+        LL_INFOS() << "Cache purge took " << execute_time << " ms to evict " << evicted.size() << " files" << LL_ENDL;
+    }
+}
+
+void LLDiskCache::fileAccessed(const LLUUID& id, const boost::filesystem::path& file_path)
+{
+    if (mIndex)
+    {
+        mIndex->touch(id);
+        return;
+    }
+
+    // update the last access time for the file if it exists - this is required
+    // even though we are reading and not writing because this is the
+    // way the cache works - it relies on a valid "last accessed time" for
+    // each file so it knows how to remove the oldest, unused files
+    boost::system::error_code ec;
+    bool exists = boost::filesystem::exists(file_path, ec);
+    if (exists && !ec.failed())
+    {
+        updateFileAccessTime(file_path);
+    }
+}
+
+void LLDiskCache::fileWritten(const LLUUID& id, LLAssetType::EType at, uintmax_t size)
+{
+    if (mIndex)
+    {
+        mIndex->insert(id, at, size);
+    }
+}
+
+void LLDiskCache::fileRemoved(const LLUUID& id)
+{
+    if (mIndex)
+    {
+        mIndex->erase(id);
+    }
+}
+
+void LLDiskCache::fileRenamed(const LLUUID& old_id, const LLUUID& new_id, LLAssetType::EType new_type)
+{
+    if (mIndex)
+    {
+        mIndex->rename(old_id, new_id, new_type);
+    }
+}
+
+void LLDiskCache::flushIndex()
+{
+    if (mIndex)
+    {
+        mIndex->flush();
+    }
+
+    if (std::shared_ptr<LLDiskCachePack> pack = getPack())
+    {
+        pack->flush();
+    }
+}
+
 //static
 const std::string LLDiskCache::assetTypeToString(LLAssetType::EType at)
 {
@@ -337,18 +515,41 @@ void LLDiskCache::updateFileAccessTime(const boost::filesystem::path& file_path)
 
 const std::string LLDiskCache::getCacheInfo()
 {
-    uintmax_t cache_used_mb = dirFileSize(mCacheDir) / (1024U * 1024U);
+    uintmax_t cache_used_mb = (mIndex ? mIndex->getTotalSize() : dirFileSize(mCacheDir)) / (1024U * 1024U);
 
     uintmax_t max_in_mb = mMaxSizeBytes / (1024U * 1024U);
     F64 percent_used = ((F64)cache_used_mb / (F64)max_in_mb) * 100.0;
 
-    return llformat("%juMB / %juMB (%.1f%% used)", cache_used_mb, max_in_mb, percent_used);
+    std::string info = llformat("%juMB / %juMB (%.1f%% used)", cache_used_mb, max_in_mb, percent_used);
+    if (std::shared_ptr<LLDiskCachePack> pack = getPack())
+    {
+        info += ", " + pack->getInfo();
+    }
+    return info;
 }
 
 void LLDiskCache::clearCache(ELLPath location, bool recreate_cache)
 {
     if (!mReadOnly)
     {
+        if (mIndex)
+        {
+            mIndex->reset();
+        }
+
+        // The pack files are about to be deleted. Closing the pack makes
+        // any thread still holding it fall back to loose files instead of
+        // writing into deleted segments.
+        std::shared_ptr<LLDiskCachePack> pack;
+        {
+            LLMutexLock lock(&mPackMutex);
+            pack.swap(mPack);
+        }
+        if (pack)
+        {
+            pack->close();
+        }
+
         std::string disk_cache_dir = gDirUtilp->getExpandedFilename(location, DISK_CACHE_DIR_NAME);
 
         const char* subdirs = "0123456789abcdef";
@@ -371,6 +572,12 @@ void LLDiskCache::clearCache(ELLPath location, bool recreate_cache)
         {
             createCache();
         }
+
+        // Keep packing for the rest of the session
+        if (pack)
+        {
+            openPack();
+        }
     }
 }
 
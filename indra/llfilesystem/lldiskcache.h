@@ -36,6 +36,14 @@
  *    the same sized directory of files, writing the last updated
  *    time to each took less than 600ms indicating that this
  *    important part of the mechanism has almost no overhead.
+ * 6/ For very large caches the directory walk in 3/ and the
+ *    timestamp writes in 2/ become the bottleneck, so an optional
+ *    indexed mode keeps sizes and access order in memory backed by
+ *    an append-only journal (see LLDiskCacheIndex). A purge then only
+ *    visits the files it deletes and reads never touch file metadata.
+ * 7/ In indexed mode small assets can also be stored in a handful of
+ *    large pack files (see LLDiskCachePack) to avoid one file open
+ *    and one set of filesystem metadata per asset.
  *
  * $LicenseInfo:firstyear=2009&license=viewerlgpl$
  * Second Life Viewer Source Code
@@ -65,6 +73,8 @@
 #include "llsingleton.h"
 #include "lluuid.h"
 #include "lldir.h"
+#include "lldiskcacheindex.h"
+#include "lldiskcachepack.h"
 
 #include "boost/unordered/unordered_flat_set.hpp"
 
@@ -80,7 +90,7 @@ class LLDiskCache final :
          * the class via a call in LLAppViewer.
          */
         LLDiskCache();
-        virtual ~LLDiskCache() = default;
+        virtual ~LLDiskCache();
 public:
         void init(                    
             /**
@@ -101,7 +111,19 @@ class LLDiskCache final :
             /**
              * Cache version mismatch purge
              */
-            const bool cache_version_mismatch);
+            const bool cache_version_mismatch,
+            /**
+             * Track file sizes and access order in an in-memory index
+             * backed by a journal instead of walking the cache directory
+             * and updating file timestamps
+             */
+            const bool use_index = false,
+            /**
+             * Store assets up to this many bytes in pack files instead of
+             * loose files. Zero disables packing; packing also requires
+             * use_index since packed assets are evicted through the index.
+             */
+            const U32 pack_max_asset_size = 0);
 
         /**
          * Construct a filename and path to it based on the file meta data
@@ -120,6 +142,36 @@ class LLDiskCache final :
          */
         static void updateFileAccessTime(const boost::filesystem::path& file_path);
 
+        /**
+         * Notify the cache that a file was read, written, removed or renamed.
+         * In indexed mode these update the index and journal; otherwise
+         * fileAccessed() falls back to updateFileAccessTime() and the others
+         * do nothing.
+         */
+        void fileAccessed(const LLUUID& id, const boost::filesystem::path& file_path);
+        void fileWritten(const LLUUID& id, LLAssetType::EType at, uintmax_t size);
+        void fileRemoved(const LLUUID& id);
+        void fileRenamed(const LLUUID& old_id, const LLUUID& new_id, LLAssetType::EType new_type);
+
+        /**
+         * True when the cache is running with an index (see init())
+         */
+        bool isIndexed() const { return mIndex != nullptr; }
+
+        /**
+         * Pack file storage for small assets, null when packing is disabled.
+         * Callers keep the returned pointer only for the operation at hand;
+         * clearCache() closes the pack and puts a fresh one in its place, a
+         * closed pack refuses every request.
+         */
+        std::shared_ptr<LLDiskCachePack> getPack() const;
+
+        /**
+         * Write any buffered index and pack changes to disk. Called from the
+         * purge thread and on shutdown.
+         */
+        void flushIndex();
+
         /**
          * Purge the oldest items in the cache so that the combined size of all files
          * is no bigger than mMaxSizeBytes.
@@ -168,6 +220,16 @@ class LLDiskCache final :
          */
         void createCache();
 
+        /**
+         * purge() for indexed mode. Only the evicted files are touched.
+         */
+        void purgeIndexed();
+
+        /**
+         * Open the pack files and make them the current pack. Packing stays
+         * off if they can not be opened.
+         */
+        void openPack();
 
     private:
         /**
@@ -202,6 +264,25 @@ class LLDiskCache final :
         bool mEnableCacheDebugInfo = false;
 
         bool mReadOnly = false;
+
+        /**
+         * Size and access order of the cache files when running in
+         * indexed mode, null otherwise
+         */
+        std::unique_ptr<LLDiskCacheIndex> mIndex;
+
+        /**
+         * Pack file storage for small assets, see getPack(). Guarded by
+         * mPackMutex since clearCache() may replace it while other threads
+         * are using it.
+         */
+        std::shared_ptr<LLDiskCachePack> mPack;
+        mutable LLMutex mPackMutex;
+
+        /**
+         * Largest asset the pack takes, 0 when packing is disabled
+         */
+        U32 mPackMaxAssetSize = 0;
 };
 
 class LLPurgeDiskCacheThread : public LLThread
@@ -0,0 +1,608 @@
+/**
+ * @file lldiskcacheindex.cpp
+ * @brief In-memory LRU index and append-only journal for the disk cache.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "lldiskcacheindex.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/range/iterator_range.hpp>
+
+#include <algorithm>
+#include <ctime>
+
+namespace
+{
+    constexpr char JOURNAL_MAGIC[8] = { 'A', 'L', 'D', 'C', 'J', 'R', 'N', 'L' };
+    constexpr U32 JOURNAL_VERSION = 1;
+
+    // Number of records read or written per fread()/fwrite() call
+    constexpr size_t JOURNAL_IO_BATCH = 4096;
+
+    // The journal is compacted once it holds more than
+    // JOURNAL_COMPACT_FACTOR records per live entry, plus some slack so
+    // that small caches are not compacted on every flush.
+    constexpr size_t JOURNAL_COMPACT_FACTOR = 4;
+    constexpr size_t JOURNAL_COMPACT_SLACK = 16384;
+
+    // Buffered records are appended once there are this many, which bounds
+    // what a crash can lose without opening the journal on every change.
+    constexpr size_t JOURNAL_FLUSH_RECORDS = 512;
+
+    U32 now()
+    {
+        return (U32)std::time(nullptr);
+    }
+
+    boost::filesystem::path to_path(const std::string& filename)
+    {
+#if LL_WINDOWS
+        return boost::filesystem::path(ll_convert_string_to_wide(filename));
+#else
+        return boost::filesystem::path(filename);
+#endif
+    }
+}
+
+LLDiskCacheIndex::LLDiskCacheIndex(const std::string& journal_path)
+    : mJournalPath(journal_path)
+{
+}
+
+bool LLDiskCacheIndex::load()
+{
+    LLMutexLock file_lock(&mFileMutex);
+    LLMutexLock lock(&mMutex);
+
+    mLRU.clear();
+    mLookup.clear();
+    mPending.clear();
+    mTotalSize = 0;
+    mJournalRecords = 0;
+
+    LLFILE* file = LLFile::fopen(mJournalPath, "rb");
+    if (!file)
+    {
+        LL_INFOS("DiskCache") << "No disk cache journal found at " << mJournalPath << LL_ENDL;
+        return false;
+    }
+
+    Header header;
+    if (fread(&header, sizeof(Header), 1, file) != 1
+        || memcmp(header.mMagic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0
+        || header.mVersion != JOURNAL_VERSION
+        || header.mRecordSize != sizeof(Record))
+    {
+        LL_WARNS("DiskCache") << "Disk cache journal " << mJournalPath << " has an unknown format" << LL_ENDL;
+        LLFile::close(file);
+        return false;
+    }
+
+    bool valid = true;
+    bool torn = false;
+    std::vector<Record> records(JOURNAL_IO_BATCH);
+    while (valid)
+    {
+        size_t bytes_read = fread(records.data(), 1, records.size() * sizeof(Record), file);
+        size_t count = bytes_read / sizeof(Record);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const Record& record = records[i];
+            LLUUID id;
+            memcpy(id.mData, record.mID, UUID_BYTES);
+            switch (record.mOp)
+            {
+            case OP_INSERT:
+                applyInsert(id, (LLAssetType::EType)record.mType, record.mSize, record.mTime);
+                break;
+            case OP_TOUCH:
+                applyTouch(id, record.mTime);
+                break;
+            case OP_ERASE:
+                applyErase(id);
+                break;
+            default:
+                valid = false;
+                break;
+            }
+            if (!valid)
+            {
+                break;
+            }
+        }
+        mJournalRecords += count;
+
+        if (bytes_read < records.size() * sizeof(Record))
+        {
+            // A partial record at the end means we crashed in the middle of
+            // an append. Everything before it is still good.
+            torn = (bytes_read % sizeof(Record)) != 0;
+            break;
+        }
+    }
+    LLFile::close(file);
+
+    if (!valid)
+    {
+        LL_WARNS("DiskCache") << "Disk cache journal " << mJournalPath << " is corrupt" << LL_ENDL;
+        mLRU.clear();
+        mLookup.clear();
+        mTotalSize = 0;
+        mJournalRecords = 0;
+        return false;
+    }
+
+    if (torn)
+    {
+        // Appending after a partial record would misalign everything that
+        // follows, so start over with a clean snapshot.
+        LL_WARNS("DiskCache") << "Disk cache journal " << mJournalPath << " ends with a partial record, compacting" << LL_ENDL;
+        writeSnapshot();
+    }
+
+    LL_INFOS("DiskCache") << "Loaded disk cache index with " << mLookup.size() << " entries totaling "
+        << mTotalSize << " bytes from " << mJournalRecords << " journal records" << LL_ENDL;
+    return true;
+}
+
+void LLDiskCacheIndex::rebuild(const std::string& cache_dir, const std::string& file_ext, const std::vector<Entry>& packed)
+{
+    typedef std::pair<std::time_t, Entry> file_info_t;
+    std::vector<file_info_t> file_info;
+    file_info.reserve(packed.size());
+    for (const Entry& entry : packed)
+    {
+        file_info.emplace_back((std::time_t)entry.mLastAccess, entry);
+    }
+
+    boost::system::error_code ec;
+    boost::filesystem::path cache_path(to_path(cache_dir));
+    if (boost::filesystem::is_directory(cache_path, ec) && !ec.failed())
+    {
+        boost::filesystem::recursive_directory_iterator dir_iter(cache_path, ec);
+        if (!ec.failed())
+        {
+            for (auto& dir_entry : boost::make_iterator_range(dir_iter, {}))
+            {
+                ec.clear();
+                if (!boost::filesystem::is_regular_file(dir_entry, ec) || ec.failed())
+                {
+                    continue;
+                }
+
+                const boost::filesystem::path& path = dir_entry.path();
+                if (path.extension().string() != file_ext)
+                {
+                    continue;
+                }
+
+                Entry entry;
+                if (!entry.mID.set(path.stem().string(), FALSE))
+                {
+                    continue;
+                }
+
+                entry.mSize = boost::filesystem::file_size(dir_entry, ec);
+                if (ec.failed())
+                {
+                    continue;
+                }
+
+                const std::time_t file_time = boost::filesystem::last_write_time(dir_entry, ec);
+                if (ec.failed())
+                {
+                    continue;
+                }
+
+                entry.mType = LLAssetType::AT_UNKNOWN;
+                entry.mLastAccess = (U32)file_time;
+                file_info.emplace_back(file_time, entry);
+            }
+        }
+    }
+
+    // Oldest first so that the newest file ends up at the front of the LRU
+    std::sort(file_info.begin(), file_info.end(), [](const file_info_t& x, const file_info_t& y)
+    {
+        return x.first < y.first;
+    });
+
+    LLMutexLock file_lock(&mFileMutex);
+    LLMutexLock lock(&mMutex);
+
+    mLRU.clear();
+    mLookup.clear();
+    mPending.clear();
+    mTotalSize = 0;
+    mLookup.reserve(file_info.size());
+    for (const file_info_t& info : file_info)
+    {
+        // A crash can leave a loose copy behind an asset that was packed
+        // since, both take up space
+        uintmax_t size = info.second.mSize;
+        auto iter = mLookup.find(info.second.mID);
+        if (iter != mLookup.end())
+        {
+            size += iter->second->mSize;
+        }
+        applyInsert(info.second.mID, info.second.mType, size, info.second.mLastAccess);
+    }
+
+    LL_INFOS("DiskCache") << "Rebuilt disk cache index from " << cache_dir << " and " << packed.size() << " packed assets with "
+        << mLookup.size() << " entries totaling " << mTotalSize << " bytes" << LL_ENDL;
+
+    writeSnapshot();
+}
+
+void LLDiskCacheIndex::reset()
+{
+    LLMutexLock file_lock(&mFileMutex);
+    LLMutexLock lock(&mMutex);
+
+    mLRU.clear();
+    mLookup.clear();
+    mPending.clear();
+    mTotalSize = 0;
+    mJournalRecords = 0;
+    mEvictPending = false;
+
+    LLFile::remove(mJournalPath, ENOENT);
+}
+
+// The changes below append through flush() once enough records are
+// buffered. flush() takes mFileMutex before mMutex, so it is only called
+// after the index lock has been released.
+
+void LLDiskCacheIndex::touch(const LLUUID& id)
+{
+    bool needs_flush = false;
+    {
+        LLMutexLock lock(&mMutex);
+
+        const U32 time = now();
+        if (applyTouch(id, time))
+        {
+            appendRecord(OP_TOUCH, id, LLAssetType::AT_NONE, 0, time);
+            needs_flush = needsFlush();
+        }
+    }
+
+    if (needs_flush)
+    {
+        flush();
+    }
+}
+
+void LLDiskCacheIndex::insert(const LLUUID& id, LLAssetType::EType type, uintmax_t size)
+{
+    bool needs_flush = false;
+    {
+        LLMutexLock lock(&mMutex);
+
+        const U32 time = now();
+        applyInsert(id, type, size, time);
+        appendRecord(OP_INSERT, id, type, size, time);
+        needs_flush = needsFlush();
+    }
+
+    if (needs_flush)
+    {
+        flush();
+    }
+}
+
+void LLDiskCacheIndex::erase(const LLUUID& id)
+{
+    bool needs_flush = false;
+    {
+        LLMutexLock lock(&mMutex);
+
+        if (applyErase(id))
+        {
+            appendRecord(OP_ERASE, id, LLAssetType::AT_NONE, 0, now());
+            needs_flush = needsFlush();
+        }
+    }
+
+    if (needs_flush)
+    {
+        flush();
+    }
+}
+
+void LLDiskCacheIndex::rename(const LLUUID& old_id, const LLUUID& new_id, LLAssetType::EType new_type)
+{
+    bool needs_flush = false;
+    {
+        LLMutexLock lock(&mMutex);
+
+        auto iter = mLookup.find(old_id);
+        if (iter == mLookup.end())
+        {
+            // The rename still replaced whatever was at new_id
+            if (applyErase(new_id))
+            {
+                appendRecord(OP_ERASE, new_id, LLAssetType::AT_NONE, 0, now());
+            }
+        }
+        else
+        {
+            const uintmax_t size = iter->second->mSize;
+            const U32 time = now();
+            applyErase(old_id);
+            appendRecord(OP_ERASE, old_id, LLAssetType::AT_NONE, 0, time);
+            applyInsert(new_id, new_type, size, time);
+            appendRecord(OP_INSERT, new_id, new_type, size, time);
+        }
+        needs_flush = needsFlush();
+    }
+
+    if (needs_flush)
+    {
+        flush();
+    }
+}
+
+void LLDiskCacheIndex::evict(uintmax_t max_size_bytes, std::vector<Entry>& evicted)
+{
+    LLMutexLock lock(&mMutex);
+
+    const U32 time = now();
+    while (mTotalSize > max_size_bytes && !mLRU.empty())
+    {
+        const Entry& entry = mLRU.back();
+        evicted.push_back(entry);
+        appendRecord(OP_ERASE, entry.mID, LLAssetType::AT_NONE, 0, time);
+        mTotalSize -= entry.mSize;
+        mLookup.erase(entry.mID);
+        mLRU.pop_back();
+        mEvictPending = true;
+    }
+}
+
+void LLDiskCacheIndex::flush()
+{
+    LLMutexLock file_lock(&mFileMutex);
+
+    std::vector<Record> records;
+    {
+        LLMutexLock lock(&mMutex);
+        mEvictPending = false;
+        if (mPending.empty())
+        {
+            return;
+        }
+
+        if (mJournalRecords + mPending.size() > mLookup.size() * JOURNAL_COMPACT_FACTOR + JOURNAL_COMPACT_SLACK)
+        {
+            writeSnapshot();
+            return;
+        }
+
+        records.swap(mPending);
+    }
+
+    // The index lock is released here so that readers are not held up by
+    // disk I/O. mFileMutex keeps other flushes and snapshots from
+    // interleaving with this append.
+    LLFILE* file = LLFile::fopen(mJournalPath, "ab");
+    if (!file)
+    {
+        LL_WARNS("DiskCache") << "Unable to open disk cache journal " << mJournalPath << " for append" << LL_ENDL;
+        LLMutexLock lock(&mMutex);
+        restorePending(records);
+        return;
+    }
+
+    bool success = fseek(file, 0, SEEK_END) == 0;
+    const long journal_end = success ? ftell(file) : -1;
+    success = journal_end >= 0;
+    if (success && journal_end == 0)
+    {
+        Header header;
+        memcpy(header.mMagic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+        header.mVersion = JOURNAL_VERSION;
+        header.mRecordSize = sizeof(Record);
+        success = fwrite(&header, sizeof(Header), 1, file) == 1;
+    }
+
+    if (success)
+    {
+        success = fwrite(records.data(), sizeof(Record), records.size(), file) == records.size();
+    }
+    success = LLFile::close(file) == 0 && success;
+
+    if (!success && journal_end >= 0)
+    {
+        // Cut off whatever part of the append made it out, so that the
+        // retry doesn't follow a partial record
+        boost::system::error_code ec;
+        boost::filesystem::resize_file(to_path(mJournalPath), (uintmax_t)journal_end, ec);
+    }
+
+    LLMutexLock lock(&mMutex);
+    if (success)
+    {
+        mJournalRecords += records.size();
+    }
+    else
+    {
+        LL_WARNS("DiskCache") << "Failed to append to disk cache journal " << mJournalPath << LL_ENDL;
+        restorePending(records);
+    }
+}
+
+bool LLDiskCacheIndex::contains(const LLUUID& id)
+{
+    LLMutexLock lock(&mMutex);
+    return mLookup.find(id) != mLookup.end();
+}
+
+uintmax_t LLDiskCacheIndex::getTotalSize()
+{
+    LLMutexLock lock(&mMutex);
+    return mTotalSize;
+}
+
+size_t LLDiskCacheIndex::getEntryCount()
+{
+    LLMutexLock lock(&mMutex);
+    return mLookup.size();
+}
+
+void LLDiskCacheIndex::applyInsert(const LLUUID& id, LLAssetType::EType type, uintmax_t size, U32 time)
+{
+    auto iter = mLookup.find(id);
+    if (iter != mLookup.end())
+    {
+        Entry& entry = *iter->second;
+        mTotalSize -= entry.mSize;
+        entry.mType = type;
+        entry.mSize = size;
+        entry.mLastAccess = time;
+        mLRU.splice(mLRU.begin(), mLRU, iter->second);
+    }
+    else
+    {
+        mLRU.push_front(Entry{ id, type, size, time });
+        mLookup.emplace(id, mLRU.begin());
+    }
+    mTotalSize += size;
+}
+
+bool LLDiskCacheIndex::applyTouch(const LLUUID& id, U32 time)
+{
+    auto iter = mLookup.find(id);
+    if (iter == mLookup.end())
+    {
+        return false;
+    }
+
+    iter->second->mLastAccess = time;
+    mLRU.splice(mLRU.begin(), mLRU, iter->second);
+    return true;
+}
+
+bool LLDiskCacheIndex::applyErase(const LLUUID& id)
+{
+    auto iter = mLookup.find(id);
+    if (iter == mLookup.end())
+    {
+        return false;
+    }
+
+    mTotalSize -= iter->second->mSize;
+    mLRU.erase(iter->second);
+    mLookup.erase(iter);
+    return true;
+}
+
+void LLDiskCacheIndex::appendRecord(EOp op, const LLUUID& id, LLAssetType::EType type, uintmax_t size, U32 time)
+{
+    Record& record = mPending.emplace_back();
+    record.mOp = op;
+    record.mType = (S8)type;
+    record.mPad[0] = record.mPad[1] = 0;
+    record.mTime = time;
+    record.mSize = (U64)size;
+    memcpy(record.mID, id.mData, UUID_BYTES);
+}
+
+// Called with mMutex held
+void LLDiskCacheIndex::restorePending(std::vector<Record>& records)
+{
+    // Ahead of anything buffered since, so the next flush keeps the order
+    records.insert(records.end(), mPending.begin(), mPending.end());
+    mPending.swap(records);
+}
+
+// Called with mMutex held
+bool LLDiskCacheIndex::needsFlush() const
+{
+    return mPending.size() >= JOURNAL_FLUSH_RECORDS && !mEvictPending;
+}
+
+// Called with both mFileMutex and mMutex held
+bool LLDiskCacheIndex::writeSnapshot()
+{
+    const std::string temp_path = mJournalPath + ".tmp";
+    LLFILE* file = LLFile::fopen(temp_path, "wb");
+    if (!file)
+    {
+        LL_WARNS("DiskCache") << "Unable to create disk cache journal " << temp_path << LL_ENDL;
+        return false;
+    }
+
+    Header header;
+    memcpy(header.mMagic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    header.mVersion = JOURNAL_VERSION;
+    header.mRecordSize = sizeof(Record);
+    bool success = fwrite(&header, sizeof(Header), 1, file) == 1;
+
+    // Least recently used first so that replaying the inserts recreates
+    // the same LRU order
+    std::vector<Record> records;
+    records.reserve(JOURNAL_IO_BATCH);
+    for (auto iter = mLRU.rbegin(); success && iter != mLRU.rend(); ++iter)
+    {
+        Record& record = records.emplace_back();
+        record.mOp = OP_INSERT;
+        record.mType = (S8)iter->mType;
+        record.mPad[0] = record.mPad[1] = 0;
+        record.mTime = iter->mLastAccess;
+        record.mSize = (U64)iter->mSize;
+        memcpy(record.mID, iter->mID.mData, UUID_BYTES);
+
+        if (records.size() == JOURNAL_IO_BATCH)
+        {
+            success = fwrite(records.data(), sizeof(Record), records.size(), file) == records.size();
+            records.clear();
+        }
+    }
+    if (success && !records.empty())
+    {
+        success = fwrite(records.data(), sizeof(Record), records.size(), file) == records.size();
+    }
+    LLFile::close(file);
+
+    boost::system::error_code ec;
+    if (success)
+    {
+        // boost::filesystem::rename replaces an existing journal atomically
+        // on every platform, unlike LLFile::rename on Windows.
+        boost::filesystem::rename(to_path(temp_path), to_path(mJournalPath), ec);
+    }
+
+    if (!success || ec.failed())
+    {
+        LL_WARNS("DiskCache") << "Failed to write disk cache journal " << mJournalPath << LL_ENDL;
+        LLFile::remove(temp_path, ENOENT);
+        return false;
+    }
+
+    mPending.clear();
+    mJournalRecords = mLookup.size();
+    return true;
+}
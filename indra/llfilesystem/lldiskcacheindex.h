@@ -0,0 +1,235 @@
+/**
+ * @file lldiskcacheindex.h
+ * @brief In-memory LRU index and append-only journal for the disk cache.
+ *
+ * @Description:
+ * The directory-walk purge in LLDiskCache has to stat every file in the
+ * cache to discover its size and last access time, then sort them all.
+ * With hundreds of thousands of cache files this costs seconds of I/O.
+ * This index keeps the same information in memory instead:
+ * 1/ Entries live in a doubly linked list ordered by last access, with
+ *    the most recently used entry at the front. A hash map keyed by the
+ *    asset ID gives O(1) lookup of the list node, so recording an access
+ *    is a splice and a purge only walks the entries it evicts.
+ * 2/ Every change is described by a fixed size record that is buffered
+ *    in memory and appended to a journal file next to the cache files.
+ *    The buffer is appended as soon as it holds a few hundred records,
+ *    so a crash loses at most that many changes rather than everything
+ *    since the last purge pass.
+ *    Nothing on disk is touched when a cache file is read, which also
+ *    takes care of the SSD write concern that led to the last access
+ *    time threshold in LLDiskCache::updateFileAccessTime().
+ * 3/ On startup the journal is replayed to rebuild the index. A torn
+ *    record at the end of the journal (crash while appending) is
+ *    ignored. If the journal is missing, has the wrong version or is
+ *    otherwise unreadable, the index is rebuilt from a single walk of
+ *    the cache directory and a fresh journal is written.
+ * 4/ The journal grows with every access, so once it holds a lot more
+ *    records than live entries it is compacted into a snapshot of the
+ *    current index, written to a temporary file and renamed over the
+ *    old journal so that a crash never leaves a half written journal.
+ *
+ * Cache files are named after the asset ID alone (see
+ * LLDiskCache::metaDataToFilepath()), so two asset types sharing an ID
+ * share a file; the index is therefore keyed on the ID and records the
+ * asset type of the last write for diagnostics.
+ *
+ * All public methods are thread safe.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLDISKCACHEINDEX_H
+#define LL_LLDISKCACHEINDEX_H
+
+#include "llassettype.h"
+#include "llmutex.h"
+#include "lluuid.h"
+
+#include "boost/unordered/unordered_flat_map.hpp"
+
+#include <list>
+#include <vector>
+
+class LLDiskCacheIndex
+{
+public:
+    struct Entry
+    {
+        LLUUID              mID;
+        LLAssetType::EType  mType;
+        uintmax_t           mSize;
+        U32                 mLastAccess;
+    };
+
+    /**
+     * The journal lives at journal_path. Nothing is read or written until
+     * load() or rebuild() is called.
+     */
+    LLDiskCacheIndex(const std::string& journal_path);
+    ~LLDiskCacheIndex() = default;
+
+    /**
+     * Replay the journal into the index. Returns false if there is no
+     * journal or it can not be trusted, in which case the index is left
+     * empty and the caller should rebuild() it.
+     */
+    bool load();
+
+    /**
+     * Throw away the current index and rebuild it by walking cache_dir for
+     * files ending in file_ext. Entries are ordered by their last write
+     * time, which is what the old purge used. Assets that are not loose
+     * files, the packed ones, are passed in packed and indexed alongside.
+     * A fresh journal is written afterwards.
+     */
+    void rebuild(const std::string& cache_dir, const std::string& file_ext,
+                 const std::vector<Entry>& packed = std::vector<Entry>());
+
+    /**
+     * Drop every entry and delete the journal. Used when the cache is
+     * cleared.
+     */
+    void reset();
+
+    /**
+     * Record that a cached file was read. Unknown IDs are ignored since
+     * there is no size to account for; the next write will add them.
+     */
+    void touch(const LLUUID& id);
+
+    /**
+     * Record that a cached file was written and now holds size bytes.
+     */
+    void insert(const LLUUID& id, LLAssetType::EType type, uintmax_t size);
+
+    /**
+     * Record that a cached file was removed.
+     */
+    void erase(const LLUUID& id);
+
+    /**
+     * Record that a cached file was renamed.
+     */
+    void rename(const LLUUID& old_id, const LLUUID& new_id, LLAssetType::EType new_type);
+
+    /**
+     * Remove the least recently used entries from the index until the
+     * total size is no bigger than max_size_bytes, appending the evicted
+     * entries to evicted. Only the evicted entries are visited. The caller
+     * is expected to delete the files and then call flush(); until then
+     * the buffered records are not appended on their own.
+     */
+    void evict(uintmax_t max_size_bytes, std::vector<Entry>& evicted);
+
+    /**
+     * Append the buffered records to the journal, compacting it first if
+     * it has grown too large. Records that fail to append stay buffered
+     * for the next flush.
+     */
+    void flush();
+
+    bool contains(const LLUUID& id);
+    uintmax_t getTotalSize();
+    size_t getEntryCount();
+
+private:
+    enum EOp : U8
+    {
+        OP_INSERT = 1,
+        OP_TOUCH  = 2,
+        OP_ERASE  = 3,
+    };
+
+    /**
+     * On disk journal record, native byte order. The journal is a local
+     * cache file so it never needs to be portable between machines.
+     */
+    struct Record
+    {
+        U8  mOp;
+        S8  mType;
+        U8  mPad[2];
+        U32 mTime;
+        U64 mSize;
+        U8  mID[UUID_BYTES];
+    };
+    static_assert(sizeof(Record) == 32, "Disk cache journal record must be 32 bytes");
+
+    struct Header
+    {
+        char mMagic[8];
+        U32  mVersion;
+        U32  mRecordSize;
+    };
+    static_assert(sizeof(Header) == 16, "Disk cache journal header must be 16 bytes");
+
+    typedef std::list<Entry> lru_list_t;
+    typedef boost::unordered_flat_map<LLUUID, lru_list_t::iterator> lookup_map_t;
+
+    void applyInsert(const LLUUID& id, LLAssetType::EType type, uintmax_t size, U32 time);
+    bool applyTouch(const LLUUID& id, U32 time);
+    bool applyErase(const LLUUID& id);
+    void appendRecord(EOp op, const LLUUID& id, LLAssetType::EType type, uintmax_t size, U32 time);
+    void restorePending(std::vector<Record>& records);
+    bool needsFlush() const;
+    bool writeSnapshot();
+
+private:
+    /**
+     * Guards the index and the pending records
+     */
+    LLMutex mMutex;
+
+    /**
+     * Serializes writes to the journal file so that the index lock does
+     * not have to be held during disk I/O. Always taken before mMutex.
+     */
+    LLMutex mFileMutex;
+
+    const std::string mJournalPath;
+
+    /**
+     * Most recently used entry first
+     */
+    lru_list_t mLRU;
+    lookup_map_t mLookup;
+    uintmax_t mTotalSize = 0;
+
+    /**
+     * Records waiting to be appended by flush()
+     */
+    std::vector<Record> mPending;
+
+    /**
+     * Number of records currently in the journal file, used to decide
+     * when to compact it
+     */
+    size_t mJournalRecords = 0;
+
+    /**
+     * Set by evict() until the caller's flush(), so that the removals are
+     * not journaled before the files are gone
+     */
+    bool mEvictPending = false;
+};
+
+#endif // LL_LLDISKCACHEINDEX_H
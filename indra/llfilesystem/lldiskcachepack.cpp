@@ -0,0 +1,630 @@
+/**
+ * @file lldiskcachepack.cpp
+ * @brief Packed segment file storage for small disk cache assets.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "lldiskcachepack.h"
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+
+namespace
+{
+    constexpr char PACK_MAGIC[8] = { 'A', 'L', 'D', 'C', 'P', 'A', 'C', 'K' };
+    constexpr U32 PACK_VERSION = 1;
+
+    const std::string PACK_INDEX_NAME = "pack.index";
+    const std::string PACK_SEGMENT_EXT = ".sl_pack";
+
+    // Free extents are reused for anything up to half their size, beyond
+    // that the waste is not worth it and we allocate at the segment end.
+    constexpr U32 MAX_REUSE_RATIO = 2;
+
+    boost::filesystem::path to_path(const std::string& filename)
+    {
+#if LL_WINDOWS
+        return boost::filesystem::path(ll_convert_string_to_wide(filename));
+#else
+        return boost::filesystem::path(filename);
+#endif
+    }
+}
+
+LLDiskCachePack::LLDiskCachePack(const std::string& path_prefix, U32 max_asset_size)
+    : mPathPrefix(path_prefix)
+    , mMaxAssetSize(llmin(max_asset_size, MAX_SEGMENT_SIZE))
+{
+}
+
+LLDiskCachePack::~LLDiskCachePack()
+{
+    close();
+}
+
+bool LLDiskCachePack::open()
+{
+    LLMutexLock flush_lock(&mFlushMutex);
+    std::unique_lock lock(mMutex);
+
+    for (U32 i = 0; i < SEGMENT_COUNT; ++i)
+    {
+        const std::string path = getSegmentPath(i);
+        LLFILE* file = LLFile::fopen(path, "r+b");
+        if (!file)
+        {
+            file = LLFile::fopen(path, "w+b");
+        }
+
+        if (!file)
+        {
+            LL_WARNS("DiskCache") << "Unable to open cache pack segment " << path << LL_ENDL;
+            return false;
+        }
+        mSegments[i].mFile = file;
+    }
+
+    if (!loadSnapshot())
+    {
+        // Start over; whatever is in the segments gets overwritten
+        mExtents.clear();
+        for (Segment& segment : mSegments)
+        {
+            segment.mEnd = 0;
+            segment.mFree.clear();
+        }
+        mUsedBytes = 0;
+        mFreeBytes = 0;
+    }
+
+    mOpen = true;
+    LL_INFOS("DiskCache") << "Opened cache pack with " << mExtents.size() << " assets" << LL_ENDL;
+    return true;
+}
+
+void LLDiskCachePack::close()
+{
+    flush();
+
+    LLMutexLock flush_lock(&mFlushMutex);
+    std::unique_lock lock(mMutex);
+
+    mOpen = false;
+    mDirty = false;
+    mExtents.clear();
+    mPendingFree.clear();
+    mUsedBytes = 0;
+    mFreeBytes = 0;
+
+    for (Segment& segment : mSegments)
+    {
+        LLMutexLock file_lock(&segment.mFileMutex);
+        if (segment.mFile)
+        {
+            LLFile::close(segment.mFile);
+            segment.mFile = nullptr;
+        }
+        segment.mEnd = 0;
+        segment.mFree.clear();
+    }
+}
+
+bool LLDiskCachePack::contains(const LLUUID& id)
+{
+    std::shared_lock lock(mMutex);
+    return mExtents.find(id) != mExtents.end();
+}
+
+S32 LLDiskCachePack::getSize(const LLUUID& id)
+{
+    std::shared_lock lock(mMutex);
+    auto iter = mExtents.find(id);
+    return iter != mExtents.end() ? (S32)iter->second.mSize : -1;
+}
+
+S32 LLDiskCachePack::read(const LLUUID& id, S32 offset, U8* buffer, S32 bytes)
+{
+    std::shared_lock lock(mMutex);
+    auto iter = mExtents.find(id);
+    if (iter == mExtents.end())
+    {
+        return -1;
+    }
+
+    const Extent& extent = iter->second;
+    if (offset < 0 || bytes <= 0 || (U32)offset >= extent.mSize)
+    {
+        return 0;
+    }
+
+    const U32 to_read = llmin((U32)bytes, extent.mSize - (U32)offset);
+    return readExtent(extent, (U32)offset, buffer, to_read) ? (S32)to_read : 0;
+}
+
+S32 LLDiskCachePack::write(const LLUUID& id, LLAssetType::EType type, S32 offset, const U8* buffer, S32 bytes, bool truncate)
+{
+    if (offset < 0 || bytes < 0 || (truncate && offset != 0))
+    {
+        return -1;
+    }
+
+    std::unique_lock lock(mMutex);
+    if (!mOpen)
+    {
+        return -1;
+    }
+
+    auto iter = mExtents.find(id);
+    const bool exists = iter != mExtents.end();
+    const U32 old_size = exists && !truncate ? iter->second.mSize : 0;
+    if ((U32)offset > old_size)
+    {
+        return -1;
+    }
+
+    const U64 new_size = llmax((U64)old_size, (U64)offset + (U64)bytes);
+    if (new_size > mMaxAssetSize)
+    {
+        return -1;
+    }
+
+    // Only a pure append may stay in place, it does not touch any byte the
+    // last snapshot may refer to
+    if (exists && !truncate && (U32)offset == old_size && new_size <= iter->second.mCapacity)
+    {
+        Extent& extent = iter->second;
+        if (!writeExtent(extent, (U32)offset, buffer, (U32)bytes))
+        {
+            return -1;
+        }
+        extent.mSize = (U32)new_size;
+        extent.mType = type;
+        mDirty = true;
+        return (S32)new_size;
+    }
+
+    Extent extent;
+    if (!allocate(id, (U32)new_size, extent))
+    {
+        return -1;
+    }
+    extent.mSize = (U32)new_size;
+    extent.mType = type;
+
+    // Carry over the part of the old data that is not being overwritten
+    bool success = true;
+    if (old_size > 0)
+    {
+        std::vector<U8> old_data(old_size);
+        success = readExtent(iter->second, 0, old_data.data(), old_size)
+            && writeExtent(extent, 0, old_data.data(), old_size);
+    }
+    success = success && writeExtent(extent, (U32)offset, buffer, (U32)bytes);
+    if (!success)
+    {
+        release(extent);
+        return -1;
+    }
+
+    // The new extent is ours alone until it is published, so readers and
+    // writers of other assets need not wait on the flush
+    const Extent old_extent = exists ? iter->second : Extent();
+    lock.unlock();
+    success = flushExtent(extent);
+    lock.lock();
+
+    if (!mOpen)
+    {
+        // close() dropped the table and the space with it
+        return -1;
+    }
+
+    if (!success)
+    {
+        release(extent);
+        return -1;
+    }
+
+    iter = mExtents.find(id);
+    if (iter != mExtents.end())
+    {
+        // Data carried over from an extent that was replaced meanwhile
+        // would bring back stale bytes
+        const Extent& current = iter->second;
+        if (!truncate && (!exists || current.mSegment != old_extent.mSegment
+                          || current.mOffset != old_extent.mOffset || current.mSize != old_extent.mSize))
+        {
+            release(extent);
+            return -1;
+        }
+        release(current);
+        iter->second = extent;
+    }
+    else if (exists && !truncate)
+    {
+        // Erased meanwhile
+        release(extent);
+        return -1;
+    }
+    else
+    {
+        mExtents.emplace(id, extent);
+    }
+    mDirty = true;
+    return (S32)new_size;
+}
+
+bool LLDiskCachePack::extract(const LLUUID& id, std::vector<U8>& data)
+{
+    std::unique_lock lock(mMutex);
+    auto iter = mExtents.find(id);
+    if (iter == mExtents.end())
+    {
+        return false;
+    }
+
+    data.resize(iter->second.mSize);
+    bool success = data.empty() || readExtent(iter->second, 0, data.data(), iter->second.mSize);
+    release(iter->second);
+    mExtents.erase(iter);
+    mDirty = true;
+    return success;
+}
+
+bool LLDiskCachePack::erase(const LLUUID& id)
+{
+    std::unique_lock lock(mMutex);
+    auto iter = mExtents.find(id);
+    if (iter == mExtents.end())
+    {
+        return false;
+    }
+
+    release(iter->second);
+    mExtents.erase(iter);
+    mDirty = true;
+    return true;
+}
+
+bool LLDiskCachePack::rename(const LLUUID& old_id, const LLUUID& new_id, LLAssetType::EType new_type)
+{
+    std::unique_lock lock(mMutex);
+    auto iter = mExtents.find(old_id);
+    if (iter == mExtents.end())
+    {
+        return false;
+    }
+
+    Extent extent = iter->second;
+    extent.mType = new_type;
+    mExtents.erase(iter);
+
+    auto new_iter = mExtents.find(new_id);
+    if (new_iter != mExtents.end())
+    {
+        release(new_iter->second);
+        new_iter->second = extent;
+    }
+    else
+    {
+        mExtents.emplace(new_id, extent);
+    }
+    mDirty = true;
+    return true;
+}
+
+void LLDiskCachePack::getAssets(std::vector<LLDiskCacheIndex::Entry>& entries)
+{
+    boost::system::error_code ec;
+    const std::time_t snapshot_time = boost::filesystem::last_write_time(to_path(mPathPrefix + PACK_INDEX_NAME), ec);
+    const U32 access_time = ec.failed() ? (U32)std::time(nullptr) : (U32)snapshot_time;
+
+    std::shared_lock lock(mMutex);
+    entries.reserve(entries.size() + mExtents.size());
+    for (const auto& [id, extent] : mExtents)
+    {
+        entries.push_back(LLDiskCacheIndex::Entry{ id, extent.mType, extent.mSize, access_time });
+    }
+}
+
+void LLDiskCachePack::flush()
+{
+    LLMutexLock flush_lock(&mFlushMutex);
+
+    Header header;
+    memset(&header, 0, sizeof(Header));
+    memcpy(header.mMagic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    header.mVersion = PACK_VERSION;
+    header.mRecordSize = sizeof(Record);
+    header.mSegmentCount = SEGMENT_COUNT;
+
+    std::vector<Record> records;
+    free_list_t released;
+    {
+        std::unique_lock lock(mMutex);
+        if (!mOpen || !mDirty)
+        {
+            return;
+        }
+        mDirty = false;
+
+        // The snapshot must never reference data that is still sitting in
+        // a stdio buffer
+        for (U32 i = 0; i < SEGMENT_COUNT; ++i)
+        {
+            Segment& segment = mSegments[i];
+            LLMutexLock file_lock(&segment.mFileMutex);
+            if (segment.mFile)
+            {
+                fflush(segment.mFile);
+            }
+            header.mSegmentEnd[i] = segment.mEnd;
+        }
+
+        records.reserve(mExtents.size());
+        for (const auto& [id, extent] : mExtents)
+        {
+            Record& record = records.emplace_back();
+            memcpy(record.mID, id.mData, UUID_BYTES);
+            record.mOffset = extent.mOffset;
+            record.mCapacity = extent.mCapacity;
+            record.mSize = extent.mSize;
+            record.mSegment = extent.mSegment;
+            record.mType = (S8)extent.mType;
+            record.mPad[0] = record.mPad[1] = 0;
+        }
+        header.mRecordCount = (U32)records.size();
+
+        released.swap(mPendingFree);
+    }
+
+    const std::string index_path = mPathPrefix + PACK_INDEX_NAME;
+    const std::string temp_path = index_path + ".tmp";
+    bool success = false;
+    LLFILE* file = LLFile::fopen(temp_path, "wb");
+    if (file)
+    {
+        success = fwrite(&header, sizeof(Header), 1, file) == 1
+            && (records.empty() || fwrite(records.data(), sizeof(Record), records.size(), file) == records.size());
+        LLFile::close(file);
+
+        boost::system::error_code ec;
+        if (success)
+        {
+            boost::filesystem::rename(to_path(temp_path), to_path(index_path), ec);
+            success = !ec.failed();
+        }
+    }
+
+    std::unique_lock lock(mMutex);
+    if (success)
+    {
+        for (const auto& [segment, free_extent] : released)
+        {
+            mSegments[segment].mFree.emplace(free_extent.first, free_extent.second);
+            mFreeBytes += free_extent.first;
+        }
+    }
+    else
+    {
+        LL_WARNS("DiskCache") << "Failed to write cache pack index " << index_path << LL_ENDL;
+        LLFile::remove(temp_path, ENOENT);
+        mPendingFree.insert(mPendingFree.end(), released.begin(), released.end());
+        mDirty = true;
+    }
+}
+
+std::string LLDiskCachePack::getInfo()
+{
+    std::shared_lock lock(mMutex);
+    return llformat("%d packed assets in %lluMB, %lluMB free", (S32)mExtents.size(),
+                    (unsigned long long)(mUsedBytes / (1024 * 1024)), (unsigned long long)(mFreeBytes / (1024 * 1024)));
+}
+
+S32 LLDiskCachePack::getEntryCount()
+{
+    std::shared_lock lock(mMutex);
+    return (S32)mExtents.size();
+}
+
+// static
+U32 LLDiskCachePack::roundCapacity(U32 size)
+{
+    // Fine granularity for the many tiny assets, coarser above that so that
+    // appends in xfer sized chunks rarely need to move the asset.
+    const U32 granule = size <= 4096 ? 256 : 4096;
+    return llmax(granule, (size + granule - 1) & ~(granule - 1));
+}
+
+// Called with mMutex held exclusively
+bool LLDiskCachePack::loadSnapshot()
+{
+    const std::string index_path = mPathPrefix + PACK_INDEX_NAME;
+    LLFILE* file = LLFile::fopen(index_path, "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    Header header;
+    std::vector<Record> records;
+    bool valid = fread(&header, sizeof(Header), 1, file) == 1
+        && memcmp(header.mMagic, PACK_MAGIC, sizeof(PACK_MAGIC)) == 0
+        && header.mVersion == PACK_VERSION
+        && header.mRecordSize == sizeof(Record)
+        && header.mSegmentCount == SEGMENT_COUNT;
+    if (valid)
+    {
+        records.resize(header.mRecordCount);
+        valid = records.empty() || fread(records.data(), sizeof(Record), records.size(), file) == records.size();
+    }
+    LLFile::close(file);
+
+    if (!valid)
+    {
+        LL_WARNS("DiskCache") << "Cache pack index " << index_path << " is unreadable, starting an empty pack" << LL_ENDL;
+        return false;
+    }
+
+    // How much data actually made it into each segment
+    std::array<U32, SEGMENT_COUNT> file_size;
+    for (U32 i = 0; i < SEGMENT_COUNT; ++i)
+    {
+        LLFILE* segment_file = mSegments[i].mFile;
+        file_size[i] = (fseek(segment_file, 0, SEEK_END) == 0) ? (U32)llmax(0L, ftell(segment_file)) : 0;
+        mSegments[i].mEnd = llmin(header.mSegmentEnd[i], MAX_SEGMENT_SIZE);
+    }
+
+    std::array<std::vector<std::pair<U32, U32>>, SEGMENT_COUNT> used;
+    mExtents.reserve(records.size());
+    for (const Record& record : records)
+    {
+        if (record.mSegment >= SEGMENT_COUNT
+            || record.mSize > record.mCapacity
+            || record.mSize > mMaxAssetSize
+            || (U64)record.mOffset + record.mCapacity > mSegments[record.mSegment].mEnd
+            || (U64)record.mOffset + record.mSize > file_size[record.mSegment])
+        {
+            continue;
+        }
+
+        LLUUID id;
+        memcpy(id.mData, record.mID, UUID_BYTES);
+        Extent extent{ record.mOffset, record.mCapacity, record.mSize, record.mSegment, (LLAssetType::EType)record.mType };
+        mExtents.emplace(id, extent);
+        used[record.mSegment].emplace_back(record.mOffset, record.mCapacity);
+    }
+
+    // Everything between the extents in use is free
+    mUsedBytes = 0;
+    mFreeBytes = 0;
+    for (U32 i = 0; i < SEGMENT_COUNT; ++i)
+    {
+        std::vector<std::pair<U32, U32>>& extents = used[i];
+        std::sort(extents.begin(), extents.end());
+
+        U32 pos = 0;
+        for (const auto& [offset, capacity] : extents)
+        {
+            if (offset < pos)
+            {
+                // Overlapping extents can only come from a damaged index
+                LL_WARNS("DiskCache") << "Cache pack index " << index_path << " has overlapping extents, starting an empty pack" << LL_ENDL;
+                return false;
+            }
+            if (offset > pos)
+            {
+                mSegments[i].mFree.emplace(offset - pos, pos);
+                mFreeBytes += offset - pos;
+            }
+            pos = offset + capacity;
+            mUsedBytes += capacity;
+        }
+        if (mSegments[i].mEnd > pos)
+        {
+            mSegments[i].mFree.emplace(mSegments[i].mEnd - pos, pos);
+            mFreeBytes += mSegments[i].mEnd - pos;
+        }
+    }
+
+    return true;
+}
+
+// Called with mMutex held exclusively
+bool LLDiskCachePack::allocate(const LLUUID& id, U32 size, Extent& extent)
+{
+    const U32 capacity = roundCapacity(size);
+    const U32 first = id.mData[0] % SEGMENT_COUNT;
+    for (U32 i = 0; i < SEGMENT_COUNT; ++i)
+    {
+        const U32 index = (first + i) % SEGMENT_COUNT;
+        Segment& segment = mSegments[index];
+
+        auto free_iter = segment.mFree.lower_bound(capacity);
+        if (free_iter != segment.mFree.end() && free_iter->first <= capacity * MAX_REUSE_RATIO)
+        {
+            extent.mOffset = free_iter->second;
+            extent.mCapacity = free_iter->first;
+            extent.mSegment = (U8)index;
+            mFreeBytes -= free_iter->first;
+            mUsedBytes += free_iter->first;
+            segment.mFree.erase(free_iter);
+            return true;
+        }
+
+        if ((U64)segment.mEnd + capacity <= MAX_SEGMENT_SIZE)
+        {
+            extent.mOffset = segment.mEnd;
+            extent.mCapacity = capacity;
+            extent.mSegment = (U8)index;
+            segment.mEnd += capacity;
+            mUsedBytes += capacity;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Called with mMutex held exclusively
+void LLDiskCachePack::release(const Extent& extent)
+{
+    mUsedBytes -= extent.mCapacity;
+    mPendingFree.emplace_back(extent.mSegment, std::make_pair(extent.mCapacity, extent.mOffset));
+}
+
+bool LLDiskCachePack::readExtent(const Extent& extent, U32 offset, U8* buffer, U32 bytes)
+{
+    Segment& segment = mSegments[extent.mSegment];
+    LLMutexLock file_lock(&segment.mFileMutex);
+    return segment.mFile
+        && fseek(segment.mFile, (long)(extent.mOffset + offset), SEEK_SET) == 0
+        && fread(buffer, 1, bytes, segment.mFile) == bytes;
+}
+
+bool LLDiskCachePack::writeExtent(const Extent& extent, U32 offset, const U8* buffer, U32 bytes)
+{
+    if (bytes == 0)
+    {
+        return true;
+    }
+
+    Segment& segment = mSegments[extent.mSegment];
+    LLMutexLock file_lock(&segment.mFileMutex);
+    return segment.mFile
+        && fseek(segment.mFile, (long)(extent.mOffset + offset), SEEK_SET) == 0
+        && fwrite(buffer, 1, bytes, segment.mFile) == bytes;
+}
+
+bool LLDiskCachePack::flushExtent(const Extent& extent)
+{
+    Segment& segment = mSegments[extent.mSegment];
+    LLMutexLock file_lock(&segment.mFileMutex);
+    return segment.mFile && fflush(segment.mFile) == 0;
+}
+
+std::string LLDiskCachePack::getSegmentPath(U32 segment) const
+{
+    return llformat("%spack_%u%s", mPathPrefix.c_str(), segment, PACK_SEGMENT_EXT.c_str());
+}
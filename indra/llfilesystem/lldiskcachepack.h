@@ -0,0 +1,274 @@
+/**
+ * @file lldiskcachepack.h
+ * @brief Packed segment file storage for small disk cache assets.
+ *
+ * @Description:
+ * Most of the assets that go through LLFileSystem (notecards, gestures,
+ * animations, sounds, small meshes) are only a few kilobytes, and for
+ * those the cost of opening, reading and closing a separate cache file
+ * plus the filesystem metadata for hundreds of thousands of tiny files
+ * dwarfs the actual data transfer. This class stores such assets inside
+ * a small number of large segment files instead:
+ * 1/ Each asset occupies a single extent in one segment. Extents are
+ *    rounded up to a granule so that small appends usually fit in place;
+ *    an asset that outgrows its extent is moved to a new one. Bytes that
+ *    are already part of the asset are never overwritten in place: such a
+ *    write goes to a fresh extent, and the extent table only points at it
+ *    once the data has been flushed, so the last snapshot keeps
+ *    describing intact data whatever happens to the new write.
+ * 2/ The segment files stay open for the whole session, so a read or a
+ *    write is a seek plus a read or write on an already open handle.
+ * 3/ The extent table is kept in memory and saved as a snapshot when
+ *    flush() is called. Space that is freed is only handed out again once
+ *    a snapshot that no longer references it is on disk, so after a
+ *    crash the old snapshot never points at extents holding some other
+ *    asset's data. Anything written after the last snapshot is simply
+ *    forgotten, which is fine for a cache.
+ * 4/ Free space is not saved; it is recomputed from the gaps between the
+ *    extents of each segment when the snapshot is loaded.
+ *
+ * Assets bigger than the configured maximum are not stored here and the
+ * caller falls back to loose files. Eviction goes through the disk cache
+ * index, so the pack is only used when LLDiskCache runs in indexed mode.
+ *
+ * All public methods are thread safe.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLDISKCACHEPACK_H
+#define LL_LLDISKCACHEPACK_H
+
+#include "llassettype.h"
+#include "lldiskcacheindex.h"
+#include "llmutex.h"
+#include "lluuid.h"
+
+#include "boost/unordered/unordered_flat_map.hpp"
+
+#include <array>
+#include <map>
+#include <shared_mutex>
+#include <vector>
+
+class LLDiskCachePack
+{
+public:
+    /**
+     * Number of segment files. Assets are spread over the segments by ID
+     * so that readers on different threads rarely wait on the same file.
+     */
+    static constexpr U32 SEGMENT_COUNT = 8;
+
+    /**
+     * Segments are capped well below 2GB so that plain fseek()/ftell()
+     * offsets work on every platform. Once every segment is full new
+     * assets go to loose files.
+     */
+    static constexpr U32 MAX_SEGMENT_SIZE = 1024u * 1024u * 1024u;
+
+    /**
+     * The pack file names are appended to path_prefix, normally the cache
+     * directory followed by a delimiter. Assets larger than max_asset_size
+     * are refused. Nothing is opened until open() is called.
+     */
+    LLDiskCachePack(const std::string& path_prefix, U32 max_asset_size);
+    ~LLDiskCachePack();
+
+    /**
+     * Open the segment files and load the last snapshot. A missing or
+     * unreadable snapshot starts an empty pack. Returns false if the
+     * segment files can not be opened, in which case the pack must not
+     * be used.
+     */
+    bool open();
+
+    /**
+     * Save a last snapshot and close the segment files. Every request
+     * after this fails as if the asset was not packed, which is how
+     * threads still holding the pack learn it is gone.
+     */
+    void close();
+
+    U32 getMaxAssetSize() const { return mMaxAssetSize; }
+
+    bool contains(const LLUUID& id);
+
+    /**
+     * Size in bytes of a packed asset, or -1 if it is not packed
+     */
+    S32 getSize(const LLUUID& id);
+
+    /**
+     * Read up to bytes from offset of a packed asset. Returns the number of
+     * bytes read, or -1 if the asset is not packed.
+     */
+    S32 read(const LLUUID& id, S32 offset, U8* buffer, S32 bytes);
+
+    /**
+     * Write bytes at offset of the asset, creating it if needed. With
+     * truncate the asset is replaced by the new data. Returns the new
+     * size of the asset, or -1 if the result would not fit in the pack
+     * (too big, offset past the end, or no room) or another write to the
+     * asset got in first, in which case nothing was changed.
+     */
+    S32 write(const LLUUID& id, LLAssetType::EType type, S32 offset, const U8* buffer, S32 bytes, bool truncate);
+
+    /**
+     * Copy a packed asset out and remove it from the pack. Used to move an
+     * asset that grew past the size limit to a loose file.
+     */
+    bool extract(const LLUUID& id, std::vector<U8>& data);
+
+    /**
+     * Remove a packed asset. Returns false if it was not packed.
+     */
+    bool erase(const LLUUID& id);
+
+    /**
+     * Move a packed asset to a new ID, replacing anything packed under the
+     * new ID. Returns false if old_id was not packed.
+     */
+    bool rename(const LLUUID& old_id, const LLUUID& new_id, LLAssetType::EType new_type);
+
+    /**
+     * Append an entry for every packed asset to entries, for rebuilding the
+     * disk cache index. The pack keeps no access times, every asset gets
+     * the time of the last snapshot.
+     */
+    void getAssets(std::vector<LLDiskCacheIndex::Entry>& entries);
+
+    /**
+     * Save a snapshot of the extent table and make the space freed before
+     * it available for reuse.
+     */
+    void flush();
+
+    /**
+     * Summary for the About box and debug logs
+     */
+    std::string getInfo();
+
+    S32 getEntryCount();
+
+private:
+    struct Extent
+    {
+        U32                 mOffset;
+        U32                 mCapacity;
+        U32                 mSize;
+        U8                  mSegment;
+        LLAssetType::EType  mType;
+    };
+
+    struct Segment
+    {
+        LLFILE*                     mFile = nullptr;
+        /**
+         * Guards the file position of mFile
+         */
+        LLMutex                     mFileMutex;
+        /**
+         * End of the last extent ever handed out
+         */
+        U32                         mEnd = 0;
+        /**
+         * Reusable extents by capacity
+         */
+        std::multimap<U32, U32>     mFree;
+    };
+
+    struct Record
+    {
+        U8  mID[UUID_BYTES];
+        U32 mOffset;
+        U32 mCapacity;
+        U32 mSize;
+        U8  mSegment;
+        S8  mType;
+        U8  mPad[2];
+    };
+    static_assert(sizeof(Record) == 32, "Pack index record must be 32 bytes");
+
+    struct Header
+    {
+        char mMagic[8];
+        U32  mVersion;
+        U32  mRecordSize;
+        U32  mSegmentCount;
+        U32  mRecordCount;
+        U32  mSegmentEnd[SEGMENT_COUNT];
+    };
+
+    typedef boost::unordered_flat_map<LLUUID, Extent> extent_map_t;
+    typedef std::vector<std::pair<U8, std::pair<U32, U32>>> free_list_t;
+
+    static U32 roundCapacity(U32 size);
+
+    bool loadSnapshot();
+    bool allocate(const LLUUID& id, U32 size, Extent& extent);
+    void release(const Extent& extent);
+    bool readExtent(const Extent& extent, U32 offset, U8* buffer, U32 bytes);
+    bool writeExtent(const Extent& extent, U32 offset, const U8* buffer, U32 bytes);
+    bool flushExtent(const Extent& extent);
+    std::string getSegmentPath(U32 segment) const;
+
+private:
+    /**
+     * Readers take this shared, anything that changes the extent table
+     * or allocates space takes it exclusively.
+     */
+    std::shared_mutex mMutex;
+
+    /**
+     * Serializes snapshot writes. Always taken before mMutex.
+     */
+    LLMutex mFlushMutex;
+
+    const std::string mPathPrefix;
+    const U32 mMaxAssetSize;
+
+    extent_map_t mExtents;
+    std::array<Segment, SEGMENT_COUNT> mSegments;
+
+    /**
+     * Extents freed since the last snapshot as (segment, (capacity, offset))
+     */
+    free_list_t mPendingFree;
+
+    /**
+     * Capacity of the extents in use, and of the reusable free extents
+     */
+    U64 mUsedBytes = 0;
+    U64 mFreeBytes = 0;
+
+    /**
+     * Set when the extent table changed since the last snapshot
+     */
+    bool mDirty = false;
+
+    /**
+     * Between a successful open() and close()
+     */
+    bool mOpen = false;
+};
+
+#endif // LL_LLDISKCACHEPACK_H
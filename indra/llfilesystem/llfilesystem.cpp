@@ -54,16 +54,7 @@ LLFileSystem::LLFileSystem(const LLUUID& file_id, const LLAssetType::EType file_
     // we decided to follow Henri's suggestion and move the code to update the last access time here.
     if (mode == LLFileSystem::READ)
     {
-        // update the last access time for the file if it exists - this is required
-        // even though we are reading and not writing because this is the
-        // way the cache works - it relies on a valid "last accessed time" for
-        // each file so it knows how to remove the oldest, unused files
-        boost::system::error_code ec;
-        bool exists = boost::filesystem::exists(mFilePath, ec);
-        if (exists && !ec.failed())
-        {
-            LLDiskCache::updateFileAccessTime(mFilePath);
-        }
+        LLDiskCache::getInstance()->fileAccessed(file_id, mFilePath);
     }
 }
 
@@ -74,6 +65,12 @@ LLFileSystem::~LLFileSystem()
 // static
 bool LLFileSystem::getExists(const LLUUID& file_id, const LLAssetType::EType file_type)
 {
+    std::shared_ptr<LLDiskCachePack> pack = LLDiskCache::getInstance()->getPack();
+    if (pack && pack->contains(file_id))
+    {
+        return true;
+    }
+
     const boost::filesystem::path filename = LLDiskCache::getInstance()->metaDataToFilepath(file_id, file_type);
     boost::system::error_code ec;
     return boost::filesystem::exists(filename, ec) && !ec.failed();
@@ -84,7 +81,12 @@ bool LLFileSystem::removeFile(const LLUUID& file_id, const LLAssetType::EType fi
 {
     const boost::filesystem::path filename = LLDiskCache::getInstance()->metaDataToFilepath(file_id, file_type);
 
-    LLFile::remove(filename, suppress_error);
+    std::shared_ptr<LLDiskCachePack> pack = LLDiskCache::getInstance()->getPack();
+    if (!pack || !pack->erase(file_id))
+    {
+        LLFile::remove(filename, suppress_error);
+    }
+    LLDiskCache::getInstance()->fileRemoved(file_id);
 
     return true;
 }
@@ -100,6 +102,16 @@ bool LLFileSystem::renameFile(const LLUUID& old_file_id, const LLAssetType::ETyp
 // static
 S32 LLFileSystem::getFileSize(const LLUUID& file_id, const LLAssetType::EType file_type)
 {
+    std::shared_ptr<LLDiskCachePack> pack = LLDiskCache::getInstance()->getPack();
+    if (pack)
+    {
+        S32 packed_size = pack->getSize(file_id);
+        if (packed_size >= 0)
+        {
+            return packed_size;
+        }
+    }
+
     const boost::filesystem::path filename = LLDiskCache::getInstance()->metaDataToFilepath(file_id, file_type);
     boost::system::error_code ec;
     S32 file_size = boost::filesystem::file_size(filename, ec);
@@ -114,6 +126,18 @@ BOOL LLFileSystem::read(U8* buffer, S32 bytes)
 {
     BOOL success = FALSE;
 
+    std::shared_ptr<LLDiskCachePack> pack = LLDiskCache::getInstance()->getPack();
+    if (pack)
+    {
+        S32 bytes_read = pack->read(mFileID, mPosition, buffer, bytes);
+        if (bytes_read >= 0)
+        {
+            mBytesRead = bytes_read;
+            mPosition += mBytesRead;
+            return mBytesRead ? TRUE : FALSE;
+        }
+    }
+
     LLFILE* file = LLFile::fopen(mFilePath, TEXT("rb"));
     if (file)
     {
@@ -149,6 +173,20 @@ BOOL LLFileSystem::eof()
 BOOL LLFileSystem::write(const U8* buffer, S32 bytes)
 {
     BOOL success = FALSE;
+    // Size of the file once written; only the in place update in READ_WRITE
+    // mode can leave it different from the final position.
+    S32 file_size = -1;
+
+    std::shared_ptr<LLDiskCachePack> pack = LLDiskCache::getInstance()->getPack();
+    if (pack)
+    {
+        file_size = writePacked(pack.get(), buffer, bytes);
+        if (file_size >= 0)
+        {
+            LLDiskCache::getInstance()->fileWritten(mFileID, mFileType, file_size);
+            return TRUE;
+        }
+    }
 
     if (mMode == APPEND)
     {
@@ -170,6 +208,10 @@ BOOL LLFileSystem::write(const U8* buffer, S32 bytes)
             {
                 S32 bytes_written = fwrite(buffer, 1, bytes, ofs);
                 mPosition = ftell(ofs);
+                if (fseek(ofs, 0, SEEK_END) == 0)
+                {
+                    file_size = ftell(ofs);
+                }
                 fclose(ofs);
                 success = (bytes_written == bytes);
             }
@@ -198,6 +240,10 @@ BOOL LLFileSystem::write(const U8* buffer, S32 bytes)
         }
     }
 
+    if (success)
+    {
+        LLDiskCache::getInstance()->fileWritten(mFileID, mFileType, file_size >= 0 ? file_size : mPosition);
+    }
 
     return success;
 }
@@ -239,6 +285,16 @@ S32 LLFileSystem::tell() const
 
 S32 LLFileSystem::getSize()
 {
+    std::shared_ptr<LLDiskCachePack> pack = LLDiskCache::getInstance()->getPack();
+    if (pack)
+    {
+        S32 packed_size = pack->getSize(mFileID);
+        if (packed_size >= 0)
+        {
+            return packed_size;
+        }
+    }
+
     boost::system::error_code ec;
     S32 file_size = boost::filesystem::file_size(mFilePath, ec);
     if(ec.failed())
@@ -258,6 +314,25 @@ BOOL LLFileSystem::rename(const LLUUID& new_id, const LLAssetType::EType new_typ
 {
     const boost::filesystem::path new_filename = LLDiskCache::getInstance()->metaDataToFilepath(new_id, new_type);
 
+    std::shared_ptr<LLDiskCachePack> pack = LLDiskCache::getInstance()->getPack();
+    if (pack)
+    {
+        if (pack->rename(mFileID, new_id, new_type))
+        {
+            // The packed asset replaces any loose file under the new ID
+            LLFile::remove(new_filename, ENOENT);
+            LLDiskCache::getInstance()->fileRenamed(mFileID, new_id, new_type);
+
+            mFileID = new_id;
+            mFileType = new_type;
+            mFilePath = new_filename;
+            return TRUE;
+        }
+
+        // The loose file replaces anything packed under the new ID
+        pack->erase(new_id);
+    }
+
     // Rename needs the new file to not exist.
     boost::system::error_code ec;
     boost::filesystem::remove(new_filename, ec);
@@ -276,6 +351,10 @@ BOOL LLFileSystem::rename(const LLUUID& new_id, const LLAssetType::EType new_typ
         //return FALSE;
         LL_WARNS() << "Failed to rename " << mFileID << " to " << new_id << " reason: "  << ec.what() << LL_ENDL;
     }
+    else
+    {
+        LLDiskCache::getInstance()->fileRenamed(mFileID, new_id, new_type);
+    }
 
     mFileID = new_id;
     mFileType = new_type;
@@ -286,7 +365,74 @@ BOOL LLFileSystem::rename(const LLUUID& new_id, const LLAssetType::EType new_typ
 
 BOOL LLFileSystem::remove()
 {
+    std::shared_ptr<LLDiskCachePack> pack = LLDiskCache::getInstance()->getPack();
+    if (pack && pack->erase(mFileID))
+    {
+        LLDiskCache::getInstance()->fileRemoved(mFileID);
+        return TRUE;
+    }
+
     boost::system::error_code ec;
     boost::filesystem::remove(mFilePath, ec);
+    LLDiskCache::getInstance()->fileRemoved(mFileID);
     return TRUE;
 }
+
+S32 LLFileSystem::writePacked(LLDiskCachePack* pack, const U8* buffer, S32 bytes)
+{
+    const S32 packed_size = pack->getSize(mFileID);
+    if (packed_size < 0)
+    {
+        if (bytes > (S32)pack->getMaxAssetSize())
+        {
+            return -1;
+        }
+
+        // An asset that already has a loose file stays there unless it is
+        // being rewritten from scratch
+        boost::system::error_code ec;
+        if (mMode != WRITE && boost::filesystem::exists(mFilePath, ec))
+        {
+            return -1;
+        }
+    }
+
+    S32 offset = mPosition;
+    if (mMode == WRITE)
+    {
+        offset = 0;
+    }
+    else if (mMode == APPEND)
+    {
+        offset = llmax(packed_size, 0);
+    }
+
+    S32 new_size = pack->write(mFileID, mFileType, offset, buffer, bytes, mMode == WRITE);
+    if (new_size >= 0)
+    {
+        if (packed_size < 0 && mMode == WRITE)
+        {
+            // Don't leave an older loose copy behind to shadow this one
+            LLFile::remove(mFilePath, ENOENT);
+        }
+        mPosition = offset + bytes;
+        return new_size;
+    }
+
+    if (packed_size >= 0)
+    {
+        // The asset outgrew the pack, move it to a loose file and let the
+        // caller carry on with the write there
+        std::vector<U8> data;
+        if (pack->extract(mFileID, data) && mMode != WRITE)
+        {
+            LLFILE* ofs = LLFile::fopen(mFilePath, TEXT("wb"));
+            if (ofs)
+            {
+                fwrite(data.data(), 1, data.size(), ofs);
+                fclose(ofs);
+            }
+        }
+    }
+    return -1;
+}
@@ -65,6 +65,14 @@ class LLFileSystem
         static const S32 READ_WRITE;
         static const S32 APPEND;
 
+    protected:
+        /**
+         * Write to the pack file storage. Returns the new size of the asset,
+         * or -1 if the write has to go to a loose file instead; any packed
+         * data has then already been moved to the loose file.
+         */
+        S32 writePacked(LLDiskCachePack* pack, const U8* buffer, S32 bytes);
+
     protected:
         boost::filesystem::path mFilePath;
         LLAssetType::EType mFileType;
@@ -0,0 +1,219 @@
+/**
+ * @file llmappedfile.cpp
+ * @brief Read-write memory mapping of a whole file.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llmappedfile.h"
+
+#if LL_WINDOWS
+#include "llwin32headerslean.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+LLMappedFile::LLMappedFile()
+{
+}
+
+LLMappedFile::~LLMappedFile()
+{
+    close();
+}
+
+#if LL_WINDOWS
+
+bool LLMappedFile::open(const std::string& filename, size_t size, bool read_only)
+{
+    close();
+
+    HANDLE file = CreateFileW(ll_convert_string_to_wide(filename).c_str(),
+                              read_only ? GENERIC_READ : GENERIC_READ | GENERIC_WRITE,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr,
+                              read_only ? OPEN_EXISTING : OPEN_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        LL_WARNS() << "Unable to open " << filename << " for mapping, error " << GetLastError() << LL_ENDL;
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    // CreateFileMapping() grows the file to the requested size
+    const U64 map_size = read_only ? (U64)file_size.QuadPart : llmax((U64)file_size.QuadPart, (U64)size);
+    if (map_size == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, read_only ? PAGE_READONLY : PAGE_READWRITE,
+                                        (DWORD)(map_size >> 32), (DWORD)(map_size & 0xffffffff), nullptr);
+    if (!mapping)
+    {
+        LL_WARNS() << "Unable to map " << filename << ", error " << GetLastError() << LL_ENDL;
+        CloseHandle(file);
+        return false;
+    }
+
+    void* data = MapViewOfFile(mapping, read_only ? FILE_MAP_READ : FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, (SIZE_T)map_size);
+    if (!data)
+    {
+        LL_WARNS() << "Unable to map a view of " << filename << ", error " << GetLastError() << LL_ENDL;
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    mFile = file;
+    mMapping = mapping;
+    mData = (U8*)data;
+    mSize = (size_t)map_size;
+    mReadOnly = read_only;
+    return true;
+}
+
+void LLMappedFile::close()
+{
+    if (mData)
+    {
+        UnmapViewOfFile(mData);
+        mData = nullptr;
+    }
+    if (mMapping)
+    {
+        CloseHandle((HANDLE)mMapping);
+        mMapping = nullptr;
+    }
+    if (mFile)
+    {
+        CloseHandle((HANDLE)mFile);
+        mFile = nullptr;
+    }
+    mSize = 0;
+}
+
+bool LLMappedFile::flush(bool wait)
+{
+    if (!mData || mReadOnly)
+    {
+        return mData != nullptr;
+    }
+
+    if (!FlushViewOfFile(mData, 0))
+    {
+        return false;
+    }
+    return !wait || FlushFileBuffers((HANDLE)mFile);
+}
+
+#else // LL_WINDOWS
+
+bool LLMappedFile::open(const std::string& filename, size_t size, bool read_only)
+{
+    close();
+
+    int fd = ::open(filename.c_str(), read_only ? O_RDONLY : O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        LL_WARNS() << "Unable to open " << filename << " for mapping, errno " << errno << LL_ENDL;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    size_t map_size = (size_t)st.st_size;
+    if (!read_only && map_size < size)
+    {
+        if (ftruncate(fd, (off_t)size) != 0)
+        {
+            LL_WARNS() << "Unable to grow " << filename << " to " << size << " bytes, errno " << errno << LL_ENDL;
+            ::close(fd);
+            return false;
+        }
+        map_size = size;
+    }
+    if (map_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, map_size, read_only ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        LL_WARNS() << "Unable to map " << filename << ", errno " << errno << LL_ENDL;
+        ::close(fd);
+        return false;
+    }
+
+    mFD = fd;
+    mData = (U8*)data;
+    mSize = map_size;
+    mReadOnly = read_only;
+    return true;
+}
+
+void LLMappedFile::close()
+{
+    if (mData)
+    {
+        munmap(mData, mSize);
+        mData = nullptr;
+    }
+    if (mFD >= 0)
+    {
+        ::close(mFD);
+        mFD = -1;
+    }
+    mSize = 0;
+}
+
+bool LLMappedFile::flush(bool wait)
+{
+    if (!mData || mReadOnly)
+    {
+        return mData != nullptr;
+    }
+
+    return msync(mData, mSize, wait ? MS_SYNC : MS_ASYNC) == 0;
+}
+
+#endif // LL_WINDOWS
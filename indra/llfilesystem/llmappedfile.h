@@ -0,0 +1,85 @@
+/**
+ * @file llmappedfile.h
+ * @brief Read-write memory mapping of a whole file.
+ *
+ * @Description:
+ * Thin wrapper around mmap() and MapViewOfFile() for cache files that
+ * are read and patched in place at random offsets. Writes through the
+ * mapping land in the OS page cache and survive a crash of the viewer
+ * process; flush() only matters for surviving an OS crash or power loss.
+ *
+ * The mapping is fixed in size once opened. Callers that need room to
+ * grow ask for the final size up front; the extra space is zero filled
+ * and, on most filesystems, sparse until written.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMAPPEDFILE_H
+#define LL_LLMAPPEDFILE_H
+
+class LLMappedFile
+{
+public:
+    LLMappedFile();
+    ~LLMappedFile();
+
+    LLMappedFile(const LLMappedFile&) = delete;
+    LLMappedFile& operator=(const LLMappedFile&) = delete;
+
+    /**
+     * Map filename into memory, creating it if needed. A writable file
+     * shorter than size is grown to size; a size of 0 maps the file as it
+     * is. A read only mapping of a missing or empty file fails. Returns
+     * false on failure, leaving the object closed.
+     */
+    bool open(const std::string& filename, size_t size, bool read_only = false);
+
+    /**
+     * Unmap and close the file. Does not flush.
+     */
+    void close();
+
+    bool isOpen() const { return mData != nullptr; }
+    bool isReadOnly() const { return mReadOnly; }
+
+    U8* getData() const { return mData; }
+    size_t getSize() const { return mSize; }
+
+    /**
+     * Start writing dirty pages back to disk. With wait the call only
+     * returns once the data and the file metadata are on disk.
+     */
+    bool flush(bool wait = false);
+
+private:
+    U8*     mData = nullptr;
+    size_t  mSize = 0;
+    bool    mReadOnly = false;
+#if LL_WINDOWS
+    void*   mFile = nullptr;
+    void*   mMapping = nullptr;
+#else
+    int     mFD = -1;
+#endif
+};
+
+#endif // LL_LLMAPPEDFILE_H
@@ -0,0 +1,385 @@
+/**
+ * @file lldiskcacheindex_test.cpp
+ * @brief LLDiskCacheIndex test cases.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../lldiskcacheindex.h"
+
+#include "../test/lltut.h"
+#include "../test/namedtempfile.h"
+#include "llstring.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/range/iterator_range.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace tut
+{
+    struct LLDiskCacheIndexFixture
+    {
+        LLDiskCacheIndexFixture()
+            : mDir(NamedTempFile::temp_path("diskcache"))
+        {
+            boost::filesystem::create_directories(mDir);
+            mJournal = (mDir / "index.journal").string();
+        }
+
+        ~LLDiskCacheIndexFixture()
+        {
+            boost::system::error_code ec;
+            boost::filesystem::remove_all(mDir, ec);
+        }
+
+        void writeCacheFile(const LLUUID& id, size_t size)
+        {
+            std::string name = id.asString() + ".sl_cache";
+            boost::filesystem::path path = mDir / name.substr(0, 1);
+            boost::filesystem::create_directories(path);
+            LLFILE* file = LLFile::fopen((path / name).string(), "wb");
+            std::vector<char> data(size, 'x');
+            fwrite(data.data(), 1, data.size(), file);
+            LLFile::close(file);
+        }
+
+        static LLUUID makeID(U32 n)
+        {
+            LLUUID id;
+            memcpy(id.mData, &n, sizeof(n));
+            id.mData[UUID_BYTES - 1] = 0x5a;
+            return id;
+        }
+
+        boost::filesystem::path mDir;
+        std::string mJournal;
+    };
+    typedef test_group<LLDiskCacheIndexFixture> LLDiskCacheIndex_factory;
+    typedef LLDiskCacheIndex_factory::object LLDiskCacheIndex_t;
+    LLDiskCacheIndex_factory tf("LLDiskCacheIndex");
+
+    template<> template<>
+    void LLDiskCacheIndex_t::test<1>()
+    {
+        set_test_name("eviction follows access order");
+
+        LLDiskCacheIndex index(mJournal);
+        const LLUUID a(makeID(1)), b(makeID(2)), c(makeID(3));
+        index.insert(a, LLAssetType::AT_SOUND, 10);
+        index.insert(b, LLAssetType::AT_SOUND, 10);
+        index.insert(c, LLAssetType::AT_SOUND, 10);
+        index.touch(a);
+        ensure_equals("total size", index.getTotalSize(), (uintmax_t)30);
+
+        std::vector<LLDiskCacheIndex::Entry> evicted;
+        index.evict(15, evicted);
+        ensure_equals("evicted count", evicted.size(), (size_t)2);
+        ensure_equals("oldest evicted first", evicted[0].mID, b);
+        ensure_equals("then the next oldest", evicted[1].mID, c);
+        ensure("touched entry kept", index.contains(a));
+        ensure_equals("size after eviction", index.getTotalSize(), (uintmax_t)10);
+
+        index.insert(a, LLAssetType::AT_SOUND, 25);
+        ensure_equals("rewrite replaces size", index.getTotalSize(), (uintmax_t)25);
+        index.rename(a, b, LLAssetType::AT_NOTECARD);
+        ensure("rename drops old id", !index.contains(a));
+        ensure("rename adds new id", index.contains(b));
+        index.erase(b);
+        ensure_equals("empty after erase", index.getEntryCount(), (size_t)0);
+    }
+
+    template<> template<>
+    void LLDiskCacheIndex_t::test<2>()
+    {
+        set_test_name("journal round trip");
+
+        {
+            LLDiskCacheIndex index(mJournal);
+            ensure("no journal yet", !index.load());
+            for (U32 i = 0; i < 100; ++i)
+            {
+                index.insert(makeID(i), LLAssetType::AT_TEXTURE, 100);
+            }
+            index.touch(makeID(0));
+            index.erase(makeID(50));
+            index.flush();
+        }
+
+        LLDiskCacheIndex index(mJournal);
+        ensure("journal loads", index.load());
+        ensure_equals("entry count", index.getEntryCount(), (size_t)99);
+        ensure_equals("total size", index.getTotalSize(), (uintmax_t)9900);
+        ensure("erased entry stays erased", !index.contains(makeID(50)));
+
+        std::vector<LLDiskCacheIndex::Entry> evicted;
+        index.evict(9800, evicted);
+        ensure_equals("evicted count", evicted.size(), (size_t)1);
+        ensure_equals("access order survives reload", evicted[0].mID, makeID(1));
+    }
+
+    template<> template<>
+    void LLDiskCacheIndex_t::test<3>()
+    {
+        set_test_name("torn journal record");
+
+        {
+            LLDiskCacheIndex index(mJournal);
+            index.insert(makeID(1), LLAssetType::AT_TEXTURE, 100);
+            index.insert(makeID(2), LLAssetType::AT_TEXTURE, 100);
+            index.flush();
+        }
+
+        // Simulate a crash halfway through appending a record
+        LLFILE* file = LLFile::fopen(mJournal, "ab");
+        fwrite("torn", 1, 4, file);
+        LLFile::close(file);
+
+        {
+            LLDiskCacheIndex index(mJournal);
+            ensure("torn journal still loads", index.load());
+            ensure_equals("records before the tear kept", index.getEntryCount(), (size_t)2);
+            index.insert(makeID(3), LLAssetType::AT_TEXTURE, 100);
+            index.flush();
+        }
+
+        LLDiskCacheIndex index(mJournal);
+        ensure("compacted journal loads", index.load());
+        ensure_equals("appends after the tear kept", index.getEntryCount(), (size_t)3);
+    }
+
+    template<> template<>
+    void LLDiskCacheIndex_t::test<4>()
+    {
+        set_test_name("corrupt journal and directory rebuild");
+
+        for (U32 i = 0; i < 20; ++i)
+        {
+            writeCacheFile(makeID(i), 64);
+        }
+
+        LLFILE* file = LLFile::fopen(mJournal, "wb");
+        fwrite("not a journal at all", 1, 20, file);
+        LLFile::close(file);
+
+        LLDiskCacheIndex index(mJournal);
+        ensure("corrupt journal rejected", !index.load());
+        index.rebuild(mDir.string(), ".sl_cache");
+        ensure_equals("rebuilt entry count", index.getEntryCount(), (size_t)20);
+        ensure_equals("rebuilt total size", index.getTotalSize(), (uintmax_t)(20 * 64));
+
+        LLDiskCacheIndex reloaded(mJournal);
+        ensure("rebuild writes a fresh journal", reloaded.load());
+        ensure_equals("reloaded entry count", reloaded.getEntryCount(), (size_t)20);
+    }
+
+    template<> template<>
+    void LLDiskCacheIndex_t::test<5>()
+    {
+        set_test_name("purge and startup benchmark");
+
+        // Creating hundreds of thousands of files takes a while, so this only
+        // runs on request, e.g. LL_DISKCACHE_BENCH_ENTRIES=100000,500000
+        std::string sizes = LLStringUtil::getenv("LL_DISKCACHE_BENCH_ENTRIES");
+        if (sizes.empty())
+        {
+            skip("set LL_DISKCACHE_BENCH_ENTRIES to run");
+        }
+
+        typedef std::chrono::high_resolution_clock clock_t;
+        auto ms = [](clock_t::time_point start)
+        {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(clock_t::now() - start).count();
+        };
+
+        std::vector<std::string> counts;
+        LLStringUtil::getTokens(sizes, counts, ",");
+        for (const std::string& count_str : counts)
+        {
+            const U32 count = (U32)std::stoul(count_str);
+            const uintmax_t file_size = 1024;
+
+            boost::system::error_code ec;
+            boost::filesystem::remove_all(mDir, ec);
+            boost::filesystem::create_directories(mDir);
+            for (U32 i = 0; i < count; ++i)
+            {
+                writeCacheFile(makeID(i), file_size);
+            }
+
+            // Old purge: walk the directory, stat every file, sort by time
+            auto start = clock_t::now();
+            typedef std::pair<std::time_t, uintmax_t> file_info_t;
+            std::vector<file_info_t> file_info;
+            boost::filesystem::recursive_directory_iterator dir_iter(mDir);
+            for (auto& entry : boost::make_iterator_range(dir_iter, {}))
+            {
+                if (boost::filesystem::is_regular_file(entry, ec)
+                    && entry.path().extension() == ".sl_cache")
+                {
+                    file_info.emplace_back(boost::filesystem::last_write_time(entry, ec),
+                                           boost::filesystem::file_size(entry, ec));
+                }
+            }
+            std::sort(file_info.begin(), file_info.end(), [](const file_info_t& x, const file_info_t& y)
+            {
+                return x.first > y.first;
+            });
+            const auto walk_ms = ms(start);
+
+            // Indexed startup without a journal
+            start = clock_t::now();
+            {
+                LLDiskCacheIndex index(mJournal);
+                index.rebuild(mDir.string(), ".sl_cache");
+            }
+            const auto rebuild_ms = ms(start);
+
+            // Indexed startup from the journal
+            LLDiskCacheIndex index(mJournal);
+            start = clock_t::now();
+            index.load();
+            const auto load_ms = ms(start);
+
+            // Indexed purge of 10% of the cache, excluding the file deletes
+            // which cost the same in both modes
+            std::vector<LLDiskCacheIndex::Entry> evicted;
+            start = clock_t::now();
+            index.evict(index.getTotalSize() - (count / 10) * file_size, evicted);
+            index.flush();
+            const auto evict_ms = ms(start);
+
+            std::cout << "\n" << count << " entries:"
+                      << " directory walk purge scan " << walk_ms << " ms,"
+                      << " index rebuild " << rebuild_ms << " ms,"
+                      << " journal load " << load_ms << " ms,"
+                      << " indexed purge of " << evicted.size() << " files " << evict_ms << " ms"
+                      << std::endl;
+        }
+    }
+
+    template<> template<>
+    void LLDiskCacheIndex_t::test<6>()
+    {
+        set_test_name("journal is appended without waiting for a purge");
+
+        LLDiskCacheIndex index(mJournal);
+        for (U32 i = 0; i < 1000; ++i)
+        {
+            index.insert(makeID(i), LLAssetType::AT_TEXTURE, 10);
+        }
+
+        // No flush(), as after a crash
+        {
+            LLDiskCacheIndex reader(mJournal);
+            ensure("journal written", reader.load());
+            ensure("most entries survive", reader.getEntryCount() >= 512);
+            ensure("first entry survives", reader.contains(makeID(0)));
+        }
+
+        // Evictions wait for the caller's flush() even when the buffer
+        // fills up in the meantime
+        index.flush();
+        std::vector<LLDiskCacheIndex::Entry> evicted;
+        index.evict(9000, evicted);
+        ensure_equals("evicted count", evicted.size(), (size_t)100);
+        for (U32 i = 1000; i < 2000; ++i)
+        {
+            index.insert(makeID(i), LLAssetType::AT_TEXTURE, 0);
+        }
+        {
+            LLDiskCacheIndex reader(mJournal);
+            ensure("journal loads", reader.load());
+            ensure("eviction not journaled yet", reader.contains(makeID(0)));
+        }
+
+        index.flush();
+        LLDiskCacheIndex reader(mJournal);
+        ensure("journal loads after flush", reader.load());
+        ensure("eviction journaled", !reader.contains(makeID(0)));
+        ensure_equals("entry count", reader.getEntryCount(), (size_t)1900);
+    }
+
+    template<> template<>
+    void LLDiskCacheIndex_t::test<7>()
+    {
+        set_test_name("records that fail to append stay pending");
+
+        LLDiskCacheIndex index(mJournal);
+        index.insert(makeID(1), LLAssetType::AT_TEXTURE, 10);
+        index.flush();
+
+        // Something in the way of the journal, the append fails
+        boost::filesystem::remove(mJournal);
+        boost::filesystem::create_directory(mJournal);
+        index.insert(makeID(2), LLAssetType::AT_TEXTURE, 10);
+        index.erase(makeID(1));
+        index.flush();
+        index.insert(makeID(3), LLAssetType::AT_TEXTURE, 10);
+
+        boost::filesystem::remove(mJournal);
+        index.flush();
+
+        LLDiskCacheIndex reader(mJournal);
+        ensure("journal loads", reader.load());
+        ensure("failed insert kept", reader.contains(makeID(2)));
+        ensure("failed erase kept", !reader.contains(makeID(1)));
+        ensure("later insert kept", reader.contains(makeID(3)));
+        ensure_equals("entry count", reader.getEntryCount(), (size_t)2);
+    }
+
+    template<> template<>
+    void LLDiskCacheIndex_t::test<8>()
+    {
+        set_test_name("rebuild indexes packed assets alongside loose files");
+
+        for (U32 i = 0; i < 4; ++i)
+        {
+            writeCacheFile(makeID(i), 100);
+        }
+
+        std::vector<LLDiskCacheIndex::Entry> packed;
+        for (U32 i = 3; i < 10; ++i)
+        {
+            packed.push_back(LLDiskCacheIndex::Entry{ makeID(i), LLAssetType::AT_NOTECARD, 10, 1 });
+        }
+
+        LLDiskCacheIndex index(mJournal);
+        index.rebuild(mDir.string(), ".sl_cache", packed);
+        ensure_equals("entry count", index.getEntryCount(), (size_t)10);
+        // ID 3 is both loose and packed
+        ensure_equals("total size", index.getTotalSize(), (uintmax_t)(4 * 100 + 7 * 10));
+        ensure("packed asset indexed", index.contains(makeID(9)));
+
+        // The packed assets are older than any file written just now
+        std::vector<LLDiskCacheIndex::Entry> evicted;
+        index.evict(410, evicted);
+        ensure_equals("packed assets evicted first", evicted.size(), (size_t)6);
+        ensure("loose file kept", index.contains(makeID(0)));
+
+        LLDiskCacheIndex reloaded(mJournal);
+        ensure("rebuild writes a fresh journal", reloaded.load());
+        ensure("journal has the packed assets", reloaded.contains(makeID(9)));
+    }
+}
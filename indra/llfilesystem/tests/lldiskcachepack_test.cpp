@@ -0,0 +1,435 @@
+/**
+ * @file lldiskcachepack_test.cpp
+ * @brief LLDiskCachePack test cases.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../lldiskcachepack.h"
+
+#include "../test/lltut.h"
+#include "../test/namedtempfile.h"
+#include "llstring.h"
+
+#include <boost/filesystem.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace tut
+{
+    struct LLDiskCachePackFixture
+    {
+        LLDiskCachePackFixture()
+            : mDir(NamedTempFile::temp_path("diskcachepack"))
+        {
+            boost::filesystem::create_directories(mDir);
+            mPrefix = mDir.string() + "/";
+        }
+
+        ~LLDiskCachePackFixture()
+        {
+            boost::system::error_code ec;
+            boost::filesystem::remove_all(mDir, ec);
+        }
+
+        static LLUUID makeID(U32 n)
+        {
+            LLUUID id;
+            memcpy(id.mData, &n, sizeof(n));
+            id.mData[UUID_BYTES - 1] = 0xa5;
+            return id;
+        }
+
+        static std::vector<U8> makeData(size_t size, U8 seed)
+        {
+            std::vector<U8> data(size);
+            for (size_t i = 0; i < size; ++i)
+            {
+                data[i] = (U8)(seed + i * 7);
+            }
+            return data;
+        }
+
+        std::vector<U8> readAll(LLDiskCachePack& pack, const LLUUID& id)
+        {
+            std::vector<U8> data(llmax(pack.getSize(id), 0));
+            if (!data.empty())
+            {
+                pack.read(id, 0, data.data(), (S32)data.size());
+            }
+            return data;
+        }
+
+        boost::filesystem::path mDir;
+        std::string mPrefix;
+    };
+    typedef test_group<LLDiskCachePackFixture> LLDiskCachePack_factory;
+    typedef LLDiskCachePack_factory::object LLDiskCachePack_t;
+    LLDiskCachePack_factory tf("LLDiskCachePack");
+
+    template<> template<>
+    void LLDiskCachePack_t::test<1>()
+    {
+        set_test_name("write, append and read back");
+
+        LLDiskCachePack pack(mPrefix, 64 * 1024);
+        ensure("pack opens", pack.open());
+
+        const LLUUID id(makeID(1));
+        ensure_equals("unknown asset", pack.getSize(id), -1);
+
+        std::vector<U8> first = makeData(200, 1);
+        ensure_equals("initial write", pack.write(id, LLAssetType::AT_NOTECARD, 0, first.data(), (S32)first.size(), true), 200);
+
+        // Grows past the first extent and has to move
+        std::vector<U8> second = makeData(5000, 2);
+        ensure_equals("append", pack.write(id, LLAssetType::AT_NOTECARD, 200, second.data(), (S32)second.size(), false), 5200);
+
+        std::vector<U8> expected = first;
+        expected.insert(expected.end(), second.begin(), second.end());
+        ensure("data survives relocation", readAll(pack, id) == expected);
+
+        // Update in the middle, which goes to a fresh extent
+        std::vector<U8> patch = makeData(16, 3);
+        ensure_equals("overwrite", pack.write(id, LLAssetType::AT_NOTECARD, 100, patch.data(), (S32)patch.size(), false), 5200);
+        std::copy(patch.begin(), patch.end(), expected.begin() + 100);
+        ensure("overwrite lands", readAll(pack, id) == expected);
+
+        U8 buffer[64];
+        ensure_equals("partial read at the end", pack.read(id, 5180, buffer, sizeof(buffer)), 20);
+        ensure_equals("read past the end", pack.read(id, 6000, buffer, sizeof(buffer)), 0);
+
+        // A truncating write replaces the data
+        ensure_equals("rewrite", pack.write(id, LLAssetType::AT_NOTECARD, 0, patch.data(), (S32)patch.size(), true), 16);
+        ensure("rewrite replaces", readAll(pack, id) == patch);
+    }
+
+    template<> template<>
+    void LLDiskCachePack_t::test<2>()
+    {
+        set_test_name("size limit and extraction");
+
+        LLDiskCachePack pack(mPrefix, 1024);
+        ensure("pack opens", pack.open());
+
+        const LLUUID id(makeID(2));
+        std::vector<U8> big = makeData(2048, 4);
+        ensure_equals("too big refused", pack.write(id, LLAssetType::AT_SOUND, 0, big.data(), (S32)big.size(), true), -1);
+        ensure("refused asset not packed", !pack.contains(id));
+
+        std::vector<U8> small = makeData(1000, 5);
+        ensure_equals("small accepted", pack.write(id, LLAssetType::AT_SOUND, 0, small.data(), (S32)small.size(), true), 1000);
+        ensure_equals("growing past the limit refused", pack.write(id, LLAssetType::AT_SOUND, 1000, small.data(), (S32)small.size(), false), -1);
+        ensure("refused growth leaves data alone", readAll(pack, id) == small);
+
+        std::vector<U8> extracted;
+        ensure("extract", pack.extract(id, extracted));
+        ensure("extracted data", extracted == small);
+        ensure("extracted asset gone", !pack.contains(id));
+    }
+
+    template<> template<>
+    void LLDiskCachePack_t::test<3>()
+    {
+        set_test_name("rename, erase and snapshot");
+
+        std::vector<U8> data_a = makeData(300, 6);
+        std::vector<U8> data_b = makeData(9000, 7);
+        {
+            LLDiskCachePack pack(mPrefix, 64 * 1024);
+            ensure("pack opens", pack.open());
+            pack.write(makeID(1), LLAssetType::AT_GESTURE, 0, data_a.data(), (S32)data_a.size(), true);
+            pack.write(makeID(2), LLAssetType::AT_ANIMATION, 0, data_b.data(), (S32)data_b.size(), true);
+            pack.write(makeID(3), LLAssetType::AT_ANIMATION, 0, data_b.data(), (S32)data_b.size(), true);
+            ensure("rename", pack.rename(makeID(2), makeID(4), LLAssetType::AT_ANIMATION));
+            ensure("erase", pack.erase(makeID(3)));
+            ensure("erase unknown", !pack.erase(makeID(3)));
+        }
+
+        LLDiskCachePack pack(mPrefix, 64 * 1024);
+        ensure("pack reopens", pack.open());
+        ensure("renamed asset kept", readAll(pack, makeID(4)) == data_b);
+        ensure("small asset kept", readAll(pack, makeID(1)) == data_a);
+        ensure("old name gone", !pack.contains(makeID(2)));
+        ensure("erased asset gone", !pack.contains(makeID(3)));
+        ensure_equals("asset count", pack.getEntryCount(), 2);
+    }
+
+    template<> template<>
+    void LLDiskCachePack_t::test<4>()
+    {
+        set_test_name("freed space is reused only after a snapshot");
+
+        std::vector<U8> data_a = makeData(3000, 8);
+        std::vector<U8> data_b = makeData(3000, 9);
+
+        LLDiskCachePack pack(mPrefix, 64 * 1024);
+        ensure("pack opens", pack.open());
+        pack.write(makeID(1), LLAssetType::AT_SOUND, 0, data_a.data(), (S32)data_a.size(), true);
+        pack.flush();
+
+        pack.erase(makeID(1));
+        pack.write(makeID(1 + 256), LLAssetType::AT_SOUND, 0, data_b.data(), (S32)data_b.size(), true);
+
+        // The snapshot still maps the first asset to its old extent, which
+        // must not have been overwritten
+        {
+            LLDiskCachePack reader(mPrefix, 64 * 1024);
+            ensure("second instance opens", reader.open());
+            ensure("old snapshot still valid", readAll(reader, makeID(1)) == data_a);
+        }
+    }
+
+    template<> template<>
+    void LLDiskCachePack_t::test<5>()
+    {
+        set_test_name("small asset I/O benchmark");
+
+        // e.g. LL_DISKCACHE_BENCH_ENTRIES=20000
+        std::string sizes = LLStringUtil::getenv("LL_DISKCACHE_BENCH_ENTRIES");
+        if (sizes.empty())
+        {
+            skip("set LL_DISKCACHE_BENCH_ENTRIES to run");
+        }
+
+        typedef std::chrono::high_resolution_clock clock_t;
+        auto ms = [](clock_t::time_point start)
+        {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(clock_t::now() - start).count();
+        };
+
+        std::vector<std::string> counts;
+        LLStringUtil::getTokens(sizes, counts, ",");
+        for (const std::string& count_str : counts)
+        {
+            const U32 count = (U32)std::stoul(count_str);
+            std::vector<U8> data = makeData(2048, 10);
+            std::vector<U8> buffer(data.size());
+
+            auto start = clock_t::now();
+            for (U32 i = 0; i < count; ++i)
+            {
+                LLFILE* file = LLFile::fopen(mPrefix + makeID(i).asString() + ".sl_cache", "wb");
+                fwrite(data.data(), 1, data.size(), file);
+                LLFile::close(file);
+            }
+            const auto loose_write_ms = ms(start);
+
+            start = clock_t::now();
+            for (U32 i = 0; i < count; ++i)
+            {
+                LLFILE* file = LLFile::fopen(mPrefix + makeID(i).asString() + ".sl_cache", "rb");
+                fread(buffer.data(), 1, buffer.size(), file);
+                LLFile::close(file);
+            }
+            const auto loose_read_ms = ms(start);
+
+            LLDiskCachePack pack(mPrefix, 64 * 1024);
+            pack.open();
+            start = clock_t::now();
+            for (U32 i = 0; i < count; ++i)
+            {
+                pack.write(makeID(i), LLAssetType::AT_NOTECARD, 0, data.data(), (S32)data.size(), true);
+            }
+            pack.flush();
+            const auto pack_write_ms = ms(start);
+
+            start = clock_t::now();
+            for (U32 i = 0; i < count; ++i)
+            {
+                pack.read(makeID(i), 0, buffer.data(), (S32)buffer.size());
+            }
+            const auto pack_read_ms = ms(start);
+
+            std::cout << "\n" << count << " assets of " << data.size() << " bytes:"
+                      << " loose write " << loose_write_ms << " ms, read " << loose_read_ms << " ms (" << count * 2 << " opens);"
+                      << " packed write " << pack_write_ms << " ms, read " << pack_read_ms << " ms ("
+                      << LLDiskCachePack::SEGMENT_COUNT << " opens)" << std::endl;
+        }
+    }
+
+    template<> template<>
+    void LLDiskCachePack_t::test<6>()
+    {
+        set_test_name("overwrites leave the snapshot data intact");
+
+        const LLUUID id(makeID(6));
+        std::vector<U8> data = makeData(3000, 11);
+
+        LLDiskCachePack pack(mPrefix, 64 * 1024);
+        ensure("pack opens", pack.open());
+        pack.write(id, LLAssetType::AT_NOTECARD, 0, data.data(), (S32)data.size(), true);
+        pack.flush();
+
+        // Overwrite in the middle, append within the extent, then replace
+        // the asset altogether. None of it is snapshotted.
+        std::vector<U8> patch = makeData(64, 12);
+        ensure_equals("overwrite", pack.write(id, LLAssetType::AT_NOTECARD, 100, patch.data(), (S32)patch.size(), false), 3000);
+        ensure_equals("append", pack.write(id, LLAssetType::AT_NOTECARD, 3000, patch.data(), (S32)patch.size(), false), 3064);
+        std::vector<U8> expected = data;
+        std::copy(patch.begin(), patch.end(), expected.begin() + 100);
+        expected.insert(expected.end(), patch.begin(), patch.end());
+        ensure("current data", readAll(pack, id) == expected);
+
+        std::vector<U8> replacement = makeData(2000, 13);
+        ensure_equals("replace", pack.write(id, LLAssetType::AT_NOTECARD, 0, replacement.data(), (S32)replacement.size(), true), 2000);
+        ensure("replaced data", readAll(pack, id) == replacement);
+
+        // What a crash right now would leave: the snapshot pointing at the
+        // original data, untouched
+        {
+            LLDiskCachePack reader(mPrefix, 64 * 1024);
+            ensure("second instance opens", reader.open());
+            ensure("snapshot data intact", readAll(reader, id) == data);
+        }
+
+        pack.flush();
+        LLDiskCachePack reader(mPrefix, 64 * 1024);
+        ensure("reopens after flush", reader.open());
+        ensure("new snapshot has the replacement", readAll(reader, id) == replacement);
+    }
+
+    template<> template<>
+    void LLDiskCachePack_t::test<7>()
+    {
+        set_test_name("closed pack refuses requests");
+
+        const LLUUID id(makeID(7));
+        std::vector<U8> data = makeData(500, 14);
+
+        LLDiskCachePack pack(mPrefix, 64 * 1024);
+        ensure("pack opens", pack.open());
+        pack.write(id, LLAssetType::AT_GESTURE, 0, data.data(), (S32)data.size(), true);
+        pack.close();
+
+        // As seen by a thread that still held the pack across a cache clear
+        U8 buffer[16];
+        ensure("not contained", !pack.contains(id));
+        ensure_equals("no size", pack.getSize(id), -1);
+        ensure_equals("no read", pack.read(id, 0, buffer, sizeof(buffer)), -1);
+        ensure_equals("no write", pack.write(id, LLAssetType::AT_GESTURE, 0, data.data(), (S32)data.size(), true), -1);
+        ensure("no erase", !pack.erase(id));
+        pack.flush();
+
+        {
+            LLDiskCachePack reopened(mPrefix, 64 * 1024);
+            ensure("reopens", reopened.open());
+            ensure("close saved a snapshot", readAll(reopened, id) == data);
+        }
+
+        // A fresh pack over a cleared directory starts empty and works
+        boost::filesystem::remove_all(mDir);
+        boost::filesystem::create_directories(mDir);
+        LLDiskCachePack fresh(mPrefix, 64 * 1024);
+        ensure("fresh pack opens", fresh.open());
+        ensure_equals("fresh pack is empty", fresh.getEntryCount(), 0);
+        ensure_equals("fresh pack takes writes", fresh.write(id, LLAssetType::AT_GESTURE, 0, data.data(), (S32)data.size(), true), 500);
+    }
+
+    template<> template<>
+    void LLDiskCachePack_t::test<8>()
+    {
+        set_test_name("packed assets rebuild the index");
+
+        std::vector<U8> data = makeData(300, 16);
+        {
+            LLDiskCachePack pack(mPrefix, 64 * 1024);
+            ensure("pack opens", pack.open());
+            for (U32 i = 0; i < 10; ++i)
+            {
+                pack.write(makeID(i), LLAssetType::AT_NOTECARD, 0, data.data(), (S32)data.size(), true);
+            }
+        }
+
+        LLDiskCachePack pack(mPrefix, 64 * 1024);
+        ensure("pack reopens", pack.open());
+        std::vector<LLDiskCacheIndex::Entry> packed;
+        pack.getAssets(packed);
+        ensure_equals("packed asset count", packed.size(), (size_t)10);
+
+        // No journal and no loose files, everything comes from the pack
+        LLDiskCacheIndex index(mDir.string() + "/index.journal");
+        ensure("no journal", !index.load());
+        index.rebuild(mDir.string(), ".sl_cache", packed);
+        ensure_equals("indexed entry count", index.getEntryCount(), (size_t)10);
+        ensure_equals("indexed total size", index.getTotalSize(), (uintmax_t)(10 * 300));
+
+        std::vector<LLDiskCacheIndex::Entry> evicted;
+        index.evict(0, evicted);
+        ensure_equals("packed assets are evicted", evicted.size(), (size_t)10);
+        for (const LLDiskCacheIndex::Entry& entry : evicted)
+        {
+            ensure("evicted asset is erased from the pack", pack.erase(entry.mID));
+        }
+        ensure_equals("pack is empty", pack.getEntryCount(), 0);
+    }
+
+    template<> template<>
+    void LLDiskCachePack_t::test<9>()
+    {
+        set_test_name("concurrent writes flush outside the table lock");
+
+        LLDiskCachePack pack(mPrefix, 64 * 1024);
+        ensure("pack opens", pack.open());
+
+        // Each thread rewrites and appends its own assets while the others do
+        // the same, every asset must read back whole
+        constexpr U32 THREADS = 4;
+        constexpr U32 ASSETS = 32;
+        std::vector<std::thread> threads;
+        for (U32 t = 0; t < THREADS; ++t)
+        {
+            threads.emplace_back([&pack, t]()
+            {
+                for (U32 round = 0; round < 8; ++round)
+                {
+                    for (U32 i = 0; i < ASSETS; ++i)
+                    {
+                        const LLUUID id(makeID(t * ASSETS + i));
+                        std::vector<U8> head = makeData(100 + i, (U8)(t + round));
+                        std::vector<U8> tail = makeData(400, (U8)(t + i));
+                        pack.write(id, LLAssetType::AT_NOTECARD, 0, head.data(), (S32)head.size(), true);
+                        pack.write(id, LLAssetType::AT_NOTECARD, (S32)head.size(), tail.data(), (S32)tail.size(), false);
+                    }
+                }
+            });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+
+        for (U32 t = 0; t < THREADS; ++t)
+        {
+            for (U32 i = 0; i < ASSETS; ++i)
+            {
+                std::vector<U8> expected = makeData(100 + i, (U8)(t + 7));
+                std::vector<U8> tail = makeData(400, (U8)(t + i));
+                expected.insert(expected.end(), tail.begin(), tail.end());
+                ensure("asset reads back whole", readAll(pack, makeID(t * ASSETS + i)) == expected);
+            }
+        }
+        ensure_equals("asset count", pack.getEntryCount(), (S32)(THREADS * ASSETS));
+    }
+}
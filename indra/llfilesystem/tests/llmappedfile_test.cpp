@@ -0,0 +1,102 @@
+/**
+ * @file llmappedfile_test.cpp
+ * @brief LLMappedFile test cases.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../llmappedfile.h"
+
+#include "../test/lltut.h"
+#include "../test/namedtempfile.h"
+
+#include <boost/filesystem.hpp>
+
+namespace tut
+{
+    struct LLMappedFileFixture
+    {
+        LLMappedFileFixture()
+            : mPath(NamedTempFile::temp_path("mappedfile").string())
+        {
+        }
+
+        ~LLMappedFileFixture()
+        {
+            boost::system::error_code ec;
+            boost::filesystem::remove(mPath, ec);
+        }
+
+        std::string mPath;
+    };
+    typedef test_group<LLMappedFileFixture> LLMappedFile_factory;
+    typedef LLMappedFile_factory::object LLMappedFile_t;
+    LLMappedFile_factory tf("LLMappedFile");
+
+    template<> template<>
+    void LLMappedFile_t::test<1>()
+    {
+        set_test_name("create, write and map again");
+
+        {
+            LLMappedFile file;
+            ensure("missing file not mapped read only", !file.open(mPath, 4096, true));
+            ensure("file created", file.open(mPath, 4096));
+            ensure_equals("mapped size", file.getSize(), (size_t)4096);
+            ensure_equals("new file is zero filled", (S32)file.getData()[4095], 0);
+            memcpy(file.getData() + 100, "mapped", 6);
+            ensure("flush", file.flush(true));
+        }
+
+        ensure_equals("file size on disk", (size_t)boost::filesystem::file_size(mPath), (size_t)4096);
+
+        LLMappedFile file;
+        ensure("existing file mapped read only", file.open(mPath, 0, true));
+        ensure("read only", file.isReadOnly());
+        ensure_equals("whole file mapped", file.getSize(), (size_t)4096);
+        ensure("data kept", memcmp(file.getData() + 100, "mapped", 6) == 0);
+    }
+
+    template<> template<>
+    void LLMappedFile_t::test<2>()
+    {
+        set_test_name("grow and keep existing data");
+
+        {
+            LLMappedFile file;
+            ensure("file created", file.open(mPath, 64));
+            memcpy(file.getData(), "head", 4);
+        }
+
+        LLMappedFile file;
+        ensure("file grown", file.open(mPath, 1 << 20));
+        ensure_equals("grown size", file.getSize(), (size_t)(1 << 20));
+        ensure("old data kept", memcmp(file.getData(), "head", 4) == 0);
+        ensure_equals("grown part zero filled", (S32)file.getData()[(1 << 20) - 1], 0);
+
+        // Asking for less than the file size maps the whole file
+        file.close();
+        ensure("not open after close", !file.isOpen());
+        ensure("file mapped", file.open(mPath, 64));
+        ensure_equals("never shrinks", file.getSize(), (size_t)(1 << 20));
+    }
+}
@@ -39,6 +39,7 @@
 #include "llimagepng.h"
 #include "llimagewebp.h"
 #include "llimagedxt.h"
+#include "llimagesimd.h"
 #include "llmemory.h"
 
 #include <boost/preprocessor.hpp>
@@ -465,6 +466,12 @@ inline void bilinear_scale(
 		S32 Cx, Cy, i, j;
 		S32 xap, yap;
 
+		if (ch == 4 && LLImageSIMD::scaleDown4(&info.ystrides[0], &info.xpoints[0], &info.xapoints[0], &info.yapoints[0],
+											   srcStride, dst, dstW, dstH, dstStride))
+		{
+			return;
+		}
+
 		for(y = 0; y < dstH; y++)
 		{
 			Cy = info.yapoints[y] >> 16;
@@ -1202,6 +1209,11 @@ void LLImageRaw::compositeUnscaled4onto3( LLImageRaw* src )
 		return;
 	}
 
+	if (LLImageSIMD::composite4onto3(src_data, dst_data, pixels))
+	{
+		return;
+	}
+
 	while( pixels-- )
 	{
 		U8 alpha = src_data[3];
@@ -1399,6 +1411,10 @@ void LLImageRaw::copyUnscaled4onto3( LLImageRaw* src )
 	S32 pixels = getWidth() * getHeight();
 	U8* src_data = src->getData();
 	U8* dst_data = dst->getData();
+	if (LLImageSIMD::copy4onto3(src_data, dst_data, pixels))
+	{
+		return;
+	}
 	for( S32 i=0; i<pixels; i++ )
 	{
 		dst_data[0] = src_data[0];
@@ -1421,6 +1437,10 @@ void LLImageRaw::copyUnscaled3onto4( LLImageRaw* src )
 	S32 pixels = getWidth() * getHeight();
 	U8* src_data = src->getData();
 	U8* dst_data = dst->getData();
+	if (LLImageSIMD::copy3onto4(src_data, dst_data, pixels))
+	{
+		return;
+	}
 	for( S32 i=0; i<pixels; i++ )
 	{
 		dst_data[0] = src_data[0];
@@ -2324,6 +2344,10 @@ void LLImageBase::setDataAndSize(U8 *data, S32 size)
 void LLImageBase::generateMip(const U8* indata, U8* mipdata, S32 width, S32 height, S32 nchannels)
 {
 	llassert(width > 0 && height > 0);
+	if (LLImageSIMD::generateMip(indata, mipdata, width, height, nchannels))
+	{
+		return;
+	}
 	U8* data = mipdata;
 	S32 in_width = width*2;
 	for (S32 h=0; h<height; h++)
@@ -0,0 +1,597 @@
+/**
+ * @file llimagesimd.cpp
+ * @brief Vectorized pixel loops for LLImageRaw, picked at run time.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llimagesimd.h"
+
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#include <immintrin.h>
+#if LL_MSVC
+#include <intrin.h>
+#endif
+
+// AVX2 kernels are compiled for AVX2 whatever the build targets, and only
+// called once the CPU is known to have it.
+#if LL_MSVC
+#define LL_TARGET_AVX2
+#else
+#define LL_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace
+{
+	bool cpu_has_avx2()
+	{
+#if LL_MSVC
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+		{
+			return false;
+		}
+		__cpuid(info, 1);
+		const int OSXSAVE = 1 << 27;
+		const int AVX = 1 << 28;
+		if ((info[2] & (OSXSAVE | AVX)) != (OSXSAVE | AVX) || (_xgetbv(0) & 6) != 6)
+		{
+			return false;
+		}
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+
+	std::atomic<S32>& level()
+	{
+		static std::atomic<S32> sLevel(LLImageSIMD::getSupportedLevel());
+		return sLevel;
+	}
+
+	inline U32 load_u32(const U8* p)
+	{
+		U32 v;
+		memcpy(&v, p, sizeof(U32));
+		return v;
+	}
+
+	inline void store_u32(U8* p, U32 v)
+	{
+		memcpy(p, &v, sizeof(U32));
+	}
+
+	inline __m128i load_12(const U8* p)
+	{
+		return _mm_insert_epi32(_mm_loadl_epi64((const __m128i*)p), (int)load_u32(p + 8), 2);
+	}
+
+	inline void store_12(U8* p, __m128i v)
+	{
+		_mm_storel_epi64((__m128i*)p, v);
+		store_u32(p + 8, (U32)_mm_extract_epi32(v, 2));
+	}
+
+	//
+	// Mips: each output byte is the truncated average of four input bytes
+	//
+
+	// Picks the even and odd pixels of 16 input bytes into the low 8 bytes
+	struct MipShuffle
+	{
+		S8 mEven[16];
+		S8 mOdd[16];
+		S32 mInBytes;	// input bytes used from each 16 byte load
+		S32 mOutBytes;	// of the 8 stored
+	};
+
+	const MipShuffle MIP_SHUFFLES[4] =
+	{
+		{ { 0, 2, 4, 6, 8, 10, 12, 14, -1, -1, -1, -1, -1, -1, -1, -1 },
+		  { 1, 3, 5, 7, 9, 11, 13, 15, -1, -1, -1, -1, -1, -1, -1, -1 }, 16, 8 },
+		{ { 0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1 },
+		  { 2, 3, 6, 7, 10, 11, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1 }, 16, 8 },
+		{ { 0, 1, 2, 6, 7, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		  { 3, 4, 5, 9, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 }, 12, 6 },
+		{ { 0, 1, 2, 3, 8, 9, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1 },
+		  { 4, 5, 6, 7, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1 }, 16, 8 }
+	};
+
+	void mip_pixels(const U8* row0, const U8* row1, U8* out, S32 first, S32 last, S32 n)
+	{
+		for (S32 i = first * n; i < last * n; ++i)
+		{
+			S32 x = i / n;
+			S32 c = i - x * n;
+			S32 in = x * 2 * n + c;
+			out[i] = (U8)(((U32)row0[in] + row0[in + n] + row1[in] + row1[in + n]) >> 2);
+		}
+	}
+
+	inline __m128i mip_block_sse(const U8* row0, const U8* row1, __m128i even, __m128i odd)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		__m128i a = _mm_loadu_si128((const __m128i*)row0);
+		__m128i b = _mm_loadu_si128((const __m128i*)row1);
+		__m128i sum = _mm_add_epi16(_mm_unpacklo_epi8(_mm_shuffle_epi8(a, even), zero),
+									_mm_unpacklo_epi8(_mm_shuffle_epi8(a, odd), zero));
+		sum = _mm_add_epi16(sum, _mm_unpacklo_epi8(_mm_shuffle_epi8(b, even), zero));
+		sum = _mm_add_epi16(sum, _mm_unpacklo_epi8(_mm_shuffle_epi8(b, odd), zero));
+		sum = _mm_srli_epi16(sum, 2);
+		return _mm_packus_epi16(sum, sum);
+	}
+
+	// Returns the input offset reached; out advances by half of it
+	S32 mip_row_sse(const U8* row0, const U8* row1, U8* out, S32 in_bytes, S32 out_bytes, const MipShuffle& shuffle, S32 in_off)
+	{
+		const __m128i even = _mm_loadu_si128((const __m128i*)shuffle.mEven);
+		const __m128i odd = _mm_loadu_si128((const __m128i*)shuffle.mOdd);
+		// Loads read 16 bytes and stores write 8, whatever is used of them
+		while (in_off + 16 <= in_bytes && in_off / 2 + 8 <= out_bytes)
+		{
+			_mm_storel_epi64((__m128i*)(out + in_off / 2), mip_block_sse(row0 + in_off, row1 + in_off, even, odd));
+			in_off += shuffle.mInBytes;
+		}
+		return in_off;
+	}
+
+	LL_TARGET_AVX2 S32 mip_row_avx2(const U8* row0, const U8* row1, U8* out, S32 in_bytes, S32 out_bytes, const MipShuffle& shuffle)
+	{
+		const __m256i even = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)shuffle.mEven));
+		const __m256i odd = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)shuffle.mOdd));
+		const __m256i zero = _mm256_setzero_si256();
+		const S32 step = shuffle.mInBytes;
+		S32 in_off = 0;
+		while (in_off + step + 16 <= in_bytes && (in_off + step) / 2 + 8 <= out_bytes)
+		{
+			// One block per 128 bit lane, as the byte shuffles stay in their lane
+			__m256i a = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(row0 + in_off))),
+												_mm_loadu_si128((const __m128i*)(row0 + in_off + step)), 1);
+			__m256i b = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(row1 + in_off))),
+												_mm_loadu_si128((const __m128i*)(row1 + in_off + step)), 1);
+			__m256i sum = _mm256_add_epi16(_mm256_unpacklo_epi8(_mm256_shuffle_epi8(a, even), zero),
+										   _mm256_unpacklo_epi8(_mm256_shuffle_epi8(a, odd), zero));
+			sum = _mm256_add_epi16(sum, _mm256_unpacklo_epi8(_mm256_shuffle_epi8(b, even), zero));
+			sum = _mm256_add_epi16(sum, _mm256_unpacklo_epi8(_mm256_shuffle_epi8(b, odd), zero));
+			sum = _mm256_packus_epi16(_mm256_srli_epi16(sum, 2), zero);
+			_mm_storel_epi64((__m128i*)(out + in_off / 2), _mm256_castsi256_si128(sum));
+			_mm_storel_epi64((__m128i*)(out + (in_off + step) / 2), _mm256_extracti128_si256(sum, 1));
+			in_off += step * 2;
+		}
+		return in_off;
+	}
+
+	//
+	// Channel conversion
+	//
+
+	const S8 SHUFFLE_3_TO_4[16] = { 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1 };
+	const S8 SHUFFLE_4_TO_3[16] = { 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1 };
+	const S8 SHUFFLE_ALPHA_3[16] = { 3, 3, 3, 7, 7, 7, 11, 11, 11, 15, 15, 15, -1, -1, -1, -1 };
+
+	S32 copy3onto4_sse(const U8* src, U8* dst, S32 pixels, S32 done)
+	{
+		const __m128i shuffle = _mm_loadu_si128((const __m128i*)SHUFFLE_3_TO_4);
+		const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+		// A load reads 16 bytes for the 12 of four pixels
+		while (done * 3 + 16 <= pixels * 3)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(src + done * 3));
+			_mm_storeu_si128((__m128i*)(dst + done * 4), _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha));
+			done += 4;
+		}
+		return done;
+	}
+
+	LL_TARGET_AVX2 S32 copy3onto4_avx2(const U8* src, U8* dst, S32 pixels)
+	{
+		const __m256i shuffle = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)SHUFFLE_3_TO_4));
+		const __m256i alpha = _mm256_set1_epi32((int)0xff000000);
+		S32 done = 0;
+		while (done * 3 + 28 <= pixels * 3)
+		{
+			__m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(src + done * 3))),
+												_mm_loadu_si128((const __m128i*)(src + done * 3 + 12)), 1);
+			_mm256_storeu_si256((__m256i*)(dst + done * 4), _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), alpha));
+			done += 8;
+		}
+		return done;
+	}
+
+	S32 copy4onto3_sse(const U8* src, U8* dst, S32 pixels, S32 done)
+	{
+		const __m128i shuffle = _mm_loadu_si128((const __m128i*)SHUFFLE_4_TO_3);
+		while (done + 4 <= pixels)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(src + done * 4));
+			store_12(dst + done * 3, _mm_shuffle_epi8(v, shuffle));
+			done += 4;
+		}
+		return done;
+	}
+
+	LL_TARGET_AVX2 S32 copy4onto3_avx2(const U8* src, U8* dst, S32 pixels)
+	{
+		const __m256i shuffle = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)SHUFFLE_4_TO_3));
+		S32 done = 0;
+		while (done + 8 <= pixels)
+		{
+			__m256i v = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + done * 4)), shuffle);
+			store_12(dst + done * 3, _mm256_castsi256_si128(v));
+			store_12(dst + done * 3 + 12, _mm256_extracti128_si256(v, 1));
+			done += 8;
+		}
+		return done;
+	}
+
+	//
+	// Compositing, with LLImageRaw::fastFractionalMult() on 16 bit lanes:
+	// a * b + 128 fits, and so does adding its high byte.
+	//
+
+	inline U8 fast_fractional_mult(U8 a, U8 b)
+	{
+		U32 i = a * b + 128;
+		return U8((i + (i >> 8)) >> 8);
+	}
+
+	void composite_pixels(const U8* src, U8* dst, S32 first, S32 last)
+	{
+		for (S32 i = first; i < last; ++i)
+		{
+			const U8* s = src + i * 4;
+			U8* d = dst + i * 3;
+			U8 alpha = s[3];
+			if (alpha)
+			{
+				if (255 == alpha)
+				{
+					d[0] = s[0];
+					d[1] = s[1];
+					d[2] = s[2];
+				}
+				else
+				{
+					U8 transparency = 255 - alpha;
+					d[0] = fast_fractional_mult(d[0], transparency) + fast_fractional_mult(s[0], alpha);
+					d[1] = fast_fractional_mult(d[1], transparency) + fast_fractional_mult(s[1], alpha);
+					d[2] = fast_fractional_mult(d[2], transparency) + fast_fractional_mult(s[2], alpha);
+				}
+			}
+		}
+	}
+
+	inline __m128i fast_fractional_mult_sse(__m128i a, __m128i b)
+	{
+		__m128i i = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128));
+		return _mm_srli_epi16(_mm_add_epi16(i, _mm_srli_epi16(i, 8)), 8);
+	}
+
+	// Both special cases of the scalar loop fall out of the blend: an
+	// alpha of 0 gives dst back and 255 gives src, exactly.
+	inline __m128i blend_sse(__m128i src, __m128i dst, __m128i alpha)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i low_byte = _mm_set1_epi16(0xff);
+		const __m128i transparency = _mm_xor_si128(alpha, _mm_set1_epi8(-1));
+		__m128i lo = _mm_add_epi16(fast_fractional_mult_sse(_mm_unpacklo_epi8(dst, zero), _mm_unpacklo_epi8(transparency, zero)),
+								   fast_fractional_mult_sse(_mm_unpacklo_epi8(src, zero), _mm_unpacklo_epi8(alpha, zero)));
+		__m128i hi = _mm_add_epi16(fast_fractional_mult_sse(_mm_unpackhi_epi8(dst, zero), _mm_unpackhi_epi8(transparency, zero)),
+								   fast_fractional_mult_sse(_mm_unpackhi_epi8(src, zero), _mm_unpackhi_epi8(alpha, zero)));
+		// The sum wraps like the U8 it is assigned to
+		return _mm_packus_epi16(_mm_and_si128(lo, low_byte), _mm_and_si128(hi, low_byte));
+	}
+
+	S32 composite4onto3_sse(const U8* src, U8* dst, S32 pixels, S32 done)
+	{
+		const __m128i rgb_shuffle = _mm_loadu_si128((const __m128i*)SHUFFLE_4_TO_3);
+		const __m128i alpha_shuffle = _mm_loadu_si128((const __m128i*)SHUFFLE_ALPHA_3);
+		while (done + 4 <= pixels)
+		{
+			__m128i s = _mm_loadu_si128((const __m128i*)(src + done * 4));
+			__m128i d = load_12(dst + done * 3);
+			store_12(dst + done * 3, blend_sse(_mm_shuffle_epi8(s, rgb_shuffle), d, _mm_shuffle_epi8(s, alpha_shuffle)));
+			done += 4;
+		}
+		return done;
+	}
+
+	LL_TARGET_AVX2 inline __m256i fast_fractional_mult_avx2(__m256i a, __m256i b)
+	{
+		__m256i i = _mm256_add_epi16(_mm256_mullo_epi16(a, b), _mm256_set1_epi16(128));
+		return _mm256_srli_epi16(_mm256_add_epi16(i, _mm256_srli_epi16(i, 8)), 8);
+	}
+
+	LL_TARGET_AVX2 S32 composite4onto3_avx2(const U8* src, U8* dst, S32 pixels)
+	{
+		const __m256i rgb_shuffle = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)SHUFFLE_4_TO_3));
+		const __m256i alpha_shuffle = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)SHUFFLE_ALPHA_3));
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i low_byte = _mm256_set1_epi16(0xff);
+		S32 done = 0;
+		while (done + 8 <= pixels)
+		{
+			__m256i s = _mm256_loadu_si256((const __m256i*)(src + done * 4));
+			__m256i d = _mm256_inserti128_si256(_mm256_castsi128_si256(load_12(dst + done * 3)), load_12(dst + done * 3 + 12), 1);
+			__m256i rgb = _mm256_shuffle_epi8(s, rgb_shuffle);
+			__m256i alpha = _mm256_shuffle_epi8(s, alpha_shuffle);
+			__m256i transparency = _mm256_xor_si256(alpha, _mm256_set1_epi8(-1));
+			__m256i lo = _mm256_add_epi16(fast_fractional_mult_avx2(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(transparency, zero)),
+										  fast_fractional_mult_avx2(_mm256_unpacklo_epi8(rgb, zero), _mm256_unpacklo_epi8(alpha, zero)));
+			__m256i hi = _mm256_add_epi16(fast_fractional_mult_avx2(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(transparency, zero)),
+										  fast_fractional_mult_avx2(_mm256_unpackhi_epi8(rgb, zero), _mm256_unpackhi_epi8(alpha, zero)));
+			__m256i result = _mm256_packus_epi16(_mm256_and_si256(lo, low_byte), _mm256_and_si256(hi, low_byte));
+			store_12(dst + done * 3, _mm256_castsi256_si128(result));
+			store_12(dst + done * 3 + 12, _mm256_extracti128_si256(result, 1));
+			done += 8;
+		}
+		return done;
+	}
+
+	//
+	// Shrinking RGBA. bilinear_scale() works out every output pixel as a
+	// weighted sum of rows, each a weighted sum of pixels, in 32 bit
+	// integers. Here one source row at a time is summed horizontally for
+	// the whole output row, with the four channels of a pixel in one
+	// vector, and the rows are then weighted together eight or four
+	// channels at a time.
+	//
+
+	inline __m128i load_pixel(const U8* p)
+	{
+		return _mm_cvtepu8_epi32(_mm_cvtsi32_si128((int)load_u32(p)));
+	}
+
+	void scale_row_horizontal(const U8* row, const S32* xpoints, const S32* xapoints, U32 width, S32* cx)
+	{
+		for (U32 x = 0; x < width; ++x)
+		{
+			const S32 Cx = xapoints[x] >> 16;
+			const S32 xap = xapoints[x] & 0xffff;
+			const __m128i cx_weight = _mm_set1_epi32(Cx);
+			const U8* pix = row + xpoints[x] * 4;
+
+			__m128i sum = _mm_mullo_epi32(load_pixel(pix), _mm_set1_epi32(xap));
+			pix += 4;
+			S32 i;
+			for (i = (1 << 14) - xap; i > Cx; i -= Cx)
+			{
+				sum = _mm_add_epi32(sum, _mm_mullo_epi32(load_pixel(pix), cx_weight));
+				pix += 4;
+			}
+			if (i > 0)
+			{
+				sum = _mm_add_epi32(sum, _mm_mullo_epi32(load_pixel(pix), _mm_set1_epi32(i)));
+			}
+			_mm_storeu_si128((__m128i*)(cx + x * 4), sum);
+		}
+	}
+
+	// comp = (cx >> 5) * weight, or comp += (cx >> 5) * weight
+	template<bool ADD>
+	void scale_rows_vertical_sse(S32* comp, const S32* cx, S32 count, S32 weight, S32 done)
+	{
+		const __m128i w = _mm_set1_epi32(weight);
+		for (; done + 4 <= count; done += 4)
+		{
+			__m128i v = _mm_mullo_epi32(_mm_srai_epi32(_mm_loadu_si128((const __m128i*)(cx + done)), 5), w);
+			if (ADD)
+			{
+				v = _mm_add_epi32(v, _mm_loadu_si128((const __m128i*)(comp + done)));
+			}
+			_mm_storeu_si128((__m128i*)(comp + done), v);
+		}
+	}
+
+	template<bool ADD>
+	LL_TARGET_AVX2 S32 scale_rows_vertical_avx2(S32* comp, const S32* cx, S32 count, S32 weight)
+	{
+		const __m256i w = _mm256_set1_epi32(weight);
+		S32 done = 0;
+		for (; done + 8 <= count; done += 8)
+		{
+			__m256i v = _mm256_mullo_epi32(_mm256_srai_epi32(_mm256_loadu_si256((const __m256i*)(cx + done)), 5), w);
+			if (ADD)
+			{
+				v = _mm256_add_epi32(v, _mm256_loadu_si256((const __m256i*)(comp + done)));
+			}
+			_mm256_storeu_si256((__m256i*)(comp + done), v);
+		}
+		return done;
+	}
+
+	template<bool ADD>
+	void scale_rows_vertical(S32* comp, const S32* cx, S32 count, S32 weight, bool avx2)
+	{
+		// Counts are whole pixels, so the SSE loop leaves nothing over
+		S32 done = avx2 ? scale_rows_vertical_avx2<ADD>(comp, cx, count, weight) : 0;
+		scale_rows_vertical_sse<ADD>(comp, cx, count, weight, done);
+	}
+}
+
+//static
+LLImageSIMD::ELevel LLImageSIMD::getSupportedLevel()
+{
+	static const ELevel supported = cpu_has_avx2() ? AVX2 : SSE41;
+	return supported;
+}
+
+//static
+LLImageSIMD::ELevel LLImageSIMD::getLevel()
+{
+	return (ELevel)level().load(std::memory_order_relaxed);
+}
+
+//static
+void LLImageSIMD::setLevel(ELevel new_level)
+{
+	level().store(llmin(new_level, getSupportedLevel()), std::memory_order_relaxed);
+}
+
+//static
+const char* LLImageSIMD::getLevelName(ELevel level)
+{
+	switch (level)
+	{
+	case SCALAR: return "scalar";
+	case SSE41: return "SSE4.1";
+	case AVX2: return "AVX2";
+	}
+	return "unknown";
+}
+
+//static
+bool LLImageSIMD::generateMip(const U8* indata, U8* mipdata, S32 width, S32 height, S32 nchannels)
+{
+	ELevel current = getLevel();
+	if (current == SCALAR || nchannels < 1 || nchannels > 4)
+	{
+		return false;
+	}
+
+	const MipShuffle& shuffle = MIP_SHUFFLES[nchannels - 1];
+	const S32 in_bytes = width * 2 * nchannels;
+	const S32 out_bytes = width * nchannels;
+	for (S32 h = 0; h < height; ++h)
+	{
+		const U8* row0 = indata + (size_t)h * 2 * in_bytes;
+		const U8* row1 = row0 + in_bytes;
+		U8* out = mipdata + (size_t)h * out_bytes;
+
+		S32 in_off = current == AVX2 ? mip_row_avx2(row0, row1, out, in_bytes, out_bytes, shuffle) : 0;
+		in_off = mip_row_sse(row0, row1, out, in_bytes, out_bytes, shuffle, in_off);
+		mip_pixels(row0, row1, out, in_off / (2 * nchannels), width, nchannels);
+	}
+	return true;
+}
+
+//static
+bool LLImageSIMD::copy3onto4(const U8* src, U8* dst, S32 pixels)
+{
+	ELevel current = getLevel();
+	if (current == SCALAR)
+	{
+		return false;
+	}
+
+	S32 done = current == AVX2 ? copy3onto4_avx2(src, dst, pixels) : 0;
+	done = copy3onto4_sse(src, dst, pixels, done);
+	for (; done < pixels; ++done)
+	{
+		dst[done * 4 + 0] = src[done * 3 + 0];
+		dst[done * 4 + 1] = src[done * 3 + 1];
+		dst[done * 4 + 2] = src[done * 3 + 2];
+		dst[done * 4 + 3] = 255;
+	}
+	return true;
+}
+
+//static
+bool LLImageSIMD::copy4onto3(const U8* src, U8* dst, S32 pixels)
+{
+	ELevel current = getLevel();
+	if (current == SCALAR)
+	{
+		return false;
+	}
+
+	S32 done = current == AVX2 ? copy4onto3_avx2(src, dst, pixels) : 0;
+	done = copy4onto3_sse(src, dst, pixels, done);
+	for (; done < pixels; ++done)
+	{
+		dst[done * 3 + 0] = src[done * 4 + 0];
+		dst[done * 3 + 1] = src[done * 4 + 1];
+		dst[done * 3 + 2] = src[done * 4 + 2];
+	}
+	return true;
+}
+
+//static
+bool LLImageSIMD::composite4onto3(const U8* src, U8* dst, S32 pixels)
+{
+	ELevel current = getLevel();
+	if (current == SCALAR)
+	{
+		return false;
+	}
+
+	S32 done = current == AVX2 ? composite4onto3_avx2(src, dst, pixels) : 0;
+	done = composite4onto3_sse(src, dst, pixels, done);
+	composite_pixels(src, dst, done, pixels);
+	return true;
+}
+
+//static
+bool LLImageSIMD::scaleDown4(const U8* const* ystrides, const S32* xpoints, const S32* xapoints, const S32* yapoints,
+							 U32 src_stride, U8* dst, U32 dst_width, U32 dst_height, U32 dst_stride)
+{
+	ELevel current = getLevel();
+	if (current == SCALAR || !dst_width)
+	{
+		return false;
+	}
+	const bool avx2 = (current == AVX2);
+	const S32 count = dst_width * 4;
+	std::vector<S32> cx(count);
+	std::vector<S32> comp(count);
+	const __m128i low_bytes = _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+	for (U32 y = 0; y < dst_height; ++y)
+	{
+		const S32 Cy = yapoints[y] >> 16;
+		const S32 yap = yapoints[y] & 0xffff;
+		const U8* sptr = ystrides[y];
+
+		scale_row_horizontal(sptr, xpoints, xapoints, dst_width, &cx[0]);
+		scale_rows_vertical<false>(&comp[0], &cx[0], count, yap, avx2);
+		sptr += src_stride;
+
+		S32 j;
+		for (j = (1 << 14) - yap; j > Cy; j -= Cy)
+		{
+			scale_row_horizontal(sptr, xpoints, xapoints, dst_width, &cx[0]);
+			scale_rows_vertical<true>(&comp[0], &cx[0], count, Cy, avx2);
+			sptr += src_stride;
+		}
+		if (j > 0)
+		{
+			scale_row_horizontal(sptr, xpoints, xapoints, dst_width, &cx[0]);
+			scale_rows_vertical<true>(&comp[0], &cx[0], count, j, avx2);
+		}
+
+		// (comp >> 23) & 0xff
+		U8* dptr = dst + y * dst_stride;
+		for (U32 x = 0; x < dst_width; ++x)
+		{
+			__m128i v = _mm_srai_epi32(_mm_loadu_si128((const __m128i*)(&comp[x * 4])), 23);
+			store_u32(dptr + x * 4, (U32)_mm_cvtsi128_si32(_mm_shuffle_epi8(v, low_bytes)));
+		}
+	}
+	return true;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file llimagesimd.h
+ * @brief Vectorized pixel loops for LLImageRaw, picked at run time.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLIMAGESIMD_H
+#define LL_LLIMAGESIMD_H
+
+#include "stdtypes.h"
+
+// SSE4.1 and AVX2 versions of the hot pixel loops of LLImageBase and
+// LLImageRaw.
+//
+// The scalar loops in llimage.cpp stay the reference: every kernel here
+// does the same integer arithmetic in the same order, so results are
+// identical to the bit. SSE4.1 is what the viewer is built for at minimum;
+// AVX2 is used when the CPU has it, whatever the build targets.
+//
+// Each kernel returns false when it does not handle the call (a scalar
+// level, or an unsupported channel count), and the caller then runs its
+// scalar loop.
+class LLImageSIMD
+{
+public:
+	enum ELevel
+	{
+		SCALAR = 0,
+		SSE41,
+		AVX2
+	};
+
+	// Best level this CPU supports
+	static ELevel getSupportedLevel();
+	static ELevel getLevel();
+	// For tests and benchmarks; clamped to the supported level
+	static void setLevel(ELevel level);
+	static const char* getLevelName(ELevel level);
+
+	// See LLImageBase::generateMip(): width and height are those of the mip
+	static bool generateMip(const U8* indata, U8* mipdata, S32 width, S32 height, S32 nchannels);
+
+	// Same sized RGB to RGBA with opaque alpha, and RGBA to RGB
+	static bool copy3onto4(const U8* src, U8* dst, S32 pixels);
+	static bool copy4onto3(const U8* src, U8* dst, S32 pixels);
+
+	// Blends RGBA src over RGB dst of the same size, as
+	// LLImageRaw::compositeUnscaled4onto3()
+	static bool composite4onto3(const U8* src, U8* dst, S32 pixels);
+
+	// The RGBA case of bilinear_scale() in llimage.cpp when shrinking both
+	// ways, taking the sample tables it computed.
+	static bool scaleDown4(const U8* const* ystrides, const S32* xpoints, const S32* xapoints, const S32* yapoints,
+						   U32 src_stride, U8* dst, U32 dst_width, U32 dst_height, U32 dst_stride);
+};
+
+#endif // LL_LLIMAGESIMD_H
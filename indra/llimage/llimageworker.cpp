@@ -62,8 +62,9 @@ class ImageRequest
 
 // MAIN THREAD
 LLImageDecodeThread::LLImageDecodeThread(bool /*threaded*/)
+:	mLastHandle(0)
 {
-    mThreadPool.reset(new LL::ThreadPool("ImageDecode", 8));
+    mThreadPool.reset(new LL::PriorityThreadPool("ImageDecode", 8));
     mThreadPool->start();
 }
 
@@ -88,28 +89,68 @@ LLImageDecodeThread::handle_t LLImageDecodeThread::decodeImage(
     const LLPointer<LLImageFormatted>& image, 
     S32 discard,
     BOOL needs_aux,
-    const LLPointer<LLImageDecodeThread::Responder>& responder)
+    const LLPointer<LLImageDecodeThread::Responder>& responder,
+    F32 priority)
 {
     LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
 
+    // It's important to our consumer (LLTextureFetchWorker) that we return a
+    // nonzero handle. Handles are unique so that setPriority() can find the
+    // work again.
+    handle_t handle;
+    {
+        LLMutexLock lock(&mTicketMutex);
+        if (++mLastHandle == 0)
+        {
+            ++mLastHandle;
+        }
+        handle = mLastHandle;
+    }
+
     // Instantiate the ImageRequest right in the lambda, why not?
+    LL::WorkPriorityQueue::Ticket ticket;
     bool posted = mThreadPool->getQueue().post(
-        [req = ImageRequest(image, discard, needs_aux, responder)]
+        [this, handle, req = ImageRequest(image, discard, needs_aux, responder)]
         () mutable
         {
+            {
+                LLMutexLock lock(&mTicketMutex);
+                mTickets.erase(handle);
+            }
             auto done = req.processRequest();
             req.finishRequest(done);
-        });
+        },
+        priority,
+        &ticket);
     if (! posted)
     {
         LL_DEBUGS() << "Tried to start decoding on shutdown" << LL_ENDL;
         // should this return 0?
     }
+    else
+    {
+        LLMutexLock lock(&mTicketMutex);
+        // setPriority() fails once a worker has taken the work, which then
+        // erases its handle only after we let go of the lock: only keep the
+        // ticket if it will be erased.
+        if (mThreadPool->getQueue().setPriority(ticket, priority))
+        {
+            mTickets[handle] = ticket;
+        }
+    }
 
-    // It's important to our consumer (LLTextureFetchWorker) that we return a
-    // nonzero handle. It is NOT important that the nonzero handle be unique:
-    // nothing is ever done with it except to compare it to zero, or zero it.
-    return 17;
+    return handle;
+}
+
+bool LLImageDecodeThread::setPriority(handle_t handle, F32 priority)
+{
+    LLMutexLock lock(&mTicketMutex);
+    auto found = mTickets.find(handle);
+    if (found == mTickets.end())
+    {
+        return false;
+    }
+    return mThreadPool->getQueue().setPriority(found->second, priority);
 }
 
 void LLImageDecodeThread::shutdown()
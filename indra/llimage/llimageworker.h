@@ -28,9 +28,12 @@
 #define LL_LLIMAGEWORKER_H
 
 #include "llimage.h"
+#include "llmutex.h"
 #include "llpointer.h"
 #include "threadpool_fwd.h"
 
+#include <unordered_map>
+
 class LLImageDecodeThread
 {
 public:
@@ -48,18 +51,29 @@ class LLImageDecodeThread
 
 	// meant to resemble LLQueuedThread::handle_t
 	typedef U32 handle_t;
+	// Higher priorities decode first, see setPriority()
 	handle_t decodeImage(const LLPointer<LLImageFormatted>& image,
 						 S32 discard, BOOL needs_aux,
-						 const LLPointer<Responder>& responder);
+						 const LLPointer<Responder>& responder,
+						 F32 priority = 0.f);
+	// Reorders a decode that has not started yet, e.g. for a texture that
+	// just came into view. Returns false if it has started or finished.
+	bool setPriority(handle_t handle, F32 priority);
 	size_t getPending();
 	size_t update(F32 max_time_ms);
 	void shutdown();
 
 private:
+	// Decodes not yet started, for setPriority(). Declared ahead of the
+	// pool, whose workers use them until it is destroyed.
+	LLMutex mTicketMutex;
+	std::unordered_map<handle_t, LL::WorkPriorityQueue::Ticket> mTickets;
+	handle_t mLastHandle;
+
 	// As of SL-17483, LLImageDecodeThread is no longer itself an
 	// LLQueuedThread - instead this is the API by which we submit work to the
 	// "ImageDecode" ThreadPool.
-	std::unique_ptr<LL::ThreadPool> mThreadPool;
+	std::unique_ptr<LL::PriorityThreadPool> mThreadPool;
 };
 
 #endif
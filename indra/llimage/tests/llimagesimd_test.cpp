@@ -0,0 +1,251 @@
+/**
+ * @file llimagesimd_test.cpp
+ * @brief Checks the vectorized image kernels against the scalar loops.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llimagesimd.h"
+#include "../llimage.h"
+
+#include "lltimer.h"
+#include "llstring.h"
+
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// Random bytes, with plenty of the alpha values the scalar loops
+	// special case when the image has four channels
+	LLPointer<LLImageRaw> make_image(S32 width, S32 height, S32 components, U32 seed)
+	{
+		LLPointer<LLImageRaw> image = new LLImageRaw(width, height, components);
+		U8* data = image->getData();
+		U32 state = seed * 2654435761u + 1;
+		for (S32 i = 0; i < width * height * components; ++i)
+		{
+			state = state * 1664525u + 1013904223u;
+			U8 value = (U8)(state >> 24);
+			if (components == 4 && (i & 3) == 3)
+			{
+				switch (value & 3)
+				{
+				case 0: value = 0; break;
+				case 1: value = 255; break;
+				default: break;
+				}
+			}
+			data[i] = value;
+		}
+		return image;
+	}
+
+	std::vector<U8> bytes(const LLImageRaw* image)
+	{
+		return std::vector<U8>(image->getData(), image->getData() + image->getDataSize());
+	}
+
+	typedef std::function<std::vector<U8>()> image_op_t;
+
+	// Runs op scalar, then at each vector level, expecting the same bytes
+	void ensure_exact(const std::string& what, const image_op_t& op)
+	{
+		LLImageSIMD::setLevel(LLImageSIMD::SCALAR);
+		std::vector<U8> expected = op();
+		for (S32 level = LLImageSIMD::SSE41; level <= LLImageSIMD::getSupportedLevel(); ++level)
+		{
+			LLImageSIMD::setLevel((LLImageSIMD::ELevel)level);
+			std::vector<U8> result = op();
+			tut::ensure_equals(what + " size, " + LLImageSIMD::getLevelName((LLImageSIMD::ELevel)level), result.size(), expected.size());
+			for (size_t i = 0; i < expected.size(); ++i)
+			{
+				if (result[i] != expected[i])
+				{
+					tut::fail(what + " differs at byte " + std::to_string(i) + ", " + LLImageSIMD::getLevelName((LLImageSIMD::ELevel)level));
+				}
+			}
+		}
+	}
+
+	const S32 SIZES[][2] = { { 1, 1 }, { 3, 5 }, { 7, 2 }, { 17, 9 }, { 64, 64 }, { 101, 37 }, { 256, 3 } };
+}
+
+namespace tut
+{
+	struct imagesimd_data
+	{
+		imagesimd_data()
+		:	mLevel(LLImageSIMD::getLevel())
+		{
+			LLImage::initClass();
+		}
+
+		~imagesimd_data()
+		{
+			LLImageSIMD::setLevel(mLevel);
+			LLImage::cleanupClass();
+		}
+
+		LLImageSIMD::ELevel mLevel;
+	};
+	typedef test_group<imagesimd_data> imagesimd_test;
+	typedef imagesimd_test::object imagesimd_object;
+	tut::imagesimd_test timagesimd("LLImageSIMD");
+
+	template<> template<>
+	void imagesimd_object::test<1>()
+	{
+		set_test_name("RGB to RGBA and back");
+		for (const auto& size : SIZES)
+		{
+			std::string name = std::to_string(size[0]) + "x" + std::to_string(size[1]);
+			LLPointer<LLImageRaw> rgb = make_image(size[0], size[1], 3, 1);
+			LLPointer<LLImageRaw> rgba = make_image(size[0], size[1], 4, 2);
+			ensure_exact("3 onto 4 " + name, [&]()
+				{
+					LLPointer<LLImageRaw> dst = new LLImageRaw(size[0], size[1], 4);
+					dst->copy(rgb);
+					return bytes(dst);
+				});
+			ensure_exact("4 onto 3 " + name, [&]()
+				{
+					LLPointer<LLImageRaw> dst = new LLImageRaw(size[0], size[1], 3);
+					dst->copy(rgba);
+					return bytes(dst);
+				});
+		}
+	}
+
+	template<> template<>
+	void imagesimd_object::test<2>()
+	{
+		set_test_name("RGBA over RGB");
+		for (const auto& size : SIZES)
+		{
+			LLPointer<LLImageRaw> src = make_image(size[0], size[1], 4, 3);
+			LLPointer<LLImageRaw> background = make_image(size[0], size[1], 3, 4);
+			ensure_exact("composite " + std::to_string(size[0]) + "x" + std::to_string(size[1]), [&]()
+				{
+					LLPointer<LLImageRaw> dst = new LLImageRaw(background->getData(), size[0], size[1], 3);
+					dst->composite(src);
+					return bytes(dst);
+				});
+		}
+	}
+
+	template<> template<>
+	void imagesimd_object::test<3>()
+	{
+		set_test_name("mips");
+		for (S32 components = 1; components <= 4; ++components)
+		{
+			for (const auto& size : SIZES)
+			{
+				LLPointer<LLImageRaw> src = make_image(size[0] * 2, size[1] * 2, components, components);
+				ensure_exact("mip of " + std::to_string(components) + " channels, " + std::to_string(size[0]) + "x" + std::to_string(size[1]), [&]()
+					{
+						std::vector<U8> mip(size[0] * size[1] * components);
+						LLImageBase::generateMip(src->getData(), &mip[0], size[0], size[1], components);
+						return mip;
+					});
+			}
+		}
+	}
+
+	template<> template<>
+	void imagesimd_object::test<4>()
+	{
+		set_test_name("shrinking RGBA");
+		const S32 scales[][4] =
+		{
+			{ 2, 2, 1, 1 }, { 64, 64, 32, 32 }, { 64, 64, 17, 5 }, { 257, 131, 61, 29 },
+			{ 1024, 16, 3, 2 }, { 100, 100, 99, 98 }, { 33, 700, 32, 11 }
+		};
+		for (const auto& scale : scales)
+		{
+			std::string name = std::to_string(scale[0]) + "x" + std::to_string(scale[1]) + " to "
+				+ std::to_string(scale[2]) + "x" + std::to_string(scale[3]);
+			LLPointer<LLImageRaw> src = make_image(scale[0], scale[1], 4, scale[2]);
+			ensure_exact("scaled " + name, [&]()
+				{
+					LLPointer<LLImageRaw> dst = src->scaled(scale[2], scale[3]);
+					return bytes(dst);
+				});
+			ensure_exact("scale " + name, [&]()
+				{
+					LLPointer<LLImageRaw> dst = new LLImageRaw(src->getData(), scale[0], scale[1], 4);
+					dst->scale(scale[2], scale[3]);
+					return bytes(dst);
+				});
+		}
+	}
+
+	template<> template<>
+	void imagesimd_object::test<5>()
+	{
+		set_test_name("throughput");
+		if (LLStringUtil::getenv("LL_IMAGESIMD_BENCH").empty())
+		{
+			skip("set LL_IMAGESIMD_BENCH to run");
+		}
+
+		const S32 SIZE = 2048;
+		const S32 PASSES = 10;
+		LLPointer<LLImageRaw> rgba = make_image(SIZE, SIZE, 4, 5);
+		LLPointer<LLImageRaw> rgb = make_image(SIZE, SIZE, 3, 6);
+		LLPointer<LLImageRaw> rgba_dst = new LLImageRaw(SIZE, SIZE, 4);
+		LLPointer<LLImageRaw> rgb_dst = new LLImageRaw(SIZE, SIZE, 3);
+		std::vector<U8> mip(SIZE * SIZE);
+
+		const std::pair<const char*, std::function<void()>> ops[] =
+		{
+			{ "copy 3 onto 4", [&]() { rgba_dst->copy(rgb); } },
+			{ "copy 4 onto 3", [&]() { rgb_dst->copy(rgba); } },
+			{ "composite", [&]() { rgb_dst->composite(rgba); } },
+			{ "mip", [&]() { LLImageBase::generateMip(rgba->getData(), &mip[0], SIZE / 2, SIZE / 2, 4); } },
+			{ "scale to 1/3", [&]() { rgba->scaled(SIZE / 3, SIZE / 3); } }
+		};
+
+		std::cout << "\n";
+		for (const auto& op : ops)
+		{
+			for (S32 level = LLImageSIMD::SCALAR; level <= LLImageSIMD::getSupportedLevel(); ++level)
+			{
+				LLImageSIMD::setLevel((LLImageSIMD::ELevel)level);
+				op.second();
+				LLTimer timer;
+				for (S32 i = 0; i < PASSES; ++i)
+				{
+					op.second();
+				}
+				F64 seconds = timer.getElapsedTimeF64();
+				std::cout << op.first << ", " << LLImageSIMD::getLevelName((LLImageSIMD::ELevel)level) << ": "
+					<< (F64)SIZE * SIZE * PASSES / seconds / 1000000.0 << " MPix/s" << std::endl;
+			}
+		}
+	}
+}
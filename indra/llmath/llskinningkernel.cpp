@@ -0,0 +1,258 @@
+/**
+ * @file llskinningkernel.cpp
+ * @brief Batched skinning palette and vertex skinning.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "llmath.h"
+#include "llskinningkernel.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // Palette indices and normalized weights of one vertex
+    inline void decodeWeights(const LLVector4a& packed, const LLIVector4a& max_joint, S32* idx, LLVector4a& weight)
+    {
+        LLIVector4a joint;
+        joint.setFloatTrunc(packed);
+
+        weight.setSub(packed, joint);
+
+        joint.min16(max_joint);
+        joint.max16(LLIVector4a::getZero());
+        joint.store128a(idx);
+
+        LLVector4a scale;
+        scale.setMoveHighLow(weight);
+        scale.add(weight);
+        scale.addFirst(scale.getVectorAt<1>());
+        scale.splat<0>(scale);
+
+        if (scale.lessEqual(LLVector4a::getEpsilon()).areAnySet(LLVector4Logical::MASK_XYZW))
+        {
+            weight = LLVector4a(1.f, 0.f, 0.f, 0.f);
+        }
+        else
+        {
+            weight.div(scale);
+        }
+    }
+
+    inline void skinOne(const LLMatrix4a* palette, const LLIVector4a& max_joint,
+                        const LLVector4a& packed, const LLVector4a& src, LLVector4a& dst)
+    {
+        alignas(16) S32 idx[4];
+        LLVector4a weight;
+        decodeWeights(packed, max_joint, idx, weight);
+
+        LLMatrix4a mat;
+        mat.setMul(palette[idx[0]], weight.getVectorAt<0>());
+        mat.setMulAdd(palette[idx[1]], weight.getVectorAt<1>());
+        mat.setMulAdd(palette[idx[2]], weight.getVectorAt<2>());
+        mat.setMulAdd(palette[idx[3]], weight.getVectorAt<3>());
+
+        mat.affineTransform(src, dst);
+    }
+
+#if defined(__AVX2__)
+    inline __m256 madd(__m256 a, __m256 b, __m256 c)
+    {
+#if defined(__FMA__)
+        return _mm256_fmadd_ps(a, b, c);
+#else
+        return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+    }
+
+    inline __m256 pair(__m128 lo, __m128 hi)
+    {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+    }
+
+    // Two columns of lhs * rhs at once, cols holds rhs columns c and c + 1
+    inline __m256 mulColumns(const __m256* lhs, __m256 cols)
+    {
+        __m256 res = _mm256_mul_ps(lhs[0], _mm256_permute_ps(cols, _MM_SHUFFLE(0, 0, 0, 0)));
+        res = madd(lhs[1], _mm256_permute_ps(cols, _MM_SHUFFLE(1, 1, 1, 1)), res);
+        res = madd(lhs[2], _mm256_permute_ps(cols, _MM_SHUFFLE(2, 2, 2, 2)), res);
+        return madd(lhs[3], _mm256_permute_ps(cols, _MM_SHUFFLE(3, 3, 3, 3)), res);
+    }
+
+    inline void mulMatrix(LLMatrix4a& dst, const LLMatrix4a& lhs, const LLMatrix4a& rhs)
+    {
+        const __m256 cols[4] = {
+            _mm256_broadcast_ps((const __m128*)lhs.mMatrix[0].getF32ptr()),
+            _mm256_broadcast_ps((const __m128*)lhs.mMatrix[1].getF32ptr()),
+            _mm256_broadcast_ps((const __m128*)lhs.mMatrix[2].getF32ptr()),
+            _mm256_broadcast_ps((const __m128*)lhs.mMatrix[3].getF32ptr())
+        };
+        const __m256 rhs01 = _mm256_loadu_ps(rhs.mMatrix[0].getF32ptr());
+        const __m256 rhs23 = _mm256_loadu_ps(rhs.mMatrix[2].getF32ptr());
+        _mm256_storeu_ps(dst.mMatrix[0].getF32ptr(), mulColumns(cols, rhs01));
+        _mm256_storeu_ps(dst.mMatrix[2].getF32ptr(), mulColumns(cols, rhs23));
+    }
+
+    // Two vertices at once, one per 128 bit lane
+    inline __m256 skinPair(const LLMatrix4a* palette, const LLIVector4a& max_joint,
+                           const LLVector4a* packed, const LLVector4a* src)
+    {
+        alignas(16) S32 idx0[4];
+        alignas(16) S32 idx1[4];
+        LLVector4a weight0, weight1;
+        decodeWeights(packed[0], max_joint, idx0, weight0);
+        decodeWeights(packed[1], max_joint, idx1, weight1);
+
+        const __m256 weights = pair(weight0, weight1);
+
+        __m256 mat[4];
+        for (U32 k = 0; k < 4; ++k)
+        {
+            const LLMatrix4a& m0 = palette[idx0[k]];
+            const LLMatrix4a& m1 = palette[idx1[k]];
+            __m256 w;
+            switch (k)
+            {
+            case 0: w = _mm256_permute_ps(weights, _MM_SHUFFLE(0, 0, 0, 0)); break;
+            case 1: w = _mm256_permute_ps(weights, _MM_SHUFFLE(1, 1, 1, 1)); break;
+            case 2: w = _mm256_permute_ps(weights, _MM_SHUFFLE(2, 2, 2, 2)); break;
+            default: w = _mm256_permute_ps(weights, _MM_SHUFFLE(3, 3, 3, 3)); break;
+            }
+            for (U32 c = 0; c < 4; ++c)
+            {
+                const __m256 col = pair(m0.mMatrix[c], m1.mMatrix[c]);
+                mat[c] = k ? madd(col, w, mat[c]) : _mm256_mul_ps(col, w);
+            }
+        }
+
+        // same order of operations as LLMatrix4a::affineTransform()
+        const __m256 v = pair(src[0], src[1]);
+        __m256 xy = _mm256_mul_ps(_mm256_permute_ps(v, _MM_SHUFFLE(0, 0, 0, 0)), mat[0]);
+        xy = madd(_mm256_permute_ps(v, _MM_SHUFFLE(1, 1, 1, 1)), mat[1], xy);
+        const __m256 zw = madd(_mm256_permute_ps(v, _MM_SHUFFLE(2, 2, 2, 2)), mat[2], mat[3]);
+        return _mm256_add_ps(xy, zw);
+    }
+#else
+    inline void mulMatrix(LLMatrix4a& dst, const LLMatrix4a& lhs, const LLMatrix4a& rhs)
+    {
+        dst.setMul(lhs, rhs);
+    }
+#endif
+
+    inline LLIVector4a maxJoint(U32 palette_count)
+    {
+        return LLIVector4a((S16)(palette_count - 1));
+    }
+} // anonymous namespace
+
+void LLSkinningKernel::mulPalette(LLMatrix4a* dst, const LLMatrix4a* const* lhs, const LLMatrix4a* rhs, U32 count)
+{
+    for (U32 i = 0; i < count; ++i)
+    {
+        if (lhs[i])
+        {
+            mulMatrix(dst[i], *lhs[i], rhs[i]);
+        }
+        else
+        {
+            dst[i] = rhs[i];
+        }
+    }
+}
+
+void LLSkinningKernel::mulPalette(LLMatrix4a* dst, const LLMatrix4a* src, const LLMatrix4a& rhs, U32 count)
+{
+    // rhs may be in dst
+    const LLMatrix4a right = rhs;
+    for (U32 i = 0; i < count; ++i)
+    {
+        const LLMatrix4a left = src[i];
+        mulMatrix(dst[i], left, right);
+    }
+}
+
+void LLSkinningKernel::skinPositions(const LLMatrix4a* palette, U32 palette_count,
+                                     const LLVector4a* weights, const LLVector4a* src, LLVector4a* dst, U32 count)
+{
+    if (!palette_count)
+    {
+        return;
+    }
+    const LLIVector4a max_joint = maxJoint(palette_count);
+
+    U32 i = 0;
+#if defined(__AVX2__)
+    for (; i + 1 < count; i += 2)
+    {
+        const __m256 res = skinPair(palette, max_joint, weights + i, src + i);
+        dst[i] = _mm256_castps256_ps128(res);
+        dst[i + 1] = _mm256_extractf128_ps(res, 1);
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        skinOne(palette, max_joint, weights[i], src[i], dst[i]);
+    }
+}
+
+void LLSkinningKernel::skinPositions(const LLMatrix4a* palette, U32 palette_count,
+                                     const LLVector4a* weights, const LLVector4a* src, LLVector4a* dst, U32 count,
+                                     LLVector4a& min, LLVector4a& max)
+{
+    llassert(count > 0);
+    if (!palette_count || !count)
+    {
+        return;
+    }
+    const LLIVector4a max_joint = maxJoint(palette_count);
+
+    skinOne(palette, max_joint, weights[0], src[0], dst[0]);
+    LLVector4a lo = dst[0];
+    LLVector4a hi = dst[0];
+
+    U32 i = 1;
+#if defined(__AVX2__)
+    __m256 lo2 = pair(lo, lo);
+    __m256 hi2 = lo2;
+    for (; i + 1 < count; i += 2)
+    {
+        const __m256 res = skinPair(palette, max_joint, weights + i, src + i);
+        dst[i] = _mm256_castps256_ps128(res);
+        dst[i + 1] = _mm256_extractf128_ps(res, 1);
+        lo2 = _mm256_min_ps(lo2, res);
+        hi2 = _mm256_max_ps(hi2, res);
+    }
+    lo.setMin(LLVector4a(_mm256_castps256_ps128(lo2)), LLVector4a(_mm256_extractf128_ps(lo2, 1)));
+    hi.setMax(LLVector4a(_mm256_castps256_ps128(hi2)), LLVector4a(_mm256_extractf128_ps(hi2, 1)));
+#endif
+    for (; i < count; ++i)
+    {
+        skinOne(palette, max_joint, weights[i], src[i], dst[i]);
+        lo.setMin(lo, dst[i]);
+        hi.setMax(hi, dst[i]);
+    }
+
+    min = lo;
+    max = hi;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file llskinningkernel.h
+ * @brief Batched skinning palette and vertex skinning.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLSKINNINGKERNEL_H
+#define LL_LLSKINNINGKERNEL_H
+
+#include "llmatrix4a.h"
+#include "llvector4a.h"
+
+// CPU skinning over whole arrays, for the paths that skin rigged meshes
+// without the GPU (bounding boxes, picking, raycasts).  Built with AVX2 the
+// matrix work runs two columns or two vertices per instruction, otherwise
+// it runs on SSE one at a time.
+//
+// Weights are packed the way LLVolumeFace::mWeights has them: the integer
+// part of each component is a palette index and the fraction its weight.
+// Weights are normalized per vertex; a vertex whose weights sum to nearly
+// zero is bound to its first joint alone, as in
+// LLSkinningUtil::getPerVertexSkinMatrixChecked().
+namespace LLSkinningKernel
+{
+    // dst[i] = lhs[i] * rhs[i], or rhs[i] where lhs[i] is null
+    void mulPalette(LLMatrix4a* dst, const LLMatrix4a* const* lhs, const LLMatrix4a* rhs, U32 count);
+
+    // dst[i] = src[i] * rhs, dst may be src
+    void mulPalette(LLMatrix4a* dst, const LLMatrix4a* src, const LLMatrix4a& rhs, U32 count);
+
+    // dst[i] = blend of palette[joint] by weights[i], applied to src[i].
+    // Indices are clamped to the palette, dst may be src.
+    void skinPositions(const LLMatrix4a* palette, U32 palette_count,
+                       const LLVector4a* weights, const LLVector4a* src, LLVector4a* dst, U32 count);
+
+    // As above, also returns the bounds of the skinned positions.  count
+    // must not be 0.
+    void skinPositions(const LLMatrix4a* palette, U32 palette_count,
+                       const LLVector4a* weights, const LLVector4a* src, LLVector4a* dst, U32 count,
+                       LLVector4a& min, LLVector4a& max);
+}
+
+#endif // LL_LLSKINNINGKERNEL_H
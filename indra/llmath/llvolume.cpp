@@ -2802,6 +2802,254 @@ bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
 }
 
 
+namespace
+{
+	const U32 DECODED_FACES_MAGIC = 0x4656444c; // "LDVF"
+
+	enum
+	{
+		DECODED_FACE_TANGENTS = 1 << 0,
+		DECODED_FACE_WEIGHTS = 1 << 1
+	};
+
+	struct DecodedFacesHeader
+	{
+		U32 mMagic;
+		U32 mVersion;
+		U32 mFaceCount;
+		U32 mVectorSize;	// catches builds with a different LLVector4a
+	};
+
+	struct DecodedFaceHeader
+	{
+		S32 mNumVertices;
+		S32 mNumIndices;
+		U32 mFlags;
+		U32 mPad;
+		F32 mExtents[2][4];
+		F32 mTexCoordExtents[2][2];
+		F32 mNormalizedScale[4];
+	};
+
+	static_assert(sizeof(DecodedFacesHeader) % 16 == 0 && sizeof(DecodedFaceHeader) % 16 == 0,
+				  "decoded face blocks must stay 16 byte aligned");
+
+	// Same sizes LLVolumeFace::resizeVertices() and resizeIndices() allocate
+	size_t decoded_vertex_bytes(S32 num_verts)
+	{
+		return sizeof(LLVector4a) * 2 * num_verts + ((num_verts * sizeof(LLVector2) + 0xF) & ~0xF);
+	}
+
+	size_t decoded_index_bytes(S32 num_indices)
+	{
+		return (num_indices * sizeof(U16) + 0xF) & ~0xF;
+	}
+
+	size_t decoded_face_bytes(const DecodedFaceHeader& header)
+	{
+		size_t bytes = sizeof(DecodedFaceHeader) + decoded_vertex_bytes(header.mNumVertices) + decoded_index_bytes(header.mNumIndices);
+		if (header.mFlags & DECODED_FACE_TANGENTS)
+		{
+			bytes += sizeof(LLVector4a) * header.mNumVertices;
+		}
+		if (header.mFlags & DECODED_FACE_WEIGHTS)
+		{
+			bytes += sizeof(LLVector4a) * header.mNumVertices;
+		}
+		return bytes;
+	}
+}
+
+bool LLVolume::packDecodedFaces(std::vector<U8>& out) const
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_VOLUME;
+
+	if (mVolumeFaces.empty())
+	{
+		return false;
+	}
+
+	std::vector<DecodedFaceHeader> headers(mVolumeFaces.size());
+	size_t total = sizeof(DecodedFacesHeader);
+	for (size_t i = 0; i < mVolumeFaces.size(); ++i)
+	{
+		const LLVolumeFace& face = mVolumeFaces[i];
+		DecodedFaceHeader& header = headers[i];
+		memset(&header, 0, sizeof(header));
+		header.mNumVertices = face.mNumVertices;
+		header.mNumIndices = face.mNumIndices;
+		header.mFlags = (face.mTangents ? DECODED_FACE_TANGENTS : 0) | (face.mWeights ? DECODED_FACE_WEIGHTS : 0);
+		if (face.mExtents)
+		{
+			memcpy(header.mExtents, face.mExtents, sizeof(header.mExtents));
+		}
+		for (U32 j = 0; j < 2; ++j)
+		{
+			header.mTexCoordExtents[j][0] = face.mTexCoordExtents[j].mV[VX];
+			header.mTexCoordExtents[j][1] = face.mTexCoordExtents[j].mV[VY];
+		}
+		memcpy(header.mNormalizedScale, face.mNormalizedScale.mV, sizeof(F32) * 3);
+		total += decoded_face_bytes(header);
+	}
+
+	try
+	{
+		out.resize(total);
+	}
+	catch (const std::bad_alloc&)
+	{
+		LL_WARNS() << "Out of memory packing " << total << " bytes of mesh faces" << LL_ENDL;
+		out.clear();
+		return false;
+	}
+
+	U8* dst = out.data();
+	DecodedFacesHeader file_header = { DECODED_FACES_MAGIC, DECODED_FACES_VERSION, (U32)mVolumeFaces.size(), sizeof(LLVector4a) };
+	memcpy(dst, &file_header, sizeof(file_header));
+	dst += sizeof(file_header);
+
+	for (size_t i = 0; i < mVolumeFaces.size(); ++i)
+	{
+		const LLVolumeFace& face = mVolumeFaces[i];
+		const DecodedFaceHeader& header = headers[i];
+		memcpy(dst, &header, sizeof(header));
+		dst += sizeof(header);
+
+		// positions, normals and texture coordinates share one buffer
+		size_t bytes = decoded_vertex_bytes(face.mNumVertices);
+		if (bytes)
+		{
+			memcpy(dst, face.mPositions, sizeof(LLVector4a) * 2 * face.mNumVertices);
+			memset(dst + sizeof(LLVector4a) * 2 * face.mNumVertices, 0, bytes - sizeof(LLVector4a) * 2 * face.mNumVertices);
+			memcpy(dst + sizeof(LLVector4a) * 2 * face.mNumVertices, face.mTexCoords, sizeof(LLVector2) * face.mNumVertices);
+		}
+		dst += bytes;
+
+		if (face.mTangents)
+		{
+			memcpy(dst, face.mTangents, sizeof(LLVector4a) * face.mNumVertices);
+			dst += sizeof(LLVector4a) * face.mNumVertices;
+		}
+		if (face.mWeights)
+		{
+			memcpy(dst, face.mWeights, sizeof(LLVector4a) * face.mNumVertices);
+			dst += sizeof(LLVector4a) * face.mNumVertices;
+		}
+
+		bytes = decoded_index_bytes(face.mNumIndices);
+		if (bytes)
+		{
+			memset(dst, 0, bytes);
+			memcpy(dst, face.mIndices, sizeof(U16) * face.mNumIndices);
+		}
+		dst += bytes;
+	}
+
+	llassert(dst == out.data() + out.size());
+	return true;
+}
+
+bool LLVolume::unpackDecodedFaces(const U8* data, size_t size)
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_VOLUME;
+
+	DecodedFacesHeader file_header;
+	if (!data || size < sizeof(file_header))
+	{
+		return false;
+	}
+	memcpy(&file_header, data, sizeof(file_header));
+	if (file_header.mMagic != DECODED_FACES_MAGIC ||
+		file_header.mVersion != DECODED_FACES_VERSION ||
+		file_header.mVectorSize != sizeof(LLVector4a) ||
+		file_header.mFaceCount == 0 ||
+		file_header.mFaceCount > (size - sizeof(file_header)) / sizeof(DecodedFaceHeader))
+	{
+		return false;
+	}
+
+	const U8* src = data + sizeof(file_header);
+	const U8* end = data + size;
+
+	std::vector<LLVolumeFace> faces(file_header.mFaceCount);
+	for (LLVolumeFace& face : faces)
+	{
+		DecodedFaceHeader header;
+		if ((size_t)(end - src) < sizeof(header))
+		{
+			return false;
+		}
+		memcpy(&header, src, sizeof(header));
+		if (header.mNumVertices < 0 || header.mNumVertices > 65536 ||
+			header.mNumIndices < 0 || header.mNumIndices % 3 != 0 ||
+			(size_t)(end - src) < decoded_face_bytes(header))
+		{
+			return false;
+		}
+		src += sizeof(header);
+
+		face.resizeVertices(header.mNumVertices);
+		face.resizeIndices(header.mNumIndices);
+		if (face.mNumVertices != header.mNumVertices || face.mNumIndices != header.mNumIndices)
+		{ // out of memory
+			return false;
+		}
+
+		if (header.mNumVertices)
+		{
+			memcpy(face.mPositions, src, decoded_vertex_bytes(header.mNumVertices));
+		}
+		src += decoded_vertex_bytes(header.mNumVertices);
+
+		if (header.mFlags & DECODED_FACE_TANGENTS)
+		{
+			face.allocateTangents(header.mNumVertices);
+			if (!face.mTangents)
+			{
+				return false;
+			}
+			memcpy(face.mTangents, src, sizeof(LLVector4a) * header.mNumVertices);
+			src += sizeof(LLVector4a) * header.mNumVertices;
+		}
+		if (header.mFlags & DECODED_FACE_WEIGHTS)
+		{
+			face.allocateWeights(header.mNumVertices);
+			if (!face.mWeights)
+			{
+				return false;
+			}
+			memcpy(face.mWeights, src, sizeof(LLVector4a) * header.mNumVertices);
+			src += sizeof(LLVector4a) * header.mNumVertices;
+		}
+
+		if (header.mNumIndices)
+		{
+			memcpy(face.mIndices, src, decoded_index_bytes(header.mNumIndices));
+			for (S32 i = 0; i < header.mNumIndices; ++i)
+			{
+				if (face.mIndices[i] >= header.mNumVertices)
+				{ // corrupt, don't hand out of range indices to the renderer
+					return false;
+				}
+			}
+		}
+		src += decoded_index_bytes(header.mNumIndices);
+
+		face.mExtents[0].loadua(header.mExtents[0]);
+		face.mExtents[1].loadua(header.mExtents[1]);
+		for (U32 j = 0; j < 2; ++j)
+		{
+			face.mTexCoordExtents[j].set(header.mTexCoordExtents[j][0], header.mTexCoordExtents[j][1]);
+		}
+		face.mNormalizedScale.set(header.mNormalizedScale);
+		face.mOptimized = TRUE;
+	}
+
+	mVolumeFaces.swap(faces);
+	mSculptLevel = 0;
+	return true;
+}
+
 bool LLVolume::isMeshAssetLoaded()
 {
 	return mIsMeshAssetLoaded;
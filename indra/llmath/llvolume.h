@@ -1105,6 +1105,14 @@ class LLVolume : public LLRefCount
 public:
 	bool unpackVolumeFaces(std::istream& is, S32 size);
 	bool unpackVolumeFaces(U8* in_data, S32 size);
+
+	// Flat binary copy of the decoded, cache optimized faces of a mesh
+	// asset, laid out like the face buffers so that unpacking is a copy.
+	// Meant for a local cache only: native byte order, and data written
+	// by another DECODED_FACES_VERSION is rejected.
+	enum { DECODED_FACES_VERSION = 1 };
+	bool packDecodedFaces(std::vector<U8>& out) const;
+	bool unpackDecodedFaces(const U8* data, size_t size);
 private:
 	bool unpackVolumeFacesInternal(const LLSD& mdl);
 
@@ -0,0 +1,332 @@
+/**
+ * @file llskinningkernel_test.cpp
+ * @brief Checks the batched skinning kernel against a scalar reference.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llmath.h"
+#include "../llskinningkernel.h"
+
+#include <vector>
+
+#include "../test/lltut.h"
+
+namespace
+{
+	const U32 PALETTE_SIZE = 12;
+	const F32 TOLERANCE = 1e-4f;
+
+	// Small deterministic generator, the results must not depend on the run
+	struct Sequence
+	{
+		U32 mState = 12345;
+
+		F32 next(F32 lo, F32 hi)
+		{
+			mState = mState * 1664525 + 1013904223;
+			return lo + (hi - lo) * F32(mState >> 8) / F32(1 << 24);
+		}
+	};
+
+	void fill_matrix(Sequence& seq, LLMatrix4a& mat)
+	{
+		for (U32 c = 0; c < 3; ++c)
+		{
+			mat.mMatrix[c].set(seq.next(-2.f, 2.f), seq.next(-2.f, 2.f), seq.next(-2.f, 2.f), 0.f);
+		}
+		mat.mMatrix[3].set(seq.next(-10.f, 10.f), seq.next(-10.f, 10.f), seq.next(-10.f, 10.f), 1.f);
+	}
+
+	// Column-major scalar product, m0 * m1
+	void reference_mul(const LLMatrix4a& m0, const LLMatrix4a& m1, LLMatrix4a& out)
+	{
+		const F32* a = m0.getF32ptr();
+		const F32* b = m1.getF32ptr();
+		F32 r[16];
+		for (U32 c = 0; c < 4; ++c)
+		{
+			for (U32 row = 0; row < 4; ++row)
+			{
+				F32 sum = 0.f;
+				for (U32 k = 0; k < 4; ++k)
+				{
+					sum += a[k * 4 + row] * b[c * 4 + k];
+				}
+				r[c * 4 + row] = sum;
+			}
+		}
+		for (U32 c = 0; c < 4; ++c)
+		{
+			out.mMatrix[c].set(r[c * 4], r[c * 4 + 1], r[c * 4 + 2], r[c * 4 + 3]);
+		}
+	}
+
+	// What LLSkinningUtil::getPerVertexSkinMatrixChecked() and
+	// LLMatrix4a::affineTransform() do for one vertex, in plain floats
+	LLVector4a reference_skin(const LLMatrix4a* palette, U32 palette_count, const LLVector4a& packed, const LLVector4a& pos)
+	{
+		S32 idx[4];
+		F32 weight[4];
+		F32 sum = 0.f;
+		for (U32 k = 0; k < 4; ++k)
+		{
+			const F32 v = packed[k];
+			const S32 joint = S32(v);
+			weight[k] = v - F32(joint);
+			idx[k] = llclamp(joint, 0, S32(palette_count) - 1);
+			sum += weight[k];
+		}
+		if (sum <= F_APPROXIMATELY_ZERO)
+		{
+			weight[0] = 1.f;
+			weight[1] = weight[2] = weight[3] = 0.f;
+		}
+		else
+		{
+			for (U32 k = 0; k < 4; ++k)
+			{
+				weight[k] /= sum;
+			}
+		}
+
+		F32 out[4] = { 0.f, 0.f, 0.f, 0.f };
+		for (U32 k = 0; k < 4; ++k)
+		{
+			const F32* m = palette[idx[k]].getF32ptr();
+			for (U32 row = 0; row < 4; ++row)
+			{
+				out[row] += weight[k] * (m[row] * pos[0] + m[4 + row] * pos[1] + m[8 + row] * pos[2] + m[12 + row]);
+			}
+		}
+		return LLVector4a(out[0], out[1], out[2], out[3]);
+	}
+
+	bool approx_equal(const LLVector4a& a, const LLVector4a& b)
+	{
+		for (U32 k = 0; k < 4; ++k)
+		{
+			const F32 scale = llmax(1.f, fabsf(b[k]));
+			if (fabsf(a[k] - b[k]) > TOLERANCE * scale)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool approx_equal(const LLMatrix4a& a, const LLMatrix4a& b)
+	{
+		for (U32 c = 0; c < 4; ++c)
+		{
+			if (!approx_equal(a.mMatrix[c], b.mMatrix[c]))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+namespace tut
+{
+	struct skinningkernel_data
+	{
+		skinningkernel_data()
+		{
+			for (U32 i = 0; i < PALETTE_SIZE; ++i)
+			{
+				fill_matrix(mSeq, mPalette[i]);
+			}
+		}
+
+		// count vertices bound to up to four joints each
+		void makeVertices(U32 count)
+		{
+			mWeights.resize(count);
+			mPositions.resize(count);
+			for (U32 i = 0; i < count; ++i)
+			{
+				F32 w[4];
+				for (U32 k = 0; k < 4; ++k)
+				{
+					w[k] = F32(U32(mSeq.next(0.f, F32(PALETTE_SIZE) - 0.01f))) + mSeq.next(0.f, 0.999f);
+				}
+				mWeights[i].set(w[0], w[1], w[2], w[3]);
+				mPositions[i].set(mSeq.next(-1.f, 1.f), mSeq.next(-1.f, 1.f), mSeq.next(-1.f, 1.f), 1.f);
+			}
+		}
+
+		Sequence mSeq;
+		LLMatrix4a mPalette[PALETTE_SIZE];
+		std::vector<LLVector4a> mWeights;
+		std::vector<LLVector4a> mPositions;
+	};
+
+	typedef test_group<skinningkernel_data> skinningkernel_group;
+	typedef skinningkernel_group::object skinningkernel_object;
+	tut::skinningkernel_group skinningkernel_test_group("LLSkinningKernel");
+
+	template<> template<>
+	void skinningkernel_object::test<1>()
+	{
+		set_test_name("mulPalette matches the matrix product");
+
+		LLMatrix4a rhs[PALETTE_SIZE];
+		const LLMatrix4a* lhs[PALETTE_SIZE];
+		for (U32 i = 0; i < PALETTE_SIZE; ++i)
+		{
+			fill_matrix(mSeq, rhs[i]);
+			lhs[i] = (i % 5 == 3) ? nullptr : &mPalette[i];
+		}
+
+		LLMatrix4a out[PALETTE_SIZE];
+		LLSkinningKernel::mulPalette(out, lhs, rhs, PALETTE_SIZE);
+
+		for (U32 i = 0; i < PALETTE_SIZE; ++i)
+		{
+			LLMatrix4a expected;
+			if (lhs[i])
+			{
+				reference_mul(*lhs[i], rhs[i], expected);
+			}
+			else
+			{
+				expected = rhs[i];
+			}
+			ensure("palette entry " + std::to_string(i), approx_equal(out[i], expected));
+		}
+	}
+
+	template<> template<>
+	void skinningkernel_object::test<2>()
+	{
+		set_test_name("mulPalette by one matrix in place");
+
+		LLMatrix4a rhs;
+		fill_matrix(mSeq, rhs);
+
+		LLMatrix4a expected[PALETTE_SIZE];
+		for (U32 i = 0; i < PALETTE_SIZE; ++i)
+		{
+			reference_mul(mPalette[i], rhs, expected[i]);
+		}
+
+		LLSkinningKernel::mulPalette(mPalette, mPalette, rhs, PALETTE_SIZE);
+
+		for (U32 i = 0; i < PALETTE_SIZE; ++i)
+		{
+			ensure("palette entry " + std::to_string(i), approx_equal(mPalette[i], expected[i]));
+		}
+
+		// rhs aliasing the first entry it overwrites
+		LLMatrix4a square;
+		reference_mul(expected[0], expected[0], square);
+		LLSkinningKernel::mulPalette(mPalette, mPalette, mPalette[0], 1);
+		ensure("aliased rhs", approx_equal(mPalette[0], square));
+	}
+
+	template<> template<>
+	void skinningkernel_object::test<3>()
+	{
+		set_test_name("skinPositions matches the scalar path");
+
+		// odd and even counts so paired and single vertex paths both run
+		for (U32 count = 1; count <= 9; ++count)
+		{
+			makeVertices(count);
+			std::vector<LLVector4a> out(count);
+			LLSkinningKernel::skinPositions(mPalette, PALETTE_SIZE, mWeights.data(), mPositions.data(), out.data(), count);
+
+			for (U32 i = 0; i < count; ++i)
+			{
+				const LLVector4a expected = reference_skin(mPalette, PALETTE_SIZE, mWeights[i], mPositions[i]);
+				ensure("count " + std::to_string(count) + " vertex " + std::to_string(i), approx_equal(out[i], expected));
+			}
+		}
+
+		// in place
+		makeVertices(257);
+		std::vector<LLVector4a> expected(mPositions.size());
+		for (size_t i = 0; i < mPositions.size(); ++i)
+		{
+			expected[i] = reference_skin(mPalette, PALETTE_SIZE, mWeights[i], mPositions[i]);
+		}
+		LLSkinningKernel::skinPositions(mPalette, PALETTE_SIZE, mWeights.data(), mPositions.data(), mPositions.data(), (U32)mPositions.size());
+		for (size_t i = 0; i < mPositions.size(); ++i)
+		{
+			ensure("in place vertex " + std::to_string(i), approx_equal(mPositions[i], expected[i]));
+		}
+	}
+
+	template<> template<>
+	void skinningkernel_object::test<4>()
+	{
+		set_test_name("skinPositions bounds");
+
+		for (U32 count = 1; count <= 6; ++count)
+		{
+			makeVertices(count);
+			std::vector<LLVector4a> out(count);
+			LLVector4a min, max;
+			LLSkinningKernel::skinPositions(mPalette, PALETTE_SIZE, mWeights.data(), mPositions.data(), out.data(), count, min, max);
+
+			LLVector4a expected_min = out[0];
+			LLVector4a expected_max = out[0];
+			for (U32 i = 0; i < count; ++i)
+			{
+				ensure("bounded vertex", approx_equal(out[i], reference_skin(mPalette, PALETTE_SIZE, mWeights[i], mPositions[i])));
+				expected_min.setMin(expected_min, out[i]);
+				expected_max.setMax(expected_max, out[i]);
+			}
+			ensure("min for count " + std::to_string(count), approx_equal(min, expected_min));
+			ensure("max for count " + std::to_string(count), approx_equal(max, expected_max));
+		}
+	}
+
+	template<> template<>
+	void skinningkernel_object::test<5>()
+	{
+		set_test_name("skinPositions degenerate weights");
+
+		makeVertices(4);
+		// weights that sum to zero go to the first joint alone
+		mWeights[0].set(3.f, 5.f, 7.f, 9.f);
+		mWeights[1].set(0.f, 0.f, 0.f, 0.f);
+		// indices past the palette are clamped to its last entry
+		mWeights[2].set(F32(PALETTE_SIZE + 4) + 0.5f, 1.25f, 2.f, 3.f);
+		mWeights[3].set(40.75f, 2.f, 1.f, 0.f);
+
+		std::vector<LLVector4a> out(4);
+		LLSkinningKernel::skinPositions(mPalette, PALETTE_SIZE, mWeights.data(), mPositions.data(), out.data(), 4);
+
+		LLVector4a expected;
+		mPalette[3].affineTransform(mPositions[0], expected);
+		ensure("zero weights bind to the first joint", approx_equal(out[0], expected));
+		mPalette[0].affineTransform(mPositions[1], expected);
+		ensure("no weights bind to joint 0", approx_equal(out[1], expected));
+		ensure("clamped index", approx_equal(out[2], reference_skin(mPalette, PALETTE_SIZE, mWeights[2], mPositions[2])));
+		mPalette[PALETTE_SIZE - 1].affineTransform(mPositions[3], expected);
+		ensure("single clamped joint", approx_equal(out[3], expected));
+	}
+}
@@ -0,0 +1,266 @@
+/**
+ * @file llvolume_test.cpp
+ * @brief Checks the decoded mesh face layout against the LLSD decoder.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llvolume.h"
+
+#include "llsdserialize.h"
+#include "llstring.h"
+#include "lltimer.h"
+#include "lluuid.h"
+
+#include <iostream>
+
+#include "../test/lltut.h"
+
+namespace
+{
+	LLSD domain(F32 lo, F32 hi, U32 components)
+	{
+		LLSD min = LLSD::emptyArray();
+		LLSD max = LLSD::emptyArray();
+		for (U32 i = 0; i < components; ++i)
+		{
+			min.append(lo);
+			max.append(hi);
+		}
+		LLSD result;
+		result["Min"] = min;
+		result["Max"] = max;
+		return result;
+	}
+
+	void push_u16(LLSD::Binary& out, U32 value)
+	{
+		out.push_back(U8(value & 0xFF));
+		out.push_back(U8(value >> 8));
+	}
+
+	// A wavy grid of side x side vertices, the way the uploader quantizes it
+	LLSD make_face(U32 side, bool weights)
+	{
+		LLSD::Binary pos, norm, tc, idx, wght;
+		for (U32 y = 0; y < side; ++y)
+		{
+			for (U32 x = 0; x < side; ++x)
+			{
+				U32 u = x * 65535 / (side - 1);
+				U32 v = y * 65535 / (side - 1);
+				push_u16(pos, u);
+				push_u16(pos, v);
+				push_u16(pos, U32(32767.f + 32767.f * sinf(x * 0.7f) * cosf(y * 0.3f)));
+				push_u16(norm, 32767 + (x * 997) % 4000);
+				push_u16(norm, 32767 - (y * 331) % 4000);
+				push_u16(norm, 65535);
+				push_u16(tc, u);
+				push_u16(tc, v);
+				if (weights)
+				{
+					wght.push_back(U8(x % 8));
+					push_u16(wght, 40000);
+					wght.push_back(U8(8 + y % 8));
+					push_u16(wght, 25535);
+					wght.push_back(0xFF);
+				}
+			}
+		}
+		for (U32 y = 0; y + 1 < side; ++y)
+		{
+			for (U32 x = 0; x + 1 < side; ++x)
+			{
+				U32 i = y * side + x;
+				push_u16(idx, i);
+				push_u16(idx, i + 1);
+				push_u16(idx, i + side);
+				push_u16(idx, i + 1);
+				push_u16(idx, i + side + 1);
+				push_u16(idx, i + side);
+			}
+		}
+
+		LLSD face;
+		face["Position"] = pos;
+		face["Normal"] = norm;
+		face["TexCoord0"] = tc;
+		face["TriangleList"] = idx;
+		face["PositionDomain"] = domain(-0.5f, 0.5f, 3);
+		face["TexCoord0Domain"] = domain(0.f, 2.f, 2);
+		if (weights)
+		{
+			face["Weights"] = wght;
+		}
+		return face;
+	}
+
+	// Compressed LLSD, as a LOD block of a mesh asset
+	std::string make_lod(U32 side, U32 faces)
+	{
+		LLSD mdl = LLSD::emptyArray();
+		for (U32 i = 0; i < faces; ++i)
+		{
+			mdl.append(make_face(side + i, i % 2 == 1));
+		}
+		LLSD no_geometry;
+		no_geometry["NoGeometry"] = true;
+		mdl.append(no_geometry);
+		return zip_llsd(mdl);
+	}
+
+	LLVolumeParams mesh_params()
+	{
+		LLVolumeParams params;
+		params.setType(LL_PCODE_PROFILE_SQUARE, LL_PCODE_PATH_LINE);
+		params.setSculptID(LLUUID("4b36f6c2-3c1e-4d4c-8d7e-6d0e8f1a2b3c"), LL_SCULPT_TYPE_MESH);
+		return params;
+	}
+
+	LLPointer<LLVolume> decode(const std::string& lod)
+	{
+		LLPointer<LLVolume> volume = new LLVolume(mesh_params(), 4.f);
+		tut::ensure("LLSD decode", volume->unpackVolumeFaces((U8*)lod.data(), (S32)lod.size()));
+		return volume;
+	}
+
+	void ensure_same_bytes(const std::string& what, const void* lhs, const void* rhs, size_t bytes)
+	{
+		tut::ensure(what, (lhs == nullptr) == (rhs == nullptr));
+		if (lhs)
+		{
+			tut::ensure(what, memcmp(lhs, rhs, bytes) == 0);
+		}
+	}
+}
+
+namespace tut
+{
+	struct volume_data
+	{
+	};
+	typedef test_group<volume_data> volume_test;
+	typedef volume_test::object volume_object;
+	tut::volume_test tvolume("LLVolume");
+
+	template<> template<>
+	void volume_object::test<1>()
+	{
+		set_test_name("decoded faces round trip");
+		LLPointer<LLVolume> expected = decode(make_lod(17, 3));
+
+		std::vector<U8> packed;
+		ensure("pack", expected->packDecodedFaces(packed));
+
+		LLPointer<LLVolume> volume = new LLVolume(mesh_params(), 4.f);
+		ensure("unpack", volume->unpackDecodedFaces(packed.data(), packed.size()));
+		ensure_equals("face count", volume->getNumVolumeFaces(), expected->getNumVolumeFaces());
+
+		for (S32 i = 0; i < expected->getNumVolumeFaces(); ++i)
+		{
+			const LLVolumeFace& lhs = volume->getVolumeFace(i);
+			const LLVolumeFace& rhs = expected->getVolumeFace(i);
+			std::string face = "face " + std::to_string(i) + " ";
+			ensure_equals(face + "vertices", lhs.mNumVertices, rhs.mNumVertices);
+			ensure_equals(face + "indices", lhs.mNumIndices, rhs.mNumIndices);
+			ensure_same_bytes(face + "positions", lhs.mPositions, rhs.mPositions, sizeof(LLVector4a) * rhs.mNumVertices);
+			ensure_same_bytes(face + "normals", lhs.mNormals, rhs.mNormals, sizeof(LLVector4a) * rhs.mNumVertices);
+			ensure_same_bytes(face + "texture coordinates", lhs.mTexCoords, rhs.mTexCoords, sizeof(LLVector2) * rhs.mNumVertices);
+			ensure_same_bytes(face + "tangents", lhs.mTangents, rhs.mTangents, sizeof(LLVector4a) * rhs.mNumVertices);
+			ensure_same_bytes(face + "weights", lhs.mWeights, rhs.mWeights, sizeof(LLVector4a) * rhs.mNumVertices);
+			ensure_same_bytes(face + "triangles", lhs.mIndices, rhs.mIndices, sizeof(U16) * rhs.mNumIndices);
+			ensure_same_bytes(face + "extents", lhs.mExtents, rhs.mExtents, sizeof(LLVector4a) * 2);
+			ensure(face + "texture extents", lhs.mTexCoordExtents[0] == rhs.mTexCoordExtents[0] && lhs.mTexCoordExtents[1] == rhs.mTexCoordExtents[1]);
+			ensure(face + "normalized scale", lhs.mNormalizedScale == rhs.mNormalizedScale);
+			ensure(face + "optimized", lhs.mOptimized);
+		}
+	}
+
+	template<> template<>
+	void volume_object::test<2>()
+	{
+		set_test_name("bad decoded faces");
+		LLPointer<LLVolume> expected = decode(make_lod(9, 2));
+		std::vector<U8> packed;
+		ensure("pack", expected->packDecodedFaces(packed));
+
+		LLPointer<LLVolume> volume = new LLVolume(mesh_params(), 4.f);
+		for (size_t size = 0; size < packed.size(); size += 7)
+		{
+			ensure("truncated to " + std::to_string(size), !volume->unpackDecodedFaces(packed.data(), size));
+		}
+
+		std::vector<U8> other_version(packed);
+		other_version[4] ^= 0xFF;
+		ensure("version", !volume->unpackDecodedFaces(other_version.data(), other_version.size()));
+
+		// first index of the first face, past its header and vertex data
+		S32 num_verts = expected->getVolumeFace(0).mNumVertices;
+		size_t first_index = 16 + 80 + sizeof(LLVector4a) * 2 * num_verts + ((num_verts * sizeof(LLVector2) + 0xF) & ~0xF)
+			+ sizeof(LLVector4a) * num_verts;
+		std::vector<U8> bad_index(packed);
+		bad_index[first_index] = 0xFF;
+		bad_index[first_index + 1] = 0xFF;
+		ensure("index out of range", !volume->unpackDecodedFaces(bad_index.data(), bad_index.size()));
+
+		ensure("still good", volume->unpackDecodedFaces(packed.data(), packed.size()));
+	}
+
+	template<> template<>
+	void volume_object::test<3>()
+	{
+		set_test_name("warm cache load time");
+		if (LLStringUtil::getenv("LL_MESHCACHE_BENCH").empty())
+		{
+			skip("set LL_MESHCACHE_BENCH to run");
+		}
+
+		// a region's worth of mesh LODs, from small props to big builds
+		const U32 MESHES = 200;
+		std::vector<std::string> lods;
+		std::vector<std::vector<U8>> decoded(MESHES);
+		for (U32 i = 0; i < MESHES; ++i)
+		{
+			lods.push_back(make_lod(8 + (i * 37) % 120, 1 + i % 4));
+			decode(lods.back())->packDecodedFaces(decoded[i]);
+		}
+
+		LLTimer timer;
+		for (const std::string& lod : lods)
+		{
+			decode(lod);
+		}
+		F64 llsd_seconds = timer.getElapsedTimeF64();
+
+		timer.reset();
+		for (const std::vector<U8>& data : decoded)
+		{
+			LLPointer<LLVolume> volume = new LLVolume(mesh_params(), 4.f);
+			volume->unpackDecodedFaces(data.data(), data.size());
+		}
+		F64 decoded_seconds = timer.getElapsedTimeF64();
+
+		std::cout << "\n" << MESHES << " mesh LODs, asset cache: " << llsd_seconds * 1000.0 << " ms, decoded cache: "
+				  << decoded_seconds * 1000.0 << " ms, " << llsd_seconds / llmax(decoded_seconds, 1e-9) << "x" << std::endl;
+	}
+}
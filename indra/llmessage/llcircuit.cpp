@@ -68,7 +68,7 @@ LLCircuitData::LLCircuitData(const LLHost &host, TPACKETID in_id,
 							 const F32Seconds circuit_heartbeat_interval, const F32Seconds circuit_timeout)
 :	mHost (host),
 	mWrapID(0),
-	mPacketsOutID(0), 
+	mPacketsOutID(std::make_shared<std::atomic<TPACKETID> >(0)), 
 	mPacketsInID(in_id),
 	mHighestPacketID(in_id),
 	mTimeoutCallback(NULL),
@@ -446,6 +446,11 @@ LLCircuitData *LLCircuit::addCircuitData(const LLHost &host, TPACKETID in_id)
 	mCircuitData.insert(circuit_data_map::value_type(host, tempp));
 	mPingSet.insert(tempp);
 
+	if (gMessageSystem)
+	{
+		gMessageSystem->mPacketRing.addAckCircuit(host, tempp->getSharedPacketOutID());
+	}
+
 	mLastCircuit = tempp;
 	return tempp;
 }
@@ -473,6 +478,10 @@ void LLCircuit::removeCircuitData(const LLHost &host)
 		// Clean up from optimization maps
 		mUnackedCircuitMap.erase(host);
 		mSendAckMap.erase(host);
+		if (gMessageSystem)
+		{
+			gMessageSystem->mPacketRing.removeAckCircuit(host);
+		}
 		delete cdp;
 	}
 
@@ -488,7 +497,7 @@ void LLCircuitData::setAlive(BOOL b_alive)
 {
 	if (mbAlive != b_alive)
 	{
-		mPacketsOutID = 0;
+		*mPacketsOutID = 0;
 		mPacketsInID = 0;
 		mbAlive = b_alive;
 	}
@@ -1235,16 +1244,31 @@ TPACKETID LLCircuitData::nextPacketOutID()
 {
 	mPacketsOut++;
 	
-	TPACKETID id; 
-
-	id = (mPacketsOutID + 1) % LL_MAX_OUT_PACKET_ID;
-			
-	if (id < mPacketsOutID)
+	bool wrapped = false;
+	TPACKETID id = advancePacketOutID(*mPacketsOutID, &wrapped);
+	if (wrapped)
 	{
 		// we just wrapped on a circuit, reset the wrap ID to zero
 		mWrapID = 0;
 	}
-	mPacketsOutID = id;
+	return id;
+}
+
+// static
+TPACKETID LLCircuitData::advancePacketOutID(std::atomic<TPACKETID>& packet_id, bool* wrapped)
+{
+	TPACKETID last_id = packet_id;
+	TPACKETID id;
+	do
+	{
+		id = (last_id + 1) % LL_MAX_OUT_PACKET_ID;
+	}
+	while (!packet_id.compare_exchange_weak(last_id, id));
+
+	if (wrapped)
+	{
+		*wrapped = id < last_id;
+	}
 	return id;
 }
 
@@ -1330,7 +1354,7 @@ U32 LLCircuitData::getPacketsOut() const
 
 TPACKETID LLCircuitData::getPacketOutID() const
 {
-	return mPacketsOutID;
+	return *mPacketsOutID;
 }
 
 
@@ -28,7 +28,9 @@
 #ifndef LL_LLCIRCUIT_H
 #define LL_LLCIRCUIT_H
 
+#include <atomic>
 #include <map>
+#include <memory>
 #include <vector>
 
 #include "llerror.h"
@@ -123,6 +125,13 @@ class LLCircuitData
 	U32			getPacketsLost() const;
 	TPACKETID	getPacketOutID() const;
 	BOOL		getTrusted() const;
+
+	// The outgoing packet id is shared with the packet ring's receive
+	// thread, which takes ids for the acks it sends
+	typedef std::shared_ptr<std::atomic<TPACKETID> > shared_packet_id_t;
+	const shared_packet_id_t& getSharedPacketOutID() const { return mPacketsOutID; }
+	static TPACKETID advancePacketOutID(std::atomic<TPACKETID>& packet_id, bool* wrapped = nullptr);
+
 	F32			getAgeInSeconds() const;
 	S32			getUnackedPacketCount() const	{ return mUnackedPacketCount; }
 	S32			getUnackedPacketBytes() const	{ return mUnackedPacketBytes; }
@@ -202,7 +211,7 @@ class LLCircuitData
 
 	// Current packet IDs of incoming/outgoing packets
 	// Used for packet sequencing/packet loss detection.
-	TPACKETID		mPacketsOutID;
+	shared_packet_id_t	mPacketsOutID;
 	TPACKETID		mPacketsInID;
 	TPACKETID		mHighestPacketID;
 
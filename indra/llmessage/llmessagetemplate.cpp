@@ -45,7 +45,8 @@ void LLMsgVarData::addData(const void *data, S32 size, EMsgVariableType type, S3
 	}
 	if(size)
 	{
-		delete[] mData; // Delete it if it already exists
+		deleteData(); // Delete it if it already exists
+		mSharedData = false;
 		mData = new U8[size];
 		htolememcpy(mData, data, mType, size);
 	}
@@ -67,6 +68,39 @@ void LLMsgData::addDataFast(char *blockname, char *varname, const void *data, S3
 	}
 }
 
+void LLMsgBlkData::addBlockData(const LLMessageBlock& block, const U8 *data, S32 size)
+{
+	delete[] mBlockData;
+	mBlockData = new U8[size];
+	memcpy(mBlockData, data, size);
+
+	const bool fixed_size = block.mTotalSize != -1;
+	S32 offset = 0;
+	U32 i = 0;
+	for (const LLMessageVariable* var : block.mMemberVariables)
+	{
+		S32 var_size = var->getSize();
+		if (fixed_size)
+		{
+			offset = block.mFixedOffsets[i++];
+		}
+		else if (var->getType() == MVT_VARIABLE)
+		{
+			// the length comes first
+			U32 length = 0;
+			memcpy(&length, mBlockData + offset, var_size);
+			offset += var_size;
+			var_size = length;
+		}
+		llassert(offset + var_size <= size);
+
+		LLMsgVarData& var_data = mMemberVarData[var->getName()];
+		var_data = LLMsgVarData(var->getName(), var->getType());
+		var_data.setSharedData(mBlockData + offset, var_size);
+		offset += var_size;
+	}
+}
+
 // LLMessageVariable functions and friends
 
 std::ostream& operator<<(std::ostream& s, LLMessageVariable &msg)
@@ -31,14 +31,16 @@
 #include "llstl.h"
 #include "llindexedvector.h"
 
+class LLMessageBlock;
+
 class LLMsgVarData
 {
 public:
-	LLMsgVarData() : mName(nullptr), mSize(-1), mDataSize(-1), mData(nullptr), mType(MVT_U8)
+	LLMsgVarData() : mName(nullptr), mSize(-1), mDataSize(-1), mData(nullptr), mType(MVT_U8), mSharedData(false)
 	{
 	}
 
-	LLMsgVarData(const char *name, EMsgVariableType type) : mSize(-1), mDataSize(-1), mData(nullptr), mType(type)
+	LLMsgVarData(const char *name, EMsgVariableType type) : mSize(-1), mDataSize(-1), mData(nullptr), mType(type), mSharedData(false)
 	{
 		mName = (char *)name; 
 	}
@@ -47,12 +49,25 @@ class LLMsgVarData
 
 	void deleteData() 
 	{
-		delete[] mData;
+		if (!mSharedData)
+		{
+			delete[] mData;
+		}
 		mData = nullptr;
 	}
 	
 	void addData(const void *indata, S32 size, EMsgVariableType type, S32 data_size = -1);
 
+	// Points at data owned by the block, see LLMsgBlkData::addBlockData()
+	void setSharedData(U8 *data, S32 size)
+	{
+		deleteData();
+		mSize = size;
+		mDataSize = -1;
+		mData = data;
+		mSharedData = true;
+	}
+
 	char *getName() const	{ return mName; }
 	S32 getSize() const		{ return mSize; }
 	void *getData()			{ return (void*)mData; }
@@ -67,12 +82,13 @@ class LLMsgVarData
 
 	U8					*mData;
 	EMsgVariableType	mType;
+	bool				mSharedData;
 };
 
 class LLMsgBlkData
 {
 public:
-        LLMsgBlkData(const char *name, S32 blocknum) : mBlockNumber(blocknum), mTotalSize(-1) 
+        LLMsgBlkData(const char *name, S32 blocknum) : mBlockNumber(blocknum), mTotalSize(-1), mBlockData(nullptr) 
 	{ 
 		mName = (char *)name; 
 	}
@@ -83,6 +99,7 @@ class LLMsgBlkData
         {
             iter.deleteData();
 		}
+		delete[] mBlockData;
 	}
 
 	void addVariable(const char *name, EMsgVariableType type)
@@ -97,11 +114,16 @@ class LLMsgBlkData
 		temp->addData(data, size, type, data_size);
 	}
 
+	// Adds every variable of the block with a single copy of the size
+	// bytes at data, which must hold the whole block.  Little endian only.
+	void addBlockData(const LLMessageBlock& block, const U8 *data, S32 size);
+
 	S32									mBlockNumber;
 	typedef LLIndexedVector<LLMsgVarData, const char *, 8> msg_var_data_map_t;
 	msg_var_data_map_t					mMemberVarData;
 	char								*mName;
 	S32									mTotalSize;
+	U8									*mBlockData;	// shared by the variables added by addBlockData()
 };
 
 class LLMsgData
@@ -196,6 +218,7 @@ class LLMessageBlock
 		if (((*varp)->getType() != MVT_VARIABLE)
 			&&(mTotalSize != -1))
 		{
+			mFixedOffsets.push_back(mTotalSize);
 			mTotalSize += (*varp)->getSize();
 		}
 		else
@@ -228,6 +251,10 @@ class LLMessageBlock
 	EMsgBlockType							mType;
 	S32										mNumber;
 	S32										mTotalSize;
+	// Where each variable starts while all of them are fixed size.  With
+	// mTotalSize this is the decode plan for fixed size blocks, which are
+	// read without walking their variables.
+	std::vector<S32>						mFixedOffsets;
 };
 
 
@@ -0,0 +1,343 @@
+/**
+ * @file llpacketreceivethread.cpp
+ * @brief Drains the UDP socket on its own thread.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llpacketreceivethread.h"
+
+#if LL_WINDOWS
+	#include "llwin32headerslean.h"
+#else
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+	#include <poll.h>
+#endif
+
+#include <thread>
+
+#include "lltimer.h"
+#include "message.h"
+
+namespace
+{
+	// Wakes up this often to check for shutdown
+	const S32 POLL_TIMEOUT_MS = 100;
+
+	// Packets read with a single system call
+	const U32 RECEIVE_BATCH = 32;
+
+	// With the pool full, yield this many times before sleeping between
+	// checks, the main thread usually frees a batch within a frame
+	const U32 FULL_POOL_SPINS = 64;
+	const U32 FULL_POOL_SLEEP_MS = 1;
+
+	// Fixed frequency message number of PacketAck as it goes on the wire
+	const U8 PACKET_ACK_NUMBER[] = { 0xFF, 0xFF, 0xFF, 0xFB };
+
+	// Same limit LLCircuit::sendAcks() uses
+	const U32 MAX_ACKS_PER_PACKET = 250;
+}
+
+LLPacketReceiveThread::LLPacketReceiveThread(S32 socket, U32 pool_size)
+:	LLThread("Packet receive"),
+	mSocket(socket),
+	mHead(0),
+	mTail(0),
+	mPoolFullWaits(0),
+	mSocketDrops(0),
+	mAcksSent(0)
+{
+	U32 size = 1;
+	while (size < pool_size)
+	{
+		size <<= 1;
+	}
+	mPool.resize(size);
+	mPoolMask = size - 1;
+
+#if LL_LINUX
+	// Reports the kernel's count of packets it dropped on a full receive
+	// buffer with every packet read
+	int enable = 1;
+	if (setsockopt(mSocket, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable)) == -1)
+	{
+		LL_WARNS("Messaging") << "Unable to enable SO_RXQ_OVFL, socket drops will not be reported" << LL_ENDL;
+	}
+#endif
+}
+
+LLPacketReceiveThread::~LLPacketReceiveThread()
+{
+	shutdown();
+}
+
+const LLPacketReceiveThread::Packet* LLPacketReceiveThread::front() const
+{
+	U32 tail = mTail.load(std::memory_order_relaxed);
+	if (tail == mHead.load(std::memory_order_acquire))
+	{
+		return nullptr;
+	}
+	return &mPool[tail & mPoolMask];
+}
+
+void LLPacketReceiveThread::pop()
+{
+	U32 tail = mTail.load(std::memory_order_relaxed);
+	if (tail != mHead.load(std::memory_order_acquire))
+	{
+		mTail.store(tail + 1, std::memory_order_release);
+	}
+}
+
+void LLPacketReceiveThread::addAckCircuit(const LLHost& host, const LLCircuitData::shared_packet_id_t& packet_out_id)
+{
+	LLMutexLock lock(&mAckMutex);
+	mAckCircuits[host] = packet_out_id;
+}
+
+void LLPacketReceiveThread::removeAckCircuit(const LLHost& host)
+{
+	LLMutexLock lock(&mAckMutex);
+	mAckCircuits.erase(host);
+}
+
+void LLPacketReceiveThread::run()
+{
+	while (!isQuitting())
+	{
+		if (!waitForData(POLL_TIMEOUT_MS))
+		{
+			continue;
+		}
+
+		const U32 head = mHead.load(std::memory_order_relaxed);
+		const U32 free = (U32)mPool.size() - (head - mTail.load(std::memory_order_acquire));
+		if (!free)
+		{
+			// The main thread has fallen behind by a whole pool.  Leave the
+			// packets in the socket until it catches up, the kernel buffer
+			// holds far more than the pool.
+			++mPoolFullWaits;
+			waitForSpace();
+			continue;
+		}
+
+		U32 count = receive(head, llmin(free, RECEIVE_BATCH));
+		if (count)
+		{
+			ackPackets(head, count);
+			mHead.store(head + count, std::memory_order_release);
+		}
+	}
+}
+
+bool LLPacketReceiveThread::waitForData(S32 timeout_ms)
+{
+#if LL_WINDOWS
+	WSAPOLLFD pfd = { (SOCKET)mSocket, POLLRDNORM, 0 };
+	return WSAPoll(&pfd, 1, timeout_ms) > 0;
+#else
+	pollfd pfd = { mSocket, POLLIN, 0 };
+	return poll(&pfd, 1, timeout_ms) > 0;
+#endif
+}
+
+U32 LLPacketReceiveThread::receive(U32 head, U32 count)
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_NETWORK;
+
+#if LL_LINUX
+	mmsghdr msgs[RECEIVE_BATCH];
+	iovec iovs[RECEIVE_BATCH];
+	sockaddr_in addrs[RECEIVE_BATCH];
+	char control[RECEIVE_BATCH][CMSG_SPACE(sizeof(in_pktinfo)) + CMSG_SPACE(sizeof(U32))];
+
+	memset(msgs, 0, sizeof(msgs));
+	for (U32 i = 0; i < count; ++i)
+	{
+		iovs[i].iov_base = slot(head + i).mData;
+		iovs[i].iov_len = NET_BUFFER_SIZE;
+		msgs[i].msg_hdr.msg_name = &addrs[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_control = control[i];
+		msgs[i].msg_hdr.msg_controllen = sizeof(control[i]);
+	}
+
+	int received = recvmmsg(mSocket, msgs, count, MSG_DONTWAIT, nullptr);
+	if (received <= 0)
+	{
+		return 0;
+	}
+
+	const U64 now = totalTime();
+	for (int i = 0; i < received; ++i)
+	{
+		Packet& packet = slot(head + i);
+		packet.mSize = (S32)msgs[i].msg_len;
+		packet.mSender = LLHost(addrs[i].sin_addr.s_addr, ntohs(addrs[i].sin_port));
+		packet.mReceivingIF = LLHost();
+		packet.mReceivedUsec = now;
+		packet.mAcked = false;
+
+		msghdr& hdr = msgs[i].msg_hdr;
+		for (cmsghdr* cmsgp = CMSG_FIRSTHDR(&hdr); cmsgp; cmsgp = CMSG_NXTHDR(&hdr, cmsgp))
+		{
+			if (cmsgp->cmsg_level == SOL_IP && cmsgp->cmsg_type == IP_PKTINFO)
+			{
+				in_pktinfo pktinfo;
+				memcpy(&pktinfo, CMSG_DATA(cmsgp), sizeof(pktinfo));
+				packet.mReceivingIF = LLHost(pktinfo.ipi_spec_dst.s_addr, INVALID_PORT);
+			}
+			else if (cmsgp->cmsg_level == SOL_SOCKET && cmsgp->cmsg_type == SO_RXQ_OVFL)
+			{
+				U32 drops;
+				memcpy(&drops, CMSG_DATA(cmsgp), sizeof(drops));
+				mSocketDrops = drops;
+			}
+		}
+	}
+	return (U32)received;
+#else
+	U32 received = 0;
+	while (received < count)
+	{
+		Packet& packet = slot(head + received);
+		S32 size = receive_packet(mSocket, (char*)packet.mData);
+		if (size <= 0)
+		{
+			break;
+		}
+		packet.mSize = size;
+		packet.mSender = get_sender();
+		packet.mReceivingIF = get_receiving_interface();
+		packet.mReceivedUsec = totalTime();
+		packet.mAcked = false;
+		++received;
+	}
+	return received;
+#endif
+}
+
+void LLPacketReceiveThread::waitForSpace()
+{
+	const U32 size = (U32)mPool.size();
+	for (U32 spins = 0; !isQuitting(); ++spins)
+	{
+		if (mHead.load(std::memory_order_relaxed) - mTail.load(std::memory_order_acquire) < size)
+		{
+			return;
+		}
+
+		if (spins < FULL_POOL_SPINS)
+		{
+			std::this_thread::yield();
+		}
+		else
+		{
+			ms_sleep(FULL_POOL_SLEEP_MS);
+		}
+	}
+}
+
+void LLPacketReceiveThread::ackPackets(U32 head, U32 count)
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_NETWORK;
+
+	LLMutexLock lock(&mAckMutex);
+	if (mAckCircuits.empty())
+	{
+		return;
+	}
+
+	for (U32 i = 0; i < count; ++i)
+	{
+		Packet& packet = slot(head + i);
+		if (packet.mSize < LL_MINIMUM_VALID_PACKET_SIZE || !(packet.mData[0] & LL_RELIABLE_FLAG))
+		{
+			continue;
+		}
+
+		auto circuit = mAckCircuits.find(packet.mSender);
+		if (circuit == mAckCircuits.end())
+		{
+			continue;
+		}
+
+		TPACKETID packet_id;
+		memcpy(&packet_id, packet.mData + 1, sizeof(packet_id));
+		mPendingAcks[packet.mSender].push_back(ntohl(packet_id));
+		packet.mAcked = true;
+	}
+
+	for (auto& pending : mPendingAcks)
+	{
+		if (!pending.second.empty())
+		{
+			sendAcks(pending.first, pending.second, *mAckCircuits[pending.first]);
+			pending.second.clear();
+		}
+	}
+}
+
+void LLPacketReceiveThread::sendAcks(const LLHost& host, const std::vector<TPACKETID>& ids, std::atomic<TPACKETID>& packet_out_id)
+{
+	// A PacketAck as LLTemplateMessageBuilder would build it: unflagged
+	// header, the message number and a variable block of U32 ids.  Sent
+	// straight to the socket, send_packet() isn't safe off the main thread.
+	U8 buffer[LL_PACKET_ID_SIZE + sizeof(PACKET_ACK_NUMBER) + 1 + MAX_ACKS_PER_PACKET * sizeof(TPACKETID)];
+
+	sockaddr_in dest;
+	memset(&dest, 0, sizeof(dest));
+	dest.sin_family = AF_INET;
+	dest.sin_addr.s_addr = host.getAddress();
+	dest.sin_port = htons(host.getPort());
+
+	for (size_t first = 0; first < ids.size(); first += MAX_ACKS_PER_PACKET)
+	{
+		const U32 count = (U32)llmin(ids.size() - first, (size_t)MAX_ACKS_PER_PACKET);
+
+		buffer[0] = 0;
+		TPACKETID sequence = htonl(LLCircuitData::advancePacketOutID(packet_out_id));
+		memcpy(buffer + 1, &sequence, sizeof(sequence));
+		buffer[PHL_OFFSET] = 0;
+		memcpy(buffer + LL_PACKET_ID_SIZE, PACKET_ACK_NUMBER, sizeof(PACKET_ACK_NUMBER));
+
+		U8* out = buffer + LL_PACKET_ID_SIZE + sizeof(PACKET_ACK_NUMBER);
+		*out++ = (U8)count;
+		for (U32 i = 0; i < count; ++i, out += sizeof(TPACKETID))
+		{
+			htolememcpy(out, &ids[first + i], MVT_U32, sizeof(TPACKETID));
+		}
+
+		const int size = (int)(out - buffer);
+		if (sendto(mSocket, (const char*)buffer, size, 0, (const sockaddr*)&dest, sizeof(dest)) == size)
+		{
+			mAcksSent += count;
+		}
+	}
+}
@@ -0,0 +1,112 @@
+/**
+ * @file llpacketreceivethread.h
+ * @brief Drains the UDP socket on its own thread.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLPACKETRECEIVETHREAD_H
+#define LL_LLPACKETRECEIVETHREAD_H
+
+#include <atomic>
+#include <map>
+#include <vector>
+
+#include "llcircuit.h"
+#include "llhost.h"
+#include "llmutex.h"
+#include "llthread.h"
+#include "net.h"
+
+// Reads packets off the socket as soon as they arrive, so that a long
+// frame on the main thread doesn't leave them to overflow the kernel
+// buffer.  Packets go into a fixed pool of slots that doubles as a
+// single producer, single consumer ring: this thread fills slots and
+// publishes them by moving mHead, the main thread reads them in order
+// and hands them back by moving mTail.  Neither side takes a lock.
+// When the pool is full this thread stops reading until the main thread
+// frees a slot, leaving the packets in the kernel buffer.
+//
+// Reliable packets from known circuits are acked from here, so that a
+// stalled main thread doesn't make the simulator resend them.
+class LLPacketReceiveThread : public LLThread
+{
+public:
+	struct Packet
+	{
+		U8			mData[NET_BUFFER_SIZE];
+		S32			mSize;
+		LLHost		mSender;
+		LLHost		mReceivingIF;
+		U64			mReceivedUsec;		// totalTime() when it came off the socket
+		bool		mAcked;				// this thread has sent the ack
+	};
+
+	// pool_size is rounded up to a power of two
+	LLPacketReceiveThread(S32 socket, U32 pool_size);
+	~LLPacketReceiveThread() override;
+
+	// Main thread.  The oldest queued packet or nullptr, valid until pop().
+	const Packet* front() const;
+	void pop();
+
+	// Reliable packets from host are acked using packet ids from packet_out_id
+	void addAckCircuit(const LLHost& host, const LLCircuitData::shared_packet_id_t& packet_out_id);
+	void removeAckCircuit(const LLHost& host);
+
+	// Totals since the thread started, safe from any thread
+	U64 getPoolFullWaits() const		{ return mPoolFullWaits; }		// the pool was full
+	U64 getSocketDrops() const			{ return mSocketDrops; }		// the kernel buffer was full, Linux only
+	U64 getAcksSent() const				{ return mAcksSent; }
+
+protected:
+	void run() override;
+
+private:
+	bool waitForData(S32 timeout_ms);
+
+	// Reads up to count packets into the slots from head on, returns how many
+	U32 receive(U32 head, U32 count);
+
+	// Backs off until the main thread frees a slot or the thread quits
+	void waitForSpace();
+
+	void ackPackets(U32 head, U32 count);
+	void sendAcks(const LLHost& host, const std::vector<TPACKETID>& ids, std::atomic<TPACKETID>& packet_out_id);
+
+	Packet& slot(U32 index)				{ return mPool[index & mPoolMask]; }
+
+	const S32					mSocket;
+	std::vector<Packet>			mPool;
+	U32							mPoolMask;
+	std::atomic<U32>			mHead;			// next slot this thread fills
+	std::atomic<U32>			mTail;			// next slot the main thread reads
+
+	LLMutex						mAckMutex;
+	std::map<LLHost, LLCircuitData::shared_packet_id_t> mAckCircuits;
+	std::map<LLHost, std::vector<TPACKETID> > mPendingAcks;		// receive thread only
+
+	std::atomic<U64>			mPoolFullWaits;
+	std::atomic<U64>			mSocketDrops;
+	std::atomic<U64>			mAcksSent;
+};
+
+#endif // LL_LLPACKETRECEIVETHREAD_H
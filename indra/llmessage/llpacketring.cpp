@@ -27,6 +27,7 @@
 #include "linden_common.h"
 
 #include "llpacketring.h"
+#include "llpacketreceivethread.h"
 
 #if LL_WINDOWS
 	#include "llwin32headerslean.h"
@@ -56,13 +57,18 @@ LLPacketRing::LLPacketRing () :
 	mInBufferLength(0),
 	mOutBufferLength(0),
 	mDropPercentage(0.0f),
-	mPacketsToDrop(0x0)
+	mPacketsToDrop(0x0),
+	mLastPacketAcked(false),
+	mQueueLatencyUsec(0),
+	mQueueLatencyMaxUsec(0),
+	mQueuedPackets(0)
 {
 }
 
 ///////////////////////////////////////////////////////////
 LLPacketRing::~LLPacketRing ()
 {
+	stopReceiveThread();
 	cleanup();
 }
 	
@@ -158,6 +164,12 @@ S32 LLPacketRing::receiveFromRing (S32 socket, char *datap)
 S32 LLPacketRing::receivePacket (S32 socket, char *datap)
 {
 	S32 packet_size = 0;
+	mLastPacketAcked = false;
+
+	if (mReceiveThread)
+	{
+		return receiveFromThread(datap);
+	}
 
 	// If using the throttle, simulate a limited size input buffer.
 	if (mUseInThrottle)
@@ -271,6 +283,111 @@ S32 LLPacketRing::receivePacket (S32 socket, char *datap)
 	return packet_size;
 }
 
+S32 LLPacketRing::receiveFromThread(char *datap)
+{
+	const LLPacketReceiveThread::Packet* packetp = mReceiveThread->front();
+	if (!packetp)
+	{
+		return 0;
+	}
+
+	S32 packet_size = packetp->mSize;
+	memcpy(datap, packetp->mData, packet_size);	/*Flawfinder: ignore*/
+	mLastSender = packetp->mSender;
+	mLastReceivingIF = packetp->mReceivingIF;
+	mLastPacketAcked = packetp->mAcked;
+
+	U64 latency = totalTime() - packetp->mReceivedUsec;
+	mQueueLatencyUsec += latency;
+	mQueueLatencyMaxUsec = llmax(mQueueLatencyMaxUsec, latency);
+	++mQueuedPackets;
+
+	mReceiveThread->pop();
+
+	// Manual drops from the debug menu still work, acked packets are
+	// dropped silently
+	if (mPacketsToDrop)
+	{
+		packet_size = 0;
+		mPacketsToDrop--;
+	}
+	return packet_size;
+}
+
+bool LLPacketRing::startReceiveThread(S32 socket)
+{
+	if (mReceiveThread)
+	{
+		return true;
+	}
+	if (mUseInThrottle || mDropPercentage > 0.f || LLProxy::isSOCKSProxyEnabled())
+	{
+		LL_INFOS("Messaging") << "Not starting the packet receive thread, the socket is throttled or proxied" << LL_ENDL;
+		return false;
+	}
+
+	// 512 packets is several seconds of a busy region
+	mReceiveThread = std::make_unique<LLPacketReceiveThread>(socket, 512);
+	for (const auto& circuit : mAckCircuits)
+	{
+		mReceiveThread->addAckCircuit(circuit.first, circuit.second);
+	}
+	mReceiveThread->start();
+	LL_INFOS("Messaging") << "Started the packet receive thread" << LL_ENDL;
+	return true;
+}
+
+void LLPacketRing::stopReceiveThread()
+{
+	if (mReceiveThread)
+	{
+		mReceiveThread->shutdown();
+		mReceiveThread.reset();
+	}
+}
+
+void LLPacketRing::addAckCircuit(const LLHost& host, const LLCircuitData::shared_packet_id_t& packet_out_id)
+{
+	mAckCircuits[host] = packet_out_id;
+	if (mReceiveThread)
+	{
+		mReceiveThread->addAckCircuit(host, packet_out_id);
+	}
+}
+
+void LLPacketRing::removeAckCircuit(const LLHost& host)
+{
+	mAckCircuits.erase(host);
+	if (mReceiveThread)
+	{
+		mReceiveThread->removeAckCircuit(host);
+	}
+}
+
+U64 LLPacketRing::getReceiveThreadWaits() const
+{
+	return mReceiveThread ? mReceiveThread->getPoolFullWaits() : 0;
+}
+
+U64 LLPacketRing::getSocketDrops() const
+{
+	return mReceiveThread ? mReceiveThread->getSocketDrops() : 0;
+}
+
+U64 LLPacketRing::getReceiveThreadAcks() const
+{
+	return mReceiveThread ? mReceiveThread->getAcksSent() : 0;
+}
+
+void LLPacketRing::getAndResetQueueLatency(U64& mean_usec, U64& max_usec)
+{
+	mean_usec = mQueuedPackets ? mQueueLatencyUsec / mQueuedPackets : 0;
+	max_usec = mQueueLatencyMaxUsec;
+	mQueueLatencyUsec = 0;
+	mQueueLatencyMaxUsec = 0;
+	mQueuedPackets = 0;
+}
+
 BOOL LLPacketRing::sendPacket(int h_socket, char * send_buffer, S32 buf_size, const LLHost& host)
 {
 #define LOCALHOST_ADDR 16777343
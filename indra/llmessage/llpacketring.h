@@ -28,14 +28,19 @@
 #ifndef LL_LLPACKETRING_H
 #define LL_LLPACKETRING_H
 
+#include <map>
+#include <memory>
 #include <queue>
 
+#include "llcircuit.h"
 #include "llhost.h"
 #include "llpacketbuffer.h"
 #include "llproxy.h"
 #include "llthrottle.h"
 #include "net.h"
 
+class LLPacketReceiveThread;
+
 class LLPacketRing
 {
 public:
@@ -60,6 +65,29 @@ class LLPacketRing
 
 	S32 getAndResetActualInBits()				{ S32 bits = mActualBitsIn; mActualBitsIn = 0; return bits;}
 	S32 getAndResetActualOutBits()				{ S32 bits = mActualBitsOut; mActualBitsOut = 0; return bits;}
+
+	// Moves socket reads to an LLPacketReceiveThread.  Not available while
+	// the in throttle, packet loss simulation or a SOCKS proxy is in use,
+	// returns false then.
+	bool startReceiveThread(S32 socket);
+	void stopReceiveThread();
+	bool isReceiveThreadRunning() const		{ return mReceiveThread != nullptr; }
+
+	// Circuits the receive thread acks reliable packets for
+	void addAckCircuit(const LLHost& host, const LLCircuitData::shared_packet_id_t& packet_out_id);
+	void removeAckCircuit(const LLHost& host);
+
+	// True if the receive thread already acked the last packet received
+	bool getLastPacketAcked() const			{ return mLastPacketAcked; }
+
+	// Receive thread totals, 0 when it isn't running
+	U64 getReceiveThreadWaits() const;
+	U64 getSocketDrops() const;
+	U64 getReceiveThreadAcks() const;
+
+	// Mean and worst time packets waited for the main thread since the
+	// last call, in microseconds
+	void getAndResetQueueLatency(U64& mean_usec, U64& max_usec);
 protected:
 	BOOL mUseInThrottle;
 	BOOL mUseOutThrottle;
@@ -82,9 +110,17 @@ class LLPacketRing
 
 	LLHost mLastSender;
 	LLHost mLastReceivingIF;
+	bool mLastPacketAcked;
+
+	std::unique_ptr<LLPacketReceiveThread> mReceiveThread;
+	std::map<LLHost, LLCircuitData::shared_packet_id_t> mAckCircuits;
+	U64 mQueueLatencyUsec;
+	U64 mQueueLatencyMaxUsec;
+	U32 mQueuedPackets;
 
 private:
 	BOOL sendPacketImpl(int h_socket, const char * send_buffer, S32 buf_size, const LLHost& host);
+	S32 receiveFromThread(char *datap);
 };
 
 
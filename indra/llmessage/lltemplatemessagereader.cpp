@@ -532,6 +532,50 @@ void LLTemplateMessageReader::logRanOffEndOfPacket( const LLHost& host, const S3
 	gMessageSystem->callExceptionFunc(MX_RAN_OFF_END_OF_PACKET);
 }
 
+S32 LLTemplateMessageReader::getBlockSize(const LLMessageBlock* block, const U8* buffer, S32 decode_pos) const
+{
+	if (block->mTotalSize != -1)
+	{
+		// fixed size, the template already knows
+		return (decode_pos + block->mTotalSize <= mReceiveSize) ? block->mTotalSize : -1;
+	}
+
+	S32 pos = decode_pos;
+	for (const LLMessageVariable* var : block->mMemberVariables)
+	{
+		const S32 var_size = var->getSize();
+		if (pos + var_size > mReceiveSize)
+		{
+			return -1;
+		}
+		if (var->getType() == MVT_VARIABLE)
+		{
+			U32 length = 0;
+			switch (var_size)
+			{
+			case 1:
+				length = buffer[pos];
+				break;
+			case 2:
+				length = buffer[pos] | (buffer[pos + 1] << 8);
+				break;
+			case 4:
+				memcpy(&length, &buffer[pos], 4);
+				break;
+			default:
+				return -1;
+			}
+			if (length > (U32)(mReceiveSize - pos - var_size))
+			{
+				return -1;
+			}
+			pos += length;
+		}
+		pos += var_size;
+	}
+	return pos - decode_pos;
+}
+
 // decode a given message
 BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender, bool custom )
 {
@@ -618,6 +662,19 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender,
 			// add the block to the message
 			mCurrentRMessageData->addBlock(cur_data_block);
 
+#ifdef LL_LITTLE_ENDIAN
+			// A block that is all there is copied once, with its variables
+			// pointing into the copy.  Anything else goes variable by
+			// variable so that what is missing reads as zero.
+			const S32 block_size = getBlockSize(mbci, buffer, decode_pos);
+			if (block_size != -1)
+			{
+				cur_data_block->addBlockData(*mbci, &buffer[decode_pos], block_size);
+				decode_pos += block_size;
+				continue;
+			}
+#endif
+
 			// now read the variables
 			for (LLMessageBlock::message_variable_map_t::const_iterator iter = 
 					 mbci->mMemberVariables.begin();
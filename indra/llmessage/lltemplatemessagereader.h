@@ -29,6 +29,7 @@
 
 #include "llmessagereader.h"
 
+class LLMessageBlock;
 class LLMessageTemplate;
 class LLMsgData;
 
@@ -117,6 +118,9 @@ class LLTemplateMessageReader : public LLMessageReader
 
 	void logRanOffEndOfPacket( const LLHost& host, const S32 where, const S32 wanted );
 
+	// Size of the block starting at decode_pos, or -1 if it doesn't fit in the packet
+	S32 getBlockSize(const LLMessageBlock* block, const U8* buffer, S32 decode_pos) const;
+
 	S32	mReceiveSize;
 	LLMessageTemplate* mCurrentRMessageTemplate;
 	LLMsgData* mCurrentRMessageData;
@@ -0,0 +1,117 @@
+/**
+ * @file llzerocode.cpp
+ * @brief Expansion of zero coded message bodies.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llzerocode.h"
+
+#include <immintrin.h>
+
+#if LL_MSVC
+#include <intrin.h>
+#endif
+
+namespace
+{
+	inline U32 lowest_set_bit(U32 mask)
+	{
+#if LL_MSVC
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return index;
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+
+	// Start of the next zero byte in [in, end), or end
+	inline const U8* find_zero(const U8* in, const U8* end)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		while (end - in >= 16)
+		{
+			const __m128i bytes = _mm_loadu_si128((const __m128i*)in);
+			const U32 mask = (U32)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, zero));
+			if (mask)
+			{
+				return in + lowest_set_bit(mask);
+			}
+			in += 16;
+		}
+		while (in < end && *in)
+		{
+			++in;
+		}
+		return in;
+	}
+}
+
+S32 ll_zero_code_expand(const U8* in, S32 in_size, U8* out, S32 out_size)
+{
+	const U8* in_end = in + in_size;
+	U8* const out_start = out;
+	U8* const out_end = out + out_size;
+
+	while (in < in_end)
+	{
+		const U8* zero = find_zero(in, in_end);
+		const size_t literal = zero - in;
+		if (literal > (size_t)(out_end - out))
+		{
+			return -1;
+		}
+		memcpy(out, in, literal);
+		out += literal;
+		in = zero;
+		if (in == in_end)
+		{
+			break;
+		}
+
+		// a zero, any number of wrap bytes and the length of the run,
+		// which may have been cut off by the end of the packet
+		size_t zeroes = 1;
+		++in;
+		while (in < in_end && !*in)
+		{
+			zeroes += 256;
+			++in;
+		}
+		if (in < in_end)
+		{
+			zeroes += *in - 1;
+			++in;
+		}
+
+		if (zeroes > (size_t)(out_end - out))
+		{
+			return -1;
+		}
+		memset(out, 0, zeroes);
+		out += zeroes;
+	}
+
+	return (S32)(out - out_start);
+}
@@ -0,0 +1,39 @@
+/**
+ * @file llzerocode.h
+ * @brief Expansion of zero coded message bodies.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLZEROCODE_H
+#define LL_LLZEROCODE_H
+
+// Expands a zero coded message body, everything after the packet header.
+// A zero byte is followed by the length of the run of zeroes it starts;
+// every further zero byte in front of the length adds 256 more.
+//
+// Literal runs are found sixteen bytes at a time, so the cost follows
+// the number of zero runs rather than the number of bytes.
+//
+// Returns the expanded size, or -1 if it would not fit in out_size.
+S32 ll_zero_code_expand(const U8* in, S32 in_size, U8* out, S32 out_size);
+
+#endif // LL_LLZEROCODE_H
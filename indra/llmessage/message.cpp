@@ -82,6 +82,7 @@
 #include "llrand.h"
 #include "llmessagelog.h"
 #include "llpounceable.h"
+#include "llzerocode.h"
 
 // Constants
 //const char* MESSAGE_LOG_FILENAME = "message.log";
@@ -326,6 +327,8 @@ LLMessageSystem::~LLMessageSystem()
 	std::for_each(mMessageNumbers.begin(), mMessageNumbers.end(), DeletePairedPointer());
 	mMessageNumbers.clear();
 	
+	// the receive thread reads from the socket until it stops
+	mPacketRing.stopReceiveThread();
 	if (!mbError)
 	{
 		end_net(mSocket);
@@ -510,6 +513,7 @@ BOOL LLMessageSystem::checkMessages(LockMessageChecker&, S64 frame_count,
 		
 		BOOL recv_reliable = FALSE;
 		BOOL recv_resent = FALSE;
+		bool recv_acked = false;	// acked by the packet ring's receive thread
 		S32 acks = 0;
 		S32 true_rcv_size = 0;
 
@@ -523,6 +527,7 @@ BOOL LLMessageSystem::checkMessages(LockMessageChecker&, S64 frame_count,
 			receive_size = mTrueReceiveSize;
 			mLastSender = mPacketRing.getLastSender();
 			mLastReceivingIF = mPacketRing.getLastReceivingInterface();
+			recv_acked = mPacketRing.getLastPacketAcked();
 		} else {
 			buffer = fake_buffer; //true my ass.
 			mTrueReceiveSize = fake_size;
@@ -581,6 +586,13 @@ BOOL LLMessageSystem::checkMessages(LockMessageChecker&, S64 frame_count,
 
 			// process the message as normal
 			mIncomingCompressedSize = zeroCodeExpand(&buffer, &receive_size);
+			if (mIncomingCompressedSize < 0)
+			{
+				// expands past the receive buffer, already reported
+				mIncomingCompressedSize = 0;
+				valid_packet = FALSE;
+				continue;
+			}
 			U32 cur_rec_pkt_id = 0U;
 			memcpy(&cur_rec_pkt_id, buffer + PHL_PACKET_ID, sizeof(cur_rec_pkt_id));
 			mCurrentRecvPacketID = ntohl(cur_rec_pkt_id);
@@ -625,7 +637,7 @@ BOOL LLMessageSystem::checkMessages(LockMessageChecker&, S64 frame_count,
 					// We need to ACK here to suppress
 					// further resends of packets we've
 					// already seen.
-					if (recv_reliable)
+					if (recv_reliable && !recv_acked)
 					{
 						//mAckList.addData(new LLPacketAck(host, mCurrentRecvPacketID));
 						// ***************************************
@@ -725,7 +737,10 @@ BOOL LLMessageSystem::checkMessages(LockMessageChecker&, S64 frame_count,
 					cdp->mRecentlyReceivedReliablePackets[mCurrentRecvPacketID] = getMessageTimeUsecs();
 
 					// Put it onto the list of packets to be acked
-					cdp->collectRAck(mCurrentRecvPacketID);
+					if (!recv_acked)
+					{
+						cdp->collectRAck(mCurrentRecvPacketID);
+					}
 					mReliablePacketsIn++;
 				}
 			}
@@ -1200,11 +1215,12 @@ S32 LLMessageSystem::sendMessage(const LLHost &host)
 	// not overwrite the offset if it was set set in buildMessage().
 	memset(mSendBuffer, 0, LL_PACKET_ID_SIZE - 1); 
 
-	// add the send id to the front of the message
-	cdp->nextPacketOutID();
+	// add the send id to the front of the message.  Use the one we were
+	// given, the receive thread may already have taken the next for an ack.
+	TPACKETID out_id = cdp->nextPacketOutID();
 
 	// Packet ID size is always 4
-	U32 packet_out_id = static_cast<U32>(htonl(cdp->getPacketOutID()));
+	U32 packet_out_id = static_cast<U32>(htonl(out_id));
 	memcpy(mSendBuffer + PHL_PACKET_ID, &packet_out_id, sizeof(packet_out_id));
 
 	// Compress the message, which will usually reduce its size.
@@ -2897,72 +2913,19 @@ S32 LLMessageSystem::zeroCodeExpand(U8** data, S32* data_size)
 	
 	*data[0] &= (~LL_ZERO_CODE_FLAG);
 
-	S32 count = (*data_size);  
-	
-	U8 *inptr = (U8 *)*data;
-	U8 *outptr = (U8 *)mEncodedRecvBuffer;
-
-// skip the packet id field
-
-	for (U32 ii = 0; ii < LL_PACKET_ID_SIZE; ++ii)
+	// the packet id field isn't coded
+	memcpy(mEncodedRecvBuffer, *data, LL_PACKET_ID_SIZE);
+	S32 body_size = ll_zero_code_expand(*data + LL_PACKET_ID_SIZE, in_size - LL_PACKET_ID_SIZE,
+										mEncodedRecvBuffer + LL_PACKET_ID_SIZE, MAX_BUFFER_SIZE - LL_PACKET_ID_SIZE);
+	if (body_size < 0)
 	{
-		count--;
-		*outptr++ = *inptr++;
+		LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size" << LL_ENDL;
+		callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
+		return -1;
 	}
 
-// reconstruct encoded packet, keeping track of net size gain
-
-// sequential zero bytes are encoded as 0 [U8 count] 
-// with 0 0 [count] representing wrap (>256 zeroes)
-
-	while (count--)
-	{
-		if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-1]))
-		{
-			LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 1" << LL_ENDL;
-			callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-			outptr = mEncodedRecvBuffer;					
-			break;
-		}
-		if (!((*outptr++ = *inptr++)))
-		{
-			while (((count--)) && (!(*inptr)))
-			{
-				*outptr++ = *inptr++;
-  				if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-256]))
-  				{
-  					LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 2" << LL_ENDL;
-					callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-					outptr = mEncodedRecvBuffer;
-					count = -1;
-					break;
-  				}
-				memset(outptr,0,255);
-				outptr += 255;
-			}
-			
-			if (count < 0)
-			{
-				break;
-			}
-
-			else
-			{
-  				if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-(*inptr)]))
-				{
-  					LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 3" << LL_ENDL;
-					callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-					outptr = mEncodedRecvBuffer;					
-				}
-				memset(outptr,0,(*inptr) - 1);
-				outptr += ((*inptr) - 1);
-				inptr++;
-			}
-		}		
-	}
-	
 	*data = mEncodedRecvBuffer;
-	*data_size = (S32)(outptr - mEncodedRecvBuffer);
+	*data_size = LL_PACKET_ID_SIZE + body_size;
 	mUncompressedBytesIn += *data_size;
 
 	return(in_size);
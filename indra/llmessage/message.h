@@ -545,6 +545,8 @@ class LLMessageSystem : public LLMessageSenderInterface
 	//void	buildMessage();
 
 	S32     zeroCode(U8 **data, S32 *data_size);
+	// Returns the coded size, 0 if the packet wasn't coded or -1 if it
+	// doesn't fit in the receive buffer once expanded
 	S32		zeroCodeExpand(U8 **data, S32 *data_size);
 	S32		zeroCodeAdjustCurrentSendTotal();
 
@@ -0,0 +1,177 @@
+/**
+ * @file llpacketreceivethread_test.cpp
+ * @brief LLPacketReceiveThread ring tests over a loopback socket.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llpacketreceivethread.h"
+#include "../net.h"
+
+#include "../test/lltut.h"
+#include "lltimer.h"
+
+namespace tut
+{
+	struct packetreceivethread_data
+	{
+		packetreceivethread_data()
+		:	mSocket(0),
+			mPort(NET_USE_OS_ASSIGNED_PORT)
+		{
+			mOpen = start_net(mSocket, mPort) == 0;
+		}
+
+		~packetreceivethread_data()
+		{
+			if (mOpen)
+			{
+				end_net(mSocket);
+			}
+		}
+
+		// Packet n carries n in its first four bytes
+		bool send(U32 n)
+		{
+			char buffer[64];
+			memset(buffer, 0, sizeof(buffer));
+			memcpy(buffer, &n, sizeof(n));
+			return send_packet(mSocket, buffer, sizeof(buffer), ip_string_to_u32("127.0.0.1"), mPort);
+		}
+
+		static U32 number(const LLPacketReceiveThread::Packet* packet)
+		{
+			U32 n;
+			memcpy(&n, packet->mData, sizeof(n));
+			return n;
+		}
+
+		// The oldest queued packet, waiting up to a few seconds for one
+		static const LLPacketReceiveThread::Packet* waitFront(LLPacketReceiveThread& thread)
+		{
+			for (S32 i = 0; i < 5000; ++i)
+			{
+				if (const LLPacketReceiveThread::Packet* packet = thread.front())
+				{
+					return packet;
+				}
+				ms_sleep(1);
+			}
+			return nullptr;
+		}
+
+		S32 mSocket;
+		int mPort;
+		bool mOpen;
+	};
+	typedef test_group<packetreceivethread_data> packetreceivethread_test;
+	typedef packetreceivethread_test::object packetreceivethread_object;
+	tut::packetreceivethread_test packetreceivethread_testcase("LLPacketReceiveThread");
+
+	template<> template<>
+	void packetreceivethread_object::test<1>()
+	{
+		set_test_name("packets come out in order across the ring wraparound");
+		if (!mOpen)
+		{
+			skip("no loopback socket");
+		}
+
+		// Rounded up to 4 slots, the packets go round several times
+		LLPacketReceiveThread thread(mSocket, 3);
+		thread.start();
+
+		const U32 count = 50;
+		U32 sent = 0;
+		for (U32 n = 0; n < count; ++n)
+		{
+			// Keep a couple in flight so the producer and the consumer run
+			// at the same time
+			ensure("packet sent", send(n));
+			if (n < 2)
+			{
+				continue;
+			}
+
+			const LLPacketReceiveThread::Packet* packet = waitFront(thread);
+			ensure("packet received", packet != nullptr);
+			ensure_equals("received in order", number(packet), sent);
+			ensure_equals("packet size", packet->mSize, 64);
+			thread.pop();
+			++sent;
+		}
+		while (sent < count)
+		{
+			const LLPacketReceiveThread::Packet* packet = waitFront(thread);
+			ensure("tail packet received", packet != nullptr);
+			ensure_equals("tail received in order", number(packet), sent);
+			thread.pop();
+			++sent;
+		}
+
+		ensure("nothing left", thread.front() == nullptr);
+		thread.pop();
+		ensure("pop on an empty ring is harmless", thread.front() == nullptr);
+
+		thread.shutdown();
+	}
+
+	template<> template<>
+	void packetreceivethread_object::test<2>()
+	{
+		set_test_name("a full ring leaves packets in the socket");
+		if (!mOpen)
+		{
+			skip("no loopback socket");
+		}
+
+		LLPacketReceiveThread thread(mSocket, 4);
+		thread.start();
+
+		// Three times the pool without consuming anything
+		const U32 count = 12;
+		for (U32 n = 0; n < count; ++n)
+		{
+			ensure("packet sent", send(n));
+		}
+
+		for (S32 i = 0; i < 5000 && !thread.getPoolFullWaits(); ++i)
+		{
+			ms_sleep(1);
+		}
+		ensure("producer waited on the full ring", thread.getPoolFullWaits() > 0);
+
+		// Every packet arrives once the consumer catches up, none were
+		// read and thrown away while the ring was full
+		for (U32 n = 0; n < count; ++n)
+		{
+			const LLPacketReceiveThread::Packet* packet = waitFront(thread);
+			ensure("packet received after the stall", packet != nullptr);
+			ensure_equals("received in order after the stall", number(packet), n);
+			thread.pop();
+		}
+		ensure("nothing left", thread.front() == nullptr);
+
+		thread.shutdown();
+	}
+}
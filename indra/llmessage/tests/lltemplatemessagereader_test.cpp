@@ -0,0 +1,490 @@
+/**
+ * @file lltemplatemessagereader_test.cpp
+ * @brief Zero code expansion and template message decoding.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../lltemplatemessagereader.h"
+#include "../llzerocode.h"
+
+#include "llfile.h"
+#include "llhost.h"
+#include "llmessagetemplate.h"
+#include "llmessagetemplateparser.h"
+#include "llstring.h"
+#include "lltimer.h"
+#include "lluuid.h"
+#include "message.h"
+#include "v3math.h"
+
+#include <iostream>
+#include <random>
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// The byte at a time expansion LLMessageSystem::zeroCodeExpand() used to do
+	S32 reference_expand(const U8* in, S32 in_size, U8* out, S32 out_size)
+	{
+		S32 count = in_size;
+		const U8* inptr = in;
+		U8* outptr = out;
+		while (count--)
+		{
+			if (outptr > out + out_size - 1)
+			{
+				return -1;
+			}
+			if (!((*outptr++ = *inptr++)))
+			{
+				while ((count--) && (!(*inptr)))
+				{
+					if (outptr + 256 > out + out_size)
+					{
+						return -1;
+					}
+					*outptr++ = *inptr++;
+					memset(outptr, 0, 255);
+					outptr += 255;
+				}
+				if (count < 0)
+				{
+					break;
+				}
+				if (outptr + (*inptr) - 1 > out + out_size)
+				{
+					return -1;
+				}
+				memset(outptr, 0, (*inptr) - 1);
+				outptr += ((*inptr) - 1);
+				inptr++;
+			}
+		}
+		return (S32)(outptr - out);
+	}
+
+	// Zero codes a message body the way LLTemplateMessageBuilder does
+	std::vector<U8> zero_code(const std::vector<U8>& body)
+	{
+		std::vector<U8> out;
+		U8 num_zeroes = 0;
+		for (U8 byte : body)
+		{
+			if (!byte)
+			{
+				if (num_zeroes)
+				{
+					if (++num_zeroes > 254)
+					{
+						out.push_back(num_zeroes);
+						num_zeroes = 0;
+					}
+				}
+				else
+				{
+					out.push_back(0);
+					num_zeroes = 1;
+				}
+			}
+			else
+			{
+				if (num_zeroes)
+				{
+					out.push_back(num_zeroes);
+					num_zeroes = 0;
+				}
+				out.push_back(byte);
+			}
+		}
+		if (num_zeroes)
+		{
+			out.push_back(num_zeroes);
+		}
+		return out;
+	}
+
+	// Message bodies with zero runs of every length, the odd long one
+	// and literal runs on both sides of the sixteen byte scan
+	std::vector<U8> random_body(std::mt19937& rng, S32 size)
+	{
+		std::vector<U8> body;
+		while ((S32)body.size() < size)
+		{
+			S32 literal = rng() % 40;
+			for (S32 i = 0; i < literal; ++i)
+			{
+				body.push_back(1 + rng() % 255);
+			}
+			S32 zeroes = (rng() % 8) ? rng() % 20 : rng() % 700;
+			body.insert(body.end(), zeroes, 0);
+		}
+		body.resize(size);
+		return body;
+	}
+
+	const char* TEST_TEMPLATE =
+		"version 2.0\n"
+		"{\n"
+		"	TestObjectUpdate High 1 NotTrusted Zerocoded\n"
+		"	{\n"
+		"		RegionData Single\n"
+		"		{ RegionHandle U64 }\n"
+		"		{ TimeDilation U16 }\n"
+		"	}\n"
+		"	{\n"
+		"		ObjectData Variable\n"
+		"		{ ID U32 }\n"
+		"		{ FullID LLUUID }\n"
+		"		{ Scale LLVector3 }\n"
+		"		{ TextureEntry Variable 2 }\n"
+		"		{ Text Variable 1 }\n"
+		"		{ TextColor Fixed 4 }\n"
+		"	}\n"
+		"}\n";
+
+	void push(std::vector<U8>& out, const void* data, size_t size)
+	{
+		out.insert(out.end(), (const U8*)data, (const U8*)data + size);
+	}
+
+	LLUUID object_id(U32 i)
+	{
+		LLUUID id;
+		memcpy(id.mData, &i, sizeof(i));
+		id.mData[15] = 0x42;
+		return id;
+	}
+
+	// An unencoded TestObjectUpdate packet
+	std::vector<U8> make_update(U32 first_id, U32 objects, bool with_text)
+	{
+		std::vector<U8> packet(LL_PACKET_ID_SIZE, 0);
+		packet.push_back(1);	// message number
+
+		U64 handle = 0x0003e80000003e80ULL;
+		U16 dilation = 65535;
+		push(packet, &handle, sizeof(handle));
+		push(packet, &dilation, sizeof(dilation));
+
+		packet.push_back((U8)objects);
+		for (U32 i = first_id; i < first_id + objects; ++i)
+		{
+			push(packet, &i, sizeof(i));
+			push(packet, object_id(i).mData, UUID_BYTES);
+			LLVector3 scale(0.5f + i, 1.f, 2.f);
+			push(packet, scale.mV, sizeof(scale.mV));
+			// a texture entry is mostly zeroes
+			U16 te_size = 48;
+			push(packet, &te_size, sizeof(te_size));
+			packet.insert(packet.end(), te_size, 0);
+			packet[packet.size() - te_size] = (U8)i;
+			std::string text = with_text ? llformat("object %u", i) : std::string();
+			packet.push_back((U8)text.size());
+			push(packet, text.data(), text.size());
+			U32 color = 0xff8000ff;
+			push(packet, &color, sizeof(color));
+		}
+		return packet;
+	}
+
+	struct TemplateSet
+	{
+		TemplateSet(const std::string& body)
+		{
+			LLTemplateTokenizer tokens(body);
+			LLTemplateParser parsed(tokens);
+			for (auto it = parsed.getMessagesBegin(); it != parsed.getMessagesEnd(); ++it)
+			{
+				mNumbers[(*it)->mMessageNumber] = *it;
+			}
+		}
+
+		~TemplateSet()
+		{
+			for (auto& entry : mNumbers)
+			{
+				delete entry.second;
+			}
+		}
+
+		LLTemplateMessageReader::message_template_number_map_t mNumbers;
+	};
+
+	const char* name(const char* str)
+	{
+		return LLMessageStringTable::getInstance()->getString(str);
+	}
+
+	// Expands packet in place the way LLMessageSystem::checkMessages() does
+	bool expand(std::vector<U8>& packet)
+	{
+		if (!(packet[0] & LL_ZERO_CODE_FLAG))
+		{
+			return true;
+		}
+		std::vector<U8> out(MAX_BUFFER_SIZE);
+		memcpy(out.data(), packet.data(), LL_PACKET_ID_SIZE);
+		out[0] &= ~LL_ZERO_CODE_FLAG;
+		S32 size = ll_zero_code_expand(packet.data() + LL_PACKET_ID_SIZE, (S32)packet.size() - LL_PACKET_ID_SIZE,
+									   out.data() + LL_PACKET_ID_SIZE, MAX_BUFFER_SIZE - LL_PACKET_ID_SIZE);
+		if (size < 0)
+		{
+			return false;
+		}
+		out.resize(LL_PACKET_ID_SIZE + size);
+		packet.swap(out);
+		return true;
+	}
+
+	// Packets as the socket handed them over, each one a little endian U16
+	// size followed by the bytes, with any appended acks still attached
+	std::vector<std::vector<U8>> read_packet_dump(const std::string& filename)
+	{
+		std::vector<std::vector<U8>> packets;
+		llifstream file(filename.c_str(), std::ios::binary);
+		U8 size_bytes[2];
+		while (file.read((char*)size_bytes, 2))
+		{
+			std::vector<U8> packet(size_bytes[0] | (size_bytes[1] << 8));
+			if (!file.read((char*)packet.data(), packet.size()))
+			{
+				break;
+			}
+			if (packet.size() > LL_MINIMUM_VALID_PACKET_SIZE && (packet[0] & LL_ACK_FLAG))
+			{
+				size_t acks = packet.back() * sizeof(TPACKETID) + 1;
+				if (acks >= packet.size() - LL_MINIMUM_VALID_PACKET_SIZE)
+				{
+					continue;
+				}
+				packet.resize(packet.size() - acks);
+			}
+			if (packet.size() >= LL_MINIMUM_VALID_PACKET_SIZE)
+			{
+				packets.push_back(packet);
+			}
+		}
+		return packets;
+	}
+}
+
+namespace tut
+{
+	struct template_reader_data
+	{
+	};
+	typedef test_group<template_reader_data> template_reader_test;
+	typedef template_reader_test::object template_reader_object;
+	tut::template_reader_test ttemplate_reader("LLTemplateMessageReader");
+
+	template<> template<>
+	void template_reader_object::test<1>()
+	{
+		set_test_name("zero code expansion matches the byte loop");
+		std::mt19937 rng(1234);
+		std::vector<U8> expected(MAX_BUFFER_SIZE), actual(MAX_BUFFER_SIZE);
+		for (S32 i = 0; i < 2000; ++i)
+		{
+			std::vector<U8> coded = zero_code(random_body(rng, rng() % 1400));
+			S32 expected_size = reference_expand(coded.data(), (S32)coded.size(), expected.data(), MAX_BUFFER_SIZE);
+			S32 actual_size = ll_zero_code_expand(coded.data(), (S32)coded.size(), actual.data(), MAX_BUFFER_SIZE);
+			ensure_equals("size", actual_size, expected_size);
+			ensure("bytes", memcmp(actual.data(), expected.data(), expected_size) == 0);
+		}
+
+		// wrap bytes, a run cut off by the end of the packet and a lone zero
+		const std::vector<std::vector<U8>> odd_cases = {
+			{ 7, 0, 0, 3, 9 },
+			{ 7, 0, 0, 0, 1 },
+			{ 7, 0 },
+			{ 7, 0, 0 },
+			{ 0 },
+			{},
+		};
+		for (const std::vector<U8>& coded : odd_cases)
+		{
+			S32 expected_size = reference_expand(coded.data(), (S32)coded.size(), expected.data(), MAX_BUFFER_SIZE);
+			S32 actual_size = ll_zero_code_expand(coded.data(), (S32)coded.size(), actual.data(), MAX_BUFFER_SIZE);
+			ensure_equals("odd case size", actual_size, expected_size);
+			ensure("odd case bytes", memcmp(actual.data(), expected.data(), expected_size) == 0);
+		}
+	}
+
+	template<> template<>
+	void template_reader_object::test<2>()
+	{
+		set_test_name("zero code expansion stops at the end of the buffer");
+		std::vector<U8> out(64, 0xCD);
+		const std::vector<U8> zeroes = { 0, 0, 0, 0, 200 };
+		ensure_equals("zero run", ll_zero_code_expand(zeroes.data(), (S32)zeroes.size(), out.data(), 32), -1);
+
+		std::vector<U8> literal(40, 1);
+		ensure_equals("literal run", ll_zero_code_expand(literal.data(), (S32)literal.size(), out.data(), 32), -1);
+		ensure("nothing written past the end", out[32] == 0xCD);
+
+		ensure_equals("exact fit", ll_zero_code_expand(literal.data(), 32, out.data(), 32), 32);
+	}
+
+	template<> template<>
+	void template_reader_object::test<3>()
+	{
+		set_test_name("decode reads whole and cut off blocks");
+		TemplateSet templates(TEST_TEMPLATE);
+		LLTemplateMessageReader reader(templates.mNumbers);
+		LLMessageReader& msg = reader;
+		LLHost host;
+
+		std::vector<U8> packet = make_update(10, 3, true);
+		reader.clearMessage();
+		ensure("validate", reader.validateMessage(packet.data(), (S32)packet.size(), host, false, true));
+		ensure("decode", reader.decodeData(packet.data(), host, true));
+
+		U64 handle = 0;
+		msg.getU64(name("RegionData"), name("RegionHandle"), handle);
+		ensure_equals("region handle", handle, 0x0003e80000003e80ULL);
+		ensure_equals("blocks", msg.getNumberOfBlocks(name("ObjectData")), 3);
+		for (S32 i = 0; i < 3; ++i)
+		{
+			U32 id = 0;
+			LLUUID full_id;
+			LLVector3 scale;
+			std::string text;
+			U8 te[48];
+			U32 color = 0;
+			msg.getU32(name("ObjectData"), name("ID"), id, i);
+			msg.getUUID(name("ObjectData"), name("FullID"), full_id, i);
+			msg.getVector3(name("ObjectData"), name("Scale"), scale, i);
+			msg.getString(name("ObjectData"), name("Text"), text, i);
+			msg.getBinaryData(name("ObjectData"), name("TextureEntry"), te, 0, i, sizeof(te));
+			msg.getU32(name("ObjectData"), name("TextColor"), color, i);
+			ensure_equals("id", id, (U32)(10 + i));
+			ensure_equals("full id", full_id, object_id(10 + i));
+			ensure_equals("scale", scale.mV[VX], 10.5f + i);
+			ensure_equals("text", text, llformat("object %d", 10 + i));
+			ensure_equals("texture entry size", msg.getSize(name("ObjectData"), i, name("TextureEntry")), 48);
+			ensure_equals("texture entry", te[0], (U8)(10 + i));
+			ensure_equals("text color", color, 0xff8000ffU);
+		}
+
+		// the last object loses its text color, which reads as zero
+		packet.resize(packet.size() - 2);
+		reader.clearMessage();
+		ensure("validate cut off", reader.validateMessage(packet.data(), (S32)packet.size(), host, false, true));
+		ensure("decode cut off", reader.decodeData(packet.data(), host, true));
+		U32 id = 0, color = 1;
+		msg.getU32(name("ObjectData"), name("ID"), id, 2);
+		msg.getU32(name("ObjectData"), name("TextColor"), color, 2);
+		ensure_equals("cut off id", id, 12U);
+		ensure_equals("cut off text color", color, 0U);
+		msg.getU32(name("ObjectData"), name("TextColor"), color, 1);
+		ensure_equals("whole text color", color, 0xff8000ffU);
+		reader.clearMessage();
+	}
+
+	template<> template<>
+	void template_reader_object::test<4>()
+	{
+		set_test_name("packet replay");
+		if (LLStringUtil::getenv("LL_MESSAGE_BENCH").empty())
+		{
+			skip("set LL_MESSAGE_BENCH to run");
+		}
+
+		// A capture (see read_packet_dump()) with the template it was
+		// sent with, or an object update flood made up on the spot
+		std::string template_body(TEST_TEMPLATE);
+		std::vector<std::vector<U8>> packets;
+		const std::string dump = LLStringUtil::getenv("LL_PACKET_DUMP");
+		if (!dump.empty())
+		{
+			llifstream file(LLStringUtil::getenv("LL_MESSAGE_TEMPLATE").c_str(), std::ios::binary);
+			std::stringstream body;
+			body << file.rdbuf();
+			template_body = body.str();
+			ensure("LL_MESSAGE_TEMPLATE", !template_body.empty());
+			packets = read_packet_dump(dump);
+			ensure("LL_PACKET_DUMP", !packets.empty());
+		}
+		else
+		{
+			for (U32 i = 0; i < 5000; ++i)
+			{
+				std::vector<U8> update = make_update(i * 8, 8, i % 4 == 0);
+				std::vector<U8> packet(update.begin(), update.begin() + LL_PACKET_ID_SIZE);
+				std::vector<U8> coded = zero_code(std::vector<U8>(update.begin() + LL_PACKET_ID_SIZE, update.end()));
+				packet.insert(packet.end(), coded.begin(), coded.end());
+				packet[0] |= LL_ZERO_CODE_FLAG;
+				packets.push_back(packet);
+			}
+		}
+
+		std::vector<U8> out(MAX_BUFFER_SIZE);
+		size_t bytes = 0;
+		LLTimer timer;
+		for (const std::vector<U8>& packet : packets)
+		{
+			bytes += reference_expand(packet.data() + LL_PACKET_ID_SIZE, (S32)packet.size() - LL_PACKET_ID_SIZE,
+									  out.data(), MAX_BUFFER_SIZE);
+		}
+		F64 reference_seconds = timer.getElapsedTimeF64();
+
+		timer.reset();
+		for (const std::vector<U8>& packet : packets)
+		{
+			ll_zero_code_expand(packet.data() + LL_PACKET_ID_SIZE, (S32)packet.size() - LL_PACKET_ID_SIZE,
+								out.data(), MAX_BUFFER_SIZE);
+		}
+		F64 expand_seconds = timer.getElapsedTimeF64();
+
+		std::vector<std::vector<U8>> expanded(packets);
+		for (std::vector<U8>& packet : expanded)
+		{
+			expand(packet);
+		}
+
+		TemplateSet templates(template_body);
+		LLTemplateMessageReader reader(templates.mNumbers);
+		LLHost host;
+		U32 decoded = 0;
+		timer.reset();
+		for (const std::vector<U8>& packet : expanded)
+		{
+			reader.clearMessage();
+			if (reader.validateMessage(packet.data(), (S32)packet.size(), host, true, true)
+				&& reader.decodeData(packet.data(), host, true))
+			{
+				++decoded;
+			}
+		}
+		F64 decode_seconds = timer.getElapsedTimeF64();
+		reader.clearMessage();
+
+		const F64 to_ns = 1.0e9 / packets.size();
+		std::cout << "\n" << packets.size() << " packets, " << bytes / 1024 << " KB expanded, " << decoded << " decoded\n"
+				  << "zero code expand: byte loop " << reference_seconds * to_ns << " ns, scan "
+				  << expand_seconds * to_ns << " ns per packet\n"
+				  << "template decode: " << decode_seconds * to_ns << " ns per packet" << std::endl;
+	}
+}
@@ -1438,6 +1438,7 @@ void LLGLManager::initExtensions()
     mHasTransformFeedback = mGLVersion >= 3.99f;
     mHasDebugOutput = mGLVersion >= 4.29f;
     mHasTextureSwizzle = mGLVersion >= 3.29f;
+    mHasBufferStorage = mGLVersion >= 4.39f;
     mHasTextureFilterAnisotropic = mGLVersion >= 4.59f || ExtensionExists("GL_EXT_texture_filter_anisotropic", gGLHExts.mSysExts);
 
     // Misc
@@ -41,6 +41,7 @@
 #include "llrender.h"
 #include "llwindow.h"
 #include "llframetimer.h"
+#include "lltexturestagingqueue.h"
 
 extern LL_COMMON_API bool on_main_thread();
 
@@ -115,6 +116,125 @@ static void free_cur_tex_image()
     free_tex_image(texName);
 }
 
+//============================================================================
+// Staged texture uploads, see LLTextureStagingQueue.  The staging buffers are
+// pixel unpack buffers, each band goes in with glTexSubImage2D() from one.
+// When the last level is in the new name replaces the image's current one.
+
+class LLGLTextureStagingQueue : public LLTextureStagingQueue
+{
+protected:
+    U32 createBuffer(U32 size) override
+    {
+        LLGLuint name = 0;
+        glGenBuffers(1, &name);
+        resizeBuffer(name, size);
+        return name;
+    }
+
+    void resizeBuffer(U32 name, U32 size) override
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, name);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    void deleteBuffer(U32 name) override
+    {
+        glDeleteBuffers(1, &name);
+    }
+
+    bool isFenceSignaled(void* fence) override
+    {
+        const GLenum status = glClientWaitSync((GLsync)fence, 0, 0);
+        return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+    }
+
+    void deleteFence(void* fence) override
+    {
+        glDeleteSync((GLsync)fence);
+    }
+
+    void* sendBand(const Upload& upload, U32 buffer, const U8* data, S32 rows, U32 bytes) override
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        U8* dst = (U8*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (!dst)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            return nullptr;
+        }
+        memcpy(dst, data, bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+        LLImageGL* image = getImage(upload);
+        gGL.getTexUnit(0)->bind(image, false, false, upload.mTexName);
+        glTexSubImage2D(GL_TEXTURE_2D, upload.mLevel, 0, upload.mNextRow, upload.mWidth, rows,
+                        image->mFormatPrimary, image->mFormatType, nullptr);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        gGL.getTexUnit(0)->unbind(LLTexUnit::TT_TEXTURE);
+        return glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    void allocateLevel(const Upload& upload) override
+    {
+        // not counted in sTextureBytes, as glGenerateMipmap()'s levels aren't
+        LLImageGL* image = getImage(upload);
+        gGL.getTexUnit(0)->bind(image, false, false, upload.mTexName);
+        glTexImage2D(GL_TEXTURE_2D, upload.mLevel, image->mFormatInternal, upload.mWidth, upload.mHeight, 0,
+                     image->mFormatPrimary, image->mFormatType, nullptr);
+        gGL.getTexUnit(0)->unbind(LLTexUnit::TT_TEXTURE);
+    }
+
+    void finish(const Upload& upload) override
+    {
+        LLImageGL* image = getImage(upload);
+        image->mStagedUpload = false;
+        if (!image->swapTexName(upload.mTexName, image->mStagedGeneration))
+        {
+            return;
+        }
+
+        // the image's size is that of the texture in use, not of one on its way
+        image->mCurrentDiscardLevel = image->mStagedDiscardLevel;
+        image->mTextureMemory = (S64Bytes)image->getMipBytes(image->mCurrentDiscardLevel);
+        image->mTexelsInGLTexture = image->getWidth() * image->getHeight();
+        if (image->mHasMipMaps)
+        {
+            if (upload.mLevels > 1)
+            {
+                // built here like setImage() builds them by hand
+                image->mMipLevels = upload.mLevels;
+            }
+            else
+            {
+                gGL.getTexUnit(0)->bind(image, false, false, upload.mTexName);
+                LL_PROFILE_GPU_ZONE("generate mip map");
+                glGenerateMipmap(GL_TEXTURE_2D);
+                gGL.getTexUnit(0)->unbind(LLTexUnit::TT_TEXTURE);
+                image->mMipLevels = wpo2(llmax(upload.mWidth, upload.mHeight));
+            }
+        }
+    }
+
+    void discard(const Upload& upload) override
+    {
+        // cleared first, erasing the upload may destroy the image
+        getImage(upload)->mStagedUpload = false;
+        LLGLuint tex_name = upload.mTexName;
+        LLImageGL::deleteTextures(1, &tex_name);
+    }
+
+private:
+    static LLImageGL* getImage(const Upload& upload)
+    {
+        return static_cast<LLImageGL*>(upload.mImage.get());
+    }
+};
+
+static LLTextureStagingQueue* sStagingQueue = nullptr;
+
 // static 
 U64 LLImageGL::getTextureBytesAllocated()
 {
@@ -131,6 +251,7 @@ F32 LLImageGL::sLastFrameTime			= 0.f;
 BOOL LLImageGL::sAllowReadBackRaw       = FALSE ;
 LLImageGL* LLImageGL::sDefaultGLTexture = NULL ;
 bool LLImageGL::sCompressTextures = false;
+U32 LLImageGL::sStagedUploadBudget = 0;
 std::set<LLImageGL*> LLImageGL::sImageList;
 
 
@@ -256,6 +377,8 @@ void LLImageGL::initClass(LLWindow* window, S32 num_catagories, BOOL skip_analyz
         LLImageGLThread::sEnabledTextures = thread_texture_loads;
         LLImageGLThread::sEnabledMedia = thread_media_updates;
     }
+
+    sStagingQueue = new LLGLTextureStagingQueue();
 }
 
 //static 
@@ -263,6 +386,28 @@ void LLImageGL::cleanupClass()
 {
     LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
     LLImageGLThread::deleteSingleton();
+
+    if (sStagingQueue)
+    {
+        sStagingQueue->cleanup();
+        delete sStagingQueue;
+        sStagingQueue = nullptr;
+    }
+}
+
+//static
+void LLImageGL::updateStagedUploads()
+{
+    if (sStagingQueue)
+    {
+        sStagingQueue->update(sStagedUploadBudget);
+    }
+}
+
+//static
+U32 LLImageGL::getStagedUploadCount()
+{
+    return sStagingQueue ? sStagingQueue->size() : 0;
 }
 
 
@@ -389,6 +534,11 @@ void LLImageGL::destroyGL(BOOL save_state)
 		}
 	}
 	sAllowReadBackRaw = false ;
+
+	if (sStagingQueue)
+	{
+		sStagingQueue->cleanup();
+	}
 }
 
 //static 
@@ -543,6 +693,11 @@ void LLImageGL::init(BOOL usemipmaps)
 	mAlphaOffset = INVALID_OFFSET ;
 
 	mGLTextureCreated = FALSE ;
+	mStagedUpload = false;
+	mStagedDiscardLevel = -1;
+	mStagedGeneration = 0;
+	mSwappedGeneration = 0;
+	mUploadGeneration = 0;
 	mTexName = 0;
 	mWidth = 0;
 	mHeight	= 0;
@@ -1691,6 +1846,16 @@ BOOL LLImageGL::createGLTexture(S32 discard_level, const U8* data_in, BOOL data_
 
     bool main_thread = on_main_thread();
 
+    if (mStagedUpload && main_thread && !defer_copy)
+    {
+        // this upload replaces the one still being staged
+        cancelStagedUpload();
+    }
+
+    // Uploads from other threads land on the main thread later, whichever
+    // texture comes from the latest upload is the one kept
+    const U32 generation = defer_copy ? 0 : ++mUploadGeneration;
+
     if (defer_copy)
     {
         data_in = nullptr;
@@ -1719,6 +1884,7 @@ BOOL LLImageGL::createGLTexture(S32 discard_level, const U8* data_in, BOOL data_
         {
             *tex_name = mTexName;
         }
+        mSwappedGeneration = generation;
         return setImage(data_in, data_hasmips);
     }
 
@@ -1772,7 +1938,7 @@ BOOL LLImageGL::createGLTexture(S32 discard_level, const U8* data_in, BOOL data_
     {
         if (!main_thread)
         {
-            syncToMainThread(new_texname);
+            syncToMainThread(new_texname, generation);
         }
         else
         {
@@ -1782,6 +1948,7 @@ BOOL LLImageGL::createGLTexture(S32 discard_level, const U8* data_in, BOOL data_
                 LLImageGL::deleteTextures(1, &old_texname);
             }
             mTexName = new_texname;
+            mSwappedGeneration = generation;
         }
     }
 
@@ -1796,7 +1963,78 @@ BOOL LLImageGL::createGLTexture(S32 discard_level, const U8* data_in, BOOL data_
     return TRUE;
 }
 
-void LLImageGL::syncToMainThread(LLGLuint new_tex_name)
+BOOL LLImageGL::createGLTextureStaged(S32 discard_level, const LLImageRaw* imageraw, S32 category)
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
+
+    if (!sStagingQueue || !sStagedUploadBudget || !on_main_thread()
+        || !imageraw || imageraw->isBufferInvalid() || !canStageUpload(imageraw))
+    {
+        return createGLTexture(discard_level, imageraw, 0, TRUE, category);
+    }
+
+    if (mStagedUpload)
+    {
+        cancelStagedUpload();
+    }
+
+    // allocates the new texture and leaves mTexName in use until it is
+    // filled, along with the size it is accounted at
+    const S8 current_discard_level = mCurrentDiscardLevel;
+    const S64Bytes texture_memory = mTextureMemory;
+    const U32 texels = mTexelsInGLTexture;
+    LLGLuint tex_name = 0;
+    const BOOL created = createGLTexture(discard_level, imageraw, 0, TRUE, category, true, &tex_name);
+    mStagedDiscardLevel = mCurrentDiscardLevel;
+    mCurrentDiscardLevel = current_discard_level;
+    mTextureMemory = texture_memory;
+    mTexelsInGLTexture = texels;
+    if (!created)
+    {
+        return FALSE;
+    }
+
+    const S32 w = imageraw->getWidth();
+    const S32 h = imageraw->getHeight();
+    analyzeAlpha(imageraw->getData(), w, h);
+    updatePickMask(w, h, imageraw->getData());
+
+    // the mips are built and sent band by band after level 0
+    const S32 levels = mHasMipMaps ? mMaxDiscardLevel - mStagedDiscardLevel + 1 : 1;
+    sStagingQueue->push(this, imageraw, tex_name, levels);
+    mStagedUpload = true;
+    mStagedGeneration = ++mUploadGeneration;
+    return TRUE;
+}
+
+bool LLImageGL::canStageUpload(const LLImageRaw* imageraw) const
+{
+    if (mTarget != GL_TEXTURE_2D || (sCompressTextures && mAllowCompression))
+    {
+        return false;
+    }
+
+    if (mHasExplicitFormat)
+    {
+        return !mFormatSwapBytes && mFormatType == GL_UNSIGNED_BYTE
+            && (mFormatPrimary == GL_RGB || mFormatPrimary == GL_RGBA)
+            && dataFormatComponents(mFormatPrimary) == imageraw->getComponents();
+    }
+
+    // RGB8 and RGBA8, as picked by createGLTexture()
+    return imageraw->getComponents() >= 3;
+}
+
+void LLImageGL::cancelStagedUpload()
+{
+    if (sStagingQueue)
+    {
+        sStagingQueue->cancel(this);
+    }
+    mStagedUpload = false;
+}
+
+void LLImageGL::syncToMainThread(LLGLuint new_tex_name, U32 generation)
 {
     LL_PROFILE_ZONE_SCOPED;
     llassert(!on_main_thread());
@@ -1843,7 +2081,14 @@ void LLImageGL::syncToMainThread(LLGLuint new_tex_name)
         [=]()
         {
             LL_PROFILE_ZONE_NAMED("cglt - delete callback");
-            syncTexName(new_tex_name);
+            if (generation)
+            {
+                swapTexName(new_tex_name, generation);
+            }
+            else
+            {
+                syncTexName(new_tex_name);
+            }
             unref();
         });
 
@@ -1851,6 +2096,24 @@ void LLImageGL::syncToMainThread(LLGLuint new_tex_name)
 }
 
 
+bool LLImageGL::swapTexName(LLGLuint texname, U32 generation)
+{
+    if (generation < mSwappedGeneration)
+    {
+        LLImageGL::deleteTextures(1, &texname);
+        return false;
+    }
+
+    if (mStagedUpload && mStagedGeneration < generation)
+    {
+        // its data is older than what is landing now
+        cancelStagedUpload();
+    }
+    mSwappedGeneration = generation;
+    syncTexName(texname);
+    return true;
+}
+
 void LLImageGL::syncTexName(LLGLuint texname)
 {
     if (texname != 0)
@@ -1978,6 +2241,11 @@ void LLImageGL::destroyGLTexture()
 {
     checkActiveThread();
 
+	if (mStagedUpload)
+	{
+		cancelStagedUpload();
+	}
+
 	if (mTexName != 0)
 	{
 		if(mTextureMemory != S64Bytes(0))
@@ -40,6 +40,8 @@
 #include "threadpool.h"
 #include "workqueue.h"
 
+#include <atomic>
+
 #define LL_IMAGEGL_THREAD_CHECK 0 //set to 1 to enable thread debugging for ImageGL
 
 class LLWindow;
@@ -51,6 +53,7 @@ class LLWindow;
 class LLImageGL : public LLRefCount
 {
 	friend class LLTexUnit;
+	friend class LLGLTextureStagingQueue;
 public:
 
     // Get an estimate of how many bytes have been allocated in vram for textures.
@@ -74,6 +77,10 @@ class LLImageGL : public LLRefCount
 
 	// needs to be called every frame
 	static void updateStats(F32 current_time);
+	// Sends up to sStagedUploadBudget bytes of staged texture data to GL,
+	// call once per frame on the main thread
+	static void updateStagedUploads();
+	static U32 getStagedUploadCount();
 
 	// Save off / restore GL textures
 	static void destroyGL(BOOL save_state = TRUE);
@@ -116,6 +123,12 @@ class LLImageGL : public LLRefCount
 	BOOL createGLTexture(S32 discard_level, const LLImageRaw* imageraw, S32 usename = 0, BOOL to_create = TRUE,
 		S32 category = sMaxCategories-1, bool defer_copy = false, LLGLuint* tex_name = nullptr);
 	BOOL createGLTexture(S32 discard_level, const U8* data, BOOL data_hasmips = FALSE, S32 usename = 0, bool defer_copy = false, LLGLuint* tex_name = nullptr);
+	// Same as createGLTexture(), except that on the main thread an
+	// uncompressed 2D image only gets its storage allocated here.  Its pixels,
+	// mips included, go through pooled pixel unpack buffers over the following
+	// frames, see updateStagedUploads(), and the current texture stays in use
+	// until the new one is complete.
+	BOOL createGLTextureStaged(S32 discard_level, const LLImageRaw* imageraw, S32 category = sMaxCategories-1);
 	void setImage(const LLImageRaw* imageraw);
 	BOOL setImage(const U8* data_in, BOOL data_hasmips = FALSE, S32 usename = 0);
     // *TODO: This function may not work if the textures is compressed (i.e.
@@ -126,8 +139,9 @@ class LLImageGL : public LLRefCount
 	BOOL setSubImageFromFrameBuffer(S32 fb_x, S32 fb_y, S32 x_pos, S32 y_pos, S32 width, S32 height);
 
     // wait for gl commands to finish on current thread and push
-    // a lambda to main thread to swap mNewTexName and mTexName
-    void syncToMainThread(LLGLuint new_tex_name);
+    // a lambda to main thread to swap mNewTexName and mTexName.
+    // generation, if set, is the one createGLTexture() gave the upload
+    void syncToMainThread(LLGLuint new_tex_name, U32 generation = 0);
 
 	// Read back a raw image for this discard level, if it exists
 	BOOL readBackRaw(S32 discard_level, LLImageRaw* imageraw, bool compressed_ok) const;
@@ -218,6 +232,11 @@ class LLImageGL : public LLRefCount
 	U32 createPickMask(S32 pWidth, S32 pHeight);
 	void freePickMask();
     bool isCompressed();
+	bool canStageUpload(const LLImageRaw* imageraw) const;
+	void cancelStagedUpload();
+	// syncTexName() unless an upload of a later generation already
+	// landed, in which case texname is deleted and false returned
+	bool swapTexName(LLGLuint texname, U32 generation);
 
 	LLPointer<LLImageRaw> mSaveData; // used for destroyGL/restoreGL
 	LL::WorkQueue::weak_t mMainQueue;
@@ -236,6 +255,11 @@ class LLImageGL : public LLRefCount
 	S8   mAlphaOffset ;
 
 	bool     mGLTextureCreated ;
+	bool     mStagedUpload; // a new texture for this image is being filled by updateStagedUploads()
+	S8       mStagedDiscardLevel; // of the staged texture, mCurrentDiscardLevel once it is swapped in
+	U32      mStagedGeneration;
+	U32      mSwappedGeneration; // of the texture in mTexName, main thread only
+	std::atomic<U32> mUploadGeneration; // bumped by every upload that replaces the texture, on any thread
 	LLGLuint mTexName;
     //LLGLuint mNewTexName = 0; // tex name set by background thread to be applied in main thread
 	U16      mWidth;
@@ -283,6 +307,7 @@ class LLImageGL : public LLRefCount
 	static LLImageGL* sDefaultGLTexture ;	
 	static BOOL sAutomatedTest;
 	static bool sCompressTextures;			//use GL texture compression
+	static U32 sStagedUploadBudget;			// bytes of staged texture data per frame, 0 to upload at once
 #if DEBUG_MISS
 	BOOL mMissed; // Missed on last bind?
 	BOOL getMissed() const { return mMissed; };
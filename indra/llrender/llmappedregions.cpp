@@ -0,0 +1,61 @@
+/**
+ * @file llmappedregions.cpp
+ * @brief Byte ranges of a mapped vertex buffer waiting to go to GL.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llmappedregions.h"
+
+void LLMappedRegions::map(U32 start, U32 end)
+{
+	if (mMappedAll)
+	{
+		return;
+	}
+
+	for (Region& region : mRegions)
+	{
+		if (end < region.mStart || start > region.mEnd)
+		{ //gap exists, do not merge
+			continue;
+		}
+
+		region.mStart = llmin(region.mStart, start);
+		region.mEnd = llmax(region.mEnd, end);
+		return;
+	}
+
+	//didn't expand an existing region, make a new one
+	mRegions.push_back({ start, end });
+}
+
+void LLMappedRegions::mapAll(U32 size)
+{
+	mRegions.clear();
+	if (size)
+	{
+		mRegions.push_back({ 0, size - 1 });
+	}
+	mMappedAll = true;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file llmappedregions.h
+ * @brief Byte ranges of a mapped vertex buffer waiting to go to GL.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMAPPEDREGIONS_H
+#define LL_LLMAPPEDREGIONS_H
+
+#include <algorithm>
+#include <vector>
+
+// The parts of one of LLVertexBuffer's client side copies that were handed
+// out for writing since the last unmap, merged where they overlap.
+class LLMappedRegions
+{
+public:
+	struct Region
+	{
+		U32 mStart;
+		U32 mEnd;		// last byte, not last byte + 1
+	};
+
+	// Flags bytes start to end as written.  Does nothing after mapAll(),
+	// so once the whole buffer is flagged several threads may call it.
+	void map(U32 start, U32 end);
+
+	// Flags all size bytes as written until the next unmap()
+	void mapAll(U32 size);
+
+	bool isMappedAll() const				{ return mMappedAll; }
+	bool empty() const						{ return mRegions.empty(); }
+	const std::vector<Region>& getRegions() const	{ return mRegions; }
+
+	// Calls flush(start, end) for each run of contiguous written bytes in
+	// ascending order, then forgets them all, mapAll() included
+	template <typename F>
+	void unmap(F flush);
+
+private:
+	std::vector<Region>	mRegions;
+	bool				mMappedAll = false;
+};
+
+template <typename F>
+void LLMappedRegions::unmap(F flush)
+{
+	mMappedAll = false;
+	if (mRegions.empty())
+	{
+		return;
+	}
+
+	std::sort(mRegions.begin(), mRegions.end(),
+			  [](const Region& lhs, const Region& rhs)
+			  {
+				  return lhs.mStart < rhs.mStart;
+			  });
+
+	U32 start = mRegions[0].mStart;
+	U32 end = mRegions[0].mEnd;
+	for (size_t i = 1; i < mRegions.size(); ++i)
+	{
+		const Region& region = mRegions[i];
+		if (region.mStart <= end + 1)
+		{
+			end = llmax(end, region.mEnd);
+		}
+		else
+		{
+			flush(start, end);
+			start = region.mStart;
+			end = region.mEnd;
+		}
+	}
+	flush(start, end);
+
+	mRegions.clear();
+}
+
+#endif // LL_LLMAPPEDREGIONS_H
@@ -0,0 +1,219 @@
+/**
+ * @file lltexturestagingqueue.cpp
+ * @brief Texture uploads spread over frames through a pool of staging buffers.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "lltexturestagingqueue.h"
+
+#include "lltimer.h"
+#include "lltrace.h"
+
+static LLTrace::CountStatHandle<F64Kilobytes> sStagedUploadBytes("texture_upload_bytes", "Texture data sent to GL through staging buffers");
+static LLTrace::SampleStatHandle<F64Milliseconds> sStagedUploadStall("texture_upload_stall", "Main thread time spent on staged texture uploads in the last frame");
+static LLTrace::CountStatHandle<> sStagedUploadWaits("texture_upload_waits", "Frames staged texture uploads stopped early because every staging buffer was still in use by the GPU");
+
+void LLTextureStagingQueue::push(LLRefCount* image, const LLImageRaw* raw, U32 tex_name, S32 levels)
+{
+	Upload upload;
+	upload.mImage = image;
+	// only read from, held so the pixels outlive the texture's own reference
+	upload.mRaw = const_cast<LLImageRaw*>(raw);
+	upload.mTexName = tex_name;
+	upload.mComponents = raw->getComponents();
+	upload.mLevel = 0;
+	upload.mWidth = raw->getWidth();
+	upload.mHeight = raw->getHeight();
+	upload.mRowBytes = raw->getWidth() * raw->getComponents();
+	upload.mNextRow = 0;
+
+	// each mip averages 2x2 texels of the level above
+	S32 width = upload.mWidth;
+	S32 height = upload.mHeight;
+	S32 halvable = 1;
+	while (halvable < levels && !(width & 1) && !(height & 1))
+	{
+		width >>= 1;
+		height >>= 1;
+		++halvable;
+	}
+	upload.mLevels = halvable == levels ? levels : 1;
+
+	mUploads.push_back(upload);
+}
+
+void LLTextureStagingQueue::cancel(LLRefCount* image)
+{
+	// the queue may hold the last reference
+	LLPointer<LLRefCount> hold = image;
+	for (auto iter = mUploads.begin(); iter != mUploads.end(); ++iter)
+	{
+		if (iter->mImage == image)
+		{
+			discard(*iter);
+			mUploads.erase(iter);
+			break;
+		}
+	}
+}
+
+U32 LLTextureStagingQueue::update(U32 budget)
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
+	if (mUploads.empty())
+	{
+		sample(sStagedUploadStall, F64Milliseconds(0.0));
+		return 0;
+	}
+
+	LLTimer timer;
+	U32 sent = 0;
+	while (!mUploads.empty() && sent < budget)
+	{
+		Upload& upload = mUploads.front();
+
+		// at least one row per band, so any budget makes progress
+		const U32 band_budget = llmin(budget - sent, STAGING_BUFFER_SIZE);
+		const S32 rows = llclamp((S32)(band_budget / upload.mRowBytes), 1, upload.mHeight - upload.mNextRow);
+		const U32 bytes = rows * upload.mRowBytes;
+
+		StagingBuffer* buffer = acquire(bytes);
+		if (!buffer)
+		{
+			add(sStagedUploadWaits, 1);
+			break;
+		}
+
+		void* fence = sendBand(upload, buffer->mName, getBand(upload, rows), rows, bytes);
+		if (!fence)
+		{
+			// leave it to the next frame rather than upload from client memory
+			break;
+		}
+		buffer->mFence = fence;
+
+		sent += bytes;
+		upload.mNextRow += rows;
+		if (upload.mNextRow >= upload.mHeight && !nextLevel(upload))
+		{
+			finish(upload);
+			mUploads.pop_front();
+		}
+	}
+
+	add(sStagedUploadBytes, F64Bytes(sent));
+	sample(sStagedUploadStall, F64Milliseconds(timer.getElapsedTimeF64() * 1000.0));
+	return sent;
+}
+
+void LLTextureStagingQueue::cleanup()
+{
+	while (!mUploads.empty())
+	{
+		cancel(mUploads.front().mImage);
+	}
+
+	for (StagingBuffer& buffer : mBuffers)
+	{
+		if (buffer.mFence)
+		{
+			deleteFence(buffer.mFence);
+		}
+		deleteBuffer(buffer.mName);
+	}
+	mBuffers.clear();
+	mNextBuffer = 0;
+}
+
+LLTextureStagingQueue::StagingBuffer* LLTextureStagingQueue::acquire(U32 size)
+{
+	const U32 count = (U32)mBuffers.size();
+	for (U32 i = 0; i < count; ++i)
+	{
+		StagingBuffer& buffer = mBuffers[(mNextBuffer + i) % count];
+		if (buffer.mFence)
+		{
+			if (!isFenceSignaled(buffer.mFence))
+			{
+				continue;
+			}
+			deleteFence(buffer.mFence);
+			buffer.mFence = nullptr;
+		}
+
+		mNextBuffer = (mNextBuffer + i + 1) % count;
+		if (buffer.mSize < size)
+		{
+			buffer.mSize = llmax(size, STAGING_BUFFER_SIZE);
+			resizeBuffer(buffer.mName, buffer.mSize);
+		}
+		return &buffer;
+	}
+
+	if (count >= MAX_STAGING_BUFFERS)
+	{
+		return nullptr;
+	}
+
+	StagingBuffer buffer;
+	buffer.mSize = llmax(size, STAGING_BUFFER_SIZE);
+	buffer.mName = createBuffer(buffer.mSize);
+	buffer.mFence = nullptr;
+	mBuffers.push_back(buffer);
+	mNextBuffer = 0;
+	return &mBuffers.back();
+}
+
+const U8* LLTextureStagingQueue::getBand(Upload& upload, S32 rows)
+{
+	const size_t offset = (size_t)upload.mNextRow * upload.mRowBytes;
+	if (!upload.mLevel)
+	{
+		return upload.mRaw->getData() + offset;
+	}
+
+	// the two rows of the level above under each row of this one
+	const U8* src = upload.mLevel == 1 ? upload.mRaw->getData() : upload.mPrevMip.data();
+	LLImageBase::generateMip(src + offset * 4, upload.mMip.data() + offset, upload.mWidth, rows, upload.mComponents);
+	return upload.mMip.data() + offset;
+}
+
+bool LLTextureStagingQueue::nextLevel(Upload& upload)
+{
+	if (upload.mLevel + 1 >= upload.mLevels)
+	{
+		return false;
+	}
+
+	++upload.mLevel;
+	upload.mWidth >>= 1;
+	upload.mHeight >>= 1;
+	upload.mRowBytes = upload.mWidth * upload.mComponents;
+	upload.mNextRow = 0;
+	// the finished level is the next one's source
+	upload.mPrevMip.swap(upload.mMip);
+	upload.mMip.resize((size_t)upload.mRowBytes * upload.mHeight);
+	allocateLevel(upload);
+	return true;
+}
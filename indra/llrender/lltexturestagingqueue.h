@@ -0,0 +1,131 @@
+/**
+ * @file lltexturestagingqueue.h
+ * @brief Texture uploads spread over frames through a pool of staging buffers.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTEXTURESTAGINGQUEUE_H
+#define LL_LLTEXTURESTAGINGQUEUE_H
+
+#include "llimage.h"
+#include "llpointer.h"
+#include "llrefcount.h"
+
+#include <deque>
+#include <vector>
+
+// Textures queued here get their storage at once but are filled a band of
+// rows at a time, through a small pool of staging buffers, under a byte
+// budget per frame.  A buffer is reused once the fence set after its last
+// band has signaled.  Mips are built from the level above a band at a time,
+// the way setImage() builds them by hand, and sent the same way.
+//
+// The buffers, fences and texture calls are left to a subclass, LLImageGL's
+// one issues them to GL.
+class LLTextureStagingQueue
+{
+public:
+	static constexpr U32 STAGING_BUFFER_SIZE = 1024 * 1024;
+	static constexpr U32 MAX_STAGING_BUFFERS = 8;
+
+	struct Upload
+	{
+		LLPointer<LLRefCount> mImage;
+		LLPointer<LLImageRaw> mRaw;		// level 0, only read from
+		U32 mTexName;
+		S32 mComponents;
+		S32 mLevels;					// levels to send, 1 leaves the mips to finish()
+		S32 mLevel;						// the level being sent
+		S32 mWidth;						// of mLevel
+		S32 mHeight;
+		U32 mRowBytes;
+		S32 mNextRow;
+		std::vector<U8> mMip;			// mLevel past 0, filled a band ahead of sending
+		std::vector<U8> mPrevMip;		// the level mMip is built from past level 1
+	};
+
+	virtual ~LLTextureStagingQueue() = default;
+
+	// Queues raw as level 0 of tex_name, which has level 0's storage, and
+	// levels - 1 mips built from it.  Sizes that don't halve evenly down to
+	// the last level send level 0 alone.
+	void push(LLRefCount* image, const LLImageRaw* raw, U32 tex_name, S32 levels = 1);
+
+	// Drops image's upload, if queued
+	void cancel(LLRefCount* image);
+
+	// Sends up to budget bytes, at least one row if anything is queued and
+	// a buffer is free, and returns the bytes sent
+	U32 update(U32 budget);
+
+	U32 size() const					{ return (U32)mUploads.size(); }
+	U32 getBufferCount() const			{ return (U32)mBuffers.size(); }
+
+	// Drops pending uploads and the staging buffers
+	void cleanup();
+
+protected:
+	virtual U32 createBuffer(U32 size) = 0;
+	virtual void resizeBuffer(U32 name, U32 size) = 0;
+	virtual void deleteBuffer(U32 name) = 0;
+
+	// True once the GPU is done with the commands before fence
+	virtual bool isFenceSignaled(void* fence) = 0;
+	virtual void deleteFence(void* fence) = 0;
+
+	// Copies rows of upload's current level from data, bytes in all, into
+	// buffer and sends them to rows upload.mNextRow on.  Returns the fence
+	// after them, or null if nothing could be sent this frame.
+	virtual void* sendBand(const Upload& upload, U32 buffer, const U8* data, S32 rows, U32 bytes) = 0;
+
+	// Gives upload's current level, past 0, its storage
+	virtual void allocateLevel(const Upload& upload) = 0;
+
+	// Every level of upload is in
+	virtual void finish(const Upload& upload) = 0;
+
+	// upload is dropped before it is finished
+	virtual void discard(const Upload& upload) = 0;
+
+private:
+	struct StagingBuffer
+	{
+		U32 mName;
+		U32 mSize;
+		void* mFence;
+	};
+
+	// a buffer the GPU is done with, grown to size if needed, or null
+	StagingBuffer* acquire(U32 size);
+
+	// the next rows of upload's current level, built first if a mip
+	const U8* getBand(Upload& upload, S32 rows);
+
+	// moves upload to its next level, false if it has none
+	bool nextLevel(Upload& upload);
+
+	std::deque<Upload> mUploads;
+	std::vector<StagingBuffer> mBuffers;
+	U32 mNextBuffer = 0;
+};
+
+#endif // LL_LLTEXTURESTAGINGQUEUE_H
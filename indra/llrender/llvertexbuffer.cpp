@@ -37,6 +37,8 @@
 #include "llglslshader.h"
 #include "llmemory.h"
 
+#include <deque>
+
 //Next Highest Power Of Two
 //helper function, returns first number > v that is a power of 2, or v if v is already a power of 2
 U32 nhpo2(U32 v)
@@ -62,14 +64,6 @@ U32 wpo2(U32 i)
 	return r;
 }
 
-struct CompareMappedRegion
-{
-    bool operator()(const LLVertexBuffer::MappedRegion& lhs, const LLVertexBuffer::MappedRegion& rhs)
-    {
-        return lhs.mStart < rhs.mStart;
-    }
-};
-
 #define ENABLE_GL_WORK_QUEUE 0
 
 #if ENABLE_GL_WORK_QUEUE
@@ -293,18 +287,53 @@ static GLuint gen_buffer()
     return ret;
 }
 
-#define ANALYZE_VBO_POOL 0
-
+static LLTrace::SampleStatHandle<F64Megabytes> sVBOPoolReserved("vbo_pool_reserved", "Video memory held by the vertex buffer pool");
+static LLTrace::SampleStatHandle<F64Megabytes> sVBOPoolUsed("vbo_pool_used", "Vertex and index data held in the vertex buffer pool");
+static LLTrace::SampleStatHandle<LLUnit<F32, LLUnits::Percent> > sVBOPoolFragmentation("vbo_pool_fragmentation", "Share of the vertex buffer pool's video memory not holding data");
+static LLTrace::SampleStatHandle<> sVBOPoolSlabs("vbo_pool_slabs", "GL buffers held by the vertex buffer pool");
+
+// Vertex and index buffers are sub-allocated out of large GL buffers, "slabs".
+// Each slab is cut into equal slots of one size class. Classes are spaced an
+// eighth of a power of two apart, so rounding up wastes at most 12.5% past the
+// smallest classes. The first slab of a class is small and each new one matches
+// what the class already holds, up to SLAB_MAX_SIZE, so a rarely used class
+// doesn't strand much video memory. A buffer bigger than that gets a slab of
+// one slot.
+//
+// Frees are queued and go back on the free lists at the end of the frame, so a
+// slot drawn from this frame isn't written again before the GPU is done with
+// it. Slabs that stay empty for SLAB_TIMEOUT are deleted.
+//
+// The CPU copy of each buffer (LLVertexBuffer::mMappedData) lives at the same
+// offset in a system memory twin of its slab.
 class LLVBOPool
 {
 public:
     typedef std::chrono::steady_clock::time_point Time;
 
-    struct Entry
+    static constexpr U32 MIN_SLOT_SIZE = 64;
+    static constexpr U32 SLAB_MIN_SIZE = 64 * 1024;
+    static constexpr U32 SLAB_MAX_SIZE = 4 * 1024 * 1024;
+    static constexpr std::chrono::seconds SLAB_TIMEOUT{ 5 };
+
+    struct Slab
     {
-        U8* mData;
+        GLenum mType;
         GLuint mGLName;
-        Time mAge;
+        U8* mData;
+        U32 mSlotSize;
+        U32 mSlotCount;
+        std::vector<U32> mFreeSlots; // next slot to hand out at the back
+        Time mEmptySince;
+
+        bool isEmpty() const { return mFreeSlots.size() == mSlotCount; }
+        U32 getSize() const { return mSlotSize * mSlotCount; }
+    };
+
+    struct PendingFree
+    {
+        Slab* mSlab;
+        U32 mSlot;
     };
 
     ~LLVBOPool()
@@ -312,36 +341,35 @@ class LLVBOPool
         clear();
     }
 
-    typedef boost::unordered_flat_map<U32, std::list<Entry>> Pool;
+    // slabs of each size class, oldest first
+    typedef boost::unordered_flat_map<U32, std::vector<Slab*>> Classes;
 
-    Pool mVBOPool;
-    Pool mIBOPool;
+    Classes mVBOClasses;
+    Classes mIBOClasses;
+    boost::unordered_flat_map<GLuint, Slab*> mSlabs;
+    std::vector<PendingFree> mPendingFrees;
+    Time mLastClean;
 
-    U32 mTouchCount = 0;
-
-    U64 mDistributed = 0;
-    U64 mAllocated = 0;
-    U64 mReserved = 0;
+    U64 mDistributed = 0;   // bytes asked for
+    U64 mAllocated = 0;     // bytes in slots handed out
+    U64 mReserved = 0;      // bytes in all slabs
     U32 mMisses = 0;
     U32 mHits = 0;
 
     U64 getVramBytesUsed()
     {
-        return mAllocated + mReserved;
+        return mReserved;
     }
 
-    // increase the size to some common value (e.g. a power of two) to increase hit rate
-    void adjustSize(U32& size)
+    // round size up to its size class
+    static U32 adjustSize(U32 size)
     {
-        // size = nhpo2(size);  // (193/303)/580 MB (distributed/allocated)/reserved in VBO Pool. Overhead: 66 percent. Hit rate: 77 percent
-
-        //(245/276)/385 MB (distributed/allocated)/reserved in VBO Pool. Overhead: 57 percent. Hit rate: 69 percent
-        //(187/209)/397 MB (distributed/allocated)/reserved in VBO Pool. Overhead: 112 percent. Hit rate: 76 percent
+        size = llmax(size, MIN_SLOT_SIZE);
         U32 block_size = llmax(nhpo2(size) / 8, (U32) 16);
-        size += block_size - (size % block_size);
+        return (size + block_size - 1) & ~(block_size - 1);
     }
 
-    void allocate(GLenum type, U32 size, GLuint& name, U8*& data)
+    void allocate(GLenum type, U32 size, GLuint& name, U32& offset, U8*& data)
     {
         LL_PROFILE_ZONE_SCOPED_CATEGORY_VERTEX;
         llassert(type == GL_ARRAY_BUFFER || type == GL_ELEMENT_ARRAY_BUFFER);
@@ -349,55 +377,50 @@ class LLVBOPool
         llassert(data == nullptr);  // non null data indicates a buffer that wasn't freed
         llassert(size >= 2);  // any buffer size smaller than a single index is nonsensical
 
-        mDistributed += size;
-        adjustSize(size);
-        mAllocated += size;
-
-        auto& pool = type == GL_ELEMENT_ARRAY_BUFFER ? mIBOPool : mVBOPool;
+        U32 slot_size = adjustSize(size);
+        auto& slabs = (type == GL_ELEMENT_ARRAY_BUFFER ? mIBOClasses : mVBOClasses)[slot_size];
 
-        Pool::iterator iter = pool.find(size);
-        if (iter == pool.end())
-        { // cache miss, allocate a new buffer
-            LL_PROFILE_ZONE_NAMED_CATEGORY_VERTEX("vbo pool miss");
-            LL_PROFILE_GPU_ZONE("vbo alloc");
-
-            mMisses++;
-            name = gen_buffer();
-            glBindBuffer(type, name);
-            glBufferData(type, size, nullptr, GL_DYNAMIC_DRAW);
-            if (type == GL_ELEMENT_ARRAY_BUFFER)
-            {
-                LLVertexBuffer::sGLRenderIndices = name;
-            }
-            else
+        Slab* slab = nullptr;
+        for (Slab* candidate : slabs)
+        {
+            if (!candidate->mFreeSlots.empty())
             {
-                LLVertexBuffer::sGLRenderBuffer = name;
+                slab = candidate;
+                break;
             }
-
-            data = (U8*)ll_aligned_malloc_16(size);
         }
-        else
+
+        if (slab)
         {
             mHits++;
-            llassert(mReserved >= size); // assert if accounting gets messed up
-            mReserved -= size;
-
-            std::list<Entry>& entries = iter->second;
-            Entry& entry = entries.back();
-            name = entry.mGLName;
-            data = entry.mData;
-            
-            entries.pop_back();
-            if (entries.empty())
+        }
+        else
+        { // no free slot in this class, add a slab
+            LL_PROFILE_ZONE_NAMED_CATEGORY_VERTEX("vbo pool miss");
+            mMisses++;
+
+            U32 class_size = 0;
+            for (Slab* existing : slabs)
             {
-                pool.erase(iter);
+                class_size += existing->getSize();
             }
+            U32 slab_size = llclamp(class_size, SLAB_MIN_SIZE, SLAB_MAX_SIZE);
+            slab = createSlab(type, slot_size, llmax(slab_size / slot_size, (U32) 1));
+            slabs.push_back(slab);
         }
 
-        clean();
+        U32 slot = slab->mFreeSlots.back();
+        slab->mFreeSlots.pop_back();
+
+        name = slab->mGLName;
+        offset = slot * slab->mSlotSize;
+        data = slab->mData + offset;
+
+        mDistributed += size;
+        mAllocated += slot_size;
     }
 
-    void free(GLenum type, U32 size, GLuint name, U8* data)
+    void free(GLenum type, U32 size, GLuint name, U32 offset, U8* data)
     {
         LL_PROFILE_ZONE_SCOPED_CATEGORY_VERTEX;
         llassert(type == GL_ARRAY_BUFFER || type == GL_ELEMENT_ARRAY_BUFFER);
@@ -405,72 +428,83 @@ class LLVBOPool
         llassert(name != 0);
         llassert(data != nullptr);
 
-        clean();
+        auto iter = mSlabs.find(name);
+        if (iter == mSlabs.end())
+        {
+            llassert(false); // not from this pool
+            return;
+        }
+
+        Slab* slab = iter->second;
+        llassert(slab->mType == type);
+        llassert(offset % slab->mSlotSize == 0);
+        llassert(data == slab->mData + offset);
+        mPendingFrees.push_back({ slab, offset / slab->mSlotSize });
 
         llassert(mDistributed >= size);
         mDistributed -= size;
-        adjustSize(size);
-        llassert(mAllocated >= size);
-        mAllocated -= size;
-        mReserved += size;
-
-        auto& pool = type == GL_ELEMENT_ARRAY_BUFFER ? mIBOPool : mVBOPool;
+        llassert(mAllocated >= slab->mSlotSize);
+        mAllocated -= slab->mSlotSize;
+    }
 
-        Pool::iterator iter = pool.find(size);
+    // return this frame's frees to the pool and sample the pool stats
+    void endFrame()
+    {
+        LL_PROFILE_ZONE_SCOPED_CATEGORY_VERTEX;
+        Time now = std::chrono::steady_clock::now();
 
-        if (iter == pool.end())
+        for (const PendingFree& pending : mPendingFrees)
         {
-            std::list<Entry> newlist;
-            newlist.push_front({ data, name, std::chrono::steady_clock::now() });
-            pool[size] = newlist;
+            Slab* slab = pending.mSlab;
+            slab->mFreeSlots.push_back(pending.mSlot);
+            if (slab->isEmpty())
+            {
+                slab->mEmptySince = now;
+            }
         }
-        else
+        mPendingFrees.clear();
+
+        if (now - mLastClean > std::chrono::seconds(1))
         {
-            iter->second.push_front({ data, name, std::chrono::steady_clock::now() });
+            clean(now);
+            mLastClean = now;
         }
 
+        sample(sVBOPoolReserved, F64Bytes(mReserved));
+        sample(sVBOPoolUsed, F64Bytes(mDistributed));
+        sample(sVBOPoolFragmentation, LLUnit<F32, LLUnits::Percent>(mReserved ? (F32)(mReserved - mDistributed) * 100.f / mReserved : 0.f));
+        sample(sVBOPoolSlabs, (F64) mSlabs.size());
     }
 
-    // clean periodically (clean gets called for every alloc/free)
-    void clean()
+    // delete slabs that have been empty for a while
+    void clean(Time now)
     {
-        mTouchCount++;
-        if (mTouchCount < 1024) // clean every 1k touches
-        {
-            return;
-        }
-        mTouchCount = 0;
-
         LL_PROFILE_ZONE_SCOPED_CATEGORY_VERTEX;
 
-        boost::unordered_flat_map<U32, std::list<Entry>>* pools[] = { &mVBOPool, &mIBOPool };
-
-        using namespace std::chrono_literals;
-
-        Time cutoff = std::chrono::steady_clock::now() - 5s;
+        Time cutoff = now - SLAB_TIMEOUT;
 
         std::vector<GLuint> names_to_free;
-        for (auto* pool : pools)
+        for (auto* classes : { &mVBOClasses, &mIBOClasses })
         {
-            for (Pool::iterator iter = pool->begin(); iter != pool->end(); )
+            for (Classes::iterator iter = classes->begin(); iter != classes->end(); )
             {
-                auto& entries = iter->second;
-
-                while (!entries.empty() && entries.back().mAge < cutoff)
+                auto& slabs = iter->second;
+                slabs.erase(std::remove_if(slabs.begin(), slabs.end(), [&](Slab* slab)
+                    {
+                        if (!slab->isEmpty() || slab->mEmptySince > cutoff)
+                        {
+                            return false;
+                        }
+                        LL_PROFILE_ZONE_NAMED_CATEGORY_VERTEX("vbo slab timeout");
+                        names_to_free.push_back(slab->mGLName);
+                        mSlabs.erase(slab->mGLName);
+                        destroySlab(slab);
+                        return true;
+                    }), slabs.end());
+
+                if (slabs.empty())
                 {
-                    LL_PROFILE_ZONE_NAMED_CATEGORY_VERTEX("vbo cache timeout");
-                    auto& entry = entries.back();
-                    ll_aligned_free_16(entry.mData);
-                    names_to_free.push_back(entry.mGLName);
-                    llassert(mReserved >= iter->first);
-                    mReserved -= iter->first;
-                    entries.pop_back();
-
-                }
-
-                if (entries.empty())
-                {
-                    pool->erase(iter++);
+                    iter = classes->erase(iter);
                 }
                 else
                 {
@@ -481,11 +515,12 @@ class LLVBOPool
         if(!names_to_free.empty()) glDeleteBuffers(names_to_free.size(), names_to_free.data());
 
 #if 0
-        LL_INFOS() << llformat("(%d/%d)/%d MB (distributed/allocated)/total in VBO Pool. Overhead: %d percent. Hit rate: %d percent", 
-            mDistributed / 1000000, 
-            mAllocated / 1000000, 
-            (mAllocated + mReserved) / 1000000, // total bytes
-            ((mAllocated+mReserved-mDistributed)*100)/llmax(mDistributed, (U64) 1), // overhead percent
+        LL_INFOS() << llformat("(%d/%d)/%d MB (distributed/allocated)/total in VBO Pool, %d slabs. Overhead: %d percent. Hit rate: %d percent",
+            mDistributed / 1000000,
+            mAllocated / 1000000,
+            mReserved / 1000000, // total bytes
+            mSlabs.size(),
+            ((mReserved-mDistributed)*100)/llmax(mDistributed, (U64) 1), // overhead percent
             (mHits*100)/llmax(mMisses+mHits, (U32)1)) // hit rate percent
             << LL_ENDL;
 #endif
@@ -494,35 +529,224 @@ class LLVBOPool
     void clear()
     {
         std::vector<GLuint> names_to_free;
-        for (auto& entries : mIBOPool)
+        for (auto& slab : mSlabs)
         {
-            for (auto& entry : entries.second)
-            {
-                ll_aligned_free_16(entry.mData);
-                names_to_free.push_back(entry.mGLName);
-            }
+            names_to_free.push_back(slab.first);
+            destroySlab(slab.second);
+        }
+        if(!names_to_free.empty()) glDeleteBuffers(names_to_free.size(), names_to_free.data());
+
+        mSlabs.clear();
+        mVBOClasses.clear();
+        mIBOClasses.clear();
+        mPendingFrees.clear();
+        mReserved = 0;
+    }
+
+private:
+    Slab* createSlab(GLenum type, U32 slot_size, U32 slot_count)
+    {
+        LL_PROFILE_GPU_ZONE("vbo alloc");
+        U32 size = slot_size * slot_count;
+
+        Slab* slab = new Slab();
+        slab->mType = type;
+        slab->mSlotSize = slot_size;
+        slab->mSlotCount = slot_count;
+        slab->mGLName = gen_buffer();
+        slab->mData = (U8*)ll_aligned_malloc_16(size);
+        slab->mFreeSlots.reserve(slot_count);
+        for (U32 i = slot_count; i > 0; --i)
+        { // hand out the lowest slots first
+            slab->mFreeSlots.push_back(i - 1);
+        }
+
+        glBindBuffer(type, slab->mGLName);
+        glBufferData(type, size, nullptr, GL_DYNAMIC_DRAW);
+        if (type == GL_ELEMENT_ARRAY_BUFFER)
+        {
+            LLVertexBuffer::sGLRenderIndices = slab->mGLName;
+        }
+        else
+        {
+            LLVertexBuffer::sGLRenderBuffer = slab->mGLName;
+        }
+
+        mSlabs[slab->mGLName] = slab;
+        mReserved += size;
+        return slab;
+    }
+
+    // frees the slab's memory, the caller forgets it and deletes the GL name
+    void destroySlab(Slab* slab)
+    {
+        llassert(mReserved >= slab->getSize());
+        mReserved -= slab->getSize();
+        ll_aligned_free_16(slab->mData);
+        delete slab;
+    }
+};
+
+static LLVBOPool* sVBOPool = nullptr;
+
+static LLTrace::CountStatHandle<F64Kilobytes> sUploadBytes("vbo_upload_bytes", "Vertex and index data sent to GL");
+static LLTrace::SampleStatHandle<F64Kilobytes> sFrameUploadBytes("vbo_upload_per_frame", "Vertex and index data sent to GL in the last frame");
+static LLTrace::CountStatHandle<> sUploadStalls("vbo_upload_stalls", "Times a vertex upload waited for the GPU to release streaming buffer space");
+
+//============================================================================
+// Streaming uploads
+//
+// Where GL 4.4 buffer storage is available, vertex and index data headed for
+// a VBO is first written into a ring buffer that stays persistently mapped,
+// then copied GPU side with glCopyBufferSubData. This replaces
+// glBufferSubData, which makes the driver copy the data again and can stall
+// if the target buffer is still in use.
+//
+// Each frame's writes are fenced at endFrame(). Space is only reused once the
+// fence that covers it has signaled; waiting for it counts as a stall.
+
+class LLVBOStreamRing
+{
+public:
+    // uploads bigger than this go through glBufferSubData as before
+    static constexpr U32 MAX_UPLOAD_FRACTION = 4;
+    static constexpr U32 ALIGNMENT = 16;
+
+    bool init(U32 size)
+    {
+        LL_PROFILE_ZONE_SCOPED_CATEGORY_VERTEX;
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+        glGenBuffers(1, &mName);
+        glBindBuffer(GL_COPY_READ_BUFFER, mName);
+        glBufferStorage(GL_COPY_READ_BUFFER, size, nullptr, flags);
+        mData = (U8*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, size, flags);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+        if (!mData)
+        {
+            LL_WARNS() << "Could not map a " << size << " byte streaming buffer, using glBufferSubData" << LL_ENDL;
+            cleanup();
+            return false;
+        }
+
+        mSize = size;
+        mHead = 0;
+        mFrameStart = 0;
+        return true;
+    }
+
+    void cleanup()
+    {
+        for (auto& fence : mFences)
+        {
+            glDeleteSync(fence.mSync);
         }
+        mFences.clear();
 
-        for (auto& entries : mVBOPool)
+        if (mName)
         {
-            for (auto& entry : entries.second)
+            if (mData)
             {
-                ll_aligned_free_16(entry.mData);
-                names_to_free.push_back(entry.mGLName);
+                glBindBuffer(GL_COPY_READ_BUFFER, mName);
+                glUnmapBuffer(GL_COPY_READ_BUFFER);
+                glBindBuffer(GL_COPY_READ_BUFFER, 0);
             }
+            glDeleteBuffers(1, &mName);
         }
-        if(!names_to_free.empty()) glDeleteBuffers(names_to_free.size(), names_to_free.data());
+        mName = 0;
+        mData = nullptr;
+        mSize = 0;
+    }
 
-        mReserved = 0;
+    // copy size bytes of data to offset of the buffer bound to target
+    bool upload(GLenum target, U32 offset, U32 size, const U8* data)
+    {
+        if (!mData || size > mSize / MAX_UPLOAD_FRACTION)
+        {
+            return false;
+        }
 
-        mIBOPool.clear();
-        mVBOPool.clear();
+        U32 start = allocate(size);
+        memcpy(mData + start, data, size);
+
+        glBindBuffer(GL_COPY_READ_BUFFER, mName);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, target, start, offset, size);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        return true;
+    }
+
+    // fence everything written since the last call
+    void endFrame()
+    {
+        if (mData && mHead != mFrameStart)
+        {
+            mFences.push_back({ mFrameStart, mHead, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+            mFrameStart = mHead;
+        }
+    }
+
+private:
+    struct Fence
+    {
+        U32 mStart;
+        U32 mEnd;
+        GLsync mSync;
+    };
+
+    U32 allocate(U32 size)
+    {
+        size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        U32 start = mHead;
+        if (start + size > mSize)
+        { // wrap around; fence the tail of the ring on its own so that the
+          // regions in mFences never wrap
+            endFrame();
+            start = 0;
+            mHead = 0;
+            mFrameStart = 0;
+        }
+        U32 end = start + size;
+
+        // wait for any fenced region [start, end) overlaps
+        while (!mFences.empty() && overlaps(mFences.front(), start, end))
+        {
+            waitFor(mFences.front());
+            mFences.pop_front();
+        }
+
+        mHead = end;
+        return start;
+    }
+
+    static bool overlaps(const Fence& fence, U32 start, U32 end)
+    {
+        return fence.mStart < end && start < fence.mEnd;
     }
 
+    void waitFor(const Fence& fence)
+    {
+        GLenum status = glClientWaitSync(fence.mSync, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+        {
+            LL_PROFILE_ZONE_NAMED_CATEGORY_VERTEX("vbo stream stall");
+            add(sUploadStalls, 1);
+            const GLuint64 one_second = 1000000000;
+            glClientWaitSync(fence.mSync, GL_SYNC_FLUSH_COMMANDS_BIT, one_second);
+        }
+        glDeleteSync(fence.mSync);
+    }
 
+    GLuint mName = 0;
+    U8* mData = nullptr;
+    U32 mSize = 0;
+    U32 mHead = 0;          // next free byte
+    U32 mFrameStart = 0;    // first byte written since the last fence
+    std::deque<Fence> mFences; // oldest first
 };
 
-static LLVBOPool* sVBOPool = nullptr;
+static LLVBOStreamRing* sStreamRing = nullptr;
+static U64 sFrameUploadCount = 0;
 
 //static
 U64 LLVertexBuffer::getBytesAllocated()
@@ -535,8 +759,11 @@ U64 LLVertexBuffer::getBytesAllocated()
 //static
 U32 LLVertexBuffer::sGLRenderBuffer = 0;
 U32 LLVertexBuffer::sGLRenderIndices = 0;
+U32 LLVertexBuffer::sGLSetupBuffer = 0;
+U32 LLVertexBuffer::sGLSetupOffset = 0;
 U32 LLVertexBuffer::sLastMask = 0;
 U32 LLVertexBuffer::sVertexCount = 0;
+U32 LLVertexBuffer::sStreamingBufferSize = 0;
 GLuint LLVertexBuffer::sDummyVAO = 0;
 
 
@@ -751,7 +978,7 @@ void LLVertexBuffer::drawRange(U32 mode, U32 start, U32 end, U32 count, U32 indi
     llassert(mGLIndices == sGLRenderIndices);
     gGL.syncMatrices();
     glDrawRangeElements(sGLMode[mode], start, end, count, GL_UNSIGNED_SHORT,
-        (GLvoid*) (indices_offset * sizeof(U16)));
+        (GLvoid*) (mGLIndicesOffset + indices_offset * sizeof(U16)));
 }
 
 void LLVertexBuffer::draw(U32 mode, U32 count, U32 indices_offset) const
@@ -794,6 +1021,17 @@ void LLVertexBuffer::initClass(LLWindow* window)
     llassert(sVBOPool == nullptr);
     sVBOPool = new LLVBOPool();
 
+    llassert(sStreamRing == nullptr);
+    if (sStreamingBufferSize && gGLManager.mHasBufferStorage)
+    {
+        sStreamRing = new LLVBOStreamRing();
+        if (!sStreamRing->init(sStreamingBufferSize))
+        {
+            delete sStreamRing;
+            sStreamRing = nullptr;
+        }
+    }
+
 #if ENABLE_GL_WORK_QUEUE
     sQueue = new GLWorkQueue();
 
@@ -805,6 +1043,27 @@ void LLVertexBuffer::initClass(LLWindow* window)
 #endif
 }
 
+//static
+void LLVertexBuffer::endFrame()
+{
+    if (sVBOPool)
+    {
+        sVBOPool->endFrame();
+    }
+    if (sStreamRing)
+    {
+        sStreamRing->endFrame();
+    }
+    sample(sFrameUploadBytes, F64Bytes(sFrameUploadCount));
+    sFrameUploadCount = 0;
+}
+
+//static
+bool LLVertexBuffer::isStreaming()
+{
+    return sStreamRing != nullptr;
+}
+
 //static 
 void LLVertexBuffer::unbind()
 {
@@ -813,6 +1072,7 @@ void LLVertexBuffer::unbind()
 
 	sGLRenderBuffer = 0;
 	sGLRenderIndices = 0;
+	sGLSetupBuffer = 0;
 }
 
 //static
@@ -823,6 +1083,13 @@ void LLVertexBuffer::cleanupClass()
     delete sVBOPool;
     sVBOPool = nullptr;
 
+    if (sStreamRing)
+    {
+        sStreamRing->cleanup();
+        delete sStreamRing;
+        sStreamRing = nullptr;
+    }
+
 	if (sDummyVAO != 0)
 	{
 #ifdef GL_ARB_vertex_array_object
@@ -929,7 +1196,7 @@ void LLVertexBuffer::genBuffer(U32 size)
         llassert(mMappedData == nullptr);
 
         mSize = size;
-        sVBOPool->allocate(GL_ARRAY_BUFFER, mSize, mGLBuffer, mMappedData);
+        sVBOPool->allocate(GL_ARRAY_BUFFER, mSize, mGLBuffer, mGLBufferOffset, mMappedData);
     }
 }
 
@@ -944,7 +1211,7 @@ void LLVertexBuffer::genIndices(U32 size)
         llassert(mGLIndices == 0);
         llassert(mMappedIndexData == nullptr);
         mIndicesSize = size;
-        sVBOPool->allocate(GL_ELEMENT_ARRAY_BUFFER, mIndicesSize, mGLIndices, mMappedIndexData);
+        sVBOPool->allocate(GL_ELEMENT_ARRAY_BUFFER, mIndicesSize, mGLIndices, mGLIndicesOffset, mMappedIndexData);
     }
 }
 
@@ -1002,11 +1269,17 @@ void LLVertexBuffer::destroyGLBuffer()
         //llassert(sVBOPool);
         if (sVBOPool)
         {
-            sVBOPool->free(GL_ARRAY_BUFFER, mSize, mGLBuffer, mMappedData);
+            sVBOPool->free(GL_ARRAY_BUFFER, mSize, mGLBuffer, mGLBufferOffset, mMappedData);
+        }
+
+        if (sGLSetupBuffer == mGLBuffer && sGLSetupOffset == mGLBufferOffset)
+        { // whatever reuses this slot must set up its attributes again
+            sGLSetupBuffer = 0;
         }
 
         mSize = 0;
         mGLBuffer = 0;
+        mGLBufferOffset = 0;
         mMappedData = nullptr;
 	}
 }
@@ -1019,11 +1292,12 @@ void LLVertexBuffer::destroyGLIndices()
         //llassert(sVBOPool);
         if (sVBOPool)
         {
-            sVBOPool->free(GL_ELEMENT_ARRAY_BUFFER, mIndicesSize, mGLIndices, mMappedIndexData);
+            sVBOPool->free(GL_ELEMENT_ARRAY_BUFFER, mIndicesSize, mGLIndices, mGLIndicesOffset, mMappedIndexData);
         }
 
         mIndicesSize = 0;
         mGLIndices = 0;
+        mGLIndicesOffset = 0;
         mMappedIndexData = nullptr;
 	}
 }
@@ -1088,24 +1362,6 @@ bool LLVertexBuffer::allocateBuffer(U32 nverts, U32 nindices)
 
 //----------------------------------------------------------------------------
 
-// if no gap between region and given range exists, expand region to cover given range and return true
-// otherwise return false
-bool expand_region(LLVertexBuffer::MappedRegion& region, U32 start, U32 end)
-{
-	
-	if (end < region.mStart ||
-		start > region.mEnd)
-	{ //gap exists, do not merge
-		return false;
-	}
-
-    region.mStart = llmin(region.mStart, start);
-    region.mEnd = llmax(region.mEnd, end);
-
-	return true;
-}
-
-
 // Map for data access
 U8* LLVertexBuffer::mapVertexBuffer(LLVertexBuffer::AttributeType type, U32 index, S32 count)
 {
@@ -1119,23 +1375,8 @@ U8* LLVertexBuffer::mapVertexBuffer(LLVertexBuffer::AttributeType type, U32 inde
     U32 start = mOffsets[type] + sTypeSize[type] * index;
     U32 end = start + sTypeSize[type] * count-1;
 
-	bool flagged = false;
-	// flag region as mapped
-	for (U32 i = 0; i < mMappedVertexRegions.size(); ++i)
-	{
-		MappedRegion& region = mMappedVertexRegions[i];
-        if (expand_region(region, start, end))
-        {
-            flagged = true;
-            break;
-        }
-	}
-
-	if (!flagged)
-	{
-		//didn't expand an existing region, make a new one
-        mMappedVertexRegions.push_back({ start, end });
-	}
+    // flag region as mapped
+    mMappedVertexRegions.map(start, end);
 	
     return mMappedData+mOffsets[type]+sTypeSize[type]*index;
 }
@@ -1153,23 +1394,8 @@ U8* LLVertexBuffer::mapIndexBuffer(U32 index, S32 count)
     U32 start = sizeof(U16) * index;
     U32 end = start + sizeof(U16) * count-1;
 
-    bool flagged = false;
     // flag region as mapped
-    for (U32 i = 0; i < mMappedIndexRegions.size(); ++i)
-    {
-        MappedRegion& region = mMappedIndexRegions[i];
-        if (expand_region(region, start, end))
-        {
-            flagged = true;
-            break;
-        }
-    }
-
-    if (!flagged)
-    {
-        //didn't expand an existing region, make a new one
-        mMappedIndexRegions.push_back({ start, end });
-    }
+    mMappedIndexRegions.map(start, end);
 
     return mMappedIndexData + sizeof(U16)*index;
 }
@@ -1179,10 +1405,23 @@ U8* LLVertexBuffer::mapIndexBuffer(U32 index, S32 count)
 //  start -- first byte to copy
 //  end -- last byte to copy (NOT last byte + 1)
 //  data -- mMappedData or mMappedIndexData
-static void flush_vbo(GLenum target, U32 start, U32 end, void* data)
+// start and end are relative to the LLVertexBuffer's data, which lives at
+// base_offset in the GL buffer
+static void flush_vbo(GLenum target, U32 start, U32 end, void* data, U32 base_offset)
 {
     if (end != 0)
     {
+        start += base_offset;
+        end += base_offset;
+        U32 total = end - start + 1;
+        sFrameUploadCount += total;
+        add(sUploadBytes, F64Bytes(total));
+
+        if (sStreamRing && sStreamRing->upload(target, start, total, (U8*)data))
+        {
+            return;
+        }
+
         LL_PROFILE_ZONE_NAMED_CATEGORY_VERTEX("glBufferSubData");
         LL_PROFILE_ZONE_NUM(start);
         LL_PROFILE_ZONE_NUM(end);
@@ -1201,83 +1440,37 @@ static void flush_vbo(GLenum target, U32 start, U32 end, void* data)
     }
 }
 
-void LLVertexBuffer::unmapBuffer()
+void LLVertexBuffer::mapAll()
 {
-    struct SortMappedRegion
-    {
-        bool operator()(const MappedRegion& lhs, const MappedRegion& rhs)
-        {
-            return lhs.mStart < rhs.mStart;
-        }
-    };
+    mMappedVertexRegions.mapAll(mSize);
+    mMappedIndexRegions.mapAll(mIndicesSize);
+}
 
-	if (!mMappedVertexRegions.empty())
-	{
-        LL_PROFILE_ZONE_NAMED_CATEGORY_VERTEX("unmapBuffer - vertex");
-        if (sGLRenderBuffer != mGLBuffer)
+void LLVertexBuffer::unmapBuffer()
+{
+    mMappedVertexRegions.unmap([this](U32 start, U32 end)
         {
-            glBindBuffer(GL_ARRAY_BUFFER, mGLBuffer);
-            sGLRenderBuffer = mGLBuffer;
-        }
-            
-        U32 start = 0;
-        U32 end = 0;
-
-        std::sort(mMappedVertexRegions.begin(), mMappedVertexRegions.end(), SortMappedRegion());
-
-		for (U32 i = 0; i < mMappedVertexRegions.size(); ++i)
-		{
-			const MappedRegion& region = mMappedVertexRegions[i];
-            if (region.mStart == end + 1)
-            {
-                end = region.mEnd;
-            }
-            else
+            LL_PROFILE_ZONE_NAMED_CATEGORY_VERTEX("unmapBuffer - vertex");
+            if (sGLRenderBuffer != mGLBuffer)
             {
-                flush_vbo(GL_ARRAY_BUFFER, start, end, (U8*)mMappedData + start);
-                start = region.mStart;
-                end = region.mEnd;
+                glBindBuffer(GL_ARRAY_BUFFER, mGLBuffer);
+                sGLRenderBuffer = mGLBuffer;
             }
-		}
-
-        flush_vbo(GL_ARRAY_BUFFER, start, end, (U8*)mMappedData + start);
-
-		mMappedVertexRegions.clear();
-	}
-	
-	if (!mMappedIndexRegions.empty())
-	{
-        LL_PROFILE_ZONE_NAMED_CATEGORY_VERTEX("unmapBuffer - index");
 
-        if (mGLIndices != sGLRenderIndices)
-        {
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mGLIndices);
-            sGLRenderIndices = mGLIndices;
-        }
-        U32 start = 0;
-        U32 end = 0;
-
-        std::sort(mMappedIndexRegions.begin(), mMappedIndexRegions.end(), SortMappedRegion());
+            flush_vbo(GL_ARRAY_BUFFER, start, end, (U8*)mMappedData + start, mGLBufferOffset);
+        });
 
-        for (U32 i = 0; i < mMappedIndexRegions.size(); ++i)
+    mMappedIndexRegions.unmap([this](U32 start, U32 end)
         {
-            const MappedRegion& region = mMappedIndexRegions[i];
-            if (region.mStart == end + 1)
-            {
-                end = region.mEnd;
-            }
-            else
+            LL_PROFILE_ZONE_NAMED_CATEGORY_VERTEX("unmapBuffer - index");
+            if (mGLIndices != sGLRenderIndices)
             {
-                flush_vbo(GL_ELEMENT_ARRAY_BUFFER, start, end, (U8*)mMappedIndexData + start);
-                start = region.mStart;
-                end = region.mEnd;
+                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mGLIndices);
+                sGLRenderIndices = mGLIndices;
             }
-        }
-
-        flush_vbo(GL_ELEMENT_ARRAY_BUFFER, start, end, (U8*)mMappedIndexData + start);
 
-		mMappedIndexRegions.clear();
-	}
+            flush_vbo(GL_ELEMENT_ARRAY_BUFFER, start, end, (U8*)mMappedIndexData + start, mGLIndicesOffset);
+        });
 }
 
 //----------------------------------------------------------------------------
@@ -1414,8 +1607,15 @@ void LLVertexBuffer::setBuffer()
     {
         glBindBuffer(GL_ARRAY_BUFFER, mGLBuffer);
         sGLRenderBuffer = mGLBuffer;
+    }
 
+    // buffers share GL buffers, so the attributes need setting up whenever
+    // the offset changes too
+    if (sGLSetupBuffer != mGLBuffer || sGLSetupOffset != mGLBufferOffset)
+    {
         setupVertexBuffer();
+        sGLSetupBuffer = mGLBuffer;
+        sGLSetupOffset = mGLBufferOffset;
     }
     else if (sLastMask != data_mask)
     {
@@ -1434,7 +1634,7 @@ void LLVertexBuffer::setBuffer()
 // virtual (default)
 void LLVertexBuffer::setupVertexBuffer()
 {
-    U8* base = nullptr;
+    U8* base = (U8*)(uintptr_t) mGLBufferOffset;
 
     U32 data_mask = LLGLSLShader::sCurBoundShaderPtr->mAttributeMask;
 
@@ -1528,19 +1728,19 @@ void LLVertexBuffer::setupVertexBuffer()
 void LLVertexBuffer::setPositionData(const LLVector4a* data)
 {
     llassert(sGLRenderBuffer == mGLBuffer);
-    flush_vbo(GL_ARRAY_BUFFER, 0, sizeof(LLVector4a) * getNumVerts()-1, (U8*) data);
+    flush_vbo(GL_ARRAY_BUFFER, 0, sizeof(LLVector4a) * getNumVerts()-1, (U8*) data, mGLBufferOffset);
 }
 
 void LLVertexBuffer::setTexCoordData(const LLVector2* data)
 {
     llassert(sGLRenderBuffer == mGLBuffer);
-    flush_vbo(GL_ARRAY_BUFFER, mOffsets[TYPE_TEXCOORD0], mOffsets[TYPE_TEXCOORD0] + sTypeSize[TYPE_TEXCOORD0] * getNumVerts() - 1, (U8*)data);
+    flush_vbo(GL_ARRAY_BUFFER, mOffsets[TYPE_TEXCOORD0], mOffsets[TYPE_TEXCOORD0] + sTypeSize[TYPE_TEXCOORD0] * getNumVerts() - 1, (U8*)data, mGLBufferOffset);
 }
 
 void LLVertexBuffer::setColorData(const LLColor4U* data)
 {
     llassert(sGLRenderBuffer == mGLBuffer);
-    flush_vbo(GL_ARRAY_BUFFER, mOffsets[TYPE_COLOR], mOffsets[TYPE_COLOR] + sTypeSize[TYPE_COLOR] * getNumVerts() - 1, (U8*) data);
+    flush_vbo(GL_ARRAY_BUFFER, mOffsets[TYPE_COLOR], mOffsets[TYPE_COLOR] + sTypeSize[TYPE_COLOR] * getNumVerts() - 1, (U8*) data, mGLBufferOffset);
 }
 
 
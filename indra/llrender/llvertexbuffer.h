@@ -35,6 +35,7 @@
 #include "llstrider.h"
 #include "llrender.h"
 #include "lltrace.h"
+#include "llmappedregions.h"
 #include <set>
 #include <vector>
 #include <list>
@@ -56,12 +57,6 @@ class LLPrivateMemoryPool;
 class LLVertexBuffer final : public LLRefCount
 {
 public:
-	struct MappedRegion
-	{
-        U32 mStart;
-        U32 mEnd;
-	};
-
 	LLVertexBuffer(const LLVertexBuffer& rhs)
 	{
 		*this = rhs;
@@ -75,6 +70,12 @@ class LLVertexBuffer final : public LLRefCount
 
 	static void initClass(LLWindow* window);
 	static void cleanupClass();
+	// Fences this frame's streaming uploads, returns this frame's frees to
+	// the buffer pool and samples the stats; call once per frame, before
+	// swapping buffers
+	static void endFrame();
+	// true if uploads go through the persistently mapped streaming buffer
+	static bool isStreaming();
 	static void setupClientArrays(U32 data_mask);
 	static void drawArrays(U32 mode, const std::vector<LLVector3>& pos);
 	static void drawElements(U32 mode, const LLVector4a* pos, const LLVector2* tc, U32 num_indices, const U16* indicesp);
@@ -159,6 +160,11 @@ class LLVertexBuffer final : public LLRefCount
 	U8*		mapIndexBuffer(U32 index, S32 count = -1);
     void	unmapBuffer();
 
+	// Flags the whole buffer as mapped.  Until unmapBuffer() the map calls
+	// above leave the region lists alone, so separate parts of the buffer
+	// can be filled from several threads at once.
+	void	mapAll();
+
 	// set for rendering
     // assumes (and will assert on) the following:
     //      - this buffer has no pending unampBuffer call
@@ -220,8 +226,10 @@ class LLVertexBuffer final : public LLRefCount
 	
 
 protected:	
-    U32		mGLBuffer = 0;		// GL VBO handle
-    U32		mGLIndices = 0;		// GL IBO handle
+    U32		mGLBuffer = 0;		// GL VBO handle, shared with other buffers
+    U32		mGLIndices = 0;		// GL IBO handle, shared with other buffers
+    U32		mGLBufferOffset = 0;	// byte offset of this buffer's vertices in mGLBuffer
+    U32		mGLIndicesOffset = 0;	// byte offset of this buffer's indices in mGLIndices
     U32		mNumVerts = 0;		// Number of vertices allocated
     U32		mNumIndices = 0;	// Number of indices allocated
     U32		mOffsets[TYPE_MAX]; // byte offsets into mMappedData of each attribute
@@ -234,8 +242,8 @@ class LLVertexBuffer final : public LLRefCount
 	U32		mSize = 0;          // size in bytes of mMappedData
 	U32		mIndicesSize = 0;   // size in bytes of mMappedIndexData
 
-	std::vector<MappedRegion> mMappedVertexRegions;  // list of mMappedData byte ranges that must be sent to GL
-	std::vector<MappedRegion> mMappedIndexRegions;   // list of mMappedIndexData byte ranges that must be sent to GL
+	LLMappedRegions mMappedVertexRegions;	// mMappedData byte ranges that must be sent to GL
+	LLMappedRegions mMappedIndexRegions;	// mMappedIndexData byte ranges that must be sent to GL
 
 private:
     // DEPRECATED
@@ -259,8 +267,13 @@ class LLVertexBuffer final : public LLRefCount
 	static const U32 sGLMode[LLRender::NUM_MODES];
 	static U32 sGLRenderBuffer;
 	static U32 sGLRenderIndices;
+	static U32 sGLSetupBuffer;	// GL buffer and offset the vertex attributes point at
+	static U32 sGLSetupOffset;
 	static U32 sLastMask;
 	static U32 sVertexCount;
+	// Size in bytes of the streaming upload buffer made by initClass() when
+	// GL 4.4 buffer storage is available, 0 to upload with glBufferSubData
+	static U32 sStreamingBufferSize;
 	static GLuint sDummyVAO;
 };
 
@@ -0,0 +1,196 @@
+/**
+ * @file llmappedregions_test.cpp
+ * @brief Tests for the mapped byte ranges of a vertex buffer.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llmappedregions.h"
+
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../test/lltut.h"
+
+namespace
+{
+	typedef std::vector<std::pair<U32, U32> > flushes_t;
+
+	flushes_t unmap(LLMappedRegions& regions)
+	{
+		flushes_t flushes;
+		regions.unmap([&flushes](U32 start, U32 end)
+			{
+				flushes.emplace_back(start, end);
+			});
+		return flushes;
+	}
+
+	void ensure_flush(const char* msg, const std::pair<U32, U32>& flush, U32 start, U32 end)
+	{
+		tut::ensure_equals(std::string(msg) + " start", flush.first, start);
+		tut::ensure_equals(std::string(msg) + " end", flush.second, end);
+	}
+
+	// One of a group's buffers being filled the way
+	// LLVolumeGeometryManager::fillBuffers() does, vertices and indices
+	// each tracked on their own
+	struct TestBuffer
+	{
+		U32 mSize;
+		U32 mIndicesSize;
+		LLMappedRegions mVertexRegions;
+		LLMappedRegions mIndexRegions;
+	};
+}
+
+namespace tut
+{
+	struct mappedregions_data
+	{
+	};
+	typedef test_group<mappedregions_data> mappedregions_test;
+	typedef mappedregions_test::object mappedregions_object;
+	tut::mappedregions_test mappedregions_testcase("LLMappedRegions");
+
+	template<> template<>
+	void mappedregions_object::test<1>()
+	{
+		set_test_name("mapped ranges merge and flush in order");
+
+		LLMappedRegions regions;
+		ensure("empty", regions.empty());
+
+		regions.map(100, 199);
+		regions.map(150, 249);		// overlaps, grows the first
+		regions.map(400, 499);
+		regions.map(250, 299);		// adjacent, flushed with the first
+		regions.map(0, 0);			// a single byte at the start
+		regions.map(120, 130);		// already covered
+		ensure("not mapped whole", !regions.isMappedAll());
+
+		flushes_t flushes = unmap(regions);
+		ensure_equals("runs", flushes.size(), (size_t)3);
+		ensure_flush("first byte", flushes[0], 0, 0);
+		ensure_flush("merged run", flushes[1], 100, 299);
+		ensure_flush("last run", flushes[2], 400, 499);
+		ensure("forgotten", regions.empty());
+		ensure("nothing flushed twice", unmap(regions).empty());
+
+		// A region grown into the next one is flushed once
+		regions.map(0, 9);
+		regions.map(20, 29);
+		regions.map(5, 24);
+		flushes = unmap(regions);
+		ensure_equals("one run", flushes.size(), (size_t)1);
+		ensure_flush("covering both", flushes[0], 0, 29);
+	}
+
+	template<> template<>
+	void mappedregions_object::test<2>()
+	{
+		set_test_name("mapAll covers a multi-buffer fill and unmap ends it");
+
+		std::vector<TestBuffer> buffers(6);
+		for (U32 i = 0; i < buffers.size(); ++i)
+		{
+			buffers[i].mSize = 4096 * (i + 1);
+			buffers[i].mIndicesSize = i == 2 ? 0 : 2048 * (i + 1);	// one without indices
+			buffers[i].mVertexRegions.mapAll(buffers[i].mSize);
+			buffers[i].mIndexRegions.mapAll(buffers[i].mIndicesSize);
+		}
+
+		// Each buffer's faces are filled on their own thread, each face
+		// maps every attribute of its range through the strider calls
+		const U32 faces = 64;
+		std::vector<std::thread> threads;
+		for (TestBuffer& buffer : buffers)
+		{
+			threads.emplace_back([&buffer, faces]()
+				{
+					const U32 face_bytes = buffer.mSize / faces;
+					const U32 face_indices = buffer.mIndicesSize / faces;
+					for (U32 face = 0; face < faces; ++face)
+					{
+						for (U32 attribute = 0; attribute < 4; ++attribute)
+						{
+							const U32 stride = face_bytes / 4;
+							const U32 start = face * face_bytes + attribute * stride;
+							buffer.mVertexRegions.map(start, start + stride - 1);
+						}
+						if (face_indices)
+						{
+							buffer.mIndexRegions.map(face * face_indices, (face + 1) * face_indices - 1);
+						}
+					}
+				});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		for (TestBuffer& buffer : buffers)
+		{
+			ensure("still mapped whole", buffer.mVertexRegions.isMappedAll());
+			ensure_equals("fills left the list alone", buffer.mVertexRegions.getRegions().size(), (size_t)1);
+
+			flushes_t flushes = unmap(buffer.mVertexRegions);
+			ensure_equals("one upload per buffer", flushes.size(), (size_t)1);
+			ensure_flush("the whole buffer", flushes[0], 0, buffer.mSize - 1);
+			ensure("back to tracking", !buffer.mVertexRegions.isMappedAll());
+			ensure("nothing pending", buffer.mVertexRegions.empty());
+
+			flushes = unmap(buffer.mIndexRegions);
+			if (buffer.mIndicesSize)
+			{
+				ensure_equals("one index upload", flushes.size(), (size_t)1);
+				ensure_flush("all the indices", flushes[0], 0, buffer.mIndicesSize - 1);
+			}
+			else
+			{
+				ensure("no indices, no upload", flushes.empty());
+			}
+			ensure("index tracking back", !buffer.mIndexRegions.isMappedAll());
+		}
+
+		// The next partial rebuild of a buffer only uploads what it touched
+		TestBuffer& buffer = buffers[3];
+		buffer.mVertexRegions.map(1024, 2047);
+		buffer.mIndexRegions.map(0, 63);
+		ensure_equals("tracked again", buffer.mVertexRegions.getRegions().size(), (size_t)1);
+		flushes_t flushes = unmap(buffer.mVertexRegions);
+		ensure_flush("only the rebuilt range", flushes[0], 1024, 2047);
+		flushes = unmap(buffer.mIndexRegions);
+		ensure_flush("only the rebuilt indices", flushes[0], 0, 63);
+
+		// A remap drops what was tracked before it
+		buffer.mVertexRegions.map(0, 15);
+		buffer.mVertexRegions.mapAll(buffer.mSize);
+		flushes = unmap(buffer.mVertexRegions);
+		ensure_equals("remapped whole", flushes.size(), (size_t)1);
+		ensure_flush("whole after partial", flushes[0], 0, buffer.mSize - 1);
+	}
+}
@@ -0,0 +1,390 @@
+/**
+ * @file lltexturestagingqueue_test.cpp
+ * @brief Tests for texture uploads spread over frames through staging buffers.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../lltexturestagingqueue.h"
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "../test/lltut.h"
+
+namespace
+{
+	class TestImage : public LLRefCount
+	{
+	public:
+		// what arrived for each level, laid out like the texture
+		std::vector<std::vector<U8> > mLevels;
+		bool mFinished = false;
+		bool mDiscarded = false;
+	};
+
+	struct AllocatedLevel
+	{
+		S32 mLevel;
+		S32 mWidth;
+		S32 mHeight;
+	};
+
+	// Keeps what LLImageGL's queue would send to GL.  Fences are numbered
+	// from 1 and signal once at or below mSignaled, or at once with
+	// mSignalAll.
+	class TestStagingQueue : public LLTextureStagingQueue
+	{
+	public:
+		bool mSignalAll = true;
+		uintptr_t mSignaled = 0;
+		bool mFailSend = false;
+
+		U32 mBuffersCreated = 0;
+		U32 mBuffersDeleted = 0;
+		std::set<U32> mBusyBuffers;		// sent from, fence not deleted yet
+		std::set<uintptr_t> mFences;		// not deleted yet
+		std::vector<U32> mBandBytes;
+		std::vector<AllocatedLevel> mAllocated;
+
+	protected:
+		U32 createBuffer(U32 size) override
+		{
+			mBufferSizes[++mBuffersCreated] = size;
+			return mBuffersCreated;
+		}
+
+		void resizeBuffer(U32 name, U32 size) override
+		{
+			mBufferSizes[name] = size;
+		}
+
+		void deleteBuffer(U32 name) override
+		{
+			mBufferSizes.erase(name);
+			++mBuffersDeleted;
+		}
+
+		bool isFenceSignaled(void* fence) override
+		{
+			return mSignalAll || (uintptr_t)fence <= mSignaled;
+		}
+
+		void deleteFence(void* fence) override
+		{
+			mFences.erase((uintptr_t)fence);
+			mBusyBuffers.erase(mFenceBuffers[(uintptr_t)fence]);
+		}
+
+		void* sendBand(const Upload& upload, U32 buffer, const U8* data, S32 rows, U32 bytes) override
+		{
+			if (mFailSend)
+			{
+				return nullptr;
+			}
+
+			tut::ensure("buffer is known", mBufferSizes.count(buffer) > 0);
+			tut::ensure("band fits its buffer", bytes <= mBufferSizes[buffer]);
+			tut::ensure("buffer not in use by the GPU", mBusyBuffers.insert(buffer).second);
+			tut::ensure_equals("whole rows", bytes, rows * upload.mRowBytes);
+			tut::ensure("level has storage", upload.mLevel == 0 || (!mAllocated.empty() && mAllocated.back().mLevel == upload.mLevel));
+
+			TestImage* image = static_cast<TestImage*>(upload.mImage.get());
+			if (image->mLevels.size() <= (size_t)upload.mLevel)
+			{
+				image->mLevels.resize(upload.mLevel + 1);
+			}
+			std::vector<U8>& level = image->mLevels[upload.mLevel];
+			tut::ensure_equals("bands in row order", level.size(), (size_t)upload.mNextRow * upload.mRowBytes);
+			level.insert(level.end(), data, data + bytes);
+			mBandBytes.push_back(bytes);
+
+			const uintptr_t fence = ++mLastFence;
+			mFences.insert(fence);
+			mFenceBuffers[fence] = buffer;
+			return (void*)fence;
+		}
+
+		void allocateLevel(const Upload& upload) override
+		{
+			mAllocated.push_back({ upload.mLevel, upload.mWidth, upload.mHeight });
+		}
+
+		void finish(const Upload& upload) override
+		{
+			static_cast<TestImage*>(upload.mImage.get())->mFinished = true;
+		}
+
+		void discard(const Upload& upload) override
+		{
+			static_cast<TestImage*>(upload.mImage.get())->mDiscarded = true;
+		}
+
+	private:
+		std::map<U32, U32> mBufferSizes;
+		std::map<uintptr_t, U32> mFenceBuffers;
+		uintptr_t mLastFence = 0;
+	};
+
+	LLPointer<LLImageRaw> make_raw(S32 width, S32 height, S32 components)
+	{
+		LLPointer<LLImageRaw> raw = new LLImageRaw(width, height, components);
+		U8* data = raw->getData();
+		for (S32 i = 0; i < width * height * components; ++i)
+		{
+			data[i] = (U8)((i * 37) ^ (i >> 7));
+		}
+		return raw;
+	}
+
+	// Runs frames until nothing is queued, returns the frames it took
+	U32 drain(TestStagingQueue& queue, U32 budget)
+	{
+		U32 frames = 0;
+		while (queue.size())
+		{
+			queue.update(budget);
+			++frames;
+		}
+		return frames;
+	}
+}
+
+namespace tut
+{
+	struct texturestagingqueue_data
+	{
+	};
+	typedef test_group<texturestagingqueue_data> texturestagingqueue_test;
+	typedef texturestagingqueue_test::object texturestagingqueue_object;
+	tut::texturestagingqueue_test texturestagingqueue_testcase("LLTextureStagingQueue");
+
+	template<> template<>
+	void texturestagingqueue_object::test<1>()
+	{
+		set_test_name("each frame sends what the upload budget allows");
+
+		TestStagingQueue queue;
+		LLPointer<TestImage> image = new TestImage;
+		LLPointer<LLImageRaw> raw = make_raw(256, 256, 4);
+		queue.push(image, raw, 1);
+		ensure_equals("queued", queue.size(), (U32)1);
+		ensure_equals("no budget, nothing sent", queue.update(0), (U32)0);
+
+		// 64 rows of 1024 bytes a frame
+		for (U32 frame = 0; frame < 4; ++frame)
+		{
+			ensure("not finished early", !image->mFinished);
+			ensure_equals("a budget's worth", queue.update(65536), (U32)65536);
+		}
+		ensure("finished on the last band", image->mFinished);
+		ensure_equals("dequeued", queue.size(), (U32)0);
+		ensure("level 0 arrived whole", image->mLevels[0] == std::vector<U8>(raw->getData(), raw->getData() + raw->getDataSize()));
+		ensure_equals("nothing left to send", queue.update(65536), (U32)0);
+
+		// Budgets that aren't a multiple of a row go up to the row past them,
+		// and one under a row still sends a row
+		LLPointer<TestImage> small = new TestImage;
+		queue.push(small, raw, 2);
+		ensure_equals("one row", queue.update(1000), (U32)1024);
+		ensure_equals("rounded up to a row", queue.update(1500), (U32)2048);
+
+		// A budget past one image goes on to the next
+		LLPointer<TestImage> next = new TestImage;
+		LLPointer<LLImageRaw> next_raw = make_raw(64, 64, 3);
+		queue.push(next, next_raw, 3);
+		const U32 left = 256 * 1024 - 3 * 1024;
+		const U32 sent = queue.update(left + 64 * 3 * 10);
+		ensure_equals("the rest of one and some of the next", sent, left + 64 * 3 * 10);
+		ensure("first finished", small->mFinished);
+		ensure("second started", !next->mFinished && next->mLevels.size() == 1);
+
+		// Large budgets are split into bands no bigger than a staging buffer
+		LLPointer<TestImage> large = new TestImage;
+		LLPointer<LLImageRaw> large_raw = make_raw(1024, 1024, 4);
+		queue.mBandBytes.clear();
+		queue.push(large, large_raw, 4);
+		drain(queue, 16 * 1024 * 1024);
+		ensure("large finished", large->mFinished);
+		for (U32 bytes : queue.mBandBytes)
+		{
+			ensure("band fits a staging buffer", bytes <= LLTextureStagingQueue::STAGING_BUFFER_SIZE);
+		}
+		ensure("all the budgets sent from one buffer", queue.getBufferCount() == 1);
+	}
+
+	template<> template<>
+	void texturestagingqueue_object::test<2>()
+	{
+		set_test_name("staging buffers are pooled and reused once their fence signals");
+
+		TestStagingQueue queue;
+		queue.mSignalAll = false;
+		LLPointer<TestImage> image = new TestImage;
+		LLPointer<LLImageRaw> raw = make_raw(256, 256, 4);
+		queue.push(image, raw, 1);
+
+		// The GPU never catches up, each frame's band takes a buffer of its own
+		const U32 band = 4 * 1024;
+		for (U32 frame = 0; frame < LLTextureStagingQueue::MAX_STAGING_BUFFERS; ++frame)
+		{
+			ensure_equals("band sent", queue.update(band), band);
+			ensure_equals("a buffer per band", queue.getBufferCount(), frame + 1);
+		}
+		ensure_equals("nothing free, nothing sent", queue.update(band), (U32)0);
+		ensure_equals("pool full", queue.getBufferCount(), LLTextureStagingQueue::MAX_STAGING_BUFFERS);
+
+		// Three fences signal, three buffers are reused
+		queue.mSignaled = 3;
+		for (U32 frame = 0; frame < 3; ++frame)
+		{
+			ensure_equals("reused buffer", queue.update(band), band);
+		}
+		ensure_equals("waits again", queue.update(band), (U32)0);
+		ensure_equals("no new buffers", queue.mBuffersCreated, LLTextureStagingQueue::MAX_STAGING_BUFFERS);
+
+		// The rest goes through as the GPU catches up
+		queue.mSignalAll = true;
+		drain(queue, band);
+		ensure("finished", image->mFinished);
+		ensure_equals("never more than the pool", queue.mBuffersCreated, LLTextureStagingQueue::MAX_STAGING_BUFFERS);
+
+		// A band that fails to go out is sent the next frame
+		LLPointer<TestImage> retried = new TestImage;
+		queue.push(retried, raw, 2);
+		queue.mFailSend = true;
+		ensure_equals("failed send", queue.update(band), (U32)0);
+		queue.mFailSend = false;
+		drain(queue, 64 * band);
+		ensure("retried image complete", retried->mLevels[0] == image->mLevels[0]);
+
+		// cleanup() drops the buffers and their fences
+		queue.cleanup();
+		ensure_equals("buffers deleted", queue.mBuffersDeleted, LLTextureStagingQueue::MAX_STAGING_BUFFERS);
+		ensure_equals("pool empty", queue.getBufferCount(), (U32)0);
+		ensure("fences deleted", queue.mFences.empty());
+	}
+
+	template<> template<>
+	void texturestagingqueue_object::test<3>()
+	{
+		set_test_name("every mip level is staged and built as setImage() builds them");
+
+		const S32 sizes[][3] = { { 64, 32, 4 }, { 32, 32, 3 } };
+		for (const S32* size : sizes)
+		{
+			const S32 width = size[0];
+			const S32 height = size[1];
+			const S32 components = size[2];
+			const S32 levels = 6;		// down to 2x1 and 1x1
+
+			// the whole chain at once, as setImage() does by hand
+			LLPointer<LLImageRaw> raw = make_raw(width, height, components);
+			std::vector<std::vector<U8> > expected(1, std::vector<U8>(raw->getData(), raw->getData() + raw->getDataSize()));
+			U32 total = expected[0].size();
+			for (S32 level = 1, w = width / 2, h = height / 2; level < levels; ++level, w /= 2, h /= 2)
+			{
+				expected.push_back(std::vector<U8>(w * h * components));
+				LLImageBase::generateMip(expected[level - 1].data(), expected[level].data(), w, h, components);
+				total += expected[level].size();
+			}
+
+			TestStagingQueue queue;
+			LLPointer<TestImage> image = new TestImage;
+			queue.push(image, raw, 1, levels);
+
+			// a small budget splits the mips into bands too
+			U32 sent = 0;
+			while (queue.size())
+			{
+				sent += queue.update(300);
+			}
+			ensure("finished", image->mFinished);
+			ensure_equals("every level's bytes counted", sent, total);
+			ensure_equals("every level sent", image->mLevels.size(), (size_t)levels);
+			for (S32 level = 0; level < levels; ++level)
+			{
+				ensure("level matches the whole-level build", image->mLevels[level] == expected[level]);
+			}
+
+			ensure_equals("levels past 0 allocated", queue.mAllocated.size(), (size_t)levels - 1);
+			for (S32 level = 1; level < levels; ++level)
+			{
+				const AllocatedLevel& allocated = queue.mAllocated[level - 1];
+				ensure_equals("in order", allocated.mLevel, level);
+				ensure_equals("width", allocated.mWidth, width >> level);
+				ensure_equals("height", allocated.mHeight, height >> level);
+			}
+		}
+
+		// 24 halves to 3, which doesn't halve evenly, so level 0 goes alone
+		// and the mips are left to finish()
+		TestStagingQueue queue;
+		LLPointer<TestImage> image = new TestImage;
+		LLPointer<LLImageRaw> raw = make_raw(24, 24, 4);
+		queue.push(image, raw, 1, 5);
+		ensure_equals("level 0 only", queue.update(1024 * 1024), (U32)(24 * 24 * 4));
+		ensure("finished", image->mFinished);
+		ensure_equals("one level", image->mLevels.size(), (size_t)1);
+		ensure("nothing allocated", queue.mAllocated.empty());
+	}
+
+	template<> template<>
+	void texturestagingqueue_object::test<4>()
+	{
+		set_test_name("cancelled uploads are dropped and release their image");
+
+		TestStagingQueue queue;
+		LLPointer<LLImageRaw> raw = make_raw(64, 64, 4);
+		LLPointer<TestImage> first = new TestImage;
+		LLPointer<TestImage> second = new TestImage;
+		queue.push(first, raw, 1, 4);
+		queue.push(second, raw, 2, 4);
+		ensure_equals("held by the queue", first->getNumRefs(), 2);
+
+		queue.update(4096);
+		queue.cancel(first);
+		ensure("discarded", first->mDiscarded);
+		ensure("not finished", !first->mFinished);
+		ensure_equals("released", first->getNumRefs(), 1);
+		ensure_equals("one left", queue.size(), (U32)1);
+
+		LLPointer<TestImage> unknown = new TestImage;
+		queue.cancel(unknown);
+		ensure("unknown image untouched", !unknown->mDiscarded);
+
+		drain(queue, 4096);
+		ensure("the other finished", second->mFinished && !second->mDiscarded);
+
+		// The queue held the last reference
+		TestImage* only = new TestImage;
+		queue.push(only, raw, 3);
+		ensure_equals("queue's reference", only->getNumRefs(), 1);
+		LLPointer<TestImage> last = new TestImage;
+		queue.push(last, raw, 4);
+		queue.cleanup();
+		ensure("pending dropped", last->mDiscarded && !last->mFinished);
+		ensure_equals("queue empty", queue.size(), (U32)0);
+	}
+}
@@ -61,62 +61,63 @@ static const struct
 	U32							mMax;
 	U32							mRate;
 	bool						mPipelined;
+	bool						mMultiplexed;
 	std::string					mKey;
 	const char *				mUsage;
 } init_data[LLAppCoreHttp::AP_COUNT] =
 {
 	{ // AP_DEFAULT
-		8,		8,		8,		0,		false,
+		8,		8,		8,		0,		false,	false,
 		"",
 		"other"
 	},
 	{ // AP_ASSET
-		8,		1,		16,		0,		true,
+		8,		1,		16,		0,		true,	true,
 		"AssetFetchConcurrency",
 		"asset fetch"
 	},
 	{ // AP_TEXTURE
-		8,		1,		12,		0,		true,
+		8,		1,		12,		0,		true,	true,
 		"TextureFetchConcurrency",
 		"texture fetch"
 	},
 	{ // AP_MESH1
-		32,		1,		128,	0,		false,
+		32,		1,		128,	0,		false,	false,
 		"MeshMaxConcurrentRequests",
 		"mesh fetch"
 	},
 	{ // AP_MESH2
-		8,		1,		32,		0,		true,	
+		8,		1,		32,		0,		true,	true,
 		"Mesh2MaxConcurrentRequests",
 		"mesh2 fetch"
 	},
 	{ // AP_LARGE_MESH
-		2,		1,		8,		0,		false,
+		2,		1,		8,		0,		false,	true,
 		"",
 		"large mesh fetch"
 	},
 	{ // AP_UPLOADS 
-		2,		1,		8,		0,		false,
+		2,		1,		8,		0,		false,	false,
 		"",
 		"asset upload"
 	},
 	{ // AP_LONG_POLL
-		32,		32,		32,		0,		false,
+		32,		32,		32,		0,		false,	false,
 		"",
 		"long poll"
 	},
 	{ // AP_INVENTORY
-		4,		1,		4,		0,		false,
+		4,		1,		4,		0,		false,	false,
 		"",
 		"inventory"
 	},
 	{ // AP_MATERIALS
-		2,		1,		8,		0,		false,
+		2,		1,		8,		0,		false,	false,
 		"RenderMaterials",
 		"material manager requests"
 	},
 	{ // AP_AGENT
-		2,		1,		32,		0,		false,
+		2,		1,		32,		0,		false,	false,
 		"Agent",
 		"Agent requests"
 	}
@@ -129,7 +130,8 @@ static void ssl_verification_changed();
 LLAppCoreHttp::HttpClass::HttpClass()
 	: mPolicy(LLCore::HttpRequest::DEFAULT_POLICY_ID),
 	  mConnLimit(0U),
-	  mPipelined(false)
+	  mPipelined(false),
+	  mMultiplexed(false)
 {}
 
 
@@ -138,7 +140,8 @@ LLAppCoreHttp::LLAppCoreHttp()
 	  mStopHandle(LLCORE_HTTP_HANDLE_INVALID),
 	  mStopRequested(0.0),
 	  mStopped(false),
-	  mPipelined(true)
+	  mPipelined(true),
+	  mMultiplexStreams(0U)
 {}
 
 
@@ -278,6 +281,14 @@ void LLAppCoreHttp::init()
 	// Need a request object to handle dynamic options before setting them
 	mRequest = new LLCore::HttpRequest;
 
+	// HTTP/2 streams per connection for the multiplexed classes
+	static const std::string http_multiplex_streams("AlchemyHttpMultiplexStreams");
+	if (gSavedSettings.controlExists(http_multiplex_streams))
+	{
+		mMultiplexStreams = gSavedSettings.getU32(http_multiplex_streams);
+		LL_INFOS("Init") << "HTTP/2 multiplexing " << (mMultiplexStreams ? "enabled" : "disabled") << "!" << LL_ENDL;
+	}
+
 	// Apply initial settings
 	refreshSettings(true);
 	
@@ -466,6 +477,32 @@ void LLAppCoreHttp::refreshSettings(bool initial)
 					mHttpClasses[app_policy].mPipelined = to_pipeline;
 				}
 			}
+
+			const bool to_multiplex(mMultiplexStreams && init_data[i].mMultiplexed);
+			if (to_multiplex != mHttpClasses[app_policy].mMultiplexed)
+			{
+				LLCore::HttpHandle handle;
+				const long new_streams(to_multiplex ? long(mMultiplexStreams) : 0L);
+
+				handle = mRequest->setPolicyOption(LLCore::HttpRequest::PO_MULTIPLEX_STREAMS,
+												   mHttpClasses[app_policy].mPolicy,
+												   new_streams,
+                                                   LLCore::HttpHandler::ptr_t());
+				if (LLCORE_HTTP_HANDLE_INVALID == handle)
+				{
+					status = mRequest->getStatus();
+					LL_WARNS("Init") << "Unable to set " << init_data[i].mUsage
+									 << " multiplexing.  Reason:  " << status.toString()
+									 << LL_ENDL;
+				}
+				else
+				{
+					LL_DEBUGS("Init") << "Changed " << init_data[i].mUsage
+									  << " multiplexing.  New value:  " << new_streams
+									  << LL_ENDL;
+					mHttpClasses[app_policy].mMultiplexed = to_multiplex;
+				}
+			}
 		}
 		
 		// Get target connection concurrency value
@@ -59,6 +59,7 @@ class LLAppCoreHttp : public LLCore::HttpHandler
 		/// Concurrency:     high 
 		/// Request rate:    unknown
 		/// Pipelined:       no
+		/// Multiplexed:     no
 		AP_DEFAULT,
 
 		/// Asset fetching policy class.  Used to
@@ -73,6 +74,7 @@ class LLAppCoreHttp : public LLCore::HttpHandler
 		/// Concurrency:     high
 		/// Request rate:    high
 		/// Pipelined:       yes
+		/// Multiplexed:     yes
 		AP_ASSET,
 
 		/// Texture fetching policy class.  Used to
@@ -87,6 +89,7 @@ class LLAppCoreHttp : public LLCore::HttpHandler
 		/// Concurrency:     high
 		/// Request rate:    high
 		/// Pipelined:       yes
+		/// Multiplexed:     yes
 		AP_TEXTURE,
 
 		/// Legacy mesh fetching policy class.  Used to
@@ -100,6 +103,7 @@ class LLAppCoreHttp : public LLCore::HttpHandler
 		/// Concurrency:     dangerously high
 		/// Request rate:    high
 		/// Pipelined:       no
+		/// Multiplexed:     no
 		AP_MESH1,
 
 		/// New mesh fetching policy class.  Used to
@@ -116,6 +120,7 @@ class LLAppCoreHttp : public LLCore::HttpHandler
 		/// Concurrency:     high
 		/// Request rate:    high
 		/// Pipelined:       yes
+		/// Multiplexed:     yes
 		AP_MESH2,
 
 		/// Large mesh fetching policy class.  Used to
@@ -134,6 +139,7 @@ class LLAppCoreHttp : public LLCore::HttpHandler
 		/// Concurrency:     low
 		/// Request rate:    low
 		/// Pipelined:       no
+		/// Multiplexed:     yes
 		AP_LARGE_MESH,
 
 		/// Asset upload policy class.  Used to store
@@ -148,6 +154,7 @@ class LLAppCoreHttp : public LLCore::HttpHandler
 		/// Concurrency:     low
 		/// Request rate:    low
 		/// Pipelined:       no
+		/// Multiplexed:     no
 		AP_UPLOADS,
 
 		/// Long-poll-type HTTP requests.  Not
@@ -163,6 +170,7 @@ class LLAppCoreHttp : public LLCore::HttpHandler
 		/// Concurrency:     unlimited but low in practice
 		/// Request rate:    low
 		/// Pipelined:       no
+		/// Multiplexed:     no
 		AP_LONG_POLL,
 
 		/// Inventory operations (really Capabilities-
@@ -176,6 +184,7 @@ class LLAppCoreHttp : public LLCore::HttpHandler
 		/// Concurrency:     high
 		/// Request rate:    high
 		/// Pipelined:       no
+		/// Multiplexed:     no
 		AP_INVENTORY,
 		AP_REPORTING = AP_INVENTORY,	// Piggy-back on inventory
 
@@ -188,6 +197,7 @@ class LLAppCoreHttp : public LLCore::HttpHandler
 		/// Concurrency:     low
 		/// Request rate:    low
 		/// Pipelined:       no
+		/// Multiplexed:     no
 		AP_MATERIALS,
 
 		/// Appearance resource requests and puts.  
@@ -199,6 +209,7 @@ class LLAppCoreHttp : public LLCore::HttpHandler
 		/// Concurrency:     mid
 		/// Request rate:    low
 		/// Pipelined:       yes
+		/// Multiplexed:     no
 		AP_AGENT,
 
 		AP_COUNT						// Must be last
@@ -242,6 +253,12 @@ class LLAppCoreHttp : public LLCore::HttpHandler
 			return mHttpClasses[policy].mPipelined;
 		}
 
+	// Return whether a policy asks for HTTP/2 multiplexing.
+	bool isMultiplexed(EAppPolicy policy) const
+		{
+			return mHttpClasses[policy].mMultiplexed;
+		}
+
 	// Apply initial or new settings from the environment.
 	void refreshSettings(bool initial);
 	
@@ -260,6 +277,7 @@ class LLAppCoreHttp : public LLCore::HttpHandler
 		policy_t					mPolicy;			// Policy class id for the class
 		U32							mConnLimit;
 		bool						mPipelined;
+		bool						mMultiplexed;
 		boost::signals2::connection mSettingsSignal;	// Signal to global setting that affect this class (if any)
 	};
 		
@@ -269,6 +287,7 @@ class LLAppCoreHttp : public LLCore::HttpHandler
 	bool						mStopped;
 	HttpClass					mHttpClasses[AP_COUNT];
 	bool						mPipelined;				// Global setting
+	U32							mMultiplexStreams;		// Global setting, 0 disables HTTP/2 multiplexing
 	boost::signals2::connection	mPipelinedSignal;		// Signal for 'HttpPipelining' setting
 	boost::signals2::connection	mSSLNoVerifySignal;		// Signal for 'NoVerifySSLCert' setting
 
@@ -558,6 +558,7 @@ static void settings_to_globals()
 	LLRender::sNsightDebugSupport = gSavedSettings.getBOOL("RenderNsightDebugSupport");
 	LLRender::sAnisotropicFilteringLevel = static_cast<F32>(gSavedSettings.getU32("RenderAnisotropicLevel"));
 	LLImageGL::sCompressTextures		= gSavedSettings.getBOOL("RenderCompressTextures");
+	LLVertexBuffer::sStreamingBufferSize = llclamp(gSavedSettings.getU32("AlchemyRenderStreamingBufferSize"), 0U, 256U) * 1024 * 1024;
 	LLVOVolume::sLODFactor				= llclamp(gSavedSettings.getF32("RenderVolumeLODFactor"), 0.01f, MAX_LOD_FACTOR);
 	LLVOVolume::sDistanceFactor			= 1.f-LLVOVolume::sLODFactor * 0.1f;
 	LLVolumeImplFlexible::sUpdateFactor = gSavedSettings.getF32("RenderFlexTimeFactor");
@@ -2157,11 +2158,13 @@ bool LLAppViewer::initThreads()
         cores = llmin(cores, (S32) max_cores);
     }
 
-    // The only configurable thread count right now is ImageDecode
+    // The configurable thread counts right now are ImageDecode and MeshDecode
     // The viewer typically starts around 8 threads not including image decode, 
     // so try to leave at least one core free
     S32 image_decode_count = llclamp(cores - 9, 1, 8);
     threadCounts["ImageDecode"] = image_decode_count;
+    // mesh assets come in bursts and decode quickly, a few threads keep up
+    threadCounts["MeshDecode"] = llclamp(cores / 4, 1, 4);
     gSavedSettings.setLLSD("ThreadPoolSizes", threadCounts);
 
 	// Image decoding
@@ -4149,7 +4152,9 @@ bool LLAppViewer::initCache()
 		const uintmax_t disk_cache_bytes = disk_cache_mb * 1024ull * 1024ull;
 
 		const bool enable_cache_debug_info = gSavedSettings.getBOOL("EnableDiskCacheDebugInfo");
-		LLDiskCache::getInstance()->init(LL_PATH_CACHE, disk_cache_bytes, enable_cache_debug_info, disk_cache_mismatch);
+		const bool use_cache_index = gSavedSettings.getBOOL("AlchemyDiskCacheIndexed");
+		const U32 pack_max_asset_size = gSavedSettings.getBOOL("AlchemyDiskCachePacked") ? gSavedSettings.getU32("AlchemyDiskCachePackMaxAssetSize") : 0;
+		LLDiskCache::getInstance()->init(LL_PATH_CACHE, disk_cache_bytes, enable_cache_debug_info, disk_cache_mismatch, use_cache_index, pack_max_asset_size);
 
 		if (!read_only)
 		{
@@ -4212,6 +4217,7 @@ void LLAppViewer::purgeCache()
 
 	LLSplashScreen::update(LLTrans::getString("StartupClearingDiskCache"));
 	LLDiskCache::getInstance()->clearCache(LL_PATH_CACHE, false);
+	gDirUtilp->deleteDirAndContents(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "mesh_decoded"));
 
 	LLSplashScreen::update(LLTrans::getString("StartupClearingObjectCache"));
 	LLVOCache::getInstance()->removeCache(LL_PATH_CACHE);
@@ -4239,6 +4245,7 @@ void LLAppViewer::purgeCacheSelective(const LLSD& insd)
 		LL_INFOS("AppCache") << "Purging Disk Cache..." << LL_ENDL;
 		LLSplashScreen::update(LLTrans::getString("StartupClearingDiskCache"));
 		LLDiskCache::getInstance()->clearCache(LL_PATH_CACHE, false);
+		gDirUtilp->deleteDirAndContents(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "mesh_decoded"));
 	}
 
 	if (insd.has("regions"))
@@ -4838,6 +4845,7 @@ void LLAppViewer::idle()
 
         if (!(logoutRequestSent() && hasSavedFinalSnapshot()))
 		{
+			gObjectList.applyQueuedUpdates();
 			gObjectList.update(gAgent);
 		}
 	}
@@ -69,7 +69,10 @@ LLMessageTemplate* LLEasyMessageReader::decodeTemplateMessage(U8 *data, S32 data
 
 	LLMessageTemplate* message_template = nullptr;
 
-	gMessageSystem->zeroCodeExpand(&decodep, &data_len);
+	if (gMessageSystem->zeroCodeExpand(&decodep, &data_len) < 0)
+	{
+		return nullptr;
+	}
 
 	if(data_len >= LL_MINIMUM_VALID_PACKET_SIZE)
 	{
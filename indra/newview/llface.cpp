@@ -46,6 +46,7 @@
 #include "llsky.h"
 #include "llviewercamera.h"
 #include "llviewertexturelist.h"
+#include "lltexturepriority.h"
 #include "llvopartgroup.h"
 #include "llvovolume.h"
 #include "pipeline.h"
@@ -2026,6 +2027,33 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 	return TRUE;
 }
 
+void LLFace::prepareGeometryVolume(LLVolume& volume, S32 face_index)
+{
+	if (face_index < 0 || face_index >= volume.getNumVolumeFaces())
+	{
+		return;
+	}
+
+	const LLTextureEntry* tep = mVObjp->getTE(face_index);
+	if (!tep)
+	{
+		return;
+	}
+
+	// tangents are generated on demand into the volume, which other objects share
+	if ((mVertexBuffer.notNull() && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_TANGENT)) ||
+		tep->getBumpmap() ||
+		tep->getTexGen() != LLTextureEntry::TEX_GEN_DEFAULT)
+	{
+		volume.genTangents(face_index);
+	}
+
+	if (isState(TEXTURE_ANIM) && !((LLVOVolume*) (LLViewerObject*) mVObjp)->mTexAnimMode)
+	{
+		clearState(TEXTURE_ANIM);
+	}
+}
+
 void LLFace::renderIndexed()
 {
     if (mVertexBuffer.notNull())
@@ -2053,6 +2081,23 @@ BOOL LLFace::hasMedia() const
 const F32 LEAST_IMPORTANCE = 0.05f ;
 const F32 LEAST_IMPORTANCE_FOR_LARGE_IMAGE = 0.3f ;
 
+void LLFace::setVirtualSize(F32 size)
+{
+	if (LLTexturePriorityBuckets::getBucket(size) != LLTexturePriorityBuckets::getBucket(mVSize))
+	{
+		// the textures on this face may belong in another priority bucket
+		for (U32 ch = 0; ch < LLRender::NUM_TEXTURE_CHANNELS; ++ch)
+		{
+			LLViewerFetchedTexture* imagep = LLViewerTextureManager::staticCastToFetchedTexture(mTexture[ch].get());
+			if (imagep)
+			{
+				gTextureList.dirtyImagePriority(imagep);
+			}
+		}
+	}
+	mVSize = size;
+}
+
 void LLFace::resetVirtualSize()
 {
 	setVirtualSize(0.f);
@@ -110,7 +110,7 @@ class alignas(16) LLFace
 	void			setState(U32 state)			{ mState |= state; }
 	void			clearState(U32 state)		{ mState &= ~state; }
 	BOOL			isState(U32 state)	const	{ return ((mState & state) != 0) ? TRUE : FALSE; }
-	void			setVirtualSize(F32 size) { mVSize = size; }
+	void			setVirtualSize(F32 size);
 	void			setPixelArea(F32 area)	{ mPixelArea = area; }
 	F32				getVirtualSize() const { return mVSize; }
 	F32				getPixelArea() const { return mPixelArea; }
@@ -154,6 +154,10 @@ class alignas(16) LLFace
                             U16 index_offset,
                             bool force_rebuild = false,
                             bool no_debug_assert = false);
+	// Does the parts of a full getGeometryVolume() that touch state shared
+	// with other faces or read by registerFace(), so the fill itself can
+	// run off the main thread afterwards.
+	void prepareGeometryVolume(LLVolume& volume, S32 face_index);
 
 	// For avatar
 	U16			 getGeometryAvatar(
@@ -0,0 +1,540 @@
+/**
+ * @file llinventorycache.cpp
+ * @brief Binary inventory cache, memory mapped on load and written off
+ * the main thread.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llinventorycache.h"
+
+#include "llapp.h"
+#include "llfile.h"
+#include "llmappedfile.h"
+#include "llmutex.h"
+#include "hbxxh.h"
+#include "workqueue.h"
+
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+
+static const char * const LOG_INV("Inventory");
+
+// File layout, all in host byte order:
+//   Header
+//   CategoryRecord[mCategoryCount]
+//   ItemRecord[mItemCount]
+//   U32 string offsets[mStringCount + 1], relative to the string data
+//   string data, not NUL terminated
+namespace
+{
+	const char MAGIC[8] = { 'A', 'L', 'I', 'N', 'V', 'B', 'I', 'N' };
+	// Reads back differently on a machine of the other endianness
+	const U32 BYTE_ORDER_MARK = 0x01020304;
+
+	// Snapshots are numbered as they are taken, so that a write that
+	// finishes after a newer one of the same file does not replace it
+	std::atomic<U32> sSnapshotCount(0);
+	// Gives each write its own temp file
+	std::atomic<U32> sTempCount(0);
+
+	// Guards sLastWritten, the snapshot last renamed into place per file
+	LLMutex sWriteMutex;
+	std::unordered_map<std::string, U32> sLastWritten;
+
+	struct Header
+	{
+		char	mMagic[8];
+		U32		mVersion;
+		U32		mByteOrder;
+		U32		mStringCount;
+		U32		mCategoryCount;
+		U32		mItemCount;
+		U32		mPad;
+		U64		mCategoryOffset;
+		U64		mItemOffset;
+		U64		mStringOffset;
+		U64		mFileSize;
+		// of everything after the header
+		U64		mChecksum;
+	};
+	static_assert(sizeof(Header) == 72, "Inventory cache header layout changed");
+
+	struct CategoryRecord
+	{
+		LLUUID	mID;
+		LLUUID	mParentID;
+		LLUUID	mOwnerID;
+		LLUUID	mThumbnailID;
+		U32		mName;
+		S32		mVersion;
+		S8		mPreferredType;
+		U8		mPad[3];
+	};
+	static_assert(sizeof(CategoryRecord) == 76, "Inventory cache category layout changed");
+
+	struct ItemRecord
+	{
+		LLUUID	mID;
+		LLUUID	mParentID;
+		LLUUID	mAssetID;
+		LLUUID	mThumbnailID;
+		LLUUID	mCreatorID;
+		LLUUID	mOwnerID;
+		LLUUID	mLastOwnerID;
+		LLUUID	mGroupID;
+		U32		mMaskBase;
+		U32		mMaskOwner;
+		U32		mMaskGroup;
+		U32		mMaskEveryone;
+		U32		mMaskNextOwner;
+		U32		mFlags;
+		S64		mCreationDate;
+		S32		mSalePrice;
+		U32		mName;
+		U32		mDescription;
+		S8		mType;
+		S8		mInventoryType;
+		U8		mSaleType;
+		U8		mPad;
+	};
+	static_assert(sizeof(ItemRecord) == 176, "Inventory cache item layout changed");
+	static_assert(std::is_trivially_copyable<CategoryRecord>::value && std::is_trivially_copyable<ItemRecord>::value,
+				  "Inventory cache records are copied straight from the file");
+
+	template<typename T>
+	inline void append(std::vector<U8>& buffer, const T* data, size_t count)
+	{
+		const U8* bytes = reinterpret_cast<const U8*>(data);
+		buffer.insert(buffer.end(), bytes, bytes + sizeof(T) * count);
+	}
+
+	// The string table as read back from a mapped file
+	class StringTable
+	{
+	public:
+		StringTable(const U8* offsets, const U8* data, U32 count, size_t data_size)
+			: mOffsets(offsets), mData(reinterpret_cast<const char*>(data)),
+			  mCount(count), mDataSize(data_size)
+		{
+		}
+
+		// Every offset in range and in order, so get() needs no checks
+		bool validate() const
+		{
+			U32 prev = 0;
+			for (U32 i = 0; i <= mCount; ++i)
+			{
+				const U32 offset = offsetAt(i);
+				if (offset < prev || offset > mDataSize)
+				{
+					return false;
+				}
+				prev = offset;
+			}
+			return offsetAt(mCount) == mDataSize;
+		}
+
+		bool has(U32 index) const	{ return index < mCount; }
+
+		std::string get(U32 index) const
+		{
+			const U32 begin = offsetAt(index);
+			return std::string(mData + begin, offsetAt(index + 1) - begin);
+		}
+
+	private:
+		U32 offsetAt(U32 index) const
+		{
+			U32 offset;
+			memcpy(&offset, mOffsets + sizeof(U32) * index, sizeof(U32));
+			return offset;
+		}
+
+		const U8*	mOffsets;
+		const char*	mData;
+		U32			mCount;
+		size_t		mDataSize;
+	};
+}
+
+class LLInventoryCache::Snapshot
+{
+public:
+	Snapshot()
+	:	mSequence(++sSnapshotCount)
+	{
+		// index 0 is the empty string, the most common description by far
+		intern(LLStringUtil::null);
+	}
+
+	U32 intern(const std::string& str)
+	{
+		auto result = mStringIndex.emplace(str, (U32)mStrings.size());
+		if (result.second)
+		{
+			mStrings.push_back(str);
+		}
+		return result.first->second;
+	}
+
+	std::vector<std::string>					mStrings;
+	std::unordered_map<std::string, U32>		mStringIndex;
+	std::vector<CategoryRecord>					mCategories;
+	std::vector<ItemRecord>						mItems;
+	const U32									mSequence;
+};
+
+//static
+LLInventoryCache::snapshot_ptr_t LLInventoryCache::snapshot(const cat_array_t& categories, const item_array_t& items)
+{
+	LL_PROFILE_ZONE_SCOPED;
+
+	snapshot_ptr_t snap = std::make_shared<Snapshot>();
+	snap->mCategories.reserve(categories.size());
+	snap->mItems.reserve(items.size());
+
+	for (const LLPointer<LLViewerInventoryCategory>& cat : categories)
+	{
+		if (cat->getVersion() == LLViewerInventoryCategory::VERSION_UNKNOWN)
+		{
+			continue;
+		}
+
+		CategoryRecord record = {};
+		record.mID = cat->getUUID();
+		record.mParentID = cat->getParentUUID();
+		record.mOwnerID = cat->getOwnerID();
+		record.mThumbnailID = cat->getThumbnailUUID();
+		record.mName = snap->intern(cat->getName());
+		record.mVersion = cat->getVersion();
+		record.mPreferredType = (S8)cat->getPreferredType();
+		snap->mCategories.push_back(record);
+	}
+
+	for (const LLPointer<LLViewerInventoryItem>& item : items)
+	{
+		// the item's own values, the viewer accessors follow links
+		const LLInventoryItem* base = item.get();
+		const LLPermissions& perm = base->LLInventoryItem::getPermissions();
+		const LLSaleInfo& sale_info = base->LLInventoryItem::getSaleInfo();
+
+		ItemRecord record = {};
+		record.mID = base->getUUID();
+		record.mParentID = base->getParentUUID();
+		record.mAssetID = base->LLInventoryItem::getAssetUUID();
+		record.mThumbnailID = base->LLInventoryItem::getThumbnailUUID();
+		record.mCreatorID = perm.getCreator();
+		record.mOwnerID = perm.getOwner();
+		record.mLastOwnerID = perm.getLastOwner();
+		record.mGroupID = perm.getGroup();
+		record.mMaskBase = perm.getMaskBase();
+		record.mMaskOwner = perm.getMaskOwner();
+		record.mMaskGroup = perm.getMaskGroup();
+		record.mMaskEveryone = perm.getMaskEveryone();
+		record.mMaskNextOwner = perm.getMaskNextOwner();
+		record.mFlags = base->LLInventoryItem::getFlags();
+		record.mCreationDate = (S64)base->LLInventoryItem::getCreationDate();
+		record.mSalePrice = sale_info.getSalePrice();
+		record.mName = snap->intern(base->LLInventoryItem::getName());
+		record.mDescription = snap->intern(base->LLInventoryItem::getActualDescription());
+		record.mType = (S8)base->LLInventoryItem::getType();
+		record.mInventoryType = (S8)base->LLInventoryItem::getInventoryType();
+		record.mSaleType = (U8)sale_info.getSaleType();
+		snap->mItems.push_back(record);
+	}
+
+	// only needed while interning
+	snap->mStringIndex.clear();
+
+	return snap;
+}
+
+//static
+bool LLInventoryCache::write(const std::string& filename, const Snapshot& snapshot,
+							 const std::string& superseded)
+{
+	LL_PROFILE_ZONE_SCOPED;
+
+	if (filename.empty())
+	{
+		LL_WARNS(LOG_INV) << "Filename is empty, inventory cache not saved" << LL_ENDL;
+		return false;
+	}
+
+	std::vector<U32> string_offsets;
+	string_offsets.reserve(snapshot.mStrings.size() + 1);
+	U64 string_bytes = 0;
+	for (const std::string& str : snapshot.mStrings)
+	{
+		string_offsets.push_back((U32)string_bytes);
+		string_bytes += str.size();
+	}
+	string_offsets.push_back((U32)string_bytes);
+	if (string_bytes > U32_MAX)
+	{
+		LL_WARNS(LOG_INV) << "Inventory names too large to cache" << LL_ENDL;
+		return false;
+	}
+
+	Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.mMagic, MAGIC, sizeof(MAGIC));
+	header.mVersion = VERSION;
+	header.mByteOrder = BYTE_ORDER_MARK;
+	header.mStringCount = (U32)snapshot.mStrings.size();
+	header.mCategoryCount = (U32)snapshot.mCategories.size();
+	header.mItemCount = (U32)snapshot.mItems.size();
+	header.mCategoryOffset = sizeof(Header);
+	header.mItemOffset = header.mCategoryOffset + sizeof(CategoryRecord) * snapshot.mCategories.size();
+	header.mStringOffset = header.mItemOffset + sizeof(ItemRecord) * snapshot.mItems.size();
+	header.mFileSize = header.mStringOffset + sizeof(U32) * string_offsets.size() + string_bytes;
+
+	std::vector<U8> buffer;
+	buffer.reserve(header.mFileSize);
+	buffer.resize(sizeof(Header));
+	append(buffer, snapshot.mCategories.data(), snapshot.mCategories.size());
+	append(buffer, snapshot.mItems.data(), snapshot.mItems.size());
+	append(buffer, string_offsets.data(), string_offsets.size());
+	for (const std::string& str : snapshot.mStrings)
+	{
+		append(buffer, str.data(), str.size());
+	}
+	llassert(buffer.size() == header.mFileSize);
+
+	header.mChecksum = HBXXH64::digest(buffer.data() + sizeof(Header), buffer.size() - sizeof(Header));
+	memcpy(buffer.data(), &header, sizeof(Header));
+
+	// Written aside and renamed so a crash or another viewer instance never
+	// sees a partial file
+	const std::string temp_filename = filename + llformat(".%d.%u.tmp", LLApp::getPid(), ++sTempCount);
+	LLFILE* fp = LLFile::fopen(temp_filename, "wb");
+	if (!fp)
+	{
+		LL_WARNS(LOG_INV) << "Unable to open " << temp_filename << ", inventory cache not saved" << LL_ENDL;
+		return false;
+	}
+	const bool written = fwrite(buffer.data(), 1, buffer.size(), fp) == buffer.size();
+	if (fclose(fp) != 0 || !written)
+	{
+		LL_WARNS(LOG_INV) << "Unable to write " << temp_filename << ", inventory cache not saved" << LL_ENDL;
+		LLFile::remove(temp_filename);
+		return false;
+	}
+
+	{
+		LLMutexLock lock(&sWriteMutex);
+		U32& last_written = sLastWritten[filename];
+		if (last_written > snapshot.mSequence)
+		{
+			LL_INFOS(LOG_INV) << "Inventory cache " << filename << " was saved from a newer snapshot meanwhile" << LL_ENDL;
+			LLFile::remove(temp_filename);
+			return true;
+		}
+
+#if LL_WINDOWS
+		// rename does not replace an existing file here
+		LLFile::remove(filename, ENOENT);
+#endif
+		if (LLFile::rename(temp_filename, filename) != 0)
+		{
+			LL_WARNS(LOG_INV) << "Unable to move " << temp_filename << " to " << filename << LL_ENDL;
+			LLFile::remove(temp_filename);
+			return false;
+		}
+		last_written = snapshot.mSequence;
+	}
+
+	LL_INFOS(LOG_INV) << "Inventory saved: " << header.mCategoryCount << " categories, "
+						  << header.mItemCount << " items, " << header.mStringCount << " strings." << LL_ENDL;
+
+	if (!superseded.empty())
+	{
+		LLFile::remove(superseded, ENOENT);
+	}
+	return true;
+}
+
+//static
+void LLInventoryCache::writeInBackground(const std::string& filename, const snapshot_ptr_t& snapshot,
+										 const std::string& superseded)
+{
+	LL::WorkQueue::ptr_t general_queue = LL::WorkQueue::getInstance("General");
+	// The General pool stops taking work as soon as the app stops running,
+	// well before the logout save
+	if (!general_queue
+		|| !general_queue->post([filename, snapshot, superseded]()
+			{
+				write(filename, *snapshot, superseded);
+			}))
+	{
+		write(filename, *snapshot, superseded);
+	}
+}
+
+//static
+bool LLInventoryCache::read(const std::string& filename,
+							cat_array_t& categories,
+							item_array_t& items,
+							changed_items_t& cats_to_update,
+							bool& is_cache_obsolete)
+{
+	LL_PROFILE_ZONE_NAMED("inventory load from binary cache");
+
+	llstat stat_data;
+	if (LLFile::stat(filename, &stat_data) != 0)
+	{
+		LL_INFOS(LOG_INV) << "No binary inventory cache at: " << filename << LL_ENDL;
+		return false;
+	}
+	LL_INFOS(LOG_INV) << "loading inventory from: (" << filename << ")" << LL_ENDL;
+
+	if ((size_t)stat_data.st_size < sizeof(Header))
+	{
+		LL_WARNS(LOG_INV) << "Inventory cache is truncated" << LL_ENDL;
+		is_cache_obsolete = true;
+		return false;
+	}
+
+	LLMappedFile mapped;
+	if (!mapped.open(filename, (size_t)stat_data.st_size, true))
+	{
+		// not necessarily the file's fault, keep it for next time
+		LL_WARNS(LOG_INV) << "Unable to map inventory cache: " << filename << LL_ENDL;
+		return false;
+	}
+	const U8* data = mapped.getData();
+	const size_t file_size = mapped.getSize();
+
+	// Obsolete until proven current
+	is_cache_obsolete = true;
+
+	if (file_size < sizeof(Header))
+	{
+		LL_WARNS(LOG_INV) << "Inventory cache is truncated" << LL_ENDL;
+		return false;
+	}
+
+	Header header;
+	memcpy(&header, data, sizeof(Header));
+	if (memcmp(header.mMagic, MAGIC, sizeof(MAGIC)) != 0
+		|| header.mByteOrder != BYTE_ORDER_MARK
+		|| header.mVersion != VERSION)
+	{
+		LL_WARNS(LOG_INV) << "Inventory cache is out of date" << LL_ENDL;
+		return false;
+	}
+
+	// Sections must tile the file exactly, computed in 64 bits so counts
+	// from a damaged header cannot wrap
+	const U64 string_data_offset = header.mStringOffset + sizeof(U32) * ((U64)header.mStringCount + 1);
+	if (header.mFileSize != file_size
+		|| header.mCategoryOffset != sizeof(Header)
+		|| header.mItemOffset != header.mCategoryOffset + sizeof(CategoryRecord) * (U64)header.mCategoryCount
+		|| header.mStringOffset != header.mItemOffset + sizeof(ItemRecord) * (U64)header.mItemCount
+		|| string_data_offset > file_size)
+	{
+		LL_WARNS(LOG_INV) << "Inventory cache is corrupt" << LL_ENDL;
+		return false;
+	}
+
+	if (HBXXH64::digest(data + sizeof(Header), file_size - sizeof(Header)) != header.mChecksum)
+	{
+		LL_WARNS(LOG_INV) << "Inventory cache failed its checksum" << LL_ENDL;
+		return false;
+	}
+
+	const StringTable strings(data + header.mStringOffset, data + string_data_offset,
+							  header.mStringCount, file_size - string_data_offset);
+	if (!strings.validate())
+	{
+		LL_WARNS(LOG_INV) << "Inventory cache string table is corrupt" << LL_ENDL;
+		return false;
+	}
+
+	categories.reserve(categories.size() + header.mCategoryCount);
+	const U8* cat_data = data + header.mCategoryOffset;
+	for (U32 i = 0; i < header.mCategoryCount; ++i)
+	{
+		CategoryRecord record;
+		memcpy(&record, cat_data + sizeof(CategoryRecord) * i, sizeof(CategoryRecord));
+		if (!strings.has(record.mName))
+		{
+			continue;
+		}
+
+		LLPointer<LLViewerInventoryCategory> cat = new LLViewerInventoryCategory(
+			record.mID, record.mParentID, (LLFolderType::EType)record.mPreferredType,
+			strings.get(record.mName), record.mOwnerID);
+		cat->setVersion(record.mVersion);
+		cat->setThumbnailUUID(record.mThumbnailID);
+		categories.push_back(cat);
+	}
+
+	items.reserve(items.size() + header.mItemCount);
+	const U8* item_data = data + header.mItemOffset;
+	for (U32 i = 0; i < header.mItemCount; ++i)
+	{
+		ItemRecord record;
+		memcpy(&record, item_data + sizeof(ItemRecord) * i, sizeof(ItemRecord));
+		if (record.mID.isNull())
+		{
+			LL_DEBUGS(LOG_INV) << "Ignoring inventory with null item id" << LL_ENDL;
+			continue;
+		}
+
+		if ((LLAssetType::EType)record.mType == LLAssetType::AT_UNKNOWN)
+		{
+			cats_to_update.insert(record.mParentID);
+			continue;
+		}
+
+		if (!strings.has(record.mName) || !strings.has(record.mDescription))
+		{
+			continue;
+		}
+
+		LLPermissions perm;
+		perm.init(record.mCreatorID, record.mOwnerID, record.mLastOwnerID, record.mGroupID);
+		perm.initMasks(record.mMaskBase, record.mMaskOwner, record.mMaskEveryone,
+					   record.mMaskGroup, record.mMaskNextOwner);
+		perm.fix();
+
+		LLPointer<LLViewerInventoryItem> item = new LLViewerInventoryItem(
+			record.mID, record.mParentID, perm, record.mAssetID,
+			(LLAssetType::EType)record.mType, (LLInventoryType::EType)record.mInventoryType,
+			strings.get(record.mName), strings.get(record.mDescription),
+			LLSaleInfo((LLSaleInfo::EForSale)record.mSaleType, record.mSalePrice),
+			record.mFlags, (time_t)record.mCreationDate);
+		item->setThumbnailUUID(record.mThumbnailID);
+		// as when loaded from the notation cache, full details are still
+		// fetched on demand
+		item->setComplete(false);
+		items.push_back(item);
+	}
+
+	is_cache_obsolete = false;
+	return true;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file llinventorycache.h
+ * @brief Binary inventory cache, memory mapped on load and written off
+ * the main thread.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLINVENTORYCACHE_H
+#define LL_LLINVENTORYCACHE_H
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "llviewerinventory.h"
+
+// The inventory cache as fixed size records followed by one table of the
+// names and descriptions they use, each distinct string stored once.
+// Loading maps the file and builds the inventory objects straight from the
+// records, there is nothing to parse.  Saving copies what it needs out of
+// the model on the main thread and writes it on the General pool.
+class LLInventoryCache
+{
+public:
+	// Bump when the records change, older files are thrown away
+	static const U32 VERSION = 1;
+
+	typedef LLViewerInventoryCategory::cat_array_t cat_array_t;
+	typedef LLViewerInventoryItem::item_array_t item_array_t;
+	typedef std::set<LLUUID> changed_items_t;
+
+	class Snapshot;
+	typedef std::shared_ptr<Snapshot> snapshot_ptr_t;
+
+	// Copies categories with a known version and all items out of the
+	// model.  Main thread only.
+	static snapshot_ptr_t snapshot(const cat_array_t& categories, const item_array_t& items);
+
+	// Writes the snapshot next to filename and renames it into place
+	// once complete, then removes superseded, if given.  superseded is
+	// left alone when the write fails.  Safe on any thread.
+	static bool write(const std::string& filename, const Snapshot& snapshot,
+					  const std::string& superseded = std::string());
+
+	// write() on the General pool.  Writes right away instead when there
+	// is no pool or it no longer takes work, as during shutdown.
+	static void writeInBackground(const std::string& filename, const snapshot_ptr_t& snapshot,
+								  const std::string& superseded = std::string());
+
+	// Same contract as LLInventoryModel::loadFromFile(): items of unknown
+	// type are not returned, their parents go in cats_to_update instead.
+	// is_cache_obsolete is set when the file is from another version or
+	// fails its checks.
+	static bool read(const std::string& filename,
+					 cat_array_t& categories,
+					 item_array_t& items,
+					 changed_items_t& cats_to_update,
+					 bool& is_cache_obsolete);
+};
+
+#endif // LL_LLINVENTORYCACHE_H
@@ -40,6 +40,7 @@
 #include "lldispatcher.h"
 #include "llinventorypanel.h"
 #include "llinventorybridge.h"
+#include "llinventorycache.h"
 #include "llinventoryfunctions.h"
 #include "llinventorymodelbackgroundfetch.h"
 #include "llinventoryobserver.h"
@@ -96,6 +97,8 @@ S32 LLInventoryModel::sPendingSystemFolders = 0;
 //BOOL decompress_file(const char* src_filename, const char* dst_filename);
 static const char PRODUCTION_CACHE_FORMAT_STRING[] = "%s.inv.llsd";
 static const char GRID_CACHE_FORMAT_STRING[] = "%s.%s.inv.llsd";
+static const char PRODUCTION_BINARY_CACHE_FORMAT_STRING[] = "%s.inv.bin";
+static const char GRID_BINARY_CACHE_FORMAT_STRING[] = "%s.%s.inv.bin";
 static const char * const LOG_INV("Inventory");
 
 struct InventoryIDPtrLess
@@ -2455,7 +2458,7 @@ bool LLInventoryModel::fetchDescendentsOf(const LLUUID& folder_id) const
 }
 
 //static
-std::string LLInventoryModel::getInvCacheAddres(const LLUUID& owner_id)
+std::string LLInventoryModel::getInvCacheAddres(const LLUUID& owner_id, bool binary)
 {
     std::string inventory_addr;
     std::string owner_id_str;
@@ -2468,7 +2471,8 @@ std::string LLInventoryModel::getInvCacheAddres(const LLUUID& owner_id)
     gDirUtilp->append(path, owner_id_str);
     if (LLGridManager::getInstance()->isInSLMain())
     {
-        inventory_addr = llformat(PRODUCTION_CACHE_FORMAT_STRING, path.c_str());
+        inventory_addr = llformat(binary ? PRODUCTION_BINARY_CACHE_FORMAT_STRING : PRODUCTION_CACHE_FORMAT_STRING,
+                                  path.c_str());
     }
     else
     {
@@ -2477,14 +2481,16 @@ std::string LLInventoryModel::getInvCacheAddres(const LLUUID& owner_id)
         // if your viewer uses grid names from an untrusted source.
         const std::string grid_id_str = LLDir::getScrubbedFileName(LLGridManager::getInstance()->getGridId());
         const std::string& grid_id_lower = utf8str_tolower(grid_id_str);
-        inventory_addr = llformat(GRID_CACHE_FORMAT_STRING, path.c_str(), grid_id_lower.c_str());
+        inventory_addr = llformat(binary ? GRID_BINARY_CACHE_FORMAT_STRING : GRID_CACHE_FORMAT_STRING,
+                                  path.c_str(), grid_id_lower.c_str());
     }
     return inventory_addr;
 }
 
 void LLInventoryModel::cache(
 	const LLUUID& parent_folder_id,
-	const LLUUID& agent_id)
+	const LLUUID& agent_id,
+	bool in_background)
 {
 	LL_DEBUGS(LOG_INV) << "Caching " << parent_folder_id << " for " << agent_id
 					   << LL_ENDL;
@@ -2502,20 +2508,19 @@ void LLInventoryModel::cache(
 		items,
 		INCLUDE_TRASH,
 		can_cache);
-    // Use temporary file to avoid potential conflicts with other
-    // instances (even a 'read only' instance unzips into a file)
-    std::string temp_file = gDirUtilp->getTempFilename();
-	saveToFile(temp_file, categories, items);
-    std::string gzip_filename = getInvCacheAddres(agent_id);
+	// The binary cache replaces the notation one, which is only read to
+	// migrate from it.  The old file goes once the new one is in place.
+	const std::string binary_filename = getInvCacheAddres(agent_id, true);
+	std::string gzip_filename = getInvCacheAddres(agent_id);
 	gzip_filename.append(".gz");
-	if(gzip_file(temp_file, gzip_filename))
+	LLInventoryCache::snapshot_ptr_t snapshot = LLInventoryCache::snapshot(categories, items);
+	if (in_background)
 	{
-		LL_DEBUGS(LOG_INV) << "Successfully compressed " << temp_file << " to " << gzip_filename << LL_ENDL;
-		LLFile::remove(temp_file);
+		LLInventoryCache::writeInBackground(binary_filename, snapshot, gzip_filename);
 	}
 	else
 	{
-		LL_WARNS(LOG_INV) << "Unable to compress " << temp_file << " into " << gzip_filename << LL_ENDL;
+		LLInventoryCache::write(binary_filename, *snapshot, gzip_filename);
 	}
 }
 
@@ -2869,31 +2874,46 @@ bool LLInventoryModel::loadSkeleton(
 		changed_items_t categories_to_update;
 		item_array_t possible_broken_links;
 		cat_set_t invalid_categories; // Used to mark categories that weren't successfully loaded.
+		const std::string binary_filename = getInvCacheAddres(owner_id, true);
 		std::string inventory_filename = getInvCacheAddres(owner_id);
 		const S32 NO_VERSION = LLViewerInventoryCategory::VERSION_UNKNOWN;
 		std::string gzip_filename(inventory_filename);
 		gzip_filename.append(".gz");
-		LLFILE* fp = LLFile::fopen(gzip_filename, "rb");
 		bool remove_inventory_file = false;
-		if(fp)
-		{
-			fclose(fp);
-			fp = NULL;
-			if(gunzip_file(gzip_filename, inventory_filename))
-			{
-				// we only want to remove the inventory file if it was
-				// gzipped before we loaded, and we successfully
-				// gunziped it.
-				remove_inventory_file = true;
-			}
-			else
+		bool is_cache_obsolete = false;
+		bool is_binary_obsolete = false;
+		bool loaded = LLInventoryCache::read(binary_filename, categories, items, categories_to_update, is_binary_obsolete);
+		if (!loaded)
+		{
+			// Older viewers only left the notation cache behind, read it
+			// this once.  The next cache() replaces it with a binary one.
+			categories.clear();
+			items.clear();
+			categories_to_update.clear();
+			LLFILE* fp = LLFile::fopen(gzip_filename, "rb");
+			if(fp)
 			{
-				LL_INFOS(LOG_INV) << "Unable to gunzip " << gzip_filename << LL_ENDL;
+				fclose(fp);
+				fp = NULL;
+				if(gunzip_file(gzip_filename, inventory_filename))
+				{
+					// we only want to remove the inventory file if it was
+					// gzipped before we loaded, and we successfully
+					// gunziped it.
+					remove_inventory_file = true;
+				}
+				else
+				{
+					LL_INFOS(LOG_INV) << "Unable to gunzip " << gzip_filename << LL_ENDL;
+				}
 			}
+			loaded = loadFromFile(inventory_filename, categories, items, categories_to_update, is_cache_obsolete);
 		}
-		bool is_cache_obsolete = false;
-		if (loadFromFile(inventory_filename, categories, items, categories_to_update, is_cache_obsolete))
+		if (loaded)
 		{
+			mCategoryMap.reserve(mCategoryMap.size() + temp_cats.size());
+			mItemMap.reserve(mItemMap.size() + items.size());
+
 			// We were able to find a cache of files. So, use what we
 			// found to generate a set of categories we should add. We
 			// will go through each category loaded and if the version
@@ -3093,6 +3113,11 @@ bool LLInventoryModel::loadSkeleton(
 			LL_WARNS(LOG_INV) << "Inv cache out of date, removing" << LL_ENDL;
 			LLFile::remove(gzip_filename);
 		}
+		if (is_binary_obsolete)
+		{
+			LL_WARNS(LOG_INV) << "Binary inv cache out of date or damaged, removing" << LL_ENDL;
+			LLFile::remove(binary_filename);
+		}
 		categories.clear(); // will unref and delete entries
 	}
 
@@ -3599,85 +3624,6 @@ bool LLInventoryModel::loadFromFile(const std::string& filename,
 	return !is_cache_obsolete;	
 }
 
-// static
-bool LLInventoryModel::saveToFile(const std::string& filename,
-	const cat_array_t& categories,
-	const item_array_t& items)
-{
-	if (filename.empty())
-	{
-		LL_ERRS(LOG_INV) << "Filename is Null!" << LL_ENDL;
-		return false;
-	}
-
-	LL_INFOS(LOG_INV) << "saving inventory to: (" << filename << ")" << LL_ENDL;
-
-    try
-    {
-        llofstream fileXML(filename.c_str());
-        if (!fileXML.is_open())
-        {
-            LL_WARNS(LOG_INV) << "Failed to open file. Unable to save inventory to: " << filename << LL_ENDL;
-            return false;
-        }
-
-        LLSD cache_ver;
-        cache_ver["inv_cache_version"] = sCurrentInvCacheVersion;
-
-        if (fileXML.fail())
-        {
-            LL_WARNS(LOG_INV) << "Failed to write cache version to file. Unable to save inventory to: " << filename << LL_ENDL;
-            return false;
-        }
-
-        fileXML << LLSDOStreamer<LLSDNotationFormatter>(cache_ver) << std::endl;
-
-        S32 count = categories.size();
-        S32 cat_count = 0;
-        S32 i;
-        for (i = 0; i < count; ++i)
-        {
-            LLViewerInventoryCategory* cat = categories[i];
-            if (cat->getVersion() != LLViewerInventoryCategory::VERSION_UNKNOWN)
-            {
-                fileXML << LLSDOStreamer<LLSDNotationFormatter>(cat->exportLLSD()) << std::endl;
-                cat_count++;
-            }
-
-            if (fileXML.fail())
-            {
-                LL_WARNS(LOG_INV) << "Failed to write a folder to file. Unable to save inventory to: " << filename << LL_ENDL;
-                return false;
-            }
-        }
-
-        S32 it_count = items.size();
-        for (i = 0; i < it_count; ++i)
-        {
-            fileXML << LLSDOStreamer<LLSDNotationFormatter>(items[i]->asLLSD()) << std::endl;
-
-            if (fileXML.fail())
-            {
-                LL_WARNS(LOG_INV) << "Failed to write an item to file. Unable to save inventory to: " << filename << LL_ENDL;
-                return false;
-            }
-        }
-        fileXML.flush();
-
-        fileXML.close();
-
-        LL_INFOS(LOG_INV) << "Inventory saved: " << cat_count << " categories, " << it_count << " items." << LL_ENDL;
-    }
-    catch (...)
-    {
-        LOG_UNHANDLED_EXCEPTION("");
-        LL_INFOS(LOG_INV) << "Failed to save inventory to: (" << filename << ")" << LL_ENDL;
-        return false;
-    }
-
-    return true;
-}
-
 // message handling functionality
 // static
 void LLInventoryModel::registerCallbacks(LLMessageSystem* msg)
@@ -195,10 +195,13 @@ class LLInventoryModel
 	void buildParentChildMap(); // brute force method to rebuild the entire parent-child relations
 	void createCommonSystemCategories();
 
-	static std::string getInvCacheAddres(const LLUUID& owner_id);
+	// binary selects the memory mapped cache, see LLInventoryCache
+	static std::string getInvCacheAddres(const LLUUID& owner_id, bool binary = false);
 
-	// Call on logout to save a terse representation.
-	void cache(const LLUUID& parent_folder_id, const LLUUID& agent_id);
+	// Saves a terse representation, on logout and after a completed
+	// fetch.  The logout save must not be in_background, the General
+	// pool is already closed.
+	void cache(const LLUUID& parent_folder_id, const LLUUID& agent_id, bool in_background = false);
 private:
 	// Information for tracking the actual inventory. We index this
 	// information in a lot of different ways so we can access
@@ -687,14 +690,12 @@ class LLInventoryModel
 	// File I/O
 	//--------------------------------------------------------------------
 protected:
+	// Reads the notation cache older viewers wrote, only to migrate from it
 	static bool loadFromFile(const std::string& filename,
 							 cat_array_t& categories,
 							 item_array_t& items,
 							 changed_items_t& cats_to_update,
 							 bool& is_cache_obsolete); 
-	static bool saveToFile(const std::string& filename,
-						   const cat_array_t& categories,
-						   const item_array_t& items); 
 
 	//--------------------------------------------------------------------
 	// Message handling functionality
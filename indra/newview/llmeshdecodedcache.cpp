@@ -0,0 +1,262 @@
+/**
+ * @file llmeshdecodedcache.cpp
+ * @brief On disk cache of decoded mesh LODs.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llmeshdecodedcache.h"
+
+#include "llapp.h"
+#include "lldir.h"
+#include "lldiskcache.h"
+#include "llfile.h"
+#include "llmappedfile.h"
+#include "llvolume.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/range/iterator_range.hpp>
+
+namespace
+{
+	const std::string DECODED_MESH_EXT(".dmesh");
+	const std::string TEMP_EXT(".tmp");
+
+	// Leftovers of writes that never got renamed, older than any write in progress
+	const std::time_t TEMP_FILE_MAX_AGE = 60 * 60;
+
+	boost::filesystem::path to_path(const std::string& filename)
+	{
+#if LL_WINDOWS
+		return boost::filesystem::path(ll_convert_string_to_wide(filename));
+#else
+		return boost::filesystem::path(filename);
+#endif
+	}
+}
+
+LLMeshDecodedCache::LLMeshDecodedCache()
+:	mMaxBytes(0),
+	mBytes(0),
+	mTempCount(0),
+	mPurging(false)
+{
+}
+
+void LLMeshDecodedCache::init(const std::string& dir, U64 max_bytes)
+{
+	mDir = dir;
+	mMaxBytes = max_bytes;
+	if (mMaxBytes && !LLFile::isdir(mDir) && LLFile::mkdir(mDir) != 0 && !LLFile::isdir(mDir))
+	{
+		LL_WARNS("MeshCache") << "Unable to create decoded mesh cache directory " << mDir << LL_ENDL;
+		mMaxBytes = 0;
+	}
+}
+
+std::string LLMeshDecodedCache::getFilename(const LLVolumeParams& mesh_params, S32 lod) const
+{
+	// mirroring and inverting are applied while decoding
+	U8 flags = mesh_params.getSculptType() & (LL_SCULPT_FLAG_MIRROR | LL_SCULPT_FLAG_INVERT);
+	return mDir + gDirUtilp->getDirDelimiter() + mesh_params.getSculptID().asString()
+		+ llformat("_%d_%d_v%d", lod, flags, (S32)LLVolume::DECODED_FACES_VERSION) + DECODED_MESH_EXT;
+}
+
+bool LLMeshDecodedCache::has(const LLVolumeParams& mesh_params, S32 lod) const
+{
+	return isEnabled() && LLFile::isfile(getFilename(mesh_params, lod));
+}
+
+bool LLMeshDecodedCache::read(const LLVolumeParams& mesh_params, S32 lod, LLVolume* volume)
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_NETWORK;
+
+	if (!isEnabled())
+	{
+		return false;
+	}
+
+	const std::string filename = getFilename(mesh_params, lod);
+	LLMappedFile file;
+	if (!file.open(filename, 0, true))
+	{
+		return false;
+	}
+
+	const size_t size = file.getSize();
+	bool success = volume->unpackDecodedFaces(file.getData(), size);
+	file.close();
+
+	if (success)
+	{
+		LLDiskCache::updateFileAccessTime(to_path(filename));
+	}
+	else
+	{
+		LL_WARNS("MeshCache") << "Discarding bad decoded mesh cache entry " << filename << LL_ENDL;
+		if (LLFile::remove(filename, ENOENT) == 0)
+		{
+			U64 bytes = mBytes.load();
+			while (!mBytes.compare_exchange_weak(bytes, bytes - llmin((U64)size, bytes)))
+			{
+			}
+		}
+	}
+	return success;
+}
+
+void LLMeshDecodedCache::write(const LLVolumeParams& mesh_params, S32 lod, const LLVolume* volume)
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_NETWORK;
+
+	if (!isEnabled())
+	{
+		return;
+	}
+
+	std::vector<U8> data;
+	if (!volume->packDecodedFaces(data) || data.size() > mMaxBytes / 4)
+	{
+		return;
+	}
+
+	if (mBytes + data.size() > mMaxBytes)
+	{
+		// Trim well below the budget so that a full cache doesn't walk
+		// the directory on every write
+		purge(mMaxBytes / 4 * 3);
+		if (mBytes + data.size() > mMaxBytes)
+		{ // another thread is purging
+			return;
+		}
+	}
+
+	// Written under a unique name and renamed into place, so readers
+	// never map a partial file
+	const std::string filename = getFilename(mesh_params, lod);
+	const std::string temp_name = filename + llformat(".%u", mTempCount++) + TEMP_EXT;
+	LLFILE* fp = LLFile::fopen(temp_name, "wb");
+	if (!fp)
+	{
+		return;
+	}
+	bool written = fwrite(data.data(), 1, data.size(), fp) == data.size();
+	written = (LLFile::close(fp) == 0) && written;
+
+	if (written && LLFile::rename(temp_name, filename, ENOENT) == 0)
+	{
+		mBytes += data.size();
+	}
+	else
+	{
+		LLFile::remove(temp_name, ENOENT);
+	}
+}
+
+void LLMeshDecodedCache::purge(U64 target_bytes)
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_NETWORK;
+
+	if (!isEnabled() || mPurging.exchange(true))
+	{
+		return;
+	}
+
+	typedef std::pair<std::time_t, std::pair<uintmax_t, boost::filesystem::path>> file_info_t;
+	std::vector<file_info_t> file_info;
+
+	const std::time_t now = std::time(nullptr);
+	boost::system::error_code ec;
+	boost::filesystem::directory_iterator dir_iter(to_path(mDir), ec);
+	if (!ec.failed())
+	{
+		for (auto& entry : boost::make_iterator_range(dir_iter, {}))
+		{
+			if (!LLApp::isRunning())
+			{
+				mPurging = false;
+				return;
+			}
+
+			if (!boost::filesystem::is_regular_file(entry, ec) || ec.failed())
+			{
+				continue;
+			}
+
+			const std::string extension = entry.path().extension().string();
+			if (extension != DECODED_MESH_EXT && extension != TEMP_EXT)
+			{
+				continue;
+			}
+
+			const uintmax_t file_size = boost::filesystem::file_size(entry, ec);
+			if (ec.failed())
+			{
+				continue;
+			}
+			const std::time_t file_time = boost::filesystem::last_write_time(entry, ec);
+			if (ec.failed())
+			{
+				continue;
+			}
+
+			if (extension == TEMP_EXT)
+			{
+				if (now - file_time > TEMP_FILE_MAX_AGE)
+				{
+					boost::filesystem::remove(entry, ec);
+				}
+				continue;
+			}
+
+			file_info.push_back(file_info_t(file_time, { file_size, entry.path() }));
+		}
+	}
+
+	// most recently used first
+	std::sort(file_info.begin(), file_info.end(), [](const file_info_t& x, const file_info_t& y)
+		{
+			return x.first > y.first;
+		});
+
+	U64 kept_bytes = 0;
+	U32 removed = 0;
+	for (const file_info_t& entry : file_info)
+	{
+		if (kept_bytes + entry.second.first <= target_bytes)
+		{
+			kept_bytes += entry.second.first;
+		}
+		else
+		{
+			boost::filesystem::remove(entry.second.second, ec);
+			++removed;
+		}
+	}
+
+	mBytes = kept_bytes;
+	mPurging = false;
+
+	LL_INFOS("MeshCache") << "Decoded mesh cache holds " << kept_bytes / 1024 << " KB in " << file_info.size() - removed
+						  << " files after removing " << removed << LL_ENDL;
+}
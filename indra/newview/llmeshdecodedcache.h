@@ -0,0 +1,73 @@
+/**
+ * @file llmeshdecodedcache.h
+ * @brief On disk cache of decoded mesh LODs.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMESHDECODEDCACHE_H
+#define LL_LLMESHDECODEDCACHE_H
+
+#include <atomic>
+
+class LLVolume;
+class LLVolumeParams;
+
+// Mesh LODs as LLVolume::packDecodedFaces() lays them out, one file per
+// LOD next to the asset cache.  The asset cache keeps the compressed
+// LLSD the mesh came as; loading from here instead skips the inflate,
+// the LLSD parse, the tangent generation and the vertex cache
+// optimization, leaving a map and a copy.
+//
+// Safe to call from any thread once init() has returned.
+class LLMeshDecodedCache
+{
+public:
+	LLMeshDecodedCache();
+
+	// A max_bytes of 0 disables the cache
+	void init(const std::string& dir, U64 max_bytes);
+	bool isEnabled() const { return mMaxBytes > 0; }
+
+	// Deletes the least recently used files until the cache fits in
+	// target_bytes.  Walks the directory, keep it off the main thread.
+	void purge(U64 target_bytes);
+	U64 getMaxBytes() const { return mMaxBytes; }
+
+	bool has(const LLVolumeParams& mesh_params, S32 lod) const;
+
+	// Fills volume from the cache.  Entries that fail to load are deleted.
+	bool read(const LLVolumeParams& mesh_params, S32 lod, LLVolume* volume);
+
+	// Adds a freshly decoded volume, trimming the cache first if it is full
+	void write(const LLVolumeParams& mesh_params, S32 lod, const LLVolume* volume);
+
+private:
+	std::string getFilename(const LLVolumeParams& mesh_params, S32 lod) const;
+
+	std::string			mDir;
+	U64					mMaxBytes;
+	std::atomic<U64>	mBytes;			// estimate, exact after a purge
+	std::atomic<U32>	mTempCount;
+	std::atomic<bool>	mPurging;
+};
+
+#endif // LL_LLMESHDECODEDCACHE_H
@@ -46,6 +46,8 @@
 #include "llsdserialize.h"
 #include "llthread.h"
 #include "llfilesystem.h"
+#include "llmeshdecodedcache.h"
+#include "threadpool.h"
 #include "llviewercontrol.h"
 #include "llviewerinventory.h"
 #include "llviewermenufile.h"
@@ -109,6 +111,7 @@
 //
 //   main     Main rendering thread, very sensitive to locking and other stalls
 //   repo     Overseeing worker thread associated with the LLMeshRepoThread class
+//   decode   MeshDecode pool threads:  decode LOD and skin info assets for repo
 //   decom    Worker thread for mesh decomposition requests
 //   core     HTTP worker thread:  does the work but doesn't intrude here
 //   uploadN  0-N temporary mesh upload threads (0-1 in practice)
@@ -130,9 +133,11 @@
 //         other mesh requests may be made
 //         ...
 //         notifyLoadedMeshes() invoked to stage work
+//           rescore waiting requests, cancel unwanted ones
+//           hand changed scores to the schedules under mMutex
 //           append HeaderRequest to mHeaderReqQ
 //         ...
-//                             scan mHeaderReqQ
+//                             pop best of mHeaderReqQ
 //                             issue 4096-byte GET for header
 //                             ...
 //                             onCompleted() invoked for GET
@@ -143,15 +148,24 @@
 //                                 scan mPendingLOD for LOD request
 //                                 push LODRequest to mLODReqQ
 //                             ...
-//                             scan mLODReqQ
+//                             pop best of mLODReqQ
 //                             fetchMeshLOD() invoked
 //                               issue Byte-Range GET for LOD
 //                             ...
 //                             onCompleted() invoked for GET
 //                               data copied
-//                               lodReceived() invoked
-//                                 unpack data into LLVolume
-//                                 append LoadedMesh to mLoadedQ
+//                               postLODDecode() invoked
+//                             ...
+//                                                  decode thread
+//                                                  lodReceived() invoked
+//                                                    unpack data into LLVolume
+//                                                    decoded faces written to mDecodedCache
+//                                                    append LoadedMesh to mLoadedQ
+//                                                  data written to cache
+//
+//   A LOD found in mDecodedCache skips the GET and the unpack:
+//   fetchMeshLOD() calls postDecodedLODLoad(), which copies the mapped
+//   faces into an LLVolume on the decode pool and appends it to mLoadedQ.
 //                             ...
 //         notifyLoadedMeshes() invoked again
 //           scan mLoadedQ
@@ -222,13 +236,18 @@
 //     sLODPending                     mMeshMutex [4]  rw.main.mMeshMutex
 //     sLODProcessing                  Repo::mMutex    rw.any.Repo::mMutex
 //     sCacheBytesRead                 none            rw.repo.none, ro.main.none [1]
-//     sCacheBytesWritten              "
-//     sCacheReads                     "
-//     sCacheWrites                    "
+//     sCacheBytesWritten              Repo::mMutex    rw.decode.Repo::mMutex, ro.main.none [1]
+//     sCacheReads                     none            rw.repo.none, ro.main.none [1]
+//     sCacheWrites                    Repo::mMutex    rw.decode.Repo::mMutex, ro.main.none [1]
 //     mLoadingMeshes                  mMeshMutex [4]  rw.main.none, rw.any.mMeshMutex
 //     mSkinMap                        none            rw.main.none
 //     mDecompositionMap               none            rw.main.none
 //     mPendingRequests                mMeshMutex [4]  rw.main.mMeshMutex
+//     mCancelledRequests              mMeshMutex [4]  rw.main.none, rw.main.mMeshMutex
+//     mLODScores                      mMeshMutex [4]  rw.main.mMeshMutex
+//     mHeaderScores                   "
+//     mLODScoreUpdates                "
+//     mHeaderScoreUpdates             "
 //     mLoadingSkins                   mMeshMutex [4]  rw.main.mMeshMutex
 //     mPendingSkinRequests            mMeshMutex [4]  rw.main.mMeshMutex
 //     mLoadingDecompositions          mMeshMutex [4]  rw.main.mMeshMutex
@@ -256,7 +275,9 @@
 //     mHeaderReqQ              mMutex        ro.repo.none [5], rw.repo.mMutex, rw.any.mMutex
 //     mLODReqQ                 mMutex        ro.repo.none [5], rw.repo.mMutex, rw.any.mMutex
 //     mUnavailableQ            mMutex        rw.repo.none [0], ro.main.none [5], rw.main.mMutex
-//     mLoadedQ                 mMutex        rw.repo.mMutex, ro.main.none [5], rw.main.mMutex
+//     mLoadedQ                 mMutex        rw.decode.mMutex, ro.main.none [5], rw.main.mMutex
+//     mDecodeTimes             mMutex        rw.decode.mMutex, rw.main.mMutex
+//     mDecodedCache            none          rw.repo.none, rw.decode.none (internally thread safe)
 //     mPendingLOD              mMutex        rw.repo.mMutex, rw.any.mMutex
 //     mGetMeshCapability       mMutex        rw.main.mMutex, ro.repo.mMutex (was:  [0])
 //     mGetMesh2Capability      mMutex        rw.main.mMutex, ro.repo.mMutex (was:  [0])
@@ -429,6 +450,34 @@ const std::array<std::string, 4> header_lod =
 
 const char * const LOG_MESH = "Mesh";
 
+static LLTrace::SampleStatHandle<> sMeshDecodeQueue("mesh_decode_queue", "Mesh assets waiting for a decode thread");
+static LLTrace::EventStatHandle<F64Milliseconds> sMeshDecodeLatency("mesh_decode_latency", "Time from a mesh asset arriving to it being decoded");
+static LLTrace::EventStatHandle<F64Milliseconds> sMeshDecodeTime("mesh_decode_time", "Time a decode thread spends on one mesh asset");
+
+// Skin info is small and holds up whole avatars, so it goes ahead of LODs,
+// whose priority is their screen space score
+static const F32 SKIN_INFO_DECODE_PRIORITY = 1000.f;
+
+// Write data fetched from the sim into the cache file for mesh_id, once it is
+// known to decode.
+static void write_mesh_cache(LLMutex* mutex, const LLUUID& mesh_id, S32 offset, const std::vector<U8>& data)
+{
+	// <FS:Ansariel> Fix asset caching
+	//LLFileSystem file(mesh_id, LLAssetType::AT_MESH, LLFileSystem::WRITE);
+	LLFileSystem file(mesh_id, LLAssetType::AT_MESH, LLFileSystem::READ_WRITE);
+
+	S32 size = (S32)data.size();
+	if (file.getSize() >= offset + size)
+	{
+		file.seek(offset);
+		file.write(data.data(), size);
+
+		LLMutexLock lock(mutex);
+		LLMeshRepository::sCacheBytesWritten += size;
+		++LLMeshRepository::sCacheWrites;
+	}
+}
+
 // Static data and functions to measure mesh load
 // time metrics for a new region scene.
 static unsigned int metrics_teleport_start_count = 0;
@@ -640,9 +689,10 @@ class LLMeshLODHandler : public LLMeshHandlerBase
 {
 public:
 	LOG_CLASS(LLMeshLODHandler);
-	LLMeshLODHandler(const LLVolumeParams & mesh_params, S32 lod, U32 offset, U32 requested_bytes)
+	LLMeshLODHandler(const LLVolumeParams & mesh_params, S32 lod, F32 score, U32 offset, U32 requested_bytes)
 		: LLMeshHandlerBase(offset, requested_bytes),
-		  mLOD(lod)
+		  mLOD(lod),
+		  mScore(score)
 	{
 			mMeshParams = mesh_params;
 			LLMeshRepoThread::incActiveLODRequests();
@@ -657,6 +707,7 @@ class LLMeshLODHandler : public LLMeshHandlerBase
 
 public:
 	S32 mLOD;
+	F32 mScore;
 };
 
 
@@ -841,6 +892,18 @@ LLMeshRepoThread::LLMeshRepoThread()
 	mHttpPolicyClass = app_core_http.getPolicy(LLAppCoreHttp::AP_MESH2);
 	mHttpLegacyPolicyClass = app_core_http.getPolicy(LLAppCoreHttp::AP_MESH1);
 	mHttpLargePolicyClass = app_core_http.getPolicy(LLAppCoreHttp::AP_LARGE_MESH);
+
+	mDecodePool = std::make_unique<LL::PriorityThreadPool>("MeshDecode", 2);
+	mDecodePool->start();
+
+	mDecodedCache = std::make_unique<LLMeshDecodedCache>();
+	mDecodedCache->init(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "mesh_decoded"),
+						(U64)gSavedSettings.getU32("AlchemyMeshDecodedCacheSize") * 1024 * 1024);
+	if (mDecodedCache->isEnabled())
+	{ // trim to size behind any decodes
+		LLMeshDecodedCache* cache = mDecodedCache.get();
+		mDecodePool->getQueue().post([cache]() { cache->purge(cache->getMaxBytes()); }, -1.f);
+	}
 }
 
 
@@ -851,6 +914,10 @@ LLMeshRepoThread::~LLMeshRepoThread()
 					   << ", Max Lock Holdoffs:  " << LLMeshRepository::sMaxLockHoldoffs
 					   << LL_ENDL;
 
+	// decodes in flight use this thread's queues and mutexes
+	mDecodePool->close();
+	mDecodePool.reset();
+
 	mHttpRequestSet.clear();
     mHttpHeaders.reset();
 
@@ -913,7 +980,7 @@ void LLMeshRepoThread::run()
 
         if (!mLODReqQ.empty() && mHttpRequestSet.size() < sRequestHighWater)
         {
-            std::list<LODRequest> incomplete;
+            std::list<std::pair<LODRequest, F32>> incomplete;
             while (!mLODReqQ.empty() && mHttpRequestSet.size() < sRequestHighWater)
             {
                 if (!mMutex)
@@ -922,22 +989,28 @@ void LLMeshRepoThread::run()
                 }
 
                 mMutex->lock();
-                LODRequest req = mLODReqQ.front();
-                mLODReqQ.pop();
+                if (mLODReqQ.empty())
+                { // cancelled by the main thread since the check
+                    mMutex->unlock();
+                    break;
+                }
+                F32 priority;
+                LODRequest req = mLODReqQ.pop(&priority);
                 LLMeshRepository::sLODProcessing--;
                 mMutex->unlock();
+                req.mScore = priority;
                 if (req.isDelayed())
                 {
                     // failed to load before, wait a bit
-                    incomplete.push_front(req);
+                    incomplete.emplace_front(req, priority);
                 }
-                else if (!fetchMeshLOD(req.mMeshParams, req.mLOD, req.canRetry()))
+                else if (!fetchMeshLOD(req.mMeshParams, req.mLOD, req.canRetry(), req.mScore, req.mSkipCache))
                 {
                     if (req.canRetry())
                     {
                         // failed, resubmit
                         req.updateTime();
-                        incomplete.push_front(req);
+                        incomplete.emplace_front(req, priority);
                     }
                     else
                     {
@@ -952,17 +1025,20 @@ void LLMeshRepoThread::run()
             if (!incomplete.empty())
             {
                 LLMutexLock locker(mMutex);
-                for (std::list<LODRequest>::iterator iter = incomplete.begin(); iter != incomplete.end(); iter++)
+                for (const auto& pending : incomplete)
                 {
-                    mLODReqQ.push(*iter);
-                    ++LLMeshRepository::sLODProcessing;
+                    const LODRequest& req = pending.first;
+                    if (mLODReqQ.push(lod_key_t(req.mMeshParams.getSculptID(), req.mLOD), req, pending.second))
+                    {
+                        ++LLMeshRepository::sLODProcessing;
+                    }
                 }
             }
         }
 
         if (!mHeaderReqQ.empty() && mHttpRequestSet.size() < sRequestHighWater)
         {
-            std::list<HeaderRequest> incomplete;
+            std::list<std::pair<HeaderRequest, F32>> incomplete;
             while (!mHeaderReqQ.empty() && mHttpRequestSet.size() < sRequestHighWater)
             {
                 if (!mMutex)
@@ -971,13 +1047,18 @@ void LLMeshRepoThread::run()
                 }
 
                 mMutex->lock();
-                HeaderRequest req = mHeaderReqQ.front();
-                mHeaderReqQ.pop();
+                if (mHeaderReqQ.empty())
+                {
+                    mMutex->unlock();
+                    break;
+                }
+                F32 priority;
+                HeaderRequest req = mHeaderReqQ.pop(&priority);
                 mMutex->unlock();
                 if (req.isDelayed())
                 {
                     // failed to load before, wait a bit
-                    incomplete.push_front(req);
+                    incomplete.emplace_front(req, priority);
                 }
                 else if (!fetchMeshHeader(req.mMeshParams, req.canRetry()))
                 {
@@ -985,7 +1066,7 @@ void LLMeshRepoThread::run()
                     {
                         //failed, resubmit
                         req.updateTime();
-                        incomplete.push_front(req);
+                        incomplete.emplace_front(req, priority);
                     }
                     else
                     {
@@ -997,9 +1078,9 @@ void LLMeshRepoThread::run()
             if (!incomplete.empty())
             {
                 LLMutexLock locker(mMutex);
-                for (std::list<HeaderRequest>::iterator iter = incomplete.begin(); iter != incomplete.end(); iter++)
+                for (const auto& pending : incomplete)
                 {
-                    mHeaderReqQ.push(*iter);
+                    mHeaderReqQ.push(pending.first.mMeshParams.getSculptID(), pending.first, pending.second);
                 }
             }
         }
@@ -1020,7 +1101,7 @@ void LLMeshRepoThread::run()
 				{
 					incomplete.emplace_back(req);
 				}
-				else if (!fetchMeshSkinInfo(req.mId, req.canRetry()))
+				else if (!fetchMeshSkinInfo(req.mId, req.canRetry(), req.mSkipCache))
 				{
 					if (req.canRetry())
 					{
@@ -1164,7 +1245,7 @@ void LLMeshRepoThread::lockAndLoadMeshLOD(const LLVolumeParams& mesh_params, S32
 	}
 }
 
-void LLMeshRepoThread::loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
+void LLMeshRepoThread::loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod, F32 score)
 { //could be called from any thread
 	const LLUUID& mesh_id = mesh_params.getSculptID();
 	LLMutexLock header_lock(mHeaderMutex);
@@ -1173,11 +1254,13 @@ void LLMeshRepoThread::loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
 	{ //if we have the header, request LOD byte range
 		header_lock.unlock();
 
-		LODRequest req(mesh_params, lod);
+		LODRequest req(mesh_params, lod, score);
 		{
 			LLMutexLock lock(mMutex);
-			mLODReqQ.push(req);
-			LLMeshRepository::sLODProcessing++;
+			if (mLODReqQ.push(lod_key_t(mesh_id, lod), req, score))
+			{
+				LLMeshRepository::sLODProcessing++;
+			}
 		}
 	}
 	else
@@ -1190,17 +1273,38 @@ void LLMeshRepoThread::loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
 
 		if (pending != mPendingLOD.end())
 		{ //append this lod request to existing header request
-			pending->second.emplace_back(lod);
+			if (std::find(pending->second.begin(), pending->second.end(), lod) == pending->second.end())
+			{
+				pending->second.emplace_back(lod);
+			}
 			llassert(pending->second.size() <= LLModel::NUM_LODS);
+			// no-op if the header is already in flight
+			mHeaderReqQ.raisePriority(mesh_id, score);
 		}
 		else
 		{ //if no header request is pending, fetch header
-			mHeaderReqQ.push(req);
+			mHeaderReqQ.push(mesh_id, req, score);
 			mPendingLOD[mesh_id].emplace_back(lod);
 		}
 	}
 }
 
+// Mutex:  must be holding mMutex when called
+void LLMeshRepoThread::cancelLOD(const LLUUID& mesh_id, S32 lod)
+{
+	if (mLODReqQ.cancel(lod_key_t(mesh_id, lod)))
+	{
+		LLMeshRepository::sLODProcessing--;
+	}
+
+	pending_lod_map::iterator pending = mPendingLOD.find(mesh_id);
+	if (pending != mPendingLOD.end())
+	{ // still fetch the header, it's small and other requests want it
+		auto& lods = pending->second;
+		lods.erase(std::remove(lods.begin(), lods.end(), lod), lods.end());
+	}
+}
+
 // Mutex:  must be holding mMutex when called
 void LLMeshRepoThread::setGetMeshCap(const std::string & mesh_cap, const std::string & legacy_get_mesh1,
 																	const std::string & legacy_get_mesh2,
@@ -1317,7 +1421,7 @@ LLCore::HttpHandle LLMeshRepoThread::getByteRange(const std::string & url, int l
 	return handle;
 }
 
-bool LLMeshRepoThread::loadInfoFromFilesystem(const LLUUID& mesh_id, MeshHeaderInfo& info, boost::function<bool(const LLUUID&, U8*, S32)> fn)
+bool LLMeshRepoThread::loadInfoFromFilesystem(const LLUUID& mesh_id, MeshHeaderInfo& info, boost::function<EMeshProcessingResult(const LLUUID&, U8*, S32)> fn)
 {
 	//check cache for mesh skin info
 	LLFileSystem file(mesh_id, LLAssetType::AT_MESH);
@@ -1352,7 +1456,7 @@ bool LLMeshRepoThread::loadInfoFromFilesystem(const LLUUID& mesh_id, MeshHeaderI
 	return false;
 }
 
-bool LLMeshRepoThread::fetchMeshSkinInfo(const LLUUID& mesh_id, bool can_retry)
+bool LLMeshRepoThread::fetchMeshSkinInfo(const LLUUID& mesh_id, bool can_retry, bool skip_cache)
 {
 	MeshHeaderInfo info;
 	{
@@ -1383,7 +1487,11 @@ bool LLMeshRepoThread::fetchMeshSkinInfo(const LLUUID& mesh_id, bool can_retry)
 	if (info.mVersion <= MAX_MESH_VERSION && info.mOffset >= 0 && info.mSize > 0)
 	{
 		//check cache for mesh skin info
-		if (loadInfoFromFilesystem(mesh_id, info, boost::bind(&LLMeshRepoThread::skinInfoReceived, this, _1, _2, _3)))
+		if (!skip_cache && loadInfoFromFilesystem(mesh_id, info, [this](const LLUUID& id, U8* data, S32 data_size)
+				{
+					postSkinInfoDecode(id, data, data_size, -1);
+					return MESH_OK;
+				}))
 			return true;
 
 		//reading from cache failed for whatever reason, fetch from sim
@@ -1656,7 +1764,7 @@ bool LLMeshRepoThread::fetchMeshHeader(const LLVolumeParams& mesh_params, bool c
 }
 
 //return false if failed to get mesh lod.
-bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod, bool can_retry)
+bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod, bool can_retry, F32 score, bool skip_cache)
 {
 	const LLUUID& mesh_id = mesh_params.getSculptID();
 	MeshHeaderInfo info;
@@ -1687,7 +1795,18 @@ bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod,
 			
 	if(info.mVersion <= MAX_MESH_VERSION && info.mOffset >= 0 && info.mSize > 0)
 	{
-		if (loadInfoFromFilesystem(mesh_id, info, boost::bind(&LLMeshRepoThread::lodReceived, this, mesh_params, lod, _2, _3 )))
+		if (!skip_cache && mDecodedCache->has(mesh_params, lod))
+		{
+			++LLMeshRepository::sCacheReads;
+			postDecodedLODLoad(mesh_params, lod, score);
+			return true;
+		}
+
+		if (!skip_cache && loadInfoFromFilesystem(mesh_id, info, [&](const LLUUID&, U8* data, S32 data_size)
+				{
+					postLODDecode(mesh_params, lod, score, data, data_size, -1);
+					return MESH_OK;
+				}))
 			return true;
 
 		//reading from cache failed for whatever reason, fetch from sim
@@ -1699,7 +1818,7 @@ bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod,
 		{
 			LL_DEBUGS(LOG_MESH) << "Mesh/Cache: Mesh body for ID " << mesh_id << " - was retrieved from the simulator." << LL_ENDL;
 
-			auto handler = std::make_shared<LLMeshLODHandler>(mesh_params, lod, info.mOffset, info.mSize);
+			auto handler = std::make_shared<LLMeshLODHandler>(mesh_params, lod, score, info.mOffset, info.mSize);
 			LLCore::HttpHandle handle = getByteRange(http_url, legacy_cap_version, info.mOffset, info.mSize, handler);
 			if (LLCORE_HTTP_HANDLE_INVALID == handle)
 			{
@@ -1736,6 +1855,125 @@ bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod,
 	return true;
 }
 
+void LLMeshRepoThread::postDecode(F32 priority, const std::function<void()>& decode)
+{
+	F64 posted = LLTimer::getTotalSeconds();
+	mDecodePool->getQueue().post([this, posted, decode]()
+		{
+			if (LLApp::isExiting())
+			{
+				return;
+			}
+
+			F64 start = LLTimer::getTotalSeconds();
+			decode();
+			F64 done = LLTimer::getTotalSeconds();
+
+			LLMutexLock lock(mMutex);
+			mDecodeTimes.emplace_back(F32(done - posted), F32(done - start));
+		}, priority);
+}
+
+size_t LLMeshRepoThread::getDecodeQueueSize()
+{
+	return mDecodePool ? mDecodePool->getQueue().size() : 0;
+}
+
+void LLMeshRepoThread::postDecodedLODLoad(const LLVolumeParams& mesh_params, S32 lod, F32 score)
+{
+	postDecode(score, [this, mesh_params, lod, score]()
+		{
+			LLPointer<LLVolume> volume = new LLVolume(mesh_params, LLVolumeLODGroup::getVolumeScaleFromDetail(lod));
+			if (mDecodedCache->read(mesh_params, lod, volume) && volume->getNumFaces() > 0)
+			{
+				LoadedMesh mesh(volume, mesh_params, lod);
+				LLMutexLock lock(mMutex);
+				mLoadedQ.push_back(mesh);
+				// see lodReceived(), release our references under the lock
+				volume = NULL;
+				mesh.mVolume = NULL;
+				return;
+			}
+
+			// the entry is gone now, go through the asset cache
+			LODRequest req(mesh_params, lod, score);
+			LLMutexLock lock(mMutex);
+			if (mLODReqQ.push(lod_key_t(mesh_params.getSculptID(), lod), req, score))
+			{
+				++LLMeshRepository::sLODProcessing;
+			}
+		});
+}
+
+void LLMeshRepoThread::postLODDecode(const LLVolumeParams& mesh_params, S32 lod, F32 score, const U8* data, S32 data_size, S32 write_offset)
+{
+	auto buffer = std::make_shared<std::vector<U8>>(data, data + data_size);
+	postDecode(score, [this, mesh_params, lod, score, buffer, write_offset]()
+		{
+			EMeshProcessingResult result = lodReceived(mesh_params, lod, buffer->data(), (S32)buffer->size());
+			if (result == MESH_OK)
+			{
+				if (write_offset >= 0)
+				{ // good fetch from sim, write to cache
+					write_mesh_cache(mMutex, mesh_params.getSculptID(), write_offset, *buffer);
+				}
+			}
+			else if (write_offset < 0)
+			{ // bad cache entry, fetch from sim
+				LODRequest req(mesh_params, lod, score);
+				req.mSkipCache = true;
+
+				LLMutexLock lock(mMutex);
+				if (mLODReqQ.push(lod_key_t(mesh_params.getSculptID(), lod), req, score))
+				{
+					++LLMeshRepository::sLODProcessing;
+				}
+			}
+			else
+			{
+				LL_WARNS(LOG_MESH) << "Error during mesh LOD processing.  ID:  " << mesh_params.getSculptID()
+								   << ", Reason: " << result
+								   << " LOD: " << lod
+								   << " Data size: " << buffer->size()
+								   << " Not retrying."
+								   << LL_ENDL;
+				LLMutexLock lock(mMutex);
+				mUnavailableQ.emplace_back(mesh_params, lod);
+			}
+		});
+}
+
+void LLMeshRepoThread::postSkinInfoDecode(const LLUUID& mesh_id, const U8* data, S32 data_size, S32 write_offset)
+{
+	auto buffer = std::make_shared<std::vector<U8>>(data, data + data_size);
+	postDecode(SKIN_INFO_DECODE_PRIORITY, [this, mesh_id, buffer, write_offset]()
+		{
+			if (skinInfoReceived(mesh_id, buffer->data(), (S32)buffer->size()) == MESH_OK)
+			{
+				if (write_offset >= 0)
+				{ // good fetch from sim, write to cache
+					write_mesh_cache(mMutex, mesh_id, write_offset, *buffer);
+				}
+			}
+			else if (write_offset < 0)
+			{ // bad cache entry, fetch from sim
+				UUIDBasedRequest req(mesh_id);
+				req.mSkipCache = true;
+
+				LLMutexLock lock(mMutex);
+				mSkinReqQ.push(req);
+			}
+			else
+			{
+				LL_WARNS(LOG_MESH) << "Error during mesh skin info processing.  ID:  " << mesh_id
+								   << ", Unknown reason.  Not retrying."
+								   << LL_ENDL;
+				LLMutexLock lock(mMutex);
+				mSkinUnavailableQ.emplace_back(mesh_id);
+			}
+		});
+}
+
 EMeshProcessingResult LLMeshRepoThread::headerReceived(const LLVolumeParams& mesh_params, U8* data, S32 data_size)
 {
 	const LLUUID& mesh_id = mesh_params.getSculptID();
@@ -1800,11 +2038,14 @@ EMeshProcessingResult LLMeshRepoThread::headerReceived(const LLVolumeParams& mes
 		pending_lod_map::iterator iter = mPendingLOD.find(mesh_id);
 		if (iter != mPendingLOD.end())
 		{
+			// the main thread sets their priority on its next update
 			for (U32 i = 0; i < iter->second.size(); ++i)
 			{
 				LODRequest req(mesh_params, iter->second[i]);
-				mLODReqQ.push(req);
-				LLMeshRepository::sLODProcessing++;
+				if (mLODReqQ.push(lod_key_t(mesh_id, iter->second[i]), req, 0.f))
+				{
+					LLMeshRepository::sLODProcessing++;
+				}
 			}
 			mPendingLOD.erase(iter);
 		}
@@ -1825,6 +2066,9 @@ EMeshProcessingResult LLMeshRepoThread::lodReceived(const LLVolumeParams& mesh_p
 	{
 		if (volume->getNumFaces() > 0)
 		{
+			// before handing the volume to the main thread
+			mDecodedCache->write(mesh_params, lod, volume);
+
 			LoadedMesh mesh(volume, mesh_params, lod);
 			{
 				LLMutexLock lock(mMutex);
@@ -2766,6 +3010,7 @@ void LLMeshRepoThread::notifyLoadedMeshes()
 	std::deque<UUIDBasedRequest> skin_info_unavail_q;
 	std::deque<std::unique_ptr<LLModel::Decomposition>> decomp_q;
 	std::deque<std::unique_ptr<LLModel::Decomposition>> physics_q;
+	std::vector<std::pair<F32, F32>> decode_times;
 	{
 		LLMutexLock mtx_lock(mMutex);
 		if (!mLoadedQ.empty())
@@ -2797,7 +3042,16 @@ void LLMeshRepoThread::notifyLoadedMeshes()
 		{
 			physics_q.swap(mPhysicsQ);
 		}
+
+		decode_times.swap(mDecodeTimes);
+	}
+
+	for (const auto& times : decode_times)
+	{
+		record(sMeshDecodeLatency, F32Seconds(times.first));
+		record(sMeshDecodeTime, F32Seconds(times.second));
 	}
+	sample(sMeshDecodeQueue, (F64) getDecodeQueueSize());
 
 
 	if (!loaded_queue.empty())
@@ -3072,7 +3326,7 @@ LLMeshHeaderHandler::~LLMeshHeaderHandler()
 			LL_WARNS(LOG_MESH) << "Mesh header fetch canceled unexpectedly, retrying." << LL_ENDL;
 			LLMeshRepoThread::HeaderRequest req(mMeshParams);
 			LLMutexLock lock(gMeshRepo.mThread->mMutex);
-			gMeshRepo.mThread->mHeaderReqQ.push(req);
+			gMeshRepo.mThread->mHeaderReqQ.push(mMeshParams.getSculptID(), req, 0.f);
 		}
 		LLMeshRepoThread::decActiveHeaderRequests();
 	}
@@ -3235,36 +3489,8 @@ void LLMeshLODHandler::processData(LLCore::BufferArray * /* body */, S32 /* body
 	if ((!MESH_LOD_PROCESS_FAILED)
 		&& ((data != NULL) == (data_size > 0))) // if we have data but no size or have size but no data, something is wrong
 	{
-		EMeshProcessingResult result = gMeshRepo.mThread->lodReceived(mMeshParams, mLOD, data, data_size);
-		if (result == MESH_OK)
-		{
-			// good fetch from sim, write to cache
-			// <FS:Ansariel> Fix asset caching
-			//LLFileSystem file(mMeshParams.getSculptID(), LLAssetType::AT_MESH, LLFileSystem::WRITE);
-			LLFileSystem file(mMeshParams.getSculptID(), LLAssetType::AT_MESH, LLFileSystem::READ_WRITE);
-
-			S32 offset = mOffset;
-			S32 size = mRequestedBytes;
-
-			if (file.getSize() >= offset+size)
-			{
-				file.seek(offset);
-				file.write(data, size);
-				LLMeshRepository::sCacheBytesWritten += size;
-				++LLMeshRepository::sCacheWrites;
-			}
-		}
-		else
-		{
-			LL_WARNS(LOG_MESH) << "Error during mesh LOD processing.  ID:  " << mMeshParams.getSculptID()
-							   << ", Reason: " << result
-							   << " LOD: " << mLOD
-							   << " Data size: " << data_size
-							   << " Not retrying."
-							   << LL_ENDL;
-			LLMutexLock lock(gMeshRepo.mThread->mMutex);
-			gMeshRepo.mThread->mUnavailableQ.emplace_back(mMeshParams, mLOD);
-		}
+		// decoded and, if good, written to cache on the decode pool
+		gMeshRepo.mThread->postLODDecode(mMeshParams, mLOD, mScore, data, data_size, mOffset);
 	}
 	else
 	{
@@ -3300,24 +3526,10 @@ void LLMeshSkinInfoHandler::processData(LLCore::BufferArray * /* body */, S32 /*
 										U8 * data, S32 data_size)
 {
 	if ((!MESH_SKIN_INFO_PROCESS_FAILED)
-		&& ((data != NULL) == (data_size > 0)) // if we have data but no size or have size but no data, something is wrong
-		&& gMeshRepo.mThread->skinInfoReceived(mMeshID, data, data_size) == MESH_OK)
+		&& ((data != NULL) == (data_size > 0))) // if we have data but no size or have size but no data, something is wrong
 	{
-		// good fetch from sim, write to cache
-		// <FS:Ansariel> Fix asset caching
-		//LLFileSystem file(mMeshID, LLAssetType::AT_MESH, LLFileSystem::WRITE);
-		LLFileSystem file(mMeshID, LLAssetType::AT_MESH, LLFileSystem::READ_WRITE);
-
-		S32 offset = mOffset;
-		S32 size = mRequestedBytes;
-
-		if (file.getSize() >= offset+size)
-		{
-			LLMeshRepository::sCacheBytesWritten += size;
-			++LLMeshRepository::sCacheWrites;
-			file.seek(offset);
-			file.write(data, size);
-		}
+		// decoded and, if good, written to cache on the decode pool
+		gMeshRepo.mThread->postSkinInfoDecode(mMeshID, data, data_size, mOffset);
 	}
 	else
 	{
@@ -3538,8 +3750,9 @@ S32 LLMeshRepository::update()
 
 void LLMeshRepository::unregisterMesh(LLVOVolume* vobj, const LLUUID& mesh_id)
 {
-	for (auto& lod : mLoadingMeshes)
+	for (S32 i = 0; i < LLVolumeLODGroup::NUM_LODS; ++i)
 	{
+		auto& lod = mLoadingMeshes[i];
 		auto it = lod.find(mesh_id);
 		if(it != lod.end())
 		{
@@ -3548,6 +3761,7 @@ void LLMeshRepository::unregisterMesh(LLVOVolume* vobj, const LLUUID& mesh_id)
 			if (it->second.empty())
 			{
 				lod.erase(it);
+				mCancelledRequests.emplace_back(mesh_id, i);
 			}
 		}
 	}
@@ -3657,6 +3871,176 @@ S32 LLMeshRepository::loadMesh(LLVOVolume* vobj, const LLVolumeParams& mesh_para
 	return detail;
 }
 
+// Screen space size of the biggest object waiting for a mesh: radius over
+// distance, which goes as the square root of the pixel area.  Objects
+// waiting for a mesh have no faces yet so their own pixel area is of no
+// use here.  Objects out of view score in (-1, 0), below everything in
+// view but still nearest and biggest first.
+static F32 get_mesh_score(const boost::unordered_flat_set<LLVOVolume*>& objects)
+{
+	F32 max_score = -1.f;
+	for (LLVOVolume* vobj : objects)
+	{
+		if (LLDrawable* drawable = vobj->mDrawable)
+		{
+			F32 cur_score = drawable->getRadius() / llmax(drawable->mDistanceWRTCamera, 1.f);
+			if (!drawable->isRecentlyVisible())
+			{
+				cur_score = cur_score / (1.f + cur_score) - 1.f;
+			}
+			max_score = llmax(max_score, cur_score);
+		}
+	}
+	return max_score;
+}
+
+// Reordering a schedule for a smaller relative move than this isn't
+// worth the repo thread's lock
+static const F32 MESH_SCORE_TOLERANCE = 0.1f;
+
+// Keeps the score last handed to the repo thread for key, unless score
+// moved far enough from it, in which case it is queued in updates
+template<typename KEY>
+static F32 track_mesh_score(const boost::unordered_flat_map<KEY, F32>& last, const KEY& key, F32 score,
+							boost::unordered_flat_map<KEY, F32>& scores, std::vector<std::pair<KEY, F32>>& updates)
+{
+	auto found = last.find(key);
+	if (found != last.end() &&
+		(found->second < 0.f) == (score < 0.f) &&
+		fabsf(score - found->second) <= MESH_SCORE_TOLERANCE * fabsf(found->second))
+	{
+		score = found->second;
+	}
+	else
+	{
+		updates.emplace_back(key, score);
+	}
+	scores[key] = score;
+	return score;
+}
+
+// Rescores everything still waiting for a mesh without the repo thread's
+// lock.  The scores that moved enough to matter are left in
+// mLODScoreUpdates and mHeaderScoreUpdates for applyRequestPriorities().
+// Mutex:  mMeshMutex must be held on entry
+void LLMeshRepository::rescoreRequests(boost::unordered_flat_map<LLUUID, F32>& score_map)
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_NETWORK;
+
+	lod_score_map_t lod_scores;
+	lod_scores.reserve(mLODScores.size());
+	mLODScoreUpdates.clear();
+	for (S32 lod = 0; lod < LLVolumeLODGroup::NUM_LODS; ++lod)
+	{
+		for (auto iter = mLoadingMeshes[lod].begin(); iter != mLoadingMeshes[lod].end();)
+		{
+			// Objects that moved on to another mesh, or that already show
+			// a better LOD of this one, don't need this LOD anymore
+			auto& objects = iter->second;
+			for (auto obj_iter = objects.begin(); obj_iter != objects.end();)
+			{
+				LLVOVolume* vobj = *obj_iter;
+				LLVolume* volume = vobj->getVolume();
+				if (volume &&
+					(volume->getParams().getSculptID() != iter->first ||
+					 (volume->isMeshAssetLoaded() && LLVolumeLODGroup::getVolumeDetailFromScale(volume->getDetail()) > lod)))
+				{
+					vobj->decMeshCache();
+					objects.erase(obj_iter++);
+				}
+				else
+				{
+					++obj_iter;
+				}
+			}
+
+			if (objects.empty())
+			{
+				mCancelledRequests.emplace_back(iter->first, lod);
+				iter = mLoadingMeshes[lod].erase(iter);
+				continue;
+			}
+
+			F32 score = track_mesh_score(mLODScores, LLMeshRepoThread::lod_key_t(iter->first, lod), get_mesh_score(objects),
+										 lod_scores, mLODScoreUpdates);
+
+			// a mesh is wanted as much as its most wanted LOD
+			auto inserted = score_map.emplace(iter->first, score);
+			if (!inserted.second)
+			{
+				inserted.first->second = llmax(inserted.first->second, score);
+			}
+			++iter;
+		}
+	}
+
+	header_score_map_t header_scores;
+	header_scores.reserve(mHeaderScores.size());
+	mHeaderScoreUpdates.clear();
+	for (const auto& header : score_map)
+	{
+		track_mesh_score(mHeaderScores, header.first, header.second, header_scores, mHeaderScoreUpdates);
+	}
+
+	// Only what is still loading is remembered
+	mLODScores.swap(lod_scores);
+	mHeaderScores.swap(header_scores);
+}
+
+// Hands what rescoreRequests() found over to the repo thread
+// Mutex:  mMeshMutex and mThread->mMutex must be held on entry
+void LLMeshRepository::applyRequestPriorities()
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_NETWORK;
+
+	for (const auto& update : mLODScoreUpdates)
+	{
+		if (!mThread->mLODReqQ.setPriority(update.first, update.second))
+		{
+			// Not queued there yet, still here or waiting on its header.
+			// Forgotten, so it is sent again on the next update.
+			mLODScores.erase(update.first);
+		}
+	}
+	mLODScoreUpdates.clear();
+
+	for (const auto& update : mHeaderScoreUpdates)
+	{
+		if (!mThread->mHeaderReqQ.setPriority(update.first, update.second))
+		{
+			mHeaderScores.erase(update.first);
+		}
+	}
+	mHeaderScoreUpdates.clear();
+
+	// Withdraw what nothing waits for, unless it was asked for again since
+	for (const auto& request : mCancelledRequests)
+	{
+		if (mLoadingMeshes[request.second].find(request.first) == mLoadingMeshes[request.second].end())
+		{
+			mThread->cancelLOD(request.first, request.second);
+		}
+	}
+	mCancelledRequests.clear();
+}
+
+// The repo thread's lock couldn't be had, send everything again next time
+// Mutex:  mMeshMutex must be held on entry
+void LLMeshRepository::dropScoreUpdates()
+{
+	for (const auto& update : mLODScoreUpdates)
+	{
+		mLODScores.erase(update.first);
+	}
+	mLODScoreUpdates.clear();
+
+	for (const auto& update : mHeaderScoreUpdates)
+	{
+		mHeaderScores.erase(update.first);
+	}
+	mHeaderScoreUpdates.clear();
+}
+
 void LLMeshRepository::notifyLoadedMeshes()
 { //called from main thread
     LL_PROFILE_ZONE_SCOPED_CATEGORY_NETWORK; //LL_RECORD_BLOCK_TIME(FTM_MESH_FETCH);
@@ -3798,12 +4182,26 @@ void LLMeshRepository::notifyLoadedMeshes()
 	// greater than 2 (written to log on exit).
 	{
 		LLMutexTrylock lock1(mMeshMutex);
+
+		// Rescore everything still waiting as the camera and objects move.
+		// Done before taking the repo thread's lock, which only needs to
+		// be held to hand over the scores that changed.
+		boost::unordered_flat_map<LLUUID, F32> score_map;
+		if (lock1.isLocked())
+		{
+			rescoreRequests(score_map);
+		}
+
 		LLMutexTrylock lock2(mThread->mMutex);
 
 		static U32 hold_offs(0);
 		if (! lock1.isLocked() || ! lock2.isLocked())
 		{
 			// If we can't get the locks, skip and pick this up later.
+			if (lock1.isLocked())
+			{
+				dropScoreUpdates();
+			}
 			++hold_offs;
 			sMaxLockHoldoffs = llmax(sMaxLockHoldoffs, hold_offs);
 			return;
@@ -3849,46 +4247,31 @@ void LLMeshRepository::notifyLoadedMeshes()
 			mUploadErrorQ.pop();
 		}
 
+		applyRequestPriorities();
+
 		S32 active_count = LLMeshRepoThread::sActiveHeaderRequests + LLMeshRepoThread::sActiveLODRequests;
 		if (active_count < LLMeshRepoThread::sRequestLowWater)
 		{
 			S32 push_count = LLMeshRepoThread::sRequestHighWater - active_count;
 
-			if (mPendingRequests.size() > push_count)
-			{
-				// More requests than the high-water limit allows so
-				// sort and forward the most important.
-
-				//calculate "score" for pending requests
-
-				//create score map
-				boost::unordered_flat_map<LLUUID, F32> score_map;
-
-				for (const auto& lod : mLoadingMeshes)
+			//set "score" for pending requests, dropping the cancelled ones
+			mPendingRequests.erase(std::remove_if(mPendingRequests.begin(), mPendingRequests.end(),
+				[this, &score_map](LLMeshRepoThread::LODRequest& request)
 				{
-					for (const auto& param : lod)
+					const LLUUID& mesh_id = request.mMeshParams.getSculptID();
+					if (mLoadingMeshes[request.mLOD].find(mesh_id) == mLoadingMeshes[request.mLOD].end())
 					{
-						F32 max_score = 0.f;
-						for (LLVOVolume* vobj : param.second)
-						{
-							if (LLDrawable* drawable = vobj->mDrawable)
-							{
-								F32 cur_score = drawable->getRadius() / llmax(drawable->mDistanceWRTCamera, 1.f);
-								max_score = llmax(max_score, cur_score);
-							}
-						}
-				
-						score_map[param.first] = max_score;
+						LLMeshRepository::sLODPending--;
+						return true;
 					}
-				}
+					request.mScore = score_map[mesh_id];
+					return false;
+				}), mPendingRequests.end());
 
-				//set "score" for pending requests
-				for (auto& request : mPendingRequests)
-                {
-                    request.mScore = score_map[request.mMeshParams.getSculptID()];
-				}
-
-				//sort by "score"
+			if (mPendingRequests.size() > push_count)
+			{
+				// More requests than the high-water limit allows so
+				// sort and forward the most important.
 				std::partial_sort(mPendingRequests.begin(), mPendingRequests.begin() + push_count,
 								  mPendingRequests.end(), LLMeshRepoThread::CompareScoreGreater());
 			}
@@ -3896,7 +4279,7 @@ void LLMeshRepository::notifyLoadedMeshes()
 			while (!mPendingRequests.empty() && push_count > 0)
 			{
 				LLMeshRepoThread::LODRequest& request = mPendingRequests.front();
-				mThread->loadMeshLOD(request.mMeshParams, request.mLOD);
+				mThread->loadMeshLOD(request.mMeshParams, request.mLOD, request.mScore);
 				mPendingRequests.erase(mPendingRequests.begin());
 				LLMeshRepository::sLODPending--;
 				push_count--;
@@ -40,6 +40,7 @@
 #include "httpheaders.h"
 #include "httphandler.h"
 #include "llthread.h"
+#include "threadpool_fwd.h"
 
 #include "boost/unordered/unordered_map.hpp"
 #include "boost/unordered/unordered_flat_map.hpp"
@@ -48,9 +49,11 @@
 #define LLCONVEXDECOMPINTER_STATIC 1
 
 #include "llconvexdecomposition.h"
+#include "llmeshrequestschedule.h"
 #include "lluploadfloaterobservers.h"
 
 class LLVOVolume;
+class LLMeshDecodedCache;
 class LLMutex;
 class LLCondition;
 class LLMeshRepository;
@@ -296,9 +299,10 @@ class LLMeshRepoThread final : public LLThread
 		LLVolumeParams  mMeshParams;
 		S32 mLOD;
 		F32 mScore;
+		bool mSkipCache;	// the cached copy failed to decode, fetch from the sim
 
-		LODRequest(const LLVolumeParams&  mesh_params, S32 lod)
-			: RequestStats(), mMeshParams(mesh_params), mLOD(lod), mScore(0.f)
+		LODRequest(const LLVolumeParams&  mesh_params, S32 lod, F32 score = 0.f)
+			: RequestStats(), mMeshParams(mesh_params), mLOD(lod), mScore(score), mSkipCache(false)
 		{
 		}
 	};
@@ -315,9 +319,10 @@ class LLMeshRepoThread final : public LLThread
 	{
 	public:
 		LLUUID mId;
+		bool mSkipCache;	// the cached copy failed to decode, fetch from the sim
 
 		UUIDBasedRequest(const LLUUID& id)
-			: RequestStats(), mId(id)
+			: RequestStats(), mId(id), mSkipCache(false)
 		{
         }
 
@@ -355,11 +360,14 @@ class LLMeshRepoThread final : public LLThread
 	// In flight queues
 	/////////
 
-	//queue of requested headers
-	std::queue<HeaderRequest> mHeaderReqQ;
+	//queue of requested headers, by mesh id
+	typedef LLMeshRequestSchedule<LLUUID, HeaderRequest> header_schedule_t;
+	header_schedule_t mHeaderReqQ;
 
-	//queue of requested LODs
-	std::queue<LODRequest> mLODReqQ;
+	//queue of requested LODs, by mesh id and LOD
+	typedef std::pair<LLUUID, S32> lod_key_t;
+	typedef LLMeshRequestSchedule<lod_key_t, LODRequest> lod_schedule_t;
+	lod_schedule_t mLODReqQ;
 
 	//set of requested skin info
 	std::queue<UUIDBasedRequest> mSkinReqQ;
@@ -416,16 +424,32 @@ class LLMeshRepoThread final : public LLThread
 	int mLegacyGetMeshVersion;
 	std::string mGetMeshCapability;
 
+	// LOD and skin info assets are decoded on this pool so that HTTP dispatch
+	// on the repo thread never waits behind a decode. LODs with a higher
+	// screen space score are decoded first.
+	std::unique_ptr<LL::PriorityThreadPool> mDecodePool;
+
+	// Seconds from posting to done, and seconds decoding, of each decode
+	// finished since the last notifyLoadedMeshes()
+	std::vector<std::pair<F32, F32>> mDecodeTimes;
+
+	// LODs already decoded and cache optimized, checked before the asset
+	// cache.  Thread safe.
+	std::unique_ptr<LLMeshDecodedCache> mDecodedCache;
+
 	LLMeshRepoThread();
 	~LLMeshRepoThread();
 
 	virtual void run();
 
 	void lockAndLoadMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
-	void loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
+	void loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod, F32 score = 0.f);
+
+	// Mutex:  mMutex must be held on entry
+	void cancelLOD(const LLUUID& mesh_id, S32 lod);
 
 	bool fetchMeshHeader(const LLVolumeParams& mesh_params, bool can_retry = true);
-	bool fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod, bool can_retry = true);
+	bool fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod, bool can_retry = true, F32 score = 0.f, bool skip_cache = false);
 	EMeshProcessingResult headerReceived(const LLVolumeParams& mesh_params, U8* data, S32 data_size);
 	EMeshProcessingResult lodReceived(const LLVolumeParams& mesh_params, S32 lod, U8* data, S32 data_size);
 	EMeshProcessingResult skinInfoReceived(const LLUUID& mesh_id, U8* data, S32 data_size);
@@ -435,7 +459,19 @@ class LLMeshRepoThread final : public LLThread
     bool hasSkinInfoInHeader(const LLUUID& mesh_id);
     bool hasHeader(const LLUUID& mesh_id);
 
-	bool loadInfoFromFilesystem(const LLUUID& mesh_id, MeshHeaderInfo& info, boost::function<bool(const LLUUID&, U8*, S32)> fn);
+	bool loadInfoFromFilesystem(const LLUUID& mesh_id, MeshHeaderInfo& info, boost::function<EMeshProcessingResult(const LLUUID&, U8*, S32)> fn);
+
+	// Queue a copy of data for lodReceived() or skinInfoReceived() on the
+	// decode pool. Data from the sim is written to the cache at write_offset
+	// once it decodes; data read from the cache has a write_offset of -1 and
+	// is fetched from the sim again if it fails to decode.
+	void postLODDecode(const LLVolumeParams& mesh_params, S32 lod, F32 score, const U8* data, S32 data_size, S32 write_offset);
+	void postSkinInfoDecode(const LLUUID& mesh_id, const U8* data, S32 data_size, S32 write_offset);
+	// Load a LOD from mDecodedCache on the decode pool, queueing a regular
+	// fetch if the entry turns out to be unusable
+	void postDecodedLODLoad(const LLVolumeParams& mesh_params, S32 lod, F32 score);
+	void postDecode(F32 priority, const std::function<void()>& decode);
+	size_t getDecodeQueueSize();
 
 	void notifyLoadedMeshes(); // Only call from main thread.
 	S32 getActualMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
@@ -446,7 +482,7 @@ class LLMeshRepoThread final : public LLThread
 
 	//send request for skin info, returns true if header info exists 
 	//  (should hold onto mesh_id and try again later if header info does not exist)
-	bool fetchMeshSkinInfo(const LLUUID& mesh_id, bool can_retry = true);
+	bool fetchMeshSkinInfo(const LLUUID& mesh_id, bool can_retry = true, bool skip_cache = false);
 
 	//send request for decomposition, returns true if header info exists 
 	//  (should hold onto mesh_id and try again later if header info does not exist)
@@ -674,6 +710,9 @@ class LLMeshRepository
 	S32 loadMesh(LLVOVolume* volume, const LLVolumeParams& mesh_params, S32 detail = 0, S32 last_lod = -1);
 	
 	void notifyLoadedMeshes();
+	void rescoreRequests(boost::unordered_flat_map<LLUUID, F32>& score_map);
+	void applyRequestPriorities();
+	void dropScoreUpdates();
 	void notifyMeshLoaded(const LLVolumeParams& mesh_params, LLVolume* volume);
 	void notifyMeshUnavailable(const LLVolumeParams& mesh_params, S32 lod);
 	void notifySkinInfoReceived(LLMeshSkinInfo* info);
@@ -722,6 +761,17 @@ class LLMeshRepository
 	LLMutex*					mMeshMutex;
 	
 	std::vector<LLMeshRepoThread::LODRequest> mPendingRequests;
+
+	//mesh LODs nothing waits for anymore, withdrawn from the repo thread's queue in notifyLoadedMeshes
+	std::vector<std::pair<LLUUID, S32>> mCancelledRequests;
+
+	//scores last handed to the repo thread's schedules, and the ones that moved since
+	typedef boost::unordered_flat_map<LLMeshRepoThread::lod_key_t, F32> lod_score_map_t;
+	typedef boost::unordered_flat_map<LLUUID, F32> header_score_map_t;
+	lod_score_map_t mLODScores;
+	header_score_map_t mHeaderScores;
+	std::vector<std::pair<LLMeshRepoThread::lod_key_t, F32>> mLODScoreUpdates;
+	std::vector<std::pair<LLUUID, F32>> mHeaderScoreUpdates;
 	
 	//list of mesh ids awaiting skin info
 	typedef boost::unordered_node_map<LLUUID, boost::unordered_flat_set<LLVOVolume*> > skin_load_map;
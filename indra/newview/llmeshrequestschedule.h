@@ -0,0 +1,170 @@
+/**
+ * @file llmeshrequestschedule.h
+ * @brief Priority schedule for the mesh repository's waiting requests.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMESHREQUESTSCHEDULE_H
+#define LL_LLMESHREQUESTSCHEDULE_H
+
+#include <map>
+#include <set>
+
+// Waiting requests, one per key, handed out highest priority first and
+// in queueing order among equal priorities.  Priorities can be changed
+// and requests withdrawn while they wait.  Not thread safe, callers hold
+// LLMeshRepoThread::mMutex.
+template<typename KEY, typename REQUEST>
+class LLMeshRequestSchedule
+{
+public:
+	// Queues req under key.  If a request is already waiting under key,
+	// keeps that one, raises its priority to at least priority and
+	// returns false.
+	bool push(const KEY& key, const REQUEST& req, F32 priority)
+	{
+		auto found = mEntries.find(key);
+		if (found != mEntries.end())
+		{
+			if (priority > found->second.mPriority)
+			{
+				reorder(found, priority);
+			}
+			return false;
+		}
+
+		found = mEntries.emplace(key, Entry(req, priority, mSequence++)).first;
+		mOrder.insert(Order(priority, found->second.mSequence, &found->first));
+		return true;
+	}
+
+	// Returns false if nothing is waiting under key
+	bool setPriority(const KEY& key, F32 priority)
+	{
+		auto found = mEntries.find(key);
+		if (found == mEntries.end())
+		{
+			return false;
+		}
+		if (priority != found->second.mPriority)
+		{
+			reorder(found, priority);
+		}
+		return true;
+	}
+
+	// Like setPriority, but never lowers it
+	bool raisePriority(const KEY& key, F32 priority)
+	{
+		auto found = mEntries.find(key);
+		if (found == mEntries.end())
+		{
+			return false;
+		}
+		if (priority > found->second.mPriority)
+		{
+			reorder(found, priority);
+		}
+		return true;
+	}
+
+	// Returns false if nothing is waiting under key
+	bool cancel(const KEY& key)
+	{
+		auto found = mEntries.find(key);
+		if (found == mEntries.end())
+		{
+			return false;
+		}
+		mOrder.erase(Order(found->second.mPriority, found->second.mSequence, nullptr));
+		mEntries.erase(found);
+		return true;
+	}
+
+	bool contains(const KEY& key) const { return mEntries.find(key) != mEntries.end(); }
+	bool empty() const { return mEntries.empty(); }
+	size_t size() const { return mEntries.size(); }
+
+	// Removes and returns the most important request, must not be empty
+	REQUEST pop(F32* priority = nullptr)
+	{
+		auto first = mOrder.begin();
+		auto found = mEntries.find(*first->mKey);
+		REQUEST req = found->second.mRequest;
+		if (priority)
+		{
+			*priority = first->mPriority;
+		}
+		mOrder.erase(first);
+		mEntries.erase(found);
+		return req;
+	}
+
+private:
+	struct Entry
+	{
+		Entry(const REQUEST& req, F32 priority, U64 sequence)
+			: mRequest(req), mPriority(priority), mSequence(sequence)
+		{
+		}
+
+		REQUEST mRequest;
+		F32 mPriority;
+		U64 mSequence;
+	};
+
+	struct Order
+	{
+		Order(F32 priority, U64 sequence, const KEY* key)
+			: mPriority(priority), mSequence(sequence), mKey(key)
+		{
+		}
+
+		bool operator<(const Order& rhs) const
+		{
+			if (mPriority != rhs.mPriority)
+			{
+				return mPriority > rhs.mPriority; // greatest = first
+			}
+			return mSequence < rhs.mSequence;
+		}
+
+		F32 mPriority;
+		U64 mSequence;
+		const KEY* mKey;	// points into mEntries, whose nodes don't move
+	};
+
+	typedef std::map<KEY, Entry> entry_map_t;
+
+	void reorder(typename entry_map_t::iterator found, F32 priority)
+	{
+		mOrder.erase(Order(found->second.mPriority, found->second.mSequence, nullptr));
+		found->second.mPriority = priority;
+		mOrder.insert(Order(priority, found->second.mSequence, &found->first));
+	}
+
+	entry_map_t mEntries;
+	std::set<Order> mOrder;
+	U64 mSequence = 0;
+};
+
+#endif // LL_LLMESHREQUESTSCHEDULE_H
@@ -0,0 +1,186 @@
+/**
+ * @file llobjectmotionbatch.cpp
+ * @brief Motion interpolation for many active objects at once.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llobjectmotionbatch.h"
+
+#include "llparallelfor.h"
+
+void LLObjectMotionBatch::clear()
+{
+	mPosition.clear();
+	mVelocity.clear();
+	mAcceleration.clear();
+	mAngularVelocity.clear();
+	mRotation.clear();
+	mAngularVelocityRot.clear();
+	mRotTime.clear();
+	mDt.clear();
+	mSinceMessage.clear();
+	mSinceInterp.clear();
+	mInterpLag.clear();
+	mFlags.clear();
+}
+
+void LLObjectMotionBatch::reserve(size_t count)
+{
+	mPosition.reserve(count);
+	mVelocity.reserve(count);
+	mAcceleration.reserve(count);
+	mAngularVelocity.reserve(count);
+	mRotation.reserve(count);
+	mAngularVelocityRot.reserve(count);
+	mRotTime.reserve(count);
+	mDt.reserve(count);
+	mSinceMessage.reserve(count);
+	mSinceInterp.reserve(count);
+	mInterpLag.reserve(count);
+	mFlags.reserve(count);
+}
+
+size_t LLObjectMotionBatch::add(const LLVector3& pos, const LLVector3& vel, const LLVector3& accel,
+								const LLVector3& ang_vel, const LLQuaternion& rot, const LLQuaternion& ang_vel_rot,
+								F32 rot_time, F32 dt, F32 since_message, F32 since_interp, F32 interp_lag, U32 flags)
+{
+	LLVector4a v;
+	v.load3(pos.mV);
+	mPosition.push_back(v);
+	v.load3(vel.mV);
+	mVelocity.push_back(v);
+	v.load3(accel.mV);
+	mAcceleration.push_back(v);
+	v.load3(ang_vel.mV);
+	mAngularVelocity.push_back(v);
+	mRotation.push_back(rot);
+	mAngularVelocityRot.push_back(ang_vel_rot);
+	mRotTime.push_back(rot_time);
+	mDt.push_back(dt);
+	mSinceMessage.push_back(since_message);
+	mSinceInterp.push_back(since_interp);
+	mInterpLag.push_back(interp_lag);
+	mFlags.push_back(flags & (ATTACHMENT | MOVING | STALLED));
+	return mFlags.size() - 1;
+}
+
+void LLObjectMotionBatch::update(const Params& params, size_t begin, size_t end)
+{
+	LL_PROFILE_ZONE_SCOPED;
+
+	for (size_t i = begin; i < end; ++i)
+	{
+		rotate(i);
+	}
+	for (size_t i = begin; i < end; ++i)
+	{
+		interpolate(params, i);
+	}
+}
+
+void LLObjectMotionBatch::update(const Params& params, size_t grain)
+{
+	LL::parallelFor("General", size(), grain,
+					[this, &params](size_t begin, size_t end)
+					{
+						update(params, begin, end);
+					});
+}
+
+// See LLViewerObject::applyAngularVelocity()
+void LLObjectMotionBatch::rotate(size_t i)
+{
+	const F32 dt = mDt[i];
+	mRotTime[i] += dt;
+
+	LLVector3 ang_vel(mAngularVelocity[i].getF32ptr());
+	F32 omega = ang_vel.magVecSquared();
+	if (omega > 0.00001f)
+	{
+		omega = sqrtf(omega);
+		ang_vel *= 1.f / omega;
+
+		LLQuaternion dQ;
+		dQ.setQuat(omega * dt, ang_vel);
+
+		mAngularVelocityRot[i] *= dQ;
+		mRotation[i] = mRotation[i] * dQ;
+		mFlags[i] |= ROTATED;
+	}
+}
+
+// See LLViewerObject::interpolateLinearMotion()
+void LLObjectMotionBatch::interpolate(const Params& params, size_t i)
+{
+	U32 flags = mFlags[i];
+	const F32 dt = mDt[i];
+	const F32 since_message = mSinceMessage[i];
+	if ((flags & ATTACHMENT) || since_message <= 0.f || dt <= 0.f)
+	{
+		return;
+	}
+	flags |= INTERPOLATED;
+
+	if (flags & MOVING)
+	{
+		LLVector4a new_pos;
+		new_pos.setMul(mAcceleration[i], 0.5f * (dt - PHYSICS_TIMESTEP));
+		new_pos.add(mVelocity[i]);
+		new_pos.mul(dt);
+
+		LLVector4a new_v;
+		new_v.setMul(mAcceleration[i], dt);
+
+		if (params.mMaxTime > 0.f &&
+			params.mPhaseOutTime > 0.f &&
+			since_message > params.mPhaseOutTime &&
+			(flags & STALLED))
+		{
+			// Start to reduce motion interpolation since we haven't seen a server update in a while
+			F32 phase_out;
+			if (since_message > params.mMaxTime)
+			{	// Past the time limit, so stop the object
+				phase_out = 0.f;
+			}
+			else if (mInterpLag[i] > params.mPhaseOutTime)
+			{	// Last update was already phased out a bit
+				phase_out = (params.mMaxTime - since_message) / (params.mMaxTime - mSinceInterp[i]);
+			}
+			else
+			{	// Phase out from full value
+				phase_out = (params.mMaxTime - since_message) / (params.mMaxTime - params.mPhaseOutTime);
+			}
+			phase_out = llclamp(phase_out, 0.f, 1.f);
+
+			new_pos.mul(phase_out);
+			new_v.mul(phase_out);
+		}
+
+		mPosition[i].add(new_pos);
+		mVelocity[i].add(new_v);
+		flags |= MOVED;
+	}
+
+	mFlags[i] = flags;
+}
@@ -0,0 +1,111 @@
+/**
+ * @file llobjectmotionbatch.h
+ * @brief Motion interpolation for many active objects at once.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLOBJECTMOTIONBATCH_H
+#define LL_LLOBJECTMOTIONBATCH_H
+
+#include <vector>
+
+#include "llmath.h"
+#include "llquaternion.h"
+#include "llvector4a.h"
+#include "v3math.h"
+
+// The interpolation state of a frame's worth of active prims, one array
+// per field.  LLViewerObjectList copies it out of the objects, update()
+// does what LLViewerObject::applyAngularVelocity() and the prediction
+// half of interpolateLinearMotion() do for each of them, and the results
+// are copied back.  Clamping to the ground and to region edges needs the
+// world and stays with the object.
+//
+// Entries are independent of each other, so ranges of them can be run on
+// different threads.
+class LLObjectMotionBatch
+{
+public:
+	enum EFlags
+	{
+		// in
+		ATTACHMENT		= 0x01,		// rotates, doesn't move
+		MOVING			= 0x02,		// has velocity or acceleration
+		STALLED			= 0x04,		// its region's circuit is dead, blocked or quiet
+		// out
+		ROTATED			= 0x10,		// rotation, accumulated rotation changed
+		MOVED			= 0x20,		// position, velocity changed
+		INTERPOLATED	= 0x40		// linear motion ran, the interpolation time moves on
+	};
+
+	struct Params
+	{
+		F32		mPhaseOutTime;		// LLViewerObject::sPhaseOutUpdateInterpolationTime
+		F32		mMaxTime;			// LLViewerObject::sMaxUpdateInterpolationTime, unbounded if 0 or less
+	};
+
+	// Same as LLViewerObject's, velocities are averaged over one step
+	static constexpr F32 PHYSICS_TIMESTEP = 1.f / 45.f;
+
+	void clear();
+	void reserve(size_t count);
+	size_t size() const							{ return mFlags.size(); }
+
+	// since_message is the time since the last update from the simulator,
+	// since_interp the time since the last interpolation and interp_lag
+	// the time between the two.  Returns the new entry's index.
+	size_t add(const LLVector3& pos, const LLVector3& vel, const LLVector3& accel,
+			   const LLVector3& ang_vel, const LLQuaternion& rot, const LLQuaternion& ang_vel_rot,
+			   F32 rot_time, F32 dt, F32 since_message, F32 since_interp, F32 interp_lag, U32 flags);
+
+	// Entries [begin, end)
+	void update(const Params& params, size_t begin, size_t end);
+
+	// Every entry, in chunks of grain on the General pool
+	void update(const Params& params, size_t grain);
+
+	U32 getFlags(size_t i) const				{ return mFlags[i]; }
+	LLVector3 getPosition(size_t i) const		{ return LLVector3(mPosition[i].getF32ptr()); }
+	LLVector3 getVelocity(size_t i) const		{ return LLVector3(mVelocity[i].getF32ptr()); }
+	const LLQuaternion& getRotation(size_t i) const			{ return mRotation[i]; }
+	const LLQuaternion& getAngularVelocityRot(size_t i) const	{ return mAngularVelocityRot[i]; }
+	F32 getRotTime(size_t i) const				{ return mRotTime[i]; }
+
+private:
+	void rotate(size_t i);
+	void interpolate(const Params& params, size_t i);
+
+	std::vector<LLVector4a>		mPosition;			// region local
+	std::vector<LLVector4a>		mVelocity;
+	std::vector<LLVector4a>		mAcceleration;
+	std::vector<LLVector4a>		mAngularVelocity;
+	std::vector<LLQuaternion>	mRotation;
+	std::vector<LLQuaternion>	mAngularVelocityRot;
+	std::vector<F32>			mRotTime;
+	std::vector<F32>			mDt;				// dilated
+	std::vector<F32>			mSinceMessage;
+	std::vector<F32>			mSinceInterp;
+	std::vector<F32>			mInterpLag;
+	std::vector<U32>			mFlags;
+};
+
+#endif // LL_LLOBJECTMOTIONBATCH_H
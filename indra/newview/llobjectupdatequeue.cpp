@@ -0,0 +1,275 @@
+/**
+ * @file llobjectupdatequeue.cpp
+ * @brief Object updates decoded off the main thread and applied
+ * under a time budget.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llobjectupdatequeue.h"
+
+#include "lldatapacker.h"
+#include "lltimer.h"
+#include "workqueue.h"
+
+#include <thread>
+
+LLObjectUpdateQueue::Batch::Batch(U64 region_handle, const LLHost& sender, EObjectUpdateType type)
+:	mRegionHandle(region_handle),
+	mSender(sender),
+	mType(type),
+	mPacketID(0),
+	mTimeDilation(0),
+	mNextRecord(0),
+	mState(QUEUED)
+{
+}
+
+LLObjectUpdateQueue::LLObjectUpdateQueue()
+:	mPendingCount(0)
+{
+}
+
+void LLObjectUpdateQueue::push(const batch_ptr_t& batch)
+{
+	if (batch->mRecords.empty())
+	{
+		return;
+	}
+
+	batch->mApplied.assign(batch->mRecords.size(), false);
+	std::unordered_map<U32, U32>& pending = mPendingObjects[batch->mSender];
+	for (const LLObjectUpdateRecord& record : batch->mRecords)
+	{
+		++pending[record.mLocalID];
+	}
+	mPendingCount += (U32)batch->mRecords.size();
+	mBatches.push_back(batch);
+
+	if (batch->mType != OUT_FULL_COMPRESSED)
+	{
+		// cache probes carry nothing to decode
+		batch->mState = Batch::DECODED;
+		return;
+	}
+
+	LL::WorkQueue::ptr_t general_queue = LL::WorkQueue::getInstance("General");
+	if (general_queue)
+	{
+		general_queue->post([batch]()
+			{
+				LL_PROFILE_ZONE_NAMED_CATEGORY_NETWORK("object update decode");
+				if (claimDecode(*batch))
+				{
+					decodeBatch(*batch);
+				}
+			});
+	}
+	// else decoded on the main thread when its turn comes
+}
+
+bool LLObjectUpdateQueue::isPending(const LLHost& sender, U32 local_id) const
+{
+	auto host_iter = mPendingObjects.find(sender);
+	return host_iter != mPendingObjects.end() && host_iter->second.count(local_id) > 0;
+}
+
+void LLObjectUpdateQueue::applyPending(F32 max_seconds, const apply_func_t& apply)
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_NETWORK;
+
+	LLTimer timer;
+	while (!mBatches.empty())
+	{
+		batch_ptr_t batch = mBatches.front();
+		if (claimDecode(*batch))
+		{
+			decodeBatch(*batch);
+		}
+		else if (batch->mState.load(std::memory_order_acquire) != Batch::DECODED)
+		{
+			// a pool thread claimed it, even since the state was last read
+			break;
+		}
+
+		while (batch->mNextRecord < batch->mRecords.size())
+		{
+			applyRecord(*batch, batch->mNextRecord++, apply);
+			if (timer.getElapsedTimeF32() > max_seconds)
+			{
+				if (batch->mNextRecord == batch->mRecords.size())
+				{
+					mBatches.pop_front();
+				}
+				return;
+			}
+		}
+		mBatches.pop_front();
+	}
+}
+
+void LLObjectUpdateQueue::applyObject(const LLHost& sender, U32 local_id, const apply_func_t& apply)
+{
+	if (!isPending(sender, local_id))
+	{
+		return;
+	}
+
+	for (const batch_ptr_t& batch : mBatches)
+	{
+		if (batch->mSender != sender)
+		{
+			continue;
+		}
+
+		const bool decoded = batch->mState.load(std::memory_order_acquire) == Batch::DECODED;
+		for (size_t i = batch->mNextRecord; i < batch->mRecords.size(); ++i)
+		{
+			const LLObjectUpdateRecord& record = batch->mRecords[i];
+			if (record.mLocalID != local_id || batch->mApplied[i])
+			{
+				continue;
+			}
+
+			if (decoded)
+			{
+				applyRecord(*batch, i, apply);
+			}
+			else
+			{
+				// The pool may be writing this batch, work from a copy
+				LLObjectUpdateRecord copy;
+				copy.mLocalID = record.mLocalID;
+				copy.mCRC = record.mCRC;
+				copy.mFlags = record.mFlags;
+				copy.mData = record.mData;
+				decode(batch->mType, copy);
+
+				batch->mApplied[i] = true;
+				apply(*batch, copy);
+			}
+		}
+	}
+
+	auto host_iter = mPendingObjects.find(sender);
+	if (host_iter != mPendingObjects.end())
+	{
+		auto object_iter = host_iter->second.find(local_id);
+		if (object_iter != host_iter->second.end())
+		{
+			mPendingCount -= object_iter->second;
+			host_iter->second.erase(object_iter);
+		}
+	}
+}
+
+void LLObjectUpdateQueue::applyAll(const apply_func_t& apply)
+{
+	while (!mBatches.empty())
+	{
+		batch_ptr_t batch = mBatches.front();
+		if (claimDecode(*batch))
+		{
+			decodeBatch(*batch);
+		}
+		else
+		{
+			// a pool thread has it, it won't be long
+			while (batch->mState.load(std::memory_order_acquire) != Batch::DECODED)
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		while (batch->mNextRecord < batch->mRecords.size())
+		{
+			applyRecord(*batch, batch->mNextRecord++, apply);
+		}
+		mBatches.pop_front();
+	}
+}
+
+void LLObjectUpdateQueue::clear()
+{
+	// Batches still being decoded are kept alive by the pool's reference
+	mBatches.clear();
+	mPendingObjects.clear();
+	mPendingCount = 0;
+}
+
+// static
+bool LLObjectUpdateQueue::claimDecode(Batch& batch)
+{
+	U32 expected = Batch::QUEUED;
+	return batch.mState.compare_exchange_strong(expected, Batch::DECODING, std::memory_order_acquire);
+}
+
+// static
+void LLObjectUpdateQueue::decodeBatch(Batch& batch)
+{
+	for (LLObjectUpdateRecord& record : batch.mRecords)
+	{
+		decode(batch.mType, record);
+	}
+	batch.mState.store(Batch::DECODED, std::memory_order_release);
+}
+
+void LLObjectUpdateQueue::applyRecord(Batch& batch, size_t index, const apply_func_t& apply)
+{
+	if (batch.mApplied[index])
+	{
+		return;
+	}
+	batch.mApplied[index] = true;
+
+	LLObjectUpdateRecord& record = batch.mRecords[index];
+	auto host_iter = mPendingObjects.find(batch.mSender);
+	if (host_iter != mPendingObjects.end())
+	{
+		auto object_iter = host_iter->second.find(record.mLocalID);
+		if (object_iter != host_iter->second.end())
+		{
+			if (!--object_iter->second)
+			{
+				host_iter->second.erase(object_iter);
+			}
+			--mPendingCount;
+		}
+	}
+
+	apply(batch, record);
+}
+
+// static
+void LLObjectUpdateQueue::decode(EObjectUpdateType type, LLObjectUpdateRecord& record)
+{
+	record.mParentID = 0;
+	if (type != OUT_FULL_COMPRESSED || record.mData.empty())
+	{
+		return;
+	}
+
+	// What LLViewerRegion::decodeBoundingInfo() needs from a new cache entry
+	LLDataPackerBinaryBuffer dp(record.mData.data(), (S32)record.mData.size());
+	record.mParentID = LLViewerObject::extractSpatialExtents(&dp, record.mPos, record.mScale, record.mRot);
+}
@@ -0,0 +1,135 @@
+/**
+ * @file llobjectupdatequeue.h
+ * @brief Object updates decoded off the main thread and applied
+ * under a time budget.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLOBJECTUPDATEQUEUE_H
+#define LL_LLOBJECTUPDATEQUEUE_H
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "llhost.h"
+#include "llquaternion.h"
+#include "v3math.h"
+#include "llviewerobject.h"
+
+// One ObjectData block of an update, copied out of the message
+struct LLObjectUpdateRecord
+{
+	U32				mLocalID;
+	U32				mCRC;
+	U32				mFlags;
+	std::vector<U8>	mData;			// uncompressed object data, empty for cache probes
+
+	// Decoded from mData by the pool
+	U32				mParentID;
+	LLVector3		mPos;
+	LLVector3		mScale;
+	LLQuaternion	mRot;
+};
+
+// Region arrival sends thousands of ObjectUpdateCompressed and
+// ObjectUpdateCached blocks.  Rather than handling each as its message
+// comes in, the blocks are copied into batches, their data packers are
+// unpacked on the General thread pool, and the main thread applies the
+// resulting records a few milliseconds per frame.  Compressed updates
+// are queued whole, the ones that create or update an object rather
+// than go to the object cache included, so each batch keeps what
+// LLViewerObject::processUpdateMessage() reads from the message itself.
+//
+// Records are applied in arrival order.  Anything else that touches an
+// object with records still queued has to apply them first through
+// applyObject(), the queue keeps a count per object for isPending().
+class LLObjectUpdateQueue
+{
+public:
+	struct Batch
+	{
+		enum EState
+		{
+			QUEUED,
+			DECODING,
+			DECODED
+		};
+
+		Batch(U64 region_handle, const LLHost& sender, EObjectUpdateType type);
+
+		const U64			mRegionHandle;
+		const LLHost		mSender;
+		const EObjectUpdateType mType;	// OUT_FULL_COMPRESSED or OUT_FULL_CACHED
+		U32					mPacketID;
+		U16					mTimeDilation;
+		std::vector<LLObjectUpdateRecord> mRecords;
+		std::vector<bool>	mApplied;	// main thread only
+		size_t				mNextRecord;
+		std::atomic<U32>	mState;
+	};
+	typedef std::shared_ptr<Batch> batch_ptr_t;
+	typedef std::function<void(const Batch&, LLObjectUpdateRecord&)> apply_func_t;
+
+	LLObjectUpdateQueue();
+
+	// Starts decoding the batch, takes ownership of it
+	void push(const batch_ptr_t& batch);
+
+	bool empty() const					{ return mBatches.empty(); }
+	U32 getPendingCount() const			{ return mPendingCount; }
+	bool isPending(const LLHost& sender, U32 local_id) const;
+
+	// Applies records in arrival order until max_seconds have passed.
+	// A batch still being decoded by the pool ends the run.
+	void applyPending(F32 max_seconds, const apply_func_t& apply);
+
+	// Applies the records for one object ahead of the rest
+	void applyObject(const LLHost& sender, U32 local_id, const apply_func_t& apply);
+
+	// Applies everything, decoding on the calling thread if need be
+	void applyAll(const apply_func_t& apply);
+
+	// Drops everything still queued
+	void clear();
+
+	// Fills in the decoded fields of a record from its data
+	static void decode(EObjectUpdateType type, LLObjectUpdateRecord& record);
+
+private:
+	// Returns true if the calling thread is to decode the batch, false if
+	// another thread has claimed it or it is already decoded
+	static bool claimDecode(Batch& batch);
+	// Decodes a claimed batch and marks it decoded
+	static void decodeBatch(Batch& batch);
+	void applyRecord(Batch& batch, size_t index, const apply_func_t& apply);
+
+	std::deque<batch_ptr_t>		mBatches;
+	std::map<LLHost, std::unordered_map<U32, U32> > mPendingObjects;
+	U32							mPendingCount;
+};
+
+#endif // LL_LLOBJECTUPDATEQUEUE_H
@@ -0,0 +1,162 @@
+/**
+ * @file lloctreecullrecord.h
+ * @brief Octree cull walks recorded off the main thread and replayed on it.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLOCTREECULLRECORD_H
+#define LL_LLOCTREECULLRECORD_H
+
+#include <vector>
+
+class LLCamera;
+
+// One group a recorded walk reached
+template <class Group>
+struct LLOctreeCullEntry
+{
+	Group*	mGroup;
+	U32		mEnd;			// index just past this group's subtree
+	bool	mVisible;		// passed the frustum, gets processGroup()
+};
+
+// Walks a tree the way the culler T does without the occlusion checks,
+// which the replay does, and without processing the groups.  Frustum
+// results are handed down the same way as in LLViewerOctreeCull::traverse(),
+// so every group the replay doesn't find occluded gets the same result it
+// would have had from T.
+//
+// Traveler is the tree traveler T derives from, Node its node type and
+// Group the group type T's checks take.
+template <class T, class Traveler, class Node, class Group>
+class LLOctreeCullRecord : public T
+{
+public:
+	typedef LLOctreeCullEntry<Group> entry_t;
+	typedef std::vector<entry_t> entry_list_t;
+
+	LLOctreeCullRecord(LLCamera* camera, entry_list_t& entries)
+		: T(camera), mEntries(entries), mCurrent(NULL) { }
+
+	// Checks the root alone, returns what its children start from
+	S32 recordRoot(const Node* n, entry_t& root)
+	{
+		Group* group = (Group*) n->getListener(0);
+		root.mGroup = group;
+		root.mEnd = 0;
+		root.mVisible = false;
+
+		this->mRes = this->frustumCheck(group);
+		if (this->mRes)
+		{
+			mCurrent = &root;
+			n->accept(this);
+		}
+		return this->mRes;
+	}
+
+	// Walks one child of the root, res being what recordRoot() returned
+	void recordSubtree(const Node* n, S32 res)
+	{
+		this->mRes = res;
+		traverse(n);
+	}
+
+	virtual void traverse(const Node* n)
+	{
+		Group* group = (Group*) n->getListener(0);
+
+		U32 index = mEntries.size();
+		mEntries.push_back({ group, 0, false });
+
+		if (this->mRes == 2 ||
+			(this->mRes && group->hasState(Group::SKIP_FRUSTUM_CHECK)))
+		{
+			mCurrent = &mEntries[index];
+			Traveler::traverse(n);
+		}
+		else
+		{
+			this->mRes = this->frustumCheck(group);
+
+			if (this->mRes)
+			{
+				mCurrent = &mEntries[index];
+				Traveler::traverse(n);
+			}
+
+			this->mRes = 0;
+		}
+
+		mEntries[index].mEnd = mEntries.size();
+	}
+
+	virtual void processGroup(Group* group)
+	{
+		mCurrent->mVisible = true;
+	}
+
+	// Replays the root on the calling thread, returns false if the walk
+	// ends there
+	template <class Culler>
+	static bool replayRoot(Culler& culler, const entry_t& root)
+	{
+		if (culler.earlyFail(root.mGroup))
+		{
+			return false;
+		}
+		if (root.mVisible)
+		{
+			culler.processGroup(root.mGroup);
+		}
+		return true;
+	}
+
+	// Replays a subtree's entries on the calling thread, skipping the
+	// subtrees of groups that fail earlyFail()
+	template <class Culler>
+	static void replay(Culler& culler, const entry_list_t& entries)
+	{
+		U32 i = 0;
+		while (i < entries.size())
+		{
+			const entry_t& entry = entries[i];
+			if (culler.earlyFail(entry.mGroup))
+			{
+				// occluded, skip its subtree
+				i = entry.mEnd;
+				continue;
+			}
+			if (entry.mVisible)
+			{
+				culler.processGroup(entry.mGroup);
+			}
+			++i;
+		}
+	}
+
+private:
+	entry_list_t&	mEntries;
+	entry_t*		mCurrent;		// the group being visited, set before its children grow mEntries
+};
+
+#endif // LL_LLOCTREECULLRECORD_H
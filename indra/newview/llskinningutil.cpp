@@ -33,6 +33,7 @@
 #include "llmeshrepository.h"
 #include "llvolume.h"
 #include "llrigginginfo.h"
+#include "llskinningkernel.h"
 
 #define DEBUG_SKINNING  LL_DEBUG
 
@@ -122,6 +123,10 @@ void LLSkinningUtil::initSkinningMatrixPalette(
     LL_PROFILE_ZONE_SCOPED_CATEGORY_AVATAR;
 
     initJointNums(const_cast<LLMeshSkinInfo*>(skin), avatar);
+    llassert(count <= (S32)LL_MAX_JOINTS_PER_MESH_OBJECT);
+
+    // Gather the joint matrices, then multiply the whole palette at once
+    const LLMatrix4a* world[LL_MAX_JOINTS_PER_MESH_OBJECT];
     for (U32 j = 0; j < count; ++j)
     {
         S32 joint_num = skin->mJointNums[j];
@@ -129,11 +134,11 @@ void LLSkinningUtil::initSkinningMatrixPalette(
 
         if (joint)
         {
-            mat[j].setMul(joint->getWorldMatrix(), skin->mInvBindMatrix[j]);
+            world[j] = &joint->getWorldMatrix();
         }
         else
         {
-            mat[j] = skin->mInvBindMatrix[j];
+            world[j] = nullptr;
 #if DEBUG_SKINNING
             // This  shouldn't  happen   -  in  mesh  upload,  skinned
             // rendering  should  be disabled  unless  all joints  are
@@ -149,6 +154,8 @@ void LLSkinningUtil::initSkinningMatrixPalette(
 #endif
         }
     }
+
+    LLSkinningKernel::mulPalette(mat, world, skin->mInvBindMatrix.data(), count);
 }
 
 void LLSkinningUtil::checkSkinWeights(LLVector4a* weights, U32 num_vertices, const LLMeshSkinInfo* skin)
@@ -53,6 +53,7 @@
 #include "llvolumemgr.h"
 #include "llviewershadermgr.h"
 #include "llcontrolavatar.h"
+#include "llparallelfor.h"
 
 extern bool gShiftFrame;
 
@@ -1440,6 +1441,26 @@ S32 LLSpatialPartition::cull(LLCamera &camera, std::vector<LLDrawable *>* result
 
 extern BOOL gCubeSnapshot;
 
+enum ECullType
+{
+	CULL_DEFAULT,
+	CULL_NO_FAR_CLIP,
+	CULL_SHADOW
+};
+
+static U8 get_cull_type(const LLSpatialPartition* part)
+{
+	if (LLPipeline::sShadowRender)
+	{
+		return CULL_SHADOW;
+	}
+	if (part->mInfiniteFarClip || (!LLPipeline::sUseFarClip && !gCubeSnapshot))
+	{
+		return CULL_NO_FAR_CLIP;
+	}
+	return CULL_DEFAULT;
+}
+
 S32 LLSpatialPartition::cull(LLCamera &camera, bool do_occlusion)
 {
     LL_PROFILE_ZONE_SCOPED_CATEGORY_SPATIAL;
@@ -1453,25 +1474,139 @@ S32 LLSpatialPartition::cull(LLCamera &camera, bool do_occlusion)
 	((LLSpatialGroup*)mOctree->getListener(0))->validate();
 #endif
 
-    if (LLPipeline::sShadowRender)
+    switch (get_cull_type(this))
+    {
+    case CULL_SHADOW:
     {
         LLOctreeCullShadow culler(&camera);
         culler.traverse(mOctree);
+        break;
     }
-    else if (mInfiniteFarClip || (!LLPipeline::sUseFarClip && !gCubeSnapshot))
+    case CULL_NO_FAR_CLIP:
     {
         LLOctreeCullNoFarClip culler(&camera);
         culler.traverse(mOctree);
+        break;
     }
-    else
+    default:
     {
         LLOctreeCull culler(&camera);
         culler.traverse(mOctree);
+        break;
+    }
     }
 	
 	return 0;
 }
 
+template <class T>
+using LLSpatialCullRecord = LLOctreeCullRecord<T, OctreeTraveler, OctreeNode, LLViewerOctreeGroup>;
+
+void LLSpatialCullSet::clear()
+{
+	mPartitions.clear();
+	mSubtreeCount = 0;
+	mNext = 0;
+}
+
+void LLSpatialCullSet::add(LLSpatialPartition* part, LLCamera& camera)
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_SPATIAL;
+
+	OctreeNode* root = part->mOctree;
+	LLSpatialGroup* group = (LLSpatialGroup*) root->getListener(0);
+	group->rebound();
+
+	const U8 type = get_cull_type(part);
+
+	mPartitions.emplace_back();
+	Partition& partition = mPartitions.back();
+	partition.mPartition = part;
+	partition.mCamera = &camera;
+	partition.mFirst = mSubtreeCount;
+
+	std::vector<Entry> unused;
+	S32 res;
+	switch (type)
+	{
+	case CULL_SHADOW:
+		res = LLSpatialCullRecord<LLOctreeCullShadow>(&camera, unused).recordRoot(root, partition.mRoot);
+		break;
+	case CULL_NO_FAR_CLIP:
+		res = LLSpatialCullRecord<LLOctreeCullNoFarClip>(&camera, unused).recordRoot(root, partition.mRoot);
+		break;
+	default:
+		res = LLSpatialCullRecord<LLOctreeCull>(&camera, unused).recordRoot(root, partition.mRoot);
+		break;
+	}
+
+	const U32 count = res ? root->getChildCount() : 0;
+	for (U32 i = 0; i < count; ++i)
+	{
+		if (mSubtreeCount == mSubtrees.size())
+		{
+			mSubtrees.emplace_back();
+		}
+		Subtree& subtree = mSubtrees[mSubtreeCount++];
+		subtree.mNode = root->getChild(i);
+		subtree.mCamera = &camera;
+		subtree.mRes = res;
+		subtree.mType = type;
+		subtree.mEntries.clear();
+	}
+	partition.mCount = count;
+}
+
+void LLSpatialCullSet::record()
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_SPATIAL;
+
+	LL::parallelFor("General", mSubtreeCount, 1,
+					[this](size_t begin, size_t end)
+					{
+						for (size_t i = begin; i < end; ++i)
+						{
+							record(mSubtrees[i]);
+						}
+					});
+}
+
+void LLSpatialCullSet::record(Subtree& subtree)
+{
+	switch (subtree.mType)
+	{
+	case CULL_SHADOW:
+		LLSpatialCullRecord<LLOctreeCullShadow>(subtree.mCamera, subtree.mEntries).recordSubtree(subtree.mNode, subtree.mRes);
+		break;
+	case CULL_NO_FAR_CLIP:
+		LLSpatialCullRecord<LLOctreeCullNoFarClip>(subtree.mCamera, subtree.mEntries).recordSubtree(subtree.mNode, subtree.mRes);
+		break;
+	default:
+		LLSpatialCullRecord<LLOctreeCull>(subtree.mCamera, subtree.mEntries).recordSubtree(subtree.mNode, subtree.mRes);
+		break;
+	}
+}
+
+void LLSpatialCullSet::replay(LLSpatialPartition* part)
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_SPATIAL;
+
+	llassert(mNext < mPartitions.size() && mPartitions[mNext].mPartition == part);
+	const Partition& partition = mPartitions[mNext++];
+
+	// the root is never occlusion culled, but its query still gets read
+	LLOctreeCull culler(partition.mCamera);
+	if (!LLSpatialCullRecord<LLOctreeCull>::replayRoot(culler, partition.mRoot))
+	{
+		return;
+	}
+
+	for (U32 i = partition.mFirst; i < partition.mFirst + partition.mCount; ++i)
+	{
+		LLSpatialCullRecord<LLOctreeCull>::replay(culler, mSubtrees[i].mEntries);
+	}
+}
+
 void pushVerts(LLDrawInfo* params)
 {
 	LLRenderPass::applyModelMatrix(*params);
@@ -31,6 +31,7 @@
 
 #include "lldrawable.h"
 #include "lloctree.h"
+#include "lloctreecullrecord.h"
 #include "llpointer.h"
 #include "llrefcount.h"
 #include "llvertexbuffer.h"
@@ -427,6 +428,56 @@ class LLSpatialPartition: public LLViewerOctreePartition, public LLGeometryManag
     bool mDepthMask; //if TRUE, objects in this partition will be written to depth during alpha rendering
 };
 
+// Culls a set of partitions against a camera with the octree walks spread
+// over the General pool.  A walk only reads the tree and the camera, so
+// each child of a partition's root is walked on its own, recording the
+// groups it reaches and which of them passed the frustum.  Occlusion
+// queries need GL and markNotCulled() fills the pipeline's cull result, so
+// both happen when the records are replayed on the main thread, in the
+// order LLSpatialPartition::cull() would have visited the groups.
+class LLSpatialCullSet
+{
+public:
+	typedef LLOctreeCullEntry<LLViewerOctreeGroup> Entry;
+
+	void clear();
+
+	// Rebounds part and checks its root, queues the root's children
+	void add(LLSpatialPartition* part, LLCamera& camera);
+
+	// Walks every queued subtree
+	void record();
+
+	// Replays the next partition added, which must be part
+	void replay(LLSpatialPartition* part);
+
+private:
+	struct Subtree
+	{
+		const OctreeNode*	mNode;
+		LLCamera*			mCamera;
+		S32					mRes;		// the root's frustum result, which the walk starts from
+		U8					mType;
+		std::vector<Entry>	mEntries;
+	};
+
+	struct Partition
+	{
+		LLSpatialPartition*	mPartition;
+		LLCamera*			mCamera;
+		Entry				mRoot;
+		U32					mFirst;		// subtrees [mFirst, mFirst + mCount)
+		U32					mCount;
+	};
+
+	void record(Subtree& subtree);
+
+	std::vector<Partition>	mPartitions;
+	std::vector<Subtree>	mSubtrees;	// kept across frames for the entry buffers
+	U32						mSubtreeCount = 0;
+	U32						mNext = 0;
+};
+
 // class for creating bridges between spatial partitions
 class LLSpatialBridge : public LLDrawable, public LLSpatialPartition
 {
@@ -669,6 +720,34 @@ class LLVolumeGeometryManager: public LLGeometryManager
 	void allocateFaces(U32 pMaxFaceCount);
 	void freeFaces();
 
+	// Runs the getGeometryVolume() calls genDrawInfo() queued, then
+	// uploads the buffers
+	void fillBuffers();
+
+	// A face whose vertex data genDrawInfo() left for fillBuffers()
+	struct FaceFill
+	{
+		LLMatrix4a	mVertXform;
+		LLMatrix4a	mNormXform;
+		LLFace*		mFace;
+		LLVolume*	mVolume;
+		S32			mTEOffset;
+		U16			mIndexOffset;
+	};
+
+	// One buffer's faces, filled in order on one thread since some of the
+	// copies run a few bytes into the next face's range
+	struct BufferFill
+	{
+		LLVertexBuffer*	mBuffer;
+		U32				mFirst;		// faces [mFirst, mFirst + mCount) of sFaceFills
+		U32				mCount;
+	};
+
+	static bool sDeferFill;		// genDrawInfo() queues faces instead of filling them
+	static std::vector<FaceFill> sFaceFills;
+	static std::vector<BufferFill> sBufferFills;
+
 	static int32_t sInstanceCount;
 	static LLFace** sFullbrightFaces[2];
 	static LLFace** sBumpFaces[2];
@@ -247,6 +247,7 @@ extern S32 gStartImageHeight;
 static bool gGotUseCircuitCodeAck = false;
 static std::string sInitialOutfit;
 static std::string sInitialOutfitGender;	// "male" or "female"
+static boost::signals2::connection sInventoryFetchedSlot;
 
 static bool gUseCircuitCallbackCalled = false;
 
@@ -659,6 +660,11 @@ bool idle_startup()
 				msg->mPacketRing.setUseOutThrottle(TRUE);
 				msg->mPacketRing.setOutBandwidth(outBandwidth);
 			}
+
+			if (gSavedSettings.getBOOL("AlchemyUDPReceiveThread"))
+			{
+				msg->mPacketRing.startReceiveThread(msg->mSocket);
+			}
 		}
 
 		LL_INFOS("AppInit") << "Message System Initialized." << LL_ENDL;
@@ -2043,6 +2049,21 @@ bool idle_startup()
 		{
 			LLNotificationsUtil::add("InventoryUnusable");
 		}
+
+		// Save what the initial fetch brought in rather than only at logout,
+		// which a crash never gets to
+		sInventoryFetchedSlot = LLInventoryModelBackgroundFetch::instance().setFetchCompletionCallback([]()
+		{
+			if (!LLInventoryModelBackgroundFetch::instance().isEverythingFetched())
+			{
+				return;
+			}
+			if (gInventory.isInventoryUsable() && gAgent.getID().notNull() && !LLApp::isExiting())
+			{
+				gInventory.cache(gInventory.getRootFolderID(), gAgent.getID(), true);
+			}
+			sInventoryFetchedSlot.disconnect();
+		});
 		
         LLInventoryModelBackgroundFetch::instance().start();
 		gInventory.createCommonSystemCategories();
@@ -51,11 +51,13 @@
 const S32 TEXTURE_CACHE_ENTRY_SIZE = FIRST_PACKET_SIZE;//1024;
 const F32 TEXTURE_CACHE_PURGE_AMOUNT = .20f; // % amount to reduce the cache by when it exceeds its limit
 const F32 TEXTURE_CACHE_LRU_SIZE = .10f; // % amount for LRU list (low overhead to regenerate)
-const S32 TEXTURE_FAST_CACHE_ENTRY_OVERHEAD = sizeof(S32) * 4; //w, h, c, level
-const S32 TEXTURE_FAST_CACHE_DATA_SIZE = 16 * 16 * 4;
-const S32 TEXTURE_FAST_CACHE_ENTRY_SIZE = TEXTURE_FAST_CACHE_DATA_SIZE + TEXTURE_FAST_CACHE_ENTRY_OVERHEAD;
+const F32 TEXTURE_FAST_CACHE_SLOTS_SIZE = .04f; // % of the cache for the 32x32 and 64x64 fast cache levels
 const F32 TEXTURE_LAZY_PURGE_TIME_LIMIT = .004f; // 4ms. Would be better to autoadjust, but there is a major cache rework in progress.
 const F32 TEXTURE_PRUNING_MAX_TIME = 15.f;
+const S32 TEXTURE_LOCK_FREE_LOOKUP_ATTEMPTS = 4; // before falling back to the header mutex
+
+LLTrace::SampleStatHandle<F32Microseconds> LLTextureCache::sEntryLookupLatency("texture_cache_lookup_latency", "Time to find a texture in the cache entry table");
+LLTrace::CountStatHandle<> LLTextureCache::sHeaderLockContention("texture_cache_lock_contention", "Times a thread had to wait for the texture cache header mutex");
 
 class LLTextureCacheWorker : public LLWorkerClass
 {
@@ -797,16 +799,16 @@ LLTextureCache::LLTextureCache(bool threaded)
 	  mWorkersMutex(),
 	  mHeaderMutex(),
 	  mListMutex(),
-	  mFastCacheMutex(),
 	  mHeaderAPRFile(NULL),
 	  mPrioritizeWriteListEmpty(true),
 	  mCompletedListEmpty(true),
 	  mReadOnly(TRUE), //do not allow to change the texture cache until setReadOnly() is called.
 	  mTexturesSizeTotal(0),
 	  mDoPurge(FALSE),
-	  mFastCachep(NULL),
-	  mFastCachePoolp(NULL),
-	  mFastCachePadBuffer(NULL)
+	  mLRUTime(0),
+	  mMappedInfo(NULL),
+	  mMappedEntries(NULL),
+	  mMappedCapacity(0)
 {
     mHeaderAPRFilePoolp = new LLVolatileAPRPool("Texture Cache Pool"); // is_local = true, because this pool is for headers, headers are under own mutex
 }
@@ -815,10 +817,9 @@ LLTextureCache::~LLTextureCache()
 {
 	clearDeleteList() ;
 	writeUpdatedEntries() ;
-	delete mFastCachep;
-	delete mFastCachePoolp;
+	closeEntriesMap();
+	mFastCache.close();
 	delete mHeaderAPRFilePoolp;
-	ll_aligned_free_16(mFastCachePadBuffer);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -884,10 +885,16 @@ std::string LLTextureCache::getTextureFileName(const LLUUID& id)
 //debug
 BOOL LLTextureCache::isInCache(const LLUUID& id) 
 {
-	LLMutexLock lock(&mHeaderMutex);
-	id_map_t::const_iterator iter = mHeaderIDMap.find(id);
-	
-	return (iter != mHeaderIDMap.end()) ;
+	S32 idx = -1;
+	if (mEntriesMap.isOpen() && lookupMappedEntry(id, idx, NULL))
+	{
+		return idx >= 0;
+	}
+
+	lockHeaders();
+	idx = mHeaderIDMap.find(id);
+	unlockHeaders();
+	return idx >= 0;
 }
 
 //debug
@@ -948,7 +955,8 @@ const char* cache_filename = "texture.cache";
 const char* old_textures_dirname = "textures";
 //change the location of the texture cache to prevent from being deleted by old version viewers.
 const char* textures_dirname = "texturecache";
-const char* fast_cache_filename = "FastCache.cache";
+const char* fast_cache_filename = "FastCacheV2.cache";
+const char* old_fast_cache_filename = "FastCache.cache";
 
 void LLTextureCache::setDirNames(ELLPath location)
 {
@@ -1001,10 +1009,14 @@ S64 LLTextureCache::initCache(ELLPath location, S64 max_size, BOOL texture_cache
 	llassert_always(getPending() == 0) ; //should not start accessing the texture cache before initialized.
 
 	S64 entries_size = (max_size * 36) / 100; //0.36 * max_size
-	S64 max_entries = entries_size / (S64)(TEXTURE_CACHE_ENTRY_SIZE + TEXTURE_FAST_CACHE_ENTRY_SIZE);
+	S64 max_entries = entries_size / (S64)(TEXTURE_CACHE_ENTRY_SIZE + LLTextureFastCache::getRecordSize());
 	sCacheMaxEntries = (U32)(llmin((S64)sCacheMaxEntries, max_entries));
-	entries_size = (S64)sCacheMaxEntries * (S64)(TEXTURE_CACHE_ENTRY_SIZE + TEXTURE_FAST_CACHE_ENTRY_SIZE);
+	entries_size = (S64)sCacheMaxEntries * (S64)(TEXTURE_CACHE_ENTRY_SIZE + LLTextureFastCache::getRecordSize());
 	max_size -= entries_size;
+	// The larger fast cache levels only for the most recently cached textures
+	const U32 fast_cache_slots = (U32)llclamp((S64)(max_size * TEXTURE_FAST_CACHE_SLOTS_SIZE) / LLTextureFastCache::getSlotSize(),
+											  (S64)1, (S64)sCacheMaxEntries);
+	max_size -= (S64)fast_cache_slots * LLTextureFastCache::getSlotSize();
 	if (sCacheMaxTexturesSize > 0)
 		sCacheMaxTexturesSize = llmin(sCacheMaxTexturesSize, max_size);
 	else
@@ -1038,19 +1050,121 @@ S64 LLTextureCache::initCache(ELLPath location, S64 max_size, BOOL texture_cache
 			std::string dirname = mTexturesDirName + gDirUtilp->getDirDelimiter() + subdirs[i];
 			LLFile::mkdir(dirname);
 		}
+
+		if (gSavedSettings.getBOOL("AlchemyTextureCacheMapped"))
+		{
+			openEntriesMap();
+		}
 	}
 	readHeaderCache();
 	purgeTextures(true); // calc mTexturesSize and make some room in the texture cache if we need it
 
 	llassert_always(getPending() == 0) ; //should not start accessing the texture cache before initialized.
-	openFastCache(true);
+	if (!mReadOnly)
+	{
+		// Replaced by the mapped fast cache
+		LLFile::remove(gDirUtilp->getExpandedFilename(location, textures_dirname, old_fast_cache_filename), ENOENT);
+	}
+	mFastCache.open(mFastCacheFileName, sCacheMaxEntries, fast_cache_slots, mReadOnly);
 
 	return max_size; // unused cache space
 }
 
+// Called in the main thread from initCache(), before any worker runs.
+// Maps room for sCacheMaxEntries entries up front so that the mapping never
+// has to move while other threads read through it.
+bool LLTextureCache::openEntriesMap()
+{
+	const size_t map_size = sizeof(EntriesInfo) + (size_t)sCacheMaxEntries * sizeof(Entry);
+	if (!mEntriesMap.open(mHeaderEntriesFileName, map_size))
+	{
+		LL_WARNS("TextureCache") << "Unable to map " << mHeaderEntriesFileName << ", using file I/O for cache entries" << LL_ENDL;
+		return false;
+	}
+
+	mMappedInfo = (EntriesInfo*)mEntriesMap.getData();
+	mMappedEntries = (Entry*)(mEntriesMap.getData() + sizeof(EntriesInfo));
+	mMappedCapacity = (U32)((mEntriesMap.getSize() - sizeof(EntriesInfo)) / sizeof(Entry));
+	mAccessTimes.reset(new std::atomic<U32>[mMappedCapacity]);
+	for (U32 i = 0; i < mMappedCapacity; ++i)
+	{
+		mAccessTimes[i].store(0, std::memory_order_relaxed);
+	}
+
+	LL_INFOS("TextureCache") << "Mapped " << mMappedCapacity << " cache entries from " << mHeaderEntriesFileName << LL_ENDL;
+	return true;
+}
+
+// Called once the workers are gone
+void LLTextureCache::closeEntriesMap()
+{
+	if (mEntriesMap.isOpen())
+	{
+		mEntriesMap.flush(true);
+		mEntriesMap.close();
+		mMappedInfo = NULL;
+		mMappedEntries = NULL;
+		mMappedCapacity = 0;
+	}
+}
+
+// Lock free, called from any thread. Returns false if writers kept changing
+// the entries while looking, or the entry found is being replaced; the
+// caller then has to take mHeaderMutex and look again.
+bool LLTextureCache::lookupMappedEntry(const LLUUID& id, S32& idx, Entry* entry)
+{
+	for (S32 attempt = 0; attempt < TEXTURE_LOCK_FREE_LOOKUP_ATTEMPTS; ++attempt)
+	{
+		const U32 seq = mHeaderIDMap.readBegin();
+		idx = mHeaderIDMap.find(id);
+		if (idx >= (S32)mMappedCapacity)
+		{
+			return false;
+		}
+		if (idx >= 0 && entry)
+		{
+			// Can race with a writer, readRetry() then throws the copy away
+			memcpy((void*)entry, (const void*)&mMappedEntries[idx], sizeof(Entry));
+		}
+		if (!mHeaderIDMap.readRetry(seq))
+		{
+			return !entry || idx < 0 || entry->mID == id;
+		}
+	}
+	return false;
+}
+
+void LLTextureCache::lockHeaders()
+{
+	if (!mHeaderMutex.try_lock())
+	{
+		add(sHeaderLockContention, 1);
+		mHeaderMutex.lock();
+	}
+}
+
 //----------------------------------------------------------------------------
 // mHeaderMutex must be locked for the following functions!
 
+// Copies the access times recorded by lock free lookups into the mapped entries
+void LLTextureCache::applyAccessTimes()
+{
+	const U32 num_entries = llmin(mHeaderEntriesInfo.mEntries, mMappedCapacity);
+	for (U32 idx = 0; idx < num_entries; ++idx)
+	{
+		if (mAccessTimes[idx].load(std::memory_order_relaxed))
+		{
+			const U32 time = mAccessTimes[idx].exchange(0, std::memory_order_relaxed);
+			if (time > mMappedEntries[idx].mTime)
+			{
+				mHeaderIDMap.beginWrite();
+				mMappedEntries[idx].mTime = time;
+				mHeaderIDMap.endWrite();
+			}
+		}
+	}
+}
+
 LLAPRFile* LLTextureCache::openHeaderEntriesFile(bool readonly, S32 offset)
 {
 	llassert_always(mHeaderAPRFile == NULL);
@@ -1078,7 +1192,12 @@ void LLTextureCache::readEntriesHeader()
 {
 	// mHeaderEntriesInfo initializes to default values so safe not to read it
 	llassert_always(mHeaderAPRFile == NULL);
-	if (LLAPRFile::isExist(mHeaderEntriesFileName, mHeaderAPRFilePoolp))
+	if (mEntriesMap.isOpen())
+	{
+		// A new file is all zeros, which fails the version check
+		memcpy((void*)&mHeaderEntriesInfo, (const void*)mMappedInfo, sizeof(EntriesInfo));
+	}
+	else if (LLAPRFile::isExist(mHeaderEntriesFileName, mHeaderAPRFilePoolp))
 	{
 		LLAPRFile::readEx(mHeaderEntriesFileName, (U8*)&mHeaderEntriesInfo, 0, sizeof(EntriesInfo),
 						  mHeaderAPRFilePoolp);
@@ -1110,7 +1229,16 @@ void LLTextureCache::setEntriesHeader()
 void LLTextureCache::writeEntriesHeader()
 {
 	llassert_always(mHeaderAPRFile == NULL);
-	if (!mReadOnly)
+	if (mReadOnly)
+	{
+		return;
+	}
+
+	if (mEntriesMap.isOpen())
+	{
+		memcpy((void*)mMappedInfo, (const void*)&mHeaderEntriesInfo, sizeof(EntriesInfo));
+	}
+	else
 	{
 		LLAPRFile::writeEx(mHeaderEntriesFileName, (U8*)&mHeaderEntriesInfo, 0, sizeof(EntriesInfo),
 						   mHeaderAPRFilePoolp);
@@ -1120,13 +1248,7 @@ void LLTextureCache::writeEntriesHeader()
 //mHeaderMutex is locked before calling this.
 S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create)
 {
-	S32 idx = -1;
-	
-	id_map_t::iterator iter1 = mHeaderIDMap.find(id);
-	if (iter1 != mHeaderIDMap.end())
-	{
-		idx = iter1->second;
-	}
+	S32 idx = mHeaderIDMap.find(id);
 
 	if (idx < 0)
 	{
@@ -1153,10 +1275,16 @@ S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create
 					// Erase entry from LRU regardless
 					mLRU.erase(curiter2);
 					// Look up entry and use it if it is valid
-					id_map_t::iterator iter3 = mHeaderIDMap.find(oldid);
-					if (iter3 != mHeaderIDMap.end() && iter3->second >= 0)
+					S32 old_idx = mHeaderIDMap.find(oldid);
+					if (old_idx >= 0)
 					{
-						idx = iter3->second;
+						// Lock free lookups can't take it off the LRU, skip it if it was used since
+						if (mEntriesMap.isOpen() && old_idx < (S32)mMappedCapacity
+							&& mAccessTimes[old_idx].load(std::memory_order_relaxed) >= mLRUTime)
+						{
+							continue;
+						}
+						idx = old_idx;
 						removeCachedTexture(oldid) ;//remove the existing cached texture to release the entry index.
 						break;
 					}
@@ -1204,6 +1332,28 @@ S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create
 //mHeaderMutex is locked before calling this.
 void LLTextureCache::writeEntryToHeaderImmediately(S32& idx, Entry& entry, bool write_header)
 {	
+	if (mEntriesMap.isOpen())
+	{
+		if (idx < 0 || idx >= (S32)mMappedCapacity)
+		{
+			clearCorruptedCache() ; //clear the cache.
+			idx = -1 ;//mark the idx invalid.
+			return ;
+		}
+
+		// The entry goes in before the header that counts it, so that a
+		// crash in between never leaves the header covering garbage
+		mHeaderIDMap.beginWrite();
+		memcpy((void*)&mMappedEntries[idx], (const void*)&entry, sizeof(Entry));
+		mHeaderIDMap.endWrite();
+		if (write_header)
+		{
+			memcpy((void*)mMappedInfo, (const void*)&mHeaderEntriesInfo, sizeof(EntriesInfo));
+		}
+		mUpdatedEntryMap.erase(idx) ;
+		return ;
+	}
+
 	LLAPRFile* aprfile ;
 	S32 bytes_written ;
 	S32 offset = sizeof(EntriesInfo) + idx * sizeof(Entry);
@@ -1240,6 +1390,18 @@ void LLTextureCache::writeEntryToHeaderImmediately(S32& idx, Entry& entry, bool
 //mHeaderMutex is locked before calling this.
 void LLTextureCache::readEntryFromHeaderImmediately(S32& idx, Entry& entry)
 {
+	if (mEntriesMap.isOpen())
+	{
+		if (idx < 0 || idx >= (S32)mMappedCapacity)
+		{
+			clearCorruptedCache() ; //clear the cache.
+			idx = -1 ;//mark the idx invalid.
+			return ;
+		}
+		memcpy((void*)&entry, (const void*)&mMappedEntries[idx], sizeof(Entry));
+		return ;
+	}
+
 	S32 offset = sizeof(EntriesInfo) + idx * sizeof(Entry);
 	LLAPRFile* aprfile = openHeaderEntriesFile(true, offset);
 	S32 bytes_read = aprfile->read((void*)&entry, (S32)sizeof(Entry));
@@ -1258,6 +1420,18 @@ void LLTextureCache::updateEntryTimeStamp(S32 idx, Entry& entry)
 {
 	static const U32 MAX_ENTRIES_WITHOUT_TIME_STAMP = (U32)(LLTextureCache::sCacheMaxEntries * 0.75f) ;
 
+	if (mEntriesMap.isOpen())
+	{
+		// No I/O involved, always keep track. Also called without the
+		// header mutex from lock free lookups.
+		if (idx >= 0 && idx < (S32)mMappedCapacity && !mReadOnly)
+		{
+			entry.mTime = time(NULL);
+			mAccessTimes[idx].store(entry.mTime, std::memory_order_relaxed);
+		}
+		return ;
+	}
+
 	if(mHeaderEntriesInfo.mEntries < MAX_ENTRIES_WITHOUT_TIME_STAMP)
 	{
 		return ; //there are enough empty entry index space, no need to stamp time.
@@ -1289,10 +1463,13 @@ bool LLTextureCache::updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32
 
 		lockHeaders() ;
 
+		// Lock free readers must not see the new ID before its entry
+		mHeaderIDMap.beginWrite();
+
 		bool update_header = false ;
 		if(entry.mImageSize < 0) //is a brand-new entry
 		{
-			mHeaderIDMap[entry.mID] = idx;
+			mHeaderIDMap.insert(entry.mID, idx);
 			mTexturesSizeMap[entry.mID] = new_body_size ;
 			mTexturesSizeTotal += new_body_size ;
 			
@@ -1311,6 +1488,7 @@ bool LLTextureCache::updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32
 		entry.mBodySize = new_body_size ;
 		
 		writeEntryToHeaderImmediately(idx, entry, update_header) ;
+		mHeaderIDMap.endWrite();
 	
 		if (mTexturesSizeTotal > sCacheMaxTexturesSize)
 		{
@@ -1332,45 +1510,63 @@ U32 LLTextureCache::openAndReadEntries(std::vector<Entry>& entries)
 {
 	U32 num_entries = mHeaderEntriesInfo.mEntries;
 
+	// Lock free readers wait for the whole rebuild rather than see it half done
+	LLTextureCacheIndex::ScopedWrite index_write(mHeaderIDMap);
 	mHeaderIDMap.clear();
+	mFastCache.clear();
 	mTexturesSizeMap.clear();
 	mFreeList.clear();
 	mTexturesSizeTotal = 0;
 
-	LLAPRFile* aprfile = NULL; 
-	if(mUpdatedEntryMap.empty())
+	if (mEntriesMap.isOpen())
 	{
-		aprfile = openHeaderEntriesFile(true, (S32)sizeof(EntriesInfo));
+		if (num_entries > mMappedCapacity)
+		{
+			LL_WARNS() << "Corrupted header entries, " << num_entries << " entries but room for " << mMappedCapacity << LL_ENDL;
+			purgeAllTextures(false);
+			return 0;
+		}
+		applyAccessTimes();
+		entries.assign(mMappedEntries, mMappedEntries + num_entries);
 	}
-	else //update the header file first.
+	else
 	{
-		aprfile = openHeaderEntriesFile(false, 0);
-		updatedHeaderEntriesFile() ;
-		if(!aprfile)
+		LLAPRFile* aprfile = NULL; 
+		if(mUpdatedEntryMap.empty())
+		{
+			aprfile = openHeaderEntriesFile(true, (S32)sizeof(EntriesInfo));
+		}
+		else //update the header file first.
+		{
+			aprfile = openHeaderEntriesFile(false, 0);
+			updatedHeaderEntriesFile() ;
+			if(!aprfile)
+			{
+				return 0;
+			}
+			aprfile->seek(APR_SET, (S32)sizeof(EntriesInfo));
+		}
+
+		entries.resize(num_entries);
+		S32 total_entries_size = sizeof(Entry) * num_entries;
+		S32 bytes_read = aprfile->read((void*)entries.data(), total_entries_size);
+		if (bytes_read != total_entries_size)
 		{
+			LL_WARNS() << "Corrupted header entries, expected " << total_entries_size << " bytes but got " << bytes_read << " bytes" << LL_ENDL;
+			closeHeaderEntriesFile();
+			purgeAllTextures(false);
 			return 0;
 		}
-		aprfile->seek(APR_SET, (S32)sizeof(EntriesInfo));
+		closeHeaderEntriesFile();
 	}
 
-    entries.resize(num_entries);
-    S32 total_entries_size = sizeof(Entry) * num_entries;
-    S32 bytes_read = aprfile->read((void*)entries.data(), total_entries_size);
-    if (bytes_read != total_entries_size)
-    {
-        LL_WARNS() << "Corrupted header entries, expected " << total_entries_size << " bytes but got " << bytes_read << " bytes" << LL_ENDL;
-        closeHeaderEntriesFile();
-        purgeAllTextures(false);
-        return 0;
-    }
-
 	for (U32 idx=0; idx<num_entries; idx++)
 	{
 		const Entry& entry = entries[idx];
 // 		LL_INFOS() << "ENTRY: " << entry.mTime << " TEX: " << entry.mID << " IDX: " << idx << " Size: " << entry.mImageSize << LL_ENDL;
 		if(entry.mImageSize > entry.mBodySize)
 		{
-			mHeaderIDMap[entry.mID] = idx;
+			mHeaderIDMap.insert(entry.mID, idx);
 			mTexturesSizeMap[entry.mID] = entry.mBodySize;
 			mTexturesSizeTotal += entry.mBodySize;
 		}
@@ -1379,7 +1575,6 @@ U32 LLTextureCache::openAndReadEntries(std::vector<Entry>& entries)
 			mFreeList.insert(idx);
 		}
 	}
-	closeHeaderEntriesFile();
 	return num_entries;
 }
 
@@ -1388,7 +1583,18 @@ void LLTextureCache::writeEntriesAndClose(const std::vector<Entry>& entries)
 	S32 num_entries = entries.size();
 	llassert_always(num_entries == mHeaderEntriesInfo.mEntries);
 	
-	if (!mReadOnly)
+	if (!mReadOnly && mEntriesMap.isOpen())
+	{
+		if (num_entries > (S32)mMappedCapacity)
+		{
+			clearCorruptedCache() ; //clear the cache.
+			return ;
+		}
+		mHeaderIDMap.beginWrite();
+		memcpy((void*)mMappedEntries, (const void*)entries.data(), num_entries * sizeof(Entry));
+		mHeaderIDMap.endWrite();
+	}
+	else if (!mReadOnly)
 	{
 		LLAPRFile* aprfile = openHeaderEntriesFile(false, (S32)sizeof(EntriesInfo));
 		for (S32 idx=0; idx<num_entries; idx++)
@@ -1407,13 +1613,24 @@ void LLTextureCache::writeEntriesAndClose(const std::vector<Entry>& entries)
 void LLTextureCache::writeUpdatedEntries()
 {
 	lockHeaders() ;
-	if (!mReadOnly && !mUpdatedEntryMap.empty())
+	if (!mReadOnly && mEntriesMap.isOpen())
+	{
+		// Everything else is already in the mapping
+		applyAccessTimes();
+		mEntriesMap.flush();
+	}
+	else if (!mReadOnly && !mUpdatedEntryMap.empty())
 	{
 		openHeaderEntriesFile(false, 0);
 		updatedHeaderEntriesFile() ;
 		closeHeaderEntriesFile();
 	}
 	unlockHeaders() ;
+
+	if (!mReadOnly)
+	{
+		mFastCache.flush();
+	}
 }
 
 //mHeaderMutex is locked and mHeaderAPRFile is created before calling this.
@@ -1461,8 +1678,11 @@ void LLTextureCache::readHeaderCache()
 	mHeaderMutex.lock();
 
 	mLRU.clear(); // always clear the LRU
+	mLRUTime = time(NULL);
 
 	readEntriesHeader();
+	// Only grows the first time, before any lookups run
+	mHeaderIDMap.reserve(llmax(sCacheMaxEntries, mHeaderEntriesInfo.mEntries));
 	
 	if (mHeaderEntriesInfo.mVersion != sHeaderCacheVersion
 		|| mHeaderEntriesInfo.mAdressSize != sHeaderCacheAddressSize
@@ -1609,17 +1829,38 @@ void LLTextureCache::purgeAllTextures(bool purge_directories)
             PeekMessage(&msg, 0, 0, 0, PM_NOREMOVE | PM_NOYIELD);
 #endif
 		}
-		gDirUtilp->deleteFilesInDir(mTexturesDirName, mask); // headers, fast cache
+		if (mEntriesMap.isOpen() || mFastCache.isOpen())
+		{
+			// Mapped files stay and are reset below
+			if (!mEntriesMap.isOpen())
+			{
+				LLFile::remove(mHeaderEntriesFileName, ENOENT);
+			}
+			LLFile::remove(mHeaderDataFileName, ENOENT);
+			if (!mFastCache.isOpen())
+			{
+				LLFile::remove(mFastCacheFileName, ENOENT);
+			}
+		}
+		else
+		{
+			gDirUtilp->deleteFilesInDir(mTexturesDirName, mask); // headers, fast cache
+		}
 		if (purge_directories)
 		{
 			LLFile::rmdir(mTexturesDirName);
 		}
 	}
 	mHeaderIDMap.clear();
+	mFastCache.clear();
 	mTexturesSizeMap.clear();
 	mTexturesSizeTotal = 0;
 	mFreeList.clear();
 	mUpdatedEntryMap.clear();
+	for (U32 i = 0; i < mMappedCapacity; ++i)
+	{
+		mAccessTimes[i].store(0, std::memory_order_relaxed);
+	}
 
 	// Info with 0 entries
 	setEntriesHeader();
@@ -1661,10 +1902,9 @@ void LLTextureCache::purgeTexturesLazy(F32 time_limit_sec)
 		{
 			if (iter1->second > 0)
 			{
-				id_map_t::iterator iter2 = mHeaderIDMap.find(iter1->first);
-				if (iter2 != mHeaderIDMap.end())
+				S32 idx = mHeaderIDMap.find(iter1->first);
+				if (idx >= 0)
 				{
-					S32 idx = iter2->second;
 					time_idx_set.insert(std::make_pair(entries[idx].mTime, idx));
 				}
 				else
@@ -1702,8 +1942,7 @@ void LLTextureCache::purgeTexturesLazy(F32 time_limit_sec)
 			Entry entry = mPurgeEntryList.back().second;
 			mPurgeEntryList.pop_back();
 			// make sure record is still valid
-			id_map_t::iterator iter_header = mHeaderIDMap.find(entry.mID);
-			if (iter_header != mHeaderIDMap.end() && iter_header->second == idx)
+			if (mHeaderIDMap.find(entry.mID) == idx)
 			{
 				std::string tex_filename = getTextureFileName(entry.mID);
 				removeEntry(idx, entry, tex_filename);
@@ -1746,10 +1985,9 @@ void LLTextureCache::purgeTextures(bool validate)
 	{
 		if (iter1->second > 0)
 		{
-			id_map_t::iterator iter2 = mHeaderIDMap.find(iter1->first);
-			if (iter2 != mHeaderIDMap.end())
+			S32 idx = mHeaderIDMap.find(iter1->first);
+			if (idx >= 0)
 			{
-				S32 idx = iter2->second;
 				time_idx_set.insert(std::make_pair(entries[idx].mTime, idx));
 // 				LL_INFOS() << "TIME: " << entries[idx].mTime << " TEX: " << entries[idx].mID << " IDX: " << idx << " Size: " << entries[idx].mImageSize << LL_ENDL;
 			}
@@ -1863,12 +2101,27 @@ LLTextureCacheWorker* LLTextureCache::getWriter(handle_t handle)
 S32 LLTextureCache::getHeaderCacheEntry(const LLUUID& id, Entry& entry)
 {
     LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
-	LLMutexLock lock(&mHeaderMutex);	
-	S32 idx = openAndReadEntry(id, entry, false);
-	if (idx >= 0)
-	{		
-		updateEntryTimeStamp(idx, entry); // updates time
+	const U64MicrosecondsImplicit start = LLTimer::getTotalTime();
+	S32 idx = -1;
+	if (mEntriesMap.isOpen() && lookupMappedEntry(id, idx, &entry)
+		&& (idx < 0 || entry.mImageSize > entry.mBodySize)) // leave corrupted entries to openAndReadEntry()
+	{
+		if (idx >= 0)
+		{
+			updateEntryTimeStamp(idx, entry); // updates time
+		}
+	}
+	else
+	{
+		lockHeaders();
+		idx = openAndReadEntry(id, entry, false);
+		if (idx >= 0)
+		{		
+			updateEntryTimeStamp(idx, entry); // updates time
+		}
+		unlockHeaders();
 	}
+	sample(sEntryLookupLatency, F32Microseconds((F32)(LLTimer::getTotalTime() - start).value()));
 	return idx;
 }
 
@@ -1876,17 +2129,17 @@ S32 LLTextureCache::getHeaderCacheEntry(const LLUUID& id, Entry& entry)
 S32 LLTextureCache::setHeaderCacheEntry(const LLUUID& id, Entry& entry, S32 imagesize, S32 datasize)
 {
     LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
-	mHeaderMutex.lock();
+	lockHeaders();
 	S32 idx = openAndReadEntry(id, entry, true); // read or create
-	mHeaderMutex.unlock();
+	unlockHeaders();
 
 	if(idx < 0) // retry once
 	{
 		readHeaderCache(); // We couldn't write an entry, so refresh the LRU
 
-		mHeaderMutex.lock();
+		lockHeaders();
 		idx = openAndReadEntry(id, entry, true);
-		mHeaderMutex.unlock();
+		unlockHeaders();
 	}
 
 	if (idx >= 0)
@@ -2002,187 +2255,27 @@ LLTextureCache::handle_t LLTextureCache::writeToCache(const LLUUID& id,
 	return handle;
 }
 
-//called in the main thread
-LLPointer<LLImageRaw> LLTextureCache::readFromFastCache(const LLUUID& id, S32& discardlevel)
+// Called in the main thread, but safe on any thread
+LLPointer<LLImageRaw> LLTextureCache::readFromFastCache(const LLUUID& id, S32& discardlevel, S32 max_dimension)
 {
-	U32 offset;
+	S32 idx = -1;
+	if (!mEntriesMap.isOpen() || !lookupMappedEntry(id, idx, NULL))
 	{
-		LLMutexLock lock(&mHeaderMutex);
-		id_map_t::const_iterator iter = mHeaderIDMap.find(id);
-		if(iter == mHeaderIDMap.end())
-		{
-			return NULL; //not in the cache
-		}
-
-		offset = iter->second;
+		lockHeaders();
+		idx = mHeaderIDMap.find(id);
+		unlockHeaders();
 	}
-	offset *= TEXTURE_FAST_CACHE_ENTRY_SIZE;
-
-	U8* data;
-	S32 head[4];
+	if (idx < 0)
 	{
-		LLMutexLock lock(&mFastCacheMutex);
-
-		openFastCache();
-
-		mFastCachep->seek(APR_SET, offset);		
-	
-		if(mFastCachep->read(head, TEXTURE_FAST_CACHE_ENTRY_OVERHEAD) != TEXTURE_FAST_CACHE_ENTRY_OVERHEAD)
-		{
-			//cache corrupted or under thread race condition
-			closeFastCache(); 
-			return NULL;
-		}
-		
-		S32 image_size = head[0] * head[1] * head[2];
-        if(image_size <= 0
-           || image_size > TEXTURE_FAST_CACHE_DATA_SIZE
-           || head[3] < 0) //invalid
-		{
-			closeFastCache();
-			return NULL;
-		}
-		discardlevel = head[3];
-		
-		data = (U8*)ll_aligned_malloc_16(image_size);
-		if(mFastCachep->read(data, image_size) != image_size)
-		{
-			ll_aligned_free_16(data);
-			closeFastCache();
-			return NULL;
-		}
-
-		closeFastCache();
+		return NULL; //not in the cache
 	}
-	LLPointer<LLImageRaw> raw = new LLImageRaw(data, head[0], head[1], head[2], true);
 
-	return raw;
+	return mFastCache.read(id, idx, max_dimension, discardlevel);
 }
 
-//return the fast cache location
 bool LLTextureCache::writeToFastCache(LLUUID image_id, S32 id, LLPointer<LLImageRaw> raw, S32 discardlevel)
 {
-    LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
-	//rescale image if needed
-	if (raw.isNull() || raw->isBufferInvalid() || !raw->getData())
-	{
-		LL_ERRS() << "Attempted to write NULL raw image to fastcache" << LL_ENDL;
-		return false;
-	}
-
-	S32 w, h, c;
-	w = raw->getWidth();
-	h = raw->getHeight();
-	c = raw->getComponents();
-
-	S32 i = 0 ;
-
-	// Search for a discard level that will fit into fast cache
-	while(((w >> i) * (h >> i) * c) > TEXTURE_FAST_CACHE_DATA_SIZE)
-	{
-		++i ;
-	}
-		
-	if(i)
-	{
-		w >>= i;
-		h >>= i;
-		if(w * h *c > 0) //valid
-		{
-            // Make a duplicate to keep the original raw image untouched.
-            raw = raw->duplicate();
-
-			if (raw->isBufferInvalid())
-			{
-				LL_WARNS() << "Invalid image duplicate buffer" << LL_ENDL;
-				return false;
-			}
-
-			raw->scale(w, h);
-
-			discardlevel += i ;
-		}
-	}
-	
-	//copy data
-	memcpy(mFastCachePadBuffer, &w, sizeof(S32));
-	memcpy(mFastCachePadBuffer + sizeof(S32), &h, sizeof(S32));
-	memcpy(mFastCachePadBuffer + sizeof(S32) * 2, &c, sizeof(S32));
-	memcpy(mFastCachePadBuffer + sizeof(S32) * 3, &discardlevel, sizeof(S32));
-
-	S32 copy_size = w * h * c;
-	if(copy_size > 0) //valid
-	{
-		copy_size = llmin(copy_size, TEXTURE_FAST_CACHE_ENTRY_SIZE - TEXTURE_FAST_CACHE_ENTRY_OVERHEAD);
-		memcpy(mFastCachePadBuffer + TEXTURE_FAST_CACHE_ENTRY_OVERHEAD, raw->getData(), copy_size);
-	}
-	S32 offset = id * TEXTURE_FAST_CACHE_ENTRY_SIZE;
-
-	{
-		LLMutexLock lock(&mFastCacheMutex);
-
-		openFastCache();
-
-		mFastCachep->seek(APR_SET, offset);	
-		
-		//no need to do this assertion check. When it fails, let it fail quietly.
-		//this failure could happen because other viewer removes the fast cache file when clearing cache.
-		//--> llassert_always(mFastCachep->write(mFastCachePadBuffer, TEXTURE_FAST_CACHE_ENTRY_SIZE) == TEXTURE_FAST_CACHE_ENTRY_SIZE);
-		mFastCachep->write(mFastCachePadBuffer, TEXTURE_FAST_CACHE_ENTRY_SIZE);
-
-		closeFastCache(true);
-	}
-
-	return true;
-}
-
-void LLTextureCache::openFastCache(bool first_time)
-{
-	if(!mFastCachep)
-	{
-		if(first_time)
-		{
-			if(!mFastCachePadBuffer)
-			{
-				mFastCachePadBuffer = (U8*)ll_aligned_malloc_16(TEXTURE_FAST_CACHE_ENTRY_SIZE);
-			}
-			mFastCachePoolp = new LLVolatileAPRPool("Fast Cache Pool", FALSE); // is_local=false, thread safe mode due to crashes 
-			if (LLAPRFile::isExist(mFastCacheFileName, mFastCachePoolp))
-			{
-				mFastCachep = new LLAPRFile(mFastCacheFileName, APR_READ|APR_WRITE|APR_BINARY, mFastCachePoolp) ;				
-			}
-			else
-			{
-				mFastCachep = new LLAPRFile(mFastCacheFileName, APR_CREATE|APR_READ|APR_WRITE|APR_BINARY, mFastCachePoolp) ;
-			}
-		}
-		else
-		{
-			mFastCachep = new LLAPRFile(mFastCacheFileName, APR_READ|APR_WRITE|APR_BINARY, mFastCachePoolp) ;
-		}
-
-		mFastCacheTimer.reset();
-	}
-	return;
-}
-	
-void LLTextureCache::closeFastCache(bool forced)
-{	
-	static const F32 timeout = 10.f ; //seconds
-
-	if(!mFastCachep)
-	{
-		return ;
-	}
-
-	if(!forced && mFastCacheTimer.getElapsedTimeF32() < timeout)
-	{
-		return ;
-	}
-
-	delete mFastCachep;
-	mFastCachep = NULL;
-	return;
+	return mFastCache.write(image_id, id, raw, discardlevel);
 }
 	
 bool LLTextureCache::writeComplete(handle_t handle, bool abort)
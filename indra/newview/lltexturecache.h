@@ -28,8 +28,12 @@
 #define LL_LLTEXTURECACHE_H
 
 #include "lldir.h"
+#include "llmappedfile.h"
 #include "llstl.h"
 #include "llstring.h"
+#include "lltexturecacheindex.h"
+#include "lltexturefastcache.h"
+#include "lltrace.h"
 #include "lluuid.h"
 
 #include "llworkerthread.h"
@@ -129,7 +133,8 @@ class LLTextureCache final : public LLWorkerThread
 	bool readComplete(handle_t handle, bool abort);
 	handle_t writeToCache(const LLUUID& id, U8* data, S32 datasize, S32 imagesize, LLPointer<LLImageRaw> rawimage, S32 discardlevel,
 						  WriteResponder* responder);
-	LLPointer<LLImageRaw> readFromFastCache(const LLUUID& id, S32& discardlevel);
+	// Returns the largest thumbnail kept for id that fits in max_dimension
+	LLPointer<LLImageRaw> readFromFastCache(const LLUUID& id, S32& discardlevel, S32 max_dimension = 16);
 	bool writeComplete(handle_t handle, bool abort = false);
 	void prioritizeWrite(handle_t handle);
 
@@ -150,6 +155,10 @@ class LLTextureCache final : public LLWorkerThread
 	U32 getMaxEntries() { return sCacheMaxEntries; };
 	BOOL isInCache(const LLUUID& id) ;
 	BOOL isInLocal(const LLUUID& id) ; //not thread safe at the moment
+	bool isEntriesMapped() const { return mEntriesMap.isOpen(); }
+
+	static LLTrace::SampleStatHandle<F32Microseconds> sEntryLookupLatency;
+	static LLTrace::CountStatHandle<> sHeaderLockContention;
 
 protected:
 	// Accessed by LLTextureCacheWorker
@@ -185,11 +194,15 @@ class LLTextureCache final : public LLWorkerThread
 	S32 setHeaderCacheEntry(const LLUUID& id, Entry& entry, S32 imagesize, S32 datasize);
 	void writeUpdatedEntries() ;
 	void updatedHeaderEntriesFile() ;
-	void lockHeaders() { mHeaderMutex.lock(); }
+	void lockHeaders(); // counts contention
 	void unlockHeaders() { mHeaderMutex.unlock(); }
+
+	// Memory mapped texture.entries
+	bool openEntriesMap();
+	void closeEntriesMap();
+	bool lookupMappedEntry(const LLUUID& id, S32& idx, Entry* entry);
+	void applyAccessTimes();
 	
-	void openFastCache(bool first_time = false);
-	void closeFastCache(bool forced = false);
 	bool writeToFastCache(LLUUID image_id, S32 cache_id, LLPointer<LLImageRaw> raw, S32 discardlevel);	
 
 private:
@@ -197,9 +210,7 @@ class LLTextureCache final : public LLWorkerThread
 	LLMutex mWorkersMutex;
 	LLMutex mHeaderMutex;
 	LLMutex mListMutex;
-	LLMutex mFastCacheMutex;
 	LLAPRFile* mHeaderAPRFile;
-	LLVolatileAPRPool* mFastCachePoolp;
 
 	// mLocalAPRFilePoolp is not thread safe and is meant only for workers
 	// howhever mHeaderEntriesFileName is accessed not from workers' threads
@@ -227,12 +238,23 @@ class LLTextureCache final : public LLWorkerThread
 	EntriesInfo mHeaderEntriesInfo;
 	std::set<S32> mFreeList; // deleted entries
 	std::set<LLUUID> mLRU;
-	typedef boost::unordered_flat_map<LLUUID, S32> id_map_t;
-	id_map_t mHeaderIDMap;
-
-	LLAPRFile*   mFastCachep;
-	LLFrameTimer mFastCacheTimer;
-	U8*          mFastCachePadBuffer;
+	U32 mLRUTime; // when mLRU was built
+	LLTextureCacheIndex mHeaderIDMap;
+
+	// When AlchemyTextureCacheMapped is set, texture.entries is mapped into
+	// memory for the whole session, sized for sCacheMaxEntries entries, and
+	// is read and patched in place instead of through mHeaderAPRFile.
+	// Lookups then only need mHeaderIDMap and the mapping, and can run on
+	// any thread without mHeaderMutex; access times are kept aside in
+	// mAccessTimes and folded into the entries under the mutex.
+	LLMappedFile mEntriesMap;
+	EntriesInfo* mMappedInfo;
+	Entry* mMappedEntries;
+	U32 mMappedCapacity;
+	std::unique_ptr<std::atomic<U32>[]> mAccessTimes;
+
+	// Thumbnails of the cached textures, indexed like texture.entries
+	LLTextureFastCache mFastCache;
 
 	// BODIES (TEXTURES minus headers)
 	std::string mTexturesDirName;
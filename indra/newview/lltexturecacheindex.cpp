@@ -0,0 +1,302 @@
+/**
+ * @file lltexturecacheindex.cpp
+ * @brief Open addressed texture ID to cache entry index map with lock free lookups.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "lltexturecacheindex.h"
+
+#include <vector>
+
+// The table is sized to be at most half full so that probe sequences stay short
+static const U32 MIN_SLOTS = 1024;
+
+LLTextureCacheIndex::LLTextureCacheIndex()
+	: mMask(0),
+	  mMaxEntries(0),
+	  mCount(0),
+	  mErased(0),
+	  mWriteDepth(0),
+	  mSequence(0)
+{
+}
+
+void LLTextureCacheIndex::reserve(U32 max_entries)
+{
+	if (max_entries <= mMaxEntries)
+	{
+		return;
+	}
+
+	U32 slots = MIN_SLOTS;
+	while (slots < max_entries * 2)
+	{
+		slots <<= 1;
+	}
+
+	const U32 old_slot_count = mSlots ? mMask + 1 : 0;
+	std::unique_ptr<std::atomic<S32>[]> old_slots(std::move(mSlots));
+	std::unique_ptr<std::atomic<U64>[]> old_keys(std::move(mKeys));
+
+	mSlots.reset(new std::atomic<S32>[slots]);
+	for (U32 i = 0; i < slots; ++i)
+	{
+		mSlots[i].store(SLOT_EMPTY, std::memory_order_relaxed);
+	}
+	mKeys.reset(new std::atomic<U64>[(size_t)max_entries * 2]);
+	for (size_t i = 0; i < (size_t)max_entries * 2; ++i)
+	{
+		mKeys[i].store(0, std::memory_order_relaxed);
+	}
+	mMask = slots - 1;
+	mMaxEntries = max_entries;
+	mCount = 0;
+	mErased = 0;
+
+	// Carry over what was already indexed
+	for (U32 i = 0; i < old_slot_count; ++i)
+	{
+		const S32 idx = old_slots[i].load(std::memory_order_relaxed);
+		if (idx >= 0)
+		{
+			LLUUID id;
+			const U64 key[2] = { old_keys[idx * 2].load(std::memory_order_relaxed),
+								 old_keys[idx * 2 + 1].load(std::memory_order_relaxed) };
+			memcpy(id.mData, key, UUID_BYTES);
+			insert(id, idx);
+		}
+	}
+}
+
+//static
+U64 LLTextureCacheIndex::hash(const LLUUID& id)
+{
+	// Texture IDs are random, but fold in both halves in case some are not
+	U64 key[2];
+	memcpy(key, id.mData, UUID_BYTES);
+	U64 h = key[0] ^ (key[1] * 0x9e3779b97f4a7c15ull);
+	return h ^ (h >> 31);
+}
+
+bool LLTextureCacheIndex::keyMatches(S32 idx, const LLUUID& id) const
+{
+	U64 key[2];
+	memcpy(key, id.mData, UUID_BYTES);
+	return mKeys[idx * 2].load(std::memory_order_relaxed) == key[0]
+		&& mKeys[idx * 2 + 1].load(std::memory_order_relaxed) == key[1];
+}
+
+void LLTextureCacheIndex::setKey(S32 idx, const LLUUID& id)
+{
+	U64 key[2];
+	memcpy(key, id.mData, UUID_BYTES);
+	mKeys[idx * 2].store(key[0], std::memory_order_relaxed);
+	mKeys[idx * 2 + 1].store(key[1], std::memory_order_relaxed);
+}
+
+S32 LLTextureCacheIndex::find(const LLUUID& id) const
+{
+	if (!mSlots)
+	{
+		return -1;
+	}
+
+	U32 slot = (U32)hash(id) & mMask;
+	for (U32 probe = 0; probe <= mMask; ++probe)
+	{
+		const S32 idx = mSlots[slot].load(std::memory_order_relaxed);
+		if (idx == SLOT_EMPTY)
+		{
+			break;
+		}
+		if (idx >= 0 && (U32)idx < mMaxEntries && keyMatches(idx, id))
+		{
+			return idx;
+		}
+		slot = (slot + 1) & mMask;
+	}
+	return -1;
+}
+
+void LLTextureCacheIndex::insert(const LLUUID& id, S32 idx)
+{
+	if (idx < 0 || (U32)idx >= mMaxEntries)
+	{
+		LL_WARNS("TextureCache") << "Entry index " << idx << " out of range for " << id << LL_ENDL;
+		return;
+	}
+
+	beginWrite();
+
+	// Whatever ID was indexed at idx before is being replaced
+	LLUUID old_id;
+	const U64 old_key[2] = { mKeys[idx * 2].load(std::memory_order_relaxed),
+							 mKeys[idx * 2 + 1].load(std::memory_order_relaxed) };
+	memcpy(old_id.mData, old_key, UUID_BYTES);
+	if (old_id != id && find(old_id) == idx)
+	{
+		erase(old_id);
+	}
+
+	U32 slot = (U32)hash(id) & mMask;
+	S32 target = -1;
+	for (U32 probe = 0; probe <= mMask; ++probe)
+	{
+		const S32 cur = mSlots[slot].load(std::memory_order_relaxed);
+		if (cur == SLOT_EMPTY)
+		{
+			if (target < 0)
+			{
+				target = (S32)slot;
+			}
+			break;
+		}
+		if (cur == SLOT_ERASED)
+		{
+			if (target < 0)
+			{
+				target = (S32)slot;
+			}
+		}
+		else if (keyMatches(cur, id))
+		{
+			// Moved to another entry
+			setKey(idx, id);
+			mSlots[slot].store(idx, std::memory_order_relaxed);
+			endWrite();
+			return;
+		}
+		slot = (slot + 1) & mMask;
+	}
+
+	if (target >= 0)
+	{
+		if (mSlots[target].load(std::memory_order_relaxed) == SLOT_ERASED)
+		{
+			--mErased;
+		}
+		setKey(idx, id);
+		mSlots[target].store(idx, std::memory_order_relaxed);
+		++mCount;
+	}
+	endWrite();
+}
+
+void LLTextureCacheIndex::erase(const LLUUID& id)
+{
+	if (!mSlots)
+	{
+		return;
+	}
+
+	U32 slot = (U32)hash(id) & mMask;
+	for (U32 probe = 0; probe <= mMask; ++probe)
+	{
+		const S32 idx = mSlots[slot].load(std::memory_order_relaxed);
+		if (idx == SLOT_EMPTY)
+		{
+			return;
+		}
+		if (idx >= 0 && keyMatches(idx, id))
+		{
+			beginWrite();
+			mSlots[slot].store(SLOT_ERASED, std::memory_order_relaxed);
+			--mCount;
+			if (++mErased > (mMask + 1) / 4)
+			{
+				rehash();
+			}
+			endWrite();
+			return;
+		}
+		slot = (slot + 1) & mMask;
+	}
+}
+
+void LLTextureCacheIndex::clear()
+{
+	if (!mSlots)
+	{
+		return;
+	}
+
+	beginWrite();
+	for (U32 i = 0; i <= mMask; ++i)
+	{
+		mSlots[i].store(SLOT_EMPTY, std::memory_order_relaxed);
+	}
+	mCount = 0;
+	mErased = 0;
+	endWrite();
+}
+
+// Drops the tombstones. Called inside a write.
+void LLTextureCacheIndex::rehash()
+{
+	std::vector<S32> live;
+	live.reserve(mCount);
+	for (U32 i = 0; i <= mMask; ++i)
+	{
+		const S32 idx = mSlots[i].load(std::memory_order_relaxed);
+		if (idx >= 0)
+		{
+			live.push_back(idx);
+		}
+		mSlots[i].store(SLOT_EMPTY, std::memory_order_relaxed);
+	}
+
+	for (S32 idx : live)
+	{
+		LLUUID id;
+		const U64 key[2] = { mKeys[idx * 2].load(std::memory_order_relaxed),
+							 mKeys[idx * 2 + 1].load(std::memory_order_relaxed) };
+		memcpy(id.mData, key, UUID_BYTES);
+		U32 slot = (U32)hash(id) & mMask;
+		while (mSlots[slot].load(std::memory_order_relaxed) != SLOT_EMPTY)
+		{
+			slot = (slot + 1) & mMask;
+		}
+		mSlots[slot].store(idx, std::memory_order_relaxed);
+	}
+	mCount = (U32)live.size();
+	mErased = 0;
+}
+
+void LLTextureCacheIndex::beginWrite()
+{
+	if (mWriteDepth++ == 0)
+	{
+		mSequence.store(mSequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+	}
+}
+
+void LLTextureCacheIndex::endWrite()
+{
+	llassert(mWriteDepth > 0);
+	if (--mWriteDepth == 0)
+	{
+		mSequence.store(mSequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+}
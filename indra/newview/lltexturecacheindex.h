@@ -0,0 +1,119 @@
+/**
+ * @file lltexturecacheindex.h
+ * @brief Open addressed texture ID to cache entry index map with lock free lookups.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTEXTURECACHEINDEX_H
+#define LL_LLTEXTURECACHEINDEX_H
+
+#include "lluuid.h"
+
+#include <atomic>
+#include <memory>
+
+// Maps texture IDs to their index in texture.entries.
+//
+// Changes are made by one thread at a time, under the texture cache header
+// mutex. Lookups can run on any thread without taking that mutex: every
+// change is bracketed by a sequence counter (a seqlock), and a reader
+// brackets its lookup, plus whatever it reads about the entry it found,
+// with readBegin()/readRetry() and tries again if a change overlapped.
+//
+//	U32 seq;
+//	do
+//	{
+//		seq = index.readBegin();
+//		idx = index.find(id);
+//		... copy what is needed about entry idx ...
+//	} while (index.readRetry(seq));
+//
+// The slots and the keys are atomics, so a racing lookup reads stale but
+// never torn values. Erased IDs leave tombstones in the probe sequence;
+// once they make up a quarter of the table it is rebuilt in place.
+class LLTextureCacheIndex
+{
+public:
+	LLTextureCacheIndex();
+
+	// Make room for entry indices below max_entries. The table only grows,
+	// and growing reallocates it, so this must not be called with a bigger
+	// size while lookups may be running on other threads.
+	void reserve(U32 max_entries);
+	U32 getMaxEntries() const { return mMaxEntries; }
+	U32 size() const { return mCount; }
+	// Erased slots still in the probe sequences
+	U32 getTombstoneCount() const { return mErased; }
+
+	// Returns the entry index of id, or -1
+	S32 find(const LLUUID& id) const;
+
+	// Writers only
+	void insert(const LLUUID& id, S32 idx);
+	void erase(const LLUUID& id);
+	void clear();
+
+	// Brackets changes made by the owner to data readers look at through
+	// the index (the entries themselves). Nests.
+	void beginWrite();
+	void endWrite();
+
+	class ScopedWrite
+	{
+	public:
+		ScopedWrite(LLTextureCacheIndex& index) : mIndex(index) { mIndex.beginWrite(); }
+		~ScopedWrite() { mIndex.endWrite(); }
+	private:
+		LLTextureCacheIndex& mIndex;
+	};
+
+	U32 readBegin() const { return mSequence.load(std::memory_order_acquire); }
+	bool readRetry(U32 seq) const
+	{
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return (seq & 1) || mSequence.load(std::memory_order_relaxed) != seq;
+	}
+
+private:
+	static U64 hash(const LLUUID& id);
+	bool keyMatches(S32 idx, const LLUUID& id) const;
+	void setKey(S32 idx, const LLUUID& id);
+	void rehash();
+
+	enum : S32
+	{
+		SLOT_EMPTY = -1,
+		SLOT_ERASED = -2
+	};
+
+	std::unique_ptr<std::atomic<S32>[]> mSlots;
+	// Two halves of the ID stored at each entry index
+	std::unique_ptr<std::atomic<U64>[]> mKeys;
+	U32 mMask;
+	U32 mMaxEntries;
+	U32 mCount;
+	U32 mErased;
+	U32 mWriteDepth;
+	std::atomic<U32> mSequence;
+};
+
+#endif // LL_LLTEXTURECACHEINDEX_H
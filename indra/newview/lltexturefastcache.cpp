@@ -0,0 +1,493 @@
+/**
+ * @file lltexturefastcache.cpp
+ * @brief Memory mapped store of small mips used as texture placeholders.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "lltexturefastcache.h"
+
+#include "llfile.h"
+
+#include <thread>
+
+static const char FAST_CACHE_MAGIC[8] = { 'A', 'L', 'F', 'A', 'S', 'T', 'C', 'A' };
+static const U32 FAST_CACHE_VERSION = 2;
+static const S64 FAST_CACHE_HEADER_SIZE = 4096;
+static const S32 MAX_READ_ATTEMPTS = 4;
+
+// Largest mip kept at each level, in bytes: 16x16, 32x32 and 64x64 RGBA
+static const S32 LEVEL_BYTES[LLTextureFastCache::NUM_LEVELS] = { 16 * 16 * 4, 32 * 32 * 4, 64 * 64 * 4 };
+// Where levels 1 and up are in a slot
+static const S32 SLOT_LEVEL_OFFSET[LLTextureFastCache::NUM_LEVELS] = { -1, 0, 32 * 32 * 4 };
+
+struct LLTextureFastCache::Header
+{
+	char mMagic[8];
+	U32 mVersion;
+	U32 mRecordCount;
+	U32 mSlotCount;
+	U32 mRecordSize;
+	U32 mSlotSize;
+	// Bumped by clear(), records and slots of older generations are ignored
+	std::atomic<U32> mGeneration;
+	// Next slot handed out, only used by writers
+	U32 mSlotHand;
+};
+
+struct LLTextureFastCache::Record
+{
+	struct Level
+	{
+		S16 mWidth;
+		S16 mHeight;
+		S32 mDiscard;
+	};
+
+	struct Info
+	{
+		U32 mGeneration;
+		U8 mID[UUID_BYTES];
+		U32 mSlot; // slot + 1, 0 for none
+		U8 mComponents;
+		U8 mLevels;
+		U8 mPad[2];
+		Level mLevel[NUM_LEVELS];
+	};
+
+	std::atomic<U32> mSequence;
+	Info mInfo;
+	U8 mPad[64 - sizeof(std::atomic<U32>) - sizeof(Info)];
+	U8 mData[16 * 16 * 4]; // level 0
+};
+
+struct LLTextureFastCache::Slot
+{
+	std::atomic<U32> mSequence;
+	S32 mOwner; // entry index
+	U32 mGeneration;
+	U8 mID[UUID_BYTES];
+	U8 mPad[64 - sizeof(std::atomic<U32>) - sizeof(S32) - sizeof(U32) - UUID_BYTES];
+	U8 mData[32 * 32 * 4 + 64 * 64 * 4]; // levels 1 and 2
+};
+
+static_assert(std::atomic<U32>::is_always_lock_free, "sequence counters live in a shared file mapping");
+
+namespace
+{
+	// Writers make the counter odd while they change what it guards. A
+	// counter left odd by a crash is treated the same, so such a record is
+	// skipped by readers until it is written again.
+	U32 begin_write(std::atomic<U32>& sequence)
+	{
+		const U32 seq = (sequence.load(std::memory_order_relaxed) + 1) | 1;
+		sequence.store(seq, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		return seq;
+	}
+
+	void end_write(std::atomic<U32>& sequence, U32 seq)
+	{
+		sequence.store(seq + 1, std::memory_order_release);
+	}
+
+	bool read_valid(const std::atomic<U32>& sequence, U32 seq)
+	{
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return sequence.load(std::memory_order_relaxed) == seq;
+	}
+}
+
+LLTextureFastCache::LLTextureFastCache()
+	: mHeader(NULL),
+	  mRecords(NULL),
+	  mSlots(NULL),
+	  mRecordCount(0),
+	  mSlotCount(0)
+{
+	static_assert(sizeof(Header) <= FAST_CACHE_HEADER_SIZE, "fast cache header too big");
+	static_assert(sizeof(Record) == 64 + 16 * 16 * 4, "unexpected fast cache record layout");
+	static_assert(sizeof(Slot) == 64 + 32 * 32 * 4 + 64 * 64 * 4, "unexpected fast cache slot layout");
+}
+
+LLTextureFastCache::~LLTextureFastCache()
+{
+	close();
+}
+
+//static
+S64 LLTextureFastCache::getRecordSize()
+{
+	return (S64)sizeof(Record);
+}
+
+//static
+S64 LLTextureFastCache::getSlotSize()
+{
+	return (S64)sizeof(Slot);
+}
+
+//static
+S64 LLTextureFastCache::getFileSize(U32 record_count, U32 slot_count)
+{
+	return FAST_CACHE_HEADER_SIZE + (S64)record_count * getRecordSize() + (S64)slot_count * getSlotSize();
+}
+
+bool LLTextureFastCache::open(const std::string& filename, U32 record_count, U32 slot_count, bool read_only)
+{
+	close();
+
+	if (record_count == 0)
+	{
+		return false;
+	}
+	slot_count = llmax(slot_count, 1U);
+
+	const S64 file_size = getFileSize(record_count, slot_count);
+	if (!mFile.open(filename, read_only ? 0 : (size_t)file_size, read_only))
+	{
+		return false;
+	}
+
+	Header* header = (Header*)mFile.getData();
+	if ((S64)mFile.getSize() >= file_size && header->mVersion == 0 && header->mMagic[0] == 0 && !read_only)
+	{
+		// New file
+		memcpy(header->mMagic, FAST_CACHE_MAGIC, sizeof(FAST_CACHE_MAGIC));
+		header->mVersion = FAST_CACHE_VERSION;
+		header->mRecordCount = record_count;
+		header->mSlotCount = slot_count;
+		header->mRecordSize = (U32)sizeof(Record);
+		header->mSlotSize = (U32)sizeof(Slot);
+		header->mGeneration.store(1, std::memory_order_relaxed);
+		header->mSlotHand = 0;
+	}
+	else if ((S64)mFile.getSize() < file_size
+			 || memcmp(header->mMagic, FAST_CACHE_MAGIC, sizeof(FAST_CACHE_MAGIC)) != 0
+			 || header->mVersion != FAST_CACHE_VERSION
+			 || header->mRecordCount != record_count
+			 || header->mSlotCount != slot_count
+			 || header->mRecordSize != (U32)sizeof(Record)
+			 || header->mSlotSize != (U32)sizeof(Slot))
+	{
+		mFile.close();
+		if (read_only)
+		{
+			LL_WARNS("TextureCache") << "Fast cache " << filename << " does not match the texture cache, not using it" << LL_ENDL;
+			return false;
+		}
+
+		// Made by another version or for another cache size, start over
+		LL_INFOS("TextureCache") << "Recreating fast cache " << filename << LL_ENDL;
+		LLFile::remove(filename, ENOENT);
+		return open(filename, record_count, slot_count, read_only);
+	}
+
+	mHeader = header;
+	mRecords = mFile.getData() + FAST_CACHE_HEADER_SIZE;
+	mSlots = mRecords + (size_t)record_count * sizeof(Record);
+	mRecordCount = record_count;
+	mSlotCount = slot_count;
+
+	LL_INFOS("TextureCache") << "Fast cache mapped with " << record_count << " records and "
+							 << slot_count << " large slots" << LL_ENDL;
+	return true;
+}
+
+void LLTextureFastCache::close()
+{
+	LLMutexLock lock(&mWriteMutex);
+	mHeader = NULL;
+	mRecords = NULL;
+	mSlots = NULL;
+	mRecordCount = 0;
+	mSlotCount = 0;
+	mFile.close();
+}
+
+void LLTextureFastCache::clear()
+{
+	LLMutexLock lock(&mWriteMutex);
+	if (isOpen() && !mFile.isReadOnly())
+	{
+		mHeader->mGeneration.store(mHeader->mGeneration.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+}
+
+LLTextureFastCache::Record* LLTextureFastCache::getRecord(S32 idx) const
+{
+	return (Record*)(mRecords + (size_t)idx * sizeof(Record));
+}
+
+LLTextureFastCache::Slot* LLTextureFastCache::getSlot(U32 slot) const
+{
+	return (Slot*)(mSlots + (size_t)slot * sizeof(Slot));
+}
+
+// Takes slot away from the entry it was last handed to. Called with
+// mWriteMutex held.
+void LLTextureFastCache::releaseSlot(U32 slot, S32 idx)
+{
+	const S32 owner = getSlot(slot)->mOwner;
+	if (owner < 0 || owner == idx || (U32)owner >= mRecordCount)
+	{
+		return;
+	}
+
+	Record* rec = getRecord(owner);
+	if (rec->mInfo.mSlot == slot + 1)
+	{
+		const U32 seq = begin_write(rec->mSequence);
+		rec->mInfo.mSlot = 0;
+		rec->mInfo.mLevels = 1;
+		end_write(rec->mSequence, seq);
+	}
+}
+
+bool LLTextureFastCache::write(const LLUUID& id, S32 idx, LLPointer<LLImageRaw> raw, S32 discardlevel)
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
+	if (raw.isNull() || raw->isBufferInvalid() || !raw->getData())
+	{
+		LL_WARNS("TextureCache") << "Attempted to write NULL raw image to fast cache" << LL_ENDL;
+		return false;
+	}
+	if (!isOpen() || mFile.isReadOnly())
+	{
+		return true;
+	}
+	if (idx < 0 || (U32)idx >= mRecordCount)
+	{
+		return false;
+	}
+
+	const S32 w = raw->getWidth();
+	const S32 h = raw->getHeight();
+	const S32 c = raw->getComponents();
+	if (c < 1 || c > 4)
+	{
+		return true;
+	}
+
+	// Search for the discard level that fits into each level
+	S32 shift[NUM_LEVELS];
+	for (S32 level = 0; level < NUM_LEVELS; ++level)
+	{
+		S32 i = 0;
+		while (((w >> i) * (h >> i) * c) > LEVEL_BYTES[level])
+		{
+			++i;
+		}
+		shift[level] = i;
+	}
+	if ((w >> shift[0]) * (h >> shift[0]) <= 0)
+	{
+		return true; // too thin to keep
+	}
+
+	// Only keep the levels that are bigger than the one below
+	S32 levels = 1;
+	while (levels < NUM_LEVELS && shift[levels] < shift[levels - 1])
+	{
+		++levels;
+	}
+
+	// Scale down from the largest level kept, outside of the lock and
+	// without touching raw, which the caller still owns
+	LLPointer<LLImageRaw> images[NUM_LEVELS];
+	LLPointer<LLImageRaw> src = raw;
+	for (S32 level = levels - 1; level >= 0; --level)
+	{
+		const S32 lw = w >> shift[level];
+		const S32 lh = h >> shift[level];
+		if (src->getWidth() != lw || src->getHeight() != lh)
+		{
+			LLPointer<LLImageRaw> scaled = new LLImageRaw(src->getData(), src->getWidth(), src->getHeight(), c);
+			if (scaled->isBufferInvalid() || !scaled->scale(lw, lh))
+			{
+				LL_WARNS("TextureCache") << "Unable to scale " << id << " for the fast cache" << LL_ENDL;
+				return false;
+			}
+			src = scaled;
+		}
+		images[level] = src;
+	}
+
+	LLMutexLock lock(&mWriteMutex);
+	if (!isOpen())
+	{
+		return true;
+	}
+
+	const U32 generation = mHeader->mGeneration.load(std::memory_order_relaxed);
+	Record* rec = getRecord(idx);
+	const U32 seq = begin_write(rec->mSequence);
+
+	Record::Info& info = rec->mInfo;
+	const U32 old_slot = info.mSlot;
+	info.mGeneration = generation;
+	memcpy(info.mID, id.mData, UUID_BYTES);
+	info.mComponents = (U8)c;
+	info.mLevels = (U8)levels;
+	for (S32 level = 0; level < NUM_LEVELS; ++level)
+	{
+		Record::Level& dst = info.mLevel[level];
+		dst.mWidth = level < levels ? (S16)(w >> shift[level]) : 0;
+		dst.mHeight = level < levels ? (S16)(h >> shift[level]) : 0;
+		dst.mDiscard = level < levels ? discardlevel + shift[level] : -1;
+	}
+	memcpy(rec->mData, images[0]->getData(), images[0]->getDataSize());
+
+	const bool owns_old_slot = old_slot > 0 && old_slot <= mSlotCount && getSlot(old_slot - 1)->mOwner == idx;
+	info.mSlot = 0;
+	if (levels > 1)
+	{
+		U32 slot;
+		if (owns_old_slot)
+		{
+			slot = old_slot - 1;
+		}
+		else
+		{
+			slot = mHeader->mSlotHand % mSlotCount;
+			mHeader->mSlotHand = (slot + 1) % mSlotCount;
+			releaseSlot(slot, idx);
+		}
+
+		Slot* dst = getSlot(slot);
+		const U32 slot_seq = begin_write(dst->mSequence);
+		dst->mOwner = idx;
+		dst->mGeneration = generation;
+		memcpy(dst->mID, id.mData, UUID_BYTES);
+		for (S32 level = 1; level < levels; ++level)
+		{
+			memcpy(dst->mData + SLOT_LEVEL_OFFSET[level], images[level]->getData(), images[level]->getDataSize());
+		}
+		end_write(dst->mSequence, slot_seq);
+		info.mSlot = slot + 1;
+	}
+	else if (owns_old_slot)
+	{
+		Slot* dst = getSlot(old_slot - 1);
+		const U32 slot_seq = begin_write(dst->mSequence);
+		dst->mOwner = -1;
+		end_write(dst->mSequence, slot_seq);
+	}
+
+	end_write(rec->mSequence, seq);
+	return true;
+}
+
+LLPointer<LLImageRaw> LLTextureFastCache::read(const LLUUID& id, S32 idx, S32 max_dimension, S32& discardlevel) const
+{
+	if (!isOpen() || idx < 0 || (U32)idx >= mRecordCount)
+	{
+		return NULL;
+	}
+
+	const U32 generation = mHeader->mGeneration.load(std::memory_order_acquire);
+	const Record* rec = getRecord(idx);
+	for (S32 attempt = 0; attempt < MAX_READ_ATTEMPTS; ++attempt)
+	{
+		const U32 seq = rec->mSequence.load(std::memory_order_acquire);
+		if (seq & 1)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		Record::Info info;
+		memcpy(&info, &rec->mInfo, sizeof(info));
+		if (!read_valid(rec->mSequence, seq))
+		{
+			continue;
+		}
+
+		if (info.mGeneration != generation
+			|| memcmp(info.mID, id.mData, UUID_BYTES) != 0
+			|| info.mLevels < 1 || info.mLevels > NUM_LEVELS
+			|| info.mComponents < 1 || info.mComponents > 4
+			|| (info.mLevels > 1 && (info.mSlot == 0 || info.mSlot > mSlotCount)))
+		{
+			return NULL; // not there, or garbage
+		}
+		for (S32 level = 0; level < info.mLevels; ++level)
+		{
+			const Record::Level& lvl = info.mLevel[level];
+			if (lvl.mWidth <= 0 || lvl.mHeight <= 0 || lvl.mDiscard < 0
+				|| lvl.mWidth * lvl.mHeight * info.mComponents > LEVEL_BYTES[level])
+			{
+				return NULL;
+			}
+		}
+
+		// Largest level that fits
+		S32 level = info.mLevels - 1;
+		while (level > 0 && (info.mLevel[level].mWidth > max_dimension || info.mLevel[level].mHeight > max_dimension))
+		{
+			--level;
+		}
+
+		const Record::Level& lvl = info.mLevel[level];
+		LLPointer<LLImageRaw> raw = new LLImageRaw(lvl.mWidth, lvl.mHeight, info.mComponents);
+		if (raw->isBufferInvalid())
+		{
+			return NULL;
+		}
+
+		if (level > 0)
+		{
+			const Slot* slot = getSlot(info.mSlot - 1);
+			const U32 slot_seq = slot->mSequence.load(std::memory_order_acquire);
+			const bool owned = slot->mOwner == idx
+				&& slot->mGeneration == generation
+				&& memcmp(slot->mID, id.mData, UUID_BYTES) == 0;
+			if (!(slot_seq & 1) && owned)
+			{
+				memcpy(raw->getData(), slot->mData + SLOT_LEVEL_OFFSET[level], raw->getDataSize());
+				if (read_valid(slot->mSequence, slot_seq) && read_valid(rec->mSequence, seq))
+				{
+					discardlevel = lvl.mDiscard;
+					return raw;
+				}
+			}
+
+			// The slot went to another entry, use the record's own level
+			const Record::Level& own = info.mLevel[0];
+			raw = new LLImageRaw(own.mWidth, own.mHeight, info.mComponents);
+			if (raw->isBufferInvalid())
+			{
+				return NULL;
+			}
+		}
+
+		memcpy(raw->getData(), rec->mData, raw->getDataSize());
+		if (read_valid(rec->mSequence, seq))
+		{
+			discardlevel = info.mLevel[0].mDiscard;
+			return raw;
+		}
+	}
+
+	return NULL;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file lltexturefastcache.h
+ * @brief Memory mapped store of small mips used as texture placeholders.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTEXTUREFASTCACHE_H
+#define LL_LLTEXTUREFASTCACHE_H
+
+#include "llimage.h"
+#include "llmappedfile.h"
+#include "llmutex.h"
+#include "lluuid.h"
+
+#include <atomic>
+
+// Fast cache, version 2.
+//
+// Keeps raw, already decoded, low resolution mips of the cached textures in
+// one memory mapped file so that a placeholder can be shown as soon as a
+// texture is created, without waiting for the fetcher and the decoder.
+//
+// Every texture cache entry owns a record, at its entry index, with the mip
+// that fits in 16x16 RGBA. Up to 64x64 and 32x32 mips are kept in a smaller
+// pool of shared slots handed out round robin, so that only recently
+// written textures have them; a record whose slot was handed to another
+// entry falls back to its own mip.
+//
+// Reads take no lock and can run on any thread. Each record and slot has a
+// sequence counter that writers make odd while they change it, and readers
+// copy the data out and check the counter did not move. Writers are
+// serialized by a mutex.
+class LLTextureFastCache
+{
+public:
+	enum
+	{
+		NUM_LEVELS = 3
+	};
+
+	LLTextureFastCache();
+	~LLTextureFastCache();
+
+	// Maps filename with room for record_count entries and slot_count
+	// shared slots, starting over if the file was made with other sizes.
+	// A read only cache never starts over.
+	bool open(const std::string& filename, U32 record_count, U32 slot_count, bool read_only);
+	void close();
+	bool isOpen() const { return mRecords != NULL; }
+	void flush() { mFile.flush(); }
+
+	// Forgets everything without touching the records
+	void clear();
+
+	// Stores the small mips of raw, which is at discardlevel, for entry idx
+	bool write(const LLUUID& id, S32 idx, LLPointer<LLImageRaw> raw, S32 discardlevel);
+
+	// Returns the largest mip stored for id at entry idx that fits in
+	// max_dimension, or the smallest one if none does, or NULL.
+	LLPointer<LLImageRaw> read(const LLUUID& id, S32 idx, S32 max_dimension, S32& discardlevel) const;
+
+	// Bytes the file takes on disk for the given sizes
+	static S64 getRecordSize();
+	static S64 getSlotSize();
+	static S64 getFileSize(U32 record_count, U32 slot_count);
+
+private:
+	struct Header;
+	struct Record;
+	struct Slot;
+
+	Record* getRecord(S32 idx) const;
+	Slot* getSlot(U32 slot) const;
+	void releaseSlot(U32 slot, S32 idx);
+
+	LLMappedFile mFile;
+	Header* mHeader;
+	U8* mRecords;
+	U8* mSlots;
+	U32 mRecordCount;
+	U32 mSlotCount;
+	LLMutex mWriteMutex;
+};
+
+#endif // LL_LLTEXTUREFASTCACHE_H
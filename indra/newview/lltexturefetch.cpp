@@ -1038,6 +1038,12 @@ void LLTextureFetchWorker::setDesiredDiscard(S32 discard, S32 size)
 void LLTextureFetchWorker::setImagePriority(F32 priority)
 {
 	mImagePriority = priority; //should map to max virtual size, abort if zero
+	LLImageDecodeThread* decoder = LLAppViewer::getImageDecodeThread();
+	if (mDecodeHandle != 0 && decoder)
+	{
+		// Let a texture that just came into view jump the decode backlog
+		decoder->setPriority(mDecodeHandle, priority);
+	}
 }
 
 // Locks:  Mw
@@ -1826,7 +1832,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 						   << " All Data: " << mHaveAllData << LL_ENDL;
 #endif
 		mDecodeHandle = LLAppViewer::getImageDecodeThread()->decodeImage(mFormattedImage, discard, mNeedsAux,
-																  new DecodeResponder(mFetcher, mID, this));
+																  new DecodeResponder(mFetcher, mID, this), mImagePriority);
 		// fall though
 	}
 	
@@ -0,0 +1,167 @@
+/**
+ * @file lltexturepriority.h
+ * @brief Fetched textures kept in log scale priority buckets.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTEXTUREPRIORITY_H
+#define LL_LLTEXTUREPRIORITY_H
+
+#include <cmath>
+#include <vector>
+
+class LLViewerFetchedTexture;
+
+// The textures in LLViewerTextureList's image list, grouped by the power of
+// two of their max virtual size and by whether they still need fetch work.
+// Each texture remembers its bucket and its slot in it, so moving it to
+// another bucket or taking it out is a swap with the bucket's last entry.
+// Fetching walks the buckets of textures needing work down from the top and
+// the discard bias walks all of them up from the bottom, neither has to sort
+// or scan the list, nor step over the many textures that are fully loaded.
+//
+// T provides mPriorityBucket, mPriorityIndex and mPriorityNeedsWork, which
+// only the buckets touch.  A template so that it can be tested without
+// dragging in the whole texture class.
+template<class T>
+class LLPriorityBuckets
+{
+public:
+	static const S32 NUM_BUCKETS = 32;
+	typedef std::vector<T*> bucket_t;
+
+	// Bucket for a virtual size, 0 for anything under one pixel
+	static S32 getBucket(F32 virtual_size);
+
+	// Files the texture under virtual_size and needs_work, adding it if
+	// needed
+	void update(T* imagep, F32 virtual_size, bool needs_work);
+	void remove(T* imagep);
+	void clear();
+
+	const bucket_t& getTextures(S32 bucket, bool needs_work) const	{ return mBuckets[needs_work][bucket]; }
+	U32 size() const												{ return mCount; }
+
+	// Highest bucket holding any texture of that kind, -1 if there is none
+	S32 getTopBucket(bool needs_work) const;
+
+private:
+	bucket_t	mBuckets[2][NUM_BUCKETS];
+	U32			mCount = 0;
+};
+
+typedef LLPriorityBuckets<LLViewerFetchedTexture> LLTexturePriorityBuckets;
+
+//static
+template<class T>
+S32 LLPriorityBuckets<T>::getBucket(F32 virtual_size)
+{
+	if (!(virtual_size >= 1.f))
+	{
+		return 0;
+	}
+
+	// virtual_size is in [2^(exp-1), 2^exp)
+	int exp = 0;
+	frexpf(virtual_size, &exp);
+	return llmin((S32)exp, NUM_BUCKETS - 1);
+}
+
+template<class T>
+void LLPriorityBuckets<T>::update(T* imagep, F32 virtual_size, bool needs_work)
+{
+	const S32 bucket = getBucket(virtual_size);
+	if (bucket == imagep->mPriorityBucket && needs_work == imagep->mPriorityNeedsWork)
+	{
+		return;
+	}
+
+	if (imagep->mPriorityBucket >= 0)
+	{
+		remove(imagep);
+	}
+
+	bucket_t& textures = mBuckets[needs_work][bucket];
+	imagep->mPriorityBucket = bucket;
+	imagep->mPriorityNeedsWork = needs_work;
+	imagep->mPriorityIndex = (U32)textures.size();
+	textures.push_back(imagep);
+	++mCount;
+}
+
+template<class T>
+void LLPriorityBuckets<T>::remove(T* imagep)
+{
+	const S32 bucket = imagep->mPriorityBucket;
+	if (bucket < 0)
+	{
+		return;
+	}
+
+	bucket_t& textures = mBuckets[imagep->mPriorityNeedsWork][bucket];
+	const U32 index = imagep->mPriorityIndex;
+	llassert(index < textures.size() && textures[index] == imagep);
+
+	T* last = textures.back();
+	textures[index] = last;
+	last->mPriorityIndex = index;
+	textures.pop_back();
+
+	imagep->mPriorityBucket = -1;
+	imagep->mPriorityIndex = 0;
+	imagep->mPriorityNeedsWork = false;
+	--mCount;
+}
+
+template<class T>
+void LLPriorityBuckets<T>::clear()
+{
+	for (bucket_t (&buckets)[NUM_BUCKETS] : mBuckets)
+	{
+		for (bucket_t& textures : buckets)
+		{
+			for (T* imagep : textures)
+			{
+				imagep->mPriorityBucket = -1;
+				imagep->mPriorityIndex = 0;
+				imagep->mPriorityNeedsWork = false;
+			}
+			textures.clear();
+		}
+	}
+	mCount = 0;
+}
+
+template<class T>
+S32 LLPriorityBuckets<T>::getTopBucket(bool needs_work) const
+{
+	for (S32 bucket = NUM_BUCKETS - 1; bucket >= 0; --bucket)
+	{
+		if (!mBuckets[needs_work][bucket].empty())
+		{
+			return bucket;
+		}
+	}
+	return -1;
+}
+
+#endif // LL_LLTEXTUREPRIORITY_H
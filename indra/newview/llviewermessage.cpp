@@ -4089,6 +4089,9 @@ void process_kill_object(LLMessageSystem *mesgsys, void **user_data)
 		U32	local_id;
 		mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_ID, local_id, i);
 
+		// a queued update would bring the object back after the kill
+		gObjectList.applyQueuedUpdates(LLHost(ip, port), local_id);
+
 		gObjectList.getUUIDFromLocal(id, local_id, ip, port);
 		if (id.isNull())
 		{
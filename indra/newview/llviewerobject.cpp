@@ -117,6 +117,7 @@
 
 BOOL		LLViewerObject::sVelocityInterpolate = TRUE;
 BOOL		LLViewerObject::sPingInterpolate = TRUE; 
+const LLObjectUpdateMessageInfo* LLViewerObject::sQueuedUpdateInfo = NULL;
 
 U32			LLViewerObject::sNumZombieObjects = 0;
 S32			LLViewerObject::sNumObjects = 0;
@@ -1183,12 +1184,21 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 		return retval;
 	}
 
+	const LLObjectUpdateMessageInfo* queued = sQueuedUpdateInfo;
+
 	// Coordinates of objects on simulators are region-local.
 	U64 region_handle = 0;	
 	
-	if(mesgsys != NULL)
+	if(mesgsys != NULL || queued)
 	{
-		mesgsys->getU64Fast(_PREHASH_RegionData, _PREHASH_RegionHandle, region_handle);
+		if (queued)
+		{
+			region_handle = queued->mRegionHandle;
+		}
+		else
+		{
+			mesgsys->getU64Fast(_PREHASH_RegionData, _PREHASH_RegionHandle, region_handle);
+		}
 		LLViewerRegion* regionp = worldInst.getRegionFromHandle(region_handle);
 		if(regionp != mRegionp && regionp && mRegionp)//region cross
 		{
@@ -1226,10 +1236,17 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 	}
 
 	F32 time_dilation = 1.f;
-	if(mesgsys != NULL)
+	if(mesgsys != NULL || queued)
 	{
         U16 time_dilation16;
-        mesgsys->getU16Fast(_PREHASH_RegionData, _PREHASH_TimeDilation, time_dilation16);
+        if (queued)
+        {
+            time_dilation16 = queued->mTimeDilation;
+        }
+        else
+        {
+            mesgsys->getU16Fast(_PREHASH_RegionData, _PREHASH_TimeDilation, time_dilation16);
+        }
         time_dilation = ((F32) time_dilation16) / 65535.f;
         mRegionp->setTimeDilation(time_dilation);
 	}
@@ -2030,7 +2047,11 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 				// Preload these five flags for every object.
 				// Finer shades require the object to be selected, and the selection manager
 				// stores the extended permission info.
-				if(mesgsys != NULL)
+				if (queued)
+				{
+					loadFlags(queued->mUpdateFlags);
+				}
+				else if(mesgsys != NULL)
 				{
 				U32 flags;
 				mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_UpdateFlags, flags, block_num);
@@ -2356,9 +2377,9 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 
 	new_rot.normQuat();
 
-	if (sPingInterpolate && mesgsys != NULL)
+	if (sPingInterpolate && (mesgsys != NULL || queued))
 	{ 
-		LLCircuitData *cdp = gMessageSystem->mCircuitInfo.findCircuit(mesgsys->getSender());
+		LLCircuitData *cdp = gMessageSystem->mCircuitInfo.findCircuit(queued ? queued->mSender : mesgsys->getSender());
 		if (cdp)
 		{
 			// Note: delay is U32 and usually less then second,
@@ -2381,9 +2402,9 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 
 	// If we're going to skip this message, why are we 
 	// doing all the parenting, etc above?
-	if(mesgsys != NULL)
+	if(mesgsys != NULL || queued)
 	{
-	U32 packet_id = mesgsys->getCurrentRecvPacketID(); 
+	U32 packet_id = queued ? queued->mPacketID : mesgsys->getCurrentRecvPacketID(); 
 	if (packet_id < mLatestRecvPacketID && 
 		mLatestRecvPacketID - packet_id < 65536)
 	{
@@ -2707,97 +2728,101 @@ void LLViewerObject::interpolateLinearMotion(const F64SecondsImplicit& frame_tim
 			}
 		}
 
-		new_pos = new_pos + getPositionRegion();
-		new_v = new_v + vel;
+		applyInterpolatedMotion(frame_time, new_pos + getPositionRegion(), new_v + vel);
+	}		
 
-		auto& worldInst = LLWorld::instance();
+	// Update the last time we did anything
+	mLastInterpUpdateSecs = frame_time;
+}
 
-		// Clamp interpolated position to minimum underground and maximum region height
-		LLVector3d new_pos_global = mRegionp->getPosGlobalFromRegion(new_pos);
-		F32 min_height;
-		if (isAvatar())
-		{	// Make a better guess about AVs not going underground
-			min_height = worldInst.resolveLandHeightGlobal(new_pos_global);
-			min_height += (0.5f * getScale().mV[VZ]);
-		}
-		else
-		{	// This will put the object underground, but we can't tell if it will stop 
-			// at ground level or not
-			min_height = worldInst.getMinAllowedZ(this, new_pos_global);
-			// Cap maximum height
-			new_pos.mV[VZ] = llmin(worldInst.getRegionMaxHeight(), new_pos.mV[VZ]);
-		}
+// Clamps a predicted position and velocity to the ground and to the known
+// regions and applies them
+void LLViewerObject::applyInterpolatedMotion(const F64SecondsImplicit& frame_time, LLVector3 new_pos, LLVector3 new_v)
+{
+	auto& worldInst = LLWorld::instance();
 
-		new_pos.mV[VZ] = llmax(min_height, new_pos.mV[VZ]);
+	// Clamp interpolated position to minimum underground and maximum region height
+	LLVector3d new_pos_global = mRegionp->getPosGlobalFromRegion(new_pos);
+	F32 min_height;
+	if (isAvatar())
+	{	// Make a better guess about AVs not going underground
+		min_height = worldInst.resolveLandHeightGlobal(new_pos_global);
+		min_height += (0.5f * getScale().mV[VZ]);
+	}
+	else
+	{	// This will put the object underground, but we can't tell if it will stop 
+		// at ground level or not
+		min_height = worldInst.getMinAllowedZ(this, new_pos_global);
+		// Cap maximum height
+		new_pos.mV[VZ] = llmin(worldInst.getRegionMaxHeight(), new_pos.mV[VZ]);
+	}
 
-		// Check to see if it's going off the region
-		LLVector3 temp(new_pos.mV[VX], new_pos.mV[VY], 0.f);
-		if (temp.clamp(0.f, mRegionp->getWidth()))
-		{	// Going off this region, so see if we might end up on another region
-			LLVector3d old_pos_global = mRegionp->getPosGlobalFromRegion(getPositionRegion());
-			new_pos_global = mRegionp->getPosGlobalFromRegion(new_pos);		// Re-fetch in case it got clipped above
+	new_pos.mV[VZ] = llmax(min_height, new_pos.mV[VZ]);
 
-			// Clip the positions to known regions
-			LLVector3d clip_pos_global = worldInst.clipToVisibleRegions(old_pos_global, new_pos_global);
-			if (clip_pos_global != new_pos_global)
-			{
-				// Was clipped, so this means we hit a edge where there is no region to enter
-				LLVector3 clip_pos = mRegionp->getPosRegionFromGlobal(clip_pos_global);
+	// Check to see if it's going off the region
+	LLVector3 temp(new_pos.mV[VX], new_pos.mV[VY], 0.f);
+	if (temp.clamp(0.f, mRegionp->getWidth()))
+	{	// Going off this region, so see if we might end up on another region
+		LLVector3d old_pos_global = mRegionp->getPosGlobalFromRegion(getPositionRegion());
+		new_pos_global = mRegionp->getPosGlobalFromRegion(new_pos);		// Re-fetch in case it got clipped above
+
+		// Clip the positions to known regions
+		LLVector3d clip_pos_global = worldInst.clipToVisibleRegions(old_pos_global, new_pos_global);
+		if (clip_pos_global != new_pos_global)
+		{
+			// Was clipped, so this means we hit a edge where there is no region to enter
+			LLVector3 clip_pos = mRegionp->getPosRegionFromGlobal(clip_pos_global);
 #ifdef SHOW_DEBUG
-				LL_DEBUGS("Interpolate") << "Hit empty region edge, clipped predicted position to "
-										 << clip_pos
-										 << " from " << new_pos << LL_ENDL;
+			LL_DEBUGS("Interpolate") << "Hit empty region edge, clipped predicted position to "
+									 << clip_pos
+									 << " from " << new_pos << LL_ENDL;
 #endif
-				new_pos = clip_pos;
-				
-				// Stop motion and get server update for bouncing on the edge
-				new_v.clear();
-				setAcceleration(LLVector3::zero);
-			}
-			else
+			new_pos = clip_pos;
+			
+			// Stop motion and get server update for bouncing on the edge
+			new_v.clear();
+			setAcceleration(LLVector3::zero);
+		}
+		else
+		{
+			// Check for how long we are crossing.
+			// Note: theoretically we can find time from velocity, acceleration and
+			// distance from border to new position, but it is not going to work
+			// if 'phase_out' activates
+			if (mRegionCrossExpire == 0)
 			{
-				// Check for how long we are crossing.
-				// Note: theoretically we can find time from velocity, acceleration and
-				// distance from border to new position, but it is not going to work
-				// if 'phase_out' activates
-				if (mRegionCrossExpire == 0)
-				{
-					// Workaround: we can't accurately figure out time when we cross border
-					// so just write down time 'after the fact', it is far from optimal in
-					// case of lags, but for lags sMaxUpdateInterpolationTime will kick in first
+				// Workaround: we can't accurately figure out time when we cross border
+				// so just write down time 'after the fact', it is far from optimal in
+				// case of lags, but for lags sMaxUpdateInterpolationTime will kick in first
 #ifdef SHOW_DEBUG
-					LL_DEBUGS("Interpolate") << "Predicted region crossing, new position " << new_pos << LL_ENDL;
+				LL_DEBUGS("Interpolate") << "Predicted region crossing, new position " << new_pos << LL_ENDL;
 #endif
-					mRegionCrossExpire = frame_time + sMaxRegionCrossingInterpolationTime;
-				}
-				else if (frame_time > mRegionCrossExpire)
-				{
-					// Predicting crossing over 1s, stop motion
-					// Stop motion
+				mRegionCrossExpire = frame_time + sMaxRegionCrossingInterpolationTime;
+			}
+			else if (frame_time > mRegionCrossExpire)
+			{
+				// Predicting crossing over 1s, stop motion
+				// Stop motion
 #ifdef SHOW_DEBUG
-					LL_DEBUGS("Interpolate") << "Predicting region crossing for too long, stopping at " << new_pos << LL_ENDL;
+				LL_DEBUGS("Interpolate") << "Predicting region crossing for too long, stopping at " << new_pos << LL_ENDL;
 #endif
-					new_v.clear();
-					setAcceleration(LLVector3::zero);
-					mRegionCrossExpire = 0;
-				}
+				new_v.clear();
+				setAcceleration(LLVector3::zero);
+				mRegionCrossExpire = 0;
 			}
 		}
-		else
-		{
-			mRegionCrossExpire = 0;
-		}
-
-		// Set new position and velocity
-		setPositionRegion(new_pos);
-		setVelocity(new_v);	
-		
-		// for objects that are spinning but not translating, make sure to flag them as having moved
-		setChanged(MOVED | SILHOUETTE);
-	}		
+	}
+	else
+	{
+		mRegionCrossExpire = 0;
+	}
 
-	// Update the last time we did anything
-	mLastInterpUpdateSecs = frame_time;
+	// Set new position and velocity
+	setPositionRegion(new_pos);
+	setVelocity(new_v);	
+	
+	// for objects that are spinning but not translating, make sure to flag them as having moved
+	setChanged(MOVED | SILHOUETTE);
 }
 
 
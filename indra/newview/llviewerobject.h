@@ -31,6 +31,7 @@
 #include <unordered_map>
 
 #include "llassetstorage.h"
+#include "llhost.h"
 //#include "llhudicon.h"
 #include "llinventory.h"
 #include "llrefcount.h"
@@ -83,6 +84,17 @@ typedef enum e_object_update_type
 	OUT_UNKNOWN,
 } EObjectUpdateType;
 
+// What a full update applied after its message is gone still needs from
+// that message, see LLObjectUpdateQueue
+struct LLObjectUpdateMessageInfo
+{
+	LLHost	mSender;
+	U64		mRegionHandle;
+	U32		mPacketID;
+	U16		mTimeDilation;
+	U32		mUpdateFlags;
+};
+
 
 // callback typedef for inventory
 typedef void (*inventory_callback)(LLViewerObject*,
@@ -183,6 +195,9 @@ class LLViewerObject
     };
 
 	static  U32     extractSpatialExtents(LLDataPackerBinaryBuffer *dp, LLVector3& pos, LLVector3& scale, LLQuaternion& rot);
+	// Set while a queued update is applied, processUpdateMessage() then
+	// gets a NULL mesgsys and reads the message fields from here
+	static const LLObjectUpdateMessageInfo* sQueuedUpdateInfo;
 	virtual U32		processUpdateMessage(LLMessageSystem *mesgsys,
 										void **user_data,
 										U32 block_num,
@@ -708,6 +723,7 @@ class LLViewerObject
 	
 	// Motion prediction between updates
 	void interpolateLinearMotion(const F64SecondsImplicit & frame_time, const F32SecondsImplicit & dt);
+	void applyInterpolatedMotion(const F64SecondsImplicit & frame_time, LLVector3 new_pos, LLVector3 new_v);
 
 	static void initObjectDataMap();
 
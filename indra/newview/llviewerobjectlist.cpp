@@ -481,6 +481,9 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 	LLDataPackerBinaryBuffer compressed_dp(compressed_dpbuffer, 2048);
 	LLViewerStatsRecorder& recorder = LLViewerStatsRecorder::instance();
 
+	static LLCachedControl<F32> update_budget(gSavedSettings, "AlchemyObjectUpdateBudget", 2.f);
+	LLObjectUpdateQueue::batch_ptr_t batch;
+
 	for (i = 0; i < num_objects; i++)
 	{
 		BOOL justCreated = FALSE;
@@ -517,17 +520,38 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 					recorder.objectUpdateFailure();
 					continue;
 				}
+				else if (update_budget > 0.f)
+				{
+					// Cache bound or not, the whole update waits its turn
+					if (!batch)
+					{
+						batch = std::make_shared<LLObjectUpdateQueue::Batch>(region_handle, mesgsys->getSender(), OUT_FULL_COMPRESSED);
+						batch->mPacketID = mesgsys->getCurrentRecvPacketID();
+						mesgsys->getU16Fast(_PREHASH_RegionData, _PREHASH_TimeDilation, batch->mTimeDilation);
+					}
+					LLObjectUpdateRecord record;
+					record.mLocalID = local_id;
+					record.mFlags = flags;
+					LLViewerObject::unpackU32(&compressed_dp, record.mCRC, "CRC");
+					record.mData.assign(compressed_dpbuffer, compressed_dpbuffer + llclamp(uncompressed_length, 0, 2048));
+					batch->mRecords.push_back(std::move(record));
+					continue;
+				}
 				else if ((flags & FLAGS_TEMPORARY_ON_REZ) == 0)
 				{
 					//send to object cache
 					regionp->cacheFullUpdate(compressed_dp, flags);
 					continue;
 				}
+
+				// anything still queued for the object goes first
+				applyQueuedUpdates(mesgsys->getSender(), local_id);
 			}
 			else //OUT_TERSE_IMPROVED
 			{
 				update_cache = true;
 				compressed_dp.unpackU32(local_id, "LocalID");
+				applyQueuedUpdates(mesgsys->getSender(), local_id);
 				getUUIDFromLocal(fullid,
 								 local_id,
 								 gMessageSystem->getSenderIP(),
@@ -544,6 +568,7 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 		else if (update_type != OUT_FULL) // !compressed, !OUT_FULL ==> OUT_FULL_CACHED only?
 		{
 			mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_ID, local_id, i);
+			applyQueuedUpdates(mesgsys->getSender(), local_id);
 
 			getUUIDFromLocal(fullid,
 							local_id,
@@ -566,10 +591,12 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 			update_cache = true;
 			mesgsys->getUUIDFast(_PREHASH_ObjectData, _PREHASH_FullID, fullid, i);
 			mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_ID, local_id, i);
+			applyQueuedUpdates(mesgsys->getSender(), local_id);
 #ifdef SHOW_DEBUG
 			LL_DEBUGS("ObjectUpdate") << "Full Update, obj " << local_id << ", global ID " << fullid << " from " << mesgsys->getSender() << LL_ENDL;
 #endif
 		}
+
 		objectp = findObject(fullid);
 
 #ifdef SHOW_DEBUG
@@ -736,6 +763,11 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 		objectp->setLastUpdateType(update_type);
 	}
 
+	if (batch)
+	{
+		mUpdateQueue.push(batch);
+	}
+
 	LLVOAvatar::cullAvatarsByPixelArea();
 }
 
@@ -766,6 +798,23 @@ void LLViewerObjectList::processCachedObjectUpdate(LLMessageSystem *mesgsys,
 
 	LLViewerStatsRecorder& recorder = LLViewerStatsRecorder::instance();
 
+	static LLCachedControl<F32> update_budget(gSavedSettings, "AlchemyObjectUpdateBudget", 2.f);
+	if (update_budget > 0.f)
+	{
+		// Probes that hit can create objects, queue them with the rest
+		auto batch = std::make_shared<LLObjectUpdateQueue::Batch>(region_handle, mesgsys->getSender(), OUT_FULL_CACHED);
+		batch->mRecords.resize(num_objects);
+		for (S32 i = 0; i < num_objects; i++)
+		{
+			LLObjectUpdateRecord& record = batch->mRecords[i];
+			mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_ID, record.mLocalID, i);
+			mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_CRC, record.mCRC, i);
+			mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_UpdateFlags, record.mFlags, i);
+		}
+		mUpdateQueue.push(batch);
+		return;
+	}
+
 	for (S32 i = 0; i < num_objects; i++)
 	{
 		U32 id;
@@ -798,6 +847,171 @@ void LLViewerObjectList::processCachedObjectUpdate(LLMessageSystem *mesgsys,
 	return;
 }	
 
+static LLTrace::SampleStatHandle<> sQueuedObjectUpdates("queued_object_updates", "Object cache updates waiting to be applied");
+
+void LLViewerObjectList::applyQueuedUpdates()
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_NETWORK;
+
+	static LLCachedControl<F32> update_budget(gSavedSettings, "AlchemyObjectUpdateBudget", 2.f);
+	auto apply = [this](const LLObjectUpdateQueue::Batch& batch, LLObjectUpdateRecord& record)
+		{
+			applyQueuedUpdate(batch, record);
+		};
+	const U32 pending = mUpdateQueue.getPendingCount();
+	if (update_budget > 0.f)
+	{
+		mUpdateQueue.applyPending(update_budget / 1000.f, apply);
+	}
+	else
+	{
+		// turned off with updates still queued
+		mUpdateQueue.applyAll(apply);
+	}
+	if (mUpdateQueue.getPendingCount() != pending)
+	{
+		// as processObjectUpdate() does after each message
+		LLVOAvatar::cullAvatarsByPixelArea();
+	}
+	sample(sQueuedObjectUpdates, mUpdateQueue.getPendingCount());
+}
+
+void LLViewerObjectList::applyQueuedUpdates(const LLHost& sender, U32 local_id)
+{
+	if (mUpdateQueue.isPending(sender, local_id))
+	{
+		mUpdateQueue.applyObject(sender, local_id, [this](const LLObjectUpdateQueue::Batch& batch, LLObjectUpdateRecord& record)
+			{
+				applyQueuedUpdate(batch, record);
+			});
+	}
+}
+
+void LLViewerObjectList::applyQueuedUpdate(const LLObjectUpdateQueue::Batch& batch, LLObjectUpdateRecord& record)
+{
+	LLViewerRegion* regionp = LLWorld::getInstance()->getRegionFromHandle(batch.mRegionHandle);
+	if (!regionp || regionp->getHost() != batch.mSender)
+	{
+		// the region went away while the update was queued
+		return;
+	}
+
+	if (batch.mType == OUT_FULL_COMPRESSED && (record.mFlags & FLAGS_TEMPORARY_ON_REZ))
+	{
+		applyQueuedFullUpdate(batch, record, regionp);
+	}
+	else if (batch.mType == OUT_FULL_COMPRESSED)
+	{
+		LLDataPackerBinaryBuffer dp(record.mData.data(), (S32)record.mData.size());
+		regionp->cacheFullUpdate(dp, record.mFlags, &record);
+	}
+	else
+	{
+		LLViewerStatsRecorder& recorder = LLViewerStatsRecorder::instance();
+		U8 cache_miss_type = LLViewerRegion::CACHE_MISS_TYPE_NONE;
+		if (regionp->probeCache(record.mLocalID, record.mCRC, record.mFlags, cache_miss_type))
+		{	// Cache Hit
+			recorder.cacheHitEvent();
+		}
+		else
+		{	// Cache Miss
+			recorder.cacheMissEvent(cache_miss_type);
+		}
+	}
+}
+
+// What processObjectUpdate() does for a compressed full update that
+// doesn't go to the object cache, the message fields it needs coming
+// from the batch
+void LLViewerObjectList::applyQueuedFullUpdate(const LLObjectUpdateQueue::Batch& batch, LLObjectUpdateRecord& record, LLViewerRegion* regionp)
+{
+	LLViewerStatsRecorder& recorder = LLViewerStatsRecorder::instance();
+
+	LLDataPackerBinaryBuffer dp(record.mData.data(), (S32)record.mData.size());
+	LLUUID fullid;
+	U32 local_id;
+	LLPCode pcode = 0;
+	dp.unpackUUID(fullid, "ID");
+	dp.unpackU32(local_id, "LocalID");
+	dp.unpackU8(pcode, "PCode");
+
+	LLViewerObject* objectp = findObject(fullid);
+	if (objectp &&
+		((objectp->mLocalID != local_id) ||
+		 (objectp->getRegion() != regionp)))
+	{
+		removeFromLocalIDTable(objectp);
+		setUUIDAndLocal(fullid,
+						local_id,
+						batch.mSender.getAddress(),
+						batch.mSender.getPort());
+
+		if (objectp->mLocalID != local_id)
+		{	// Update local ID in object with the one sent from the region
+			objectp->mLocalID = local_id;
+		}
+
+		if (objectp->getRegion() != regionp)
+		{	// Object changed region, so update it
+			objectp->updateRegion(regionp); // for LLVOAvatar
+		}
+	}
+
+	bool just_created = false;
+	if (!objectp)
+	{
+#ifdef IGNORE_DEAD
+		if (mDeadObjects.find(fullid) != mDeadObjects.end())
+		{
+			mNumDeadObjectUpdates++;
+			recorder.objectUpdateFailure();
+			return;
+		}
+#endif
+
+// [SL:KB] - Patch: World-Derender | Checked: 2012-06-08 (Catznip-3.3)
+		if (LLDerenderList::instance().processObjectUpdate(regionp->getHandle(), fullid, local_id, dp.getBuffer()))
+		{
+			return;
+		}
+// [/SL:KB]
+
+		objectp = createObject(pcode, regionp, fullid, local_id, batch.mSender);
+		if (!objectp)
+		{
+			LL_INFOS() << "createObject failure for object: " << fullid << LL_ENDL;
+			recorder.objectUpdateFailure();
+			return;
+		}
+
+		just_created = true;
+		mNumNewObjects++;
+	}
+
+	if (objectp->isDead())
+	{
+		LL_WARNS() << "Dead object " << objectp->mID << " in UUID map 1!" << LL_ENDL;
+	}
+
+	objectp->mLocalID = local_id;
+
+	LLObjectUpdateMessageInfo info;
+	info.mSender = batch.mSender;
+	info.mRegionHandle = batch.mRegionHandle;
+	info.mPacketID = batch.mPacketID;
+	info.mTimeDilation = batch.mTimeDilation;
+	info.mUpdateFlags = record.mFlags;
+
+	// No message behind it, processUpdateCore() falls back on the region's
+	// host for orphans and processUpdateMessage() reads the info instead
+	LLViewerObject::sQueuedUpdateInfo = &info;
+	processUpdateCore(objectp, NULL, 0, OUT_FULL_COMPRESSED, &dp, just_created, true);
+	LLViewerObject::sQueuedUpdateInfo = NULL;
+
+	recorder.objectUpdateEvent(OUT_FULL_COMPRESSED);
+	objectp->setLastUpdateType(OUT_FULL_COMPRESSED);
+}
+
 void LLViewerObjectList::dirtyAllObjectInventory()
 {
 	for (vobj_list_t::iterator iter = mObjects.begin(); iter != mObjects.end(); ++iter)
@@ -1016,12 +1230,20 @@ void LLViewerObjectList::update(LLAgent &agent)
 	}
 	else
 	{
-		for (std::vector<LLViewerObject*>::iterator idle_iter = idle_list.begin();
-			idle_iter != idle_end; idle_iter++)
+		static LLCachedControl<bool> batched_update(gSavedSettings, "AlchemyBatchedObjectUpdate", true);
+		if (batched_update)
+		{
+			idleUpdateBatched(agent, frame_time, idle_list.begin(), idle_end);
+		}
+		else
 		{
-			objectp = *idle_iter;
-			llassert(objectp->isActive());
-                objectp->idleUpdate(agent, frame_time);
+			for (std::vector<LLViewerObject*>::iterator idle_iter = idle_list.begin();
+				idle_iter != idle_end; idle_iter++)
+			{
+				objectp = *idle_iter;
+				llassert(objectp->isActive());
+				objectp->idleUpdate(agent, frame_time);
+			}
 		}
 
 		//update flexible objects
@@ -1100,6 +1322,178 @@ void LLViewerObjectList::update(LLAgent &agent)
 	sample(LLStatViewer::NUM_ACTIVE_OBJECTS, idle_count);
 }
 
+// Prims are most of the active list and don't override idleUpdate(), so
+// rather than going through it one object at a time their interpolation
+// state is copied into mMotionBatch and the math runs over all of them at
+// once on the General pool.  The results are applied as
+// LLViewerObject::idleUpdate() would.  Everything else gets its
+// idleUpdate() one type after another.
+void LLViewerObjectList::idleUpdateBatched(LLAgent& agent, const F64 frame_time,
+										   std::vector<LLViewerObject*>::const_iterator begin,
+										   std::vector<LLViewerObject*>::const_iterator end)
+{
+	LL_PROFILE_ZONE_SCOPED;
+
+	// Prims per chunk on the pool
+	const size_t MOTION_GRAIN = 256;
+
+	const F64Seconds frame_secs(frame_time);
+	const F64Seconds phase_out_time = LLViewerObject::sPhaseOutUpdateInterpolationTime;
+	const F64Seconds max_time = LLViewerObject::sMaxUpdateInterpolationTime;
+
+	mMotionBatch.clear();
+	mMotionBatch.reserve(end - begin);
+	mMotionObjects.clear();
+	for (auto& group : mIdleGroups)
+	{
+		group.second.clear();
+	}
+
+	// Whether each region's circuit has gone quiet, see interpolateLinearMotion()
+	std::vector<std::pair<LLViewerRegion*, bool> > stalled_regions;
+	auto is_stalled = [&stalled_regions](LLViewerRegion* regionp)
+	{
+		for (const auto& region : stalled_regions)
+		{
+			if (region.first == regionp)
+			{
+				return region.second;
+			}
+		}
+
+		bool stalled = false;
+		LLCircuitData* cdp = gMessageSystem->mCircuitInfo.findCircuit(regionp->getHost());
+		if (cdp)
+		{
+			F64Seconds time_since_last_packet = LLMessageSystem::getMessageTimeSeconds() - cdp->getLastPacketInTime();
+			stalled = !cdp->isAlive() || cdp->isBlocked() ||
+					  time_since_last_packet > LLViewerObject::sPhaseOutUpdateInterpolationTime;
+		}
+		stalled_regions.emplace_back(regionp, stalled);
+		return stalled;
+	};
+
+	for (auto iter = begin; iter != end; ++iter)
+	{
+		LLViewerObject* objectp = *iter;
+		llassert(objectp->isActive());
+
+		const LLPCode pcode = objectp->getPCode();
+		if (pcode != LL_PCODE_VOLUME)
+		{
+			auto group = std::find_if(mIdleGroups.begin(), mIdleGroups.end(),
+									  [pcode](const auto& entry) { return entry.first == pcode; });
+			if (group == mIdleGroups.end())
+			{
+				mIdleGroups.emplace_back(pcode, std::vector<LLViewerObject*>());
+				group = mIdleGroups.end() - 1;
+			}
+			group->second.push_back(objectp);
+			continue;
+		}
+
+		if (objectp->mDead)
+		{
+			continue;
+		}
+		if (objectp->mStatic || !LLViewerObject::sVelocityInterpolate || objectp->isSelected())
+		{
+			objectp->updateDrawable(FALSE);
+			continue;
+		}
+
+		LLViewerRegion* regionp = objectp->mRegionp;
+		const F32 time_dilation = regionp ? regionp->getTimeDilation() : 1.0f;
+		const F32 dt = time_dilation * (frame_secs - objectp->mLastInterpUpdateSecs).value();
+		const F64Seconds since_message = frame_secs - objectp->mLastMessageUpdateSecs;
+		const LLVector3& vel = objectp->getVelocity();
+		const LLVector3& accel = objectp->getAcceleration();
+
+		U32 flags = 0;
+		if (objectp->isAttachment())
+		{
+			flags |= LLObjectMotionBatch::ATTACHMENT;
+		}
+		if (!vel.isExactlyZero() || !accel.isExactlyZero())
+		{
+			flags |= LLObjectMotionBatch::MOVING;
+			if (regionp &&
+				max_time > (F64Seconds)0.0 &&
+				phase_out_time > (F64Seconds)0.0 &&
+				since_message > phase_out_time &&
+				is_stalled(regionp))
+			{
+				flags |= LLObjectMotionBatch::STALLED;
+			}
+		}
+
+		mMotionBatch.add(objectp->getPositionRegion(), vel, accel,
+						 objectp->getAngularVelocity(), objectp->getRotation(), objectp->mAngularVelocityRot,
+						 objectp->mRotTime, dt, (F32)since_message.value(),
+						 (F32)(frame_secs - objectp->mLastInterpUpdateSecs).value(),
+						 (F32)(objectp->mLastInterpUpdateSecs - objectp->mLastMessageUpdateSecs).value(),
+						 flags);
+		mMotionObjects.push_back(objectp);
+	}
+
+	LLObjectMotionBatch::Params params;
+	params.mPhaseOutTime = (F32)phase_out_time.value();
+	params.mMaxTime = (F32)max_time.value();
+	mMotionBatch.update(params, MOTION_GRAIN);
+
+	for (size_t i = 0; i < mMotionObjects.size(); ++i)
+	{
+		LLViewerObject* objectp = mMotionObjects[i];
+		const U32 flags = mMotionBatch.getFlags(i);
+
+		objectp->mRotTime = mMotionBatch.getRotTime(i);
+		if (flags & LLObjectMotionBatch::ROTATED)
+		{
+			objectp->mAngularVelocityRot = mMotionBatch.getAngularVelocityRot(i);
+			objectp->setRotation(mMotionBatch.getRotation(i));
+			objectp->setChanged(LLXform::MOVED | LLXform::SILHOUETTE);
+		}
+
+		if (flags & LLObjectMotionBatch::ATTACHMENT)
+		{
+			objectp->mLastInterpUpdateSecs = frame_secs;
+			continue;
+		}
+
+		if (flags & LLObjectMotionBatch::MOVED)
+		{
+			if (max_time <= (F64Seconds)0.0)
+			{	// Old code path ... unbounded, simple interpolation
+				objectp->setPositionRegion(mMotionBatch.getPosition(i));
+				objectp->setVelocity(mMotionBatch.getVelocity(i));
+				objectp->setChanged(LLXform::MOVED | LLXform::SILHOUETTE);
+			}
+			else
+			{
+				objectp->applyInterpolatedMotion(frame_secs, mMotionBatch.getPosition(i), mMotionBatch.getVelocity(i));
+			}
+		}
+		if (flags & LLObjectMotionBatch::INTERPOLATED)
+		{
+			objectp->mLastInterpUpdateSecs = frame_secs;
+		}
+
+		objectp->updateDrawable(FALSE);
+	}
+
+	// avatar skeletons are brought up to date together once every object
+	// has had its idle update
+	LLVOAvatar::beginDeferredIdleUpdates();
+	for (const auto& group : mIdleGroups)
+	{
+		for (LLViewerObject* objectp : group.second)
+		{
+			objectp->idleUpdate(agent, frame_time);
+		}
+	}
+	LLVOAvatar::finishDeferredIdleUpdates(agent);
+}
+
 void LLViewerObjectList::fetchObjectCosts()
 {
 	// issue http request for stale object physics costs
@@ -1491,6 +1885,8 @@ void LLViewerObjectList::killAllObjects()
 	// Used only on global destruction.
 	LLViewerObject *objectp;
 
+	mUpdateQueue.clear();
+
 	for (vobj_list_t::iterator iter = mObjects.begin(); iter != mObjects.end(); ++iter)
 	{
 		objectp = *iter;
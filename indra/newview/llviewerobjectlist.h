@@ -36,6 +36,8 @@
 
 // project includes
 #include "llviewerobject.h"
+#include "llobjectmotionbatch.h"
+#include "llobjectupdatequeue.h"
 #include "lleventcoro.h"
 #include "llcoros.h"
 
@@ -91,6 +93,13 @@ class LLViewerObjectList
 	void processObjectUpdate(LLMessageSystem *mesgsys, void **user_data, EObjectUpdateType update_type, bool compressed=false);
 	void processCompressedObjectUpdate(LLMessageSystem *mesgsys, void **user_data, EObjectUpdateType update_type);
 	void processCachedObjectUpdate(LLMessageSystem *mesgsys, void **user_data, EObjectUpdateType update_type);
+
+	// Updates that the two above queued, applied for
+	// AlchemyObjectUpdateBudget milliseconds per frame
+	void applyQueuedUpdates();
+	// Applies whatever is queued for one object, before anything else touches it
+	void applyQueuedUpdates(const LLHost& sender, U32 local_id);
+	U32 getQueuedUpdateCount() const { return mUpdateQueue.getPendingCount(); }
 	void updateApparentAngles(LLAgent &agent);
 	void update(LLAgent &agent);
 
@@ -196,6 +205,20 @@ class LLViewerObjectList
 	S32 mNumDeadObjectUpdates;
 	S32 mNumDeadObjects;
 protected:
+	void applyQueuedUpdate(const LLObjectUpdateQueue::Batch& batch, LLObjectUpdateRecord& record);
+	void applyQueuedFullUpdate(const LLObjectUpdateQueue::Batch& batch, LLObjectUpdateRecord& record, LLViewerRegion* regionp);
+
+	LLObjectUpdateQueue mUpdateQueue;
+
+	// Runs idleUpdate() for the active objects in [begin, end), see update()
+	void idleUpdateBatched(LLAgent& agent, const F64 frame_time,
+						   std::vector<LLViewerObject*>::const_iterator begin,
+						   std::vector<LLViewerObject*>::const_iterator end);
+
+	LLObjectMotionBatch mMotionBatch;
+	std::vector<LLViewerObject*> mMotionObjects;	// the object behind each mMotionBatch entry
+	std::vector<std::pair<LLPCode, std::vector<LLViewerObject*> > > mIdleGroups;	// the rest, by type
+
 	std::vector<U64>	mOrphanParents;	// LocalID/ip,port of orphaned objects
 	std::vector<OrphanInfo> mOrphanChildren;	// UUID's of orphaned objects
 	S32 mNumOrphans;
@@ -34,6 +34,7 @@
 #include "llavatarnamecache.h"		// name lookup cap url
 #include "llfloaterreg.h"
 #include "llmath.h"
+#include "llobjectupdatequeue.h"
 #include "llregex.h"
 #include "llregionflags.h"
 #include "llregionhandle.h"
@@ -821,7 +822,7 @@ void LLViewerRegion::loadObjectCache()
 		vocache.readFromCache(mHandle, mImpl->mCacheID, mImpl->mCacheMap);
         vocache.readGenericExtrasFromCache(mHandle, mImpl->mCacheID, mImpl->mGLTFOverridesLLSD);
 
-		if (mImpl->mCacheMap.empty())
+		if (isObjectCacheEmpty())
 		{
 			mCacheDirty = TRUE;
 		}
@@ -829,6 +830,12 @@ void LLViewerRegion::loadObjectCache()
 }
 
 
+bool LLViewerRegion::isObjectCacheEmpty() const
+{
+	return mImpl->mCacheMap.empty()
+		&& !(LLVOCache::instanceExists() && LLVOCache::instance().getNumStoredEntries(mHandle) > 0);
+}
+
 void LLViewerRegion::saveObjectCache()
 {
 	if (!mCacheLoaded)
@@ -838,6 +845,10 @@ void LLViewerRegion::saveObjectCache()
 
 	if (mImpl->mCacheMap.empty())
 	{
+		if (LLVOCache::instanceExists())
+		{
+			LLVOCache::instance().closeRegionFile(mHandle);
+		}
 		return;
 	}
 
@@ -2618,7 +2629,7 @@ void LLViewerRegion::findOrphans(U32 parent_id)
 	}
 }
 
-void LLViewerRegion::decodeBoundingInfo(LLVOCacheEntry* entry)
+void LLViewerRegion::decodeBoundingInfo(LLVOCacheEntry* entry, const LLObjectUpdateRecord* decoded)
 {
 	if(!sVOCacheCullingEnabled)
 	{
@@ -2675,7 +2686,18 @@ void LLViewerRegion::decodeBoundingInfo(LLVOCacheEntry* entry)
 	LLQuaternion rot;
 
 	//decode spatial info and parent info
-	U32 parent_id = LLViewerObject::extractSpatialExtents(entry->getDP(), pos, scale, rot);
+	U32 parent_id;
+	if (decoded)
+	{
+		parent_id = decoded->mParentID;
+		pos = decoded->mPos;
+		scale = decoded->mScale;
+		rot = decoded->mRot;
+	}
+	else
+	{
+		parent_id = LLViewerObject::extractSpatialExtents(entry->getDP(), pos, scale, rot);
+	}
 	
 	U32 old_parent_id = entry->getParentID();
 	bool same_old_parent = false;
@@ -2784,7 +2806,7 @@ void LLViewerRegion::decodeBoundingInfo(LLVOCacheEntry* entry)
 	return ;
 }
 
-LLViewerRegion::eCacheUpdateResult LLViewerRegion::cacheFullUpdate(LLDataPackerBinaryBuffer &dp, U32 flags)
+LLViewerRegion::eCacheUpdateResult LLViewerRegion::cacheFullUpdate(LLDataPackerBinaryBuffer &dp, U32 flags, const LLObjectUpdateRecord* decoded)
 {
 	eCacheUpdateResult result;
 	U32 crc;
@@ -2832,7 +2854,7 @@ LLViewerRegion::eCacheUpdateResult LLViewerRegion::cacheFullUpdate(LLDataPackerB
 
 // [SL:KB] - Patch: World-Derender | Checked: 2014-08-10 (Catznip-3.7)
 		if (fUpdateObj)
-			decodeBoundingInfo(entry);
+			decodeBoundingInfo(entry, result == CACHE_UPDATE_CHANGED ? decoded : NULL);
 // [/SL:KB]
 	}
 	else
@@ -2850,7 +2872,7 @@ LLViewerRegion::eCacheUpdateResult LLViewerRegion::cacheFullUpdate(LLDataPackerB
 		
 		mImpl->mCacheMap[local_id] = entry;
 		
-		decodeBoundingInfo(entry);
+		decodeBoundingInfo(entry, decoded);
 	}
 	entry->setUpdateFlags(flags);
 
@@ -2886,6 +2908,15 @@ LLVOCacheEntry* LLViewerRegion::getCacheEntryForOctree(U32 local_id)
 LLVOCacheEntry* LLViewerRegion::getCacheEntry(U32 local_id, bool valid)
 {
 	LLVOCacheEntry::vocache_entry_map_t::iterator iter = mImpl->mCacheMap.find(local_id);
+	if (iter == mImpl->mCacheMap.end() && mCacheLoaded && LLVOCache::instanceExists())
+	{
+		// A mapped region cache hands its entries out on first use
+		LLPointer<LLVOCacheEntry> entry = LLVOCache::instance().readEntry(mHandle, local_id);
+		if (entry.notNull())
+		{
+			iter = mImpl->mCacheMap.emplace(local_id, entry).first;
+		}
+	}
 	if(iter != mImpl->mCacheMap.end())
 	{
 		if(!valid || iter->second->isValid())
@@ -3258,7 +3289,7 @@ void LLViewerRegion::unpackRegionHandshake()
 	{
 		flags |= 0x00000001; //set the bit 0 to be 1 to ask sim to send all cacheable objects.		
 	}
-	if(mImpl->mCacheMap.empty())
+	if(isObjectCacheEmpty())
 	{
 		flags |= 0x00000002; //set the bit 1 to be 1 to tell sim the cache file is empty, no need to send cache probes.
 	}
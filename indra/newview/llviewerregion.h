@@ -61,6 +61,7 @@ class LLViewerObject;
 class LLViewerTexture;
 class LLMessageSystem;
 class LLNetMap;
+struct LLObjectUpdateRecord;
 class LLViewerParcelOverlay;
 class LLSurface;
 class LLVOCache;
@@ -113,6 +114,8 @@ class LLViewerRegion final : public LLCapabilityProvider // implements this inte
 	// Call this after you have the region name and handle.
 	void loadObjectCache();
 	void saveObjectCache();
+	// No entries loaded, and none left in a mapped cache file either
+	bool isObjectCacheEmpty() const;
 
 	void sendMessage(); // Send the current message to this region's simulator
 	void sendReliableMessage(); // Send the current message to this region's simulator
@@ -367,8 +370,9 @@ class LLViewerRegion final : public LLCapabilityProvider // implements this inte
 		CACHE_UPDATE_REPLACED
 	} eCacheUpdateResult;
 
-	// handle a full update message
-	eCacheUpdateResult cacheFullUpdate(LLDataPackerBinaryBuffer &dp, U32 flags);
+	// handle a full update message.  decoded, when given, holds the
+	// spatial extents already unpacked from dp.
+	eCacheUpdateResult cacheFullUpdate(LLDataPackerBinaryBuffer &dp, U32 flags, const LLObjectUpdateRecord* decoded = NULL);
 	eCacheUpdateResult cacheFullUpdate(LLViewerObject* objectp, LLDataPackerBinaryBuffer &dp, U32 flags);
 
     void cacheFullUpdateGLTFOverride(const LLGLTFOverrideCacheEntry &override_data);
@@ -485,7 +489,7 @@ class LLViewerRegion final : public LLCapabilityProvider // implements this inte
 	void updateVisibleEntries(F32 max_time); //update visible entries
 
 	void addCacheMiss(U32 id, LLViewerRegion::eCacheMissType miss_type);
-	void decodeBoundingInfo(LLVOCacheEntry* entry);
+	void decodeBoundingInfo(LLVOCacheEntry* entry, const LLObjectUpdateRecord* decoded = NULL);
 	bool isNonCacheableObjectCreated(U32 local_id);	
 	void setGodnames();
 
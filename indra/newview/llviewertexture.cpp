@@ -1062,6 +1062,11 @@ void LLViewerFetchedTexture::init(bool firstinit)
 	if (firstinit)
 	{
 		mInImageList = 0;
+		mPriorityBucket = -1;
+		mPriorityIndex = 0;
+		mPriorityNeedsWork = false;
+		mPriorityDirty = false;
+		mPriorityFrame = 0;
 	}
 
 	// Only set mIsMissingAsset true when we know for certain that the database
@@ -1168,8 +1173,21 @@ void LLViewerFetchedTexture::loadFromFastCache()
 
     add(LLTextureFetch::sCacheAttempt, 1.0);
 
+	// The fast cache keeps up to 64x64, only ask for more than the usual
+	// placeholder where the texture is known to be drawn that large
+	static LLCachedControl<S32> fast_cache_max_size(gSavedSettings, "AlchemyTextureFastCacheMaxSize", 16);
+	S32 max_dimension = fast_cache_max_size;
+	if (mBoostLevel == LLGLTexture::BOOST_ICON)
+	{
+		max_dimension = mKnownDrawWidth > 0 ? llmax(mKnownDrawWidth, mKnownDrawHeight) : DEFAULT_ICON_DIMENSIONS;
+	}
+	else if (mBoostLevel == LLGLTexture::BOOST_THUMBNAIL)
+	{
+		max_dimension = mKnownDrawWidth > 0 ? llmax(mKnownDrawWidth, mKnownDrawHeight) : DEFAULT_THUMBNAIL_DIMENSIONS;
+	}
+
     LLTimer fastCacheTimer;
-	mRawImage = LLAppViewer::getTextureCache()->readFromFastCache(getID(), mRawDiscardLevel);
+	mRawImage = LLAppViewer::getTextureCache()->readFromFastCache(getID(), mRawDiscardLevel, max_dimension);
 	if(mRawImage.notNull())
 	{
         F32 cachReadTime = fastCacheTimer.getElapsedTimeF32();
@@ -1194,8 +1212,8 @@ void LLViewerFetchedTexture::loadFromFastCache()
 		{
             if (mBoostLevel == LLGLTexture::BOOST_ICON)
             {
-                // Shouldn't do anything usefull since texures in fast cache are 16x16,
-                // it is here in case fast cache changes.
+                // Fast cache picks a level that fits, this only catches
+                // non square icons.
                 S32 expected_width = mKnownDrawWidth > 0 ? mKnownDrawWidth : DEFAULT_ICON_DIMENSIONS;
                 S32 expected_height = mKnownDrawHeight > 0 ? mKnownDrawHeight : DEFAULT_ICON_DIMENSIONS;
                 if (mRawImage && (mRawImage->getWidth() > expected_width || mRawImage->getHeight() > expected_height))
@@ -1581,7 +1599,9 @@ BOOL LLViewerFetchedTexture::createTexture(S32 usename/*= 0*/)
         return FALSE;
     }
 
-	BOOL res = mGLTexturep->createGLTexture(mRawDiscardLevel, mRawImage, usename, TRUE, mBoostLevel);
+	// on the main thread large images are filled over several frames
+	BOOL res = usename ? mGLTexturep->createGLTexture(mRawDiscardLevel, mRawImage, usename, TRUE, mBoostLevel)
+					   : mGLTexturep->createGLTextureStaged(mRawDiscardLevel, mRawImage, mBoostLevel);
     
 	return res;
 }
@@ -264,6 +264,8 @@ class LLViewerFetchedTexture : public LLViewerTexture
 {
 	friend class LLTextureBar; // debug info only
 	friend class LLTextureView; // debug info only
+	template<class T> friend class LLPriorityBuckets;
+	friend class LLViewerTextureList;
 
 protected:
 	/*virtual*/ ~LLViewerFetchedTexture();
@@ -517,6 +519,11 @@ class LLViewerFetchedTexture : public LLViewerTexture
 	LLFrameTimer mStopFetchingTimer;	// Time since mDecodePriority == 0.f.
 
 	BOOL  mInImageList;				// TRUE if image is in list (in which case don't reset priority!)
+	S8    mPriorityBucket;			// LLTexturePriorityBuckets bucket, -1 if in none
+	U32   mPriorityIndex;			// slot in that bucket
+	bool  mPriorityNeedsWork;		// filed with the textures that still need fetching
+	bool  mPriorityDirty;			// a face's virtual size changed, rescore next frame
+	U32   mPriorityFrame;			// frame the priority was last rescored
 	// This needs to be atomic, since it is written both in the main thread
 	// and in the GL image worker thread... HB
 	LLAtomicBool mNeedsCreateTexture;	
@@ -31,8 +31,13 @@
 
 #include "llmath.h"
 #include "llerror.h"
+#include "llparallelfor.h"
+
+// Animations per chunk on the pool
+static const size_t FRAME_GRAIN = 256;
 
 std::vector<LLViewerTextureAnim*> LLViewerTextureAnim::sInstanceList;
+std::vector<LLViewerTextureAnim::Frame> LLViewerTextureAnim::sFrames;
 
 LLViewerTextureAnim::LLViewerTextureAnim(LLVOVolume* vobj) : LLTextureAnim()
 {
@@ -69,9 +74,30 @@ void LLViewerTextureAnim::reset()
 //static 
 void LLViewerTextureAnim::updateClass()
 {
-	for (std::vector<LLViewerTextureAnim*>::iterator iter = sInstanceList.begin(); iter != sInstanceList.end(); ++iter)
+	LL_PROFILE_ZONE_SCOPED;
+
+	// Working out the frames only touches the animations, so that part
+	// runs on the pool.  Applying them to the faces stays here.
+	const size_t count = sInstanceList.size();
+	sFrames.resize(count);
+	LL::parallelFor("General", count, FRAME_GRAIN,
+					[](size_t begin, size_t end)
+					{
+						for (size_t i = begin; i < end; ++i)
+						{
+							Frame& frame = sFrames[i];
+							frame.mOffS = frame.mOffT = frame.mRot = 0.f;
+							frame.mScaleS = frame.mScaleT = 1.f;
+							frame.mResult = sInstanceList[i]->animateTextures(frame.mOffS, frame.mOffT,
+																			  frame.mScaleS, frame.mScaleT, frame.mRot);
+						}
+					});
+
+	for (size_t i = 0; i < count; ++i)
 	{
-		(*iter)->mVObj->animateTextures();
+		const Frame& frame = sFrames[i];
+		sInstanceList[i]->mVObj->applyTextureAnim(frame.mResult, frame.mOffS, frame.mOffT,
+												  frame.mScaleS, frame.mScaleT, frame.mRot);
 	}
 }
 
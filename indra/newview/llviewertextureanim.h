@@ -35,7 +35,19 @@ class LLVOVolume;
 class LLViewerTextureAnim : public LLTextureAnim
 {
 private:
+	// A frame worked out by animateTextures()
+	struct Frame
+	{
+		S32 mResult;
+		F32 mOffS;
+		F32 mOffT;
+		F32 mScaleS;
+		F32 mScaleT;
+		F32 mRot;
+	};
+
 	static std::vector<LLViewerTextureAnim*> sInstanceList;
+	static std::vector<Frame> sFrames;		// parallel to sInstanceList
 	S32 mInstanceIndex;
 
 public:
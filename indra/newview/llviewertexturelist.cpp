@@ -371,6 +371,9 @@ void LLViewerTextureList::shutdown()
 	mLoadingStreamList.clear();
 	mCreateTextureList.clear();
 	mFastCacheList.clear();
+
+	mPriorityDirtyList.clear();
+	mPriorityBuckets.clear();
 	
 	mUUIDMap.clear();
 	
@@ -699,6 +702,7 @@ void LLViewerTextureList::addImageToList(LLViewerFetchedTexture *image)
 			LL_WARNS() << "Error happens when insert image " << image->getID()  << " into mImageList!" << LL_ENDL ;
 	}
 	image->setInImageList(TRUE) ;
+	fileImage(image);
 }
 }
 
@@ -750,6 +754,7 @@ void LLViewerTextureList::removeImageFromList(LLViewerFetchedTexture *image)
 		}
 	}
       
+	mPriorityBuckets.remove(image);
 	image->setInImageList(FALSE) ;
 }
 
@@ -803,6 +808,15 @@ void LLViewerTextureList::dirtyImage(LLViewerFetchedTexture *image)
 	mDirtyTextureList.insert(image);
 }
 
+void LLViewerTextureList::dirtyImagePriority(LLViewerFetchedTexture *imagep)
+{
+	if (!imagep->mPriorityDirty && imagep->isInImageList())
+	{
+		imagep->mPriorityDirty = true;
+		mPriorityDirtyList.push_back(imagep);
+	}
+}
+
 ////////////////////////////////////////////////////////////////////////////
 
 void LLViewerTextureList::updateImages(F32 max_time)
@@ -888,11 +902,17 @@ void LLViewerTextureList::clearFetchingRequests()
 	}
 }
 
-static void touch_texture(LLViewerFetchedTexture* tex, F32 vsize)
+void LLViewerTextureList::touchTexture(LLViewerFetchedTexture* tex, F32 vsize)
 {
     if (tex)
     {
         tex->addTextureStats(vsize);
+        // material textures have no faces of their own, this is where their
+        // priority moves
+        if (tex->isInImageList())
+        {
+            fileImage(tex);
+        }
     }
 }
 
@@ -947,10 +967,10 @@ void LLViewerTextureList::updateImageDecodePriority(LLViewerFetchedTexture* imag
                     llassert(mat == nullptr || dynamic_cast<LLFetchedGLTFMaterial*>(te->getGLTFRenderMaterial()) != nullptr);
                     if (mat)
                     {
-                        touch_texture(mat->mBaseColorTexture, vsize);
-                        touch_texture(mat->mNormalTexture, vsize);
-                        touch_texture(mat->mMetallicRoughnessTexture, vsize);
-                        touch_texture(mat->mEmissiveTexture, vsize);
+                        touchTexture(mat->mBaseColorTexture, vsize);
+                        touchTexture(mat->mNormalTexture, vsize);
+                        touchTexture(mat->mMetallicRoughnessTexture, vsize);
+                        touchTexture(mat->mEmissiveTexture, vsize);
                     }
                     else
                     {
@@ -1054,6 +1074,12 @@ F32 LLViewerTextureList::updateImagesCreateTextures(F32 max_time)
 	//
 		
 	LLTimer create_timer;
+
+	// staged uploads send a bounded number of bytes per frame, on top of the
+	// time limit on creating textures
+	static LLCachedControl<U32> upload_budget(gSavedSettings, "AlchemyTextureUploadBudget", 4096);
+	LLImageGL::sStagedUploadBudget = upload_budget * 1024;
+
 	image_list_t::iterator enditer = mCreateTextureList.begin();
 	for (image_list_t::iterator iter = mCreateTextureList.begin();
 		 iter != mCreateTextureList.end();)
@@ -1070,6 +1096,8 @@ F32 LLViewerTextureList::updateImagesCreateTextures(F32 max_time)
         }
 	}
 	mCreateTextureList.erase(mCreateTextureList.begin(), enditer);
+
+	LLImageGL::updateStagedUploads();
 	return create_timer.getElapsedTimeF32();
 }
 
@@ -1119,16 +1147,162 @@ void LLViewerTextureList::forceImmediateUpdate(LLViewerFetchedTexture* imagep)
 	return ;
 }
 
+// A texture still needs fetch work when it has nothing loaded, is below the
+// resolution it wants or is in the middle of a fetch
+static bool needs_fetch_work(LLViewerFetchedTexture* imagep)
+{
+    const S32 current_discard = imagep->getDiscardLevel();
+    return imagep->getGLTexture() && !imagep->isMissingAsset()
+        && (imagep->isFetching() || current_discard < 0 || imagep->getDesiredDiscardLevel() < current_discard);
+}
+
+void LLViewerTextureList::fileImage(LLViewerFetchedTexture* imagep)
+{
+    mPriorityBuckets.update(imagep, imagep->getMaxVirtualSize(), needs_fetch_work(imagep));
+}
+
+void LLViewerTextureList::rescoreImage(LLViewerFetchedTexture* imagep, U32 frame)
+{
+    updateImageDecodePriority(imagep);
+    imagep->mPriorityFrame = frame;
+    if (imagep->isInImageList())
+    {
+        fileImage(imagep);
+    }
+}
+
 F32 LLViewerTextureList::updateImagesFetchTextures(F32 max_time)
 {
     LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
     typedef std::vector<LLPointer<LLViewerFetchedTexture> > entries_list_t;
     entries_list_t entries;
 
-    // update N textures at beginning of mImageList
-    U32 update_count = 0;
     static const S32 MIN_UPDATE_COUNT = gSavedSettings.getS32("TextureFetchUpdateMinCount");       // default: 32
-    // WIP -- dumb code here
+    // frames before the discard bias looks at the same texture again
+    const U32 BIAS_RESCORE_FRAMES = 30;
+
+    LLTimer timer;
+    const U32 frame = LLFrameTimer::getFrameCount();
+
+    {
+        LL_PROFILE_ZONE_NAMED_CATEGORY_TEXTURE("vtluift - dirty");
+
+        // textures whose faces changed size since last frame, what does not
+        // fit in half the time waits for the next one
+        entries.swap(mPriorityDirtyList);
+        size_t i = 0;
+        for (; i < entries.size() && timer.getElapsedTimeF32() < max_time * 0.5f; ++i)
+        {
+            LLViewerFetchedTexture* imagep = entries[i];
+            imagep->mPriorityDirty = false;
+            if (imagep->getNumRefs() > 1)
+            {
+                rescoreImage(imagep, frame);
+            }
+        }
+        mPriorityDirtyList.insert(mPriorityDirtyList.end(), entries.begin() + i, entries.end());
+        entries.clear();
+    }
+
+    {
+        LL_PROFILE_ZONE_NAMED_CATEGORY_TEXTURE("vtluift - top buckets");
+
+        // fetch for the most wanted textures first, bucket 0 is not wanted.
+        // Only textures that still need work are in these buckets; any found
+        // done since they were filed are moved out once the walk is over.
+        std::vector<LLViewerFetchedTexture*> settled;
+        for (S32 bucket = mPriorityBuckets.getTopBucket(true);
+             bucket > 0 && entries.size() < (size_t)MIN_UPDATE_COUNT && timer.getElapsedTimeF32() < max_time;
+             --bucket)
+        {
+            for (LLViewerFetchedTexture* imagep : mPriorityBuckets.getTextures(bucket, true))
+            {
+                if (entries.size() >= (size_t)MIN_UPDATE_COUNT)
+                {
+                    break;
+                }
+
+                if (needs_fetch_work(imagep))
+                {
+                    entries.push_back(imagep);
+                }
+                else
+                {
+                    settled.push_back(imagep);
+                }
+            }
+        }
+
+        for (LLViewerFetchedTexture* imagep : settled)
+        {
+            fileImage(imagep);
+        }
+
+        for (auto& imagep : entries)
+        {
+            if (imagep->getNumRefs() > 1)
+            {
+                imagep->updateFetch();
+            }
+            if (imagep->isInImageList())
+            {
+                fileImage(imagep);
+            }
+
+            if (timer.getElapsedTimeF32() > max_time)
+            {
+                break;
+            }
+        }
+        entries.clear();
+    }
+
+    if (LLViewerTexture::sDesiredDiscardBias > 1.f)
+    {
+        LL_PROFILE_ZONE_NAMED_CATEGORY_TEXTURE("vtluift - discard bias");
+
+        // short on memory, the least wanted textures give up resolution
+        // first.  What was rescored lately is stepped over, that is at most
+        // BIAS_RESCORE_FRAMES frames worth of this loop.
+        for (S32 bucket = 0;
+             bucket < LLTexturePriorityBuckets::NUM_BUCKETS && entries.size() < (size_t)MIN_UPDATE_COUNT && timer.getElapsedTimeF32() < max_time;
+             ++bucket)
+        {
+            for (bool needs_work : { false, true })
+            {
+                for (LLViewerFetchedTexture* imagep : mPriorityBuckets.getTextures(bucket, needs_work))
+                {
+                    if (entries.size() >= (size_t)MIN_UPDATE_COUNT)
+                    {
+                        break;
+                    }
+
+                    if (imagep->getDiscardLevel() >= 0 && frame - imagep->mPriorityFrame > BIAS_RESCORE_FRAMES)
+                    {
+                        entries.push_back(imagep);
+                    }
+                }
+            }
+        }
+
+        for (auto& imagep : entries)
+        {
+            if (imagep->getNumRefs() > 1)
+            {
+                rescoreImage(imagep, frame);
+            }
+
+            if (timer.getElapsedTimeF32() > max_time)
+            {
+                break;
+            }
+        }
+        entries.clear();
+    }
+
+    // Sweep the rest of the textures a few at a time, for decay, fetch
+    // results and cleanup of textures no longer in use.
+    U32 update_count = 0;
     //update MIN_UPDATE_COUNT or 5% of other textures, whichever is greater
     update_count = llmax((U32) MIN_UPDATE_COUNT, (U32) mUUIDMap.size()/20);
     update_count = llmin(update_count, (U32) mUUIDMap.size());
@@ -1154,8 +1328,6 @@ F32 LLViewerTextureList::updateImagesFetchTextures(F32 max_time)
         }
     }
 
-    LLTimer timer;
-
     LLPointer<LLViewerTexture> last_imagep = nullptr;
 
     for (auto& imagep : entries)
@@ -1163,8 +1335,15 @@ F32 LLViewerTextureList::updateImagesFetchTextures(F32 max_time)
         if (imagep && imagep->getNumRefs() > 1) // make sure this image hasn't been deleted before attempting to update (may happen as a side effect of some other image updating)
 
         {
-            updateImageDecodePriority(imagep);
+            if (imagep->mPriorityFrame != frame)
+            {
+                rescoreImage(imagep, frame);
+            }
             imagep->updateFetch();
+            if (imagep->isInImageList())
+            {
+                fileImage(imagep);
+            }
         }
 
         last_imagep = imagep;
@@ -31,6 +31,7 @@
 //#include "message.h"
 #include "llgl.h"
 #include "llviewertexture.h"
+#include "lltexturepriority.h"
 #include "llui.h"
 #include <list>
 #include <set>
@@ -137,6 +138,10 @@ class LLViewerTextureList
 	LLViewerFetchedTexture *findImage(const LLTextureKey &search_key);
 
 	void dirtyImage(LLViewerFetchedTexture *image);
+
+	// Has the texture rescored next frame, for faces whose virtual size
+	// moved to another priority bucket
+	void dirtyImagePriority(LLViewerFetchedTexture *imagep);
 	
 	// Using image stats, determine what images are necessary, and perform image updates.
 	void updateImages(F32 max_time);
@@ -164,6 +169,12 @@ class LLViewerTextureList
     // - updates desired discard level
     // - cleans up textures that haven't been referenced in awhile
     void updateImageDecodePriority(LLViewerFetchedTexture* imagep);
+	// Files the texture in mPriorityBuckets by its max virtual size and
+	// whether it still needs fetching
+	void fileImage(LLViewerFetchedTexture* imagep);
+	// updateImageDecodePriority(), then refiles the texture in its bucket
+	void rescoreImage(LLViewerFetchedTexture* imagep, U32 frame);
+	void touchTexture(LLViewerFetchedTexture* imagep, F32 vsize);
 	F32  updateImagesCreateTextures(F32 max_time);
 	F32  updateImagesFetchTextures(F32 max_time);
 	void updateImagesUpdateStats();
@@ -240,6 +251,10 @@ class LLViewerTextureList
     typedef std::set < LLPointer<LLViewerFetchedTexture> > image_priority_list_t;
 	image_priority_list_t mImageList;
 
+	// mImageList by max virtual size, and what needs rescoring next frame
+	LLTexturePriorityBuckets mPriorityBuckets;
+	std::vector<LLPointer<LLViewerFetchedTexture> > mPriorityDirtyList;
+
 	// simply holds on to LLViewerFetchedTexture references to stop them from being purged too soon
 	std::set<LLPointer<LLViewerFetchedTexture> > mImagePreloads;
 
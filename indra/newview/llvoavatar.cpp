@@ -133,6 +133,8 @@
 #include "llsidepanelappearance.h"
 #include "llviewermenufile.h"
 
+#include "llparallelfor.h"
+
 extern F32 SPEED_ADJUST_MAX;
 extern F32 SPEED_ADJUST_MAX_SEC;
 extern F32 ANIM_SPEED_MAX;
@@ -638,6 +640,8 @@ F32 LLVOAvatar::sGreyUpdateTime = 0.f;
 LLPointer<LLViewerTexture> LLVOAvatar::sCloudTexture = NULL;
 std::vector<LLUUID> LLVOAvatar::sAVsIgnoringARTLimit;
 S32 LLVOAvatar::sAvatarsNearby = 0;
+bool LLVOAvatar::sDeferSkeletonUpdates = false;
+std::vector<LLPointer<LLVOAvatar> > LLVOAvatar::sDeferredSkeletons;
 
 //-----------------------------------------------------------------------------
 // Helper functions
@@ -693,6 +697,8 @@ LLVOAvatar::LLVOAvatar(const LLUUID& id,
 	mCulled( FALSE ),
 	mVisibilityRank(0),
 	mNeedsSkin(FALSE),
+	mSkeletonUpdateDeferred(false),
+	mDeferredDetailedUpdate(FALSE),
 	mLastSkinTime(0.f),
 	mUpdatePeriod(1),
 	mOverallAppearance(AOA_INVISIBLE),
@@ -2669,7 +2675,18 @@ void LLVOAvatar::idleUpdate(LLAgent &agent, const F64 &time)
 	// store off last frame's root position to be consistent with camera position
 	mLastRootPos = mRoot->getWorldPosition();
 	BOOL detailed_update = updateCharacter(agent);
+	if (mSkeletonUpdateDeferred)
+	{
+		// finished by finishDeferredIdleUpdates() once the skeleton is up to date
+		mDeferredDetailedUpdate = detailed_update;
+		return;
+	}
+
+	idleUpdateFinish(agent, detailed_update);
+}
 
+void LLVOAvatar::idleUpdateFinish(LLAgent &agent, BOOL detailed_update)
+{
 	static LLUICachedControl<bool> visualizers_in_calls("ShowVoiceVisualizersInCalls", false);
 	bool voice_enabled = (visualizers_in_calls || LLVoiceClient::getInstance()->inProximalChannel()) &&
 						 LLVoiceClient::getInstance()->getVoiceEnabled(mID);
@@ -2725,6 +2742,53 @@ void LLVOAvatar::idleUpdate(LLAgent &agent, const F64 &time)
     idleUpdateDebugInfo();
 }
 
+//static
+void LLVOAvatar::beginDeferredIdleUpdates()
+{
+	static LLCachedControl<bool> parallel_skeleton_update(gSavedSettings, "AlchemyParallelSkeletonUpdate", true);
+	sDeferSkeletonUpdates = parallel_skeleton_update;
+}
+
+//static
+void LLVOAvatar::finishDeferredIdleUpdates(LLAgent &agent)
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_AVATAR;
+
+	sDeferSkeletonUpdates = false;
+	if (sDeferredSkeletons.empty())
+	{
+		return;
+	}
+
+	std::vector<LLPointer<LLVOAvatar> > avatars;
+	avatars.swap(sDeferredSkeletons);
+
+	// Each skeleton only reads its own joints and the xforms of whatever it
+	// sits on, which nothing writes until the loop below.
+	LL::parallelFor("General", avatars.size(), 1,
+		[&avatars](size_t begin, size_t end)
+		{
+			LL_PROFILE_ZONE_NAMED_CATEGORY_AVATAR("updateWorldMatrixChildren");
+			for (size_t i = begin; i < end; ++i)
+			{
+				LLVOAvatar* avatar = avatars[i];
+				if (!avatar->isDead())
+				{
+					avatar->mRoot->updateWorldMatrixChildren();
+				}
+			}
+		});
+
+	for (LLVOAvatar* avatar : avatars)
+	{
+		avatar->mSkeletonUpdateDeferred = false;
+		if (!avatar->isDead())
+		{
+			avatar->idleUpdateFinish(agent, avatar->mDeferredDetailedUpdate);
+		}
+	}
+}
+
 void LLVOAvatar::idleUpdateVoiceVisualizer(bool voice_enabled)
 {
 	bool render_visualizer = voice_enabled;
@@ -4926,7 +4990,15 @@ bool LLVOAvatar::updateCharacter(LLAgent &agent)
     updateFootstepSounds();
 
 	// Update child joints as needed.
-	mRoot->updateWorldMatrixChildren();
+	if (sDeferSkeletonUpdates && !isSelf())
+	{
+		mSkeletonUpdateDeferred = true;
+		sDeferredSkeletons.push_back(this);
+	}
+	else
+	{
+		mRoot->updateWorldMatrixChildren();
+	}
 
     if (visible)
     {
@@ -298,6 +298,20 @@ class LLVOAvatar :
 	void			idleUpdateNameTagText(bool new_name);
 	void			idleUpdateNameTagPosition(const LLVector3& root_pos_last);
 	void			idleUpdateNameTagAlpha(bool new_name, F32 alpha);
+
+	// Between these two calls, other avatars leave their skeleton world
+	// matrices and the rest of idleUpdate() for finishDeferredIdleUpdates(),
+	// which updates the skeletons in parallel on the General pool.
+	static void		beginDeferredIdleUpdates();
+	static void		finishDeferredIdleUpdates(LLAgent &agent);
+private:
+	void			idleUpdateFinish(LLAgent &agent, BOOL detailed_update);
+
+	static bool		sDeferSkeletonUpdates;
+	static std::vector<LLPointer<LLVOAvatar> > sDeferredSkeletons;
+	bool			mSkeletonUpdateDeferred;
+	BOOL			mDeferredDetailedUpdate;
+public:
 	LLColor4		getNameTagColor(bool is_friend);
 	void			clearNameTag();
 	static void		invalidateNameTag(const LLUUID& agent_id);
@@ -162,6 +162,7 @@ LLVOCacheEntry::LLVOCacheEntry(U32 local_id, U32 crc, LLDataPackerBinaryBuffer &
 	mState(INACTIVE),
 	mSceneContrib(0.f),
 	mValid(TRUE),
+	mDirty(true),
 	mParentID(0),
 	mBSphereRadius(-1.0f)
 {
@@ -182,6 +183,7 @@ LLVOCacheEntry::LLVOCacheEntry()
 	mState(INACTIVE),
 	mSceneContrib(0.f),
 	mValid(TRUE),
+	mDirty(false),
 	mParentID(0),
 	mBSphereRadius(-1.0f)
 {
@@ -195,6 +197,7 @@ LLVOCacheEntry::LLVOCacheEntry(LLAPRFile* apr_file)
 	mState(INACTIVE),
 	mSceneContrib(0.f),
 	mValid(FALSE),
+	mDirty(false),
 	mParentID(0),
 	mBSphereRadius(-1.0f)
 {
@@ -253,6 +256,47 @@ LLVOCacheEntry::LLVOCacheEntry(LLAPRFile* apr_file)
 	}
 }
 
+// Reads a record written by writeToBuffer()
+LLVOCacheEntry::LLVOCacheEntry(const U8* data_buffer, S32 data_size)
+:	LLViewerOctreeEntryData(LLViewerOctreeEntry::LLVOCACHEENTRY),
+	mLocalID(0),
+	mCRC(0),
+	mUpdateFlags(-1),
+	mHitCount(0),
+	mDupeCount(0),
+	mCRCChangeCount(0),
+	mBuffer(NULL),
+	mState(INACTIVE),
+	mSceneContrib(0.f),
+	mValid(FALSE),
+	mDirty(false),
+	mParentID(0),
+	mBSphereRadius(-1.0f)
+{
+	mDP.assignBuffer(mBuffer, 0);
+
+	S32 size = -1;
+	if (data_buffer && data_size > ENTRY_HEADER_SIZE)
+	{
+		memcpy(&size, data_buffer + (5 * sizeof(U32)), sizeof(S32));
+	}
+	if (size < 1 || size > MAX_ENTRY_BODY_SIZE || size > data_size - ENTRY_HEADER_SIZE)
+	{
+		LL_WARNS() << "Bogus cache entry, size " << size << LL_ENDL;
+		return;
+	}
+
+	memcpy(&mLocalID, data_buffer, sizeof(U32));
+	memcpy(&mCRC, data_buffer + sizeof(U32), sizeof(U32));
+	memcpy(&mHitCount, data_buffer + (2 * sizeof(U32)), sizeof(S32));
+	memcpy(&mDupeCount, data_buffer + (3 * sizeof(U32)), sizeof(S32));
+	memcpy(&mCRCChangeCount, data_buffer + (4 * sizeof(U32)), sizeof(S32));
+
+	mBuffer = new U8[size];
+	memcpy(mBuffer, data_buffer + ENTRY_HEADER_SIZE, size);
+	mDP.assignBuffer(mBuffer, size);
+}
+
 LLVOCacheEntry::~LLVOCacheEntry()
 {
 	mDP.freeBuffer();
@@ -267,6 +311,7 @@ void LLVOCacheEntry::updateEntry(U32 crc, LLDataPackerBinaryBuffer &dp)
 	}
 
 	mDP.freeBuffer();
+	mDirty = true;
 
 	llassert_always(dp.getBufferSize() > 0);
 	mBuffer = new U8[dp.getBufferSize()];
@@ -425,6 +470,19 @@ void LLVOCacheEntry::dump() const
 }
 
 S32 LLVOCacheEntry::writeToBuffer(U8 *data_buffer) const
+{
+    S32 size = writeHeaderToBuffer(data_buffer);
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    memcpy(data_buffer + ENTRY_HEADER_SIZE, (void*)mBuffer, size - ENTRY_HEADER_SIZE);
+
+    return size;
+}
+
+S32 LLVOCacheEntry::writeHeaderToBuffer(U8 *data_buffer) const
 {
     S32 size = mDP.getBufferSize();
 
@@ -440,7 +498,6 @@ S32 LLVOCacheEntry::writeToBuffer(U8 *data_buffer) const
     memcpy(data_buffer + (3 * sizeof(U32)), &mDupeCount, sizeof(S32));
     memcpy(data_buffer + (4 * sizeof(U32)), &mCRCChangeCount, sizeof(S32));
     memcpy(data_buffer + (5 * sizeof(U32)), &size, sizeof(S32));
-    memcpy(data_buffer + ENTRY_HEADER_SIZE, (void*)mBuffer, size);
 
     return ENTRY_HEADER_SIZE + size;
 }
@@ -1110,6 +1167,7 @@ void LLVOCachePartition::removeOccluder(LLVOCacheGroup* group)
 // Format strings used to construct filename for the object cache
 static const char OBJECT_CACHE_FILENAME[] = "objects_%d_%d.slc";
 static const char OBJECT_CACHE_EXTRAS_FILENAME[] = "objects_%d_%d_extras.slec";
+static const char OBJECT_CACHE_MAPPED_FILENAME[] = "objects_%d_%d.slcm";
 
 const U32 MAX_NUM_OBJECT_ENTRIES = 128 ;
 const U32 MIN_ENTRIES_TO_PURGE = 16 ;
@@ -1123,10 +1181,12 @@ LLVOCache::LLVOCache(bool read_only) :
 	mReadOnly(read_only),
 	mNumEntries(0),
 	mCacheSize(1),
-    mEnabled(true)
+    mEnabled(true),
+	mMappedRegions(false)
 {
 #ifndef LL_TEST
 	mEnabled = gSavedSettings.getBOOL("ObjectCacheEnabled");
+	mMappedRegions = gSavedSettings.getBOOL("AlchemyObjectCacheMapped");
 #endif
 	mLocalAPRFilePoolp = new LLVolatileAPRPool("VOCache Pool") ;
 }
@@ -1214,6 +1274,8 @@ void LLVOCache::removeCache(ELLPath location, bool started)
 
 	LL_INFOS() << "about to remove the object cache due to settings." << LL_ENDL ;
 
+	mRegionFiles.clear();
+
 	std::string mask = "*";
 	std::string cache_dir = gDirUtilp->getExpandedFilename(location, object_cache_dirname);
 	LL_INFOS() << "Removing cache at " << cache_dir << LL_ENDL;
@@ -1238,6 +1300,8 @@ void LLVOCache::removeCache()
 		return ;
 	}
 
+	mRegionFiles.clear();
+
 	std::string mask = "*";
 	LL_INFOS() << "Removing object cache at " << mObjectCacheDirName << LL_ENDL;
 	gDirUtilp->deleteFilesInDir(mObjectCacheDirName, mask); 
@@ -1283,6 +1347,8 @@ void LLVOCache::removeEntry(U64 handle)
 
 void LLVOCache::clearCacheInMemory()
 {
+	mRegionFiles.clear();
+
 	if(!mHeaderEntryQueue.empty()) 
 	{
 		for(header_entry_queue_t::iterator iter = mHeaderEntryQueue.begin(); iter != mHeaderEntryQueue.end(); ++iter)
@@ -1316,6 +1382,15 @@ std::string LLVOCache::getObjectCacheExtrasFilename(U64 handle)
                llformat(OBJECT_CACHE_EXTRAS_FILENAME, region_x, region_y));
 }
 
+std::string LLVOCache::getObjectCacheMappedFilename(U64 handle)
+{
+	U32 region_x, region_y;
+
+	grid_from_region_handle(handle, &region_x, &region_y);
+	return gDirUtilp->getExpandedFilename(LL_PATH_CACHE, object_cache_dirname,
+			   llformat(OBJECT_CACHE_MAPPED_FILENAME, region_x, region_y));
+}
+
 void LLVOCache::removeFromCache(HeaderEntryInfo* entry)
 {
 	if(mReadOnly)
@@ -1324,6 +1399,9 @@ void LLVOCache::removeFromCache(HeaderEntryInfo* entry)
 		return ;
 	}
 
+	mRegionFiles.erase(entry->mHandle);
+	LLFile::remove(getObjectCacheMappedFilename(entry->mHandle), ENOENT);
+
 	std::string filename;
 	getObjectCacheFilename(entry->mHandle, filename);
 	LLAPRFile::remove(filename, mLocalAPRFilePoolp);
@@ -1490,6 +1568,17 @@ void LLVOCache::readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::voca
 		return ;
 	}
 
+	if (mMappedRegions)
+	{
+		LLVOCacheRegionFile* file = openRegionFile(handle, id);
+		if (file && file->getNumEntries() > 0)
+		{
+			// Entries are read as the region asks for them, see readEntry()
+			return;
+		}
+		// Otherwise the region may still have a cache in the old format
+	}
+
 	bool success = true ;
 	{
 		std::string filename;
@@ -1541,6 +1630,102 @@ void LLVOCache::readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::voca
 	return ;
 }
 
+LLVOCacheRegionFile* LLVOCache::openRegionFile(U64 handle, const LLUUID& id)
+{
+	std::unique_ptr<LLVOCacheRegionFile> file(new LLVOCacheRegionFile());
+	if (!file->open(getObjectCacheMappedFilename(handle), id, mMetaInfo.mVersion, mReadOnly))
+	{
+		mRegionFiles.erase(handle);
+		return NULL;
+	}
+
+	LLVOCacheRegionFile* filep = file.get();
+	mRegionFiles[handle] = std::move(file);
+	return filep;
+}
+
+void LLVOCache::closeRegionFile(U64 handle)
+{
+	mRegionFiles.erase(handle);
+}
+
+U32 LLVOCache::getNumStoredEntries(U64 handle) const
+{
+	region_file_map_t::const_iterator iter = mRegionFiles.find(handle);
+	return iter != mRegionFiles.end() ? iter->second->getNumEntries() : 0;
+}
+
+LLPointer<LLVOCacheEntry> LLVOCache::readEntry(U64 handle, U32 local_id)
+{
+	region_file_map_t::iterator iter = mRegionFiles.find(handle);
+	if (iter == mRegionFiles.end())
+	{
+		return NULL;
+	}
+
+	S32 size = 0;
+	const U8* data = iter->second->find(local_id, size);
+	if (!data)
+	{
+		return NULL;
+	}
+
+	LLPointer<LLVOCacheEntry> entry = new LLVOCacheEntry(data, size);
+	if (entry->getLocalID() != local_id)
+	{
+		LL_WARNS() << "Dropping corrupted cache entry " << local_id << " of region " << handle << LL_ENDL;
+		iter->second->erase(local_id);
+		return NULL;
+	}
+	return entry;
+}
+
+// Only writes the entries that changed since they were read
+bool LLVOCache::writeToRegionFile(LLVOCacheRegionFile& file, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, bool removal_enabled)
+{
+	U8 data_buffer[ENTRY_HEADER_SIZE + MAX_ENTRY_BODY_SIZE];
+	for (LLVOCacheEntry::vocache_entry_map_t::const_iterator iter = cache_entry_map.begin(); iter != cache_entry_map.end(); ++iter)
+	{
+		const LLVOCacheEntry* entry = iter->second;
+		if (removal_enabled && !entry->isValid())
+		{
+			file.erase(iter->first);
+			continue;
+		}
+
+		S32 stored_size = 0;
+		if (!entry->isDirty() && file.find(iter->first, stored_size))
+		{
+			// Only the hit counts can have changed
+			if (entry->writeHeaderToBuffer(data_buffer) == stored_size
+				&& file.patch(iter->first, data_buffer, ENTRY_HEADER_SIZE))
+			{
+				continue;
+			}
+		}
+
+		S32 size = entry->writeToBuffer(data_buffer);
+		if (size <= ENTRY_HEADER_SIZE || !file.write(iter->first, data_buffer, size))
+		{
+			return false;
+		}
+	}
+
+	if (removal_enabled)
+	{
+		// Entries never asked for during the visit are not valid either
+		file.retain([&cache_entry_map](U32 local_id)
+					{
+						LLVOCacheEntry::vocache_entry_map_t::const_iterator iter = cache_entry_map.find(local_id);
+						return iter != cache_entry_map.end() && iter->second->isValid();
+					});
+	}
+
+	file.compact();
+	file.flush();
+	return true;
+}
+
 void LLVOCache::readGenericExtrasFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_gltf_overrides_map_t& cache_extras_entry_map)
 {
     if(!mEnabled)
@@ -1641,6 +1826,15 @@ void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry:
 	}
 	llassert_always(mInitialized);
 
+	// The region is done with its file, which closes on the way out
+	std::unique_ptr<LLVOCacheRegionFile> region_file;
+	region_file_map_t::iterator file_iter = mRegionFiles.find(handle);
+	if (file_iter != mRegionFiles.end())
+	{
+		region_file = std::move(file_iter->second);
+		mRegionFiles.erase(file_iter);
+	}
+
 	if(mReadOnly)
 	{
 		LL_WARNS() << "Not writing cache for handle " << handle << "): Cache is currently in read-only mode." << LL_ENDL;
@@ -1688,6 +1882,37 @@ void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry:
 		return ; //nothing changed, no need to update.
 	}
 
+	if (mMappedRegions)
+	{
+		if (!region_file)
+		{
+			region_file.reset(new LLVOCacheRegionFile());
+			if (!region_file->open(getObjectCacheMappedFilename(handle), id, mMetaInfo.mVersion, false))
+			{
+				region_file.reset();
+			}
+		}
+		if (region_file)
+		{
+			const bool written = writeToRegionFile(*region_file, cache_entry_map, removal_enabled);
+			region_file.reset();
+			if (written)
+			{
+				// Superseded by the mapped file
+				std::string filename;
+				getObjectCacheFilename(handle, filename);
+				LLFile::remove(filename, ENOENT);
+			}
+			else
+			{
+				LL_WARNS() << "Failed to write object cache file of handle " << handle << LL_ENDL;
+				removeEntry(entry);
+			}
+			return;
+		}
+		// Fall back to the old format
+	}
+
 	//write to cache file
 	bool success = true ;
 	{
@@ -33,6 +33,7 @@
 #include "llvieweroctree.h"
 #include "llapr.h"
 #include "llgltfmaterial.h"
+#include "llvocacheregionfile.h"
 
 #include <unordered_map>
 
@@ -107,6 +108,7 @@ class LLVOCacheEntry final
 public:
 	LLVOCacheEntry(U32 local_id, U32 crc, LLDataPackerBinaryBuffer &dp);
 	LLVOCacheEntry(LLAPRFile* apr_file);
+	LLVOCacheEntry(const U8* data_buffer, S32 data_size);
 	LLVOCacheEntry();	
 
 	void updateEntry(U32 crc, LLDataPackerBinaryBuffer &dp);
@@ -130,6 +132,8 @@ class LLVOCacheEntry final
 
 	void dump() const;
 	S32 writeToBuffer(U8 *data_buffer) const;
+	// Only the fixed size part, returns the size of the whole record
+	S32 writeHeaderToBuffer(U8 *data_buffer) const;
 	LLDataPackerBinaryBuffer *getDP() const;
 	void recordHit();
 	void recordDupe() { mDupeCount++; }
@@ -153,6 +157,9 @@ class LLVOCacheEntry final
 	void setValid(BOOL valid = TRUE) {mValid = valid;}
 	BOOL isValid() const {return mValid;}
 
+	// Set when the object data changed since the entry was read from the cache
+	bool isDirty() const {return mDirty;}
+
 	void setUpdateFlags(U32 flags) {mUpdateFlags = flags;}
 	U32  getUpdateFlags() const    {return mUpdateFlags;}
 
@@ -191,6 +198,7 @@ class LLVOCacheEntry final
 	vocache_entry_set_t         mChildrenList; //children entries in a linked set.
 
 	BOOL                        mValid; //if set, this entry is valid, otherwise it is invalid and will be removed.
+	bool                        mDirty; //object data not in the cache file yet.
 
 	LLVector4a                  mBSphereCenter; //bounding sphere center
 	F32                         mBSphereRadius; //bounding sphere radius
@@ -301,6 +309,13 @@ class LLVOCache final : public LLParamSingleton<LLVOCache>
     void writeGenericExtrasToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry::vocache_gltf_overrides_map_t& cache_extras_entry_map, BOOL dirty_cache, bool removal_enabled);
 	void removeEntry(U64 handle) ;
 
+	// With AlchemyObjectCacheMapped, readFromCache() leaves the entries of
+	// a region in its mapped cache file, to be read one at a time as the
+	// region asks for them, until writeToCache() or closeRegionFile().
+	LLPointer<LLVOCacheEntry> readEntry(U64 handle, U32 local_id);
+	U32 getNumStoredEntries(U64 handle) const;
+	void closeRegionFile(U64 handle);
+
 	U32 getCacheEntries() { return mNumEntries; }
 	U32 getCacheEntriesMax() { return mCacheSize; }
 
@@ -309,6 +324,9 @@ class LLVOCache final : public LLParamSingleton<LLVOCache>
 	// determine the cache filename for the region from the region handle	
 	void getObjectCacheFilename(U64 handle, std::string& filename);
     std::string getObjectCacheExtrasFilename(U64 handle);
+	std::string getObjectCacheMappedFilename(U64 handle);
+	LLVOCacheRegionFile* openRegionFile(U64 handle, const LLUUID& id);
+	bool writeToRegionFile(LLVOCacheRegionFile& file, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, bool removal_enabled);
 	void removeFromCache(HeaderEntryInfo* entry);
 	void readCacheHeader();
 	void writeCacheHeader();
@@ -322,6 +340,7 @@ class LLVOCache final : public LLParamSingleton<LLVOCache>
 	bool                 mEnabled;
 	bool                 mInitialized ;
 	bool                 mReadOnly ;
+	bool                 mMappedRegions;
 	HeaderMetaInfo       mMetaInfo;
 	U32                  mCacheSize;
 	U32                  mNumEntries;
@@ -330,6 +349,9 @@ class LLVOCache final : public LLParamSingleton<LLVOCache>
 	LLVolatileAPRPool*   mLocalAPRFilePoolp ; 	
 	header_entry_queue_t mHeaderEntryQueue;
 	handle_entry_map_t   mHandleEntryMap;	
+
+	typedef std::map<U64, std::unique_ptr<LLVOCacheRegionFile> > region_file_map_t;
+	region_file_map_t    mRegionFiles; // regions being visited
 };
 
 #endif
@@ -0,0 +1,402 @@
+/**
+ * @file llvocacheregionfile.cpp
+ * @brief Memory mapped object cache file of one region.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llvocacheregionfile.h"
+
+#include "llfile.h"
+
+static const char REGION_FILE_MAGIC[4] = { 'S', 'L', 'C', 'M' };
+static const U32 REGION_FILE_VERSION = 1;
+static const U32 MIN_INDEX_CAPACITY = 1024;
+static const U64 MIN_DATA_CAPACITY = 256 * 1024;
+static const U64 MIN_DEAD_BYTES_TO_COMPACT = 64 * 1024;
+
+struct LLVOCacheRegionFile::Header
+{
+	char mMagic[4];
+	U32 mFormatVersion;
+	U32 mCacheVersion;
+	U32 mIndexCapacity; // power of two
+	U8 mRegionCacheID[UUID_BYTES];
+	U32 mCount; // live records
+	U32 mUsed; // index slots taken, erased ones included
+	U64 mDataEnd; // where the next record goes
+	U64 mDeadBytes; // replaced and erased records
+	U8 mPad[8];
+};
+
+struct LLVOCacheRegionFile::IndexSlot
+{
+	U32 mLocalID; // 0 if never used
+	U32 mSize; // 0 if erased
+	U64 mOffset; // in the data, after the index
+};
+
+LLVOCacheRegionFile::LLVOCacheRegionFile()
+	: mHeader(NULL),
+	  mCacheVersion(0)
+{
+	static_assert(sizeof(Header) == 64, "unexpected region file header layout");
+	static_assert(sizeof(IndexSlot) == 16, "unexpected region file index layout");
+}
+
+LLVOCacheRegionFile::~LLVOCacheRegionFile()
+{
+	close();
+}
+
+bool LLVOCacheRegionFile::open(const std::string& filename, const LLUUID& region_cache_id, U32 cache_version, bool read_only)
+{
+	close();
+	mFilename = filename;
+	mRegionCacheID = region_cache_id;
+	mCacheVersion = cache_version;
+
+	if (!LLFile::isfile(filename))
+	{
+		return !read_only && create(MIN_INDEX_CAPACITY, MIN_DATA_CAPACITY);
+	}
+
+	if (!mFile.open(filename, 0, read_only))
+	{
+		return false;
+	}
+
+	const Header* header = (const Header*)mFile.getData();
+	const size_t size = mFile.getSize();
+	bool valid = size >= sizeof(Header)
+		&& memcmp(header->mMagic, REGION_FILE_MAGIC, sizeof(REGION_FILE_MAGIC)) == 0
+		&& header->mFormatVersion == REGION_FILE_VERSION
+		&& header->mCacheVersion == cache_version
+		&& memcmp(header->mRegionCacheID, region_cache_id.mData, UUID_BYTES) == 0
+		&& header->mIndexCapacity >= MIN_INDEX_CAPACITY
+		&& (header->mIndexCapacity & (header->mIndexCapacity - 1)) == 0;
+	if (valid)
+	{
+		const U64 data_start = sizeof(Header) + (U64)header->mIndexCapacity * sizeof(IndexSlot);
+		valid = data_start <= size
+			&& header->mDataEnd <= size - data_start
+			&& header->mCount <= header->mUsed
+			&& header->mUsed <= header->mIndexCapacity;
+	}
+
+	if (!valid)
+	{
+		mFile.close();
+		if (read_only)
+		{
+			return false;
+		}
+		LL_INFOS() << "Starting over object cache file " << filename << LL_ENDL;
+		return create(MIN_INDEX_CAPACITY, MIN_DATA_CAPACITY);
+	}
+
+	mHeader = (Header*)mFile.getData();
+	return true;
+}
+
+void LLVOCacheRegionFile::close()
+{
+	mHeader = NULL;
+	mFile.close();
+}
+
+U32 LLVOCacheRegionFile::getNumEntries() const
+{
+	return mHeader ? mHeader->mCount : 0;
+}
+
+bool LLVOCacheRegionFile::create(U32 index_capacity, U64 data_capacity)
+{
+	close();
+	LLFile::remove(mFilename, ENOENT);
+
+	const U64 size = sizeof(Header) + (U64)index_capacity * sizeof(IndexSlot) + data_capacity;
+	if (!mFile.open(mFilename, (size_t)size))
+	{
+		return false;
+	}
+
+	// The file is zero filled, so is the index
+	Header* header = (Header*)mFile.getData();
+	memcpy(header->mMagic, REGION_FILE_MAGIC, sizeof(REGION_FILE_MAGIC));
+	header->mFormatVersion = REGION_FILE_VERSION;
+	header->mCacheVersion = mCacheVersion;
+	header->mIndexCapacity = index_capacity;
+	memcpy(header->mRegionCacheID, mRegionCacheID.mData, UUID_BYTES);
+	header->mCount = 0;
+	header->mUsed = 0;
+	header->mDataEnd = 0;
+	header->mDeadBytes = 0;
+	mHeader = header;
+	return true;
+}
+
+LLVOCacheRegionFile::IndexSlot* LLVOCacheRegionFile::getSlots() const
+{
+	return (IndexSlot*)(mFile.getData() + sizeof(Header));
+}
+
+U8* LLVOCacheRegionFile::getData() const
+{
+	return mFile.getData() + sizeof(Header) + (size_t)mHeader->mIndexCapacity * sizeof(IndexSlot);
+}
+
+// Index slot of local_id, erased or not, or -1
+S32 LLVOCacheRegionFile::findSlot(U32 local_id) const
+{
+	if (!mHeader || local_id == 0)
+	{
+		return -1;
+	}
+
+	const U32 mask = mHeader->mIndexCapacity - 1;
+	U32 h = local_id * 0x9e3779b1;
+	U32 slot = (h ^ (h >> 16)) & mask;
+	const IndexSlot* slots = getSlots();
+	for (U32 probe = 0; probe <= mask; ++probe)
+	{
+		if (slots[slot].mLocalID == local_id)
+		{
+			return (S32)slot;
+		}
+		if (slots[slot].mLocalID == 0)
+		{
+			break;
+		}
+		slot = (slot + 1) & mask;
+	}
+	return -1;
+}
+
+const U8* LLVOCacheRegionFile::find(U32 local_id, S32& size) const
+{
+	const S32 idx = findSlot(local_id);
+	if (idx < 0)
+	{
+		return NULL;
+	}
+
+	const IndexSlot& slot = getSlots()[idx];
+	if (slot.mSize == 0 || slot.mOffset + slot.mSize > mHeader->mDataEnd)
+	{
+		return NULL;
+	}
+	size = (S32)slot.mSize;
+	return getData() + slot.mOffset;
+}
+
+// Makes room for data_size more bytes of records, remapping the file
+bool LLVOCacheRegionFile::reserve(U64 data_size)
+{
+	const U64 data_start = sizeof(Header) + (U64)mHeader->mIndexCapacity * sizeof(IndexSlot);
+	const U64 needed = data_start + mHeader->mDataEnd + data_size;
+	if (needed <= mFile.getSize())
+	{
+		return true;
+	}
+
+	const U64 new_size = llmax(needed, (U64)mFile.getSize() * 2);
+	mHeader = NULL;
+	mFile.close();
+	if (!mFile.open(mFilename, (size_t)new_size))
+	{
+		LL_WARNS() << "Unable to grow object cache file " << mFilename << LL_ENDL;
+		return false;
+	}
+	mHeader = (Header*)mFile.getData();
+	return true;
+}
+
+bool LLVOCacheRegionFile::write(U32 local_id, const U8* data, S32 size)
+{
+	if (!mHeader || mFile.isReadOnly() || local_id == 0 || size <= 0)
+	{
+		return false;
+	}
+
+	S32 idx = findSlot(local_id);
+	if (idx < 0 && (mHeader->mUsed + 1) * 2 > mHeader->mIndexCapacity)
+	{
+		// Keep the index at most half full
+		if (!compact(true, mHeader->mIndexCapacity * 2))
+		{
+			return false;
+		}
+	}
+	if (!reserve(size))
+	{
+		return false;
+	}
+
+	// The record goes in first, then the index points at it
+	const U64 offset = mHeader->mDataEnd;
+	memcpy(getData() + offset, data, size);
+	mHeader->mDataEnd += size;
+
+	IndexSlot* slots = getSlots();
+	if (idx < 0)
+	{
+		const U32 mask = mHeader->mIndexCapacity - 1;
+		U32 h = local_id * 0x9e3779b1;
+		U32 slot = (h ^ (h >> 16)) & mask;
+		while (slots[slot].mLocalID != 0)
+		{
+			slot = (slot + 1) & mask;
+		}
+		idx = (S32)slot;
+		++mHeader->mUsed;
+	}
+
+	IndexSlot& slot = slots[idx];
+	if (slot.mSize > 0)
+	{
+		mHeader->mDeadBytes += slot.mSize;
+	}
+	else
+	{
+		++mHeader->mCount;
+	}
+	slot.mOffset = offset;
+	slot.mSize = (U32)size;
+	slot.mLocalID = local_id;
+	return true;
+}
+
+bool LLVOCacheRegionFile::patch(U32 local_id, const U8* data, S32 size)
+{
+	if (!mHeader || mFile.isReadOnly())
+	{
+		return false;
+	}
+
+	const S32 idx = findSlot(local_id);
+	if (idx < 0)
+	{
+		return false;
+	}
+	const IndexSlot& slot = getSlots()[idx];
+	if (size <= 0 || (U32)size > slot.mSize)
+	{
+		return false;
+	}
+	memcpy(getData() + slot.mOffset, data, size);
+	return true;
+}
+
+void LLVOCacheRegionFile::erase(U32 local_id)
+{
+	if (!mHeader || mFile.isReadOnly())
+	{
+		return;
+	}
+
+	const S32 idx = findSlot(local_id);
+	if (idx >= 0)
+	{
+		IndexSlot& slot = getSlots()[idx];
+		if (slot.mSize > 0)
+		{
+			// The slot stays taken so that probing goes on past it
+			mHeader->mDeadBytes += slot.mSize;
+			slot.mSize = 0;
+			--mHeader->mCount;
+		}
+	}
+}
+
+void LLVOCacheRegionFile::retain(const std::function<bool(U32 local_id)>& keep)
+{
+	if (!mHeader || mFile.isReadOnly())
+	{
+		return;
+	}
+
+	IndexSlot* slots = getSlots();
+	for (U32 i = 0; i < mHeader->mIndexCapacity; ++i)
+	{
+		IndexSlot& slot = slots[i];
+		if (slot.mLocalID != 0 && slot.mSize > 0 && !keep(slot.mLocalID))
+		{
+			mHeader->mDeadBytes += slot.mSize;
+			slot.mSize = 0;
+			--mHeader->mCount;
+		}
+	}
+}
+
+bool LLVOCacheRegionFile::compact(bool force, U32 index_capacity)
+{
+	if (!mHeader || mFile.isReadOnly())
+	{
+		return false;
+	}
+
+	if (!force && (mHeader->mDeadBytes < MIN_DEAD_BYTES_TO_COMPACT || mHeader->mDeadBytes * 2 < mHeader->mDataEnd))
+	{
+		return true;
+	}
+
+	U32 capacity = MIN_INDEX_CAPACITY;
+	while (capacity < index_capacity || capacity < mHeader->mCount * 4)
+	{
+		capacity <<= 1;
+	}
+	const U64 live_bytes = mHeader->mDataEnd - mHeader->mDeadBytes;
+
+	LLVOCacheRegionFile compacted;
+	compacted.mFilename = mFilename + ".tmp";
+	compacted.mRegionCacheID = mRegionCacheID;
+	compacted.mCacheVersion = mCacheVersion;
+	if (!compacted.create(capacity, llmax(live_bytes + live_bytes / 2, MIN_DATA_CAPACITY)))
+	{
+		return false;
+	}
+
+	const IndexSlot* slots = getSlots();
+	for (U32 i = 0; i < mHeader->mIndexCapacity; ++i)
+	{
+		const IndexSlot& slot = slots[i];
+		if (slot.mLocalID != 0 && slot.mSize > 0 && slot.mOffset + slot.mSize <= mHeader->mDataEnd
+			&& !compacted.write(slot.mLocalID, getData() + slot.mOffset, (S32)slot.mSize))
+		{
+			compacted.close();
+			LLFile::remove(compacted.mFilename, ENOENT);
+			return false;
+		}
+	}
+	compacted.close();
+
+	close();
+	LLFile::remove(mFilename, ENOENT);
+	if (LLFile::rename(compacted.mFilename, mFilename) != 0)
+	{
+		LLFile::remove(compacted.mFilename, ENOENT);
+		return false;
+	}
+	return open(mFilename, mRegionCacheID, mCacheVersion, false);
+}
@@ -0,0 +1,92 @@
+/**
+ * @file llvocacheregionfile.h
+ * @brief Memory mapped object cache file of one region.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLVOCACHEREGIONFILE_H
+#define LL_LLVOCACHEREGIONFILE_H
+
+#include "llmappedfile.h"
+#include "lluuid.h"
+
+#include <functional>
+
+// Object cache records of one region, keyed by local ID.
+//
+// The file starts with a header and an open addressed index of local IDs,
+// followed by the records, as written by LLVOCacheEntry::writeToBuffer(),
+// one after the other. A changed record is appended and its index slot
+// pointed at the new copy, so saving a region only writes what changed;
+// the space of replaced records is reclaimed by compact() once it makes
+// up half of the file.
+//
+// Not thread safe, like LLVOCache.
+class LLVOCacheRegionFile
+{
+public:
+	LLVOCacheRegionFile();
+	~LLVOCacheRegionFile();
+
+	// Maps filename, creating it if needed. A file of another format,
+	// cache version or region is started over, unless read_only.
+	bool open(const std::string& filename, const LLUUID& region_cache_id, U32 cache_version, bool read_only);
+	void close();
+	bool isOpen() const { return mHeader != NULL; }
+	bool flush() { return mFile.flush(); }
+
+	U32 getNumEntries() const;
+
+	// Returns the record stored for local_id, or NULL. Only valid until
+	// the next change to the file.
+	const U8* find(U32 local_id, S32& size) const;
+
+	// Stores the record of local_id, replacing what was there
+	bool write(U32 local_id, const U8* data, S32 size);
+	// Overwrites the start of the record of local_id
+	bool patch(U32 local_id, const U8* data, S32 size);
+	void erase(U32 local_id);
+	// Erases the records keep() returns false for
+	void retain(const std::function<bool(U32 local_id)>& keep);
+
+	// Rewrites the file without the replaced records if they take up too
+	// much of it, or with a bigger index.
+	bool compact(bool force = false, U32 index_capacity = 0);
+
+private:
+	struct Header;
+	struct IndexSlot;
+
+	IndexSlot* getSlots() const;
+	U8* getData() const;
+	S32 findSlot(U32 local_id) const;
+	bool reserve(U64 data_size);
+	bool create(U32 index_capacity, U64 data_capacity);
+
+	LLMappedFile mFile;
+	Header* mHeader;
+	std::string mFilename;
+	LLUUID mRegionCacheID;
+	U32 mCacheVersion;
+};
+
+#endif // LL_LLVOCACHEREGIONFILE_H
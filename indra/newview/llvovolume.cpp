@@ -55,6 +55,7 @@
 #include "llspatialpartition.h"
 #include "llhudmanager.h"
 #include "llflexibleobject.h"
+#include "llskinningkernel.h"
 #include "llskinningutil.h"
 #include "llsky.h"
 #include "lltexturefetch.h"
@@ -91,6 +92,7 @@
 #include "llavatarappearancedefines.h"
 #include "llgltfmateriallist.h"
 #include "lltoolmgr.h"
+#include "llparallelfor.h"
 // [RLVa:KB] - Checked: RLVa-2.0.0
 #include "rlvactions.h"
 #include "rlvlocks.h"
@@ -614,9 +616,18 @@ void LLVOVolume::animateTextures()
 {
 	if (!mDead)
 	{
-        shrinkWrap();
 		F32 off_s = 0.f, off_t = 0.f, scale_s = 1.f, scale_t = 1.f, rot = 0.f;
 		S32 result = mTextureAnimp->animateTextures(off_s, off_t, scale_s, scale_t, rot);
+		applyTextureAnim(result, off_s, off_t, scale_s, scale_t, rot);
+	}
+}
+
+// Applies a frame LLViewerTextureAnim::animateTextures() worked out to the faces
+void LLVOVolume::applyTextureAnim(S32 result, F32 off_s, F32 off_t, F32 scale_s, F32 scale_t, F32 rot)
+{
+	if (!mDead)
+	{
+        shrinkWrap();
 	
 		if (result)
 		{
@@ -4923,17 +4934,20 @@ void LLRiggedVolume::update(
     }
 
 
-	//build matrix palette
+	//build matrix palette, shared with the GPU skinning path for this frame,
+	//with the bind shape folded into every joint
 	static const size_t kMaxJoints = LL_MAX_JOINTS_PER_MESH_OBJECT;
 
 	LLMatrix4a mat[kMaxJoints];
-	U32 maxJoints = LLSkinningUtil::getMeshJointCount(skin);
-    LLSkinningUtil::initSkinningMatrixPalette(mat, maxJoints, skin, avatar);
-    const LLMatrix4a bind_shape_matrix = skin->mBindShapeMatrix;
+	const LLVOAvatar::MatrixPaletteCache& palette = avatar->updateSkinInfoMatrixPalette(skin);
+	U32 maxJoints = (U32)palette.mMatrixPalette.size();
+	LLSkinningKernel::mulPalette(mat, palette.mMatrixPalette.data(), skin->mBindShapeMatrix, maxJoints);
 
     S32 rigged_vert_count = 0;
     S32 rigged_face_count = 0;
     LLVector4a box_min, box_max;
+    box_min.clear();
+    box_max.clear();
     S32 face_begin;
     S32 face_end;
     if (face_index == DO_NOT_UPDATE_FACES)
@@ -4965,45 +4979,25 @@ void LLRiggedVolume::update(
 
 			LLVector4a* pos = dst_face.mPositions;
 
-			if (pos && dst_face.mExtents)
+			if (pos && dst_face.mExtents && dst_face.mNumVertices > 0 && maxJoints > 0)
 			{
                 rigged_vert_count += dst_face.mNumVertices;
                 rigged_face_count++;
 
-                {
-				    for (U32 j = 0; j < dst_face.mNumVertices; ++j)
-				    {
-					    LLMatrix4a final_mat;
-                        LLSkinningUtil::getPerVertexSkinMatrixUnchecked(weight[j], mat, final_mat);
-				
-					    LLVector4a& v = vol_face.mPositions[j];
-					    LLVector4a t;
-					    LLVector4a dst;
-					    bind_shape_matrix.affineTransform(v, t);
-					    final_mat.affineTransform(t, dst);
-					    pos[j] = dst;
-				    }
-                }
-
-				//update bounding box
+				//skin and update bounding box
 				// VFExtents change
 				LLVector4a& min = dst_face.mExtents[0];
 				LLVector4a& max = dst_face.mExtents[1];
 
-				min = pos[0];
-				max = pos[1];
-                if (i==0)
+				LLSkinningKernel::skinPositions(mat, maxJoints, weight, vol_face.mPositions, pos,
+												dst_face.mNumVertices, min, max);
+
+                if (rigged_face_count == 1)
                 {
                     box_min = min;
                     box_max = max;
                 }
 
-				for (U32 j = 1; j < dst_face.mNumVertices; ++j)
-				{
-					min.setMin(min, pos[j]);
-					max.setMax(max, pos[j]);
-				}
-
                 box_min.setMin(min,box_min);
                 box_max.setMax(max,box_max);
 
@@ -5144,6 +5138,9 @@ LLFace** LLVolumeGeometryManager::sSpecFaces[2] = { NULL };
 LLFace** LLVolumeGeometryManager::sNormSpecFaces[2] = { NULL };
 LLFace** LLVolumeGeometryManager::sPbrFaces[2] = { NULL };
 LLFace** LLVolumeGeometryManager::sAlphaFaces[2] = { NULL };
+bool LLVolumeGeometryManager::sDeferFill = false;
+std::vector<LLVolumeGeometryManager::FaceFill> LLVolumeGeometryManager::sFaceFills;
+std::vector<LLVolumeGeometryManager::BufferFill> LLVolumeGeometryManager::sBufferFills;
 
 LLVolumeGeometryManager::LLVolumeGeometryManager()
 	: LLGeometryManager()
@@ -5980,6 +5977,10 @@ void LLVolumeGeometryManager::rebuildGeom(LLSpatialGroup* group)
 
 	U32 geometryBytes = 0;
 
+    // leave the vertex fill to fillBuffers()
+    static LLCachedControl<bool> threaded_fill(gSavedSettings, "AlchemyThreadedGeometryFill", true);
+    sDeferFill = threaded_fill;
+
     // generate render batches for static geometry
     U32 extra_mask = LLVertexBuffer::MAP_TEXTURE_INDEX;
     BOOL alpha_sort = TRUE;
@@ -6000,6 +6001,12 @@ void LLVolumeGeometryManager::rebuildGeom(LLSpatialGroup* group)
         rigged = TRUE;
     }
 
+    if (sDeferFill)
+    {
+        fillBuffers();
+        sDeferFill = false;
+    }
+
 	group->mGeometryBytes = geometryBytes;
 
 	{
@@ -6111,6 +6118,45 @@ void LLVolumeGeometryManager::rebuildMesh(LLSpatialGroup* group)
 	} 
 }
 
+void LLVolumeGeometryManager::fillBuffers()
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_VOLUME;
+
+	for (const BufferFill& fill : sBufferFills)
+	{
+		fill.mBuffer->mapAll();
+	}
+
+	LL::parallelFor("General", sBufferFills.size(), 1,
+					[](size_t begin, size_t end)
+					{
+						for (size_t i = begin; i < end; ++i)
+						{
+							const BufferFill& fill = sBufferFills[i];
+							for (U32 j = fill.mFirst; j < fill.mFirst + fill.mCount; ++j)
+							{
+								const FaceFill& face = sFaceFills[j];
+								if (!face.mFace->getGeometryVolume(*face.mVolume, face.mTEOffset,
+									face.mVertXform, face.mNormXform, face.mIndexOffset, true))
+								{
+									LL_WARNS() << "Failed to get geometry for face!" << LL_ENDL;
+								}
+							}
+						}
+					});
+
+	{
+        LL_PROFILE_ZONE_NAMED_CATEGORY_VOLUME("fillBuffers - upload");
+		for (const BufferFill& fill : sBufferFills)
+		{
+			fill.mBuffer->unmapBuffer();
+		}
+	}
+
+	sBufferFills.clear();
+	sFaceFills.clear();
+}
+
 struct CompareBatchBreaker
 {
 	bool operator()(const LLFace* const& lhs, const LLFace* const& rhs)
@@ -6441,7 +6487,13 @@ U32 LLVolumeGeometryManager::genDrawInfo(LLSpatialGroup* group, U32 mask, LLFace
 
 					U32 te_idx = facep->getTEOffset();
 
-					if (!facep->getGeometryVolume(*volume, te_idx, 
+					if (sDeferFill)
+					{
+						facep->prepareGeometryVolume(*volume, te_idx);
+						sFaceFills.push_back({ vobj->getRelativeXform(), vobj->getRelativeXformInvTrans(),
+											   facep, volume, (S32) te_idx, index_offset });
+					}
+					else if (!facep->getGeometryVolume(*volume, te_idx, 
 						vobj->getRelativeXform(), vobj->getRelativeXformInvTrans(), index_offset,true))
 					{
 						LL_WARNS() << "Failed to get geometry for face!" << LL_ENDL;
@@ -6800,7 +6852,15 @@ U32 LLVolumeGeometryManager::genDrawInfo(LLSpatialGroup* group, U32 mask, LLFace
 
 		if (buffer)
 		{
-			buffer->unmapBuffer();
+			if (sDeferFill)
+			{
+				const U32 last = sBufferFills.empty() ? 0 : sBufferFills.back().mFirst + sBufferFills.back().mCount;
+				sBufferFills.push_back({ buffer, last, (U32) sFaceFills.size() - last });
+			}
+			else
+			{
+				buffer->unmapBuffer();
+			}
 		}
 	}
 
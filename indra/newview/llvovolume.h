@@ -131,6 +131,7 @@ class LLVOVolume final : public LLViewerObject
 				void	deleteFaces();
 
 				void	animateTextures();
+				void	applyTextureAnim(S32 result, F32 off_s, F32 off_t, F32 scale_s, F32 scale_t, F32 rot);
 	
 	            BOOL    isVisible() const ;
 	BOOL isActive() const override;
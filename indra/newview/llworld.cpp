@@ -94,6 +94,9 @@ LLWorld::LLWorld() :
 	mLastPacketsIn(0),
 	mLastPacketsOut(0),
 	mLastPacketsLost(0),
+	mLastReceiveThreadWaits(0),
+	mLastSocketDrops(0),
+	mLastReceiveThreadAcks(0),
 	mSpaceTimeUSec(0)
 {
 	for (S32 i = 0; i < EDGE_WATER_OBJECTS_COUNT; i++)
@@ -835,6 +838,13 @@ void LLWorld::renderPropertyLines()
 }
 
 
+// Packet receive thread, see LLPacketReceiveThread
+static LLTrace::CountStatHandle<> sReceiveThreadWaits("receivethreadwaits", "Times the receive thread waited on a full queue, leaving packets in the socket");
+static LLTrace::CountStatHandle<> sSocketDrops("socketdrops", "Packets dropped by the OS with the socket buffer full");
+static LLTrace::CountStatHandle<> sReceiveThreadAcks("receivethreadacks", "Reliable packets acked by the receive thread");
+static LLTrace::SampleStatHandle<F64Milliseconds> sPacketQueueLatency("packetqueuelatency", "Mean time packets waited for the main thread");
+static LLTrace::SampleStatHandle<F64Milliseconds> sPacketQueueLatencyMax("packetqueuelatencymax", "Longest time a packet waited for the main thread");
+
 void LLWorld::updateNetStats()
 {
 	F64Bits bits;
@@ -861,6 +871,25 @@ void LLWorld::updateNetStats()
 	add(LLStatViewer::PACKETS_OUT, packets_out);
 	add(LLStatViewer::PACKETS_LOST, packets_lost);
 
+	LLPacketRing& packet_ring = gMessageSystem->mPacketRing;
+	if (packet_ring.isReceiveThreadRunning())
+	{
+		U64 waits = packet_ring.getReceiveThreadWaits();
+		U64 socket_drops = packet_ring.getSocketDrops();
+		U64 acks = packet_ring.getReceiveThreadAcks();
+		add(sReceiveThreadWaits, (F64)(waits - mLastReceiveThreadWaits));
+		add(sSocketDrops, (F64)(socket_drops - llmin(mLastSocketDrops, socket_drops)));
+		add(sReceiveThreadAcks, (F64)(acks - mLastReceiveThreadAcks));
+		mLastReceiveThreadWaits = waits;
+		mLastSocketDrops = socket_drops;
+		mLastReceiveThreadAcks = acks;
+
+		U64 mean_usec, max_usec;
+		packet_ring.getAndResetQueueLatency(mean_usec, max_usec);
+		sample(sPacketQueueLatency, F64Milliseconds(mean_usec / 1000.0));
+		sample(sPacketQueueLatencyMax, F64Milliseconds(max_usec / 1000.0));
+	}
+
 	F32 total_packets_in = LLViewerStats::instance().getRecording().getSum(LLStatViewer::PACKETS_IN);
 	if (total_packets_in > 0)
 	{
@@ -248,6 +248,9 @@ class LLWorld final : public LLSimpleton<LLWorld>
 	S32 mLastPacketsIn;
 	S32 mLastPacketsOut;
 	S32 mLastPacketsLost;
+	U64 mLastReceiveThreadWaits;
+	U64 mLastSocketDrops;
+	U64 mLastReceiveThreadAcks;
 	U32 mNumOfActiveCachedObjects;
 	U64MicrosecondsImplicit mSpaceTimeUSec;
 
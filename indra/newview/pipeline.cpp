@@ -2416,6 +2416,26 @@ void LLPipeline::updateCull(LLCamera& camera, LLCullResult& result)
 
 	sCull->clear();
 
+	// Walk the octrees on the pool first, the loop below replays the walks
+	static LLCachedControl<bool> parallel_cull(gSavedSettings, "AlchemyParallelCull", true);
+	const bool use_cull_set = parallel_cull;
+	if (use_cull_set)
+	{
+		mCullSet.clear();
+		for (LLViewerRegion* region : LLWorld::getInstance()->getRegionList())
+		{
+			for (U32 i = 0; i < LLViewerRegion::NUM_PARTITIONS; i++)
+			{
+				LLSpatialPartition* part = region->getSpatialPartition(i);
+				if (part && hasRenderType(part->mDrawableType))
+				{
+					mCullSet.add(part, camera);
+				}
+			}
+		}
+		mCullSet.record();
+	}
+
 	for (LLWorld::region_list_t::const_iterator iter = LLWorld::getInstance()->getRegionList().begin(); 
 			iter != LLWorld::getInstance()->getRegionList().end(); ++iter)
 	{
@@ -2428,7 +2448,14 @@ void LLPipeline::updateCull(LLCamera& camera, LLCullResult& result)
 			{
 				if (hasRenderType(part->mDrawableType))
 				{
-					part->cull(camera);
+					if (use_cull_set)
+					{
+						mCullSet.replay(part);
+					}
+					else
+					{
+						part->cull(camera);
+					}
 				}
 			}
 		}
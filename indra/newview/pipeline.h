@@ -782,6 +782,9 @@ class LLPipeline
 	LLDrawable::drawable_vector_t mMovedBridge;
 	LLDrawable::drawable_vector_t	mShiftList;
 
+	// octree walks of the current updateCull()
+	LLSpatialCullSet		mCullSet;
+
 	/////////////////////////////////////////////
 	//
 	//
@@ -0,0 +1,546 @@
+/**
+ * @file llinventorycache_test.cpp
+ * @brief Test and load time benchmark for LLInventoryCache.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llinventorycache.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/stream.hpp>
+
+#include "llsdserialize.h"
+#include "stringize.h"
+#include "workqueue.h"
+#include "../test/lltut.h"
+#include "../test/namedtempfile.h"
+
+//----------------------------------------------------------------------------
+// Mock objects for the dependencies of the code we're testing.  The cache
+// only needs the plain inventory values, the viewer overrides that follow
+// links or talk to the server are not exercised.
+LLViewerInventoryItem::LLViewerInventoryItem(const LLUUID& uuid, const LLUUID& parent_uuid,
+											 const LLPermissions& perm, const LLUUID& asset_uuid,
+											 LLAssetType::EType type, LLInventoryType::EType inv_type,
+											 const std::string& name, const std::string& desc,
+											 const LLSaleInfo& sale_info, U32 flags, time_t creation_date_utc)
+	: LLInventoryItem(uuid, parent_uuid, perm, asset_uuid, type, inv_type,
+					  name, desc, sale_info, flags, creation_date_utc),
+	  mIsComplete(true)
+{
+}
+LLViewerInventoryItem::LLViewerInventoryItem() : LLInventoryItem(), mIsComplete(false) {}
+LLViewerInventoryItem::~LLViewerInventoryItem() {}
+LLAssetType::EType LLViewerInventoryItem::getType() const { return LLInventoryItem::getType(); }
+const LLUUID& LLViewerInventoryItem::getAssetUUID() const { return LLInventoryItem::getAssetUUID(); }
+const LLUUID& LLViewerInventoryItem::getProtectedAssetUUID() const { return LLInventoryItem::getAssetUUID(); }
+const std::string& LLViewerInventoryItem::getName() const { return LLInventoryItem::getName(); }
+S32 LLViewerInventoryItem::getSortField() const { return 0; }
+void LLViewerInventoryItem::getSLURL() {}
+const LLPermissions& LLViewerInventoryItem::getPermissions() const { return LLInventoryItem::getPermissions(); }
+const bool LLViewerInventoryItem::getIsFullPerm() const { return false; }
+const LLUUID& LLViewerInventoryItem::getCreatorUUID() const { return LLInventoryItem::getCreatorUUID(); }
+const std::string& LLViewerInventoryItem::getDescription() const { return LLInventoryItem::getDescription(); }
+const LLSaleInfo& LLViewerInventoryItem::getSaleInfo() const { return LLInventoryItem::getSaleInfo(); }
+const LLUUID& LLViewerInventoryItem::getThumbnailUUID() const { return LLInventoryItem::getThumbnailUUID(); }
+LLInventoryType::EType LLViewerInventoryItem::getInventoryType() const { return LLInventoryItem::getInventoryType(); }
+bool LLViewerInventoryItem::isWearableType() const { return false; }
+LLWearableType::EType LLViewerInventoryItem::getWearableType() const { return LLWearableType::WT_INVALID; }
+bool LLViewerInventoryItem::isSettingsType() const { return false; }
+LLSettingsType::type_e LLViewerInventoryItem::getSettingsType() const { return LLSettingsType::ST_NONE; }
+U32 LLViewerInventoryItem::getFlags() const { return LLInventoryItem::getFlags(); }
+time_t LLViewerInventoryItem::getCreationDate() const { return LLInventoryItem::getCreationDate(); }
+U32 LLViewerInventoryItem::getCRC32() const { return LLInventoryItem::getCRC32(); }
+void LLViewerInventoryItem::copyItem(const LLInventoryItem* other) { LLInventoryItem::copyItem(other); }
+void LLViewerInventoryItem::updateParentOnServer(BOOL) const {}
+void LLViewerInventoryItem::updateServer(BOOL) const {}
+void LLViewerInventoryItem::packMessage(LLMessageSystem*) const {}
+BOOL LLViewerInventoryItem::unpackMessage(LLMessageSystem*, const char*, S32) { return FALSE; }
+BOOL LLViewerInventoryItem::unpackMessage(const LLSD&) { return FALSE; }
+BOOL LLViewerInventoryItem::importLegacyStream(std::istream&) { return FALSE; }
+void LLViewerInventoryItem::setTransactionID(const LLTransactionID&) {}
+
+LLViewerInventoryCategory::LLViewerInventoryCategory(const LLUUID& uuid, const LLUUID& parent_uuid,
+													 LLFolderType::EType pref, const std::string& name,
+													 const LLUUID& owner_id)
+	: LLInventoryCategory(uuid, parent_uuid, pref, name),
+	  mOwnerID(owner_id),
+	  mVersion(VERSION_UNKNOWN),
+	  mDescendentCount(DESCENDENT_COUNT_UNKNOWN),
+	  mFetching(FETCH_NONE)
+{
+}
+LLViewerInventoryCategory::~LLViewerInventoryCategory() {}
+S32 LLViewerInventoryCategory::getVersion() const { return mVersion; }
+void LLViewerInventoryCategory::setVersion(S32 version) { mVersion = version; }
+void LLViewerInventoryCategory::updateParentOnServer(BOOL) const {}
+void LLViewerInventoryCategory::updateServer(BOOL) const {}
+void LLViewerInventoryCategory::packMessage(LLMessageSystem*) const {}
+void LLViewerInventoryCategory::unpackMessage(LLMessageSystem*, const char*, S32) {}
+BOOL LLViewerInventoryCategory::unpackMessage(const LLSD&) { return FALSE; }
+
+namespace
+{
+	typedef LLInventoryCache::cat_array_t cat_array_t;
+	typedef LLInventoryCache::item_array_t item_array_t;
+	typedef LLInventoryCache::changed_items_t changed_items_t;
+
+	std::vector<char> readFile(const std::string& filename)
+	{
+		std::ifstream file(filename, std::ios::binary);
+		return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	void writeFile(const std::string& filename, const std::vector<char>& data)
+	{
+		std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+		file.write(data.data(), data.size());
+	}
+
+	// An inventory shaped like a real one: many items sharing a few names
+	// and descriptions
+	void makeInventory(U32 folder_count, U32 item_count, cat_array_t& categories, item_array_t& items)
+	{
+		const LLUUID owner_id = LLUUID::generateNewID();
+		for (U32 i = 0; i < folder_count; ++i)
+		{
+			LLPointer<LLViewerInventoryCategory> cat = new LLViewerInventoryCategory(
+				LLUUID::generateNewID(), i ? categories[0]->getUUID() : LLUUID::null,
+				i ? LLFolderType::FT_NONE : LLFolderType::FT_ROOT_INVENTORY,
+				llformat("Folder %u", i), owner_id);
+			cat->setVersion(i + 1);
+			if (i % 4 == 0)
+			{
+				cat->setThumbnailUUID(LLUUID::generateNewID());
+			}
+			categories.push_back(cat);
+		}
+
+		for (U32 i = 0; i < item_count; ++i)
+		{
+			LLPermissions perm;
+			perm.init(LLUUID::generateNewID(), owner_id, LLUUID::generateNewID(), LLUUID::null);
+			perm.initMasks(PERM_ALL, PERM_ALL, PERM_NONE, PERM_NONE, (i % 2) ? PERM_COPY : PERM_ALL);
+			perm.fix();
+			LLPointer<LLViewerInventoryItem> item = new LLViewerInventoryItem(
+				LLUUID::generateNewID(), categories[i % folder_count]->getUUID(), perm,
+				LLUUID::generateNewID(),
+				(i % 3) ? LLAssetType::AT_OBJECT : LLAssetType::AT_NOTECARD,
+				(i % 3) ? LLInventoryType::IT_OBJECT : LLInventoryType::IT_NOTECARD,
+				llformat("Item %u", i % 50), (i % 5) ? std::string() : "(No Description)",
+				LLSaleInfo((i % 7) ? LLSaleInfo::FS_NOT : LLSaleInfo::FS_COPY, S32(i % 7) * 10),
+				i % 11, (time_t)(1600000000 + i));
+			if (i % 10 == 0)
+			{
+				item->setThumbnailUUID(LLUUID::generateNewID());
+			}
+			items.push_back(item);
+		}
+	}
+}
+
+namespace tut
+{
+	struct inventorycache_data
+	{
+		inventorycache_data()
+			: mPath(NamedTempFile::temp_path("invcache").string())
+		{
+		}
+
+		~inventorycache_data()
+		{
+			boost::system::error_code ec;
+			boost::filesystem::remove(mPath, ec);
+		}
+
+		bool read(cat_array_t& categories, item_array_t& items, changed_items_t& cats_to_update,
+				  bool& is_cache_obsolete)
+		{
+			is_cache_obsolete = false;
+			return LLInventoryCache::read(mPath, categories, items, cats_to_update, is_cache_obsolete);
+		}
+
+		// Writes a small inventory and checks it is read back whole, so the
+		// rejection tests know what they broke
+		void writeValid()
+		{
+			cat_array_t categories;
+			item_array_t items;
+			makeInventory(3, 20, categories, items);
+			ensure("written", LLInventoryCache::write(mPath, *LLInventoryCache::snapshot(categories, items)));
+
+			cat_array_t read_categories;
+			item_array_t read_items;
+			changed_items_t cats_to_update;
+			bool is_cache_obsolete = true;
+			ensure("valid file read", read(read_categories, read_items, cats_to_update, is_cache_obsolete));
+			ensure("valid file current", !is_cache_obsolete);
+		}
+
+		std::string mPath;
+	};
+
+	typedef test_group<inventorycache_data> inventorycache_group;
+	typedef inventorycache_group::object inventorycache_object;
+	tut::inventorycache_group inventorycache_test_group("LLInventoryCache");
+
+	template<> template<>
+	void inventorycache_object::test<1>()
+	{
+		set_test_name("round trip");
+
+		cat_array_t categories;
+		item_array_t items;
+		makeInventory(5, 200, categories, items);
+
+		// not written: a folder whose contents are not known...
+		LLPointer<LLViewerInventoryCategory> unknown = new LLViewerInventoryCategory(
+			LLUUID::generateNewID(), categories[0]->getUUID(), LLFolderType::FT_NONE, "Unknown", LLUUID::null);
+		categories.push_back(unknown);
+		// ...not read back: an item with no id, and one of unknown type
+		// whose folder must be refetched instead
+		LLPointer<LLViewerInventoryItem> null_item = new LLViewerInventoryItem(
+			LLUUID::null, categories[1]->getUUID(), LLPermissions(), LLUUID::null, LLAssetType::AT_OBJECT,
+			LLInventoryType::IT_OBJECT, "Null", "", LLSaleInfo(), 0, 0);
+		LLPointer<LLViewerInventoryItem> unknown_item = new LLViewerInventoryItem(
+			LLUUID::generateNewID(), categories[2]->getUUID(), LLPermissions(), LLUUID::null, LLAssetType::AT_UNKNOWN,
+			LLInventoryType::IT_NONE, "Unknown", "", LLSaleInfo(), 0, 0);
+		items.push_back(null_item);
+		items.push_back(unknown_item);
+
+		ensure("written", LLInventoryCache::write(mPath, *LLInventoryCache::snapshot(categories, items)));
+
+		cat_array_t read_categories;
+		item_array_t read_items;
+		changed_items_t cats_to_update;
+		bool is_cache_obsolete = true;
+		ensure("read", read(read_categories, read_items, cats_to_update, is_cache_obsolete));
+		ensure("current", !is_cache_obsolete);
+
+		ensure_equals("categories with a version", read_categories.size(), (size_t)5);
+		for (size_t i = 0; i < read_categories.size(); ++i)
+		{
+			const LLViewerInventoryCategory* expected = categories[i];
+			const LLViewerInventoryCategory* cat = read_categories[i];
+			ensure_equals("category id", cat->getUUID(), expected->getUUID());
+			ensure_equals("category parent", cat->getParentUUID(), expected->getParentUUID());
+			ensure_equals("category owner", cat->getOwnerID(), expected->getOwnerID());
+			ensure_equals("category thumbnail", cat->getThumbnailUUID(), expected->getThumbnailUUID());
+			ensure_equals("category name", cat->getName(), expected->getName());
+			ensure_equals("category version", cat->getVersion(), expected->getVersion());
+			ensure_equals("category type", (S32)cat->getPreferredType(), (S32)expected->getPreferredType());
+		}
+
+		ensure_equals("items with an id and a type", read_items.size(), (size_t)200);
+		for (size_t i = 0; i < read_items.size(); ++i)
+		{
+			const LLViewerInventoryItem* expected = items[i];
+			const LLViewerInventoryItem* item = read_items[i];
+			ensure_equals("item id", item->getUUID(), expected->getUUID());
+			ensure_equals("item parent", item->getParentUUID(), expected->getParentUUID());
+			ensure_equals("item asset", item->getAssetUUID(), expected->getAssetUUID());
+			ensure_equals("item thumbnail", item->getThumbnailUUID(), expected->getThumbnailUUID());
+			ensure("item permissions", item->getPermissions() == expected->getPermissions());
+			ensure("item sale info", item->getSaleInfo() == expected->getSaleInfo());
+			ensure_equals("item name", item->getName(), expected->getName());
+			ensure_equals("item description", item->getDescription(), expected->getDescription());
+			ensure_equals("item type", (S32)item->getType(), (S32)expected->getType());
+			ensure_equals("item inventory type", (S32)item->getInventoryType(), (S32)expected->getInventoryType());
+			ensure_equals("item flags", item->getFlags(), expected->getFlags());
+			ensure_equals("item creation date", (S64)item->getCreationDate(), (S64)expected->getCreationDate());
+			ensure("details still to fetch", !item->isFinished());
+		}
+
+		ensure_equals("one folder to refetch", cats_to_update.size(), (size_t)1);
+		ensure("unknown item's folder refetched", cats_to_update.count(categories[2]->getUUID()) > 0);
+
+		// 50 names and a description shared by 200 items, the table holds
+		// each once
+		const size_t file_size = (size_t)boost::filesystem::file_size(mPath);
+		ensure("strings interned", file_size < 72 + 5 * 76 + 202 * 176 + 200 * 12);
+	}
+
+	template<> template<>
+	void inventorycache_object::test<2>()
+	{
+		set_test_name("truncated file rejected");
+
+		writeValid();
+		const std::vector<char> data = readFile(mPath);
+
+		// cut inside the records, inside the header, and one byte short
+		const size_t lengths[] = { data.size() / 2, 16, data.size() - 1, 0 };
+		for (size_t length : lengths)
+		{
+			writeFile(mPath, std::vector<char>(data.begin(), data.begin() + length));
+
+			cat_array_t categories;
+			item_array_t items;
+			changed_items_t cats_to_update;
+			bool is_cache_obsolete = false;
+			ensure(STRINGIZE("truncated to " << length << " not read"),
+				   !read(categories, items, cats_to_update, is_cache_obsolete));
+			ensure(STRINGIZE("truncated to " << length << " obsolete"), is_cache_obsolete);
+			ensure("nothing returned", categories.empty() && items.empty() && cats_to_update.empty());
+		}
+	}
+
+	template<> template<>
+	void inventorycache_object::test<3>()
+	{
+		set_test_name("bad checksum rejected");
+
+		writeValid();
+		const std::vector<char> data = readFile(mPath);
+
+		// a bit flipped in a record, and one in the string table
+		const size_t offsets[] = { 72 + 3 * 76 + 5, data.size() - 1 };
+		for (size_t offset : offsets)
+		{
+			std::vector<char> damaged = data;
+			damaged[offset] ^= 0x10;
+			writeFile(mPath, damaged);
+
+			cat_array_t categories;
+			item_array_t items;
+			changed_items_t cats_to_update;
+			bool is_cache_obsolete = false;
+			ensure(STRINGIZE("damaged at " << offset << " not read"),
+				   !read(categories, items, cats_to_update, is_cache_obsolete));
+			ensure(STRINGIZE("damaged at " << offset << " obsolete"), is_cache_obsolete);
+			ensure("nothing returned", categories.empty() && items.empty());
+		}
+
+		// a file from another version is obsolete too
+		std::vector<char> other_version = data;
+		other_version[8] ^= 0x7f;
+		writeFile(mPath, other_version);
+		cat_array_t categories;
+		item_array_t items;
+		changed_items_t cats_to_update;
+		bool is_cache_obsolete = false;
+		ensure("other version not read", !read(categories, items, cats_to_update, is_cache_obsolete));
+		ensure("other version obsolete", is_cache_obsolete);
+
+		// and no file at all is just a miss
+		boost::filesystem::remove(mPath);
+		is_cache_obsolete = false;
+		ensure("missing file not read", !read(categories, items, cats_to_update, is_cache_obsolete));
+		ensure("missing file not obsolete", !is_cache_obsolete);
+	}
+
+	template<> template<>
+	void inventorycache_object::test<4>()
+	{
+		set_test_name("superseded cache removed only once written");
+
+		cat_array_t categories;
+		item_array_t items;
+		makeInventory(2, 10, categories, items);
+		LLInventoryCache::snapshot_ptr_t snapshot = LLInventoryCache::snapshot(categories, items);
+
+		NamedTempFile legacy("invcache", "legacy", ".llsd.gz");
+		const std::string unwritable = (boost::filesystem::path(mPath) / "missing" / "inv.bin").string();
+		ensure("write to a missing directory fails", !LLInventoryCache::write(unwritable, *snapshot, legacy.getName()));
+		ensure("legacy cache kept", boost::filesystem::exists(legacy.getName()));
+
+		ensure("written", LLInventoryCache::write(mPath, *snapshot, legacy.getName()));
+		ensure("legacy cache removed", !boost::filesystem::exists(legacy.getName()));
+	}
+
+	template<> template<>
+	void inventorycache_object::test<5>()
+	{
+		set_test_name("background write falls back once the pool is closed");
+
+		cat_array_t categories;
+		item_array_t items;
+		makeInventory(2, 10, categories, items);
+
+		// As at logout: the General queue still exists but stopped taking
+		// work when the app stopped running
+		LL::WorkQueue general("General");
+		general.close();
+		LLInventoryCache::writeInBackground(mPath, LLInventoryCache::snapshot(categories, items));
+		ensure("written on the calling thread", boost::filesystem::exists(mPath));
+
+		cat_array_t read_categories;
+		item_array_t read_items;
+		changed_items_t cats_to_update;
+		bool is_cache_obsolete = true;
+		ensure("read", read(read_categories, read_items, cats_to_update, is_cache_obsolete));
+		ensure_equals("all items", read_items.size(), (size_t)10);
+	}
+
+	template<> template<>
+	void inventorycache_object::test<6>()
+	{
+		set_test_name("load time benchmark");
+
+		// Building a large inventory takes a while, so this only runs on
+		// request, e.g. LL_INVENTORY_CACHE_BENCH_ITEMS=100000
+		std::string items_str = LLStringUtil::getenv("LL_INVENTORY_CACHE_BENCH_ITEMS");
+		if (items_str.empty())
+		{
+			skip("set LL_INVENTORY_CACHE_BENCH_ITEMS to run");
+		}
+		const U32 item_count = (U32)std::stoul(items_str);
+		const U32 folder_count = llmax(1U, item_count / 20);
+
+		cat_array_t categories;
+		item_array_t items;
+		makeInventory(folder_count, item_count, categories, items);
+
+		typedef std::chrono::steady_clock clock_t;
+		auto ms = [](clock_t::time_point start)
+			{
+				return std::chrono::duration<double, std::milli>(clock_t::now() - start).count();
+			};
+
+		// The notation cache as LLInventoryModel::saveToFile() wrote it,
+		// one entry per line
+		std::string notation;
+		for (const LLPointer<LLViewerInventoryCategory>& cat : categories)
+		{
+			LLSD sd = cat->LLInventoryCategory::exportLLSD();
+			sd["owner_id"] = cat->getOwnerID();
+			sd["version"] = cat->getVersion();
+			notation += STRINGIZE(LLSDOStreamer<LLSDNotationFormatter>(sd)) + "\n";
+		}
+		for (const LLPointer<LLViewerInventoryItem>& item : items)
+		{
+			notation += STRINGIZE(LLSDOStreamer<LLSDNotationFormatter>(item->asLLSD())) + "\n";
+		}
+
+		// What LLInventoryModel::loadFromFile() does with it, less the
+		// gunzip and the file reads
+		clock_t::time_point start = clock_t::now();
+		item_array_t notation_items;
+		{
+			LLPointer<LLSDParser> parser = new LLSDNotationParser();
+			std::istringstream lines(notation);
+			std::string line;
+			while (std::getline(lines, line))
+			{
+				LLSD s_item;
+				boost::iostreams::stream<boost::iostreams::array_source> iss(line.data(), line.size());
+				parser->parse(iss, s_item, line.length());
+				if (s_item.has("item_id"))
+				{
+					LLPointer<LLViewerInventoryItem> inv_item = new LLViewerInventoryItem;
+					inv_item->fromLLSD(s_item);
+					notation_items.push_back(inv_item);
+				}
+				else
+				{
+					LLPointer<LLViewerInventoryCategory> inv_cat = new LLViewerInventoryCategory(
+						LLUUID::null, LLUUID::null, LLFolderType::FT_NONE, "", LLUUID::null);
+					inv_cat->LLInventoryCategory::importLLSD(s_item);
+				}
+			}
+		}
+		const double notation_ms = ms(start);
+
+		start = clock_t::now();
+		ensure("written", LLInventoryCache::write(mPath, *LLInventoryCache::snapshot(categories, items)));
+		const double write_ms = ms(start);
+
+		start = clock_t::now();
+		cat_array_t read_categories;
+		item_array_t read_items;
+		changed_items_t cats_to_update;
+		bool is_cache_obsolete = true;
+		ensure("read", read(read_categories, read_items, cats_to_update, is_cache_obsolete));
+		const double binary_ms = ms(start);
+		ensure_equals("same items", read_items.size(), notation_items.size());
+
+		std::cout << "\n" << item_count << " items in " << folder_count << " folders:\n"
+				  << "  notation parse    " << notation_ms << " ms, " << notation.size() << " bytes\n"
+				  << "  binary load       " << binary_ms << " ms, "
+				  << boost::filesystem::file_size(mPath) << " bytes\n"
+				  << "  binary save       " << write_ms << " ms" << std::endl;
+	}
+
+	template<> template<>
+	void inventorycache_object::test<7>()
+	{
+		set_test_name("overlapping writes keep the newest snapshot");
+
+		cat_array_t categories;
+		item_array_t items;
+		makeInventory(2, 10, categories, items);
+		LLInventoryCache::snapshot_ptr_t older = LLInventoryCache::snapshot(categories, items);
+		categories.clear();
+		items.clear();
+		makeInventory(2, 20, categories, items);
+		LLInventoryCache::snapshot_ptr_t newer = LLInventoryCache::snapshot(categories, items);
+
+		// Each write of the same file has its own temp file, so two at once
+		// never mix their bytes
+		std::thread other([this, older]()
+			{
+				for (S32 i = 0; i < 20; ++i)
+				{
+					LLInventoryCache::write(mPath, *older);
+				}
+			});
+		for (S32 i = 0; i < 20; ++i)
+		{
+			LLInventoryCache::write(mPath, *newer);
+		}
+		other.join();
+
+		cat_array_t read_categories;
+		item_array_t read_items;
+		changed_items_t cats_to_update;
+		bool is_cache_obsolete = true;
+		ensure("read", read(read_categories, read_items, cats_to_update, is_cache_obsolete));
+		ensure("current", !is_cache_obsolete);
+		ensure_equals("newest snapshot in place", read_items.size(), (size_t)20);
+
+		// An older snapshot finishing last does not replace a newer one
+		ensure("late older write reported done", LLInventoryCache::write(mPath, *older));
+		read_categories.clear();
+		read_items.clear();
+		cats_to_update.clear();
+		ensure("read after the late write", read(read_categories, read_items, cats_to_update, is_cache_obsolete));
+		ensure_equals("newer snapshot kept", read_items.size(), (size_t)20);
+
+		const boost::filesystem::path dir = boost::filesystem::path(mPath).parent_path();
+		const std::string prefix = boost::filesystem::path(mPath).filename().string();
+		for (const boost::filesystem::directory_entry& entry : boost::filesystem::directory_iterator(dir))
+		{
+			const std::string name = entry.path().filename().string();
+			ensure("no temp file left behind", name.compare(0, prefix.size(), prefix) != 0 || name == prefix);
+		}
+	}
+}
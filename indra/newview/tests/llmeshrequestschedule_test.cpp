@@ -0,0 +1,146 @@
+/**
+ * @file llmeshrequestschedule_test.cpp
+ * @brief Tests for the mesh request schedule.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llmeshrequestschedule.h"
+
+#include <string>
+#include <utility>
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// Keyed like the LOD schedule, by mesh and LOD
+	typedef std::pair<S32, S32> lod_key_t;
+	typedef LLMeshRequestSchedule<lod_key_t, std::string> schedule_t;
+}
+
+namespace tut
+{
+	struct meshrequestschedule_data
+	{
+	};
+	typedef test_group<meshrequestschedule_data> meshrequestschedule_test;
+	typedef meshrequestschedule_test::object meshrequestschedule_object;
+	tut::meshrequestschedule_test meshrequestschedule_testcase("LLMeshRequestSchedule");
+
+	template<> template<>
+	void meshrequestschedule_object::test<1>()
+	{
+		set_test_name("highest priority first, queueing order among equals");
+
+		schedule_t schedule;
+		ensure("empty", schedule.empty());
+
+		ensure("queued", schedule.push(lod_key_t(1, 0), "a", 0.5f));
+		ensure("queued", schedule.push(lod_key_t(2, 0), "b", 2.f));
+		ensure("queued", schedule.push(lod_key_t(3, 0), "c", 0.5f));
+		ensure("queued", schedule.push(lod_key_t(4, 0), "d", -0.5f));	// out of view
+		ensure("queued", schedule.push(lod_key_t(1, 1), "e", 0.5f));	// other LOD, same mesh
+		ensure_equals("size", schedule.size(), (size_t)5);
+		ensure("contains", schedule.contains(lod_key_t(1, 1)));
+		ensure("doesn't contain", !schedule.contains(lod_key_t(1, 2)));
+
+		F32 priority = 0.f;
+		ensure_equals("best first", schedule.pop(&priority), std::string("b"));
+		ensure_equals("its priority", priority, 2.f);
+		ensure_equals("then in queueing order", schedule.pop(), std::string("a"));
+		ensure_equals("queueing order", schedule.pop(), std::string("c"));
+		ensure_equals("queueing order", schedule.pop(), std::string("e"));
+		ensure_equals("out of view last", schedule.pop(&priority), std::string("d"));
+		ensure_equals("negative priority", priority, -0.5f);
+		ensure("empty again", schedule.empty());
+	}
+
+	template<> template<>
+	void meshrequestschedule_object::test<2>()
+	{
+		set_test_name("one request per key");
+
+		schedule_t schedule;
+		schedule.push(lod_key_t(1, 0), "first", 1.f);
+		schedule.push(lod_key_t(2, 0), "other", 3.f);
+
+		// Asked for again at a higher priority, the original moves up
+		ensure("not queued twice", !schedule.push(lod_key_t(1, 0), "second", 5.f));
+		ensure_equals("one entry per key", schedule.size(), (size_t)2);
+		F32 priority = 0.f;
+		ensure_equals("original kept and raised", schedule.pop(&priority), std::string("first"));
+		ensure_equals("raised", priority, 5.f);
+
+		// A lower priority doesn't lower it
+		schedule.push(lod_key_t(3, 0), "third", 4.f);
+		ensure("not queued twice", !schedule.push(lod_key_t(3, 0), "again", 0.f));
+		ensure_equals("not lowered", schedule.pop(&priority), std::string("third"));
+		ensure_equals("priority kept", priority, 4.f);
+
+		// Once handed out, the key can be queued again
+		ensure("queued again", schedule.push(lod_key_t(1, 0), "retry", 0.f));
+		ensure_equals("size", schedule.size(), (size_t)2);
+	}
+
+	template<> template<>
+	void meshrequestschedule_object::test<3>()
+	{
+		set_test_name("rescoring and cancelling waiting requests");
+
+		schedule_t schedule;
+		for (S32 mesh = 0; mesh < 5; ++mesh)
+		{
+			schedule.push(lod_key_t(mesh, 0), std::to_string(mesh), (F32)mesh);
+		}
+
+		// The camera turns, the last becomes the first
+		ensure("rescored", schedule.setPriority(lod_key_t(0, 0), 10.f));
+		ensure("rescored", schedule.setPriority(lod_key_t(4, 0), -1.f));
+		ensure("unknown key", !schedule.setPriority(lod_key_t(9, 0), 1.f));
+		ensure_equals("nothing added", schedule.size(), (size_t)5);
+
+		// raisePriority never lowers
+		ensure("known key", schedule.raisePriority(lod_key_t(1, 0), 0.f));
+		ensure("unknown key", !schedule.raisePriority(lod_key_t(9, 0), 1.f));
+		schedule.raisePriority(lod_key_t(2, 0), 20.f);
+
+		// Nothing waits for 3 anymore
+		ensure("cancelled", schedule.cancel(lod_key_t(3, 0)));
+		ensure("cancelled once", !schedule.cancel(lod_key_t(3, 0)));
+		ensure("gone", !schedule.contains(lod_key_t(3, 0)));
+
+		const char* expected[] = { "2", "0", "1", "4" };
+		for (const char* name : expected)
+		{
+			ensure_equals("rescored order", schedule.pop(), std::string(name));
+		}
+		ensure("drained", schedule.empty());
+
+		// Rescoring to the same priority keeps queueing order
+		schedule.push(lod_key_t(1, 0), "x", 1.f);
+		schedule.push(lod_key_t(2, 0), "y", 1.f);
+		schedule.setPriority(lod_key_t(1, 0), 1.f);
+		ensure_equals("order kept", schedule.pop(), std::string("x"));
+	}
+}
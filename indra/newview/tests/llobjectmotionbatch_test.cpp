@@ -0,0 +1,408 @@
+/**
+ * @file llobjectmotionbatch_test.cpp
+ * @brief Test and idle update benchmark for LLObjectMotionBatch.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llobjectmotionbatch.h"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+
+#include "lltimer.h"
+#include "workqueue.h"
+#include "../test/lltut.h"
+
+namespace
+{
+	const F32 PHASE_OUT_TIME = 3.f;
+	const F32 MAX_TIME = 6.f;
+
+	// An active prim the way LLViewerObject keeps it: its own heap block,
+	// updated through a virtual call.  The padding stands in for the rest
+	// of the object so that neighbours don't share cache lines.
+	class SyntheticObject
+	{
+	public:
+		virtual ~SyntheticObject() = default;
+		virtual void idleUpdate(F32 dt) = 0;
+	};
+
+	class SyntheticPrim : public SyntheticObject
+	{
+	public:
+		// What LLViewerObject::applyAngularVelocity() and the prediction
+		// in interpolateLinearMotion() do
+		void idleUpdate(F32 dt) override
+		{
+			mRotTime += dt;
+			LLVector3 ang_vel = mAngularVelocity;
+			F32 omega = ang_vel.magVecSquared();
+			if (omega > 0.00001f)
+			{
+				omega = sqrtf(omega);
+				ang_vel *= 1.f / omega;
+				LLQuaternion dQ;
+				dQ.setQuat(omega * dt, ang_vel);
+				mAngularVelocityRot *= dQ;
+				mRotation = mRotation * dQ;
+			}
+
+			if (mAttachment || mSinceMessage <= 0.f || dt <= 0.f)
+			{
+				return;
+			}
+			if (!mVelocity.isExactlyZero() || !mAcceleration.isExactlyZero())
+			{
+				LLVector3 new_pos = (mVelocity + (0.5f * (dt - LLObjectMotionBatch::PHYSICS_TIMESTEP)) * mAcceleration) * dt;
+				LLVector3 new_v = mAcceleration * dt;
+				if (mStalled && mSinceMessage > PHASE_OUT_TIME)
+				{
+					F32 phase_out;
+					if (mSinceMessage > MAX_TIME)
+					{
+						phase_out = 0.f;
+					}
+					else if (mInterpLag > PHASE_OUT_TIME)
+					{
+						phase_out = (MAX_TIME - mSinceMessage) / (MAX_TIME - mSinceInterp);
+					}
+					else
+					{
+						phase_out = (MAX_TIME - mSinceMessage) / (MAX_TIME - PHASE_OUT_TIME);
+					}
+					phase_out = llclamp(phase_out, 0.f, 1.f);
+					new_pos *= phase_out;
+					new_v *= phase_out;
+				}
+				mPosition += new_pos;
+				mVelocity += new_v;
+			}
+		}
+
+		U32 flags() const
+		{
+			U32 flags = 0;
+			if (mAttachment)
+			{
+				flags |= LLObjectMotionBatch::ATTACHMENT;
+			}
+			if (!mVelocity.isExactlyZero() || !mAcceleration.isExactlyZero())
+			{
+				flags |= LLObjectMotionBatch::MOVING;
+			}
+			if (mStalled)
+			{
+				flags |= LLObjectMotionBatch::STALLED;
+			}
+			return flags;
+		}
+
+		void addTo(LLObjectMotionBatch& batch, F32 dt) const
+		{
+			batch.add(mPosition, mVelocity, mAcceleration, mAngularVelocity, mRotation, mAngularVelocityRot,
+					  mRotTime, dt, mSinceMessage, mSinceInterp, mInterpLag, flags());
+		}
+
+		LLVector3		mPosition;
+		LLVector3		mVelocity;
+		LLVector3		mAcceleration;
+		LLVector3		mAngularVelocity;
+		LLQuaternion	mRotation;
+		LLQuaternion	mAngularVelocityRot;
+		F32				mRotTime = 0.f;
+		F32				mSinceMessage = 0.f;
+		F32				mSinceInterp = 0.f;
+		F32				mInterpLag = 0.f;
+		bool			mAttachment = false;
+		bool			mStalled = false;
+		U8				mPadding[1024];
+	};
+
+	// A region's worth of active objects: mostly moving and spinning
+	// prims, some attachments, some coasting on a stalled circuit
+	std::vector<std::unique_ptr<SyntheticPrim>> make_prims(U32 count)
+	{
+		std::mt19937 rng(count);
+		std::uniform_real_distribution<F32> unit(-1.f, 1.f);
+		std::vector<std::unique_ptr<SyntheticPrim>> prims;
+		for (U32 i = 0; i < count; ++i)
+		{
+			auto prim = std::make_unique<SyntheticPrim>();
+			prim->mPosition.set(128.f + 100.f * unit(rng), 128.f + 100.f * unit(rng), 30.f + 10.f * unit(rng));
+			if (i % 4)
+			{
+				prim->mVelocity.set(unit(rng), unit(rng), unit(rng));
+			}
+			if (i % 5 == 0)
+			{
+				prim->mAcceleration.set(0.f, 0.f, -9.8f);
+			}
+			if (i % 3)
+			{
+				prim->mAngularVelocity.set(unit(rng), unit(rng), 2.f * unit(rng));
+			}
+			prim->mRotation.setQuat(unit(rng) * F_PI, LLVector3(unit(rng), unit(rng), 1.f));
+			prim->mAttachment = i % 11 == 0;
+			prim->mStalled = i % 7 == 0;
+			prim->mSinceMessage = (i % 13) * 0.5f;
+			prim->mSinceInterp = 0.02f;
+			prim->mInterpLag = (i % 13) * 0.5f - 0.02f;
+			prims.push_back(std::move(prim));
+		}
+		// allocated in one go they would sit in order, active lists don't
+		std::shuffle(prims.begin(), prims.end(), rng);
+		return prims;
+	}
+
+	bool close_enough(const LLVector3& a, const LLVector3& b)
+	{
+		return dist_vec(a, b) < 1e-4f;
+	}
+
+	bool close_enough(const LLQuaternion& a, const LLQuaternion& b)
+	{
+		return fabsf(a.mQ[VX] - b.mQ[VX]) < 1e-5f && fabsf(a.mQ[VY] - b.mQ[VY]) < 1e-5f &&
+			   fabsf(a.mQ[VZ] - b.mQ[VZ]) < 1e-5f && fabsf(a.mQ[VW] - b.mQ[VW]) < 1e-5f;
+	}
+}
+
+namespace tut
+{
+	struct objectmotionbatch
+	{
+		objectmotionbatch()
+		{
+			mParams.mPhaseOutTime = PHASE_OUT_TIME;
+			mParams.mMaxTime = MAX_TIME;
+		}
+
+		LLObjectMotionBatch::Params mParams;
+	};
+	typedef test_group<objectmotionbatch> objectmotionbatch_t;
+	typedef objectmotionbatch_t::object objectmotionbatch_object_t;
+	tut::objectmotionbatch_t tut_objectmotionbatch("LLObjectMotionBatch");
+
+	template<> template<>
+	void objectmotionbatch_object_t::test<1>()
+	{
+		set_test_name("matches the per object update");
+		const F32 dt = 1.f / 30.f;
+		auto prims = make_prims(500);
+
+		LLObjectMotionBatch batch;
+		for (const auto& prim : prims)
+		{
+			prim->addTo(batch, dt);
+		}
+		batch.update(mParams, 0, batch.size());
+
+		for (size_t i = 0; i < prims.size(); ++i)
+		{
+			SyntheticPrim& prim = *prims[i];
+			const U32 flags = batch.getFlags(i);
+			prim.idleUpdate(dt);
+
+			ensure("position", close_enough(batch.getPosition(i), prim.mPosition));
+			ensure("velocity", close_enough(batch.getVelocity(i), prim.mVelocity));
+			ensure("rotation", close_enough(batch.getRotation(i), prim.mRotation));
+			ensure("accumulated rotation", close_enough(batch.getAngularVelocityRot(i), prim.mAngularVelocityRot));
+			ensure_approximately_equals("rot time", batch.getRotTime(i), prim.mRotTime, 16);
+			ensure_equals("rotated", (flags & LLObjectMotionBatch::ROTATED) != 0,
+						  !prim.mAngularVelocity.isExactlyZero());
+			if (prim.mAttachment || prim.mSinceMessage <= 0.f)
+			{
+				ensure("attachments and fresh updates don't interpolate",
+					   !(flags & (LLObjectMotionBatch::INTERPOLATED | LLObjectMotionBatch::MOVED)));
+			}
+			else
+			{
+				ensure("interpolated", flags & LLObjectMotionBatch::INTERPOLATED);
+				ensure_equals("moved", (flags & LLObjectMotionBatch::MOVED) != 0,
+							  (prim.flags() & LLObjectMotionBatch::MOVING) != 0);
+			}
+		}
+	}
+
+	template<> template<>
+	void objectmotionbatch_object_t::test<2>()
+	{
+		set_test_name("phase out and unbounded");
+		LLObjectMotionBatch batch;
+		const LLVector3 vel(1.f, 0.f, 0.f);
+		// since the last message: within the phase out, partly phased out, past the limit
+		batch.add(LLVector3::zero, vel, LLVector3::zero, LLVector3::zero, LLQuaternion(), LLQuaternion(),
+				  0.f, 1.f, 2.f, 1.f, 1.f, LLObjectMotionBatch::MOVING | LLObjectMotionBatch::STALLED);
+		batch.add(LLVector3::zero, vel, LLVector3::zero, LLVector3::zero, LLQuaternion(), LLQuaternion(),
+				  0.f, 1.f, 4.5f, 1.f, 1.f, LLObjectMotionBatch::MOVING | LLObjectMotionBatch::STALLED);
+		batch.add(LLVector3::zero, vel, LLVector3::zero, LLVector3::zero, LLQuaternion(), LLQuaternion(),
+				  0.f, 1.f, 7.f, 1.f, 1.f, LLObjectMotionBatch::MOVING | LLObjectMotionBatch::STALLED);
+		// a healthy circuit never phases out
+		batch.add(LLVector3::zero, vel, LLVector3::zero, LLVector3::zero, LLQuaternion(), LLQuaternion(),
+				  0.f, 1.f, 7.f, 1.f, 1.f, LLObjectMotionBatch::MOVING);
+		batch.update(mParams, 0, batch.size());
+
+		ensure_approximately_equals("full motion", batch.getPosition(0).mV[VX], 1.f, 16);
+		ensure_approximately_equals("half motion", batch.getPosition(1).mV[VX], 0.5f, 16);
+		ensure_approximately_equals("velocity kept", batch.getVelocity(1).mV[VX], 1.f, 16);
+		ensure_approximately_equals("stopped", batch.getPosition(2).mV[VX], 0.f, 16);
+		ensure_approximately_equals("not stalled", batch.getPosition(3).mV[VX], 1.f, 16);
+
+		LLObjectMotionBatch::Params unbounded;
+		unbounded.mPhaseOutTime = PHASE_OUT_TIME;
+		unbounded.mMaxTime = 0.f;
+		batch.clear();
+		batch.add(LLVector3::zero, vel, LLVector3::zero, LLVector3::zero, LLQuaternion(), LLQuaternion(),
+				  0.f, 1.f, 7.f, 1.f, 1.f, LLObjectMotionBatch::MOVING | LLObjectMotionBatch::STALLED);
+		batch.update(unbounded, 0, batch.size());
+		ensure_approximately_equals("unbounded", batch.getPosition(0).mV[VX], 1.f, 16);
+	}
+
+	template<> template<>
+	void objectmotionbatch_object_t::test<3>()
+	{
+		set_test_name("pool matches serial");
+		LL::WorkQueue queue("General");
+		std::vector<std::thread> workers;
+		for (S32 i = 0; i < 3; ++i)
+		{
+			workers.emplace_back([&queue](){ queue.runUntilClose(); });
+		}
+
+		const F32 dt = 1.f / 45.f;
+		auto prims = make_prims(10000);
+		LLObjectMotionBatch serial, pooled;
+		for (const auto& prim : prims)
+		{
+			prim->addTo(serial, dt);
+			prim->addTo(pooled, dt);
+		}
+		serial.update(mParams, 0, serial.size());
+		pooled.update(mParams, 256);
+
+		queue.close();
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+
+		for (size_t i = 0; i < serial.size(); ++i)
+		{
+			ensure_equals("flags", pooled.getFlags(i), serial.getFlags(i));
+			ensure("position", pooled.getPosition(i) == serial.getPosition(i));
+			ensure("rotation", pooled.getRotation(i) == serial.getRotation(i));
+		}
+	}
+
+	template<> template<>
+	void objectmotionbatch_object_t::test<4>()
+	{
+		set_test_name("idle update benchmark");
+		if (LLStringUtil::getenv("LL_OBJECTUPDATE_BENCH").empty())
+		{
+			skip("set LL_OBJECTUPDATE_BENCH to run");
+		}
+
+		const U32 OBJECTS = 10000;
+		const U32 FRAMES = 100;
+		const F32 dt = 1.f / 60.f;
+		auto prims = make_prims(OBJECTS);
+		std::vector<SyntheticObject*> active_list;
+		for (const auto& prim : prims)
+		{
+			active_list.push_back(prim.get());
+		}
+
+		// one virtual idleUpdate() per object per frame
+		LLTimer timer;
+		for (U32 frame = 0; frame < FRAMES; ++frame)
+		{
+			for (SyntheticObject* objectp : active_list)
+			{
+				objectp->idleUpdate(dt);
+			}
+		}
+		F64 virtual_seconds = timer.getElapsedTimeF64();
+
+		// the batch, gather and scatter included
+		LLObjectMotionBatch batch;
+		auto run_batch = [&](bool pooled)
+		{
+			for (U32 frame = 0; frame < FRAMES; ++frame)
+			{
+				batch.clear();
+				batch.reserve(prims.size());
+				for (const auto& prim : prims)
+				{
+					prim->addTo(batch, dt);
+				}
+				if (pooled)
+				{
+					batch.update(mParams, 256);
+				}
+				else
+				{
+					batch.update(mParams, 0, batch.size());
+				}
+				for (size_t i = 0; i < prims.size(); ++i)
+				{
+					SyntheticPrim& prim = *prims[i];
+					prim.mPosition = batch.getPosition(i);
+					prim.mVelocity = batch.getVelocity(i);
+					prim.mRotation = batch.getRotation(i);
+					prim.mAngularVelocityRot = batch.getAngularVelocityRot(i);
+					prim.mRotTime = batch.getRotTime(i);
+				}
+			}
+		};
+
+		timer.reset();
+		run_batch(false);
+		F64 serial_seconds = timer.getElapsedTimeF64();
+
+		LL::WorkQueue queue("General");
+		std::vector<std::thread> workers;
+		for (S32 i = 0; i < 3; ++i)
+		{
+			workers.emplace_back([&queue](){ queue.runUntilClose(); });
+		}
+		timer.reset();
+		run_batch(true);
+		F64 pooled_seconds = timer.getElapsedTimeF64();
+		queue.close();
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+
+		std::cout << "\n" << OBJECTS << " active objects, " << FRAMES << " frames: per object "
+				  << virtual_seconds * 1000.0 / FRAMES << " ms/frame, batched "
+				  << serial_seconds * 1000.0 / FRAMES << " ms/frame, batched on 3 threads + caller "
+				  << pooled_seconds * 1000.0 / FRAMES << " ms/frame, "
+				  << virtual_seconds / llmax(pooled_seconds, 1e-9) << "x" << std::endl;
+	}
+}
@@ -0,0 +1,309 @@
+/**
+ * @file llobjectupdatequeue_test.cpp
+ * @brief Tests for the queue of object updates applied under a time budget.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../llviewerprecompiledheaders.h"
+
+#include "../llobjectupdatequeue.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "lldatapacker.h"
+#include "lltimer.h"
+#include "net.h"
+#include "workqueue.h"
+#include "../test/lltut.h"
+
+namespace
+{
+	std::atomic<U32> sDecodes(0);
+	// while set, decodes off the test's thread wait, holding their batch
+	// in DECODING
+	std::atomic<bool> sHoldPoolDecodes(false);
+	std::thread::id sTestThread;
+}
+
+//----------------------------------------------------------------------------
+// Stubs
+
+U32 LLViewerObject::extractSpatialExtents(LLDataPackerBinaryBuffer* dp, LLVector3& pos, LLVector3& scale, LLQuaternion& rot)
+{
+	++sDecodes;
+	while (std::this_thread::get_id() != sTestThread && sHoldPoolDecodes)
+	{
+		std::this_thread::yield();
+	}
+
+	// The tests only care that decoding ran, the first word stands in for the parent
+	U32 parent_id = 0;
+	dp->unpackU32(parent_id, "ParentID");
+	return parent_id;
+}
+
+//----------------------------------------------------------------------------
+
+namespace tut
+{
+	struct objectupdatequeue_data
+	{
+		objectupdatequeue_data()
+		:	mSender(ip_string_to_u32("127.0.0.1"), 13000)
+		{
+			sDecodes = 0;
+			sHoldPoolDecodes = false;
+			sTestThread = std::this_thread::get_id();
+		}
+
+		// One compressed record per local id, the data holds local id + 1000
+		// for the decode stub to hand back as the parent
+		LLObjectUpdateQueue::batch_ptr_t makeBatch(U32 first, U32 count)
+		{
+			auto batch = std::make_shared<LLObjectUpdateQueue::Batch>(0, mSender, OUT_FULL_COMPRESSED);
+			batch->mPacketID = first;
+			for (U32 local_id = first; local_id < first + count; ++local_id)
+			{
+				LLObjectUpdateRecord record;
+				record.mLocalID = local_id;
+				record.mCRC = 0;
+				record.mFlags = 0;
+				record.mParentID = 0;
+				record.mData.resize(sizeof(U32));
+				LLDataPackerBinaryBuffer dp(record.mData.data(), (S32)record.mData.size());
+				dp.packU32(local_id + 1000, "ParentID");
+				batch->mRecords.push_back(std::move(record));
+			}
+			return batch;
+		}
+
+		LLObjectUpdateQueue::apply_func_t recorder(F32 spin_seconds = 0.f)
+		{
+			return [this, spin_seconds](const LLObjectUpdateQueue::Batch& batch, LLObjectUpdateRecord& record)
+				{
+					mApplied.push_back(record.mLocalID);
+					mParents.push_back(record.mParentID);
+					mPacketIDs.push_back(batch.mPacketID);
+					// stand in for the cost of a real update
+					LLTimer timer;
+					while (timer.getElapsedTimeF32() < spin_seconds)
+					{
+					}
+				};
+		}
+
+		LLHost mSender;
+		std::vector<U32> mApplied;
+		std::vector<U32> mParents;
+		std::vector<U32> mPacketIDs;
+	};
+	typedef test_group<objectupdatequeue_data> objectupdatequeue_test;
+	typedef objectupdatequeue_test::object objectupdatequeue_object;
+	tut::objectupdatequeue_test objectupdatequeue_testcase("LLObjectUpdateQueue");
+
+	template<> template<>
+	void objectupdatequeue_object::test<1>()
+	{
+		set_test_name("records apply in arrival order, one object can go first");
+
+		LLObjectUpdateQueue queue;
+		queue.push(makeBatch(1, 3));
+		queue.push(makeBatch(4, 3));
+		ensure_equals("pending", queue.getPendingCount(), (U32)6);
+		ensure("object queued", queue.isPending(mSender, 5));
+		ensure("other host", !queue.isPending(LLHost(ip_string_to_u32("127.0.0.2"), 13000), 5));
+
+		// A terse update for 5 arrives, its queued full update goes first
+		queue.applyObject(mSender, 5, recorder());
+		ensure_equals("one applied", mApplied.size(), (size_t)1);
+		ensure_equals("the requested one", mApplied[0], (U32)5);
+		ensure_equals("decoded first", mParents[0], (U32)1005);
+		ensure_equals("its batch's packet", mPacketIDs[0], (U32)4);
+		ensure("no longer queued", !queue.isPending(mSender, 5));
+		ensure_equals("pending after one", queue.getPendingCount(), (U32)5);
+
+		queue.applyPending(1000.f, recorder());
+		const U32 expected[] = { 5, 1, 2, 3, 4, 6 };
+		ensure_equals("all applied once", mApplied.size(), (size_t)6);
+		for (size_t i = 0; i < mApplied.size(); ++i)
+		{
+			ensure_equals("arrival order", mApplied[i], expected[i]);
+			ensure_equals("decoded", mParents[i], expected[i] + 1000);
+		}
+		ensure("empty", queue.empty());
+		ensure_equals("nothing pending", queue.getPendingCount(), (U32)0);
+	}
+
+	template<> template<>
+	void objectupdatequeue_object::test<2>()
+	{
+		set_test_name("applyPending stops at the frame budget");
+
+		LLObjectUpdateQueue queue;
+		const U32 count = 40;
+		queue.push(makeBatch(1, count / 2));
+		queue.push(makeBatch(1 + count / 2, count / 2));
+
+		// 1ms per update against a 4.5ms budget
+		const F32 spin = 0.001f;
+		const F32 budget = 0.0045f;
+		queue.applyPending(budget, recorder(spin));
+		const size_t first_frame = mApplied.size();
+		ensure("some applied", first_frame > 0);
+		ensure("stopped at the budget", first_frame < count);
+		ensure_equals("the rest pending", queue.getPendingCount(), (U32)(count - first_frame));
+
+		// Each frame picks up where the last left off
+		S32 frames = 1;
+		while (!queue.empty() && frames < 100)
+		{
+			size_t before = mApplied.size();
+			queue.applyPending(budget, recorder(spin));
+			ensure("progress every frame", mApplied.size() > before);
+			++frames;
+		}
+		ensure("drained", queue.empty());
+		ensure("took several frames", frames > 1);
+		ensure_equals("all applied once", mApplied.size(), (size_t)count);
+		for (U32 i = 0; i < count; ++i)
+		{
+			ensure_equals("order kept across frames", mApplied[i], i + 1);
+		}
+	}
+
+	template<> template<>
+	void objectupdatequeue_object::test<3>()
+	{
+		set_test_name("an object applied early isn't applied again");
+
+		LLObjectUpdateQueue queue;
+		queue.push(makeBatch(1, 4));
+
+		queue.applyPending(0.f, recorder());
+		ensure_equals("a zero budget still applies one", mApplied.size(), (size_t)1);
+
+		queue.applyObject(mSender, 3, recorder());
+		queue.applyObject(mSender, 3, recorder());
+		ensure_equals("applied once", mApplied.size(), (size_t)2);
+
+		queue.applyAll(recorder());
+		const U32 expected[] = { 1, 3, 2, 4 };
+		ensure_equals("all applied", mApplied.size(), (size_t)4);
+		for (size_t i = 0; i < mApplied.size(); ++i)
+		{
+			ensure_equals("order", mApplied[i], expected[i]);
+		}
+
+		queue.push(makeBatch(10, 2));
+		queue.clear();
+		ensure("cleared", queue.empty());
+		ensure("nothing pending", !queue.isPending(mSender, 10));
+	}
+
+	template<> template<>
+	void objectupdatequeue_object::test<4>()
+	{
+		set_test_name("a batch the pool claims first waits for its decode");
+
+		LL::WorkQueue general("General");
+		sHoldPoolDecodes = true;
+
+		LLObjectUpdateQueue queue;
+		LLObjectUpdateQueue::batch_ptr_t batch = makeBatch(1, 4);
+		queue.push(batch);
+		std::thread worker([&general]()
+			{
+				general.runOne();
+			});
+		while (batch->mState.load() != LLObjectUpdateQueue::Batch::DECODING)
+		{
+			std::this_thread::yield();
+		}
+
+		// The pool is writing the records, none may be applied from them
+		queue.applyPending(1000.f, recorder());
+		ensure("nothing applied mid-decode", mApplied.empty());
+		ensure_equals("all pending", queue.getPendingCount(), (U32)4);
+
+		// One object can still go ahead, decoded from a copy
+		queue.applyObject(mSender, 3, recorder());
+		ensure_equals("early object applied", mApplied.size(), (size_t)1);
+		ensure_equals("from a decoded copy", mParents[0], (U32)1003);
+
+		sHoldPoolDecodes = false;
+		worker.join();
+		ensure("decoded by the pool", batch->mState.load() == LLObjectUpdateQueue::Batch::DECODED);
+
+		queue.applyPending(1000.f, recorder());
+		const U32 expected[] = { 3, 1, 2, 4 };
+		ensure_equals("all applied", mApplied.size(), (size_t)4);
+		for (size_t i = 0; i < mApplied.size(); ++i)
+		{
+			ensure_equals("order", mApplied[i], expected[i]);
+			ensure_equals("decoded", mParents[i], expected[i] + 1000);
+		}
+		ensure_equals("the pool's decode used, the copy's on top", sDecodes.load(), (U32)5);
+
+		// Decoded on this thread before the pool gets to it, the pool's
+		// task finds it claimed and leaves it alone
+		queue.push(makeBatch(10, 4));
+		queue.applyPending(1000.f, recorder());
+		ensure_equals("decoded here", sDecodes.load(), (U32)9);
+		general.runPending();
+		ensure_equals("not decoded again", sDecodes.load(), (U32)9);
+		ensure("drained", queue.empty());
+
+		// The pool racing this thread for every batch, polling so it picks
+		// each one up as this thread gets to it
+		std::thread pool([&general]()
+			{
+				while (general.runOne())
+				{
+				}
+			});
+		mApplied.clear();
+		mParents.clear();
+		sDecodes = 0;
+		const U32 batches = 2000;
+		const U32 per_batch = 4;
+		for (U32 i = 0; i < batches; ++i)
+		{
+			queue.push(makeBatch(i * per_batch, per_batch));
+			while (!queue.empty())
+			{
+				queue.applyPending(1000.f, recorder());
+			}
+		}
+		general.close();
+		pool.join();
+
+		ensure_equals("every record applied", mApplied.size(), (size_t)(batches * per_batch));
+		for (size_t i = 0; i < mApplied.size(); ++i)
+		{
+			ensure_equals("never applied before its decode", mParents[i], mApplied[i] + 1000);
+		}
+		ensure_equals("each record decoded once", sDecodes.load(), batches * per_batch);
+	}
+}
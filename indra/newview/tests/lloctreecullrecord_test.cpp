@@ -0,0 +1,361 @@
+/**
+ * @file lloctreecullrecord_test.cpp
+ * @brief Tests for octree cull walks recorded off the main thread.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../lloctreecullrecord.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../test/lltut.h"
+
+namespace
+{
+	struct TestNode;
+
+	// What LLSpatialGroup answers the cullers with, fixed per group
+	struct TestGroup
+	{
+		enum
+		{
+			SKIP_FRUSTUM_CHECK = 0x00000004
+		};
+
+		bool hasState(U32 state) const { return mState & state; }
+
+		U32		mID;
+		U32		mState;
+		S32		mFrustum;			// frustumCheck(), 0 out, 1 partially in, 2 fully in
+		S32		mObjectsFrustum;	// frustumCheckObjects()
+		bool	mOccluded;
+		const TestNode* mNode;
+	};
+
+	class TestTraveler;
+
+	// Stands in for OctreeNode
+	struct TestNode
+	{
+		TestGroup* getListener(U32 index) const					{ return mGroup.get(); }
+		U32 getChildCount() const								{ return (U32)mChildren.size(); }
+		const TestNode* getChild(U32 index) const				{ return mChildren[index].get(); }
+		U32 getElementCount() const								{ return mElements; }
+		void accept(TestTraveler* visitor) const;
+
+		std::unique_ptr<TestGroup> mGroup;
+		std::vector<std::unique_ptr<TestNode> > mChildren;
+		const TestNode* mParent = NULL;
+		U32 mElements = 0;
+	};
+
+	// LLOctreeTraveler::traverse()
+	class TestTraveler
+	{
+	public:
+		virtual ~TestTraveler() = default;
+		virtual void traverse(const TestNode* node)
+		{
+			node->accept(this);
+			for (U32 i = 0; i < node->getChildCount(); i++)
+			{
+				traverse(node->getChild(i));
+			}
+		}
+		virtual void visit(const TestNode* branch) = 0;
+	};
+
+	void TestNode::accept(TestTraveler* visitor) const
+	{
+		visitor->visit(this);
+	}
+
+	// LLViewerOctreeCull and LLOctreeCull with the checks answered by the
+	// groups.  The replay's calls are logged to compare with the serial walk.
+	class TestCull : public TestTraveler
+	{
+	public:
+		TestCull(LLCamera* camera) : mRes(0) { }
+
+		virtual void traverse(const TestNode* n)
+		{
+			TestGroup* group = n->getListener(0);
+
+			if (earlyFail(group))
+			{
+				return;
+			}
+
+			if (mRes == 2 ||
+				(mRes && group->hasState(TestGroup::SKIP_FRUSTUM_CHECK)))
+			{
+				TestTraveler::traverse(n);
+			}
+			else
+			{
+				mRes = frustumCheck(group);
+
+				if (mRes)
+				{
+					TestTraveler::traverse(n);
+				}
+
+				mRes = 0;
+			}
+		}
+
+		virtual void visit(const TestNode* branch)
+		{
+			TestGroup* group = branch->getListener(0);
+			if (checkObjects(branch, group))
+			{
+				processGroup(group);
+			}
+		}
+
+		virtual bool earlyFail(TestGroup* group)
+		{
+			mChecked.push_back(group->mID);
+			// never occlusion cull the root node
+			return group->mNode->mParent && group->mOccluded;
+		}
+
+		virtual S32 frustumCheck(const TestGroup* group)
+		{
+			return group->mFrustum;
+		}
+
+		virtual S32 frustumCheckObjects(const TestGroup* group)
+		{
+			return group->mObjectsFrustum;
+		}
+
+		bool checkObjects(const TestNode* branch, const TestGroup* group)
+		{
+			if (branch->getElementCount() == 0)
+			{
+				return false;
+			}
+			else if (branch->getChildCount() == 0)
+			{
+				return true;
+			}
+			else if (mRes == 1 && !frustumCheckObjects(group))
+			{
+				return false;
+			}
+			return true;
+		}
+
+		virtual void processGroup(TestGroup* group)
+		{
+			mVisible.push_back(group->mID);
+		}
+
+		S32 mRes;
+		std::vector<U32> mChecked;		// earlyFail() calls, in order
+		std::vector<U32> mVisible;		// processGroup() calls, in order
+	};
+
+	typedef LLOctreeCullRecord<TestCull, TestTraveler, TestNode, TestGroup> record_t;
+
+	class TreeBuilder
+	{
+	public:
+		TreeBuilder(U32 seed) : mSeed(seed), mNextID(0) { }
+
+		std::unique_ptr<TestNode> build(U32 depth)
+		{
+			std::unique_ptr<TestNode> root = makeNode(NULL);
+			grow(root.get(), depth);
+			return root;
+		}
+
+	private:
+		U32 rand(U32 range)
+		{
+			mSeed = mSeed * 1664525 + 1013904223;
+			return (mSeed >> 8) % range;
+		}
+
+		std::unique_ptr<TestNode> makeNode(const TestNode* parent)
+		{
+			std::unique_ptr<TestNode> node(new TestNode);
+			node->mParent = parent;
+			node->mElements = rand(3);
+			node->mGroup.reset(new TestGroup);
+			TestGroup* group = node->mGroup.get();
+			group->mID = mNextID++;
+			group->mState = 0;
+			group->mFrustum = rand(3);
+			group->mObjectsFrustum = rand(2);
+			group->mOccluded = rand(5) == 0;
+			group->mNode = node.get();
+			return node;
+		}
+
+		void grow(TestNode* node, U32 depth)
+		{
+			if (!depth)
+			{
+				return;
+			}
+
+			const U32 children = node->mParent ? rand(5) : 1 + rand(8);
+			for (U32 i = 0; i < children; ++i)
+			{
+				node->mChildren.push_back(makeNode(node));
+				grow(node->mChildren.back().get(), depth - 1);
+			}
+
+			// LLViewerOctreeGroup::rebound() skips the frustum check of an
+			// only child of a node without elements, it has the same bounds
+			if (children == 1 && node->mElements == 0 && rand(2))
+			{
+				node->mChildren[0]->mGroup->mState |= TestGroup::SKIP_FRUSTUM_CHECK;
+			}
+		}
+
+		U32 mSeed;
+		U32 mNextID;
+	};
+
+	// LLSpatialCullSet::add(), record() and replay() for one tree
+	void record_and_replay(const TestNode* root, TestCull& replayer)
+	{
+		record_t::entry_t root_entry;
+		record_t::entry_list_t unused;
+		const S32 res = record_t(NULL, unused).recordRoot(root, root_entry);
+
+		const U32 count = res ? root->getChildCount() : 0;
+		std::vector<record_t::entry_list_t> subtrees(count);
+		std::vector<std::thread> threads;
+		for (U32 i = 0; i < count; ++i)
+		{
+			threads.emplace_back([&, i]()
+				{
+					record_t(NULL, subtrees[i]).recordSubtree(root->getChild(i), res);
+				});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		if (!record_t::replayRoot(replayer, root_entry))
+		{
+			return;
+		}
+		for (const record_t::entry_list_t& entries : subtrees)
+		{
+			record_t::replay(replayer, entries);
+		}
+	}
+}
+
+namespace tut
+{
+	struct octreecullrecord_data
+	{
+	};
+	typedef test_group<octreecullrecord_data> octreecullrecord_test;
+	typedef octreecullrecord_test::object octreecullrecord_object;
+	tut::octreecullrecord_test octreecullrecord_testcase("LLOctreeCullRecord");
+
+	template<> template<>
+	void octreecullrecord_object::test<1>()
+	{
+		set_test_name("a recorded walk skips occluded subtrees on replay");
+
+		// root with two children, the first occluded with a child of its own
+		TreeBuilder builder(1);
+		std::unique_ptr<TestNode> root = builder.build(0);
+		for (U32 i = 0; i < 2; ++i)
+		{
+			std::unique_ptr<TestNode> child(new TestNode);
+			child->mParent = root.get();
+			child->mElements = 1;
+			child->mGroup.reset(new TestGroup{ i + 1, 0, 2, 1, i == 0, child.get() });
+			root->mChildren.push_back(std::move(child));
+		}
+		TestNode* occluded = root->mChildren[0].get();
+		std::unique_ptr<TestNode> grandchild(new TestNode);
+		grandchild->mParent = occluded;
+		grandchild->mElements = 1;
+		grandchild->mGroup.reset(new TestGroup{ 3, 0, 2, 1, false, grandchild.get() });
+		occluded->mChildren.push_back(std::move(grandchild));
+		root->mElements = 1;
+		root->mGroup->mFrustum = 1;
+		root->mGroup->mObjectsFrustum = 1;
+		root->mGroup->mOccluded = true;
+
+		record_t::entry_t root_entry;
+		record_t::entry_list_t unused;
+		ensure_equals("root partially in", record_t(NULL, unused).recordRoot(root.get(), root_entry), 1);
+		ensure("root visible", root_entry.mVisible);
+
+		record_t::entry_list_t entries;
+		record_t(NULL, entries).recordSubtree(occluded, 1);
+		ensure_equals("the whole subtree recorded", entries.size(), (size_t)2);
+		ensure_equals("subtree end", entries[0].mEnd, (U32)2);
+		ensure("walked past occlusion", entries[1].mVisible);
+
+		TestCull replayer(NULL);
+		ensure("root never occluded", record_t::replayRoot(replayer, root_entry));
+		record_t::replay(replayer, entries);
+		ensure_equals("occluded group checked, its child skipped", replayer.mChecked.size(), (size_t)2);
+		ensure_equals("only the root processed", replayer.mVisible.size(), (size_t)1);
+	}
+
+	template<> template<>
+	void octreecullrecord_object::test<2>()
+	{
+		set_test_name("record and replay matches the serial cull");
+
+		U32 visible = 0;
+		U32 skipped = 0;
+		for (U32 seed = 1; seed <= 500; ++seed)
+		{
+			std::unique_ptr<TestNode> root = TreeBuilder(seed).build(5);
+
+			TestCull serial(NULL);
+			serial.traverse(root.get());
+
+			TestCull replayer(NULL);
+			record_and_replay(root.get(), replayer);
+
+			ensure("same groups checked for occlusion", replayer.mChecked == serial.mChecked);
+			ensure("same visible groups in the same order", replayer.mVisible == serial.mVisible);
+
+			visible += serial.mVisible.size();
+			skipped += serial.mChecked.size() - serial.mVisible.size();
+		}
+
+		// the trees had something to cull and something to keep
+		ensure("groups were visible", visible > 0);
+		ensure("groups were culled", skipped > 0);
+	}
+}
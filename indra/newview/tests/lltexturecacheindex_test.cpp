@@ -0,0 +1,267 @@
+/**
+ * @file lltexturecacheindex_test.cpp
+ * @brief Tests for the texture cache entry index.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../lltexturecacheindex.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "../test/lltut.h"
+
+namespace
+{
+	U64 mix(U64 x)
+	{
+		x += 0x9e3779b97f4a7c15ull;
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+		return x ^ (x >> 31);
+	}
+
+	// The n-th texture ID, random looking like the real ones
+	LLUUID make_id(U32 n)
+	{
+		LLUUID id;
+		U64 key[2] = { mix(n), mix(~(U64)n) };
+		memcpy(id.mData, key, UUID_BYTES);
+		return id;
+	}
+}
+
+namespace tut
+{
+	struct texturecacheindex_data
+	{
+	};
+	typedef test_group<texturecacheindex_data> texturecacheindex_test;
+	typedef texturecacheindex_test::object texturecacheindex_object;
+	tut::texturecacheindex_test texturecacheindex_testcase("LLTextureCacheIndex");
+
+	template<> template<>
+	void texturecacheindex_object::test<1>()
+	{
+		set_test_name("insert, find and replace");
+
+		LLTextureCacheIndex index;
+		ensure_equals("empty lookup", index.find(make_id(1)), -1);
+
+		index.reserve(64);
+		for (U32 n = 0; n < 64; ++n)
+		{
+			index.insert(make_id(n), (S32)n);
+		}
+		ensure_equals("size", index.size(), (U32)64);
+		for (U32 n = 0; n < 64; ++n)
+		{
+			ensure_equals("found at its entry", index.find(make_id(n)), (S32)n);
+		}
+		ensure_equals("unknown ID", index.find(make_id(1000)), -1);
+
+		// A new texture takes over entry 5, the old one goes
+		index.insert(make_id(1000), 5);
+		ensure_equals("new ID at the entry", index.find(make_id(1000)), 5);
+		ensure_equals("replaced ID gone", index.find(make_id(5)), -1);
+		ensure_equals("size unchanged", index.size(), (U32)64);
+
+		// Out of range entries are refused
+		index.insert(make_id(2000), 64);
+		ensure_equals("out of range", index.find(make_id(2000)), -1);
+
+		// Growing keeps what was indexed
+		index.reserve(4096);
+		ensure_equals("kept after growing", index.find(make_id(63)), 63);
+		ensure_equals("size after growing", index.size(), (U32)64);
+
+		index.clear();
+		ensure_equals("cleared", index.size(), (U32)0);
+		ensure_equals("gone after clear", index.find(make_id(63)), -1);
+	}
+
+	template<> template<>
+	void texturecacheindex_object::test<2>()
+	{
+		set_test_name("erase and reinsert reuse tombstones");
+
+		LLTextureCacheIndex index;
+		index.reserve(512);		// 1024 slots, rebuilt past 256 tombstones
+
+		index.insert(make_id(1), 0);
+		index.erase(make_id(1));
+		ensure_equals("erased", index.find(make_id(1)), -1);
+		ensure_equals("size after erase", index.size(), (U32)0);
+		ensure_equals("one tombstone", index.getTombstoneCount(), (U32)1);
+		index.erase(make_id(1));
+		ensure_equals("erasing twice leaves one", index.getTombstoneCount(), (U32)1);
+
+		// Coming back to another entry, the ID lands in its old slot
+		index.insert(make_id(1), 7);
+		ensure_equals("reinserted", index.find(make_id(1)), 7);
+		ensure_equals("tombstone reused", index.getTombstoneCount(), (U32)0);
+
+		// Churning one ID never piles up tombstones
+		for (U32 i = 0; i < 1000; ++i)
+		{
+			index.erase(make_id(1));
+			index.insert(make_id(1), (S32)(i % 512));
+		}
+		ensure_equals("no tombstones after churn", index.getTombstoneCount(), (U32)0);
+		ensure_equals("last entry", index.find(make_id(1)), (S32)(999 % 512));
+
+		// Half of a batch goes and comes back, each takes a tombstone
+		for (U32 n = 0; n < 200; ++n)
+		{
+			index.insert(make_id(100 + n), (S32)n);
+		}
+		for (U32 n = 0; n < 200; n += 2)
+		{
+			index.erase(make_id(100 + n));
+		}
+		ensure_equals("half erased", index.size(), (U32)101);
+		ensure_equals("their tombstones", index.getTombstoneCount(), (U32)100);
+		for (U32 n = 0; n < 200; n += 2)
+		{
+			index.insert(make_id(100 + n), (S32)(n + 300));
+		}
+		ensure_equals("back to full", index.size(), (U32)201);
+		ensure_equals("all tombstones reused", index.getTombstoneCount(), (U32)0);
+		for (U32 n = 0; n < 200; ++n)
+		{
+			ensure_equals("every ID at its entry", index.find(make_id(100 + n)), (S32)((n & 1) ? n : n + 300));
+		}
+
+		// Past a quarter of the slots the table is rebuilt without them
+		for (U32 n = 0; n < 200; ++n)
+		{
+			index.erase(make_id(100 + n));
+		}
+		ensure_equals("tombstones before the rebuild", index.getTombstoneCount(), (U32)200);
+		bool rebuilt = false;
+		for (U32 n = 0; n < 1000 && !rebuilt; ++n)
+		{
+			const U32 before = index.getTombstoneCount();
+			index.insert(make_id(1000 + n), (S32)(n % 512));
+			index.erase(make_id(1000 + n));
+			rebuilt = index.getTombstoneCount() < before;
+		}
+		ensure("rebuilt", rebuilt);
+		ensure_equals("only the churned ID left", index.size(), (U32)1);
+		ensure_equals("churned ID survives the rebuild", index.find(make_id(1)), (S32)(999 % 512));
+		index.insert(make_id(5000), 3);
+		ensure_equals("works after the rebuild", index.find(make_id(5000)), 3);
+	}
+
+	template<> template<>
+	void texturecacheindex_object::test<3>()
+	{
+		set_test_name("lookups racing a writer never see a torn entry");
+
+		const U32 entries = 256;
+		const U32 ids = 1024;
+		const U32 rounds = 200000;
+
+		LLTextureCacheIndex index;
+		index.reserve(entries);
+
+		// What the texture cache keeps per entry, here the ID's number
+		std::unique_ptr<std::atomic<U32>[]> owner(new std::atomic<U32>[entries]);
+		for (U32 idx = 0; idx < entries; ++idx)
+		{
+			owner[idx].store(idx, std::memory_order_relaxed);
+			index.insert(make_id(idx), (S32)idx);
+		}
+
+		// The writer keeps handing entries to new IDs, the way purging and
+		// adding textures does. Each entry briefly holds a stale owner, and
+		// the erases leave tombstones, so the table is rebuilt along the way.
+		std::atomic<bool> done(false);
+		std::thread writer([&]()
+			{
+				for (U32 round = 0; round < rounds; ++round)
+				{
+					const U32 idx = round % entries;
+					const U32 n = entries + round % (ids - entries);
+					LLTextureCacheIndex::ScopedWrite lock(index);
+					const U32 old_owner = owner[idx].load(std::memory_order_relaxed);
+					// the entry is rewritten while the old ID still points at it
+					owner[idx].store(0xffffffff, std::memory_order_relaxed);
+					if (round % 64 == 0)
+					{
+						// let the readers in mid change
+						std::this_thread::yield();
+					}
+					index.erase(make_id(old_owner));
+					owner[idx].store(n, std::memory_order_relaxed);
+					index.insert(make_id(n), (S32)idx);
+				}
+				done = true;
+			});
+
+		U32 hits = 0;
+		U32 lookups = 0;
+		bool consistent = true;
+		while (!done || lookups < 1000)
+		{
+			const U32 n = lookups++ % ids;
+			S32 idx;
+			U32 found_owner;
+			while (true)
+			{
+				const U32 seq = index.readBegin();
+				idx = index.find(make_id(n));
+				found_owner = idx >= 0 ? owner[idx].load(std::memory_order_relaxed) : n;
+				if (!index.readRetry(seq))
+				{
+					break;
+				}
+				// a change overlapped, let the writer finish it
+				std::this_thread::yield();
+			}
+
+			if (idx >= 0)
+			{
+				++hits;
+			}
+			if (found_owner != n)
+			{
+				consistent = false;
+				break;
+			}
+		}
+		writer.join();
+
+		ensure("every stable lookup matched its entry", consistent);
+		ensure("some lookups hit", hits > 0);
+
+		// Quiet again, the index agrees with the entries
+		for (U32 idx = 0; idx < entries; ++idx)
+		{
+			ensure_equals("final owner indexed", index.find(make_id(owner[idx])), (S32)idx);
+		}
+		ensure_equals("final size", index.size(), entries);
+	}
+}
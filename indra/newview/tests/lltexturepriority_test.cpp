@@ -0,0 +1,194 @@
+/**
+ * @file lltexturepriority_test.cpp
+ * @brief Tests for the texture priority buckets.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Alchemy Viewer Source Code
+ * Copyright (C) 2024, Alchemy Viewer Project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../lltexturepriority.h"
+
+#include <algorithm>
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// Just the bookkeeping LLViewerFetchedTexture carries for the buckets
+	struct TestTexture
+	{
+		S8		mPriorityBucket = -1;
+		U32		mPriorityIndex = 0;
+		bool	mPriorityNeedsWork = false;
+	};
+
+	typedef LLPriorityBuckets<TestTexture> buckets_t;
+
+	bool contains(const buckets_t& buckets, S32 bucket, bool needs_work, const TestTexture* texture)
+	{
+		const buckets_t::bucket_t& textures = buckets.getTextures(bucket, needs_work);
+		return std::find(textures.begin(), textures.end(), texture) != textures.end();
+	}
+
+	// Every texture sits at the slot it thinks it is at
+	bool consistent(const buckets_t& buckets)
+	{
+		U32 count = 0;
+		for (bool needs_work : { false, true })
+		{
+			for (S32 bucket = 0; bucket < buckets_t::NUM_BUCKETS; ++bucket)
+			{
+				const buckets_t::bucket_t& textures = buckets.getTextures(bucket, needs_work);
+				for (U32 i = 0; i < textures.size(); ++i)
+				{
+					const TestTexture* texture = textures[i];
+					if (texture->mPriorityBucket != bucket || texture->mPriorityNeedsWork != needs_work || texture->mPriorityIndex != i)
+					{
+						return false;
+					}
+				}
+				count += (U32)textures.size();
+			}
+		}
+		return count == buckets.size();
+	}
+}
+
+namespace tut
+{
+	struct texturepriority_data
+	{
+	};
+	typedef test_group<texturepriority_data> texturepriority_test;
+	typedef texturepriority_test::object texturepriority_object;
+	tut::texturepriority_test texturepriority_testcase("LLTexturePriorityBuckets");
+
+	template<> template<>
+	void texturepriority_object::test<1>()
+	{
+		set_test_name("bucket placement");
+
+		ensure_equals("nothing", buckets_t::getBucket(0.f), 0);
+		ensure_equals("under a pixel", buckets_t::getBucket(0.5f), 0);
+		ensure_equals("one pixel", buckets_t::getBucket(1.f), 1);
+		ensure_equals("just under two", buckets_t::getBucket(1.99f), 1);
+		ensure_equals("two pixels", buckets_t::getBucket(2.f), 2);
+		ensure_equals("1024x1024", buckets_t::getBucket(1024.f * 1024.f), 21);
+		ensure_equals("clamped to the top", buckets_t::getBucket(1e30f), buckets_t::NUM_BUCKETS - 1);
+
+		buckets_t buckets;
+		TestTexture small, large, loaded;
+		ensure_equals("empty", buckets.getTopBucket(true), -1);
+
+		buckets.update(&small, 16.f, true);
+		buckets.update(&large, 4096.f, true);
+		buckets.update(&loaded, 1e6f, false);
+		ensure_equals("count", buckets.size(), (U32)3);
+		ensure_equals("small bucket", (S32)small.mPriorityBucket, 5);
+		ensure("small filed", contains(buckets, 5, true, &small));
+		ensure("large filed", contains(buckets, 13, true, &large));
+		ensure("loaded texture kept apart", contains(buckets, 20, false, &loaded));
+		ensure_equals("top bucket needing work", buckets.getTopBucket(true), 13);
+		ensure_equals("top bucket of loaded textures", buckets.getTopBucket(false), 20);
+		ensure("consistent", consistent(buckets));
+
+		// Same bucket, nothing moves
+		buckets.update(&small, 20.f, true);
+		ensure_equals("same slot", small.mPriorityIndex, (U32)0);
+		ensure_equals("same count", buckets.size(), (U32)3);
+
+		buckets.clear();
+		ensure_equals("cleared", buckets.size(), (U32)0);
+		ensure_equals("texture unfiled", (S32)large.mPriorityBucket, -1);
+		ensure_equals("nothing left", buckets.getTopBucket(false), -1);
+	}
+
+	template<> template<>
+	void texturepriority_object::test<2>()
+	{
+		set_test_name("swap remove");
+
+		buckets_t buckets;
+		TestTexture textures[5];
+		for (TestTexture& texture : textures)
+		{
+			buckets.update(&texture, 100.f, true);
+		}
+		ensure_equals("all in one bucket", buckets.getTextures(7, true).size(), (size_t)5);
+
+		// The last one takes the removed one's slot
+		buckets.remove(&textures[1]);
+		ensure_equals("removed texture unfiled", (S32)textures[1].mPriorityBucket, -1);
+		ensure("last moved into the hole", buckets.getTextures(7, true)[1] == &textures[4]);
+		ensure_equals("moved texture knows its slot", textures[4].mPriorityIndex, (U32)1);
+		ensure("consistent after a middle remove", consistent(buckets));
+
+		buckets.remove(&textures[4]);
+		buckets.remove(&textures[3]);
+		ensure("consistent after removing the tail", consistent(buckets));
+
+		// Removing twice is harmless
+		buckets.remove(&textures[3]);
+		ensure_equals("count", buckets.size(), (U32)2);
+
+		buckets.remove(&textures[0]);
+		buckets.remove(&textures[2]);
+		ensure_equals("empty", buckets.size(), (U32)0);
+		ensure_equals("no top bucket", buckets.getTopBucket(true), -1);
+	}
+
+	template<> template<>
+	void texturepriority_object::test<3>()
+	{
+		set_test_name("rescore of a dirty texture");
+
+		buckets_t buckets;
+		TestTexture a, b, c;
+		buckets.update(&a, 64.f, true);
+		buckets.update(&b, 64.f, true);
+		buckets.update(&c, 64.f, true);
+
+		// A face grew, the texture moves up and the others close ranks
+		buckets.update(&a, 65536.f, true);
+		ensure("moved up", contains(buckets, 17, true, &a));
+		ensure("gone from the old bucket", !contains(buckets, 7, true, &a));
+		ensure_equals("old bucket size", buckets.getTextures(7, true).size(), (size_t)2);
+		ensure_equals("new top", buckets.getTopBucket(true), 17);
+		ensure("consistent after moving up", consistent(buckets));
+
+		// Fully loaded, the fetch walk no longer sees it
+		buckets.update(&a, 65536.f, false);
+		ensure("moved to the loaded textures", contains(buckets, 17, false, &a));
+		ensure_equals("top bucket needing work", buckets.getTopBucket(true), 7);
+
+		// Out of view, it drops to the bottom, still filed as loaded
+		buckets.update(&a, 0.f, false);
+		ensure("dropped to bucket 0", contains(buckets, 0, false, &a));
+		ensure_equals("nothing loaded above it", buckets.getTopBucket(false), 0);
+
+		// Wanted again at a higher resolution
+		buckets.update(&a, 256.f, true);
+		ensure("back with the textures needing work", contains(buckets, 9, true, &a));
+		ensure_equals("count unchanged", buckets.size(), (U32)3);
+		ensure("consistent", consistent(buckets));
+	}
+}